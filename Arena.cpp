@@ -0,0 +1,242 @@
+#include "gb-include.h"
+
+#include "Arena.h"
+#include "Mem.h"
+#include "GbMutex.h"
+#include "ScopedLock.h"
+#include "Errno.h"
+#include "SafeBuf.h"
+#include "HashTableX.h"
+
+
+const size_t Arena::s_chunkSize;
+
+// keep at most this many free chunks (16MB) around for reuse
+static const int32_t s_maxPooledChunks = 256;
+
+static GbMutex s_poolMtx;
+static void *s_pool = NULL; // singly linked through the first word
+static int32_t s_numPooled = 0;
+static int64_t s_poolHits = 0;
+static int64_t s_poolMisses = 0;
+
+
+static void *getPooledChunk() {
+	ScopedLock sl(s_poolMtx);
+	if ( ! s_pool ) {
+		s_poolMisses++;
+		return NULL;
+	}
+	void *mem = s_pool;
+	s_pool = *(void **)mem;
+	s_numPooled--;
+	s_poolHits++;
+	return mem;
+}
+
+static bool putPooledChunk(void *mem) {
+	ScopedLock sl(s_poolMtx);
+	if ( s_numPooled >= s_maxPooledChunks ) {
+		return false;
+	}
+	*(void **)mem = s_pool;
+	s_pool = mem;
+	s_numPooled++;
+	return true;
+}
+
+
+Arena::Arena(const char *note)
+	: m_note(note)
+	, m_chunks(NULL)
+	, m_spare(NULL)
+	, m_cur(NULL)
+	, m_end(NULL)
+	, m_used(0)
+	, m_allocated(0) {
+}
+
+Arena::~Arena() {
+	clear();
+}
+
+static inline size_t alignUp(size_t size) {
+	return (size + 7) & ~(size_t)7;
+}
+
+static const size_t s_headerSize = alignUp(sizeof(void *) + sizeof(size_t));
+
+// smallest kept chunk big enough for "size" bytes, including the header
+Arena::Chunk *Arena::getSpareChunk(size_t size) {
+	Chunk **best = NULL;
+	for ( Chunk **prev = &m_spare ; *prev ; prev = &(*prev)->m_next ) {
+		if ( (*prev)->m_size >= size && ( ! best || (*prev)->m_size < (*best)->m_size ) ) {
+			best = prev;
+		}
+	}
+	if ( ! best ) {
+		return NULL;
+	}
+	Chunk *chunk = *best;
+	*best = chunk->m_next;
+	return chunk;
+}
+
+void Arena::releaseChunk(Chunk *chunk) {
+	size_t size = chunk->m_size;
+	m_allocated -= size;
+	if ( size != s_chunkSize || ! putPooledChunk(chunk) ) {
+		mfree(chunk, size, m_note);
+	}
+}
+
+// . big chunks are linked in behind the current chunk so we keep bumping in
+//   it. returns the chunk, NULL on failure
+Arena::Chunk *Arena::addChunk(size_t minSize) {
+	bool isBig = ( minSize > s_chunkSize / 4 );
+	size_t size = isBig ? s_headerSize + minSize : s_chunkSize;
+
+	Chunk *chunk = m_spare ? getSpareChunk(size) : NULL;
+	if ( chunk ) {
+		// may be bigger than asked for
+		size = chunk->m_size;
+	} else {
+		void *mem = isBig ? NULL : getPooledChunk();
+		if ( ! mem ) {
+			mem = mmalloc(size, m_note);
+			if ( ! mem ) {
+				g_errno = ENOMEM;
+				return NULL;
+			}
+		}
+
+		chunk = (Chunk *)mem;
+		chunk->m_size = size;
+		m_allocated += size;
+	}
+
+	void *mem = chunk;
+
+	if ( isBig && m_chunks ) {
+		chunk->m_next = m_chunks->m_next;
+		m_chunks->m_next = chunk;
+		return chunk;
+	}
+
+	chunk->m_next = m_chunks;
+	m_chunks = chunk;
+	if ( isBig ) {
+		// nothing else fits in it
+		m_cur = m_end = (char *)mem + size;
+	} else {
+		m_cur = (char *)mem + s_headerSize;
+		m_end = (char *)mem + size;
+	}
+	return chunk;
+}
+
+void *Arena::alloc(size_t size) {
+	size = alignUp(size ? size : 1);
+
+	if ( size > s_chunkSize / 4 ) {
+		Chunk *chunk = addChunk(size);
+		if ( ! chunk ) {
+			return NULL;
+		}
+		m_used += size;
+		return (char *)chunk + s_headerSize;
+	}
+
+	if ( (size_t)(m_end - m_cur) < size && ! addChunk(size) ) {
+		return NULL;
+	}
+
+	void *mem = m_cur;
+	m_cur += size;
+	m_used += size;
+	return mem;
+}
+
+void Arena::clear() {
+	rewind(0);
+}
+
+void Arena::rewind(size_t maxKeep) {
+	// the already kept ones first so we keep the same chunks over and over
+	Chunk *chunks = m_spare;
+	m_spare = NULL;
+	for ( int pass = 0 ; pass < 2 ; pass++ ) {
+		while ( chunks ) {
+			Chunk *next = chunks->m_next;
+			if ( chunks->m_size <= maxKeep ) {
+				maxKeep -= chunks->m_size;
+				chunks->m_next = m_spare;
+				m_spare = chunks;
+			} else {
+				releaseChunk(chunks);
+			}
+			chunks = next;
+		}
+		chunks = m_chunks;
+		m_chunks = NULL;
+	}
+
+	m_cur = NULL;
+	m_end = NULL;
+	m_used = 0;
+}
+
+bool Arena::reserve(SafeBuf *sb, int32_t need, const char *label) {
+	if ( sb->getAvail() >= need ) {
+		return true;
+	}
+	if ( sb->length() > 0 || need <= 0 ) {
+		return sb->reserve(need, label);
+	}
+
+	char *mem = (char *)alloc(need);
+	if ( ! mem ) {
+		return false;
+	}
+	sb->setBuf(mem, need, 0, false);
+	sb->setLabel(label);
+	return true;
+}
+
+bool Arena::setTable(HashTableX *ht, int32_t ks, int32_t ds, int32_t numSlots,
+                     bool allowDups, const char *label, bool useKeyMagic) {
+	int32_t need = HashTableX::getBufSize(ks, ds, numSlots);
+	char *mem = NULL;
+	if ( need > 0 ) {
+		mem = (char *)alloc(need);
+		if ( ! mem ) {
+			return false;
+		}
+	}
+	return ht->set(ks, ds, numSlots, mem, need, allowDups, label, useKeyMagic);
+}
+
+int32_t Arena::getNumPooledChunks() {
+	ScopedLock sl(s_poolMtx);
+	return s_numPooled;
+}
+
+int64_t Arena::getNumPoolHits() {
+	ScopedLock sl(s_poolMtx);
+	return s_poolHits;
+}
+
+int64_t Arena::getNumPoolMisses() {
+	ScopedLock sl(s_poolMtx);
+	return s_poolMisses;
+}
+
+void Arena::releasePool() {
+	ScopedLock sl(s_poolMtx);
+	while ( s_pool ) {
+		void *next = *(void **)s_pool;
+		mfree(s_pool, s_chunkSize, "Arena");
+		s_pool = next;
+	}
+	s_numPooled = 0;
+}
@@ -0,0 +1,88 @@
+// . bump allocator for memory that lives as long as a request, eg. the
+//   per docid split tables of a query's PosdbTable
+// . allocations are carved out of chunks which are all given back at once
+//   by clear() or the destructor. freeing single allocations is not possible
+// . standard sized chunks go to a process wide pool so the next request can
+//   reuse them without going through Mem, so Mem accounting and its lock are
+//   per chunk instead of per allocation
+// . an object that is reused, like a spider XmlDoc, can rewind() its arena
+//   instead, keeping the chunks it grew to for the next use
+// . an Arena must only be used by one thread at a time. the pool is locked
+
+#ifndef GB_ARENA_H
+#define GB_ARENA_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+class SafeBuf;
+class HashTableX;
+
+class Arena {
+public:
+	explicit Arena(const char *note = "Arena");
+	~Arena();
+
+	// . returns 8-byte aligned memory, NULL and g_errno=ENOMEM on failure
+	// . requests bigger than a quarter chunk get a chunk of their own
+	void *alloc(size_t size);
+
+	// give back all memory. pointers returned by alloc() become invalid
+	void clear();
+
+	// . like clear() but keeps up to "maxKeep" bytes of chunks for the next
+	//   alloc() calls instead of giving them back
+	// . pointers returned by alloc() become invalid
+	void rewind(size_t maxKeep);
+
+	// . like SafeBuf::reserve() but an empty buffer gets its memory from
+	//   the arena. it is not owned by the SafeBuf so it is never freed or
+	//   realloc'd in place, growing it copies it to the heap as with a
+	//   stack buffer
+	// . returns false and sets g_errno on error
+	bool reserve(SafeBuf *sb, int32_t need, const char *label);
+
+	// . like HashTableX::set() but the initial slots come from the arena.
+	//   the table does not own them, growing it moves it to the heap
+	// . returns false and sets g_errno on error
+	bool setTable(HashTableX *ht, int32_t ks, int32_t ds, int32_t numSlots,
+	              bool allowDups, const char *label, bool useKeyMagic);
+
+	// bytes handed out by alloc() since the last clear()
+	size_t getUsed() const { return m_used; }
+	// bytes in chunks held by this arena, including the ones kept by rewind()
+	size_t getAllocated() const { return m_allocated; }
+
+	// standard chunk size, including the chunk header
+	static const size_t s_chunkSize = 64 * 1024;
+
+	// pool statistics
+	static int32_t getNumPooledChunks();
+	static int64_t getNumPoolHits();
+	static int64_t getNumPoolMisses();
+	// free the pooled chunks, eg. at shutdown or when low on memory
+	static void releasePool();
+
+private:
+	Arena(const Arena &);
+	Arena &operator=(const Arena &);
+
+	struct Chunk {
+		Chunk *m_next;
+		size_t m_size; // including this header
+	};
+
+	Chunk *addChunk(size_t minSize);
+	Chunk *getSpareChunk(size_t minSize);
+	void releaseChunk(Chunk *chunk);
+
+	const char *m_note;
+	Chunk *m_chunks;  // current chunk first
+	Chunk *m_spare;   // kept by rewind(), not used yet
+	char *m_cur;      // free space in the current chunk
+	char *m_end;
+	size_t m_used;
+	size_t m_allocated;
+};
+
+#endif // GB_ARENA_H
@@ -0,0 +1,139 @@
+#ifndef GB_ASCIISIMD_H
+#define GB_ASCIISIMD_H
+
+// . fast paths for the ascii parts of utf8 text. most of the documents we
+//   index are mostly ascii so the utf8 decoding and property table lookups
+//   are only needed for a few chars
+// . these check 16 bytes at a time with sse2 and fall back to a plain loop
+//   for the tail and on other architectures
+// . they never look past "len"
+
+#include <inttypes.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+#ifdef __SSE2__
+// bit i set if byte i is in [lo,hi]
+static inline uint32_t asciiRangeMask16 ( __m128i v, char lo, char hi ) {
+	// shift so the range starts at -128 and compare signed
+	__m128i shifted = _mm_sub_epi8 ( v, _mm_set1_epi8 ( (char)(lo + 128) ) );
+	__m128i inRange = _mm_cmplt_epi8 ( shifted, _mm_set1_epi8 ( (char)(hi - lo - 127) ) );
+	return (uint32_t)_mm_movemask_epi8 ( inRange );
+}
+
+// bit i set if byte i is in [0-9A-Za-z]
+static inline uint32_t asciiAlnumMask16 ( __m128i v ) {
+	// lower case the letters by setting 0x20. no other byte becomes a
+	// lower case letter
+	__m128i lower = _mm_or_si128 ( v, _mm_set1_epi8 ( 0x20 ) );
+	return asciiRangeMask16 ( v, '0', '9' ) | asciiRangeMask16 ( lower, 'a', 'z' );
+}
+#endif
+
+static inline bool isAsciiAlnumByte ( uint8_t c ) {
+	return ( c >= '0' && c <= '9' ) || ( ( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'z' );
+}
+
+// are all bytes below 0x80?
+static inline bool isAscii ( const char *s, int32_t len ) {
+	int32_t i = 0;
+#ifdef __SSE2__
+	for ( ; i + 16 <= len ; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i *)( s + i ) );
+		if ( _mm_movemask_epi8 ( v ) ) {
+			return false;
+		}
+	}
+#endif
+	for ( ; i + 8 <= len ; i += 8 ) {
+		uint64_t v;
+		memcpy ( &v, s + i, 8 );
+		if ( v & 0x8080808080808080ULL ) {
+			return false;
+		}
+	}
+	for ( ; i < len ; i++ ) {
+		if ( (uint8_t)s[i] & 0x80 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// number of leading bytes in [0x01,0x7f]
+static inline int32_t getAsciiSpanLen ( const char *s, int32_t len ) {
+	int32_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128 ( );
+	for ( ; i + 16 <= len ; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i *)( s + i ) );
+		uint32_t stop = (uint32_t)_mm_movemask_epi8 ( v ) |
+			(uint32_t)_mm_movemask_epi8 ( _mm_cmpeq_epi8 ( v, zero ) );
+		if ( stop ) {
+			return i + __builtin_ctz ( stop );
+		}
+	}
+#endif
+	for ( ; i < len ; i++ ) {
+		uint8_t c = (uint8_t)s[i];
+		if ( c == 0 || c >= 0x80 ) {
+			break;
+		}
+	}
+	return i;
+}
+
+// number of leading bytes in [0-9A-Za-z]
+static inline int32_t getAsciiAlnumSpanLen ( const char *s, int32_t len ) {
+	int32_t i = 0;
+#ifdef __SSE2__
+	for ( ; i + 16 <= len ; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i *)( s + i ) );
+		uint32_t stop = ~asciiAlnumMask16 ( v ) & 0xffff;
+		if ( stop ) {
+			return i + __builtin_ctz ( stop );
+		}
+	}
+#endif
+	for ( ; i < len ; i++ ) {
+		if ( ! isAsciiAlnumByte ( (uint8_t)s[i] ) ) {
+			break;
+		}
+	}
+	return i;
+}
+
+// . number of leading bytes in [0x01,0x7f] that are not [0-9A-Za-z]
+// . also stops at '<' if "stopAtTag" is true
+static inline int32_t getAsciiPunctSpanLen ( const char *s, int32_t len, bool stopAtTag ) {
+	int32_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128 ( );
+	const __m128i lt = _mm_set1_epi8 ( '<' );
+	for ( ; i + 16 <= len ; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i *)( s + i ) );
+		uint32_t stop = asciiAlnumMask16 ( v ) |
+			(uint32_t)_mm_movemask_epi8 ( v ) |
+			(uint32_t)_mm_movemask_epi8 ( _mm_cmpeq_epi8 ( v, zero ) );
+		if ( stopAtTag ) {
+			stop |= (uint32_t)_mm_movemask_epi8 ( _mm_cmpeq_epi8 ( v, lt ) );
+		}
+		if ( stop ) {
+			return i + __builtin_ctz ( stop );
+		}
+	}
+#endif
+	for ( ; i < len ; i++ ) {
+		uint8_t c = (uint8_t)s[i];
+		if ( c == 0 || c >= 0x80 || isAsciiAlnumByte ( c ) || ( stopAtTag && c == '<' ) ) {
+			break;
+		}
+	}
+	return i;
+}
+
+#endif // GB_ASCIISIMD_H
@@ -11,7 +11,11 @@
 #include "ScopedLock.h"
 #include "Mem.h"
 #include "Statistics.h"
+#include "GbIoUring.h"
+#include "Process.h"
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <new>
 #include <vector>
 #include <pthread.h>
@@ -26,6 +30,8 @@ static void readwriteWrapper_r  ( void *state );
 static void  readwriteDoneWrapper(void *state, job_exit_t exit_type);
 static bool  readwrite_r        ( FileState *fstate );
 
+static bool  readwriteUringStart( FileState *fstate );
+
 
 //A set (list in this case) of filenames that we intend to unlink or rename (src name).
 //it is needed for preventing queued read operations from working on deleted files.
@@ -77,6 +83,49 @@ bool BigFile::anyOngoingUnlinksOrRenames() {
 }
 
 
+//The file states currently being read/written through io_uring. Only modified
+//by the main thread but isBeingRead() is also called from the unlink threads.
+static std::vector<FileState*> s_uringFileStates;
+static GbMutex s_uringMtx;
+
+static void addUringFileState(FileState *fstate) {
+	ScopedLock sl(s_uringMtx);
+	s_uringFileStates.push_back(fstate);
+}
+
+static void removeUringFileState(FileState *fstate) {
+	ScopedLock sl(s_uringMtx);
+	for(std::vector<FileState*>::iterator iter=s_uringFileStates.begin(); iter!=s_uringFileStates.end(); ++iter) {
+		if(*iter==fstate) {
+			s_uringFileStates.erase(iter);
+			return;
+		}
+	}
+}
+
+//io_uring reads cannot be pulled back from the kernel, so just mark them so
+//the callback is told the read was cancelled, like cancel_file_read_jobs() does
+static void cancelUringReads(const BigFile *bf) {
+	ScopedLock sl(s_uringMtx);
+	for(auto fstate : s_uringFileStates) {
+		if(fstate->m_bigfile==bf && !fstate->m_doWrite)
+			fstate->m_cancelled = true;
+	}
+}
+
+
+bool BigFile::isBeingRead() const {
+	if(g_jobScheduler.is_reading_file(this))
+		return true;
+	ScopedLock sl(s_uringMtx);
+	for(auto fstate : s_uringFileStates) {
+		if(fstate->m_bigfile==this && !fstate->m_doWrite)
+			return true;
+	}
+	return false;
+}
+
+
 BigFile::~BigFile () {
 	close();
 }
@@ -92,7 +141,9 @@ BigFile::BigFile ()
     m_outstandingRenameP2JobCount(0),
     m_latestsRenameP1Errno(0),
     m_mtxMetaJobs(),
-    m_flushingIsApplicable(false)
+    m_flushingIsApplicable(false),
+    m_dropPageCache(false),
+    m_mmapReads(false)
 {
 	m_flags       = O_RDWR ; // | O_DIRECT;
 	m_maxParts = 0;
@@ -632,6 +683,8 @@ bool BigFile::readwrite ( void         *buf      ,
 	fstate->m_niceness    = niceness;
 	fstate->m_flags       = m_flags;
 	fstate->m_flushAfterWrite = g_conf.m_flushWrites && m_flushingIsApplicable;
+	fstate->m_dropCacheAfterWrite = doWrite && m_dropPageCache;
+	fstate->m_cancelled   = false;
 
 	// sanity
 	if ( fstate->m_bytesToGo > 150000000 ) {
@@ -695,6 +748,21 @@ bool BigFile::readwrite ( void         *buf      ,
 	fstate->m_startTime   = gettimeofdayInMilliseconds();
 	fstate->m_vfd         = m_vfd;
 
+	// . small reads of data that is already in the page cache are just
+	//   copied out of a mapping of the file. no thread hop, no syscall
+	if ( ! doWrite && m_mmapReads && g_conf.m_mmapPosdbReads && readFromMapping ( fstate ) ) {
+		return true;
+	}
+
+	// . queue it in io_uring if enabled. no thread hop needed. the
+	//   eventfd callback in the main loop calls readwriteDoneWrapper()
+	// . the ring is main thread only, other threads use the io threads
+	if(callback && g_conf.m_useIoUring && g_ioUring.isInitialized() && g_process.isMainThread() && g_jobScheduler.are_new_jobs_allowed()) {
+		if ( readwriteUringStart ( fstate ) ) {
+			return false;
+		}
+	}
+
 	if(callback && g_jobScheduler.are_new_jobs_allowed()) {
 		// . spawn a thread to do this i/o
 		// . this returns false and sets g_errno on error, true on success
@@ -1114,6 +1182,15 @@ static bool readwrite_r ( FileState *fstate ) {
 			errno = 0;
 		}
 
+		// . write back and drop the range from the page cache so a merge
+		//   does not push the query working set out of it
+		if (doWrite && fstate->m_dropCacheAfterWrite && n > 0) {
+			if (sync_file_range(fd, localOffset, n, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) == 0) {
+				posix_fadvise(fd, localOffset, n, POSIX_FADV_DONTNEED);
+			}
+			errno = 0;
+		}
+
 		// update the count
 		bytesDone += n;
 		// inc the main offset and the buffer ptr, "p"
@@ -1125,6 +1202,198 @@ static bool readwrite_r ( FileState *fstate ) {
 }
 
 
+
+static void readwriteUringDone(void *state, int32_t result);
+static void readwriteUringFinish(FileState *fstate, job_exit_t exit_type);
+
+// read/writes whose next piece did not fit in the ring. Main thread only
+static std::vector<FileState*> s_uringWaitingStates;
+
+// . queue the next piece of the read/write, at most up to the end of the
+//   current part file
+// . returns false if it could not be queued. m_errno is set if it never
+//   can be, otherwise the ring is full
+static bool readwriteUringNext(FileState *fstate) {
+	int64_t offset = fstate->m_offset + fstate->m_bytesDone;
+	int32_t filenum = offset / MAX_PART_SIZE;
+	int64_t localOffset = offset % MAX_PART_SIZE;
+	int64_t len = fstate->m_bytesToGo - fstate->m_bytesDone;
+	if (len > MAX_PART_SIZE - localOffset) {
+		len = MAX_PART_SIZE - localOffset;
+	}
+	// sqe lengths are 32 bits. short read/write handling does the rest
+	if (len > 0x40000000) {
+		len = 0x40000000;
+	}
+
+	int fd = -1;
+	if (filenum == fstate->m_filenum1) {
+		fd = fstate->m_fd1;
+	} else if (filenum == fstate->m_filenum2) {
+		fd = fstate->m_fd2;
+	}
+	if (fd < 0) {
+		log(LOG_LOGIC, "disk: fd < 0 for filenum %d. Bad engineer.", filenum);
+		fstate->m_errno = EBADENGINEER;
+		return false;
+	}
+
+	char *p = fstate->m_buf + fstate->m_bytesDone;
+	if (fstate->m_doWrite) {
+		unsigned flags = 0;
+		if (fstate->m_flushAfterWrite) {
+			flags |= GbIoUring::flag_datasync;
+		}
+		if (fstate->m_dropCacheAfterWrite) {
+			flags |= GbIoUring::flag_drop_cache;
+		}
+		return g_ioUring.write(fd, p, len, localOffset, flags, fstate, readwriteUringDone);
+	} else {
+		return g_ioUring.read(fd, p, len, localOffset, fstate, readwriteUringDone);
+	}
+}
+
+
+// . start a read/write through io_uring
+// . returns false if it could not be queued. nothing has been done then and
+//   the caller should use the io threads instead
+static bool readwriteUringStart(FileState *fstate) {
+	// let the thread path deal with files about to be unlinked
+	if ((fstate->m_filename1[0] && isPendingUnlink(fstate->m_filename1)) ||
+	    (fstate->m_filename2[0] && isPendingUnlink(fstate->m_filename2))) {
+		return false;
+	}
+
+	// writes already got their fds and entered write mode in readwrite()
+	if ( ! fstate->m_doWrite ) {
+		fstate->m_fd1 = fstate->m_bigfile->getfd(fstate->m_filenum1, true);
+		fstate->m_fd2 = fstate->m_bigfile->getfd(fstate->m_filenum2, true);
+		fstate->m_closeCount1 = getCloseCount_r(fstate->m_fd1);
+		fstate->m_closeCount2 = getCloseCount_r(fstate->m_fd2);
+
+		if ( ! fstate->m_buf && fstate->m_bytesToGo > 0 ) {
+			int64_t need = fstate->m_bytesToGo + fstate->m_allocOff;
+			char *p = (char *) mmalloc ( need , "ThreadReadBuf" );
+			if ( ! p ) {
+				log( LOG_WARN, "disk: read buf alloc failed for %" PRId64" bytes.", need );
+				return false;
+			}
+			fstate->m_buf       = p + fstate->m_allocOff;
+			fstate->m_allocBuf  = p;
+			fstate->m_allocSize = need;
+		}
+	}
+
+	if ( fstate->m_bytesToGo <= 0 ) {
+		return false;
+	}
+
+	addUringFileState(fstate);
+	if ( ! readwriteUringNext(fstate) ) {
+		removeUringFileState(fstate);
+		// the io threads get their own fds
+		fstate->m_errno = 0;
+		return false;
+	}
+	return true;
+}
+
+
+// . called by g_ioUring after it processed completions, so there may be
+//   room in the ring again
+// . whatever still doesn't fit waits for the next completions. there is
+//   always some operation in flight when the ring is full
+static void readwriteUringRetry() {
+	std::vector<FileState*> waiting;
+	waiting.swap(s_uringWaitingStates);
+	for ( auto fstate : waiting ) {
+		if ( fstate->m_cancelled ) {
+			readwriteUringFinish(fstate, job_exit_cancelled);
+		} else if ( ! readwriteUringNext(fstate) ) {
+			if ( fstate->m_errno ) {
+				readwriteUringFinish(fstate, job_exit_normal);
+			} else {
+				s_uringWaitingStates.push_back(fstate);
+			}
+		}
+	}
+}
+
+
+static void readwriteUringFinish(FileState *fstate, job_exit_t exit_type) {
+	removeUringFileState(fstate);
+	fstate->m_doneTime = gettimeofdayInMilliseconds();
+
+	if ( exit_type == job_exit_cancelled && fstate->m_allocBuf ) {
+		mfree ( fstate->m_allocBuf, fstate->m_allocSize, "ThreadReadBuf" );
+		fstate->m_buf       = NULL;
+		fstate->m_allocBuf  = NULL;
+		fstate->m_allocSize = 0;
+	}
+
+	readwriteDoneWrapper(fstate, exit_type);
+}
+
+
+// . called from the main loop when io_uring completed a piece of the
+//   read/write
+static void readwriteUringDone(void *state, int32_t result) {
+	FileState *fstate = (FileState *)state;
+
+	if ( fstate->m_cancelled ) {
+		readwriteUringFinish(fstate, job_exit_cancelled);
+		return;
+	}
+
+	if ( result == -EINTR || result == -EAGAIN ) {
+		result = 0;
+	} else if ( result < 0 ) {
+		// same as what readwrite_r() does
+		log(LOG_ERROR, "disk::readwriteUringDone: %s error: %s", fstate->m_doWrite ? "write" : "read", mstrerror(-result));
+		gbshutdownAbort(true);
+	} else if ( result == 0 && fstate->m_doWrite ) {
+		log(LOG_WARN, "disk: Write of %" PRId64" bytes at offset %" PRId64" wrote nothing. fd1=%i fd2=%i",
+		    fstate->m_bytesToGo - fstate->m_bytesDone, fstate->m_offset + fstate->m_bytesDone,
+		    fstate->m_fd1, fstate->m_fd2);
+		fstate->m_errno = EBADENGINEER;
+		readwriteUringFinish(fstate, job_exit_normal);
+		return;
+	} else if ( result == 0 ) {
+		log(LOG_WARN, "disk: Read of %" PRId64" bytes at offset %" PRId64" failed because file is too short for that offset? fd1=%i fd2=%i",
+		    fstate->m_bytesToGo - fstate->m_bytesDone, fstate->m_offset + fstate->m_bytesDone,
+		    fstate->m_fd1, fstate->m_fd2);
+		fstate->m_errno = EBADENGINEER;
+		readwriteUringFinish(fstate, job_exit_normal);
+		return;
+	}
+
+	fstate->m_bytesDone += result;
+
+	if ( fstate->m_bytesDone < fstate->m_bytesToGo ) {
+		if ( readwriteUringNext(fstate) ) {
+			return;
+		}
+		if ( ! fstate->m_errno ) {
+			// . ring is full. queue the rest when completions made room
+			//   instead of blocking the main thread
+			g_ioUring.setRetryCallback(readwriteUringRetry);
+			s_uringWaitingStates.push_back(fstate);
+			return;
+		}
+	}
+
+	// . fd may have been closed and re-opened for another file while we
+	//   were waiting. see readwriteWrapper_r()
+	if ( ! fstate->m_doWrite && ! fstate->m_errno &&
+	     ( getCloseCount_r ( fstate->m_fd1 ) != fstate->m_closeCount1 ||
+	       getCloseCount_r ( fstate->m_fd2 ) != fstate->m_closeCount2 ) ) {
+		fstate->m_errno = EFILECLOSED;
+	}
+
+	readwriteUringFinish(fstate, job_exit_normal);
+}
+
+
 bool BigFile::unlink() {
 	logTrace( g_conf.m_logTraceBigFile, "BEGIN. filename [%s]", getFilename());
 	
@@ -1149,6 +1418,7 @@ bool BigFile::unlink() {
 	// remove all queued threads that point to us that have not
 	// yet been launched
 	g_jobScheduler.cancel_file_read_jobs(this);
+	cancelUringReads(this);
 	
 	bool anyErrors = false;
 	for(int32_t i = 0; i < m_maxParts; i++) {
@@ -1418,6 +1688,7 @@ bool BigFile::unlink(int32_t part, void (*callback)(void *state), void *state) {
 		// remove all queued threads that point to us that have not
 		// yet been launched
 		g_jobScheduler.cancel_file_read_jobs(this);
+		cancelUringReads(this);
 	}
 
 	// save callback for when all parts are unlinked
@@ -1824,7 +2095,7 @@ void BigFile::unlinkWrapper(File *f) {
 	//100ms, break after 5 seconds because then it is highly unlikely that
 	//any unfinished job refers to that area/file anymore.
 	for(int i=0; i<50; i++) {
-		if(!g_jobScheduler.is_reading_file(this))
+		if(!isBeingRead())
 			break;
 		usleep(100000); //sleep 100ms
 	}
@@ -1901,6 +2172,116 @@ void BigFile::doneUnlinkWrapper(File *f, int32_t i) {
 	logTrace( g_conf.m_logTraceBigFile, "END" );
 }
 
+// reads bigger than this are never served from a mapping. also bounds the
+// mincore() vector in readFromMapping()
+static const int64_t s_maxMmapReadBytes = 1024*1024;
+
+bool BigFile::readFromMapping ( FileState *fstate ) {
+	int64_t size = fstate->m_bytesToGo;
+	int64_t maxSize = g_conf.m_mmapReadMaxBytes;
+	if ( maxSize > s_maxMmapReadBytes ) maxSize = s_maxMmapReadBytes;
+	if ( size <= 0 || size > maxSize ) {
+		return false;
+	}
+
+	// must be within one part file
+	int32_t n = fstate->m_offset / MAX_PART_SIZE;
+	if ( n != ( fstate->m_offset + size - 1 ) / MAX_PART_SIZE ) {
+		return false;
+	}
+	int64_t localOffset = fstate->m_offset - (int64_t)n * MAX_PART_SIZE;
+
+	ScopedLock sl(m_mappedPartsMtx);
+
+	if ( n >= (int32_t)m_mappedParts.size() ) {
+		MappedPart empty = { NULL, 0 };
+		m_mappedParts.resize ( n + 1, empty );
+	}
+	MappedPart *mp = &m_mappedParts[n];
+
+	// (re)map the part if this read is past what we have mapped. the file
+	// may have grown since we mapped it, like a merge target does
+	if ( localOffset + size > mp->m_size ) {
+		unmapPart ( n );
+		int fd = getfd ( n, true );
+		if ( fd < 0 ) {
+			g_errno = 0;
+			return false;
+		}
+		struct stat st;
+		if ( fstat ( fd, &st ) != 0 || localOffset + size > st.st_size ) {
+			return false;
+		}
+		void *p = mmap ( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( p == MAP_FAILED ) {
+			log( LOG_WARN, "disk: mmap of %s failed: %s", getFile2(n)->getFilename(), mstrerror(errno) );
+			return false;
+		}
+		madvise ( p, st.st_size, MADV_RANDOM );
+		mp->m_ptr  = (char *)p;
+		mp->m_size = st.st_size;
+	}
+
+	// caller may want us to allocate the buffer like the io threads do.
+	// done before the mincore() check to keep the window between it and
+	// the memcpy() short. if we fall back the io threads use this buffer
+	if ( ! fstate->m_buf ) {
+		int64_t need = size + fstate->m_allocOff;
+		char *p = (char *) mmalloc ( need , "ThreadReadBuf" );
+		if ( ! p ) {
+			g_errno = 0;
+			return false;
+		}
+		fstate->m_buf       = p + fstate->m_allocOff;
+		fstate->m_allocBuf  = p;
+		fstate->m_allocSize = need;
+	}
+
+	// . only copy if every page is in memory. otherwise we would block the
+	//   main loop on the page faults, so leave it to the io threads which
+	//   also brings it into the page cache for next time
+	// . this is best-effort. a page can still be evicted between mincore()
+	//   and memcpy(), and then the memcpy() takes a major fault on the
+	//   calling thread. pinning the pages with mlock() would cost a syscall
+	//   per read and count against RLIMIT_MEMLOCK, which is the overhead
+	//   this path avoids. eviction of a page just found resident is rare,
+	//   and the worst case is one blocking read on the main thread
+	static const int64_t pageSize = sysconf ( _SC_PAGESIZE );
+	int64_t start = localOffset & ~(pageSize - 1);
+	int64_t len = localOffset + size - start;
+	int64_t numPages = ( len + pageSize - 1 ) / pageSize;
+	unsigned char vec[ s_maxMmapReadBytes / 4096 + 2 ];
+	if ( numPages > (int64_t)sizeof(vec) ) {
+		return false;
+	}
+	if ( mincore ( mp->m_ptr + start, len, vec ) != 0 ) {
+		return false;
+	}
+	for ( int64_t i = 0 ; i < numPages ; i++ ) {
+		if ( ! ( vec[i] & 1 ) ) {
+			return false;
+		}
+	}
+
+	memcpy ( fstate->m_buf, mp->m_ptr + localOffset, size );
+
+	fstate->m_bytesDone = size;
+	fstate->m_doneTime  = gettimeofdayInMilliseconds();
+	return true;
+}
+
+void BigFile::unmapPart ( int32_t n ) {
+	if ( n >= (int32_t)m_mappedParts.size() ) {
+		return;
+	}
+	MappedPart *mp = &m_mappedParts[n];
+	if ( mp->m_ptr ) {
+		munmap ( mp->m_ptr, mp->m_size );
+	}
+	mp->m_ptr  = NULL;
+	mp->m_size = 0;
+}
+
 void BigFile::removePart ( int32_t i ) {
 	//File *f = getFile2(i);
 	File **filePtrs = (File **)m_filePtrsBuf.getBufStart();
@@ -1913,6 +2294,10 @@ void BigFile::removePart ( int32_t i ) {
 
 	// and clear from our table
 	filePtrs[i] = NULL;
+	{
+		ScopedLock sl(m_mappedPartsMtx);
+		unmapPart ( i );
+	}
 	// we have one less part
 	m_numParts--;
 	// max part num may be different
@@ -1961,8 +2346,17 @@ bool BigFile::close ( ) {
 	m_numParts   = 0;
 	m_maxParts   = 0;
 
+	{
+		ScopedLock sl(m_mappedPartsMtx);
+		for ( int32_t i = 0 ; i < (int32_t)m_mappedParts.size() ; i++ ) {
+			unmapPart ( i );
+		}
+		m_mappedParts.clear();
+	}
+
 	// remove all queued threads that point to us that have not
 	// yet been launched
 	g_jobScheduler.cancel_file_read_jobs(this);
+	cancelUringReads(this);
 	return true;
 }
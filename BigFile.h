@@ -13,6 +13,7 @@
 #include "JobScheduler.h" //for job_exit_t
 #include "SafeBuf.h"
 #include "GbMutex.h"
+#include <vector>
 
 
 #ifndef PRIVACORE_TEST_VERSION
@@ -73,6 +74,10 @@ public:
 
 	int32_t m_flags;
 	bool m_flushAfterWrite;
+	bool m_dropCacheAfterWrite;
+
+	// set if the bigfile was closed while the read was queued in io_uring
+	bool m_cancelled;
 
 	// when we are given a NULL buffer to read into we must allocate
 	// in Threads.cpp right before the
@@ -109,6 +114,8 @@ public:
 		m_closeCount2 = 0;
 		m_flags = 0;
 		m_flushAfterWrite = false;
+		m_dropCacheAfterWrite = false;
+		m_cancelled = false;
 		m_allocBuf = NULL;
 		m_allocSize = 0;
 		m_allocOff = 0;
@@ -140,6 +147,13 @@ class BigFile {
 
 	void setFlushingIsApplicable() { m_flushingIsApplicable=true; }
 
+	// write back and drop written data from the page cache (used for merges)
+	void setDropPageCache(bool dropPageCache) { m_dropPageCache = dropPageCache; }
+
+	// allow small reads to be served from an mmap of the part files when
+	// g_conf.m_mmapPosdbReads is on (see readFromMapping())
+	void setMmapReads(bool mmapReads) { m_mmapReads = mmapReads; }
+
 	void logAllData(int32_t log_type);
 
 	// . return -2 on error
@@ -223,6 +237,22 @@ private:
 
 	void removePart ( int32_t i ) ;
 
+	// . copy a read straight out of the mapping of its part file if
+	//   all the pages are in the page cache
+	// . the page cache check is best-effort, a page evicted right after it
+	//   makes the copy fault on the calling thread
+	// . returns false if the read must be done the normal way
+	bool readFromMapping ( FileState *fstate );
+	// caller must hold m_mappedPartsMtx
+	void unmapPart ( int32_t n );
+
+	struct MappedPart {
+		char    *m_ptr;
+		int64_t  m_size;
+	};
+	std::vector<MappedPart> m_mappedParts;
+	GbMutex m_mappedPartsMtx; //protects m_mappedParts
+
 	void (*m_callback)(void *state);
 	void  *m_state;
 
@@ -292,6 +322,8 @@ private:
 
 	int32_t m_flags;
 	bool m_flushingIsApplicable; //is g_conf.m_flushWrites relevant for this file?
+	bool m_dropPageCache;
+	bool m_mmapReads;
 
 	int32_t             m_vfd;
 
@@ -334,6 +366,9 @@ public:
 
 	static bool anyOngoingUnlinksOrRenames();
 
+	// is there a queued or running read (io thread or io_uring) on this file?
+	bool isBeingRead() const;
+
 	bool reset ( );
 
 	int32_t getMaxParts() const { return m_maxParts; }
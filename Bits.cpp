@@ -7,11 +7,13 @@
 #include "Mem.h"
 #include "Sections.h"
 #include "Process.h"
+#include "Arena.h"
 
 
 Bits::Bits() {
 	m_bits = NULL;
 	m_swbits = NULL;
+	m_arena = NULL;
 	memset(m_localBuf, 0, sizeof(m_localBuf));
 	reset();
 }
@@ -55,6 +57,10 @@ bool Bits::set(const Words *words) {
 	// use local buf?
 	if ( need < BITS_LOCALBUFSIZE ) {
 		m_bits = (wbit_t *) m_localBuf;
+	} else if ( m_arena ) {
+		// freed by the arena's owner
+		m_bitsSize = need;
+		m_bits = (wbit_t *)m_arena->alloc ( need );
 	} else {
 		m_bitsSize = need;
 		m_bits = (wbit_t *)mmalloc ( need , "Bits1" );
@@ -226,6 +232,9 @@ bool Bits::setForSummary ( const Words *words ) {
 	// use local buf?
 	if ( need < BITS_LOCALBUFSIZE ) {
 		m_swbits = (swbit_t *)m_localBuf;
+	} else if ( m_arena ) {
+		m_swbitsSize = need;
+		m_swbits = (swbit_t *)m_arena->alloc ( need );
 	} else {
 		// i guess need to malloc
 		m_swbitsSize = need;
@@ -101,6 +101,12 @@ public:
 
 	void reset();
 
+	// . get the bit arrays from "arena" instead of the heap when they do
+	//   not fit the local buffer. stays set across reset()
+	void setArena ( class Arena *arena ) {
+		m_arena = arena;
+	}
+
 	bool isStopWord( int32_t i ) const {
 		return m_bits[i] & D_IS_STOPWORD;
 	}
@@ -133,6 +139,7 @@ public:
 	bool m_inUrlBitsSet;
 
 	bool m_needsFree;
+	class Arena *m_arena;
 	char m_localBuf [ BITS_LOCALBUFSIZE ];
 
 	// get bits for the ith word
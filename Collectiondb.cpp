@@ -23,6 +23,7 @@
 #include "File.h"
 #include "Conf.h"
 #include "Mem.h"
+#include "ScopedLock.h"
 #include <sys/stat.h> //mkdir()
 
 static HashTableX g_collTable;
@@ -401,6 +402,9 @@ bool Collectiondb::registerCollRec ( CollectionRec *cr ) {
 
 // swap it in
 bool Collectiondb::addRdbBaseToAllRdbsForEachCollRec ( ) {
+	// read the maps and indexes of all collections in one go
+	RdbBase::beginParallelLoad();
+
 	for ( int32_t i = 0 ; i < m_numRecs ; i++ ) {
 		CollectionRec *cr = m_recs[i];
 		if ( ! cr ) continue;
@@ -408,6 +412,8 @@ bool Collectiondb::addRdbBaseToAllRdbsForEachCollRec ( ) {
 		addRdbBasesForCollRec ( cr );
 	}
 
+	RdbBase::finishParallelLoad();
+
 	// now clean the trees. moved this into here from
 	// addRdbBasesForCollRec() since we call addRdbBasesForCollRec()
 	// now from getBase() to load on-demand for saving memory
@@ -967,6 +973,8 @@ CollectionRec::CollectionRec() {
 	memset(m_numNegKeysInTree, 0, sizeof(m_numNegKeysInTree));
 	memset(m_numPosKeysInTree, 0, sizeof(m_numPosKeysInTree));
 	m_spiderColl = NULL;
+	// no rules until rebuildUrlFilters() is called
+	m_urlFilterProgram.reset ( new UrlFilterProgram );
 	m_overflow  = 0x12345678;
 	m_overflow2 = 0x12345678;
 	// the spiders are currently uninhibited i guess
@@ -2103,6 +2111,11 @@ bool CollectionRec::save ( ) {
 
 void nukeDoledb ( collnum_t collnum );
 
+urlfilterprogram_ptr_t CollectionRec::getUrlFilterProgram ( ) {
+	ScopedLock sl ( m_urlFilterProgramMtx );
+	return m_urlFilterProgram;
+}
+
 // . anytime the url filters are updated, this function is called
 // . it is also called on load of the collection at startup
 bool CollectionRec::rebuildUrlFilters ( ) {
@@ -2114,6 +2127,16 @@ bool CollectionRec::rebuildUrlFilters ( ) {
 	// set the url filters based on the url filter profile, if any
 	rebuildUrlFilters2();
 
+	// . so getUrlFilterNum() does not have to parse them for every url
+	// . compile into a new program and swap it in, because the
+	//   process-msg4 thread may be running the old one right now
+	urlfilterprogram_ptr_t prog ( new UrlFilterProgram );
+	prog->compile ( m_regExs , m_numRegExs );
+	{
+		ScopedLock sl ( m_urlFilterProgramMtx );
+		m_urlFilterProgram.swap ( prog );
+	}
+
 	// set this so we know whether we have to keep track of page counts
 	// per subdomain/site. if the url filters have
 	// 'sitepages' we have to keep
@@ -9,6 +9,7 @@
 #include "SafeBuf.h"
 #include "rdbid_t.h"
 #include "GbMutex.h"
+#include "UrlFilterProgram.h"
 
 
 class Collectiondb  {
@@ -175,6 +176,10 @@ public:
 	// for regular crawls
 	bool rebuildUrlFilters2();
 
+	// the compiled url filters. keep the returned pointer while using it,
+	// rebuildUrlFilters() may swap in a new one at any time
+	urlfilterprogram_ptr_t getUrlFilterProgram();
+
 	bool rebuildLangRules( const char *lang , const char *tld );
 
 	bool rebuildPrivacoreRules();
@@ -292,6 +297,10 @@ public:
 	// make Parms.cpp use that stringbuf rather than store into here...
 	SafeBuf		m_regExs[ MAX_FILTERS ];
 
+	// m_regExs compiled by rebuildUrlFilters() for getUrlFilterNum()
+	urlfilterprogram_ptr_t m_urlFilterProgram;
+	GbMutex m_urlFilterProgramMtx;
+
 	int32_t		m_numSpiderFreqs;	// useless, just for Parms::setParm()
 	float		m_spiderFreqs[ MAX_FILTERS ];
 
@@ -75,6 +75,9 @@ Conf::Conf ( ) {
 	m_titledbMaxLostPositivesPercentage = 0;
 	m_titledbFileCacheSize = 0;
 	m_titledbMaxTreeMem = 0;
+	m_titleRecCodec = 0;
+	m_titleRecCompressionLevel = 3;
+	m_titleRecUseDict = false;
 	m_spiderdbMaxLostPositivesPercentage = 0;
 	m_spiderdbFileCacheSize = 0;
 	m_spiderdbMaxTreeMem = 0;
@@ -84,7 +87,18 @@ Conf::Conf ( ) {
 	m_maxCpuThreads = 0;
 	m_maxIOThreads = 0;
 	m_maxExternalThreads = 0;
+	m_minCpuThreads = 0;
+	m_minSummaryThreads = 0;
+	m_minMergeThreads = 0;
+	m_jobThreadIdleTimeout = 0;
+	m_jobWorkStealing = false;
 	m_maxJobCleanupTime = 0;
+	m_loopEdgeTriggered = false;
+	m_udpBatchSize = 32;
+	m_udpReceiveThreads = 0;
+	m_udpCongestionControl = true;
+	m_multicastLatencyAwareSelection = true;
+	m_multicastHedging = false;
 	m_vagusClusterId[0] = '\0';
 	m_vagusPort = 8720;
 	m_vagusKeepaliveSendInterval = 500;
@@ -146,13 +160,28 @@ Conf::Conf ( ) {
 	m_useCollectionPasswords = false;
 	m_readOnlyMode = false;
 	m_useEtcHosts = false;
+	m_msg4MaxBatchSize = 32;
+	m_parallelIndexMinWords = 20000;
+	m_docArenaKeepSize = 2097152;
+	m_spiderWinnerCheck = false;
 	m_verifyTreeIntegrity = false;
 	m_verifyDumpedLists = false;
 	m_verifyIndex = false;
 	m_flushWrites = false;
+	m_useIoUring = false;
+	m_ioUringQueueDepth = 256;
+	m_mergeDropPageCache = false;
+	m_mmapRdbMaps = false;
+	m_mmapPosdbReads = false;
+	m_mmapReadMaxBytes = 65536;
+	m_parallelStartupLoad = true;
+	m_lazyLoadColdCollections = false;
+	m_packRdbIndexes = true;
 	m_verifyWrites = false;
 	m_corruptRetries = 0;
 	m_detectMemLeaks = false;
+	m_memTableTracking = true;
+	m_memSampleRate = 0;
 	m_forceIt = false;
 	m_doIncrementalUpdating = false;
 	m_stableSummaryCacheSize = 0;
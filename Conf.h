@@ -128,6 +128,10 @@ class Conf {
 	int32_t m_titledbMaxLostPositivesPercentage;
 	int64_t m_titledbFileCacheSize;
 	int32_t  m_titledbMaxTreeMem;
+	// titlerec_codec_t used for new titlerecs, see TitleRecCodec.h
+	int32_t  m_titleRecCodec;
+	int32_t  m_titleRecCompressionLevel;
+	bool     m_titleRecUseDict;
 
 	// spiderdb
 	int32_t m_spiderdbMaxLostPositivesPercentage;
@@ -151,8 +155,38 @@ class Conf {
 	int32_t  m_maxFileMetaThreads;
 	int32_t  m_maxMergeThreads;
 
+	// the cpu, summary and merge pools shrink to these when idle for
+	// m_jobThreadIdleTimeout ms and grow up to the max on demand
+	int32_t  m_minCpuThreads;
+	int32_t  m_minSummaryThreads;
+	int32_t  m_minMergeThreads;
+	int32_t  m_jobThreadIdleTimeout;
+
+	// let idle cpu/summary/merge threads run jobs queued for the others
+	bool     m_jobWorkStealing;
+
 	int32_t  m_maxJobCleanupTime;
 
+	// use edge triggered epoll in Loop instead of level triggered
+	bool     m_loopEdgeTriggered;
+
+	// max dgrams UdpServer reads/sends with one recvmmsg()/sendmmsg()
+	int32_t  m_udpBatchSize;
+
+	// # of threads reading the udp port with SO_REUSEPORT sockets. 0 means
+	// the main loop reads it
+	int32_t  m_udpReceiveThreads;
+
+	// adapt the udp ack window and resend time to the rtt and losses of
+	// each host instead of using fixed ones
+	bool     m_udpCongestionControl;
+
+	// pick the twin with the lowest recent response time in Multicast
+	bool     m_multicastLatencyAwareSelection;
+	// send a query multicast to a twin as well if the first host hasn't
+	// replied within the 95th percentile response time
+	bool     m_multicastHedging;
+
 	char    m_vagusClusterId[128];
 	int32_t m_vagusPort;
 	int32_t m_vagusKeepaliveSendInterval; //milliseconds
@@ -249,6 +283,21 @@ class Conf {
 	// if this is true we use /etc/hosts for hostname lookup before dns
 	bool   m_useEtcHosts;
 
+	// most incoming msg4 requests whose records are added to the rdbs
+	// together. 1 adds them one request at a time. takes effect on restart
+	int32_t m_msg4MaxBatchSize;
+
+	// documents with at least this many words are hashed for indexing in
+	// parallel stages. 0 disables
+	int32_t m_parallelIndexMinWords;
+
+	// bytes of parsing buffers each spider slot keeps for the next doc
+	int32_t m_docArenaKeepSize;
+
+	// do a full spiderdb scan after merging changed urls into the cached
+	// winners of an ip and log if they differ
+	bool m_spiderWinnerCheck;
+
 	//verify integrity of tree/buckets after modification operations
 	bool m_verifyTreeIntegrity;
 
@@ -261,6 +310,23 @@ class Conf {
 
 	// calls fsync(fd) if true after each write
 	bool   m_flushWrites; 
+
+	// use io_uring instead of the io thread pool for async file i/o
+	bool    m_useIoUring;
+	int32_t m_ioUringQueueDepth;
+	// write back and drop merge output from the page cache
+	bool    m_mergeDropPageCache;
+	// mmap map files instead of reading them into heap segments
+	bool    m_mmapRdbMaps;
+	// serve small, page-cache resident posdb reads from a mapping
+	bool    m_mmapPosdbReads;
+	int32_t m_mmapReadMaxBytes;
+	// read maps/indexes of all collections in parallel at startup
+	bool    m_parallelStartupLoad;
+	// don't load collections that are not spidering until first used
+	bool    m_lazyLoadColdCollections;
+	// keep docids of finished index files and the global index Elias-Fano encoded
+	bool    m_packRdbIndexes;
 	bool   m_verifyWrites;
 	int32_t   m_corruptRetries;
 
@@ -268,6 +334,12 @@ class Conf {
 
 	// log unfreed memory on exit
 	bool   m_detectMemLeaks;
+	// . keep every allocation in Mem's table for the unbalanced free and
+	//   breech checks. takes a global lock per allocation
+	// . the per note breakdown is kept without it
+	bool   m_memTableTracking;
+	// record 1 in this many allocations with a backtrace. 0 is off
+	int32_t m_memSampleRate;
 
 	bool   m_forceIt;
 
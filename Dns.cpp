@@ -232,18 +232,17 @@ bool Dns::init ( uint16_t clientPort ) {
 static bool isTimedOut(int32_t ip) {
 	// is this ip address in the "timed out" cache. if so,
 	// then do not try again for at least 1 hour
-	char *rec;
+	char rec[4];
 	int32_t  recSize;
 	int32_t  maxAge = 3600; // 1 hour in seconds
 	key96_t k;
 	k.n0 = 0LL;
 	k.n1 = ip;
-	RdbCacheLock rcl(g_timedoutCache);
-	bool  inCache = g_timedoutCache.getRecord ( (collnum_t)0 ,
-							k       , // key
-							&rec    ,
+	bool  inCache = g_timedoutCache.peekRecord ( (collnum_t)0 ,
+							(const char *)&k, // key
+							rec     ,
+							sizeof(rec),
 							&recSize,
-							false   ,//do copy?
 							maxAge  ,
 							true    );//inc cnt
 	return inCache;
@@ -2293,17 +2292,16 @@ bool Dns::isInCache ( key96_t key , int32_t *ip ) {
 	// . the callback, gotIp(), can be NULL if we're just updating times
 	// . TODO: ensure list owns the data
 	// if not found, return false;
-	char *rec;
+	char rec[4];
 	int32_t  recSize;
 	// return false if not in cache
-	RdbCacheLock rcl(m_rdbCache);
-	if ( ! m_rdbCache.getRecord ( (collnum_t)0 ,
-				      key      , 
-				      &rec     ,
-				      &recSize ,
-				      false    ,  // do copy?
-				      maxAge   ,
-				      true     )) // inc count?
+	if ( ! m_rdbCache.peekRecord ( (collnum_t)0 ,
+				       (const char *)&key ,
+				       rec      ,
+				       sizeof(rec) ,
+				       &recSize ,
+				       maxAge   ,
+				       true     )) // inc count?
 		return false;
 	// recSize must be 4 -- sanity check
 	if ( recSize != 4 ) {
@@ -2342,7 +2340,7 @@ void Dns::addToCache ( key96_t hostnameKey , int32_t ip , int32_t ttl ) {
 		c = &m_rdbCache;
 
  	// just add a record to the cache
-	RdbCacheLock rcl(*c);
+	RdbCacheLock rcl(*c, (const char *)&hostnameKey);
 	c->addRecord((collnum_t)0,hostnameKey,(char *)&ip,4,
 		     timestamp);//rec size
 	// reset g_errno in case it had an error (we don't care)
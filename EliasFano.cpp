@@ -0,0 +1,276 @@
+#include "EliasFano.h"
+#include "Sanity.h"
+
+
+EliasFano::EliasFano()
+	: m_count(0)
+	, m_numAppended(0)
+	, m_maxValue(0)
+	, m_lastValue(0)
+	, m_lowBits(0)
+	, m_payloadBits(0)
+	, m_upperBits(0)
+	, m_lower()
+	, m_upper()
+	, m_payload()
+	, m_select1Samples()
+	, m_select0Samples() {
+}
+
+
+void EliasFano::init(uint64_t count, uint64_t maxValue, unsigned payloadBits) {
+	if (payloadBits > 64) {
+		gbshutdownLogicError();
+	}
+
+	m_count = count;
+	m_numAppended = 0;
+	m_maxValue = maxValue;
+	m_lastValue = 0;
+	m_payloadBits = payloadBits;
+
+	// lowBits = floor(log2(maxValue/count)). This keeps the upper bitvector
+	// at no more than ~2 bits per element
+	m_lowBits = 0;
+	if (count > 0 && maxValue / count > 1) {
+		m_lowBits = 63 - __builtin_clzll(maxValue / count);
+	}
+
+	m_upperBits = count > 0 ? count + (maxValue >> m_lowBits) + 1 : 0;
+
+	// one extra word so readBits() can always look at the next word
+	m_lower.assign((count * m_lowBits + 63) / 64 + 1, 0);
+	m_upper.assign((m_upperBits + 63) / 64 + 1, 0);
+	m_payload.assign((count * m_payloadBits + 63) / 64 + 1, 0);
+
+	m_select1Samples.clear();
+	m_select0Samples.clear();
+}
+
+
+void EliasFano::append(uint64_t value, uint64_t payload) {
+	if (m_numAppended >= m_count || value > m_maxValue || (m_numAppended > 0 && value < m_lastValue)) {
+		gbshutdownLogicError();
+	}
+
+	uint64_t i = m_numAppended;
+	uint64_t pos = (value >> m_lowBits) + i;
+	m_upper[pos / 64] |= 1ULL << (pos % 64);
+
+	writeBits(&m_lower, i * m_lowBits, m_lowBits, value);
+	writeBits(&m_payload, i * m_payloadBits, m_payloadBits, payload);
+
+	m_lastValue = value;
+	m_numAppended++;
+}
+
+
+void EliasFano::finalize() {
+	if (m_numAppended != m_count) {
+		gbshutdownLogicError();
+	}
+
+	m_select1Samples.clear();
+	m_select0Samples.clear();
+	m_select1Samples.reserve(m_count / s_sampleInterval + 1);
+	m_select0Samples.reserve((m_upperBits - m_count) / s_sampleInterval + 1);
+
+	uint64_t numOnes = 0;
+	uint64_t numZeros = 0;
+	for (uint64_t pos = 0; pos < m_upperBits; pos++) {
+		if ((m_upper[pos / 64] >> (pos % 64)) & 1) {
+			if (numOnes % s_sampleInterval == 0) {
+				m_select1Samples.push_back(pos);
+			}
+			numOnes++;
+		} else {
+			if (numZeros % s_sampleInterval == 0) {
+				m_select0Samples.push_back(pos);
+			}
+			numZeros++;
+		}
+	}
+
+	m_select1Samples.shrink_to_fit();
+	m_select0Samples.shrink_to_fit();
+}
+
+
+void EliasFano::set(const std::vector<uint64_t> &values) {
+	init(values.size(), values.empty() ? 0 : values.back());
+	for (auto value : values) {
+		append(value);
+	}
+	finalize();
+}
+
+
+uint64_t EliasFano::readBits(const std::vector<uint64_t> &v, uint64_t bitOffset, unsigned numBits) {
+	if (numBits == 0) {
+		return 0;
+	}
+
+	uint64_t w = bitOffset / 64;
+	unsigned s = bitOffset % 64;
+	uint64_t bits = v[w] >> s;
+	if (s + numBits > 64) {
+		bits |= v[w + 1] << (64 - s);
+	}
+
+	return numBits == 64 ? bits : (bits & ((1ULL << numBits) - 1));
+}
+
+
+void EliasFano::writeBits(std::vector<uint64_t> *v, uint64_t bitOffset, unsigned numBits, uint64_t bits) {
+	if (numBits == 0) {
+		return;
+	}
+
+	if (numBits < 64) {
+		bits &= (1ULL << numBits) - 1;
+	}
+
+	uint64_t w = bitOffset / 64;
+	unsigned s = bitOffset % 64;
+	(*v)[w] |= bits << s;
+	if (s + numBits > 64) {
+		(*v)[w + 1] |= bits >> (64 - s);
+	}
+}
+
+
+// position of the n'th set bit in word (n is 0-based and must be < popcount)
+static inline unsigned selectInWord(uint64_t word, unsigned n) {
+	for (unsigned i = 0; i < n; i++) {
+		word &= word - 1;
+	}
+	return __builtin_ctzll(word);
+}
+
+
+uint64_t EliasFano::select1(uint64_t i) const {
+	uint64_t pos = m_select1Samples[i / s_sampleInterval];
+	uint64_t remaining = i % s_sampleInterval;
+
+	uint64_t w = pos / 64;
+	uint64_t word = m_upper[w] & (~0ULL << (pos % 64));
+	for (;;) {
+		unsigned numOnes = __builtin_popcountll(word);
+		if (remaining < numOnes) {
+			return w * 64 + selectInWord(word, remaining);
+		}
+		remaining -= numOnes;
+		word = m_upper[++w];
+	}
+}
+
+
+uint64_t EliasFano::select0(uint64_t i) const {
+	uint64_t pos = m_select0Samples[i / s_sampleInterval];
+	uint64_t remaining = i % s_sampleInterval;
+
+	uint64_t w = pos / 64;
+	uint64_t word = ~m_upper[w] & (~0ULL << (pos % 64));
+	for (;;) {
+		unsigned numZeros = __builtin_popcountll(word);
+		if (remaining < numZeros) {
+			return w * 64 + selectInWord(word, remaining);
+		}
+		remaining -= numZeros;
+		word = ~m_upper[++w];
+	}
+}
+
+
+uint64_t EliasFano::get(size_t i) const {
+	uint64_t high = select1(i) - i;
+	return (high << m_lowBits) | getLow(i);
+}
+
+
+size_t EliasFano::lowerBound(uint64_t value, uint64_t *foundValue) const {
+	if (m_count == 0 || value > m_lastValue) {
+		return m_count;
+	}
+
+	uint64_t high = value >> m_lowBits;
+	uint64_t low = m_lowBits ? (value & ((1ULL << m_lowBits) - 1)) : 0;
+
+	// skip all elements in lower buckets. bucket h is terminated by zero #h
+	uint64_t i = 0;
+	uint64_t pos = 0;
+	if (high > 0) {
+		pos = select0(high - 1);
+		i = pos - (high - 1);
+		pos++;
+	}
+
+	// scan the elements in our bucket
+	for (; i < m_count; i++, pos++) {
+		if (((m_upper[pos / 64] >> (pos % 64)) & 1) == 0) {
+			// end of bucket. next element is in a higher bucket
+			if (foundValue) {
+				*foundValue = get(i);
+			}
+			return i;
+		}
+
+		uint64_t elementLow = getLow(i);
+		if (elementLow >= low) {
+			if (foundValue) {
+				*foundValue = (high << m_lowBits) | elementLow;
+			}
+			return i;
+		}
+	}
+
+	// not reached because value <= m_lastValue
+	return m_count;
+}
+
+
+void EliasFano::decode(std::vector<uint64_t> *values) const {
+	values->clear();
+	values->reserve(m_count);
+
+	uint64_t i = 0;
+	for (uint64_t w = 0; i < m_count; w++) {
+		uint64_t word = m_upper[w];
+		while (word && i < m_count) {
+			uint64_t pos = w * 64 + __builtin_ctzll(word);
+			values->push_back(((pos - i) << m_lowBits) | getLow(i));
+			i++;
+			word &= word - 1;
+		}
+	}
+}
+
+
+EliasFano::Iterator::Iterator(const EliasFano *ef)
+  : m_ef(ef),
+    m_i(0),
+    m_w(0),
+    m_word((ef && !ef->m_upper.empty()) ? ef->m_upper[0] : 0)
+{
+}
+
+
+bool EliasFano::Iterator::next(uint64_t *value, uint64_t *payload) {
+	if (!m_ef || m_i >= m_ef->m_count)
+		return false;
+	while (!m_word)
+		m_word = m_ef->m_upper[++m_w];
+	uint64_t pos = m_w * 64 + __builtin_ctzll(m_word);
+	*value = ((pos - m_i) << m_ef->m_lowBits) | m_ef->getLow(m_i);
+	if (payload)
+		*payload = m_ef->getPayload(m_i);
+	m_word &= m_word - 1;
+	m_i++;
+	return true;
+}
+
+
+size_t EliasFano::getMemUsed() const {
+	return (m_lower.capacity() + m_upper.capacity() + m_payload.capacity() +
+	        m_select1Samples.capacity() + m_select0Samples.capacity()) * sizeof(uint64_t);
+}
@@ -0,0 +1,101 @@
+#ifndef GB_ELIASFANO_H
+#define GB_ELIASFANO_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+
+//Elias-Fano encoding of a non-decreasing sequence of 64-bit values, with an
+//optional fixed-width value ("payload") stored next to each element.
+//
+//Each element is split into its lower m_lowBits bits, which are stored as-is
+//in a packed array, and the remaining upper bits which are stored in unary
+//in a bitvector. This takes roughly 2+log2(maxValue/count) bits per element,
+//eg. ~20 bits for the docids of a posdb index file instead of 64.
+//
+//Random access (get) and successor search (lowerBound) use sampled select
+//positions in the upper bitvector, so they only look at a few words.
+//
+//Built once with init()+append()+finalize() (or set()), read-only after that
+//and safe to use from multiple threads.
+class EliasFano {
+public:
+	EliasFano();
+
+	// . prepare for 'count' values no larger than 'maxValue'
+	// . payloadBits can be 0 (no payload) through 64
+	void init(uint64_t count, uint64_t maxValue, unsigned payloadBits = 0);
+
+	// values must be appended in non-decreasing order
+	void append(uint64_t value, uint64_t payload = 0);
+
+	// build the select samples. must be called after the last append
+	void finalize();
+
+	// convenience: init+append+finalize from a sorted vector
+	void set(const std::vector<uint64_t> &values);
+
+	size_t size() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+
+	uint64_t get(size_t i) const;
+	uint64_t getPayload(size_t i) const {
+		return readBits(m_payload, i * m_payloadBits, m_payloadBits);
+	}
+
+	// . index of the first element >= value, or size() if there is none
+	// . if there is one and foundValue is not NULL then it is stored there
+	size_t lowerBound(uint64_t value, uint64_t *foundValue = NULL) const;
+
+	// decode all elements (not payloads) into 'values'
+	void decode(std::vector<uint64_t> *values) const;
+
+	// sequential access to the elements and payloads, a few instructions per
+	// element and no copy of the sequence. ef can be NULL (no elements)
+	class Iterator {
+	public:
+		explicit Iterator(const EliasFano *ef);
+		// returns false when there are no more elements
+		bool next(uint64_t *value, uint64_t *payload = NULL);
+	private:
+		const EliasFano *m_ef;
+		uint64_t m_i;    //next element
+		uint64_t m_w;    //current word of m_upper
+		uint64_t m_word; //its ones not visited yet
+	};
+
+	// heap memory used
+	size_t getMemUsed() const;
+
+private:
+	static const unsigned s_sampleInterval = 256;
+
+	static uint64_t readBits(const std::vector<uint64_t> &v, uint64_t bitOffset, unsigned numBits);
+	static void writeBits(std::vector<uint64_t> *v, uint64_t bitOffset, unsigned numBits, uint64_t bits);
+
+	uint64_t getLow(size_t i) const {
+		return readBits(m_lower, i * m_lowBits, m_lowBits);
+	}
+
+	// position in m_upper of the i'th one/zero bit
+	uint64_t select1(uint64_t i) const;
+	uint64_t select0(uint64_t i) const;
+
+	uint64_t m_count;
+	uint64_t m_numAppended;
+	uint64_t m_maxValue;
+	uint64_t m_lastValue;
+	unsigned m_lowBits;
+	unsigned m_payloadBits;
+	uint64_t m_upperBits; //number of bits used in m_upper
+
+	std::vector<uint64_t> m_lower;   //packed lower bits
+	std::vector<uint64_t> m_upper;   //unary coded upper bits
+	std::vector<uint64_t> m_payload; //packed payloads
+
+	std::vector<uint64_t> m_select1Samples; //position of every s_sampleInterval'th one
+	std::vector<uint64_t> m_select0Samples; //position of every s_sampleInterval'th zero
+};
+
+#endif //GB_ELIASFANO_H
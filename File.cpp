@@ -31,6 +31,10 @@ static File   *s_filePtrs   [ MAX_NUM_FDS ];
 //   a lot of robots.txt lookups! let's set this down from 800 to 500
 static const int s_maxNumOpenFiles = 500;
 static int       s_numOpenFiles    = 0;
+// . highest fd we ever opened a file with
+// . MAX_NUM_FDS is sized for the sockets of the Loop, so the scans of the
+//   fd pool stop here instead
+static int       s_maxOpenedFd     = -1;
 
 // . keep track of number of times an fd was closed
 // . so if we do a read on an fd, and it gets unlinked and a new file opened
@@ -56,7 +60,7 @@ static void sanityCheck ( ) {
 		return;
 	}
 	int32_t openCount = 0;
-	for ( int i = 0 ; i < MAX_NUM_FDS ; i++ )
+	for ( int i = 0 ; i <= s_maxOpenedFd ; i++ )
 		if ( s_open[i] ) openCount++;
 	if ( openCount != s_numOpenFiles ) gbshutdownCorrupted();
 }
@@ -701,6 +705,7 @@ int File::getfd () {
 	s_unlinking [ fd ] = false;
 	s_timestamps[ fd ] = gettimeofdayInMilliseconds();
 	s_open      [ fd ] = true;
+	if ( fd > s_maxOpenedFd ) s_maxOpenedFd = fd;
 	s_filePtrs  [ fd ] = this;
 
 	if ( g_conf.m_logDebugDisk ) {
@@ -727,7 +732,7 @@ bool File::closeLeastUsed () {
 	// get the least used of all the actively opened file descriptors.
 	// we can't get files that were opened for writing!!!
 	int i;
-	for ( i = 0 ; i < MAX_NUM_FDS ; i++ ) {
+	for ( i = 0 ; i <= s_maxOpenedFd ; i++ ) {
 		//if ( s_fds   [ i ] < 0        ) continue;
 		if ( ! s_open[i] ) { notopen++; continue; }
 		// fds opened for writing are not candidates, because if
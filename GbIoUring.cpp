@@ -0,0 +1,410 @@
+#include "GbIoUring.h"
+#include "Loop.h"
+#include "Log.h"
+#include "Conf.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+
+GbIoUring g_ioUring;
+
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+//user_data encoding: op index shifted left one bit, lowest bit set for the
+//data-transferring sqe of a chain (the others are fsync/fadvise/etc.)
+static uint64_t makeUserData(uint32_t opIndex, bool isDataSqe) {
+	return ((uint64_t)opIndex << 1) | (isDataSqe ? 1 : 0);
+}
+
+//user_data of the IORING_OP_ASYNC_CANCEL sqes queued by cancelAll()
+static const uint64_t s_cancelUserData = ~(uint64_t)0;
+
+
+GbIoUring::GbIoUring()
+  : m_ringFd(-1),
+    m_eventFd(-1),
+    m_sqRingPtr(NULL), m_sqRingSize(0),
+    m_cqRingPtr(NULL), m_cqRingSize(0),
+    m_sqes(NULL), m_sqesSize(0),
+    m_sqHead(NULL), m_sqTail(NULL), m_sqMask(NULL), m_sqArray(NULL), m_sqEntries(0),
+    m_cqHead(NULL), m_cqTail(NULL), m_cqMask(NULL), m_cqes(NULL), m_cqEntries(0),
+    m_numQueued(0),
+    m_numSqesInFlight(0),
+    m_numOpsInFlight(0),
+    m_ops(),
+    m_freeOps(),
+    m_cancelling(false),
+    m_retryCallback(NULL),
+    m_numSubmitCalls(0),
+    m_numSubmittedSqes(0)
+{
+}
+
+
+GbIoUring::~GbIoUring() {
+	finalize();
+}
+
+
+bool GbIoUring::initialize(unsigned queueDepth) {
+	if(isInitialized())
+		return true;
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = sys_io_uring_setup(queueDepth, &p);
+	if(fd < 0) {
+		log(LOG_WARN, "disk: io_uring_setup(%u) failed: %s", queueDepth, strerror(errno));
+		return false;
+	}
+
+	size_t sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	size_t cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	bool singleMmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if(singleMmap) {
+		if(cqRingSize > sqRingSize)
+			sqRingSize = cqRingSize;
+		cqRingSize = sqRingSize;
+	}
+
+	void *sqRingPtr = mmap(NULL, sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(sqRingPtr == MAP_FAILED) {
+		log(LOG_WARN, "disk: mmap of io_uring sq ring failed: %s", strerror(errno));
+		::close(fd);
+		return false;
+	}
+	void *cqRingPtr = sqRingPtr;
+	if(!singleMmap) {
+		cqRingPtr = mmap(NULL, cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if(cqRingPtr == MAP_FAILED) {
+			log(LOG_WARN, "disk: mmap of io_uring cq ring failed: %s", strerror(errno));
+			munmap(sqRingPtr, sqRingSize);
+			::close(fd);
+			return false;
+		}
+	}
+	size_t sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+	void *sqes = mmap(NULL, sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(sqes == MAP_FAILED) {
+		log(LOG_WARN, "disk: mmap of io_uring sqes failed: %s", strerror(errno));
+		if(!singleMmap)
+			munmap(cqRingPtr, cqRingSize);
+		munmap(sqRingPtr, sqRingSize);
+		::close(fd);
+		return false;
+	}
+
+	int efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	if(efd < 0 || sys_io_uring_register(fd, IORING_REGISTER_EVENTFD, &efd, 1) != 0) {
+		log(LOG_WARN, "disk: could not set up io_uring eventfd: %s", strerror(errno));
+		if(efd >= 0)
+			::close(efd);
+		munmap(sqes, sqesSize);
+		if(!singleMmap)
+			munmap(cqRingPtr, cqRingSize);
+		munmap(sqRingPtr, sqRingSize);
+		::close(fd);
+		return false;
+	}
+
+	m_ringFd = fd;
+	m_eventFd = efd;
+	m_sqRingPtr = sqRingPtr;
+	m_sqRingSize = sqRingSize;
+	m_cqRingPtr = singleMmap ? NULL : cqRingPtr;
+	m_cqRingSize = singleMmap ? 0 : cqRingSize;
+	m_sqes = (struct io_uring_sqe*)sqes;
+	m_sqesSize = sqesSize;
+
+	char *sq = (char*)sqRingPtr;
+	m_sqHead  = (unsigned*)(sq + p.sq_off.head);
+	m_sqTail  = (unsigned*)(sq + p.sq_off.tail);
+	m_sqMask  = (unsigned*)(sq + p.sq_off.ring_mask);
+	m_sqArray = (unsigned*)(sq + p.sq_off.array);
+	m_sqEntries = p.sq_entries;
+	char *cq = (char*)cqRingPtr;
+	m_cqHead  = (unsigned*)(cq + p.cq_off.head);
+	m_cqTail  = (unsigned*)(cq + p.cq_off.tail);
+	m_cqMask  = (unsigned*)(cq + p.cq_off.ring_mask);
+	m_cqes    = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+	m_cqEntries = p.cq_entries;
+
+	m_numQueued = 0;
+	m_numSqesInFlight = 0;
+	m_numOpsInFlight = 0;
+	m_ops.resize(m_cqEntries);
+	m_freeOps.clear();
+	for(uint32_t i = m_cqEntries; i > 0; i--)
+		m_freeOps.push_back(i-1);
+
+	log(LOG_INFO, "disk: io_uring initialized with %u sq entries and %u cq entries", m_sqEntries, m_cqEntries);
+	return true;
+}
+
+
+void GbIoUring::finalize() {
+	if(!isInitialized())
+		return;
+	//the owners of the outstanding operations may already be gone, so cancel
+	//them and don't call the callbacks. We still have to wait for them as the
+	//kernel may be writing into the callers' buffers.
+	m_cancelling = true;
+	cancelAll();
+	submit();
+	while(m_numOpsInFlight > 0)
+		processCompletions(true);
+	m_cancelling = false;
+
+	munmap(m_sqes, m_sqesSize);
+	if(m_cqRingPtr)
+		munmap(m_cqRingPtr, m_cqRingSize);
+	munmap(m_sqRingPtr, m_sqRingSize);
+	::close(m_eventFd);
+	::close(m_ringFd);
+	m_ringFd = -1;
+	m_eventFd = -1;
+	m_sqRingPtr = NULL;
+	m_cqRingPtr = NULL;
+	m_sqes = NULL;
+	m_ops.clear();
+	m_freeOps.clear();
+}
+
+
+bool GbIoUring::registerLoopCallback() {
+	if(!isInitialized())
+		return false;
+	return g_loop.registerReadCallback(m_eventFd, this, eventFdCallback, "GbIoUring::eventFdCallback", 0);
+}
+
+
+void GbIoUring::eventFdCallback(int fd, void *state) {
+	GbIoUring *that = static_cast<GbIoUring*>(state);
+	uint64_t dummy;
+	ssize_t ignored __attribute__((unused)) = ::read(fd, &dummy, sizeof(dummy));
+	that->processCompletions(false);
+}
+
+
+struct io_uring_sqe *GbIoUring::getSqe() {
+	unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	unsigned tail = *m_sqTail;
+	if(tail - head >= m_sqEntries)
+		return NULL;
+	unsigned idx = tail & *m_sqMask;
+	struct io_uring_sqe *sqe = &m_sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	m_sqArray[idx] = idx;
+	__atomic_store_n(m_sqTail, tail+1, __ATOMIC_RELEASE);
+	m_numQueued++;
+	m_numSqesInFlight++;
+	return sqe;
+}
+
+
+bool GbIoUring::queueChain(int opcode, int fd, void *buf, uint32_t len, int64_t offset, unsigned flags, void *state, callback_t callback) {
+	if(!isInitialized())
+		return false;
+
+	unsigned numSqes = 1;
+	if(flags & flag_datasync)
+		numSqes++;
+	if(flags & flag_drop_cache)
+		numSqes += 2;
+
+	//never let more sqes be outstanding than the completion ring can hold
+	if(m_numSqesInFlight + numSqes > m_cqEntries || m_freeOps.empty())
+		return false;
+	unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	if(m_sqEntries - (*m_sqTail - head) < numSqes) {
+		//submission ring full. Flush and check again
+		submit();
+		head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+		if(m_sqEntries - (*m_sqTail - head) < numSqes)
+			return false;
+	}
+
+	uint32_t opIndex = m_freeOps.back();
+	m_freeOps.pop_back();
+	Op &op = m_ops[opIndex];
+	op.m_state = state;
+	op.m_callback = callback;
+	op.m_result = -ECANCELED;
+	op.m_pendingCqes = numSqes;
+	m_numOpsInFlight++;
+
+	struct io_uring_sqe *sqe = getSqe();
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = makeUserData(opIndex, true);
+	if(numSqes > 1)
+		sqe->flags |= IOSQE_IO_LINK;
+	numSqes--;
+
+	if(flags & flag_datasync) {
+		sqe = getSqe();
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = fd;
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+		sqe->user_data = makeUserData(opIndex, false);
+		if(--numSqes > 0)
+			sqe->flags |= IOSQE_IO_LINK;
+	}
+
+	if(flags & flag_drop_cache) {
+		//dirty pages cannot be dropped so write them back first
+		sqe = getSqe();
+		sqe->opcode = IORING_OP_SYNC_FILE_RANGE;
+		sqe->fd = fd;
+		sqe->off = offset;
+		sqe->len = len;
+		sqe->sync_range_flags = SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+		sqe->user_data = makeUserData(opIndex, false);
+		sqe->flags |= IOSQE_IO_LINK;
+		sqe = getSqe();
+		sqe->opcode = IORING_OP_FADVISE;
+		sqe->fd = fd;
+		sqe->off = offset;
+		sqe->len = len;
+		sqe->fadvise_advice = POSIX_FADV_DONTNEED;
+		sqe->user_data = makeUserData(opIndex, false);
+	}
+
+	if(m_numQueued >= m_sqEntries/2)
+		submit();
+	return true;
+}
+
+
+//ask the kernel to cancel every operation in flight. Ones that already
+//started complete normally, the others with -ECANCELED (the rest of their
+//chain too)
+void GbIoUring::cancelAll() {
+	if(m_numOpsInFlight > 0)
+		log(LOG_INFO, "disk: cancelling %u io_uring operations", m_numOpsInFlight);
+	for(uint32_t i = 0; i < m_ops.size(); i++) {
+		if(m_ops[i].m_pendingCqes == 0)
+			continue;
+		//the cancel completions need room in the completion ring too.
+		//what doesn't fit is just waited for
+		if(m_numSqesInFlight >= m_cqEntries)
+			break;
+		unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+		if(*m_sqTail - head >= m_sqEntries) {
+			submit();
+			head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+			if(*m_sqTail - head >= m_sqEntries)
+				break;
+		}
+		struct io_uring_sqe *sqe = getSqe();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = makeUserData(i, true);
+		sqe->user_data = s_cancelUserData;
+	}
+}
+
+
+bool GbIoUring::read(int fd, void *buf, uint32_t len, int64_t offset, void *state, callback_t callback) {
+	return queueChain(IORING_OP_READ, fd, buf, len, offset, 0, state, callback);
+}
+
+
+bool GbIoUring::write(int fd, const void *buf, uint32_t len, int64_t offset, unsigned flags, void *state, callback_t callback) {
+	return queueChain(IORING_OP_WRITE, fd, const_cast<void*>(buf), len, offset, flags, state, callback);
+}
+
+
+void GbIoUring::submit() {
+	while(m_numQueued > 0) {
+		int rc = sys_io_uring_enter(m_ringFd, m_numQueued, 0, 0);
+		if(rc < 0) {
+			if(errno == EINTR)
+				continue;
+			//EAGAIN/EBUSY: the kernel is short on resources. Try again next time around.
+			if(errno != EAGAIN && errno != EBUSY)
+				log(LOG_ERROR, "disk: io_uring_enter failed: %s", strerror(errno));
+			return;
+		}
+		m_numSubmitCalls++;
+		m_numSubmittedSqes += rc;
+		m_numQueued -= rc;
+		if(rc == 0)
+			return;
+	}
+	logDebug(g_conf.m_logDebugDisk, "disk: io_uring submitted. %u ops in flight", m_numOpsInFlight);
+}
+
+
+void GbIoUring::processCompletions(bool wait) {
+	if(!isInitialized())
+		return;
+	if(wait && m_numOpsInFlight > 0 &&
+	   __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) == *m_cqHead) {
+		int rc = sys_io_uring_enter(m_ringFd, m_numQueued, 1, IORING_ENTER_GETEVENTS);
+		if(rc > 0) {
+			m_numSubmitCalls++;
+			m_numSubmittedSqes += rc;
+			m_numQueued -= rc;
+		}
+	}
+
+	//first collect the finished ops and advance the cq head, then call the
+	//callbacks. Callbacks are allowed to queue new operations.
+	std::vector<uint32_t> finishedOps;
+	unsigned head = *m_cqHead;
+	unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+	while(head != tail) {
+		const struct io_uring_cqe *cqe = &m_cqes[head & *m_cqMask];
+		if(cqe->user_data == s_cancelUserData) {
+			//-ENOENT/-EALREADY just mean it was too late to cancel
+			m_numSqesInFlight--;
+			head++;
+			continue;
+		}
+		uint32_t opIndex = (uint32_t)(cqe->user_data >> 1);
+		bool isDataSqe = (cqe->user_data & 1) != 0;
+		Op &op = m_ops[opIndex];
+		if(isDataSqe)
+			op.m_result = cqe->res;
+		else if(cqe->res < 0 && cqe->res != -ECANCELED)
+			log(LOG_WARN, "disk: io_uring sync/fadvise failed: %s", strerror(-cqe->res));
+		m_numSqesInFlight--;
+		if(--op.m_pendingCqes == 0)
+			finishedOps.push_back(opIndex);
+		head++;
+	}
+	__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+	for(auto opIndex : finishedOps) {
+		Op op = m_ops[opIndex];
+		m_freeOps.push_back(opIndex);
+		m_numOpsInFlight--;
+		if(!m_cancelling)
+			op.m_callback(op.m_state, op.m_result);
+	}
+
+	if(m_retryCallback && !m_cancelling && !finishedOps.empty())
+		m_retryCallback();
+}
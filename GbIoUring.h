@@ -0,0 +1,116 @@
+#ifndef GB_GBIOURING_H
+#define GB_GBIOURING_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+
+//A minimal io_uring wrapper used by BigFile as an alternative to doing
+//pread()/pwrite() in the I/O thread pool. Requests are queued into the
+//submission ring and handed to the kernel in one io_uring_enter() per loop
+//iteration (see submit()). Completions are signalled through an eventfd that
+//is registered with g_loop, so the callbacks are called in the main thread.
+//
+//Everything here must be called from the main thread only.
+//
+//finalize() asks the kernel to cancel what is still in flight and waits for
+//it without calling the callbacks, as their owners are gone by then.
+class GbIoUring {
+	GbIoUring(const GbIoUring&);
+	GbIoUring& operator=(const GbIoUring&);
+public:
+	//result is the number of bytes transferred, or -errno
+	typedef void (*callback_t)(void *state, int32_t result);
+
+	enum {
+		flag_datasync   = 0x01, //fdatasync() the file after the write
+		flag_drop_cache = 0x02, //write back and drop the written range from the page cache
+	};
+
+	GbIoUring();
+	~GbIoUring();
+
+	bool initialize(unsigned queueDepth);
+	void finalize();
+	bool isInitialized() const { return m_ringFd >= 0; }
+
+	//register the completion eventfd with g_loop
+	bool registerLoopCallback();
+
+	//called after completions have been processed, so a user that could not
+	//queue an operation because the ring was full can try again
+	void setRetryCallback(void (*callback)()) { m_retryCallback = callback; }
+
+	//queue an operation. Returns false if the ring cannot take it right
+	//now (full, not initialized) in which case the caller must use
+	//another way to do the i/o. The callback is called exactly once.
+	bool read(int fd, void *buf, uint32_t len, int64_t offset, void *state, callback_t callback);
+	bool write(int fd, const void *buf, uint32_t len, int64_t offset, unsigned flags, void *state, callback_t callback);
+
+	//hand queued operations over to the kernel
+	void submit();
+
+	//reap completed operations and call their callbacks. If wait is true
+	//then block until at least one operation has completed.
+	void processCompletions(bool wait);
+
+	unsigned getNumInFlight() const { return m_numOpsInFlight; }
+
+	//statistics
+	uint64_t getNumSubmitCalls() const { return m_numSubmitCalls; }
+	uint64_t getNumSubmittedSqes() const { return m_numSubmittedSqes; }
+
+private:
+	struct Op {
+		void      *m_state;
+		callback_t m_callback;
+		int32_t    m_result;
+		unsigned   m_pendingCqes;
+	};
+
+	bool queueChain(int opcode, int fd, void *buf, uint32_t len, int64_t offset, unsigned flags, void *state, callback_t callback);
+	struct io_uring_sqe *getSqe();
+	void cancelAll();
+
+	static void eventFdCallback(int fd, void *state);
+
+	int m_ringFd;
+	int m_eventFd;
+
+	//mmap'ed ring areas
+	void    *m_sqRingPtr;
+	size_t   m_sqRingSize;
+	void    *m_cqRingPtr;
+	size_t   m_cqRingSize;
+	struct io_uring_sqe *m_sqes;
+	size_t   m_sqesSize;
+
+	unsigned *m_sqHead;
+	unsigned *m_sqTail;
+	unsigned *m_sqMask;
+	unsigned *m_sqArray;
+	unsigned  m_sqEntries;
+	unsigned *m_cqHead;
+	unsigned *m_cqTail;
+	unsigned *m_cqMask;
+	struct io_uring_cqe *m_cqes;
+	unsigned  m_cqEntries;
+
+	unsigned m_numQueued;          //sqes queued but not yet submitted
+	unsigned m_numSqesInFlight;    //sqes submitted/queued but not completed (must not exceed m_cqEntries)
+	unsigned m_numOpsInFlight;
+
+	std::vector<Op> m_ops;
+	std::vector<uint32_t> m_freeOps;
+
+	bool m_cancelling;             //finalize() in progress, callbacks are not called
+	void (*m_retryCallback)();
+
+	uint64_t m_numSubmitCalls;
+	uint64_t m_numSubmittedSqes;
+};
+
+extern GbIoUring g_ioUring;
+
+#endif //GB_GBIOURING_H
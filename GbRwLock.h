@@ -0,0 +1,88 @@
+#ifndef GB_RWLOCK_H_
+#define GB_RWLOCK_H_
+
+#include <pthread.h>
+#include <assert.h>
+
+//reader/writer lock. Many readers or one writer.
+class GbRwLock {
+	GbRwLock(const GbRwLock&);
+	GbRwLock& operator=(const GbRwLock&);
+public:
+	pthread_rwlock_t rwlock;
+
+	GbRwLock() {
+		pthread_rwlockattr_t attr;
+		pthread_rwlockattr_init(&attr);
+		//don't let a steady stream of readers starve a writer (clear/dump/save)
+		pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+		pthread_rwlock_init(&rwlock, &attr);
+		pthread_rwlockattr_destroy(&attr);
+	}
+	~GbRwLock() {
+		pthread_rwlock_destroy(&rwlock);
+	}
+
+	void readLock() {
+		int rc = pthread_rwlock_rdlock(&rwlock);
+		assert(rc==0);
+	}
+	void writeLock() {
+		int rc = pthread_rwlock_wrlock(&rwlock);
+		assert(rc==0);
+	}
+	void unlock() {
+		int rc = pthread_rwlock_unlock(&rwlock);
+		assert(rc==0);
+	}
+};
+
+
+//scoped shared lock
+class ScopedReadLock {
+	GbRwLock &lock;
+	bool locked;
+	ScopedReadLock(const ScopedReadLock&);
+	ScopedReadLock& operator=(const ScopedReadLock&);
+public:
+	ScopedReadLock(GbRwLock &lock_)
+	  : lock(lock_), locked(true)
+	{
+		lock.readLock();
+	}
+	~ScopedReadLock() {
+		if(locked)
+			lock.unlock();
+	}
+	void unlock() {
+		assert(locked);
+		lock.unlock();
+		locked = false;
+	}
+};
+
+
+//scoped exclusive lock
+class ScopedWriteLock {
+	GbRwLock &lock;
+	bool locked;
+	ScopedWriteLock(const ScopedWriteLock&);
+	ScopedWriteLock& operator=(const ScopedWriteLock&);
+public:
+	ScopedWriteLock(GbRwLock &lock_)
+	  : lock(lock_), locked(true)
+	{
+		lock.writeLock();
+	}
+	~ScopedWriteLock() {
+		if(locked)
+			lock.unlock();
+	}
+	void unlock() {
+		assert(locked);
+		lock.unlock();
+		locked = false;
+	}
+};
+
+#endif //GB_RWLOCK_H_
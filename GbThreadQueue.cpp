@@ -2,6 +2,7 @@
 #include "ScopedLock.h"
 #include <stdexcept>
 #include "Log.h"
+#include <vector>
 
 void* GbThreadQueue::thread_queue_function(void *args) {
 	GbThreadQueue *tq = static_cast<GbThreadQueue*>(args);
@@ -21,6 +22,25 @@ void* GbThreadQueue::thread_queue_function(void *args) {
 			continue;
 		}
 
+		if (tq->m_batchFunc) {
+			// . take everything that queued up while we were busy
+			// . items stay in the queue until processed so isEmpty() is
+			//   only true when we are idle
+			std::vector<void*> items;
+			for (size_t i = 0; i < tq->m_queue.size() && i < tq->m_maxBatchSize; ++i) {
+				items.push_back(tq->m_queue[i]);
+			}
+			sl.unlock();
+
+			tq->m_batchFunc(&items[0], items.size());
+
+			ScopedLock sl2(tq->m_queueMtx);
+			for (size_t i = 0; i < items.size(); ++i) {
+				tq->m_queue.pop_front();
+			}
+			continue;
+		}
+
 		void *item = tq->m_queue.front();
 		sl.unlock();
 
@@ -28,7 +48,7 @@ void* GbThreadQueue::thread_queue_function(void *args) {
 		tq->m_func(item);
 
 		ScopedLock sl2(tq->m_queueMtx);
-		tq->m_queue.pop();
+		tq->m_queue.pop_front();
 
 		/// @todo ALC configurable delay here?
 	}
@@ -42,6 +62,8 @@ GbThreadQueue::GbThreadQueue()
 	, m_queueCondNotEmpty(PTHREAD_COND_INITIALIZER)
 	, m_thread()
 	, m_func()
+	, m_batchFunc()
+	, m_maxBatchSize(1)
 	, m_stop(false)
 	, m_started(false) {
 }
@@ -52,6 +74,20 @@ GbThreadQueue::~GbThreadQueue() {
 
 bool GbThreadQueue::initialize(queue_func_t processFunc, const char *threadName) {
 	m_func = processFunc;
+	m_batchFunc = NULL;
+
+	return startThread(threadName);
+}
+
+bool GbThreadQueue::initialize(queue_batch_func_t processBatchFunc, size_t maxBatchSize, const char *threadName) {
+	m_func = NULL;
+	m_batchFunc = processBatchFunc;
+	m_maxBatchSize = maxBatchSize > 0 ? maxBatchSize : 1;
+
+	return startThread(threadName);
+}
+
+bool GbThreadQueue::startThread(const char *threadName) {
 
 	if (!m_started) {
 		m_stop = false;
@@ -84,7 +120,7 @@ void GbThreadQueue::finalize() {
 
 void GbThreadQueue::addItem(void *item) {
 	ScopedLock sl(m_queueMtx);
-	m_queue.push(item);
+	m_queue.push_back(item);
 	pthread_cond_signal(&m_queueCondNotEmpty);
 }
 
@@ -1,12 +1,15 @@
 #ifndef GB_GBTHREADQUEUE_H
 #define GB_GBTHREADQUEUE_H
 
-#include <queue>
+#include <deque>
+#include <stddef.h>
 #include <pthread.h>
 #include <atomic>
 
 
 typedef void (*queue_func_t)(void *item);
+// gets all the items queued up so far (up to the max batch size)
+typedef void (*queue_batch_func_t)(void **items, size_t numItems);
 
 class GbThreadQueue {
 public:
@@ -14,6 +17,7 @@ public:
 	~GbThreadQueue();
 
 	bool initialize(queue_func_t processFunc, const char *threadName);
+	bool initialize(queue_batch_func_t processBatchFunc, size_t maxBatchSize, const char *threadName);
 	void finalize();
 
 	// we are not responsible for cleaning up memory used by item
@@ -22,13 +26,16 @@ public:
 	bool isEmpty();
 private:
 	static void* thread_queue_function(void *args);
+	bool startThread(const char *threadName);
 
-	std::queue<void*> m_queue;
+	std::deque<void*> m_queue;
 	pthread_mutex_t m_queueMtx;
 	pthread_cond_t m_queueCondNotEmpty;
 
 	pthread_t m_thread;
 	queue_func_t m_func;
+	queue_batch_func_t m_batchFunc;
+	size_t m_maxBatchSize;
 	std::atomic<bool> m_stop;
 	bool m_started;
 };
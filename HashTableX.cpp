@@ -291,6 +291,13 @@ bool HashTableX::removeSlot ( int32_t n ) {
 }
 
 
+// bytes of the buf setTableSize() needs for "oldn" slots
+int32_t HashTableX::getBufSize ( int32_t ks , int32_t ds , int32_t oldn ) {
+	if ( oldn <= 0 ) return 0;
+	int64_t n = getHighestLitBitValueLL((uint64_t)oldn * 2LL -1);
+	return (ks+ds+1) * n;
+}
+
 // . set table size to "n" slots
 // . rehashes the termId/score pairs into new table
 // . returns false and sets errno on error
@@ -277,6 +277,10 @@ class HashTableX {
 
 	bool setTableSize ( int32_t numSlots , char *buf , int32_t bufSize );
 
+	// size of the buffer set() or setTableSize() need for "numSlots", so
+	// the caller can pass its own
+	static int32_t getBufSize ( int32_t keySize , int32_t dataSize , int32_t numSlots );
+
 	// for debugging
 	void print();
 
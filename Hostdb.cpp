@@ -1348,6 +1348,7 @@ bool Hostdb::replaceHost ( int32_t origHostId, int32_t spareHostId ) {
 	oldHost->m_dgramsFrom          = 0;
 	oldHost->m_totalResends        = 0;
 	oldHost->m_etryagains          = 0;
+	oldHost->m_udpCongestion.reset();
 	oldHost->m_repairMode          = 0;
 	oldHost->m_splitsDone          = 0;
 	oldHost->m_splitTimes          = 0;
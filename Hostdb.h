@@ -16,6 +16,7 @@
 #include "rdbid_t.h"
 #include "Sanity.h"
 #include "GbMutex.h"
+#include "UdpCongestion.h"
 #include <atomic>
 
 /// @note ALC there used to be a sync host functionality that was removed
@@ -143,6 +144,9 @@ public:
 	std::atomic<int32_t>     m_totalResends; //how many UDP packets has been resent
 	std::atomic<int32_t>     m_etryagains;   //how many times a request got an ETRYAGAIN
 
+	// rtt estimate and congestion window for UdpSlot sends to this host
+	UdpCongestion  m_udpCongestion;
+
 	char           m_repairMode;
 
 	// for timing how long the msg39 takes from this host
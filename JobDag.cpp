@@ -0,0 +1,308 @@
+#include "JobDag.h"
+#include "ScopedLock.h"
+#include "GbMutex.h"
+#include "Errno.h"
+#include "Log.h"
+#include "fctypes.h"
+#include <atomic>
+#include <map>
+
+
+namespace {
+
+struct Stage {
+	JobDagCore *m_core;
+	const char *m_name;
+	JobDag::stage_func_t m_func;
+	void *m_state;
+	uint32_t m_deps;            //bitmask of stage numbers
+	std::atomic<bool> m_claimed; //someone started running it
+	bool m_scheduled;           //submitted as a job (or kept by the caller)
+	bool m_done;
+	bool m_failed;
+	bool m_inJob;
+	int m_errno;                //0 if skipped
+	int64_t m_time;
+};
+
+}
+
+
+// . the state shared with the jobs
+// . jobs may still be queued when run() returns (the caller ran their stages
+//   itself) so this is reference counted and freed by whoever is last, the
+//   JobDag or the finish callback of a job
+class JobDagCore {
+	JobDagCore(const JobDagCore&);
+	JobDagCore& operator=(const JobDagCore&);
+public:
+	JobDagCore()
+		: m_numStages(0)
+		, m_refs(1) {
+		pthread_mutex_init(&m_mtx, NULL);
+		pthread_cond_init(&m_cond, NULL);
+	}
+
+	~JobDagCore() {
+		pthread_mutex_destroy(&m_mtx);
+		pthread_cond_destroy(&m_cond);
+	}
+
+	void ref() {
+		++m_refs;
+	}
+
+	void unref() {
+		if (--m_refs == 0) {
+			delete this;
+		}
+	}
+
+	void runStage(Stage *stage, bool inJob);
+
+	pthread_mutex_t m_mtx;
+	pthread_cond_t m_cond;
+	Stage m_stages[JobDag::MAX_STAGES];
+	int m_numStages;
+
+private:
+	std::atomic<int> m_refs;
+};
+
+
+static GbMutex s_statsMtx;
+static std::map<std::string, JobDagStageStats> s_stats;
+
+static void addStats(const std::string &name, int64_t time, bool inJob) {
+	ScopedLock sl(s_statsMtx);
+	JobDagStageStats &stats = s_stats[name];
+	if (stats.m_name.empty()) {
+		stats.m_name = name;
+		stats.m_count = 0;
+		stats.m_inJobCount = 0;
+		stats.m_totalTime = 0;
+		stats.m_maxTime = 0;
+	}
+	stats.m_count++;
+	if (inJob) {
+		stats.m_inJobCount++;
+	}
+	stats.m_totalTime += time;
+	if (time > stats.m_maxTime) {
+		stats.m_maxTime = time;
+	}
+}
+
+
+void JobDagCore::runStage(Stage *stage, bool inJob) {
+	uint64_t start = gettimeofdayInMicroseconds();
+
+	g_errno = 0;
+	bool status = stage->m_func(stage->m_state);
+	int err = 0;
+	if (!status) {
+		err = g_errno ? g_errno : EBADENGINEER;
+	}
+
+	uint64_t took = gettimeofdayInMicroseconds() - start;
+
+	ScopedLock sl(m_mtx);
+	stage->m_done = true;
+	stage->m_failed = !status;
+	stage->m_errno = err;
+	stage->m_time = took;
+	stage->m_inJob = inJob;
+	pthread_cond_signal(&m_cond);
+}
+
+
+static void runStageJob(void *state) {
+	Stage *stage = static_cast<Stage*>(state);
+	// the caller may have run it already while we were queued
+	if (stage->m_claimed.exchange(true)) {
+		return;
+	}
+	stage->m_core->runStage(stage, true);
+}
+
+static void stageJobDone(void *state, job_exit_t /*exit_type*/) {
+	Stage *stage = static_cast<Stage*>(state);
+	stage->m_core->unref();
+}
+
+
+JobDag::JobDag(const char *name)
+	: m_name(name)
+	, m_core(new JobDagCore())
+	, m_totalTime(0) {
+}
+
+JobDag::~JobDag() {
+	m_core->unref();
+}
+
+int JobDag::addStage(const char *name, stage_func_t func, void *state, const int *deps, int numDeps) {
+	if (m_core->m_numStages >= MAX_STAGES) {
+		log(LOG_LOGIC, "jobdag: %s: too many stages", m_name);
+		return -1;
+	}
+
+	int n = m_core->m_numStages;
+
+	uint32_t depMask = 0;
+	for (int i = 0; i < numDeps; i++) {
+		// only on earlier stages so the graph can't have cycles
+		if (deps[i] < 0 || deps[i] >= n) {
+			log(LOG_LOGIC, "jobdag: %s: bad dependency %d of stage %s", m_name, deps[i], name);
+			return -1;
+		}
+		depMask |= 1U << deps[i];
+	}
+
+	Stage &stage = m_core->m_stages[n];
+	stage.m_core = m_core;
+	stage.m_name = name;
+	stage.m_func = func;
+	stage.m_state = state;
+	stage.m_deps = depMask;
+	stage.m_claimed = false;
+	stage.m_scheduled = false;
+	stage.m_done = false;
+	stage.m_failed = false;
+	stage.m_inJob = false;
+	stage.m_errno = 0;
+	stage.m_time = -1;
+
+	m_core->m_numStages++;
+	return n;
+}
+
+bool JobDag::run(thread_type_t threadType, int niceness) {
+	uint64_t start = gettimeofdayInMicroseconds();
+
+	JobDagCore *core = m_core;
+	Stage *stages = core->m_stages;
+	int numStages = core->m_numStages;
+
+	pthread_mutex_lock(&core->m_mtx);
+
+	for (;;) {
+		// . skip the stages depending on a failed one and schedule the
+		//   ones that are ready. dependencies are on earlier stages so
+		//   one pass in order is enough
+		// . the first ready stage is kept for ourselves
+		int mine = -1;
+		bool allDone = true;
+		for (int i = 0; i < numStages; i++) {
+			Stage &stage = stages[i];
+			if (stage.m_done) {
+				continue;
+			}
+
+			if (!stage.m_scheduled) {
+				bool ready = true;
+				bool depFailed = false;
+				for (int j = 0; j < i; j++) {
+					if (!(stage.m_deps & (1U << j))) {
+						continue;
+					}
+					if (!stages[j].m_done) {
+						ready = false;
+					} else if (stages[j].m_failed) {
+						depFailed = true;
+					}
+				}
+
+				if (depFailed) {
+					stage.m_claimed = true;
+					stage.m_done = true;
+					stage.m_failed = true;
+					continue;
+				}
+
+				if (ready) {
+					stage.m_scheduled = true;
+					if (mine < 0) {
+						stage.m_claimed = true;
+						mine = i;
+					} else {
+						core->ref();
+						if (!g_jobScheduler.submit(runStageJob, stageJobDone, &stage, threadType, niceness)) {
+							// we'll run it ourselves
+							core->unref();
+						}
+					}
+				}
+			}
+
+			allDone = false;
+		}
+
+		if (allDone) {
+			break;
+		}
+
+		// help out with a scheduled stage no job thread has started yet
+		for (int i = 0; mine < 0 && i < numStages; i++) {
+			if (stages[i].m_scheduled && !stages[i].m_done && !stages[i].m_claimed.exchange(true)) {
+				mine = i;
+			}
+		}
+
+		if (mine >= 0) {
+			pthread_mutex_unlock(&core->m_mtx);
+			core->runStage(&stages[mine], false);
+			pthread_mutex_lock(&core->m_mtx);
+			continue;
+		}
+
+		// wait for a job thread to finish a stage
+		pthread_cond_wait(&core->m_cond, &core->m_mtx);
+	}
+
+	int err = 0;
+	for (int i = 0; i < numStages; i++) {
+		if (stages[i].m_failed && stages[i].m_errno && !err) {
+			err = stages[i].m_errno;
+			log(LOG_WARN, "jobdag: %s: stage %s failed: %s", m_name, stages[i].m_name, mstrerror(err));
+		}
+	}
+
+	pthread_mutex_unlock(&core->m_mtx);
+
+	m_totalTime = gettimeofdayInMicroseconds() - start;
+
+	addStats(m_name, m_totalTime, false);
+	for (int i = 0; i < numStages; i++) {
+		if (stages[i].m_time >= 0) {
+			addStats(std::string(m_name) + "." + stages[i].m_name, stages[i].m_time, stages[i].m_inJob);
+		}
+	}
+
+	if (err) {
+		g_errno = err;
+		return false;
+	}
+
+	return true;
+}
+
+int JobDag::getNumStages() const {
+	return m_core->m_numStages;
+}
+
+const char *JobDag::getStageName(int stage) const {
+	return m_core->m_stages[stage].m_name;
+}
+
+int64_t JobDag::getStageTime(int stage) const {
+	return m_core->m_stages[stage].m_time;
+}
+
+void JobDag::getStats(std::vector<JobDagStageStats> *stats) {
+	ScopedLock sl(s_statsMtx);
+	stats->clear();
+	for (auto const &it : s_stats) {
+		stats->push_back(it.second);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef GB_JOBDAG_H
+#define GB_JOBDAG_H
+
+#include "JobScheduler.h"
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+class JobDagCore;
+
+// accumulated over all runs of the graphs/stages with the same name
+struct JobDagStageStats {
+	std::string m_name;
+	int64_t m_count;
+	int64_t m_inJobCount;   //ran on a job thread instead of the caller's
+	int64_t m_totalTime;    //microseconds
+	int64_t m_maxTime;
+};
+
+// . a small graph of dependent stages of work. run() runs the stages whose
+//   dependencies are done concurrently on the job threads and waits for all
+//   of them
+// . the calling thread works too: it runs the stages no job thread has
+//   picked up yet, so we never wait for a stage still queued behind other
+//   jobs
+// . stages must not block. a stage returns false and sets g_errno on error,
+//   stages depending on a failed stage are skipped
+class JobDag {
+	JobDag(const JobDag&);
+	JobDag& operator=(const JobDag&);
+public:
+	typedef bool (*stage_func_t)(void *state);
+
+	static const int MAX_STAGES = 16;
+
+	explicit JobDag(const char *name);
+	~JobDag();
+
+	// . returns the stage number, or -1 if there are too many stages
+	// . "deps" are the numbers of the stages that must be done first
+	int addStage(const char *name, stage_func_t func, void *state, const int *deps = NULL, int numDeps = 0);
+
+	// . can only be called once
+	// . returns false and sets g_errno to the error of the first failed stage
+	bool run(thread_type_t threadType, int niceness);
+
+	int getNumStages() const;
+	const char *getStageName(int stage) const;
+	// microseconds. -1 if the stage was skipped
+	int64_t getStageTime(int stage) const;
+	// microseconds run() took
+	int64_t getTotalTime() const { return m_totalTime; }
+
+	// stats of the graphs (named "<graph>") and their stages (named
+	// "<graph>.<stage>") since startup
+	static void getStats(std::vector<JobDagStageStats> *stats);
+
+private:
+	const char *m_name;
+	JobDagCore *m_core;
+	int64_t m_totalTime;
+};
+
+#endif // GB_JOBDAG_H
@@ -8,6 +8,8 @@
 #include <stdexcept>
 #include <assert.h>
 #include <sys/time.h>
+#include <time.h>
+#include <errno.h>
 
 
 #include <stdio.h>
@@ -45,19 +47,46 @@ struct JobEntry {
 	uint64_t          stop_time;	      //when this job stopped running
 	uint64_t          finish_time;        //when the finish callback was called
 	uint64_t          exit_time;	      //when this job was finished, including finish-callback
+	bool              was_stolen;         //run by a thread of another pool
+	
+	const void       *job_group;          //jobs of eg. one query, so they can be cancelled together
+	bool              cancelled;          //set while running by cancel_job_group(). Atomic access
+	
+	uint64_t          queue_sequence;     //for keeping FIFO order among jobs with the same priority
 };
 
 
 
 
 //a set of jobs, prioritized
+//Kept as a binary heap on (priority,sequence) so both adding and taking the
+//top-priority job are O(log n), and jobs with the same priority are still
+//run in the order they were queued. Iteration order is unspecified.
 class JobQueue : public std::vector<JobEntry> {
+	uint64_t next_sequence;
+	
+	//"heap order": true if a should be run after b. Within a priority the
+	//job with the earliest start deadline goes first, jobs without a
+	//deadline last
+	static bool runs_after(const JobEntry &a, const JobEntry &b) {
+		if(a.initial_priority!=b.initial_priority)
+			return a.initial_priority > b.initial_priority;
+		if(a.start_deadline!=b.start_deadline) {
+			if(a.start_deadline==0)
+				return true;
+			if(b.start_deadline==0)
+				return false;
+			return a.start_deadline > b.start_deadline;
+		}
+		return a.queue_sequence > b.queue_sequence;
+	}
 public:
 	pthread_cond_t cond_not_empty;
 	unsigned potential_worker_threads;
 
 	JobQueue()
 	  : vector(),
+	    next_sequence(0),
 	    cond_not_empty PTHREAD_COND_INITIALIZER,
 	    potential_worker_threads(0)
 	{
@@ -69,12 +98,21 @@ public:
 	
 	void add(const JobEntry &e) {
 		push_back(e);
-		pthread_cond_signal(&cond_not_empty);
+		back().queue_sequence = next_sequence++;
+		std::push_heap(begin(),end(),runs_after);
 	}
 	
-	JobEntry pop_top_priority();
+	int top_priority() const {
+		assert(!empty());
+		return front().initial_priority;
+	}
 	
+	JobEntry pop_top_priority();
 	
+	//restore the heap after entries have been erased
+	void reheap() {
+		std::make_heap(begin(),end(),runs_after);
+	}
 };
 
 
@@ -82,14 +120,9 @@ JobEntry JobQueue::pop_top_priority()
 {
 	assert(!empty());
 	//todo: age old entries
-	std::vector<JobEntry>::iterator best_iter = begin();
-	std::vector<JobEntry>::iterator iter = best_iter;
-	++iter;
-	for( ; iter!=end(); ++iter)
-		if(iter->initial_priority<best_iter->initial_priority)
-			best_iter = iter;
-	JobEntry tmp = *best_iter;
-	erase(best_iter);
+	std::pop_heap(begin(),end(),runs_after);
+	JobEntry tmp = back();
+	pop_back();
 	return tmp;
 }
 
@@ -99,35 +132,227 @@ typedef std::vector<std::pair<JobEntry,job_exit_t>> ExitSet;
 typedef std::list<JobEntry> RunningSet;
 
 
-//parameters given to a pool thread
-struct PoolThreadParameters {
+//the job the current thread is running, for JobScheduler::is_job_cancelled()
+static __thread const JobEntry *current_job = NULL;
+
+
+static void job_done_notify_noop() {
+}
+
+
+//A pool of worker threads serving one job queue.
+//The pool starts with num_threads threads (which is also the maximum), and
+//threads above min_threads exit when they have been idle for a while. When a
+//job is queued and there is no idle thread a new one is started, up to the
+//maximum. If work stealing is enabled, idle threads take jobs from the
+//queues of sibling pools (see steal_from()) when their own queue is empty.
+//All members are covered by the scheduler mutex.
+class ThreadPool {
+public:
+	ThreadPool(const char *thread_name_prefix,
+	           unsigned num_threads,
+	           JobQueue *job_queue, RunningSet *running_set, ExitSet *exit_set,
+		   unsigned *num_io_write_jobs_running,
+		   pthread_mutex_t *mtx,
+		   job_done_notify_t job_done_notify_);
+	
+	//let idle threads of this pool take jobs from the victim's queue. Must be called before jobs are submitted
+	void steal_from(ThreadPool *victim);
+	
+	//mtx must be held for the following
+	void set_min_threads(unsigned min_threads_, unsigned idle_timeout_ms_);
+	void set_work_stealing(bool enabled) { work_stealing = enabled; }
+	void job_added();
+	unsigned num_live_threads() const { return tid.size(); }
+	
+	void initiate_stop();
+	void join_all();
+	~ThreadPool();
+	
+private:
+	const char        *thread_name_prefix;
 	JobQueue          *job_queue;                 //queue to fetch jobs from
 	RunningSet        *running_set;               //set to store the job in while executing it
 	ExitSet           *exit_set;                  //set to store the finished job+exit-cause in
 	unsigned          *num_io_write_jobs_running; //global counter for scheduling
-	pthread_mutex_t   *mtx;                       //mutex covering above 3 containers
+	pthread_mutex_t   *mtx;                       //mutex covering above 3 containers and this pool
 	job_done_notify_t job_done_notify;            //notifycation callback whenever a job returns
 	bool              stop;
+	
+	std::vector<pthread_t> tid;                   //live threads
+	unsigned          max_threads;
+	unsigned          min_threads;
+	unsigned          idle_timeout_ms;            //idle threads above min_threads exit after this long
+	unsigned          next_thread_number;         //for thread names
+	unsigned          num_idle;                   //threads waiting for a job
+	unsigned          num_wakeups_pending;        //idle threads signalled but not yet awake
+	
+	bool                     work_stealing;
+	std::vector<JobQueue*>   steal_queues;        //queues we may take jobs from when our own is empty
+	std::vector<ThreadPool*> thieves;             //pools that may take jobs from our queue
+	
+	bool spawn_thread();
+	bool wake_idle_thread();
+	JobQueue *pick_queue(bool *stolen) const;
+	void thread_loop();
+	static void *thread_function(void *pv);
 };
 
 
-extern "C" {
-static void *job_pool_thread_function(void *pv) {
-	PoolThreadParameters *ptp= static_cast<PoolThreadParameters*>(pv);
-	pthread_mutex_lock(ptp->mtx);
-	while(!ptp->stop) {
-		if(ptp->job_queue->empty())
-			pthread_cond_wait(&ptp->job_queue->cond_not_empty,ptp->mtx);
-		if(ptp->stop)
-			break;
-		if(ptp->job_queue->empty()) //spurious wakeup
-			continue;
+ThreadPool::ThreadPool(const char *thread_name_prefix_,
+                       unsigned num_threads,
+                       JobQueue *job_queue_, RunningSet *running_set_, ExitSet *exit_set_,
+		       unsigned *num_io_write_jobs_running_,
+		       pthread_mutex_t *mtx_,
+                       job_done_notify_t job_done_notify_)
+  : thread_name_prefix(thread_name_prefix_),
+    job_queue(job_queue_),
+    running_set(running_set_),
+    exit_set(exit_set_),
+    num_io_write_jobs_running(num_io_write_jobs_running_),
+    mtx(mtx_),
+    job_done_notify(job_done_notify_?job_done_notify_:job_done_notify_noop),
+    stop(false),
+    tid(),
+    max_threads(num_threads),
+    min_threads(num_threads),
+    idle_timeout_ms(0),
+    next_thread_number(0),
+    num_idle(0),
+    num_wakeups_pending(0),
+    work_stealing(false),
+    steal_queues(),
+    thieves()
+{
+	job_queue->potential_worker_threads += num_threads;
+	ScopedLock sl(*mtx);
+	for(unsigned i=0; i<num_threads; i++) {
+		if(!spawn_thread())
+			throw std::runtime_error("pthread_create() failed");
+	}
+}
+
+
+void ThreadPool::steal_from(ThreadPool *victim)
+{
+	steal_queues.push_back(victim->job_queue);
+	victim->thieves.push_back(this);
+}
+
+
+void ThreadPool::set_min_threads(unsigned min_threads_, unsigned idle_timeout_ms_)
+{
+	min_threads = std::min(min_threads_,max_threads);
+	idle_timeout_ms = idle_timeout_ms_;
+	//wake idle threads so they notice the new timeout
+	pthread_cond_broadcast(&job_queue->cond_not_empty);
+}
+
+
+bool ThreadPool::spawn_thread()
+{
+	pthread_t t;
+	int rc = pthread_create(&t, NULL, thread_function, this);
+	if(rc!=0)
+		return false;
+	char thread_name[16]; //hard limit
+	snprintf(thread_name,sizeof(thread_name),"%s %u", thread_name_prefix,next_thread_number++);
+	pthread_setname_np(t,thread_name); //cosmetic only
+	tid.push_back(t);
+	return true;
+}
+
+
+bool ThreadPool::wake_idle_thread()
+{
+	if(num_idle <= num_wakeups_pending)
+		return false;
+	num_wakeups_pending++;
+	pthread_cond_signal(&job_queue->cond_not_empty);
+	return true;
+}
+
+
+//a job has been put into our queue. Make sure someone will run it
+void ThreadPool::job_added()
+{
+	if(wake_idle_thread())
+		return;
+	if(tid.size()<max_threads && !stop && spawn_thread())
+		return;
+	//all our threads are busy. Let an idle sibling take it
+	for(auto thief : thieves) {
+		if(thief->work_stealing && thief->wake_idle_thread())
+			return;
+	}
+	//otherwise it will be run when one of our threads finishes its current job
+}
+
+
+//find the queue to take the next job from: our own, or if that is empty the
+//sibling queue with the most urgent job
+JobQueue *ThreadPool::pick_queue(bool *stolen) const
+{
+	*stolen = false;
+	if(!job_queue->empty())
+		return job_queue;
+	if(!work_stealing)
+		return NULL;
+	JobQueue *best = NULL;
+	for(auto jq : steal_queues) {
+		if(!jq->empty() && (!best || jq->top_priority() < best->top_priority()))
+			best = jq;
+	}
+	*stolen = best!=NULL;
+	return best;
+}
+
+
+void ThreadPool::thread_loop()
+{
+	pthread_mutex_lock(mtx);
+	while(!stop) {
+		bool stolen;
+		JobQueue *jq = pick_queue(&stolen);
+		if(!jq) {
+			num_idle++;
+			int rc;
+			if(idle_timeout_ms!=0 && tid.size()>min_threads) {
+				struct timespec ts;
+				clock_gettime(CLOCK_REALTIME,&ts);
+				ts.tv_sec += idle_timeout_ms/1000;
+				ts.tv_nsec += (idle_timeout_ms%1000)*1000000;
+				if(ts.tv_nsec>=1000000000) {
+					ts.tv_sec++;
+					ts.tv_nsec -= 1000000000;
+				}
+				rc = pthread_cond_timedwait(&job_queue->cond_not_empty,mtx,&ts);
+			} else
+				rc = pthread_cond_wait(&job_queue->cond_not_empty,mtx);
+			num_idle--;
+			if(num_wakeups_pending)
+				num_wakeups_pending--;
+			if(rc==ETIMEDOUT && !stop && tid.size()>min_threads && !pick_queue(&stolen)) {
+				//been idle for a while and there are more threads than we need
+				pthread_t self = pthread_self();
+				for(std::vector<pthread_t>::iterator iter = tid.begin(); iter!=tid.end(); ++iter) {
+					if(pthread_equal(*iter,self)) {
+						tid.erase(iter);
+						break;
+					}
+				}
+				pthread_detach(self);
+				break;
+			}
+			continue; //also handles spurious wakeups
+		}
 		
 		//take the top-priority job and move it into the running set
-		RunningSet::iterator iter = ptp->running_set->insert(ptp->running_set->begin(),ptp->job_queue->pop_top_priority());
+		RunningSet::iterator iter = running_set->insert(running_set->begin(),jq->pop_top_priority());
+		iter->was_stolen = stolen;
 		if(iter->is_io_job && iter->is_io_write_job)
-			++*(ptp->num_io_write_jobs_running);
-		pthread_mutex_unlock(ptp->mtx);
+			++*num_io_write_jobs_running;
+		pthread_mutex_unlock(mtx);
 		
 		job_exit_t job_exit;
 		uint64_t now = now_ms();
@@ -135,91 +360,47 @@ static void *job_pool_thread_function(void *pv) {
 		if(iter->start_deadline==0 || iter->start_deadline>now) {
 			// Clear g_errno so the thread/job starts with a clean slate
 			g_errno = 0;
+			current_job = &*iter;
 			iter->start_routine(iter->state);
+			current_job = NULL;
 			iter->stop_time = now_ms();
 			job_exit = job_exit_normal;
 		} else {
 			job_exit = job_exit_deadline;
 		}
 		
-		pthread_mutex_lock(ptp->mtx);
+		pthread_mutex_lock(mtx);
 		if(iter->is_io_job && iter->is_io_write_job)
-			--*(ptp->num_io_write_jobs_running);
+			--*num_io_write_jobs_running;
 		//copy+delete it into the exit queue
-		ptp->exit_set->push_back(std::make_pair(*iter,job_exit));
-		ptp->running_set->erase(iter);
-		pthread_mutex_unlock(ptp->mtx);
+		exit_set->push_back(std::make_pair(*iter,job_exit));
+		running_set->erase(iter);
+		pthread_mutex_unlock(mtx);
 		
-		(ptp->job_done_notify)();
+		job_done_notify();
 		
-		pthread_mutex_lock(ptp->mtx);
+		pthread_mutex_lock(mtx);
 	}
 	
-	pthread_mutex_unlock(ptp->mtx);
-	return 0;
-}
+	pthread_mutex_unlock(mtx);
 }
 
 
-static void job_done_notify_noop() {
-}
-
-
-class ThreadPool {
-public:
-	ThreadPool(const char *thread_name_prefix,
-	           unsigned num_threads,
-	           JobQueue *job_queue, RunningSet *running_set, ExitSet *exit_set,
-		   unsigned *num_io_write_jobs_running,
-		   pthread_mutex_t *mtx,
-		   job_done_notify_t job_done_notify_);
-	void initiate_stop();
-	void join_all();
-	~ThreadPool();
-	
-private:
-	PoolThreadParameters ptp;
-	std::vector<pthread_t> tid;
-};
-
-
-ThreadPool::ThreadPool(const char *thread_name_prefix,
-                       unsigned num_threads,
-                       JobQueue *job_queue, RunningSet *running_set, ExitSet *exit_set,
-		       unsigned *num_io_write_jobs_running,
-		       pthread_mutex_t *mtx,
-                       job_done_notify_t job_done_notify_)
-  : tid(num_threads)
-{
-	job_queue->potential_worker_threads += num_threads;
-	ptp.job_queue = job_queue;
-	ptp.running_set = running_set;
-	ptp.exit_set = exit_set;
-	ptp.num_io_write_jobs_running = num_io_write_jobs_running;
-	ptp.mtx = mtx;
-	ptp.job_done_notify = job_done_notify_?job_done_notify_:job_done_notify_noop;
-	ptp.stop = false;
-	for(unsigned i=0; i<tid.size(); i++) {
-		int rc = pthread_create(&tid[i], NULL, job_pool_thread_function, &ptp);
-		if(rc!=0)
-			throw std::runtime_error("pthread_create() failed");
-		char thread_name[16]; //hard limit
-		snprintf(thread_name,sizeof(thread_name),"%s %u", thread_name_prefix,i);
-		rc = pthread_setname_np(tid[i],thread_name);
-		if(rc!=0)
-			throw std::runtime_error("pthread_setname_np() failed");
-	}
+void *ThreadPool::thread_function(void *pv) {
+	static_cast<ThreadPool*>(pv)->thread_loop();
+	return 0;
 }
 
 
 void ThreadPool::initiate_stop()
 {
-	for(unsigned i=0; i<tid.size(); i++)
-		ptp.stop = true;
+	ScopedLock sl(*mtx);
+	stop = true;
 }
 
 void ThreadPool::join_all()
 {
+	//threads don't exit on their own once stop is set, so tid is stable
 	for(unsigned i=0; i<tid.size(); i++)
 		pthread_join(tid[i],NULL);
 	tid.clear();
@@ -268,8 +449,10 @@ class JobScheduler_impl {
 	std::map<thread_type_t,JobTypeStatistics> job_statistics;
 	
 	bool submit(thread_type_t thread_type, JobEntry &e);
+	ThreadPool *pool_for_queue(JobQueue *job_queue);
 	
 	void cancel_queued_jobs(JobQueue &jq, job_exit_t job_exit);
+	void cancel_queued_jobs(JobQueue &jq, const void *job_group);
 public:
 	JobScheduler_impl(unsigned num_coordinator_threads, unsigned num_cpu_threads, unsigned num_summary_threads, unsigned num_io_threads, unsigned num_external_threads, unsigned num_file_meta_threads, unsigned num_merge_threads, job_done_notify_t job_done_notify)
 	  : mtx PTHREAD_MUTEX_INITIALIZER,
@@ -293,6 +476,16 @@ public:
 	    no_threads(num_cpu_threads==0 && num_summary_threads==0 && num_io_threads==0 && num_external_threads==0 && num_file_meta_threads==0),
 	    new_jobs_allowed(true)
 	{
+		//Idle CPU-bound workers may help each other out. Merge workers
+		//may take query and summary jobs, but not the other way around
+		//because a file merge can occupy a thread for minutes.
+		{
+			ScopedLock sl(mtx);
+			cpu_thread_pool.steal_from(&summary_thread_pool);
+			summary_thread_pool.steal_from(&cpu_thread_pool);
+			merge_thread_pool.steal_from(&cpu_thread_pool);
+			merge_thread_pool.steal_from(&summary_thread_pool);
+		}
 	}
 	
 	~JobScheduler_impl();
@@ -302,7 +495,8 @@ public:
 		    void             *state,
 		    thread_type_t     thread_type,
 		    int               priority,
-		    uint64_t          start_deadline=0);
+		    uint64_t          start_deadline,
+		    const void       *job_group);
 	bool submit_io(start_routine_t   start_routine,
 	               finish_routine_t  finish_callback,
 		       FileState        *fstate,
@@ -313,6 +507,7 @@ public:
 	
 	bool are_io_write_jobs_running() const;
 	void cancel_file_read_jobs(const BigFile *bf);
+	void cancel_job_group(const void *job_group);
 	//void nice page for html and administation()
 	bool is_reading_file(const BigFile *bf);
 	
@@ -325,6 +520,10 @@ public:
 	bool are_new_jobs_allowed() const {
 		return new_jobs_allowed && !no_threads;
 	}
+	
+	void set_adaptive_pools(unsigned min_cpu_threads, unsigned min_summary_threads, unsigned min_merge_threads, unsigned idle_thread_timeout_ms);
+	void set_work_stealing(bool enabled);
+	unsigned num_pool_threads() const;
 	void cancel_all_jobs_for_shutdown();
 	
 	unsigned num_queued_jobs() const;
@@ -437,10 +636,24 @@ bool JobScheduler_impl::submit(thread_type_t thread_type, JobEntry &e)
 	e.queue_enter_time = now_ms();
 	ScopedLock sl(mtx);
 	job_queue->add(e);
+	pool_for_queue(job_queue)->job_added();
 	return true;
 }
 
 
+ThreadPool *JobScheduler_impl::pool_for_queue(JobQueue *job_queue)
+{
+	if(job_queue==&coordinator_job_queue) return &coordinator_thread_pool;
+	if(job_queue==&cpu_job_queue)         return &cpu_thread_pool;
+	if(job_queue==&summary_job_queue)     return &summary_thread_pool;
+	if(job_queue==&io_job_queue)          return &io_thread_pool;
+	if(job_queue==&external_job_queue)    return &external_thread_pool;
+	if(job_queue==&file_meta_job_queue)   return &file_meta_thread_pool;
+	assert(job_queue==&merge_job_queue);
+	return &merge_thread_pool;
+}
+
+
 void JobScheduler_impl::cancel_queued_jobs(JobQueue &jq, job_exit_t job_exit) {
 	while(!jq.empty()) {
 		exit_set.push_back(std::make_pair(jq.back(),job_exit));
@@ -449,12 +662,28 @@ void JobScheduler_impl::cancel_queued_jobs(JobQueue &jq, job_exit_t job_exit) {
 }
 
 
+void JobScheduler_impl::cancel_queued_jobs(JobQueue &jq, const void *job_group) {
+	bool any = false;
+	for(JobQueue::iterator iter = jq.begin(); iter!=jq.end(); ) {
+		if(iter->job_group==job_group) {
+			exit_set.push_back(std::make_pair(*iter,job_exit_cancelled));
+			iter = jq.erase(iter);
+			any = true;
+		} else
+			++iter;
+	}
+	if(any)
+		jq.reheap();
+}
+
+
 bool JobScheduler_impl::submit(start_routine_t   start_routine,
                                finish_routine_t  finish_callback,
                                void             *state,
                                thread_type_t     thread_type,
                                int               priority,
-                               uint64_t          start_deadline)
+                               uint64_t          start_deadline,
+                               const void       *job_group)
 {
 	JobEntry e;
 	
@@ -466,6 +695,7 @@ bool JobScheduler_impl::submit(start_routine_t   start_routine,
 	e.start_deadline = start_deadline;
 	e.is_io_write_job = false;
 	e.initial_priority = priority;
+	e.job_group = job_group;
 	return submit(thread_type,e);
 }
 
@@ -515,6 +745,28 @@ void JobScheduler_impl::cancel_file_read_jobs(const BigFile *bf)
 		}
 		++iter;
 	}
+	io_job_queue.reheap();
+}
+
+
+//Cancel the queued jobs of the group and tell the running ones to stop. The
+//running jobs have to check is_job_cancelled() themselves
+void JobScheduler_impl::cancel_job_group(const void *job_group)
+{
+	if(!job_group)
+		return;
+	ScopedLock sl(mtx);
+	cancel_queued_jobs(coordinator_job_queue,job_group);
+	cancel_queued_jobs(cpu_job_queue,job_group);
+	cancel_queued_jobs(summary_job_queue,job_group);
+	cancel_queued_jobs(io_job_queue,job_group);
+	cancel_queued_jobs(external_job_queue,job_group);
+	cancel_queued_jobs(file_meta_job_queue,job_group);
+	cancel_queued_jobs(merge_job_queue,job_group);
+	for(auto &e : running_set) {
+		if(e.job_group==job_group)
+			__atomic_store_n(&e.cancelled,true,__ATOMIC_RELAXED);
+	}
 }
 
 
@@ -555,6 +807,31 @@ void JobScheduler_impl::cancel_all_jobs_for_shutdown() {
 
 
 
+void JobScheduler_impl::set_adaptive_pools(unsigned min_cpu_threads, unsigned min_summary_threads, unsigned min_merge_threads, unsigned idle_thread_timeout_ms)
+{
+	ScopedLock sl(mtx);
+	cpu_thread_pool.set_min_threads(min_cpu_threads,idle_thread_timeout_ms);
+	summary_thread_pool.set_min_threads(min_summary_threads,idle_thread_timeout_ms);
+	merge_thread_pool.set_min_threads(min_merge_threads,idle_thread_timeout_ms);
+}
+
+
+void JobScheduler_impl::set_work_stealing(bool enabled)
+{
+	ScopedLock sl(mtx);
+	cpu_thread_pool.set_work_stealing(enabled);
+	summary_thread_pool.set_work_stealing(enabled);
+	merge_thread_pool.set_work_stealing(enabled);
+}
+
+
+unsigned JobScheduler_impl::num_pool_threads() const
+{
+	ScopedLock sl(mtx);
+	return coordinator_thread_pool.num_live_threads() + cpu_thread_pool.num_live_threads() + summary_thread_pool.num_live_threads() + io_thread_pool.num_live_threads() + external_thread_pool.num_live_threads() + file_meta_thread_pool.num_live_threads() + merge_thread_pool.num_live_threads();
+}
+
+
 unsigned JobScheduler_impl::num_queued_jobs() const
 {
 	ScopedLock sl(mtx);
@@ -580,6 +857,8 @@ void JobScheduler_impl::cleanup_finished_jobs()
 		s.running_time += e.first.stop_time - e.first.start_time;
 		s.done_time += e.first.finish_time - e.first.stop_time;
 		s.cleanup_time += e.first.exit_time - e.first.finish_time;
+		if(e.first.was_stolen)
+			s.stolen_count++;
 	}
 }
 
@@ -677,10 +956,11 @@ bool JobScheduler::submit(start_routine_t   start_routine,
                           void             *state,
                           thread_type_t     thread_type,
                           int               priority,
-                          uint64_t          start_deadline)
+                          uint64_t          start_deadline,
+                          const void       *job_group)
 {
 	if(impl)
-		return impl->submit(start_routine,finish_callback,state,thread_type,priority,start_deadline);
+		return impl->submit(start_routine,finish_callback,state,thread_type,priority,start_deadline,job_group);
 	else
 		return false;
 }
@@ -716,6 +996,19 @@ void JobScheduler::cancel_file_read_jobs(const BigFile *bf)
 }
 
 
+void JobScheduler::cancel_job_group(const void *job_group)
+{
+	if(impl)
+		impl->cancel_job_group(job_group);
+}
+
+
+bool JobScheduler::is_job_cancelled()
+{
+	return current_job && __atomic_load_n(&current_job->cancelled,__ATOMIC_RELAXED);
+}
+
+
 //void nice page for html and administation()
 
 
@@ -749,6 +1042,27 @@ bool JobScheduler::are_new_jobs_allowed() const
 }
 
 
+void JobScheduler::set_adaptive_pools(unsigned min_cpu_threads, unsigned min_summary_threads, unsigned min_merge_threads, unsigned idle_thread_timeout_ms)
+{
+	if(impl)
+		impl->set_adaptive_pools(min_cpu_threads,min_summary_threads,min_merge_threads,idle_thread_timeout_ms);
+}
+
+void JobScheduler::set_work_stealing(bool enabled)
+{
+	if(impl)
+		impl->set_work_stealing(enabled);
+}
+
+unsigned JobScheduler::num_pool_threads() const
+{
+	if(impl)
+		return impl->num_pool_threads();
+	else
+		return 0;
+}
+
+
 void JobScheduler::cancel_all_jobs_for_shutdown() {
 	if(impl)
 		impl->cancel_all_jobs_for_shutdown();
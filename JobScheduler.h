@@ -73,6 +73,7 @@ struct JobTypeStatistics {
 	uint64_t running_time;          //time from start to stop, in nsecs
 	uint64_t done_time;             //time from stop to cleanup
 	uint64_t cleanup_time;          //time from in cleanup
+	uint64_t stolen_count;          //jobs run by an idle thread of another pool
 };
 
 
@@ -95,7 +96,8 @@ public:
 		    void             *state,
 		    thread_type_t     thread_type,
 		    int               priority,
-		    uint64_t          start_deadline=0);
+		    uint64_t          start_deadline=0,
+		    const void       *job_group=0);
 	bool submit_io(start_routine_t   start_routine,
 	               finish_routine_t  finish_callback,
 		       FileState        *fstate,
@@ -108,10 +110,26 @@ public:
 	void cancel_file_read_jobs(const BigFile *bf);
 	bool is_reading_file(const BigFile *bf);
 	
+	//Jobs submitted with the same job_group (eg. the Msg39 instance) can be
+	//cancelled together. Queued jobs exit with job_exit_cancelled, running
+	//jobs see is_job_cancelled() become true and should give up
+	void cancel_job_group(const void *job_group);
+	//true if the job running in the calling thread has been cancelled
+	static bool is_job_cancelled();
+	
 	void allow_new_jobs();
 	void disallow_new_jobs();
 	bool are_new_jobs_allowed() const;
 	
+	//let the cpu, summary and merge pools shrink to the given number of
+	//threads when idle for idle_thread_timeout_ms (0=never). They grow
+	//back up to the initialize() numbers on demand. By default the pools
+	//are fixed
+	void set_adaptive_pools(unsigned min_cpu_threads, unsigned min_summary_threads, unsigned min_merge_threads, unsigned idle_thread_timeout_ms);
+	//let idle cpu/summary/merge threads take jobs from each others queues (default off)
+	void set_work_stealing(bool enabled);
+	unsigned num_pool_threads() const;
+	
 	void cancel_all_jobs_for_shutdown();
 	
 	unsigned num_queued_jobs() const;
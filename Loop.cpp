@@ -11,6 +11,7 @@
 #include "ScopedLock.h"
 #include "Mem.h"
 #include "InstanceInfoExchange.h"
+#include "GbIoUring.h"
 
 #include "Stats.h"
 
@@ -21,12 +22,16 @@
 #include <sys/types.h>
 #include <signal.h>
 #include <fcntl.h>      // fcntl()
-#include <sys/poll.h>   // POLLIN, POLLPRI, ...
+#include <sys/epoll.h>
 
 // raised from 5000 to 10000 because we have more UdpSlots now and Multicast
 // will call g_loop.registerSleepCallback() if it fails to get a UdpSlot to
-// send on.
-#define MAX_SLOTS 10000
+// send on. plus one per fd now that we can watch more than 1024 fds
+#define MAX_SLOTS (10000 + MAX_NUM_FDS)
+
+// max # of fd events we handle per doPoll(). with level triggering the rest
+// are reported again on the next epoll_wait()
+#define MAX_EPOLL_EVENTS 1024
 
 
 // TODO: . if signal queue overflows another signal is sent
@@ -57,8 +62,12 @@ class Slot {
 	// this callback should be called every X milliseconds
 	int32_t      m_tick;
 
-	// when we were last called in ms time (only valid for sleep callbacks)
-	int64_t m_lastCall;
+	// . when we are due next in monotonic ms (only valid for sleep callbacks)
+	// . m_timerList is the timer wheel bucket (or m_timersDue) we are in
+	int64_t m_nextCall;
+	Slot  **m_timerList;
+	Slot   *m_timerPrev;
+	Slot   *m_timerNext;
 
 	const char *m_description;
 
@@ -71,6 +80,14 @@ class Slot {
 Loop g_loop;
 
 
+// sleep callbacks are timed with this so setting the clock doesn't stall them
+static int64_t getMonotonicMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
 // free up all our mem
 void Loop::reset() {
 	if ( m_slots ) {
@@ -99,13 +116,10 @@ void Loop::unregisterSleepCallback ( void *state , void (* callback)(int fd,void
 	unregisterCallback (m_readSlots,MAX_NUM_FDS,state,callback,true);
 }
 
-static fd_set s_selectMaskRead;
-static fd_set s_selectMaskWrite;
+// the EPOLLIN/EPOLLOUT events each fd is currently registered for in epoll
+static uint8_t s_epollMask[MAX_NUM_FDS];
 
-static int s_readFds[MAX_NUM_FDS];
-static int32_t s_numReadFds = 0;
-static int s_writeFds[MAX_NUM_FDS];
-static int32_t s_numWriteFds = 0;
+static struct epoll_event s_epollEvents[MAX_EPOLL_EVENTS];
 
 void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callback)(int fd,void *state), bool forReading) {
 	// bad fd
@@ -113,10 +127,6 @@ void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callbac
 		log(LOG_LOGIC, "loop: fd to unregister is negative.");
 		return;
 	}
-	// . keep track of new min tick for sleep callbacks
-	// . sleep a min of 40ms so g_now is somewhat up to date
-	int32_t min     = 40; // 0x7fffffff;
-
 	ScopedLock sl(m_slotMutex);
 	// chase through all callbacks registered with this fd
 	Slot *prevSlot = NULL;
@@ -127,63 +137,32 @@ void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callbac
 		   s->m_state    == state) {
 			// free this slot since it callback matches "callback"
 			returnSlot ( s );
-			// if the last one, then remove the FD from s_fdList
-			// so and clear a bit so doPoll() function is fast
-			if(slots[fd] == s && s->m_next == NULL) {
-				if(forReading) {
-					for(int32_t i = 0; i < s_numReadFds; i++ ) {
-						if (s_readFds[i] == fd) {
-							s_readFds[i] = s_readFds[s_numReadFds-1];
-							s_numReadFds--;
-							// remove from select mask too
-							FD_CLR(fd,&s_selectMaskRead );
-							if(g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
-								log( "loop: unregistering read callback for fd=%i", fd );
-							}
-							break;
-						}
-					}
-				} else {
-					for(int32_t i = 0; i < s_numWriteFds; i++ ) {
-						if(s_writeFds[i] == fd) {
-							s_writeFds[i] = s_writeFds[s_numWriteFds-1];
-							s_numWriteFds--;
-							// remove from select mask too
-							FD_CLR(fd,&s_selectMaskWrite);
-							if(g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
-								log( LOG_DEBUG, "loop: unregistering write callback for fd=%" PRId32" from write #wrts=%" PRId32,
-								     ( int32_t ) fd, ( int32_t ) s_numWriteFds );
-							}
-							break;
-						}
-					}
-				}
+			// take sleep slots out of the timer wheel
+			if(fd == MAX_NUM_FDS) {
+				unlinkTimer(s);
 			}
 			// excise the previous slot from linked list
 			if(prevSlot)
 				prevSlot->m_next = next;
 			else
 				slots[fd]        = next;
+			// if that was the last one then stop watching the fd
+			if(slots[fd] == NULL && fd < MAX_NUM_FDS) {
+				if(g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
+					log( LOG_DEBUG, "loop: unregistering %s callback for fd=%i", forReading ? "read" : "write", fd );
+				}
+				updateEpoll(fd);
+			}
 			// watch out if we're in the previous callback, we need to
 			// fix the linked list in callCallbacks_ass
 			if(m_callbacksNext == s)
 				m_callbacksNext = next;
 		} else {
 			prevSlot = s;
-			// if we're unregistering a sleep callback
-			// we might have to recalculate m_minTick
-			if(s->m_tick < min)
-				min = s->m_tick;
 		}
 		// advance to the next slot
 		s = next;
 	}
-	// set our new minTick if we were unregistering a sleep callback
-	if ( fd == MAX_NUM_FDS ) {
-		m_minTick = min;
-	}
-
-	return;
 }
 
 bool Loop::registerReadCallback(int fd, void *state, void (*callback)(int fd, void *state),
@@ -217,11 +196,6 @@ bool Loop::registerSleepCallback(int32_t tick, void *state, void (*callback)(int
 		return false;
 	}
 
-	ScopedLock sl(m_slotMutex);
-	if ( tick < m_minTick ) {
-		m_minTick = tick;
-	}
-
 	return true;
 }
 
@@ -275,31 +249,10 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 	if ( forReading ) {
 		next = m_readSlots [ fd ];
 		m_readSlots  [ fd ] = s;
-		// if not already registered, add to list
-		if ( fd < MAX_NUM_FDS && ! FD_ISSET( fd,&s_selectMaskRead ) ) {
-			// sanity
-			if ( s_numReadFds >= MAX_NUM_FDS){
-				g_process.shutdownAbort(true);
-			}
-			
-			s_readFds[s_numReadFds++] = fd;
-			FD_SET ( fd,&s_selectMaskRead  );
-		}
 	}
 	else {
 	 	next = m_writeSlots [ fd ];
 	 	m_writeSlots [ fd ] = s;
-	 	//FD_SET ( fd , &m_writefds );
-	 	// if not already registered, add to list
-	 	if ( fd<MAX_NUM_FDS && ! FD_ISSET ( fd,&s_selectMaskWrite ) ) {
-	 		// sanity
-	 		if ( s_numWriteFds>=MAX_NUM_FDS){
-			    g_process.shutdownAbort(true);
-		    }
-
-	 		s_writeFds[s_numWriteFds++] = fd;
-	 		FD_SET ( fd,&s_selectMaskWrite  );
-	 	}
 	}
 	// set our callback and state
 	s->m_callback  = callback;
@@ -315,11 +268,15 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 	// store the tick for sleep wrappers (should be max for others)
 	s->m_tick      = tick;
 
-	// the last called time
-	s->m_lastCall = immediate ? 0 : gettimeofdayInMilliseconds();
+	s->m_timerList = NULL;
+	s->m_timerPrev = NULL;
+	s->m_timerNext = NULL;
 
 	// if fd == MAX_NUM_FDS if it's a sleep callback
 	if ( fd == MAX_NUM_FDS ) {
+		// the next time we're due
+		s->m_nextCall = immediate ? 0 : getMonotonicMs() + tick;
+		linkTimer(s);
 		return true;
 	}
 
@@ -328,10 +285,190 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 		return true;
 	}
 
+	// start watching the fd if we weren't already
+	if ( ! updateEpoll(fd) ) {
+		// undo
+		if ( forReading ) m_readSlots  [ fd ] = next;
+		else              m_writeSlots [ fd ] = next;
+		returnSlot(s);
+		return false;
+	}
+
 	// set fd non-blocking
 	return setNonBlocking(fd);
 }
 
+// . make the epoll interest set of "fd" match the slots registered on it
+// . caller holds m_slotMutex
+bool Loop::updateEpoll(int fd) {
+	if ( fd >= MAX_NUM_FDS || m_epollFd < 0 ) {
+		return true;
+	}
+
+	uint8_t want = 0;
+	if ( m_readSlots [ fd ] ) want |= EPOLLIN;
+	if ( m_writeSlots[ fd ] ) want |= EPOLLOUT;
+	if ( want == s_epollMask[fd] ) {
+		return true;
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = want;
+	if ( m_edgeTriggered ) {
+		ev.events |= EPOLLET;
+	}
+	ev.data.fd = fd;
+
+	int rc;
+	if ( want == 0 ) {
+		// closing the fd already took it out of the set
+		rc = epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, &ev);
+		if ( rc < 0 && errno != EBADF && errno != ENOENT ) {
+			log( LOG_WARN, "loop: epoll_ctl(DEL) fd=%i: %s", fd, strerror(errno) );
+		}
+		s_epollMask[fd] = 0;
+		return true;
+	}
+
+	if ( s_epollMask[fd] == 0 ) {
+		rc = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+		if ( rc < 0 && errno == EEXIST ) {
+			rc = epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev);
+		}
+	} else {
+		rc = epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev);
+		// fd was closed and reopened while registered
+		if ( rc < 0 && errno == ENOENT ) {
+			rc = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+		}
+	}
+
+	if ( rc < 0 ) {
+		g_errno = errno;
+		log( LOG_WARN, "loop: epoll_ctl fd=%i: %s", fd, strerror(errno) );
+		return false;
+	}
+
+	s_epollMask[fd] = want;
+	return true;
+}
+
+// . put sleep slot "s" in the bucket for its m_nextCall
+// . caller holds m_slotMutex
+void Loop::linkTimer(Slot *s) {
+	// never in a bucket we already passed, it would wait a whole revolution
+	int64_t due = s->m_nextCall;
+	if ( due <= m_timerWheelTime ) {
+		due = m_timerWheelTime + 1;
+	}
+
+	Slot **list = &m_timerWheel[due & (LOOP_TIMER_WHEEL_SIZE - 1)];
+	s->m_timerList = list;
+	s->m_timerPrev = NULL;
+	s->m_timerNext = *list;
+	if ( *list ) {
+		(*list)->m_timerPrev = s;
+	}
+	*list = s;
+}
+
+void Loop::unlinkTimer(Slot *s) {
+	if ( ! s->m_timerList ) {
+		return;
+	}
+
+	if ( s->m_timerPrev ) {
+		s->m_timerPrev->m_timerNext = s->m_timerNext;
+	} else {
+		*s->m_timerList = s->m_timerNext;
+	}
+	if ( s->m_timerNext ) {
+		s->m_timerNext->m_timerPrev = s->m_timerPrev;
+	}
+
+	s->m_timerList = NULL;
+	s->m_timerPrev = NULL;
+	s->m_timerNext = NULL;
+}
+
+// . call the sleep callbacks that are due at "now" (monotonic ms)
+// . only the buckets for the ms since the last call are looked at. slots
+//   due more than a revolution away are skipped when their bucket comes up
+void Loop::callSleepCallbacks(int64_t now) {
+	// save the g_errno to send to all callbacks
+	int saved_errno = g_errno;
+
+	ScopedLock sl(m_slotMutex);
+
+	if ( now <= m_timerWheelTime ) {
+		return;
+	}
+
+	// move the due slots out of the wheel first so callbacks can register
+	// and unregister sleep callbacks while we go
+	int64_t from = m_timerWheelTime + 1;
+	if ( now - from >= LOOP_TIMER_WHEEL_SIZE ) {
+		from = now - LOOP_TIMER_WHEEL_SIZE + 1;
+	}
+	for ( int64_t t = from ; t <= now ; t++ ) {
+		for ( Slot *s = m_timerWheel[t & (LOOP_TIMER_WHEEL_SIZE - 1)]; s; ) {
+			Slot *next = s->m_timerNext;
+			if ( s->m_nextCall <= now ) {
+				unlinkTimer(s);
+				s->m_timerList = &m_timersDue;
+				s->m_timerNext = m_timersDue;
+				if ( m_timersDue ) {
+					m_timersDue->m_timerPrev = s;
+				}
+				m_timersDue = s;
+			}
+			s = next;
+		}
+	}
+	m_timerWheelTime = now;
+
+	while ( m_timersDue ) {
+		Slot *s = m_timersDue;
+		unlinkTimer(s);
+
+		// sanity check. -1 no longer supported
+		if (s->m_niceness < 0) {
+			g_process.shutdownAbort(true);
+		}
+
+		// schedule the next call before calling since the callback may
+		// unregister itself
+		s->m_nextCall = now + s->m_tick;
+		linkTimer(s);
+
+		void (*callback)(int fd, void *state) = s->m_callback;
+		void *state = s->m_state;
+		const char *description = s->m_description;
+
+		logDebug(g_conf.m_logDebugLoop, "loop: enter sleep callback '%s' nice=%" PRId32, description, s->m_niceness);
+
+		int64_t took = 0;
+
+		m_slotMutex.unlock();
+		{
+			int64_t start = gettimeofdayInMilliseconds();
+			callback(MAX_NUM_FDS, state);
+			took = gettimeofdayInMilliseconds() - start;
+		}
+		m_slotMutex.lock();
+
+		if (took > g_conf.m_logLoopTimeThreshold) {
+			log(LOG_WARN, "loop: %s took %" PRId64"ms", description, took);
+		}
+
+		logDebug(g_conf.m_logDebugLoop, "loop: exit sleep callback '%s'", description);
+
+		// reset g_errno so all callbacks get same g_errno
+		g_errno = saved_errno;
+	}
+}
+
 // . now make sure we're listening for an interrupt on this fd
 // . set it non-blocing and enable signal catching for it
 // . listen for an interrupt for this fd
@@ -355,14 +492,19 @@ bool Loop::setNonBlocking(int fd) {
 		return false;
 	}
 
-	// we use select()/poll now so skip stuff below
+	// we use epoll now so skip stuff below
 	return true;
 }
 
 // . if "forReading" is true  call callbacks registered for reading on "fd"
 // . if "forReading" is false call callbacks registered for writing on "fd"
-// . if fd is MAX_NUM_FDS and "forReading" is true call all sleepy callbacks
+// . if fd is MAX_NUM_FDS and "forReading" is true call the due sleepy callbacks
 void Loop::callCallbacks_ass ( bool forReading , int fd , int64_t now , int32_t niceness ) {
+	if ( forReading && fd == MAX_NUM_FDS ) {
+		callSleepCallbacks(getMonotonicMs());
+		return;
+	}
+
 	// save the g_errno to send to all callbacks
 	int saved_errno = g_errno;
 
@@ -383,28 +525,12 @@ void Loop::callCallbacks_ass ( bool forReading , int fd , int64_t now , int32_t
 			continue;
 		}
 
-		// watch out if clock was set back
-		if ( s->m_lastCall > now ) {
-			s->m_lastCall = now;
-		}
-
-		// if we're a sleep callback, check to make sure not premature
-		if ( fd == MAX_NUM_FDS && s->m_lastCall + s->m_tick > now ) {
-			s = s->m_next;
-			continue;
-		}
-
 		// skip if not a niceness match
 		if ( niceness == 0 && s->m_niceness != 0 ) {
 			s = s->m_next;
 			continue;
 		}
 
-		// update the lastCall timestamp for this slot
-		if ( fd == MAX_NUM_FDS ) {
-			s->m_lastCall = now;
-		}
-
 		// do the callback
 
 		// NOTE: callback can unregister fd for Slot s, so get next
@@ -447,7 +573,11 @@ void Loop::callCallbacks_ass ( bool forReading , int fd , int64_t now , int32_t
 }
 
 Loop::Loop()
-  : m_callbacksNext(NULL),
+  : m_timersDue(NULL),
+    m_timerWheelTime(0),
+    m_epollFd(-1),
+    m_edgeTriggered(false),
+    m_callbacksNext(NULL),
     m_slotMutex(),
     m_lastKeepaliveTimestamp(0)
 {
@@ -458,13 +588,15 @@ Loop::Loop()
 		m_readSlots [i] = NULL;
 		m_writeSlots[i] = NULL;
 	}
+	for ( int32_t i = 0 ; i < LOOP_TIMER_WHEEL_SIZE ; i++ ) {
+		m_timerWheel[i] = NULL;
+	}
 	// the extra sleep slots
 	//m_readSlots [ MAX_NUM_FDS ] = NULL;
 	m_slots = NULL;
 	m_pipeFd[0] = -1;
 	m_pipeFd[1] = -1;
 	m_shutdown = 0;
-	m_minTick = 40;
 	m_head = NULL;
 	m_tail = NULL;
 }
@@ -480,6 +612,10 @@ Loop::~Loop ( ) {
 		close(m_pipeFd[1]);
 		m_pipeFd[1] = -1;
 	}
+	if(m_epollFd>=0) {
+		close(m_epollFd);
+		m_epollFd = -1;
+	}
 }
 
 // returns NULL and sets g_errno if none are left
@@ -503,8 +639,14 @@ void Loop::returnSlot ( Slot *s ) {
 bool Loop::init ( ) {
 
 	// clear this up here before using in doPoll()
-	FD_ZERO(&s_selectMaskRead);
-	FD_ZERO(&s_selectMaskWrite);
+	memset(s_epollMask, 0, sizeof(s_epollMask));
+
+	m_edgeTriggered = g_conf.m_loopEdgeTriggered;
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(m_epollFd<0) {
+		log(LOG_ERROR,"epoll_create1() failed with errno=%d",errno);
+		return false;
+	}
 
 	// set-up wakeup pipe
 	if(pipe(m_pipeFd)!=0) {
@@ -513,13 +655,20 @@ bool Loop::init ( ) {
 	}
 	setNonBlocking(m_pipeFd[0]);
 	setNonBlocking(m_pipeFd[1]);
-	FD_SET(m_pipeFd[0],&s_selectMaskRead);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = m_pipeFd[0];
+	if(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_pipeFd[0], &ev)!=0) {
+		log(LOG_ERROR,"epoll_ctl() failed with errno=%d",errno);
+		return false;
+	}
 
 	// sighupHandler() will set this to true so we know when to shutdown
 	m_shutdown  = 0;
-	// . reset this cuz we have no sleep callbacks right now
-	// . sleep a min of 40ms so g_now is somewhat up to date
-	m_minTick = 40; //0x7fffffff;
+	// no sleep callbacks right now
+	m_timerWheelTime = getMonotonicMs();
 	// make slots
 	m_slots = (Slot *) mmalloc ( MAX_SLOTS * (int32_t)sizeof(Slot) , "Loop" );
 	if ( ! m_slots ) return false;
@@ -617,13 +766,7 @@ void sighupHandler ( int x , siginfo_t *info , void *y ) {
 	g_loop.m_shutdown = 1;
 }
 
-// . keep a timestamp for the last time we called the sleep callbacks
-// . we have to call those every 1 second
-static int64_t s_lastTime = 0;
-
 void Loop::runLoop ( ) {
-	s_lastTime = 0;
-
 	m_isDoingLoop = true;
 
 	// . now loop forever waiting for signals
@@ -712,55 +855,36 @@ void Loop::doPoll ( ) {
 		InstanceInfoExchange::weAreAlive();
 	}
 
-	int32_t n;
-
-	timeval v;
-	v.tv_sec  = 0;
-	// 10ms for sleepcallbacks so they can be called...
-	// and we need this to be the same as sigalrmhandler() since we
-	// keep track of cpu usage here too, since sigalrmhandler is "VT"
-	// based it only goes off when that much "cpu time" has elapsed.
-	v.tv_usec = 10 * 1000;
+	// hand the disk reads/writes queued since last time to the kernel in one go
+	g_ioUring.submit();
 
-	// gotta copy to our own since bits get cleared by select() function
-	fd_set readfds = s_selectMaskRead;
-	fd_set writefds = s_selectMaskWrite;
+	logDebug( g_conf.m_logDebugLoop, "loop: in epoll_wait" );
 
-	logDebug( g_conf.m_logDebugLoop, "loop: in select" );
-
-	// . poll the fd's searching for socket closes
-	// . the sigalrms and sigvtalrms and SIGCHLDs knock us out of this
-	//   select() with n < 0 and errno equal to EINTR.
-	// . crap the sigalarms kick us out here every 1ms. i noticed
-	//   then when running disableTimer() above and we don't get
-	//   any EINTRs... can we mask those out here? it only seems to be
-	//   the SIGALRMs not the SIGVTALRMs that interrupt us.
-	n = select (MAX_NUM_FDS,
-		    &readfds,
-		    &writefds,
-		    NULL,//&exceptfds,
-		    &v );
+	// . wait for fd events
+	// . 10ms for sleepcallbacks so they can be called...
+	// . signals (SIGPROF etc.) knock us out of this with EINTR
+	int n = epoll_wait(m_epollFd, s_epollEvents, MAX_EPOLL_EVENTS, 10);
 
 	if(n<0) {
-		g_errno = errno;
-		log( LOG_WARN, "loop: select: %s.", strerror( g_errno ) );
+		if(errno != EINTR) {
+			g_errno = errno;
+			log( LOG_WARN, "loop: epoll_wait: %s.", strerror( g_errno ) );
+		}
 		return;
 	}
 	
 	errno = 0;
 
-	logDebug( g_conf.m_logDebugLoop, "loop: select() returned %d", n);
+	logDebug( g_conf.m_logDebugLoop, "loop: epoll_wait() returned %d", n);
 
 	if (g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
-		for ( int32_t i = 0; i < MAX_NUM_FDS; i++) {
-			// continue if not set for reading
-			if ( FD_ISSET ( i, &readfds ) ) {
-				log( LOG_DEBUG, "loop: fd=%" PRId32" is on for read", i);
+		for ( int32_t i = 0; i < n; i++) {
+			if ( s_epollEvents[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP) ) {
+				log( LOG_DEBUG, "loop: fd=%" PRId32" is on for read", (int32_t)s_epollEvents[i].data.fd);
 			}
-			if ( FD_ISSET ( i, &writefds ) ) {
-				log( LOG_DEBUG, "loop: fd=%" PRId32" is on for write", i);
+			if ( s_epollEvents[i].events & (EPOLLOUT|EPOLLERR|EPOLLHUP) ) {
+				log( LOG_DEBUG, "loop: fd=%" PRId32" is on for write", (int32_t)s_epollEvents[i].data.fd);
 			}
-			// if niceness is not -1, handle it below
 		}
 	}
 
@@ -768,105 +892,51 @@ void Loop::doPoll ( ) {
 
 	const int64_t now = gettimeofdayInMilliseconds();
 
-	if( n > 0 && FD_ISSET( m_pipeFd[0], &readfds ) ) {
-		//drain the wakeup pipe
-		char buf[32];
-		ssize_t ignored __attribute__((unused)) = read( m_pipeFd[0], buf, sizeof(buf) ); // shut up gcc warning: ignoring return value
-		n--;
-		FD_CLR( m_pipeFd[0], &readfds );
-	}
-
-	// now keep this fast, too. just check fds we need to.
-	for ( int32_t i = 0 ; i < s_numReadFds ; i++ ) {
-		if ( n == 0 ) break;
-		int fd = s_readFds[i];
-		Slot *s = m_readSlots  [ fd ];
-	 	// if niceness is not 0, handle it below
-		if ( s && s->m_niceness > 0 ) continue;
-		// must be set
-		if ( ! FD_ISSET ( fd , &readfds ) ) continue;
-		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
-			log( LOG_DEBUG, "loop: calling cback0 niceness=%" PRId32" fd=%i", s ? s->m_niceness : -1, fd );
+	// . like select() an error or hangup is reported to both the read and
+	//   the write callbacks
+	// . high priority (niceness 0) fds first
+	for ( int32_t niceness = 0 ; niceness <= 1 ; niceness++ ) {
+		for ( int32_t i = 0 ; i < n ; i++ ) {
+			int fd = s_epollEvents[i].data.fd;
+			if ( fd == m_pipeFd[0] ) {
+				if ( niceness == 0 ) {
+					//drain the wakeup pipe
+					char buf[32];
+					while ( read( m_pipeFd[0], buf, sizeof(buf) ) > 0 )
+						;
+				}
+				continue;
+			}
+			if ( ! ( s_epollEvents[i].events & (EPOLLIN|EPOLLPRI|EPOLLERR|EPOLLHUP) ) ) continue;
+			Slot *s = m_readSlots  [ fd ];
+			// niceness 0 in the first pass, the rest in the second
+			if ( s && ( s->m_niceness > 0 ) != ( niceness > 0 ) ) continue;
+			if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
+				log( LOG_DEBUG, "loop: calling cback%" PRId32" niceness=%" PRId32" fd=%i", niceness, s ? s->m_niceness : -1, fd );
+			}
+			callCallbacks_ass (true,fd, now,niceness);//read?
 		}
-		callCallbacks_ass (true,fd, now,0);//read?
-	}
-	for ( int32_t i = 0 ; i < s_numWriteFds ; i++ ) {
-		if ( n == 0 ) break;
-		int fd = s_writeFds[i];
-		Slot *s = m_writeSlots  [ fd ];
-	 	// if niceness is not 0, handle it below
-		if ( s && s->m_niceness > 0 ) continue;
-		// fds are always ready for writing so take this out.
-		if ( ! FD_ISSET ( fd , &writefds ) ) continue;
-		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
-			log( LOG_DEBUG, "loop: calling wcback0 niceness=%" PRId32" fd=%i", s ? s->m_niceness : -1, fd );
+		for ( int32_t i = 0 ; i < n ; i++ ) {
+			int fd = s_epollEvents[i].data.fd;
+			if ( fd == m_pipeFd[0] ) continue;
+			if ( ! ( s_epollEvents[i].events & (EPOLLOUT|EPOLLERR|EPOLLHUP) ) ) continue;
+			Slot *s = m_writeSlots  [ fd ];
+			// niceness 0 in the first pass, the rest in the second
+			if ( s && ( s->m_niceness > 0 ) != ( niceness > 0 ) ) continue;
+			if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
+				log( LOG_DEBUG, "loop: calling wcback%" PRId32" niceness=%" PRId32" fd=%i", niceness, s ? s->m_niceness : -1, fd );
+			}
+			callCallbacks_ass (false,fd, now,niceness);//false=forRead?
 		}
-		callCallbacks_ass (false,fd, now,0);//false=forRead?
-	}
 
-	cleanupFinishedJobs();
-
-	// now for lower priority fds
-	for ( int32_t i = 0 ; i < s_numReadFds ; i++ ) {
-		if ( n == 0 ) break;
-		int fd = s_readFds[i];
-		Slot *s = m_readSlots  [ fd ];
-	  	// if niceness is <= 0 we did it above
-		if ( s && s->m_niceness <= 0 ) continue;
-		// must be set
-		if ( ! FD_ISSET ( fd , &readfds ) ) continue;
-		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
-			log( LOG_DEBUG, "loop: calling cback1 fd=%i", fd );
-		}
-		callCallbacks_ass (true,fd, now,1);//read?
+		cleanupFinishedJobs();
 	}
 
-	for ( int32_t i = 0 ; i < s_numWriteFds ; i++ ) {
-		if ( n == 0 ) {
-			break;
-		}
-
-	 	int fd = s_writeFds[i];
-		Slot *s = m_writeSlots[fd];
-
-	  	// if niceness is <= 0 we did it above
-	 	if ( s && s->m_niceness <= 0 ) {
-	 		continue;
-	 	}
-	 	// must be set
-	 	if ( ! FD_ISSET ( fd , &writefds ) ) {
-	 		continue;
-	 	}
-		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
-			if( s ) {
-				log( LOG_DEBUG, "loop: calling wcback1 niceness=%" PRId32" fd=%i", s->m_niceness, fd );
-			}
-			else {
-				log( LOG_WARN, "loop: calling wcback1. Slot not found! fd=%i", fd );
-			}
-		}
-		callCallbacks_ass(false, fd, now, 1);//forread?
-	}
+	// call sleepers if they need it
+	callSleepCallbacks(getMonotonicMs());
 
 	cleanupFinishedJobs();
 
-	// call sleepers if they need it
-	// call this every (about) 1 second
-	int32_t elapsed = gettimeofdayInMilliseconds() - s_lastTime;
-	// if someone changed the system clock on us, this could be negative
-	// so fix it! otherwise, times may NEVER get called in our lifetime
-	if ( elapsed < 0 ) {
-		elapsed = m_minTick;
-	}
-
-	if ( elapsed >= m_minTick ) {
-		// MAX_NUM_FDS is the fd for sleep callbacks
-		callCallbacks_ass ( true , MAX_NUM_FDS , gettimeofdayInMilliseconds() );
-		// note the last time we called them
-		s_lastTime = gettimeofdayInMilliseconds();
-		cleanupFinishedJobs();
-	}
-
 	logDebug( g_conf.m_logDebugLoop, "loop: Exited doPoll.");
 }
 
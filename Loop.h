@@ -2,6 +2,10 @@
 
 // . core class for handling interupts-based i/o on non-blocking descriptors
 // . when an fd/state/callback is registered for reading we call your callback //   when fd has a read event (same for write and sleeping)
+// . fds are watched with epoll, level triggered unless the
+//   "loop edge triggered" parm is set
+// . sleep callbacks are kept in a timer wheel so doPoll() only looks at the
+//   ones that are (nearly) due
 
 #ifndef GB_LOOP_H
 #define GB_LOOP_H
@@ -21,8 +25,12 @@ void printStackTrace (bool print_location = false);
 class Slot;
 
 
-// linux 2.2 kernel has this limitation
-#define MAX_NUM_FDS 1024
+// . highest fd + 1 we can register. epoll has no fd_set limit so this only
+//   bounds the per-fd slot arrays
+#define MAX_NUM_FDS 65536
+
+// number of 1ms buckets in the sleep callback timer wheel. power of 2
+#define LOOP_TIMER_WHEEL_SIZE 1024
 
 
 // . niceness can only be 0, 1 or 2
@@ -106,6 +114,17 @@ class Loop {
 				  void (* callback)(int fd,void *state) ,
 				  bool forReading );
 
+	// . make the epoll interest set of fd match its read/write slots
+	// . returns false and sets g_errno on error
+	bool updateEpoll(int fd);
+
+	// add/remove a sleep slot to/from the timer wheel
+	void linkTimer(Slot *s);
+	void unlinkTimer(Slot *s);
+
+	// call the sleep callbacks that are due
+	void callSleepCallbacks(int64_t now);
+
 	bool addSlot(bool forReading, int fd, void *state, void (*callback)(int fd, void *state),
 	             int32_t niceness, const char *description, int32_t tick = 0x7fffffff, bool immediate = false);
 
@@ -125,8 +144,14 @@ class Loop {
 	Slot *m_readSlots  [MAX_NUM_FDS+2];
 	Slot *m_writeSlots [MAX_NUM_FDS+2];
 
-	// the minimal tick time in milliseconds (ms)
-	int32_t m_minTick;
+	// . sleep slots hashed by the ms they are due in
+	// . m_timerWheelTime is the last ms we called sleep callbacks for
+	Slot *m_timerWheel[LOOP_TIMER_WHEEL_SIZE];
+	Slot *m_timersDue;
+	int64_t m_timerWheelTime;
+
+	int m_epollFd;
+	bool m_edgeTriggered;
 
 	// now we pre-allocate our slots to prevent nasty coredumps from merge
 	// because it could not register a sleep callback with us
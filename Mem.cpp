@@ -10,6 +10,10 @@
 #include "Conf.h"
 #include "Sanity.h"
 #include <string.h>            //for strlen()
+#include <atomic>
+#include <algorithm>
+#include <pthread.h>
+#include <execinfo.h>
 
 
 // only Mem.cpp should call ::malloc, everyone else must call mmalloc() so
@@ -32,6 +36,29 @@
 
 static const char MAGICCHAR = (char)0xda;
 
+// . every block has this in front of it so a free knows the size and note of
+//   the block without looking it up in the global table
+// . the underpad of *alloc() blocks is the end of the header so new'd and
+//   *alloc()'ed mem both stay 16 byte aligned
+struct MemHeader {
+	uint64_t m_size    : 48;
+	uint64_t m_noteIdx : 16;
+	uint8_t  m_magic;
+	uint8_t  m_flags;
+	uint16_t m_sampleSlot;
+	char     m_underpad[UNDERPAD];
+};
+static_assert(sizeof(MemHeader) == 16, "MemHeader must be 16 bytes");
+
+static const uint8_t MEMHEADER_MAGIC = 0xa7;
+#define MEMF_NEW     0x01
+#define MEMF_TABLE   0x02 // in the leak table
+#define MEMF_SAMPLED 0x04 // in the sample table
+
+static inline MemHeader *getMemHeader(void *mem) {
+	return (MemHeader *)mem - 1;
+}
+
 class Mem g_mem;
 
 
@@ -55,6 +82,269 @@ static int32_t   s_n = 0;
 static bool   s_initialized = 0;
 
 
+// . per note counters. notes are interned into s_notes[] by the hash of
+//   their first 15 chars, like the labels of the leak table. slot 0 is for
+//   notes that didn't fit
+// . all of these are zero-initialized statics because operator new is called
+//   before the Mem constructor runs
+#define MEM_MAX_NOTES   2048
+#define MEM_NOTE_CACHE  256
+// publish a thread's used mem once it is off by this much
+#define MEM_FLUSH_BYTES (256*1024)
+
+struct MemNote {
+	std::atomic<uint32_t> m_hash;
+	std::atomic<bool>     m_ready;
+	char                  m_label[16];
+};
+static MemNote s_notes[MEM_MAX_NOTES];
+
+// . counters of a thread. only the owning thread writes them, so they are
+//   updated without a lock or atomic read-modify-write. a free on another
+//   thread counts there, so a single thread's counters can go negative,
+//   only the sums over all threads mean anything
+// . released when the thread exits and reused by the next new thread
+struct MemThreadStats {
+	std::atomic<int64_t> m_bytes[MEM_MAX_NOTES];
+	std::atomic<int64_t> m_allocs[MEM_MAX_NOTES];
+	std::atomic<int64_t> m_numAllocated;
+	std::atomic<int64_t> m_numTotalAllocated;
+	std::atomic<bool>    m_inUse;
+	MemThreadStats      *m_next;
+	int64_t              m_usedDelta;
+	int32_t              m_sampleCountdown;
+	// note ptr -> s_notes[] slot
+	const char          *m_cacheNote[MEM_NOTE_CACHE];
+	uint16_t             m_cacheIdx[MEM_NOTE_CACHE];
+};
+
+static std::atomic<MemThreadStats *> s_threadStatsList;
+// used when we can't allocate a block for a thread. not thread safe but
+// counters are estimates anyway
+static MemThreadStats s_fallbackStats;
+static __thread MemThreadStats *s_threadStats = NULL;
+static pthread_key_t s_threadStatsKey;
+static pthread_once_t s_threadStatsOnce = PTHREAD_ONCE_INIT;
+
+static std::atomic<int64_t> s_used;
+static std::atomic<int64_t> s_maxAllocated;
+
+
+static inline void addCount(std::atomic<int64_t> &counter, int64_t delta) {
+	counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+static void flushUsed(MemThreadStats *ts) {
+	int64_t used = s_used.fetch_add(ts->m_usedDelta, std::memory_order_relaxed) + ts->m_usedDelta;
+	ts->m_usedDelta = 0;
+
+	int64_t maxAllocated = s_maxAllocated.load(std::memory_order_relaxed);
+	while ( used > maxAllocated &&
+		! s_maxAllocated.compare_exchange_weak(maxAllocated, used, std::memory_order_relaxed) ) {
+	}
+}
+
+static void releaseThreadStats(void *arg) {
+	MemThreadStats *ts = (MemThreadStats *)arg;
+	flushUsed(ts);
+	s_threadStats = NULL;
+	ts->m_inUse.store(false, std::memory_order_release);
+}
+
+static void initThreadStatsKey() {
+	pthread_key_create(&s_threadStatsKey, releaseThreadStats);
+}
+
+static MemThreadStats *getThreadStats() {
+	if ( s_threadStats ) {
+		return s_threadStats;
+	}
+
+	pthread_once(&s_threadStatsOnce, initThreadStatsKey);
+
+	// reuse the block of an exited thread
+	MemThreadStats *ts = NULL;
+	for ( MemThreadStats *p = s_threadStatsList.load(std::memory_order_acquire); p; p = p->m_next ) {
+		bool inUse = false;
+		if ( ! p->m_inUse.load(std::memory_order_relaxed) &&
+		     p->m_inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire) ) {
+			ts = p;
+			break;
+		}
+	}
+
+	if ( ! ts ) {
+		ts = (MemThreadStats *)syscalloc(1, sizeof(MemThreadStats));
+		if ( ! ts ) {
+			return &s_fallbackStats;
+		}
+		ts->m_inUse.store(true, std::memory_order_relaxed);
+		MemThreadStats *head = s_threadStatsList.load(std::memory_order_relaxed);
+		do {
+			ts->m_next = head;
+		} while ( ! s_threadStatsList.compare_exchange_weak(head, ts, std::memory_order_release, std::memory_order_relaxed) );
+	}
+
+	pthread_setspecific(s_threadStatsKey, ts);
+	s_threadStats = ts;
+	return ts;
+}
+
+// returns the s_notes[] slot of "note", 0 if the table is full
+static int32_t internNote(const char *note) {
+	char label[16];
+	int32_t len = strnlen(note, 15);
+	memcpy(label, note, len);
+	label[len] = '\0';
+
+	uint32_t h = hash32n(label);
+	if ( h == 0 ) h = 1;
+
+	int32_t slot = h % MEM_MAX_NOTES;
+	for ( int32_t count = 0 ; count < MEM_MAX_NOTES ; count++ ) {
+		if ( slot == 0 ) slot = 1;
+		uint32_t cur = s_notes[slot].m_hash.load(std::memory_order_acquire);
+		if ( cur == 0 ) {
+			if ( s_notes[slot].m_hash.compare_exchange_strong(cur, h, std::memory_order_acq_rel) ) {
+				memcpy(s_notes[slot].m_label, label, len + 1);
+				s_notes[slot].m_ready.store(true, std::memory_order_release);
+				return slot;
+			}
+			// someone else took it, cur is their hash now
+		}
+		if ( cur == h ) {
+			return slot;
+		}
+		if ( ++slot >= MEM_MAX_NOTES ) slot = 1;
+	}
+
+	return 0;
+}
+
+static int32_t getNoteIdx(MemThreadStats *ts, const char *note) {
+	if ( ! note || ! note[0] ) {
+		return 0;
+	}
+
+	// most notes are string literals, so remember their slot by address
+	uint32_t c = ((uintptr_t)note >> 3) % MEM_NOTE_CACHE;
+	if ( ts->m_cacheNote[c] == note ) {
+		int32_t idx = ts->m_cacheIdx[c];
+		// the note may be a buffer that was reused for another label
+		if ( s_notes[idx].m_ready.load(std::memory_order_acquire) &&
+		     strncmp(s_notes[idx].m_label, note, 15) == 0 ) {
+			return idx;
+		}
+	}
+
+	int32_t idx = internNote(note);
+	ts->m_cacheNote[c] = note;
+	ts->m_cacheIdx[c] = idx;
+	return idx;
+}
+
+static const char *getNoteLabel(int32_t idx) {
+	if ( idx == 0 || ! s_notes[idx].m_ready.load(std::memory_order_acquire) ) {
+		return "other";
+	}
+	return s_notes[idx].m_label;
+}
+
+
+// . sampled allocations, 1 in g_conf.m_memSampleRate, with the stack that
+//   allocated them. the slot is kept in the mem header
+// . the lock is only taken for sampled allocations
+#define MEM_MAX_SAMPLES   16384
+#define MEM_SAMPLE_FRAMES 10
+
+struct MemSample {
+	void    *m_ptr;
+	size_t   m_size;
+	int64_t  m_time;
+	int32_t  m_noteIdx;
+	int32_t  m_numFrames;
+	void    *m_frames[MEM_SAMPLE_FRAMES];
+	int32_t  m_nextFree;
+};
+
+static GbMutex s_sampleLock;
+static MemSample *s_samples = NULL;
+static int32_t s_sampleFreeHead = 0;
+static int32_t s_numSamples = 0;
+
+// returns the sample slot, 0 if the table is full
+static int32_t addSample(void *mem, size_t size, int32_t noteIdx) {
+	// skip ourselves and Mem::addMem()
+	void *frames[MEM_SAMPLE_FRAMES + 2];
+	int numFrames = backtrace(frames, MEM_SAMPLE_FRAMES + 2) - 2;
+	if ( numFrames < 0 ) numFrames = 0;
+
+	int64_t now = gettimeofdayInMilliseconds();
+
+	ScopedLock sl(s_sampleLock);
+	if ( ! s_samples ) {
+		s_samples = (MemSample *)syscalloc(MEM_MAX_SAMPLES, sizeof(MemSample));
+		if ( ! s_samples ) {
+			return 0;
+		}
+		// slot 0 means not sampled
+		for ( int32_t i = 1 ; i < MEM_MAX_SAMPLES ; i++ ) {
+			s_samples[i].m_nextFree = ( i + 1 < MEM_MAX_SAMPLES ) ? i + 1 : 0;
+		}
+		s_sampleFreeHead = 1;
+	}
+
+	int32_t slot = s_sampleFreeHead;
+	if ( slot == 0 ) {
+		return 0;
+	}
+	MemSample *sample = &s_samples[slot];
+	s_sampleFreeHead = sample->m_nextFree;
+	s_numSamples++;
+
+	sample->m_ptr = mem;
+	sample->m_size = size;
+	sample->m_time = now;
+	sample->m_noteIdx = noteIdx;
+	sample->m_numFrames = numFrames;
+	memcpy(sample->m_frames, frames + 2, numFrames * sizeof(void *));
+	sample->m_nextFree = 0;
+	return slot;
+}
+
+static void rmSample(int32_t slot) {
+	ScopedLock sl(s_sampleLock);
+	MemSample *sample = &s_samples[slot];
+	sample->m_ptr = NULL;
+	sample->m_nextFree = s_sampleFreeHead;
+	s_sampleFreeHead = slot;
+	s_numSamples--;
+}
+
+static void relabelSample(int32_t slot, int32_t noteIdx) {
+	ScopedLock sl(s_sampleLock);
+	s_samples[slot].m_noteIdx = noteIdx;
+}
+
+// check the padding of a block that is not in the table
+static void checkBreech(const char *mem, size_t size, const char *note) {
+	for ( int32_t j = 0 ; j < UNDERPAD ; j++ ) {
+		if ( mem[0-j-1] != MAGICCHAR ) {
+			log(LOG_LOGIC,"mem: underrun at %" PTRFMT" loff=%" PRId32" size=%zu note=%s",
+			    (PTRTYPE)mem,0-j-1,size,note);
+			gbshutdownCorrupted();
+		}
+	}
+	for ( int32_t j = 0 ; j < OVERPAD ; j++ ) {
+		if ( mem[size+j] != MAGICCHAR ) {
+			log(LOG_LOGIC,"mem: overrun  at 0x%" PTRFMT" (size=%zu) roff=%" PRId32" note=%s",
+			    (PTRTYPE)mem,size,j,note);
+			gbshutdownCorrupted();
+		}
+	}
+}
+
+
 //note: the ScopedMemoryLimitBypass is not thread-safe. The "bypass" flag should really
 //be per-thread. Or RdbBase should be reworked to use another technique than artificially
 //raising the memory limit while adding a file.
@@ -98,10 +388,38 @@ void operator delete [] ( void *ptr ) throw () {
 #define MINMEM 6000000
 
 
+// . relabel mem we got from operator new as "note"
+// . new[] of objects with destructors returns a ptr past the array cookie,
+//   that has no header so it keeps counting as TMPMEM
 void Mem::addnew ( void *ptr , size_t size , const char *note ) {
 	logTrace( g_conf.m_logTraceMem, "ptr=%p size=%zu note=%s", ptr, size, note );
-	// 1 --> isnew
-	addMem ( ptr , size , note , 1 );
+
+	if ( ! ptr ) {
+		return;
+	}
+
+	MemHeader *hdr = getMemHeader(ptr);
+	if ( hdr->m_magic != MEMHEADER_MAGIC || ! ( hdr->m_flags & MEMF_NEW ) || hdr->m_size != size ) {
+		logDebug( g_conf.m_logDebugMem, "mem: addnew: no header for %p (%s)", ptr, note );
+		return;
+	}
+
+	MemThreadStats *ts = getThreadStats();
+	int32_t oldIdx = hdr->m_noteIdx;
+	int32_t newIdx = getNoteIdx(ts, note);
+	addCount(ts->m_bytes[oldIdx], -(int64_t)size);
+	addCount(ts->m_allocs[oldIdx], -1);
+	addCount(ts->m_bytes[newIdx], size);
+	addCount(ts->m_allocs[newIdx], 1);
+	hdr->m_noteIdx = newIdx;
+
+	if ( hdr->m_flags & MEMF_TABLE ) {
+		// relabels the TMPMEM entry
+		addToTable ( ptr , size , note , 1 );
+	}
+	if ( hdr->m_flags & MEMF_SAMPLED ) {
+		relabelSample(hdr->m_sampleSlot, newIdx);
+	}
 }
 
 void Mem::delnew ( void *ptr , size_t size , const char *note ) {
@@ -144,7 +462,7 @@ void * operator new (size_t size) throw (std::bad_alloc) {
 		throw std::bad_alloc();
 	}
 
-	void *mem = sysmalloc ( size );
+	void *mem = sysmalloc ( sizeof(MemHeader) + size );
 
 	if ( ! mem && size > 0 ) {
 		g_mem.incrementOOMCount();
@@ -154,6 +472,7 @@ void * operator new (size_t size) throw (std::bad_alloc) {
 		//return NULL;
 	}
 
+	mem = (char *)mem + sizeof(MemHeader);
 	g_mem.addMem ( mem , size , "TMPMEM" , 1 );
 
 	return mem;
@@ -176,7 +495,7 @@ void * operator new [] (size_t size) throw (std::bad_alloc) {
 		//throw 1;
 	}
 
-	void *mem = sysmalloc ( size );
+	void *mem = sysmalloc ( sizeof(MemHeader) + size );
 
 
 	if ( ! mem && size > 0 ) {
@@ -186,6 +505,7 @@ void * operator new [] (size_t size) throw (std::bad_alloc) {
 		throw std::bad_alloc();
 	}
 
+	mem = (char *)mem + sizeof(MemHeader);
 	g_mem.addMem ( (char*)mem , size, "TMPMEM" , 1 );
 
 	return mem;
@@ -193,13 +513,9 @@ void * operator new [] (size_t size) throw (std::bad_alloc) {
 
 
 Mem::Mem() {
-	m_used = 0;
-	m_numAllocated = 0;
-	m_numTotalAllocated = 0;
 	// DO NOT INIT THIS:	m_memtablesize = 0;
 	m_maxAlloc = 0;
 	m_maxAllocBy = "";
-	m_maxAllocated = 0;
 
 	// count how many allocs/news failed
 	m_outOfMems = 0;
@@ -213,8 +529,30 @@ Mem::~Mem() {
 
 
 size_t Mem::getUsedMem () const {
-	ScopedLock sl(s_lock);
-	return m_used;
+	int64_t used = s_used.load(std::memory_order_relaxed);
+	return used > 0 ? used : 0;
+}
+
+size_t Mem::getMaxAllocated() const {
+	return s_maxAllocated.load(std::memory_order_relaxed);
+}
+
+int32_t Mem::getNumAllocated() const {
+	int64_t n = 0;
+	for ( MemThreadStats *ts = s_threadStatsList.load(std::memory_order_acquire); ts; ts = ts->m_next ) {
+		n += ts->m_numAllocated.load(std::memory_order_relaxed);
+	}
+	n += s_fallbackStats.m_numAllocated.load(std::memory_order_relaxed);
+	return (int32_t)n;
+}
+
+int64_t Mem::getNumTotalAllocated() const {
+	int64_t n = 0;
+	for ( MemThreadStats *ts = s_threadStatsList.load(std::memory_order_acquire); ts; ts = ts->m_next ) {
+		n += ts->m_numTotalAllocated.load(std::memory_order_relaxed);
+	}
+	n += s_fallbackStats.m_numTotalAllocated.load(std::memory_order_relaxed);
+	return n;
 }
 
 
@@ -224,16 +562,13 @@ size_t Mem::getMaxMem() const {
 
 
 float Mem::getUsedMemPercentage() const {
-	ScopedLock sl(s_lock);
-	int64_t used_mem = m_used;
+	int64_t used_mem = getUsedMem();
 	int64_t max_mem = g_conf.m_maxMem;
-	sl.unlock();
 	return ((float)used_mem) * 100.0 / ((float)max_mem);
 }
 
 int64_t Mem::getFreeMem() const {
-	ScopedLock sl(s_lock);
-	return g_conf.m_maxMem - m_used;
+	return g_conf.m_maxMem - (int64_t)getUsedMem();
 }
 
 bool Mem::init  ( ) {
@@ -242,19 +577,76 @@ bool Mem::init  ( ) {
 
 	// reset this, our max mem used over time ever because we don't
 	// want the mem test we did above to count towards it
-	m_maxAllocated = 0;
+	s_maxAllocated.store(0, std::memory_order_relaxed);
 
 	return true;
 }
 
 
-// this is called after a memory block has been allocated and needs to be registered
+// . this is called after a memory block has been allocated and needs to be
+//   registered
+// . "mem" must be preceded by a MemHeader
 void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
-	if(!s_lock.working) return;
+	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s' is_new=%d", mem, size, note, isnew );
 
-	ScopedLock sl(s_lock);
+	// copy the magic character, iff not a new() call
+	if ( size == 0 ) {
+		gbshutdownLogicError();
+	}
 
-	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s' is_new=%d", mem, size, note, isnew );
+	MemHeader *hdr = getMemHeader(mem);
+	hdr->m_size = size;
+	hdr->m_magic = MEMHEADER_MAGIC;
+	hdr->m_flags = isnew ? MEMF_NEW : 0;
+	hdr->m_sampleSlot = 0;
+	for ( int32_t i = 0 ; i < UNDERPAD ; i++ )
+		hdr->m_underpad[i] = MAGICCHAR;
+	if ( ! isnew ) {
+		for ( int32_t i = 0 ; i < OVERPAD ; i++ )
+			((char *)mem)[0+size+i] = MAGICCHAR;
+	}
+
+	MemThreadStats *ts = getThreadStats();
+	int32_t noteIdx = getNoteIdx(ts, note);
+	hdr->m_noteIdx = noteIdx;
+
+	addCount(ts->m_bytes[noteIdx], size);
+	addCount(ts->m_allocs[noteIdx], 1);
+	addCount(ts->m_numAllocated, 1);
+	addCount(ts->m_numTotalAllocated, 1);
+	ts->m_usedDelta += size;
+	if ( ts->m_usedDelta >= MEM_FLUSH_BYTES || size >= MEM_FLUSH_BYTES ) {
+		flushUsed(ts);
+	}
+
+	// racy, but only an estimate
+	if ( size > m_maxAlloc ) { m_maxAlloc = size; m_maxAllocBy = note; }
+
+	// debug
+	if ( (size > MINMEM && g_conf.m_logDebugMemUsage) || size>=100000000 )
+		log(LOG_INFO,"mem: addMem(%zu): %s. ptr=0x%" PTRFMT" "
+		    "used=%zu",
+		    size,note,(PTRTYPE)mem,getUsedMem());
+
+	if ( g_conf.m_memTableTracking && s_lock.working ) {
+		hdr->m_flags |= MEMF_TABLE;
+		addToTable ( mem , size , note , isnew );
+	}
+
+	int32_t sampleRate = g_conf.m_memSampleRate;
+	if ( sampleRate > 0 && --ts->m_sampleCountdown <= 0 ) {
+		ts->m_sampleCountdown = sampleRate;
+		int32_t slot = addSample(mem, size, noteIdx);
+		if ( slot ) {
+			hdr->m_sampleSlot = slot;
+			hdr->m_flags |= MEMF_SAMPLED;
+		}
+	}
+}
+
+// add to the leak detecting table
+void Mem::addToTable ( void *mem , size_t size , const char *note , char isnew ) {
+	ScopedLock sl(s_lock);
 
 	//validate();
 
@@ -269,7 +661,7 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 		//if ( m_maxMem < 8000000000 ) gbshutdownLogicError();
 	}
 
-	if ( (int32_t)m_numAllocated + 100 >= (int32_t)m_memtablesize ) { 
+	if ( s_n + 100 >= (int32_t)m_memtablesize ) { 
 		static bool s_printed = false;
 		if ( ! s_printed ) {
 			log(LOG_WARN, "mem: using too many slots");
@@ -278,19 +670,13 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 		}
 	}
 
-	logDebug( g_conf.m_logDebugMem, "mem: add %08" PTRFMT" %zu bytes (%" PRId64") (%s)", (PTRTYPE)mem, size, m_used, note );
+	logDebug( g_conf.m_logDebugMem, "mem: add %08" PTRFMT" %zu bytes (%zu) (%s)", (PTRTYPE)mem, size, getUsedMem(), note );
 
 	// check for breech after every call to alloc or free in order to
 	// more easily isolate breeching code.. this slows things down a lot
 	// though.
 	if ( g_conf.m_logDebugMem ) printBreeches_unlocked();
 
-	// copy the magic character, iff not a new() call
-	if ( size == 0 ) {
-		sl.unlock();
-		gbshutdownLogicError();
-	}
-
 	// sanity check -- for machines with > 4GB ram?
 	if ( (PTRTYPE)mem + (PTRTYPE)size < (PTRTYPE)mem ) {
 		log(LOG_LOGIC,"mem: Kernel returned mem at "
@@ -301,16 +687,6 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 		gbshutdownLogicError();
 	}
 
-	// umsg00
-//	bool useElectricFence = false;
-//	if ( ! isnew && ! useElectricFence ) {
-	if ( ! isnew ) {
-		for ( int32_t i = 0 ; i < UNDERPAD ; i++ )
-			((char *)mem)[0-i-1] = MAGICCHAR;
-		for ( int32_t i = 0 ; i < OVERPAD ; i++ )
-			((char *)mem)[0+size+i] = MAGICCHAR;
-	}
-
 	// if no label!
 	if ( ! note[0] ) log(LOG_LOGIC,"mem: addmem: NO note.");
 
@@ -327,7 +703,8 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 			if ( s_labels ) sysfree ( s_labels );
 			if ( s_isnew  ) sysfree ( s_isnew );
 			log(LOG_WARN, "mem: addMem: Init failed. Disabling checks.");
-			g_conf.m_detectMemLeaks = false;
+			g_conf.m_memTableTracking = false;
+			getMemHeader(mem)->m_flags &= ~MEMF_TABLE;
 			return;
 		}
 		s_initialized = true;
@@ -336,6 +713,7 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 	// try to add ptr/size/note to leak-detecting table
 	if ( (int32_t)s_n > (int32_t)m_memtablesize ) {
 		log( LOG_WARN, "mem: addMem: No room in table for %s size=%zu.", note,size);
+		getMemHeader(mem)->m_flags &= ~MEMF_TABLE;
 		return;
 	}
 	// hash into table
@@ -388,18 +766,6 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 	//log("adding %" PRId32" size=%" PRId32" to [%" PRId32"] #%" PRId32" (%s)",
 	//(int32_t)mem,size,h,s_n,note);
 	s_n++;
-	// debug
-	if ( (size > MINMEM && g_conf.m_logDebugMemUsage) || size>=100000000 )
-		log(LOG_INFO,"mem: addMem(%zu): %s. ptr=0x%" PTRFMT" "
-		    "used=%" PRId64,
-		    size,note,(PTRTYPE)mem,m_used);
-	// now update used mem
-	// we do this here now since we always call addMem() now
-	m_used += size;
-	m_numAllocated++;
-	m_numTotalAllocated++;
-	if ( size > m_maxAlloc ) { m_maxAlloc = size; m_maxAllocBy = note; }
-	if ( m_used > m_maxAllocated ) m_maxAllocated = m_used;
 
 
  skipMe:
@@ -417,15 +783,17 @@ void Mem::addMem ( void *mem , size_t size , const char *note , char isnew ) {
 
 class MemEntry {
 public:
-	int32_t  m_hash;
-	char *m_label;
-	int32_t  m_allocated;
-	int32_t  m_numAllocs;
+	const char *m_label;
+	int64_t  m_allocated;
+	int64_t  m_numAllocs;
 };
 
-// print out the mem table
-// but combine allocs with the same label
-// sort by mem allocated
+static bool cmpMemEntry(const MemEntry &a, const MemEntry &b) {
+	return a.m_allocated > b.m_allocated;
+}
+
+// . print out the mem usage by note, from the per thread counters
+// . sort by mem allocated
 bool Mem::printMemBreakdownTable(SafeBuf *sb) {
 	sb->safePrintf (
 		       "<table>"
@@ -442,106 +810,179 @@ bool Mem::printMemBreakdownTable(SafeBuf *sb) {
 		       "</tr>" ,
 		       TABLE_STYLE, DARK_BLUE, DARK_BLUE );
 
-	int32_t n = m_numAllocated * 2;
-	MemEntry *e = (MemEntry *)mcalloc ( sizeof(MemEntry) * n , "Mem" );
+	MemEntry *e = (MemEntry *)mcalloc ( sizeof(MemEntry) * MEM_MAX_NOTES , "Mem" );
 	if ( ! e ) {
 		log(LOG_WARN, "admin: Could not alloc %" PRId32" bytes for mem table.",
-		    (int32_t)sizeof(MemEntry)*n);
+		    (int32_t)sizeof(MemEntry)*MEM_MAX_NOTES);
 		return false;
 	}
 
-	// hash em up, combine allocs of like label together for this hash
-	for ( int32_t i = 0 ; i < (int32_t)m_memtablesize ; i++ ) {
-		// skip empty buckets
-		if ( ! s_mptrs[i] ) continue;
-		// get label ptr, use as a hash
-		char *label = &s_labels[i*16];
-		int32_t  h     = hash32n ( label );
-		if ( h == 0 ) h = 1;
-		// accumulate the size
-		int32_t b = (uint32_t)h % n;
-		// . chain till we find it or hit empty
-		// . use the label as an indicator if bucket is full or empty
-		while ( e[b].m_hash && e[b].m_hash != h )
-			if ( ++b >= n ) b = 0;
-		// add it in
-		e[b].m_hash       = h;
-		e[b].m_label      = label;
-		e[b].m_allocated += s_sizes[i];
-		e[b].m_numAllocs++;
-	}
-
-	// get the top 20 users of mem
-	MemEntry *winners [ PRINT_TOP ];
-
-	int32_t i = 0;
-	int32_t count = 0;
-	for ( ; i < n && count < PRINT_TOP ; i++ )
-		// if non-empty, add to winners array
-		if ( e[i].m_hash ) winners [ count++ ] = &e[i];
-
-	// compute new min
-	int32_t min  = 0x7fffffff;
-	int32_t mini = -1000;
-	for ( int32_t j = 0 ; j < count ; j++ ) {
-		if ( winners[j]->m_allocated > min ) continue;
-		min  = winners[j]->m_allocated;
-		mini = j;
-	}
-
-	// now the rest must compete
-	for ( ; i < n ; i++ ) {
-		// if empty skip
-		if ( ! e[i].m_hash ) continue;
-		//if ( e[i].m_allocated > 120 && e[i].m_allocated < 2760 )
-		//	log("hey %" PRId32, e[i].m_allocated);
-		// skip if not a winner
-		if ( e[i].m_allocated <= min ) continue;
-		// replace the lowest winner
-		winners[mini] = &e[i];
-		// compute new min
-		min = 0x7fffffff;
-		for ( int32_t j = 0 ; j < count ; j++ ) {
-			if ( winners[j]->m_allocated > min ) continue;
-			min  = winners[j]->m_allocated;
-			mini = j;
+	// add up the threads
+	for ( MemThreadStats *ts = s_threadStatsList.load(std::memory_order_acquire); ; ts = ts->m_next ) {
+		if ( ! ts ) ts = &s_fallbackStats;
+		for ( int32_t i = 0 ; i < MEM_MAX_NOTES ; i++ ) {
+			e[i].m_allocated += ts->m_bytes[i].load(std::memory_order_relaxed);
+			e[i].m_numAllocs += ts->m_allocs[i].load(std::memory_order_relaxed);
 		}
+		if ( ts == &s_fallbackStats ) break;
 	}
 
-	// now sort them
-	bool flag = true;
-	while ( flag ) {
-		flag = false;
-		for ( int32_t i = 1 ; i < count ; i++ ) {
-			// no need to swap?
-			if ( winners[i-1]->m_allocated >= 
-			     winners[i]->m_allocated ) continue;
-			// swap
-			flag = true;
-			MemEntry *tmp = winners[i-1];
-			winners[i-1]  = winners[i];
-			winners[i  ]  = tmp;
-		}
+	int32_t count = 0;
+	for ( int32_t i = 0 ; i < MEM_MAX_NOTES ; i++ ) {
+		if ( e[i].m_numAllocs <= 0 && e[i].m_allocated <= 0 ) continue;
+		e[count].m_label     = getNoteLabel(i);
+		e[count].m_allocated = e[i].m_allocated;
+		e[count].m_numAllocs = e[i].m_numAllocs;
+		count++;
 	}
-			
+
+	std::sort(e, e + count, cmpMemEntry);
+	if ( count > PRINT_TOP ) count = PRINT_TOP;
+
 	// now print into buffer
 	for ( int32_t i = 0 ; i < count ; i++ ) 
 		sb->safePrintf (
 			       "<tr bgcolor=%s>"
 			       "<td>%s</td>"
-			       "<td>%" PRId32"</td>"
-			       "<td>%" PRId32"</td>"
+			       "<td>%" PRId64"</td>"
+			       "<td>%" PRId64"</td>"
 			       "</tr>\n",
 			       LIGHT_BLUE,
-			       winners[i]->m_label,
-			       winners[i]->m_numAllocs,
-			       winners[i]->m_allocated);
+			       e[i].m_label,
+			       e[i].m_numAllocs,
+			       e[i].m_allocated);
 
 	sb->safePrintf ( "</table>\n");
 
 	// don't forget to release this mem
-	mfree ( e , (int32_t)sizeof(MemEntry) * n , "Mem" );
+	mfree ( e , (int32_t)sizeof(MemEntry) * MEM_MAX_NOTES , "Mem" );
+
+	return printSampleTable(sb);
+}
+
+
+class MemSampleGroup {
+public:
+	int32_t  m_first; // index into the sorted samples
+	int32_t  m_numSamples;
+	int64_t  m_allocated;
+	int64_t  m_oldest;
+};
+
+static bool cmpSampleStack(const MemSample &a, const MemSample &b) {
+	if ( a.m_noteIdx != b.m_noteIdx ) return a.m_noteIdx < b.m_noteIdx;
+	if ( a.m_numFrames != b.m_numFrames ) return a.m_numFrames < b.m_numFrames;
+	return memcmp(a.m_frames, b.m_frames, a.m_numFrames * sizeof(void *)) < 0;
+}
+
+static bool sameSampleStack(const MemSample &a, const MemSample &b) {
+	return a.m_noteIdx == b.m_noteIdx &&
+	       a.m_numFrames == b.m_numFrames &&
+	       memcmp(a.m_frames, b.m_frames, a.m_numFrames * sizeof(void *)) == 0;
+}
+
+static bool cmpSampleGroup(const MemSampleGroup &a, const MemSampleGroup &b) {
+	return a.m_allocated > b.m_allocated;
+}
+
+// . print the live sampled allocations grouped by note and stack, biggest
+//   first, so a leak shows up as a group that keeps growing and getting older
+// . we use the system allocator here so we don't sample ourselves
+bool Mem::printSampleTable(SafeBuf *sb) {
+	int32_t sampleRate = g_conf.m_memSampleRate;
+	if ( sampleRate <= 0 ) {
+		return true;
+	}
+
+	MemSample *samples = (MemSample *)sysmalloc(MEM_MAX_SAMPLES * sizeof(MemSample));
+	MemSampleGroup *groups = (MemSampleGroup *)sysmalloc(MEM_MAX_SAMPLES * sizeof(MemSampleGroup));
+	if ( ! samples || ! groups ) {
+		if ( samples ) sysfree(samples);
+		if ( groups ) sysfree(groups);
+		log(LOG_WARN, "admin: Could not alloc mem for sample table.");
+		return false;
+	}
+
+	int32_t numSamples = 0;
+	ScopedLock sl(s_sampleLock);
+	for ( int32_t i = 1 ; s_samples && i < MEM_MAX_SAMPLES ; i++ ) {
+		if ( s_samples[i].m_ptr ) {
+			samples[numSamples++] = s_samples[i];
+		}
+	}
+	sl.unlock();
+
+	std::sort(samples, samples + numSamples, cmpSampleStack);
+
+	int32_t numGroups = 0;
+	for ( int32_t i = 0 ; i < numSamples ; i++ ) {
+		if ( i == 0 || ! sameSampleStack(samples[i-1], samples[i]) ) {
+			MemSampleGroup *g = &groups[numGroups++];
+			g->m_first = i;
+			g->m_numSamples = 0;
+			g->m_allocated = 0;
+			g->m_oldest = samples[i].m_time;
+		}
+		MemSampleGroup *g = &groups[numGroups-1];
+		g->m_numSamples++;
+		g->m_allocated += samples[i].m_size;
+		if ( samples[i].m_time < g->m_oldest ) g->m_oldest = samples[i].m_time;
+	}
+
+	std::sort(groups, groups + numGroups, cmpSampleGroup);
+	if ( numGroups > PRINT_TOP ) numGroups = PRINT_TOP;
+
+	sb->safePrintf (
+		       "<br><table %s>"
+		       "<tr>"
+		       "<td colspan=5 bgcolor=#%s>"
+		       "<center><b>Sampled Allocations (1 in %" PRId32")</b></td></tr>\n"
+
+		       "<tr bgcolor=#%s>"
+		       "<td><b>allocator</b></td>"
+		       "<td><b>samples</b></td>"
+		       "<td><b>est. allocated</b></td>"
+		       "<td><b>oldest (s)</b></td>"
+		       "<td><b>stack</b></td>"
+		       "</tr>" ,
+		       TABLE_STYLE, DARK_BLUE, sampleRate, DARK_BLUE );
+
+	int64_t now = gettimeofdayInMilliseconds();
+	for ( int32_t i = 0 ; i < numGroups ; i++ ) {
+		const MemSampleGroup *g = &groups[i];
+		const MemSample *sample = &samples[g->m_first];
+
+		sb->safePrintf (
+			       "<tr bgcolor=%s>"
+			       "<td>%s</td>"
+			       "<td>%" PRId32"</td>"
+			       "<td>%" PRId64"</td>"
+			       "<td>%" PRId64"</td>"
+			       "<td><small>",
+			       LIGHT_BLUE,
+			       getNoteLabel(sample->m_noteIdx),
+			       g->m_numSamples,
+			       g->m_allocated * sampleRate,
+			       ( now - g->m_oldest ) / 1000 );
+
+		char **symbols = backtrace_symbols(sample->m_frames, sample->m_numFrames);
+		for ( int32_t j = 0 ; j < sample->m_numFrames ; j++ ) {
+			if ( symbols ) {
+				sb->htmlEncode(symbols[j]);
+				sb->safePrintf("<br>");
+			} else {
+				sb->safePrintf("0x%" PTRFMT"<br>", (PTRTYPE)sample->m_frames[j]);
+			}
+		}
+		if ( symbols ) sysfree(symbols);
+
+		sb->safePrintf("</small></td></tr>\n");
+	}
+
+	sb->safePrintf ( "</table>\n");
 
+	sysfree(samples);
+	sysfree(groups);
 	return true;
 }
 
@@ -599,12 +1040,60 @@ bool Mem::lblMem( void *mem, size_t size, const char *note ) {
 #endif
 }
 
-// this is called just before a memory block is freed and needs to be deregistered
+// . this is called just before a memory block is freed and needs to be
+//   deregistered
+// . returns false if "mem" was not allocated by us or was already freed
 bool Mem::rmMem(void *mem, size_t size, const char *note, bool checksize) {
-	if(!s_lock.working) return true;
-	ScopedLock sl(s_lock);
 	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s'", mem, size, note );
 
+	MemHeader *hdr = getMemHeader(mem);
+	if ( hdr->m_magic != MEMHEADER_MAGIC ) {
+		log(LOG_LOGIC,"mem: could not find slot (note=%s)",note);
+		return false;
+	}
+
+	// . bitch is sizes don't match
+	// . delete operator does not provide a size
+	if ( checksize && hdr->m_size != size ) {
+		log( LOG_ERROR, "mem: rmMem: Freeing %zu should be %zu. (%s)", size,(size_t)hdr->m_size,note);
+		gbshutdownAbort(true);
+	}
+	size = hdr->m_size;
+
+	// debug
+	if ( (size > MINMEM && g_conf.m_logDebugMemUsage) || size>=100000000 )
+		log(LOG_INFO,"mem: rmMem (%zu): ptr=0x%" PTRFMT" %s.",size,(PTRTYPE)mem,note);
+
+	if ( hdr->m_flags & MEMF_TABLE ) {
+		// also checks for breeches
+		if ( s_lock.working ) rmFromTable ( mem , size , note );
+	} else if ( ! ( hdr->m_flags & MEMF_NEW ) ) {
+		checkBreech ( (char *)mem , size , note );
+	}
+
+	if ( hdr->m_flags & MEMF_SAMPLED ) {
+		rmSample(hdr->m_sampleSlot);
+	}
+
+	MemThreadStats *ts = getThreadStats();
+	addCount(ts->m_bytes[hdr->m_noteIdx], -(int64_t)size);
+	addCount(ts->m_allocs[hdr->m_noteIdx], -1);
+	addCount(ts->m_numAllocated, -1);
+	ts->m_usedDelta -= size;
+	if ( ts->m_usedDelta <= -MEM_FLUSH_BYTES || size >= MEM_FLUSH_BYTES ) {
+		flushUsed(ts);
+	}
+
+	// catch double frees
+	hdr->m_magic = 0;
+
+	return true;
+}
+
+// remove from the leak detecting table
+void Mem::rmFromTable(void *mem, size_t size, const char *note) {
+	ScopedLock sl(s_lock);
+
 	//validate();
 
 	logDebug( g_conf.m_logDebugMem, "mem: free %08" PTRFMT" %zu bytes (%s)", (PTRTYPE)mem,size,note);
@@ -614,11 +1103,6 @@ bool Mem::rmMem(void *mem, size_t size, const char *note, bool checksize) {
 	// though.
 	if ( g_conf.m_logDebugMem ) printBreeches_unlocked();
 
-	// don't free 0 bytes
-	if ( checksize && size == 0 ) {
-		return true;
-	}
-
 	// . hash by first hashing "mem" to mix it up some
 	// . balance the mallocs/frees
 	// . hash into table
@@ -640,29 +1124,11 @@ bool Mem::rmMem(void *mem, size_t size, const char *note, bool checksize) {
 	// are we from the "new" operator
 	bool isnew = s_isnew[h];
 
-	if(checksize) {
-		// . bitch is sizes don't match
-		// . delete operator does not provide a size now (it's -1)
-		if ( s_sizes[h] != size ) {
-			log( LOG_ERROR, "mem: rmMem: Freeing %zu should be %zu. (%s)", size,s_sizes[h],note);
-			gbshutdownAbort(true);
-		}
-	} else
-		size = s_sizes[h];
-
-	// debug
-	if ( (size > MINMEM && g_conf.m_logDebugMemUsage) || size>=100000000 )
-		log(LOG_INFO,"mem: rmMem (%zu): ptr=0x%" PTRFMT" %s.",size,(PTRTYPE)mem,note);
-
-	//
-	// we do this here now since we always call rmMem() now
-	//
-	// decrement freed mem
-	m_used -= size;
-	// new/delete does not have padding because the "new"
-	// function can't support it right now
-	//if ( ! isnew ) m_used -= (UNDERPAD + OVERPAD);
-	m_numAllocated--;
+	if ( s_sizes[h] != size ) {
+		log( LOG_ERROR, "mem: rmMem: Freeing %zu should be %zu. (%s)", size,s_sizes[h],note);
+		sl.unlock();
+		gbshutdownAbort(true);
+	}
 
 	// check for breeches, if we don't do it here, we won't be able
 	// to check this guy for breeches later, cuz he's getting 
@@ -702,8 +1168,6 @@ bool Mem::rmMem(void *mem, size_t size, const char *note, bool checksize) {
 	}
 
 	//validate();
-
-	return true;
 }
 
 int32_t Mem::validate ( ) {
@@ -717,32 +1181,13 @@ int32_t Mem::validate ( ) {
 		total += s_sizes[i];
 		count++;
 	}
-	// see if it matches
-	if ( total != m_used ) gbshutdownAbort(true);
-	if ( count != m_numAllocated ) gbshutdownAbort(true);
+	// see if it matches. only allocations made while table tracking was
+	// enabled are in the table
+	if ( count != s_n ) gbshutdownAbort(true);
 	return 1;
 }
 
 
-int32_t Mem::getMemSlot ( void *mem ) {
-	if(!s_lock.working) return true;
-	ScopedLock sl(s_lock);
-
-	// hash into table
-	uint32_t u = (PTRTYPE)mem * (PTRTYPE)0x4bf60ade;
-	uint32_t h = u % (uint32_t)m_memtablesize;
-	// . chain to an empty bucket
-	// . CAUTION: loops forever if no empty bucket
-	while ( s_mptrs[h] && s_mptrs[h] != mem ) {
-		h++;
-		if ( h == m_memtablesize ) h = 0;
-	}
-	// if not found, return -1
-	if ( ! s_mptrs[h] ) return -1;
-	return h;
-}
-
-
 int Mem::printBreech ( int32_t i) {
 	// skip if empty
 	if ( ! s_mptrs    ) return 0;
@@ -894,8 +1339,8 @@ int Mem::printMem ( ) {
 	log(LOG_INFO,"mem: # current objects allocated now = %" PRId32, np );
 	log(LOG_INFO,"mem: totalMem allocated now = %" PRId64, total );
 	//log("mem: max allocated at one time = %" PRId32, (int32_t)(m_maxAllocated));
-	log(LOG_INFO,"mem: Memory allocated now: %" PRId64".\n", m_used );
-	log(LOG_INFO,"mem: Num allocs %" PRId32".\n", m_numAllocated );
+	log(LOG_INFO,"mem: Memory allocated now: %zu.\n", getUsedMem() );
+	log(LOG_INFO,"mem: Num allocs %" PRId32".\n", getNumAllocated() );
 	return 1;
 }
 
@@ -923,7 +1368,7 @@ void *Mem::gbmalloc ( size_t size , const char *note ) {
 
 	void *mem;
 
-	mem = (void *)sysmalloc ( size + UNDERPAD + OVERPAD );
+	mem = (void *)sysmalloc ( sizeof(MemHeader) + size + OVERPAD );
 
 	if ( ! mem && size > 0 ) {
 		g_mem.m_outOfMems++;
@@ -931,11 +1376,11 @@ void *Mem::gbmalloc ( size_t size , const char *note ) {
 		static int64_t s_lastTime;
 		static int32_t s_missed = 0;
 		int64_t now = gettimeofdayInMilliseconds();
-		int64_t avail = (int64_t)g_conf.m_maxMem - (int64_t)m_used;
+		int64_t avail = (int64_t)g_conf.m_maxMem - (int64_t)getUsedMem();
 		if ( now - s_lastTime >= 1000LL ) {
 			log(LOG_WARN, "mem: system malloc(%zu,%s) availShouldBe=%" PRId64": "
 			    "%s (%s) (ooms suppressed since last log msg = %" PRId32")",
-			    size+UNDERPAD+OVERPAD,
+			    sizeof(MemHeader)+size+OVERPAD,
 			    note,
 			    avail,
 			    mstrerror(g_errno),
@@ -952,8 +1397,8 @@ void *Mem::gbmalloc ( size_t size , const char *note ) {
 
 	logTrace( g_conf.m_logTraceMem, "mem=%p size=%zu note='%s'", mem, size, note );
 
-	addMem ( (char *)mem + UNDERPAD , size , note , 0 );
-	return (char *)mem + UNDERPAD;
+	addMem ( (char *)mem + sizeof(MemHeader) , size , note , 0 );
+	return (char *)mem + sizeof(MemHeader);
 }
 
 void *Mem::gbcalloc ( size_t size , const char *note ) {
@@ -996,21 +1441,19 @@ void *Mem::gbrealloc ( void *ptr , size_t oldSize , size_t newSize , const char
 
 	// assume it will be successful. we can't call rmMem() after
 	// calling sysrealloc() because it will mess up our MAGICCHAR buf
-	rmMem(ptr, oldSize, note, true);
+	if ( ! rmMem(ptr, oldSize, note, true) ) {
+		g_errno = EBADENGINEER;
+		return NULL;
+	}
 
 	// . do the actual realloc
-	char *mem = (char *)sysrealloc ( (char *)ptr - UNDERPAD , newSize + UNDERPAD + OVERPAD );
+	char *mem = (char *)sysrealloc ( (char *)ptr - sizeof(MemHeader) , sizeof(MemHeader) + newSize + OVERPAD );
 
 	// remove old guy on sucess
 	if ( mem ) {
-		addMem ( (char *)mem + UNDERPAD , newSize , note , 0 );
-		char *returnMem = mem + UNDERPAD;
-		// set magic char bytes for mem
-		for ( int32_t i = 0 ; i < UNDERPAD ; i++ )
-			returnMem[0-i-1] = MAGICCHAR;
-		for ( int32_t i = 0 ; i < OVERPAD ; i++ )
-			returnMem[0+newSize+i] = MAGICCHAR;
-		return returnMem;
+		// sets the magic char bytes
+		addMem ( mem + sizeof(MemHeader) , newSize , note , 0 );
+		return mem + sizeof(MemHeader);
 	}
 
 	// ok, just try using malloc then!
@@ -1029,7 +1472,7 @@ void *Mem::gbrealloc ( void *ptr , size_t oldSize , size_t newSize , const char
 	// copy over to it
 	memcpy ( mem, ptr, oldSize );
 	// we already called rmMem() so don't double call
-	sysfree ( (char *)ptr - UNDERPAD );	
+	sysfree ( (char *)ptr - sizeof(MemHeader) );	
 
 	return mem;
 }
@@ -1054,24 +1497,15 @@ void Mem::gbfree ( void *ptr , const char *note, size_t size , bool checksize )
 		return;
 	}
 
-	// . get how much it was from the mem table
-	// . this is used for alloc/free wrappers for zlib because it does
-	//   not give us a size to free when it calls our mfree(), so we use -1
-	int32_t slot = g_mem.getMemSlot ( ptr );
-	if ( slot < 0 ) {
-		log(LOG_LOGIC,"mem: could not find slot (note=%s)",note);
-		// do NOT abort here... Let it run, otherwise it dies during merges.  abort();
-		// return for now so procog does not core all the time!
-		return;
-	}
-
-	bool isnew = s_isnew[slot];
-
-	// if this returns false it was an unbalanced free
+	// . if this returns false it was an unbalanced free
+	// . do NOT abort here... Let it run, otherwise it dies during merges.
+	// . the size is in the mem header. that is used for alloc/free
+	//   wrappers for zlib because it does not give us a size to free when
+	//   it calls our mfree()
 	if (!rmMem(ptr, size, note, checksize)) {
 		return;
 	}
 
-	if ( isnew ) sysfree ( (char *)ptr );
-	else         sysfree ( (char *)ptr - UNDERPAD );
+	// new'd and *alloc()'ed mem both start with the header
+	sysfree ( (char *)ptr - sizeof(MemHeader) );
 }
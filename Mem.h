@@ -32,18 +32,20 @@ class Mem {
 	void gbfree(void *ptr, const char *note, size_t size, bool checksize);
 	void *dup     ( const void *data , size_t dataSize , const char *note);
 
-	// this one does not include new/delete mem, only *alloc()/free() mem
+	// . this one does not include new/delete mem, only *alloc()/free() mem
+	// . threads add up their allocations before publishing them, so this is
+	//   off by up to a few hundred KB per thread
 	size_t getUsedMem() const;
 	// the max mem ever allocated
-	size_t getMaxAllocated() const { return m_maxAllocated; }
+	size_t getMaxAllocated() const;
 	size_t getMaxAlloc  () const { return m_maxAlloc; }
 	const char *getMaxAllocBy() const { return m_maxAllocBy; }
 	// the max mem we can use!
 	size_t getMaxMem() const;
 
-	int32_t getNumAllocated() const { return m_numAllocated; }
+	int32_t getNumAllocated() const;
 
-	int64_t getNumTotalAllocated() const { return m_numTotalAllocated; }
+	int64_t getNumTotalAllocated() const;
 	
 	float getUsedMemPercentage() const;
 	int32_t getOOMCount() const { return m_outOfMems; }
@@ -58,6 +60,9 @@ class Mem {
 	// print mem usage stats
 	int  printMem      ( ) ;
 
+	// . account for a block allocated with a mem header in front of it.
+	//   per thread counters always, the table and sampling if enabled
+	// . rmMem() returns false if "mem" has no valid header
 	void addMem(void *mem, size_t size, const char *note, char isnew);
 	bool rmMem(void *mem, size_t size, const char *note, bool checksize);
 	bool lblMem(void *mem, size_t size, const char *note);
@@ -67,22 +72,19 @@ class Mem {
 	bool printMemBreakdownTable(SafeBuf *sb);
 
 private:
-	size_t m_maxAllocated; // at any one time
 	size_t m_maxAlloc; // the biggest single alloc ever done
 	const char *m_maxAllocBy; // the biggest single alloc ever done
 
 	int32_t validate();
 
-	int32_t getMemSlot(void *mem);
+	void addToTable(void *mem, size_t size, const char *note, char isnew);
+	void rmFromTable(void *mem, size_t size, const char *note);
 
-	// currently used mem (estimate)
-	size_t m_used;
+	bool printSampleTable(SafeBuf *sb);
 
 	// count how many allocs/news failed
 	int32_t m_outOfMems;
 
-	int32_t          m_numAllocated;
-	int64_t     m_numTotalAllocated;
 	uint32_t m_memtablesize;
 
 	int printBreeches_unlocked();
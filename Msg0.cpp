@@ -82,7 +82,9 @@ void Msg0::reset ( ) {
 bool Msg0::registerHandler ( ) {
 	// . register ourselves with the udp server
 	// . it calls our callback when it receives a msg of type 0x0A
-	if ( ! g_udpServer.registerHandler ( msg_type_0, handleRequest0 ))
+	// . Msg5 is used off the main thread by the query coordinator too, so
+	//   the receive threads can call us
+	if ( ! g_udpServer.registerHandler ( msg_type_0, handleRequest0, true ))
 		return false;
 	return true;
 }
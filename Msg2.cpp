@@ -64,6 +64,8 @@ Msg2::Msg2()
     m_state(NULL),
     m_callback(NULL),
     m_niceness(0),
+    m_jobGroup(NULL),
+    m_jobDeadline(0),
     m_isDebug(false),
     m_startTime(0)
 {
@@ -287,6 +289,7 @@ bool Msg2::getLists ( ) {
 
 		Msg5 *msg5 = getAvailMsg5();
 		if(!msg5) gbshutdownLogicError();
+		msg5->setJobGroup(m_jobGroup, m_jobDeadline);
 
 		// . start up a Msg5 to get it
 		// . this will return false if blocks
@@ -376,6 +379,7 @@ bool Msg2::getLists ( ) {
 		// get one
 		Msg5 *msg5 = getAvailMsg5();
 		if(!msg5) gbshutdownLogicError();
+		msg5->setJobGroup(m_jobGroup, m_jobDeadline);
 
 		// advance cursor
 		m_p = p;
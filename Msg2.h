@@ -74,6 +74,12 @@ public:
 		return m_numLists;
 	}
 
+	// the merge jobs of the Msg5s are submitted in this job group
+	void setJobGroup(const void *jobGroup, int64_t jobDeadline) {
+		m_jobGroup = jobGroup;
+		m_jobDeadline = jobDeadline;
+	}
+
 	int64_t docIdStart() const { return m_docIdStart; }
 	int64_t docIdEnd() const { return m_docIdEnd; }
 
@@ -132,6 +138,9 @@ private:
 	void (*m_callback)(void *state);
 	int32_t m_niceness;
 
+	const void *m_jobGroup;
+	int64_t m_jobDeadline;
+
 	// if this is true we log more output
 	bool m_isDebug;
 
@@ -23,10 +23,11 @@ struct Msg20State {
 
 
 static void handleRequest20(UdpSlot *slot, int32_t netnice);
+static void getSummary20(UdpSlot *slot, int32_t netnice);
 static bool gotReplyWrapperxd(void *state);
 
 
-static bool sendCachedReply ( Msg20Request *req, const void *cached_summary, size_t cached_summary_len, UdpSlot *slot );
+static bool sendCachedReply ( void *cached_summary, size_t cached_summary_len, UdpSlot *slot );
 
 
 Msg20::Msg20 () { 
@@ -106,7 +107,7 @@ void Msg20::reset() {
 bool Msg20::registerHandler ( ) {
 	// . register ourselves with the udp server
     // . it calls our callback when it receives a msg of type 0x20
-    if ( ! g_udpServer.registerHandler ( msg_type_20, handleRequest20 ))
+    if ( ! g_udpServer.registerHandler ( msg_type_20, handleRequest20, true ))
 		return false;
 
 	return true;
@@ -336,6 +337,9 @@ void Msg20::gotReply ( UdpSlot *slot ) {
 
 // . this is called
 // . destroys the UdpSlot if false is returned
+// . this is thread-safe up to the summary cache lookup so it is called from
+//   the udp receive threads. XmlDoc is not, a cache miss is passed on to
+//   getSummary20() in the main loop
 static void handleRequest20(UdpSlot *slot, int32_t netnice) {
 	// . check g_errno
 	// . before, we were not sending a reply back here and we continued
@@ -378,13 +382,13 @@ static void handleRequest20(UdpSlot *slot, int32_t netnice) {
 	}
 
 	int64_t cache_key = req->makeCacheKey();
-	const void *cached_summary;
+	void *cached_summary;
 	size_t cached_summary_len;
 	if(g_stable_summary_cache.lookup(cache_key, &cached_summary, &cached_summary_len) ||
 	   g_unstable_summary_cache.lookup(cache_key, &cached_summary, &cached_summary_len))
 	{
 		log(LOG_DEBUG, "query: Summary cache hit");
-		sendCachedReply(req,cached_summary,cached_summary_len,slot);
+		sendCachedReply(cached_summary,cached_summary_len,slot);
 		return;
 	} else
 		log(LOG_DEBUG, "query: Summary cache miss");
@@ -407,6 +411,21 @@ static void handleRequest20(UdpSlot *slot, int32_t netnice) {
 		return; 
 	}
 
+	if ( UdpServer::isReceiveThread() ) {
+		g_udpServer.callHandlerFromMainLoop(slot, getSummary20);
+		return;
+	}
+
+	getSummary20(slot, netnice);
+}
+
+// . generate the summary for a request handleRequest20() checked and did
+//   not find in the summary cache
+// . called from the main loop
+static void getSummary20(UdpSlot *slot, int32_t /*netnice*/) {
+	// deserialized by handleRequest20()
+	Msg20Request *req = (Msg20Request *)slot->m_readBuf;
+
 	int64_t startTime = gettimeofdayInMilliseconds();
 
 	// alloc a new state to get the titlerec
@@ -662,17 +681,10 @@ bool Msg20Reply::sendReply(Msg20State *state) {
 }
 
 
-static bool sendCachedReply ( Msg20Request *req, const void *cached_summary, size_t cached_summary_len, UdpSlot *slot )
+// the cached summary is a copy made by SummaryCache::lookup(), so UDPSlot/Server can free it when possible
+static bool sendCachedReply ( void *cached_summary, size_t cached_summary_len, UdpSlot *slot )
 {
-	//copy the cached summary to a new temporary buffer, so that UDPSlot/Server can free it when possible
-	char *buf  = (char *)mmalloc ( cached_summary_len , "Msg20Reply" );
-	if(!buf) {
-		log(LOG_ERROR,"%s:%s:%d: call sendErrorReply. error=%s", __FILE__, __func__, __LINE__, mstrerror( g_errno ));
-		g_udpServer.sendErrorReply ( slot , g_errno ) ;
-		return true;
-	}
-	memcpy(buf,cached_summary,cached_summary_len);
-	
+	char *buf = (char *)cached_summary;
 	g_udpServer.sendReply(buf, cached_summary_len, buf, cached_summary_len, slot);
 	
 	return true;
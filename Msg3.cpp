@@ -187,7 +187,9 @@ class RdbCache *getDiskPageCache ( rdbid_t rdbId ) {
 			   false , // loadfromdisk
 			   sizeof(key192_t), // cache key size
 			   0 , // data key size
-			   -1 ) )  // numptrsmax
+			   -1 , // numptrsmax
+			   16 ) ) // shards, every msg3 of a query reads these
+
 		return NULL;
 
 	return rpc;
@@ -288,6 +290,16 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 		return true;
 	}
 
+	// . the files of a cold collection are loaded on first access. other
+	//   threads wait for that, the main thread and the udp receive threads
+	//   get an error until then
+	if ( ! base->ensureFilesLoaded() ) {
+		log(LOG_DEBUG, "net: msg3: %s files of collnum %" PRId32" not loaded yet",
+		    base->getDbName(), (int32_t)m_collnum);
+		g_errno = ETRYAGAIN;
+		return true;
+	}
+
 	// save startFileNum here, just for recall
 	m_startFileNum = startFileNum;
 	m_numFiles     = numFiles;
@@ -554,7 +566,7 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 			key192_t ck = makeCacheKey ( vfd , offset, bytesToRead);
 			char *rec; int32_t recSize;
 			bool inCache = false;
-			RdbCacheLock rcl(*rpc);
+			RdbCacheLock rcl(*rpc, (const char *)&ck);
 			if ( vfd != -1 && ! m_validateCache ) 
 				inCache = rpc->getRecord ( (collnum_t)0 , // collnum
 							(char *)&ck , 
@@ -926,7 +938,7 @@ bool Msg3::doneScanning ( ) {
 		if ( m_validateCache && ff && rpc && vfd != -1 ) {
 			bool inCache;
 			char *rec; int32_t recSize;
-			RdbCacheLock rcl(*rpc);
+			RdbCacheLock rcl(*rpc, (const char *)&ck);
 			inCache = rpc->getRecord ( (collnum_t)0 , // collnum
 						   (char *)&ck , 
 						   &rec , 
@@ -957,7 +969,7 @@ bool Msg3::doneScanning ( ) {
 		if ( m_retryNum<=0 && ff && rpc && vfd != -1 &&
 		     ! m_scan[i].m_inPageCache )
 		{
-			RdbCacheLock rcl(*rpc);
+			RdbCacheLock rcl(*rpc, (const char *)&ck);
 			char tmpShiftCount = m_scan[i].m_scan.shiftCount();
 			rpc->addRecord ( (collnum_t)0 , // collnum
 					 (char *)&ck , 
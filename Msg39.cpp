@@ -61,10 +61,22 @@ public:
 	void wait_for_finish() {
 		verify_signature();
 		ScopedLock sl(mtx);
-		while(!result_ready)
-			pthread_cond_wait(&cond,&mtx);
+		while(!result_ready) {
+			//wake up now and then to see if the query should be given up
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME,&ts);
+			ts.tv_nsec += cancel_check_interval_ms*1000000;
+			if(ts.tv_nsec>=1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&cond,&mtx,&ts);
+			if(!result_ready)
+				msg39->checkCancelled();
+		}
 		verify_signature();
 	}
+	static const int cancel_check_interval_ms = 10;
 };
 
 //a simple function just signals that the job has been finished
@@ -78,6 +90,23 @@ static void JobFinishedCallback(void *state) {
 	assert(rc==0);
 }
 
+//finish callback for jobs that signal completion themselves. Only if the job
+//never ran (cancelled or deadline passed) we have to do it here. Otherwise
+//the JobState is long gone
+static void JobNotRunCallback(void *state, job_exit_t exit_type) {
+	if(exit_type==job_exit_normal)
+		return;
+	JobState *js = static_cast<JobState*>(state);
+	verify_signature_at(js->signature);
+	ScopedLock sl(js->mtx);
+	assert(!js->result_ready);
+	//marks the query as given up if the deadline passed
+	js->msg39->checkCancelled();
+	js->result_ready = true;
+	int rc = pthread_cond_signal(&js->cond);
+	assert(rc==0);
+}
+
 } //anonymous namespace
 
 
@@ -145,7 +174,9 @@ void Msg39Request::reset() {
 bool Msg39::registerHandler ( ) {
 	// . register ourselves with the udp server
 	// . it calls our callback when it receives a msg of type 0x39
-	if ( ! g_udpServer.registerHandler ( msg_type_39, &handleRequest39 ))
+	// . we only deserialize the request and hand it to the coordinator
+	//   job, so the receive threads can call us
+	if ( ! g_udpServer.registerHandler ( msg_type_39, &handleRequest39, true ))
 		return false;
 	return true;
 }
@@ -153,7 +184,8 @@ bool Msg39::registerHandler ( ) {
 
 Msg39::Msg39 ()
   : m_lists(NULL),
-    m_clusterBuf(NULL)
+    m_clusterBuf(NULL),
+    m_arena("Msg39")
 {
 	m_inUse = false;
 	reset();
@@ -172,10 +204,8 @@ void Msg39::reset() {
 	m_numTotalHits = 0;
 	m_gotClusterRecs = 0;
 	reset2();
-	if(m_clusterBuf) {
-		mfree ( m_clusterBuf, m_clusterBufSize, "Msg39cluster");
-		m_clusterBuf = NULL;
-	}
+	m_clusterBuf = NULL;
+	m_arena.clear();
 
 	// Coverity
 	m_slot = NULL;
@@ -190,6 +220,7 @@ void Msg39::reset() {
 	m_numClusterDocIds = 0;
 	m_numVisible = 0;
 	m_debug = false;
+	m_cancelled = false;
 }
 
 
@@ -297,6 +328,13 @@ void Msg39::getDocIds ( UdpSlot *slot ) {
 	}
 
 	log(LOG_DEBUG,"query: msg39: processing query '%*.*s', this=%p", (int)m_msg39req->size_query, (int)m_msg39req->size_query, m_msg39req->ptr_query, this);
+	// . start loading the posdb files of a cold collection. the
+	//   coordinator thread waits for them when it reads the lists
+	RdbBase *base = getRdbBase(RDB_POSDB, m_msg39req->m_collnum);
+	if ( base ) {
+		base->ensureFilesLoaded();
+	}
+
 	// OK, we have deserialized and checked the msg39request and we can now process
 	// it by shoveling into the jobe queue. that means that the main thread (or whoever
 	// called us) is freed up and can do other stuff.
@@ -467,6 +505,10 @@ void Msg39::controlLoop ( ) {
 				log(LOG_ERROR,"Msg39::controlLoop: got error %d after getLists()", g_errno);
 				goto hadError;
 			}
+			if ( m_cancelled ) {
+				g_errno = ECANCELLED;
+				goto hadError;
+			}
 
 			// Intersect the lists we loaded (using a thread)
 			documentIndexChecker.setFileNum(fileNum);
@@ -475,6 +517,10 @@ void Msg39::controlLoop ( ) {
 				log(LOG_ERROR,"Msg39::controlLoop: got error %d after intersectLists()", g_errno);
 				goto hadError;
 			}
+			if ( m_cancelled ) {
+				g_errno = ECANCELLED;
+				goto hadError;
+			}
 			
 			// Sum up stats
 			if ( m_posdbTable.m_t1 ) {
@@ -703,6 +749,9 @@ void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
 
 	JobState jobState(this);
 	
+	// so the list merges can be cancelled with the query
+	m_msg2.setJobGroup(this, getQueryDeadline());
+
 	// call msg2
 	if ( ! m_msg2.getLists ( m_msg39req->m_collnum,
 				 m_msg39req->m_addToCache,
@@ -800,10 +849,12 @@ void Msg39::intersectLists(const DocumentIndexChecker &documentIndexChecker) {
 	// . create the thread
 	// . only one of these type of threads should be launched at a time
 	if ( g_jobScheduler.submit(&intersectListsThreadFunction,
-	                           0, //no finish callback
+	                           &JobNotRunCallback,
 				   &jobState,
 				   thread_type_query_intersect,
-				   m_msg39req->m_niceness) ) {
+				   m_msg39req->m_niceness,
+				   getQueryDeadline(),
+				   this) ) {
 		jobState.wait_for_finish();
 	} else
 		m_posdbTable.intersectLists();
@@ -817,6 +868,46 @@ void Msg39::intersectLists(const DocumentIndexChecker &documentIndexChecker) {
 
 
 
+// . give up the query if the requester cancelled it or it timed out
+// . cancels our queued jobs and tells the running ones to stop
+// . called by the coordinator while waiting for sub-jobs
+bool Msg39::checkCancelled() {
+	if ( m_cancelled ) {
+		return true;
+	}
+
+	const char *reason = NULL;
+	if ( m_slot && m_slot->isRequesterCancelled() ) {
+		reason = "requester cancelled it";
+	} else {
+		int64_t deadline = getQueryDeadline();
+		if ( deadline && gettimeofdayInMilliseconds() > deadline ) {
+			reason = "it timed out";
+		}
+	}
+	if ( ! reason ) {
+		return false;
+	}
+
+	// the coordinator and the main thread may both get here
+	if ( m_cancelled.exchange(true) ) {
+		return true;
+	}
+	log(LOG_INFO, "query: msg39: [%" PTRFMT"] giving up query because %s", (PTRTYPE)this, reason);
+	g_jobScheduler.cancel_job_group(this);
+	return true;
+}
+
+
+// when the requester will have given up on us. 0 if no timeout
+int64_t Msg39::getQueryDeadline() const {
+	if ( m_msg39req->m_timeout <= 0 ) {
+		return 0;
+	}
+	return m_startTimeQuery + m_msg39req->m_timeout;
+}
+
+
 // Use of ThreadEntry parameter is NOT thread safe
 void Msg39::intersectListsThreadFunction ( void *state ) {
 	JobState *js = static_cast<JobState*>(state);
@@ -857,7 +948,7 @@ void Msg39::getClusterRecs ( ) {
 	int32_t nodeSize  = 8 + 1 + 12;
 	int32_t numDocIds = m_toptree.getNumUsedNodes();
 	m_clusterBufSize = numDocIds * nodeSize;
-	m_clusterBuf = (char *)mmalloc(m_clusterBufSize, "Msg39cluster");
+	m_clusterBuf = (char *)m_arena.alloc(m_clusterBufSize);
 	// on error, return true, g_errno should be set
 	if ( m_clusterBufSize>0 && ! m_clusterBuf ) {
 		log("query: msg39: Failed to alloc buf for clustering.");
@@ -961,8 +1052,7 @@ bool Msg39::gotClusterRecs() {
 	log(LOG_DEBUG,"query: msg39: %" PRId32" docids out of %" PRId32" are visible",
 	    m_numVisible,nd);
 
-	// we don't need this anymore
-	mfree ( m_clusterBuf, m_clusterBufSize, "Msg39cluster");
+	// we don't need this anymore. the arena gives it back in reset()
 	m_clusterBuf = NULL;
 
 	return true;
@@ -12,7 +12,9 @@
 #include "TopTree.h"
 #include "Msg51.h"
 #include "ScoringWeights.h"
+#include "Arena.h"
 #include "JobScheduler.h"
+#include <atomic>
 
 
 class UdpSlot;
@@ -204,6 +206,7 @@ private:
 	int64_t  m_numTotalHits;
 
 	int32_t        m_clusterBufSize;
+	// carved out of m_arena
 	char       *m_clusterBuf;
 	int64_t  *m_clusterDocIds;
 	char       *m_clusterLevels;
@@ -213,6 +216,9 @@ private:
 	Msg51       m_msg51;
 	bool        m_gotClusterRecs;
 
+	// memory that lives as long as the request, cleared by reset()
+	Arena       m_arena;
+
 	void        controlLoop();
 	static void intersectListsThreadFunction(void *state);
 
@@ -222,7 +228,18 @@ private:
 	void        getClusterRecs();
 	bool        gotClusterRecs ();
 
+	int64_t     getQueryDeadline() const;
+
+	// . set when the query was given up, by the coordinator or by the
+	//   main thread when a job of ours was not run (JobNotRunCallback)
+	// . polled by the coordinator while it waits for its sub-jobs
+	std::atomic<bool> m_cancelled;
+
 public:
+	// . see if the query should be given up, and if so cancel its jobs
+	// . called by the coordinator thread while waiting for sub-jobs
+	bool checkCancelled();
+
 	//debugging aid
 	bool    m_inUse;
 	bool    m_debug;
@@ -13,6 +13,8 @@
 #include "Titledb.h"	// for Titledb::validateSerializedRecord
 #include <sys/stat.h> //stat()
 #include <fcntl.h>
+#include <algorithm>
+#include <atomic>
 
 #ifdef _VALGRIND_
 #include <valgrind/memcheck.h>
@@ -24,12 +26,24 @@
 // . also, need to update spiderdb rec for the url in Msg14 using Msg4 too!
 // . need to add support for passing in array of lists for Msg14
 
+struct RdbItems;
+
 namespace Msg4In {
-static bool addMetaList(const char *p, class UdpSlot *slot = NULL);
+static bool parseMetaList(const char *p, class UdpSlot *slot, std::map<rdbid_t, RdbItems> *rdbItems);
+static bool checkRoom(const std::map<rdbid_t, RdbItems> &rdbItems, const std::map<rdbid_t, RdbItems> &batchItems);
+static bool addRdbItems(std::map<rdbid_t, RdbItems> *batchItems);
 static void handleRequest4(UdpSlot *slot, int32_t niceness);
-static void processMsg4(void *item);
+static void processMsg4Batch(void **items, size_t numItems);
 
 static GbThreadQueue s_incomingThreadQueue;
+
+static std::atomic<int64_t> s_numBatches(0);
+static std::atomic<int64_t> s_numRequests(0);
+static std::atomic<int64_t> s_numTryAgains(0);
+static std::atomic<int64_t> s_numRecs(0);
+static std::atomic<int64_t> s_numBytes(0);
+static std::atomic<int64_t> s_maxBatchSize(0);
+static std::atomic<int64_t> s_processingTimeUs(0);
 }
 
 // all these parameters should be preset
@@ -48,43 +62,14 @@ bool Msg4In::registerHandler() {
 }
 
 bool Msg4In::initializeIncomingThread() {
-	return s_incomingThreadQueue.initialize(processMsg4, "process-msg4");
+	int32_t maxBatchSize = g_conf.m_msg4MaxBatchSize > 0 ? g_conf.m_msg4MaxBatchSize : 1;
+	return s_incomingThreadQueue.initialize(processMsg4Batch, maxBatchSize, "process-msg4");
 }
 
 void Msg4In::finalizeIncomingThread() {
 	s_incomingThreadQueue.finalize();
 }
 
-// . destroys the slot if false is returned
-// . this is registered in Msg4::set() to handle add rdb record msgs
-// . seems like we should always send back a reply so we don't leave the
-//   requester's slot hanging, unless he can kill it after transmit success???
-// . TODO: need we send a reply back on success????
-// . NOTE: Must always call g_udpServer::sendReply or sendErrorReply() so
-//   read/send bufs can be freed
-static void Msg4In::processMsg4(void *item) {
-	UdpSlot *slot = static_cast<UdpSlot*>(item);
-
-	logTrace( g_conf.m_logTraceMsg4, "BEGIN" );
-
-	// extract what we read
-	char *readBuf     = slot->m_readBuf;
-
-	// this returns false with g_errno set on error
-	if (!addMetaList(readBuf, slot)) {
-		logError("calling sendErrorReply error='%s'", mstrerror(g_errno));
-		g_udpServer.sendErrorReply(slot,g_errno);
-
-		logTrace(g_conf.m_logTraceMsg4, "END - addMetaList returned false. g_errno=%d", g_errno);
-		return;
-	}
-
-	// good to go
-	g_udpServer.sendReply(NULL, 0, NULL, 0, slot);
-
-	logTrace(g_conf.m_logTraceMsg4, "END - OK");
-}
-
 static void Msg4In::handleRequest4(UdpSlot *slot, int32_t /*netnice*/) {
 	// if we just came up we need to make sure our hosts.conf is in
 	// sync with everyone else before accepting this! it might have
@@ -171,18 +156,6 @@ static void Msg4In::handleRequest4(UdpSlot *slot, int32_t /*netnice*/) {
 	s_incomingThreadQueue.addItem(slot);
 }
 
-struct RdbItem {
-	RdbItem(collnum_t collNum, const char *rec, int32_t recSize)
-		: m_collNum(collNum)
-		, m_rec(rec)
-		, m_recSize(recSize) {
-	}
-
-	collnum_t m_collNum;
-	const char *m_rec;
-	int32_t m_recSize;
-};
-
 struct RdbItems {
 	RdbItems()
 		: m_numRecs(0)
@@ -192,13 +165,98 @@ struct RdbItems {
 
 	int32_t m_numRecs;
 	int32_t m_dataSizes;
-	std::vector<RdbItem> m_items;
+	std::vector<RdbBatchRec> m_items;
 };
 
-// . Syncdb.cpp will call this after it has received checkoff keys from
-//   all the alive hosts for this zid/sid
+
+// . the records of one or more msg4 requests are added together: the
+//   requests queued up while we were busy are taken as one batch, their
+//   records merged per rdb, sorted and added with Rdb::addBatch(), so the
+//   buckets are locked once per rdb instead of once per record
+// . all requests of a batch get the same reply, if adding fails they are all
+//   retried by the senders. adding a record again just overwrites it
+// . NOTE: Must always call g_udpServer::sendReply or sendErrorReply() so
+//   read/send bufs can be freed
+static void Msg4In::processMsg4Batch(void **items, size_t numItems) {
+	logTrace(g_conf.m_logTraceMsg4, "BEGIN. numItems=%zu", numItems);
+
+	uint64_t startTime = gettimeofdayInMicroseconds();
+
+	std::vector<UdpSlot*> slots;
+	std::map<rdbid_t, RdbItems> batchItems;
+	int64_t numBytes = 0;
+
+	for (size_t i = 0; i < numItems; ++i) {
+		UdpSlot *slot = static_cast<UdpSlot*>(items[i]);
+
+		g_errno = 0;
+
+		// these return false with g_errno set on error
+		std::map<rdbid_t, RdbItems> rdbItems;
+		if (!parseMetaList(slot->m_readBuf, slot, &rdbItems) || !checkRoom(rdbItems, batchItems)) {
+			if (g_errno == ETRYAGAIN) {
+				++s_numTryAgains;
+			}
+
+			logError("calling sendErrorReply error='%s'", mstrerror(g_errno));
+			g_udpServer.sendErrorReply(slot, g_errno);
+			continue;
+		}
+
+		for (auto &rdbItem : rdbItems) {
+			RdbItems &batchItem = batchItems[rdbItem.first];
+			batchItem.m_numRecs += rdbItem.second.m_numRecs;
+			batchItem.m_dataSizes += rdbItem.second.m_dataSizes;
+			batchItem.m_items.insert(batchItem.m_items.end(), rdbItem.second.m_items.begin(), rdbItem.second.m_items.end());
+		}
+
+		numBytes += slot->m_readBufSize;
+		slots.push_back(slot);
+	}
+
+	if (slots.empty()) {
+		logTrace(g_conf.m_logTraceMsg4, "END - no requests to add");
+		return;
+	}
+
+	// this returns false with g_errno set on error
+	g_errno = 0;
+	bool status = addRdbItems(&batchItems);
+	int32_t err = g_errno;
+
+	for (auto slot : slots) {
+		if (!status) {
+			logError("calling sendErrorReply error='%s'", mstrerror(err));
+			g_udpServer.sendErrorReply(slot, err);
+		} else {
+			g_udpServer.sendReply(NULL, 0, NULL, 0, slot);
+		}
+	}
+
+	if (!status && err == ETRYAGAIN) {
+		s_numTryAgains += slots.size();
+	}
+
+	int64_t numRecs = 0;
+	for (auto const &batchItem : batchItems) {
+		numRecs += batchItem.second.m_numRecs;
+	}
+
+	++s_numBatches;
+	s_numRequests += slots.size();
+	s_numRecs += numRecs;
+	s_numBytes += numBytes;
+	if ((int64_t)slots.size() > s_maxBatchSize) {
+		s_maxBatchSize = slots.size();
+	}
+	s_processingTimeUs += gettimeofdayInMicroseconds() - startTime;
+
+	logTrace(g_conf.m_logTraceMsg4, "END - requests=%zu records=%" PRId64" status=%s", slots.size(), numRecs, status ? "ok" : mstrerror(err));
+}
+
+// . parse the records of a msg4 request per rdb
 // . returns false and sets g_errno on error, returns true otherwise
-static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
+static bool Msg4In::parseMetaList(const char *p, UdpSlot *slot, std::map<rdbid_t, RdbItems> *rdbItems) {
 	logDebug(g_conf.m_logDebugSpider, "syncdb: calling addMetalist zid=%" PRIu64, *(int64_t *) (p + 4));
 
 	// get total buf used
@@ -215,10 +273,6 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 
 	/// @note we can have multiple meta list here
 
-	// check if we have enough room for the whole request
-	// note: we also use this variable for keeping track of which rdbs we have touch and may need an integrity check
-	std::map<rdbid_t, RdbItems> rdbItems;
-
 	while (p < pend) {
 		collnum_t collnum = *(collnum_t *)p;
 		p += sizeof(collnum_t);
@@ -285,7 +339,7 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 			continue;
 		}
 
-		auto &rdbItem = rdbItems[rdbId];
+		auto &rdbItem = (*rdbItems)[rdbId];
 		++rdbItem.m_numRecs;
 
 		int32_t dataSize = recSize - rdb->getKeySize();
@@ -298,13 +352,29 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 		rdbItem.m_items.emplace_back(collnum, rec, recSize);
 	}
 
+	return true;
+}
+
+// . check if we have enough room for the records of a request on top of the
+//   ones of the requests already in the batch
+// . returns false and sets g_errno to ETRYAGAIN if not
+static bool Msg4In::checkRoom(const std::map<rdbid_t, RdbItems> &rdbItems, const std::map<rdbid_t, RdbItems> &batchItems) {
 	bool hasRoom = true;
 	bool anyDumping = false;
 	for (auto const &rdbItem : rdbItems) {
 		Rdb *rdb = getRdbFromId(rdbItem.first);
+		int32_t numRecs = rdbItem.second.m_numRecs;
+		int32_t dataSizes = rdbItem.second.m_dataSizes;
+
+		auto it = batchItems.find(rdbItem.first);
+		if (it != batchItems.end()) {
+			numRecs += it->second.m_numRecs;
+			dataSizes += it->second.m_dataSizes;
+		}
+
 		if (rdb->isDumping()) {
 			anyDumping = true;
-		} else if (!rdb->hasRoom(rdbItem.second.m_numRecs, rdbItem.second.m_dataSizes)) {
+		} else if (!rdb->hasRoom(numRecs, dataSizes)) {
 			rdb->submitRdbDumpJob(true);
 			hasRoom = false;
 		}
@@ -322,45 +392,54 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 		return false;
 	}
 
+	return true;
+}
 
-	for (auto const &rdbItem : rdbItems) {
-		Rdb *rdb = getRdbFromId(rdbItem.first);
-
-		bool status = false;
-		for (auto const &item : rdbItem.second.m_items) {
-			// reset g_errno
-			g_errno = 0;
-
-			// . make a list from this data
-			// . skip over the first 4 bytes which is the rdbId
-			// . TODO: embed the rdbId in the msgtype or something...
-			RdbList list;
+// . sort the records by collection and key (ignoring the delete bit so a
+//   record and its opposite keep their order) for adding them to the tree or
+//   buckets in order
+// . records that can't be reordered (see Rdb::canReorderAdd) split the list
+//   into runs which are sorted separately
+static void sortRdbItems(Rdb *rdb, std::vector<RdbBatchRec> *items) {
+	char ks = rdb->getKeySize();
+	auto cmp = [ks](const RdbBatchRec &a, const RdbBatchRec &b) {
+		if (a.m_collnum != b.m_collnum) {
+			return a.m_collnum < b.m_collnum;
+		}
+		return KEYCMPNEGEQ(a.m_rec, b.m_rec, ks) < 0;
+	};
+
+	auto runStart = items->begin();
+	for (auto it = items->begin(); it != items->end(); ++it) {
+		if (!rdb->canReorderAdd(it->m_rec)) {
+			std::stable_sort(runStart, it, cmp);
+			runStart = it + 1;
+		}
+	}
+	std::stable_sort(runStart, items->end(), cmp);
+}
 
-			// set the list
-			// todo: dodgy cast to char*. RdbList should be fixed
-			list.set((char *)item.m_rec, item.m_recSize, (char *)item.m_rec, item.m_recSize,
-			         rdb->getFixedDataSize(), false, rdb->useHalfKeys(), rdb->getKeySize());
+// . add the records of all the requests in the batch
+// . returns false and sets g_errno on error, returns true otherwise
+static bool Msg4In::addRdbItems(std::map<rdbid_t, RdbItems> *batchItems) {
+	bool status = true;
+	for (auto &rdbItem : *batchItems) {
+		Rdb *rdb = getRdbFromId(rdbItem.first);
+		std::vector<RdbBatchRec> &items = rdbItem.second.m_items;
 
-			// keep track of stats
+		// keep track of stats
+		for (auto const &item : items) {
 			rdb->readRequestAdd(item.m_recSize);
-
-			// this returns false and sets g_errno on error
-			status = rdb->addListNoSpaceCheck(item.m_collNum, &list);
-
-			// bad coll #? ignore it. common when deleting and resetting
-			// collections using crawlbot. but there are other recs in this
-			// list from different collections, so do not abandon the whole
-			// meta list!! otherwise we lose data!!
-			if (g_errno == ENOCOLLREC && !status) {
-				g_errno = 0;
-				status = true;
-			}
-
-			if (!status) {
-				break;
-			}
 		}
 
+		sortRdbItems(rdb, &items);
+
+		// this returns false and sets g_errno on error
+		// bad coll #? they are skipped. common when deleting and resetting
+		// collections using crawlbot. but there are other recs in this
+		// list from different collections, so do not abandon the whole
+		// meta list!! otherwise we lose data!!
+		status = rdb->addBatch(&items[0], items.size());
 		if (!status) {
 			break;
 		}
@@ -368,10 +447,12 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 
 	// verify integrity if wanted
 	if (g_conf.m_verifyTreeIntegrity) {
-		for (auto const &rdbItem : rdbItems) {
+		int32_t err = g_errno;
+		for (auto const &rdbItem : *batchItems) {
 			Rdb *rdb = getRdbFromId(rdbItem.first);
 			rdb->verifyTreeIntegrity();
 		}
+		g_errno = err;
 	}
 
 	// no memory means to try again
@@ -390,7 +471,7 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 	}
 
 	// Initiate dumps for any Rdbs wanting it
-	for (auto const &rdbItem : rdbItems) {
+	for (auto const &rdbItem : *batchItems) {
 		Rdb *rdb = getRdbFromId(rdbItem.first);
 		rdb->submitRdbDumpJob(false);
 	}
@@ -398,3 +479,13 @@ static bool Msg4In::addMetaList(const char *p, UdpSlot *slot) {
 	// success
 	return true;
 }
+
+void Msg4In::getStats(Msg4InStats *stats) {
+	stats->m_numBatches = s_numBatches;
+	stats->m_numRequests = s_numRequests;
+	stats->m_numTryAgains = s_numTryAgains;
+	stats->m_numRecs = s_numRecs;
+	stats->m_numBytes = s_numBytes;
+	stats->m_maxBatchSize = s_maxBatchSize;
+	stats->m_processingTimeUs = s_processingTimeUs;
+}
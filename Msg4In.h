@@ -5,6 +5,19 @@
 #ifndef GB_MSG4IN_H
 #define GB_MSG4IN_H
 
+#include <inttypes.h>
+
+// ingestion stats since startup, shown on the stats page
+struct Msg4InStats {
+	int64_t m_numBatches;
+	int64_t m_numRequests;
+	int64_t m_numTryAgains;     // requests we told to try again
+	int64_t m_numRecs;
+	int64_t m_numBytes;
+	int64_t m_maxBatchSize;     // most requests added together
+	int64_t m_processingTimeUs; // time spent adding the batches
+};
+
 namespace Msg4In {
 
 bool registerHandler();
@@ -12,6 +25,8 @@ bool registerHandler();
 bool initializeIncomingThread();
 void finalizeIncomingThread();
 
+void getStats(Msg4InStats *stats);
+
 }
 
 #endif // GB_MSG4IN_H
@@ -55,6 +55,8 @@ Msg5::Msg5()
 	m_ks = 0;
 	m_collnum = 0;
 	m_errno = 0;
+	m_jobGroup = NULL;
+	m_jobDeadline = 0;
 	// PVS-Studio
 	memset(m_fileStartKey, 0, sizeof(m_fileStartKey));
 	memset(m_minEndKey, 0, sizeof(m_minEndKey));
@@ -926,7 +928,7 @@ bool Msg5::gotList2 ( ) {
 	}
 
 	if(m_callback) {
-		if (g_jobScheduler.submit(mergeListsWrapper, mergeDoneWrapper, this, m_isRealMerge ? thread_type_file_merge : thread_type_query_merge, m_niceness)) {
+		if (g_jobScheduler.submit(mergeListsWrapper, mergeDoneWrapper, this, m_isRealMerge ? thread_type_file_merge : thread_type_query_merge, m_niceness, m_jobDeadline, m_jobGroup)) {
 			return false;
 		}
 
@@ -964,6 +966,12 @@ void Msg5::mergeListsWrapper(void *state) {
 	// assume no error since we're at the start of thread call
 	that->m_errno = 0;
 
+	// the query gave up while we were queued
+	if ( JobScheduler::is_job_cancelled() ) {
+		that->m_errno = ECANCELLED;
+		return;
+	}
+
 	// repair any corruption
 	that->repairLists();
 
@@ -989,10 +997,16 @@ void Msg5::mergeDoneWrapper(void *state, job_exit_t exit_type) {
 	that->mergeDone(exit_type);
 }
 
-void Msg5::mergeDone(job_exit_t /*exit_type*/) {
+void Msg5::mergeDone(job_exit_t exit_type) {
 	verify_signature();
 
 	if(m_calledCallback) gbshutdownCorrupted();
+
+	// . the merge job never ran (cancelled, deadline passed or shutting
+	//   down) so the lists were not merged
+	if ( exit_type != job_exit_normal && ! g_errno ) {
+		g_errno = ECANCELLED;
+	}
 	
 	// we MAY be in a thread now
 
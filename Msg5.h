@@ -73,6 +73,13 @@ class Msg5 {
 
 	bool isWaitingForList() const { return m_waitingForList; }
 
+	// . merge jobs are submitted in this job group and with this start
+	//   deadline (0=none) so a query can cancel them when it gives up
+	void setJobGroup(const void *jobGroup, int64_t jobDeadline) {
+		m_jobGroup = jobGroup;
+		m_jobDeadline = jobDeadline;
+	}
+
 	int32_t minRecSizes() const { return m_minRecSizes; }
 
 	declare_signature
@@ -170,6 +177,9 @@ private:
 
 	bool m_isSingleUnmergedListGet;
 
+	const void *m_jobGroup;
+	int64_t m_jobDeadline;
+
 	static void gotListWrapper0(void *state);
 	void gotListWrapper();
 	
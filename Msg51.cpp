@@ -203,22 +203,20 @@ bool Msg51::sendRequests_unlocked(int32_t k) {
 	RdbCache *c = &s_clusterdbQuickCache;
 	if ( ! s_cacheInit ) c = NULL;
 	int32_t      crecSize;
-	char     *crecPtr = NULL;
+	key96_t     crec;
 	key96_t     ckey = (key96_t)m_docIds[m_nexti];
 	if ( c ) {
-		RdbCacheLock rcl(*c);
-		bool found = c->getRecord ( m_collnum    ,
-				       ckey      , // cache key
-				       &crecPtr  , // pointer to it
+		bool found = c->peekRecord ( m_collnum    ,
+				       (const char *)&ckey , // cache key
+				       (char *)&crec ,
+				       sizeof(crec) ,
 				       &crecSize ,
-				       false     , // do copy?
 				       3600      , // max age in secs
-				       true      , // inc counts?
-				       NULL      );// cachedTime
+				       true      );// inc counts?
 		if ( found ) {
 			// sanity check
 			if ( crecSize != sizeof(key96_t) ) gbshutdownLogicError();
-			m_clusterRecs[m_nexti] = *(key96_t *)crecPtr;
+			m_clusterRecs[m_nexti] = crec;
 			// it is no longer CR_UNINIT, we got the rec now
 			m_clusterLevels[m_nexti] = CR_GOT_REC;
 			// debug msg
@@ -9,6 +9,7 @@
 #include "Process.h"
 #include "ip.h"
 #include "Mem.h"
+#include "MulticastLatency.h"
 
 // TODO: if we're ordered to close and we still are waiting on stuff
 //       to send we should send as much as we can and save the remaining
@@ -54,7 +55,11 @@ Multicast::Multicast()
     m_lastLaunch(0),
     m_freeReadBuf(false),
     m_key(0),
-    m_sentToTwin(false)
+    m_sentToTwin(false),
+    m_lastHostNum(-1),
+    m_firstHostNum(-1),
+    m_hedgeHostNum(-1),
+    m_registeredHedge(false)
 {
 	constructor();
 }
@@ -128,6 +133,10 @@ bool Multicast::send(char *msg, int32_t msgSize, msg_type_t msgType, bool ownMsg
 	m_registeredSleep  = false;
 	m_sentToTwin       = false;
 	m_key              = key;
+	m_lastHostNum      = -1;
+	m_firstHostNum     = -1;
+	m_hedgeHostNum     = -1;
+	m_registeredHedge  = false;
 
 	// clear m_retired, m_errnos, m_slots
 	for(int i=0; i<MAX_HOSTS_PER_GROUP; i++)
@@ -151,6 +160,16 @@ bool Multicast::send(char *msg, int32_t msgSize, msg_type_t msgType, bool ownMsg
 			m_inUse = false;
 		}
 
+		// . if the host is slower than 95% of the replies we got for
+		//   this msg type, send it to a twin as well. see hedge()
+		if ( retVal && m_inUse && shouldHedge() ) {
+			int32_t wait = g_multicastLatency.getPercentile95(m_msgType);
+			if ( wait < 1 ) wait = 1;
+			if ( g_loop.registerSleepCallback(wait, this, hedgeWrapper, "Multicast::hedgeWrapper", m_niceness) ) {
+				m_registeredHedge = true;
+			}
+		}
+
 		return retVal;
 	} else {
 		// . send to ALL hosts in this group if sendToWholeGroup is true
@@ -441,7 +460,7 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 		// if he's not dead or retired use him right away
 		if ( ! m_host[i].m_retired &&
 		     ! g_hostdb.isDead ( m_host[i].m_hostPtr ) )
-			return i;
+			return pickFasterHost ( i );
 	}
 
 	// no no no we need to randomize the order that we try them
@@ -449,7 +468,7 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 	// if this host is not dead, use him
 	if ( ! m_host[n].m_retired &&
 	     ! g_hostdb.isDead(fh) )
-		return n;
+		return pickFasterHost ( n );
 
 	// . ok now select the kth available host
 	// . make a list of the candidates
@@ -472,7 +491,7 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 	// if a host was alive and untried, use him next
 	if ( nc > 0 ) {
 		int32_t k = ((uint32_t)m_key) % nc;
-		return cand[k];
+		return pickFasterHost ( cand[k] );
 	}
 	// . come here if all hosts were DEAD
 	// . try sending to a host that is dead, but not retired now
@@ -484,6 +503,45 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 	return -1;
 }
 
+// . host #i is the one pickBestHost() would normally use. it may have the
+//   data cached from the last request with the same key, so only use
+//   another live host instead if #i has been a lot slower lately
+// . hosts without recent samples are left alone so they get probed again
+int32_t Multicast::pickFasterHost ( int32_t i ) {
+	if ( ! g_conf.m_multicastLatencyAwareSelection ) {
+		return i;
+	}
+
+	int64_t now = gettimeofdayInMilliseconds();
+	int32_t latency = g_multicastLatency.getHostLatency ( m_host[i].m_hostPtr, m_msgType, now );
+	if ( latency < 0 ) {
+		return i;
+	}
+
+	int32_t best = i;
+	int32_t bestLatency = latency;
+	for ( int32_t j = 0 ; j < m_numHosts ; j++ ) {
+		if ( j == i ) continue;
+		if ( m_host[j].m_retired ) continue;
+		if ( g_hostdb.isDead ( m_host[j].m_hostPtr ) ) continue;
+		int32_t l = g_multicastLatency.getHostLatency ( m_host[j].m_hostPtr, m_msgType, now );
+		if ( l < 0 ) continue;
+		if ( l < bestLatency ) {
+			best = j;
+			bestLatency = l;
+		}
+	}
+
+	// twice as slow and at least 5ms
+	if ( best != i && latency > 2 * bestLatency + 5 ) {
+		logDebug(g_conf.m_logDebugMulticast, "multicast: msgType=0x%02x picking host #%" PRId32" (%" PRId32"ms) "
+		         "instead of host #%" PRId32" (%" PRId32"ms)",
+		         (int)m_msgType, m_host[best].m_hostPtr->m_hostId, bestLatency, m_host[i].m_hostPtr->m_hostId, latency);
+		return best;
+	}
+	return i;
+}
+
 // . returns false and sets error on g_errno
 // . returns true if kicked of the request (m_msg)
 // . sends m_msg to host "h"
@@ -574,6 +632,8 @@ bool Multicast::sendToHost ( int32_t i ) {
 	}
 	// mark it as outstanding
 	m_host[i].m_inProgress = true;
+	m_lastHostNum = i;
+	if ( m_firstHostNum < 0 ) m_firstHostNum = i;
 	// set our last launch date
 	m_lastLaunch = nowms ; // gettimeofdayInMilliseconds();
 
@@ -662,6 +722,67 @@ int Multicast::calculateTimeout() {
 
 }
 
+// . only query time requests are hedged. they are read only and the
+//   query waits for them
+// . needs enough replies for a 95th percentile
+bool Multicast::shouldHedge() const {
+	if ( ! g_conf.m_multicastHedging ) return false;
+	if ( m_niceness != 0 ) return false;
+	if ( m_numHosts < 2 ) return false;
+	switch ( m_msgType ) {
+		case msg_type_0:
+		case msg_type_20:
+		case msg_type_22:
+		case msg_type_39:
+			break;
+		default:
+			return false;
+	}
+	return g_multicastLatency.getPercentile95(m_msgType) >= 0;
+}
+
+void Multicast::hedgeWrapper ( int bogusfd , void *state ) {
+	Multicast *that = static_cast<Multicast*>(state);
+	that->hedge();
+}
+
+// . the first host did not reply within the 95th percentile response time
+// . send the request to a twin too. the first reply wins and closeUpShop()
+//   destroys the other slot. destroySlot() sends the host still working on
+//   it a cancel ack right away so it can stop
+void Multicast::hedge() {
+	// only once
+	g_loop.unregisterSleepCallback ( this , hedgeWrapper );
+	m_registeredHedge = false;
+
+	if ( ! m_inUse ) {
+		return;
+	}
+
+	// if nothing is in progress gotReply1() already sent it to a twin
+	// because of an error
+	bool inProgress = false;
+	for ( int32_t i = 0 ; i < m_numHosts ; i++ ) {
+		if ( m_host[i].m_inProgress ) inProgress = true;
+	}
+	if ( ! inProgress ) {
+		return;
+	}
+
+	if ( ! sendToHostLoop(0,-1) ) {
+		// no twin left to send to
+		g_errno = 0;
+		return;
+	}
+
+	m_hedgeHostNum = m_lastHostNum;
+	g_stats.m_hedges[(int)m_msgType][m_niceness]++;
+
+	logDebug(g_conf.m_logDebugMulticast, "multicast: hedged msgType=0x%02x to host #%" PRId32" after %" PRId64" ms",
+	         (int)m_msgType, m_host[m_hedgeHostNum].m_hostPtr->m_hostId,
+	         gettimeofdayInMilliseconds() - m_startTime);
+}
+
 // this is called every 50 ms so we have the chance to launch our request
 // to a more responsive host
 void Multicast::sleepCallback1Wrapper ( int bogusfd , void    *state ) {
@@ -806,6 +927,13 @@ void Multicast::gotReply1 ( UdpSlot *slot ) {
 	m_replyingHost    = h;
 	m_replyLaunchTime = m_host[i].m_launchTime;
 
+	// response time for latency aware selection and hedging
+	int64_t nowms = gettimeofdayInMilliseconds();
+	if ( ! g_errno )
+		g_multicastLatency.addSample ( h, m_msgType, nowms - m_host[i].m_launchTime, false, i == m_firstHostNum, nowms );
+	else if ( g_errno == EUDPTIMEDOUT )
+		g_multicastLatency.addSample ( h, m_msgType, nowms - m_host[i].m_launchTime, true, i == m_firstHostNum, nowms );
+
 	if ( m_sentToTwin ) {
 		logDebug(g_conf.m_logDebugMulticast, "multicast: Twin msgType=0x%" PRIx32" (this=0x%" PTRFMT") reply: %s.",
 		    (int32_t) m_msgType, (PTRTYPE) this, mstrerror(g_errno));
@@ -886,6 +1014,14 @@ void Multicast::gotReply1 ( UdpSlot *slot ) {
 			g_stats.m_reroutes[(int)m_msgType][m_niceness]++;
 			return;
 		}
+		// . if we hedged (or rerouted) the request we are still
+		//   waiting for another host, so let its reply decide
+		for ( int32_t j = 0 ; j < m_numHosts ; j++ ) {
+			if ( m_host[j].m_inProgress ) {
+				g_errno = 0;
+				return;
+			}
+		}
 		// . otherwise we've failed on all hosts
 		// . re-instate g_errno,might have been set by sendToHostLoop()
 		g_errno =m_host[i].m_errno;
@@ -929,6 +1065,11 @@ void Multicast::closeUpShop ( UdpSlot *slot ) {
 		// save slot so msg4 knows what slot replied in udpserver
 		// for doing its flush callback logic
 		m_slot = slot;
+
+		// did the twin we hedged to win?
+		if ( ! g_errno && m_hedgeHostNum >= 0 && m_host[m_hedgeHostNum].m_slot == slot ) {
+			g_stats.m_hedgeWins[(int)m_msgType][m_niceness]++;
+		}
 	}
 
 	// unregister our sleep wrapper if we did
@@ -936,6 +1077,10 @@ void Multicast::closeUpShop ( UdpSlot *slot ) {
 		g_loop.unregisterSleepCallback(this, sleepCallback1Wrapper);
 		m_registeredSleep = false;
 	}
+	if ( m_registeredHedge ) {
+		g_loop.unregisterSleepCallback(this, hedgeWrapper);
+		m_registeredHedge = false;
+	}
 
 	// allow us to be re-used now, callback might relaunch
 	m_inUse = false;
@@ -948,6 +1093,7 @@ void Multicast::closeUpShop ( UdpSlot *slot ) {
 
 // destroy all slots that may be in progress (except "slot")
 void Multicast::destroySlotsInProgress ( UdpSlot *slot ) {
+	int64_t now = gettimeofdayInMilliseconds();
 	// do a loop over all hosts in the group
 	for (int32_t i = 0 ; i < m_numHosts ; i++ ) {
 		// . destroy all slots but this one that are in progress
@@ -960,10 +1106,16 @@ void Multicast::destroySlotsInProgress ( UdpSlot *slot ) {
 		// must be in progress
 		if ( ! m_host[i].m_inProgress ) continue;
 
+		// . it lost, so it took at least this long
+		// . if it was the first send this still goes into the percentile
+		//   so a hedge that wins doesn't hide how slow the host was
+		g_multicastLatency.addSample ( m_host[i].m_hostPtr, m_msgType, now - m_host[i].m_launchTime, true, i == m_firstHostNum, now );
+
 		// don't free his sendBuf, readBuf is ok to free, however
 		m_host[i].m_slot->m_sendBufAlloc = NULL;
 
-		// destroy this slot that's in progress
+		// . destroy this slot that's in progress
+		// . this sends the host a cancel ack so it stops working on it
 		g_udpServer.destroySlot ( m_host[i].m_slot );
 		// do not re-destroy. consider no longer in progress.
 		m_host[i].m_inProgress = false;
@@ -187,6 +187,15 @@ private:
 
 	bool        m_sentToTwin;
 
+	// . index in m_host[] of the last host we sent to
+	// . of the first host we sent to, the percentile is built from that
+	// . and of the host we hedged the request to, -1 if we didn't
+	int32_t     m_lastHostNum;
+	int32_t     m_firstHostNum;
+	int32_t     m_hedgeHostNum;
+	// are we registered for the hedge callback
+	bool        m_registeredHedge;
+
 	void destroySlotsInProgress ( UdpSlot *slot );
 
 	void sendToWholeGroup();
@@ -196,6 +205,9 @@ private:
 	static void sleepCallback1Wrapper(int bogusfd, void *state);
 	void sleepCallback1();
 	static void sleepWrapper2(int bogusfd, void *state);
+	static void hedgeWrapper(int bogusfd, void *state);
+	void hedge();
+	bool shouldHedge() const;
 	static void gotReply1(void *state, UdpSlot *slot);
 	void gotReply1(UdpSlot *slot);
 	static void gotReply2(void *state, UdpSlot *slot);
@@ -204,6 +216,7 @@ private:
 	bool sendToHostLoop(int32_t key, int32_t firstHostId);
 	bool sendToHost    ( int32_t i ); 
 	int32_t pickBestHost(uint32_t key, int32_t firstHostId);
+	int32_t pickFasterHost(int32_t i);
 	void closeUpShop   ( UdpSlot *slot ) ;
 };
 
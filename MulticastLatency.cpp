@@ -0,0 +1,119 @@
+#include "gb-include.h"
+
+#include "MulticastLatency.h"
+#include "Hostdb.h"
+#include "ScopedLock.h"
+#include "Mem.h"
+#include <algorithm>
+
+
+MulticastLatency g_multicastLatency;
+
+
+MulticastLatency::MulticastLatency()
+	: m_mtx() {
+	for ( int32_t i = 0 ; i < MAX_MSG_TYPES ; i++ ) {
+		m_msgTypes[i] = NULL;
+	}
+}
+
+MulticastLatency::~MulticastLatency() {
+	reset();
+}
+
+void MulticastLatency::reset() {
+	ScopedLock sl(m_mtx);
+	for ( int32_t i = 0 ; i < MAX_MSG_TYPES ; i++ ) {
+		if ( m_msgTypes[i] ) {
+			mfree(m_msgTypes[i], sizeof(MsgTypeEntry), "MulticastLatency");
+			m_msgTypes[i] = NULL;
+		}
+	}
+}
+
+void MulticastLatency::addSample(const Host *h, msg_type_t msgType, int64_t latencyMs, bool censored, bool firstSend, int64_t nowMs) {
+	if ( ! h || h->m_hostId < 0 || h->m_hostId >= MAX_HOSTS ) {
+		return;
+	}
+	if ( latencyMs < 0 ) latencyMs = 0;
+	if ( latencyMs > 0x7fffffff ) latencyMs = 0x7fffffff;
+
+	ScopedLock sl(m_mtx);
+
+	MsgTypeEntry *e = m_msgTypes[(uint8_t)msgType];
+	if ( ! e ) {
+		e = (MsgTypeEntry *)mmalloc(sizeof(MsgTypeEntry), "MulticastLatency");
+		if ( ! e ) {
+			// just go without
+			return;
+		}
+		memset(e, 0, sizeof(MsgTypeEntry));
+		e->m_percentile95 = -1;
+		m_msgTypes[(uint8_t)msgType] = e;
+	}
+
+	// . ewma with alpha 1/4, restarted if the last sample is too old
+	// . a censored sample is a lower bound so it can only make it worse
+	HostEntry *he = &e->m_hosts[h->m_hostId];
+	bool recent = he->m_lastSampleTime != 0 && nowMs - he->m_lastSampleTime < s_maxSampleAge;
+	if ( ! recent ) {
+		he->m_ewma = (int32_t)latencyMs;
+	} else if ( ! censored || latencyMs > he->m_ewma ) {
+		he->m_ewma = he->m_ewma - he->m_ewma / 4 + (int32_t)latencyMs / 4;
+	}
+	he->m_lastSampleTime = nowMs;
+
+	// . a censored first send counts with the time it took until it was
+	//   given up on. that underestimates it, but leaving it out would leave
+	//   out the slowest requests
+	if ( ! firstSend ) {
+		return;
+	}
+
+	e->m_recent[e->m_nextRecent] = (int32_t)latencyMs;
+	e->m_nextRecent = ( e->m_nextRecent + 1 ) % s_numRecent;
+	if ( e->m_numRecent < s_numRecent ) e->m_numRecent++;
+
+	if ( e->m_numRecent < s_minRecent ) {
+		return;
+	}
+	if ( ++e->m_newSamples < s_recomputeInterval && e->m_percentile95 >= 0 ) {
+		return;
+	}
+	e->m_newSamples = 0;
+
+	int32_t tmp[s_numRecent];
+	memcpy(tmp, e->m_recent, e->m_numRecent * sizeof(int32_t));
+	int32_t k = ( e->m_numRecent * 95 ) / 100;
+	std::nth_element(tmp, tmp + k, tmp + e->m_numRecent);
+	e->m_percentile95 = tmp[k];
+}
+
+int32_t MulticastLatency::getHostLatency(const Host *h, msg_type_t msgType, int64_t nowMs) const {
+	if ( ! h || h->m_hostId < 0 || h->m_hostId >= MAX_HOSTS ) {
+		return -1;
+	}
+
+	ScopedLock sl(m_mtx);
+
+	const MsgTypeEntry *e = m_msgTypes[(uint8_t)msgType];
+	if ( ! e ) {
+		return -1;
+	}
+
+	const HostEntry *he = &e->m_hosts[h->m_hostId];
+	if ( he->m_lastSampleTime == 0 || nowMs - he->m_lastSampleTime >= s_maxSampleAge ) {
+		return -1;
+	}
+	return he->m_ewma;
+}
+
+int32_t MulticastLatency::getPercentile95(msg_type_t msgType) const {
+	ScopedLock sl(m_mtx);
+
+	const MsgTypeEntry *e = m_msgTypes[(uint8_t)msgType];
+	if ( ! e ) {
+		return -1;
+	}
+	return e->m_percentile95;
+}
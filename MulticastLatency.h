@@ -0,0 +1,71 @@
+// . response times of Multicast requests, per msg type
+// . an EWMA per host lets Multicast::pickBestHost() steer away from a slow
+//   twin, and the 95th percentile over all hosts is how long Multicast waits
+//   before hedging a request to a twin
+
+#ifndef GB_MULTICASTLATENCY_H
+#define GB_MULTICASTLATENCY_H
+
+#include "msgtype_t.h"
+#include "UdpProtocol.h" // MAX_MSG_TYPES
+#include "GbMutex.h"
+#include "max_hosts.h"
+#include <inttypes.h>
+
+class Host;
+
+class MulticastLatency {
+public:
+	MulticastLatency();
+	~MulticastLatency();
+
+	void reset();
+
+	// . a reply to msgType took "latencyMs" from host "h"
+	// . if "censored" the request was cancelled or timed out after
+	//   "latencyMs", so it is only a lower bound. it can only make the host
+	//   look slower
+	// . only "firstSend" samples, the host a multicast sent to first, go
+	//   into the percentile, censored or not. replies from hedged twins
+	//   would only tell how fast the winners were
+	void addSample(const Host *h, msg_type_t msgType, int64_t latencyMs, bool censored, bool firstSend, int64_t nowMs);
+
+	// smoothed response time of the host in ms. -1 if we have no sample
+	// from the last few seconds
+	int32_t getHostLatency(const Host *h, msg_type_t msgType, int64_t nowMs) const;
+
+	// 95th percentile of the recent first send response times of all hosts
+	// in ms. -1 if there aren't enough samples
+	int32_t getPercentile95(msg_type_t msgType) const;
+
+private:
+	// samples older than this are forgotten, so a host that was slow once
+	// gets another chance
+	static const int64_t s_maxSampleAge = 10000;
+	// recent samples the percentile is computed from
+	static const int32_t s_numRecent = 256;
+	static const int32_t s_minRecent = 64;
+	// recompute the percentile after this many new samples
+	static const int32_t s_recomputeInterval = 16;
+
+	struct HostEntry {
+		int32_t m_ewma;
+		int64_t m_lastSampleTime;
+	};
+
+	struct MsgTypeEntry {
+		HostEntry m_hosts[MAX_HOSTS];
+		int32_t m_recent[s_numRecent];
+		int32_t m_numRecent;
+		int32_t m_nextRecent;
+		int32_t m_newSamples;
+		int32_t m_percentile95;
+	};
+
+	mutable GbMutex m_mtx;
+	MsgTypeEntry *m_msgTypes[MAX_MSG_TYPES];
+};
+
+extern MulticastLatency g_multicastLatency;
+
+#endif // GB_MULTICASTLATENCY_H
@@ -140,6 +140,11 @@ skipReplaceHost:
 
 			       "<td><b>try agains recvd</b></td>"
 
+			       "<td><b>srtt</b></td>"
+			       "<td><b>rto</b></td>"
+			       "<td><b>cwnd</b></td>"
+			       "<td><b>cwnd cuts</b></td>"
+
 			       "<td><a href=\"/admin/hosts?c=%s&sort=13\">"
 			       "<b>avg split time</b></a></td>"
 
@@ -176,6 +181,7 @@ skipReplaceHost:
 			h->m_etryagains   = 0;
 			h->m_dgramsTo     = 0;
 			h->m_dgramsFrom   = 0;
+			h->m_udpCongestion.resetStats();
 			h->m_splitTimes = 0;
 			h->m_splitsDone = 0;
 		}
@@ -264,6 +270,11 @@ skipReplaceHost:
 		if ( h->m_splitsDone ) 
 			splitTime = h->m_splitTimes / h->m_splitsDone;
 
+		// udp rtt estimate and congestion window, rtts in ms
+		const UdpCongestion &congestion = h->m_udpCongestion;
+		double srtt = congestion.getSrtt() / 1000.0;
+		double rto  = ( congestion.getSrtt() + 4.0 * congestion.getRttVar() ) / 1000.0;
+
 		//char flagString[32];
 		StackBuf<64> fb;
 
@@ -385,6 +396,13 @@ skipReplaceHost:
 				      "</errorTryAgains>\n",
 				      h->m_etryagains.load());
 
+			sb.safePrintf("\t\t<srtt>%.2f</srtt>\n", srtt);
+			sb.safePrintf("\t\t<rto>%.2f</rto>\n", rto);
+			sb.safePrintf("\t\t<cwnd>%" PRId32"</cwnd>\n",
+				      congestion.getWindow());
+			sb.safePrintf("\t\t<cwndCuts>%" PRId32"</cwndCuts>\n",
+				      congestion.getNumWindowDecreases());
+
 			/*
 			sb.safePrintf("\t\t<dgramsTo>%" PRId64"</dgramsTo>\n",
 				      h->m_dgramsTo);
@@ -457,6 +475,13 @@ skipReplaceHost:
 			sb.safePrintf("\t\t\t\t\"errorTryAgains\":%" PRId32",\n",
 				      h->m_etryagains.load());
 
+			sb.safePrintf("\t\t\t\t\"srtt\":%.2f,\n", srtt);
+			sb.safePrintf("\t\t\t\t\"rto\":%.2f,\n", rto);
+			sb.safePrintf("\t\t\t\t\"cwnd\":%" PRId32",\n",
+				      congestion.getWindow());
+			sb.safePrintf("\t\t\t\t\"cwndCuts\":%" PRId32",\n",
+				      congestion.getNumWindowDecreases());
+
 			/*
 			sb.safePrintf("\t\t\t\t\"dgramsTo\":%" PRId64",\n",
 				      h->m_dgramsTo);
@@ -522,6 +547,12 @@ skipReplaceHost:
 			  // etryagains
 			  "<td>%" PRId32"</td>"
 
+			  // srtt, rto, cwnd, cwnd cuts
+			  "<td>%.2f</td>"
+			  "<td>%.2f</td>"
+			  "<td>%" PRId32"</td>"
+			  "<td>%" PRId32"</td>"
+
 			  // split time
 			  "<td>%" PRId32"</td>"
 			  // splits done
@@ -552,6 +583,11 @@ skipReplaceHost:
 			  h->m_totalResends.load(),
 			  h->m_etryagains.load(),
 
+			  srtt,
+			  rto,
+			  congestion.getWindow(),
+			  congestion.getNumWindowDecreases(),
+
 			  splitTime,
 			  h->m_splitsDone,
 
@@ -691,6 +727,38 @@ skipReplaceHost:
 		  "</td>"
 		  "</tr>\n"
 
+		  "<tr class=poo>"
+		  "<td>srtt</td>"
+		  "<td>Smoothed round trip time in milliseconds of the udp "
+		  "datagrams sent to this host, measured from the ACKs. "
+		  "Datagrams that were resent are not measured."
+		  "</td>"
+		  "</tr>\n"
+
+		  "<tr class=poo>"
+		  "<td>rto</td>"
+		  "<td>Resend timeout in milliseconds computed from the round "
+		  "trip time and its deviation. Datagrams not ACKed within it "
+		  "are resent, although never sooner than 40ms."
+		  "</td>"
+		  "</tr>\n"
+
+		  "<tr class=poo>"
+		  "<td>cwnd</td>"
+		  "<td>Congestion window. How many unACKed datagrams a udp "
+		  "transaction may have outstanding to this host. Grows as "
+		  "datagrams are ACKed and is halved when they are lost."
+		  "</td>"
+		  "</tr>\n"
+
+		  "<tr class=poo>"
+		  "<td>cwnd cuts</td>"
+		  "<td>How many times the congestion window was halved "
+		  "because datagrams to this host were lost. High numbers "
+		  "mean the host or the network to it is congested."
+		  "</td>"
+		  "</tr>\n"
+
 		  "<tr class=poo>"
 		  "<td>avg split time</td>"
 		  "<td>Average time this host took to compute the docids "
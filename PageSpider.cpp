@@ -256,7 +256,7 @@ static bool generatePageHTML(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	// count # of spiders out
 	int32_t j = 0;
 	// first print the spider recs we are spidering
-	for (int32_t i = 0; i < (int32_t)MAX_SPIDERS; i++) {
+	for (size_t i = 0; i < g_spiderLoop.m_docs.size(); i++) {
 		// get it
 		XmlDoc *xd = g_spiderLoop.m_docs[i];
 		// skip if empty
@@ -408,6 +408,43 @@ static bool generatePageHTML(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	sb->safePrintf ( "</table>\n" );
 	sb->safePrintf ( "<br>\n" );
 
+	/////////////////
+	//
+	// PRINT URL FILTER HITS
+	//
+	// how many times each url filter rule matched on this host since
+	// the url filters were last changed
+	//
+	/////////////////
+	urlfilterprogram_ptr_t prog = cr->getUrlFilterProgram();
+	sb->safePrintf ( "<table %s>\n"
+	                "<tr><td colspan=50>"
+	                "<b>URL Filter Hits for collection "
+	                "<font color=red><b>%s</b>"
+	                "</font></b>"
+	                "</td></tr>\n",
+	                TABLE_STYLE,
+	                cr->m_coll );
+	sb->safePrintf("<tr bgcolor=#%s>",DARK_BLUE);
+	sb->safePrintf("<td><b>#</b></td>\n");
+	sb->safePrintf("<td><b>expression</b></td>\n");
+	sb->safePrintf("<td><b>priority</b></td>\n");
+	sb->safePrintf("<td><b>hits</b></td>\n");
+	sb->safePrintf("</tr>\n");
+	for ( int32_t i = 0 ; i < prog->getNumRules() && i < cr->m_numRegExs ; i++ ) {
+		const char *expr = cr->m_regExs[i].getBufStart();
+		sb->safePrintf("<tr bgcolor=#%s><td>%" PRId32"</td><td>", LIGHT_BLUE, i);
+		sb->htmlEncode ( expr ? expr : "" );
+		sb->safePrintf("</td>"
+		               "<td>%" PRId32"</td>"
+		               "<td>%" PRId64"</td>"
+		               "</tr>\n",
+		               (int32_t)cr->m_spiderPriorities[i],
+		               prog->getHits(i));
+	}
+	sb->safePrintf ( "</table>\n" );
+	sb->safePrintf ( "<br>\n" );
+
 	return true;
 }
 
@@ -437,7 +474,7 @@ static bool generatePageJSON(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	// count # of spiders out
 	int32_t j = 0;
 	// first print the spider recs we are spidering
-	for (int32_t i = 0; i < (int32_t)MAX_SPIDERS; i++) {
+	for (size_t i = 0; i < g_spiderLoop.m_docs.size(); i++) {
 		XmlDoc *xd = g_spiderLoop.m_docs[i];
 		if (!xd) {
 			continue;
@@ -557,6 +594,28 @@ static bool generatePageJSON(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 			if (++count == 20) break;
 		}
 	}
+	sb->safePrintf("\t],\n");
+
+	// how many times each url filter rule matched on this host
+	urlfilterprogram_ptr_t prog = cr->getUrlFilterProgram();
+	sb->safePrintf("\t\"urlFilterHits\": [\n");
+	for ( int32_t i = 0 ; i < prog->getNumRules() && i < cr->m_numRegExs ; i++ ) {
+		if (i != 0) {
+			sb->safePrintf("\t\t,\n");
+		}
+
+		const char *expr = cr->m_regExs[i].getBufStart();
+
+		sb->safePrintf("\t\t{\n");
+
+		sb->safePrintf("\t\t\t\"expression\": \"");
+		sb->jsonEncode(expr ? expr : "");
+		sb->safePrintf("\",\n");
+		sb->safePrintf("\t\t\t\"priority\": %d,\n", (int)cr->m_spiderPriorities[i]);
+		sb->safePrintf("\t\t\t\"hits\": %" PRId64"\n", prog->getHits(i));
+
+		sb->safePrintf("\t\t}\n");
+	}
 	sb->safePrintf("\t]\n");
 
 	sb->safePrintf("}\n}\n");
@@ -20,6 +20,8 @@
 #include "Sections.h"
 #include "Msg13.h"
 #include "Msg3.h"
+#include "Msg4In.h"
+#include "JobDag.h"
 #include "Mem.h"
 
 
@@ -258,6 +260,153 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 	if ( format == FORMAT_HTML ) p.safePrintf("</table><br><br>\n");
 
+	// msg4 ingestion stats
+	Msg4InStats m4;
+	Msg4In::getStats ( &m4 );
+	double m4Secs = (double)m4.m_processingTimeUs / 1000000.0;
+	double m4RecsPerSec = m4Secs > 0 ? (double)m4.m_numRecs / m4Secs : 0;
+	double m4BytesPerSec = m4Secs > 0 ? (double)m4.m_numBytes / m4Secs : 0;
+	double m4AvgBatch = m4.m_numBatches > 0 ? (double)m4.m_numRequests / (double)m4.m_numBatches : 0;
+
+	if ( format == FORMAT_HTML )
+		p.safePrintf (
+			      "<table %s>"
+			      "<tr class=hdrow>"
+			      "<td colspan=2>"
+			      "<center><b>Msg4 Ingestion</b></td></tr>\n"
+			      "<tr class=poo><td><b>Batches</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Requests</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Requests Told To Try Again</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Records</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Bytes</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Avg Requests Per Batch</b></td><td>%.2f</td></tr>\n"
+			      "<tr class=poo><td><b>Max Requests Per Batch</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Processing Time (ms)</b></td><td>%" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>Records/sec Processing</b></td><td>%.0f</td></tr>\n"
+			      "<tr class=poo><td><b>Bytes/sec Processing</b></td><td>%.0f</td></tr>\n"
+			      "</table><br><br>\n"
+			      , TABLE_STYLE
+			      , m4.m_numBatches
+			      , m4.m_numRequests
+			      , m4.m_numTryAgains
+			      , m4.m_numRecs
+			      , m4.m_numBytes
+			      , m4AvgBatch
+			      , m4.m_maxBatchSize
+			      , m4.m_processingTimeUs / 1000
+			      , m4RecsPerSec
+			      , m4BytesPerSec );
+
+	if ( format == FORMAT_XML )
+		p.safePrintf ("\t<msg4Ingestion>\n"
+			      "\t\t<numBatches>%" PRId64"</numBatches>\n"
+			      "\t\t<numRequests>%" PRId64"</numRequests>\n"
+			      "\t\t<numTryAgains>%" PRId64"</numTryAgains>\n"
+			      "\t\t<numRecords>%" PRId64"</numRecords>\n"
+			      "\t\t<numBytes>%" PRId64"</numBytes>\n"
+			      "\t\t<maxBatchSize>%" PRId64"</maxBatchSize>\n"
+			      "\t\t<processingMS>%" PRId64"</processingMS>\n"
+			      "\t</msg4Ingestion>\n"
+			      , m4.m_numBatches
+			      , m4.m_numRequests
+			      , m4.m_numTryAgains
+			      , m4.m_numRecs
+			      , m4.m_numBytes
+			      , m4.m_maxBatchSize
+			      , m4.m_processingTimeUs / 1000 );
+
+	if ( format == FORMAT_JSON )
+		p.safePrintf ("\t\"msg4Ingestion\":{\n"
+			      "\t\t\"numBatches\":%" PRId64",\n"
+			      "\t\t\"numRequests\":%" PRId64",\n"
+			      "\t\t\"numTryAgains\":%" PRId64",\n"
+			      "\t\t\"numRecords\":%" PRId64",\n"
+			      "\t\t\"numBytes\":%" PRId64",\n"
+			      "\t\t\"maxBatchSize\":%" PRId64",\n"
+			      "\t\t\"processingMS\":%" PRId64"\n"
+			      "\t},\n"
+			      , m4.m_numBatches
+			      , m4.m_numRequests
+			      , m4.m_numTryAgains
+			      , m4.m_numRecs
+			      , m4.m_numBytes
+			      , m4.m_maxBatchSize
+			      , m4.m_processingTimeUs / 1000 );
+
+	// parallel stage timings, like the document hashing ones
+	std::vector<JobDagStageStats> dagStats;
+	JobDag::getStats ( &dagStats );
+
+	if ( format == FORMAT_HTML && !dagStats.empty() )
+		p.safePrintf (
+			      "<table %s>"
+			      "<tr class=hdrow>"
+			      "<td colspan=5>"
+			      "<center><b>Parallel Stages</b></td></tr>\n"
+			      "<tr class=poo><td><b>Stage</b></td><td><b>Runs</b></td>"
+			      "<td><b>Ran In Job Thread</b></td><td><b>Avg (ms)</b></td>"
+			      "<td><b>Max (ms)</b></td></tr>\n"
+			      , TABLE_STYLE );
+
+	if ( format == FORMAT_XML )
+		p.safePrintf ("\t<parallelStages>\n");
+
+	if ( format == FORMAT_JSON )
+		p.safePrintf ("\t\"parallelStages\":[\n");
+
+	for ( size_t i = 0 ; i < dagStats.size() ; i++ ) {
+		const JobDagStageStats &ds = dagStats[i];
+		double avgMs = ds.m_count > 0 ? (double)ds.m_totalTime / (double)ds.m_count / 1000.0 : 0;
+		double maxMs = (double)ds.m_maxTime / 1000.0;
+
+		if ( format == FORMAT_HTML )
+			p.safePrintf ("<tr class=poo><td>%s</td><td>%" PRId64"</td>"
+				      "<td>%" PRId64"</td><td>%.2f</td><td>%.2f</td></tr>\n"
+				      , ds.m_name.c_str()
+				      , ds.m_count
+				      , ds.m_inJobCount
+				      , avgMs
+				      , maxMs );
+
+		if ( format == FORMAT_XML )
+			p.safePrintf ("\t\t<stage>\n"
+				      "\t\t\t<name><![CDATA[%s]]></name>\n"
+				      "\t\t\t<runs>%" PRId64"</runs>\n"
+				      "\t\t\t<inJobThread>%" PRId64"</inJobThread>\n"
+				      "\t\t\t<avgMS>%.2f</avgMS>\n"
+				      "\t\t\t<maxMS>%.2f</maxMS>\n"
+				      "\t\t</stage>\n"
+				      , ds.m_name.c_str()
+				      , ds.m_count
+				      , ds.m_inJobCount
+				      , avgMs
+				      , maxMs );
+
+		if ( format == FORMAT_JSON )
+			p.safePrintf ("\t\t{\n"
+				      "\t\t\t\"name\":\"%s\",\n"
+				      "\t\t\t\"runs\":%" PRId64",\n"
+				      "\t\t\t\"inJobThread\":%" PRId64",\n"
+				      "\t\t\t\"avgMS\":%.2f,\n"
+				      "\t\t\t\"maxMS\":%.2f\n"
+				      "\t\t}%s\n"
+				      , ds.m_name.c_str()
+				      , ds.m_count
+				      , ds.m_inJobCount
+				      , avgMs
+				      , maxMs
+				      , i + 1 < dagStats.size() ? "," : "" );
+	}
+
+	if ( format == FORMAT_HTML && !dagStats.empty() )
+		p.safePrintf ("</table><br><br>\n");
+
+	if ( format == FORMAT_XML )
+		p.safePrintf ("\t</parallelStages>\n");
+
+	if ( format == FORMAT_JSON )
+		p.safePrintf ("\t],\n");
+
 	// stripe loads
 	if ( g_hostdb.m_myHost->m_isProxy ) {
 		p.safePrintf ( 
@@ -299,6 +448,9 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 	caches[numCaches++] = g_dns.getCache();
 	caches[numCaches++] = g_dns.getCacheLocal();
 	caches[numCaches++] = &g_spiderLoop.m_winnerListCache;
+	caches[numCaches++] = &g_termFreqCache;
+	if ( getDiskPageCache(RDB_POSDB) )
+		caches[numCaches++] = getDiskPageCache(RDB_POSDB);
 
 	if ( format == FORMAT_HTML ) {
 		p.safePrintf (
@@ -337,6 +489,18 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			     caches[i]->getMaxMem());
 		p.safePrintf("\t\t<saveToDisk>%" PRId32"</saveToDisk>\n",
 			     (int32_t)caches[i]->useDisk());
+		p.safePrintf("\t\t<numShards>%" PRId32"</numShards>\n",
+			     caches[i]->getNumShards());
+		p.safePrintf("\t\t<numLockAcquires>%" PRId64"</numLockAcquires>\n",
+			     caches[i]->getNumLockAcquires());
+		p.safePrintf("\t\t<numLockContended>%" PRId64"</numLockContended>\n",
+			     caches[i]->getNumLockContended());
+		p.safePrintf("\t\t<lockWaitMS>%" PRId64"</lockWaitMS>\n",
+			     caches[i]->getLockWaitTime()/1000);
+		p.safePrintf("\t\t<numLockFreeReads>%" PRId64"</numLockFreeReads>\n",
+			     caches[i]->getNumLockFreeReads());
+		p.safePrintf("\t\t<numLockFreeFallbacks>%" PRId64"</numLockFreeFallbacks>\n",
+			     caches[i]->getNumLockFreeFallbacks());
 		p.safePrintf("\t</cacheStats>\n");
 	}
 
@@ -361,8 +525,20 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			     caches[i]->getMemOccupied());
 		p.safePrintf("\t\t\"maxBytes\":%" PRId32",\n",
 			     caches[i]->getMaxMem());
-		p.safePrintf("\t\t\"saveToDisk\":%" PRId32"\n",
+		p.safePrintf("\t\t\"saveToDisk\":%" PRId32",\n",
 			     (int32_t)caches[i]->useDisk());
+		p.safePrintf("\t\t\"numShards\":%" PRId32",\n",
+			     caches[i]->getNumShards());
+		p.safePrintf("\t\t\"numLockAcquires\":%" PRId64",\n",
+			     caches[i]->getNumLockAcquires());
+		p.safePrintf("\t\t\"numLockContended\":%" PRId64",\n",
+			     caches[i]->getNumLockContended());
+		p.safePrintf("\t\t\"lockWaitMS\":%" PRId64",\n",
+			     caches[i]->getLockWaitTime()/1000);
+		p.safePrintf("\t\t\"numLockFreeReads\":%" PRId64",\n",
+			     caches[i]->getNumLockFreeReads());
+		p.safePrintf("\t\t\"numLockFreeFallbacks\":%" PRId64"\n",
+			     caches[i]->getNumLockFreeFallbacks());
 		p.safePrintf("\t},\n");
 	}
 
@@ -442,6 +618,46 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 		p.safePrintf("<td>%" PRId64"</td>",a);
 	}
 
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>shards</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int64_t a = caches[i]->getNumShards();
+		p.safePrintf("<td>%" PRId64"</td>",a);
+	}
+
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>lock acquires</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int64_t a = caches[i]->getNumLockAcquires();
+		p.safePrintf("<td>%" PRId64"</td>",a);
+	}
+
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>lock contended</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int64_t a = caches[i]->getNumLockAcquires();
+		int64_t b = caches[i]->getNumLockContended();
+		if ( a > 0 )
+			p.safePrintf("<td>%" PRId64" (%.1f%%)</td>",b,100.0*(double)b/(double)a);
+		else
+			p.safePrintf("<td>--</td>");
+	}
+
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>lock wait ms</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int64_t a = caches[i]->getLockWaitTime() / 1000;
+		p.safePrintf("<td>%" PRId64"</td>",a);
+	}
+
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>lock-free reads</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int64_t a = caches[i]->getNumLockFreeReads();
+		p.safePrintf("<td>%" PRId64"</td>",a);
+	}
+
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>lock-free fallbacks</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int64_t a = caches[i]->getNumLockFreeFallbacks();
+		p.safePrintf("<td>%" PRId64"</td>",a);
+	}
+
 	// end the table now
 	p.safePrintf ( "</tr>\n</table><br><br>" );
 
@@ -640,6 +856,12 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 	//
 	// print network stats
 	//
+	const UdpBatchStatistic &batchStats = g_udpServer.getBatchStatistic();
+	char recvBatchSizes[256];
+	char sendBatchSizes[256];
+	batchStats.printRecvHistogram(recvBatchSizes, sizeof(recvBatchSizes));
+	batchStats.printSendHistogram(sendBatchSizes, sizeof(sendBatchSizes));
+
 	if ( format == FORMAT_HTML )
 		p.safePrintf ( 
 			      "<table %s>"
@@ -678,6 +900,17 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			      "</td><td>%" PRId32"</td></tr>\n"
 			      "<tr class=poo><td><b>dropped dgrams</b>"
 			      "</td><td>%" PRId32"</td></tr>\n"
+
+			      "<tr class=poo><td><b>udp recv batches/dgrams</b>"
+			      "</td><td>%" PRId64" / %" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>udp recv batch sizes</b>"
+			      "</td><td>%s</td></tr>\n"
+			      "<tr class=poo><td><b>udp send batches/dgrams</b>"
+			      "</td><td>%" PRId64" / %" PRId64"</td></tr>\n"
+			      "<tr class=poo><td><b>udp send batch sizes</b>"
+			      "</td><td>%s</td></tr>\n"
+			      "<tr class=poo><td><b>udp send batches blocked</b>"
+			      "</td><td>%" PRId64"</td></tr>\n"
 			      ,
 			      TABLE_STYLE,
 
@@ -699,7 +932,15 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 			      g_cancelAcksSent,
 			      g_cancelAcksRead,
-			      g_dropped
+			      g_dropped,
+
+			      batchStats.getNumRecvCalls(),
+			      batchStats.getNumRecvDgrams(),
+			      recvBatchSizes,
+			      batchStats.getNumSendCalls(),
+			      batchStats.getNumSendDgrams(),
+			      sendBatchSizes,
+			      batchStats.getNumSendBlocked()
 			       );
 
 
@@ -734,6 +975,14 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 			      "\t\t<droppedDgrams>%" PRId32"</droppedDgrams>\n"
 
+			      "\t\t<udpRecvBatches>%" PRId64"</udpRecvBatches>\n"
+			      "\t\t<udpRecvBatchDgrams>%" PRId64"</udpRecvBatchDgrams>\n"
+			      "\t\t<udpRecvBatchSizes>%s</udpRecvBatchSizes>\n"
+			      "\t\t<udpSendBatches>%" PRId64"</udpSendBatches>\n"
+			      "\t\t<udpSendBatchDgrams>%" PRId64"</udpSendBatchDgrams>\n"
+			      "\t\t<udpSendBatchSizes>%s</udpSendBatchSizes>\n"
+			      "\t\t<udpSendBatchesBlocked>%" PRId64"</udpSendBatchesBlocked>\n"
+
 			      "\t</networkStats>\n"
 
 			      ,
@@ -757,7 +1006,15 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 			      g_cancelAcksSent,
 			      g_cancelAcksRead,
-			      g_dropped
+			      g_dropped,
+
+			      batchStats.getNumRecvCalls(),
+			      batchStats.getNumRecvDgrams(),
+			      recvBatchSizes,
+			      batchStats.getNumSendCalls(),
+			      batchStats.getNumSendDgrams(),
+			      sendBatchSizes,
+			      batchStats.getNumSendBlocked()
 			       );
 
 	if ( format == FORMAT_JSON )
@@ -788,6 +1045,14 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 			      "\t\t\"droppedDgrams\":%" PRId32",\n"
 
+			      "\t\t\"udpRecvBatches\":%" PRId64",\n"
+			      "\t\t\"udpRecvBatchDgrams\":%" PRId64",\n"
+			      "\t\t\"udpRecvBatchSizes\":\"%s\",\n"
+			      "\t\t\"udpSendBatches\":%" PRId64",\n"
+			      "\t\t\"udpSendBatchDgrams\":%" PRId64",\n"
+			      "\t\t\"udpSendBatchSizes\":\"%s\",\n"
+			      "\t\t\"udpSendBatchesBlocked\":%" PRId64",\n"
+
 			      "\t},\n"
 
 			      ,
@@ -811,7 +1076,15 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 			      g_cancelAcksSent,
 			      g_cancelAcksRead,
-			      g_dropped
+			      g_dropped,
+
+			      batchStats.getNumRecvCalls(),
+			      batchStats.getNumRecvDgrams(),
+			      recvBatchSizes,
+			      batchStats.getNumSendCalls(),
+			      batchStats.getNumSendDgrams(),
+			      sendBatchSizes,
+			      batchStats.getNumSendBlocked()
 			       );
 
 	if ( format == FORMAT_HTML ) 
@@ -1049,6 +1322,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			      "<td><b>acks out</td>\n"
 
 			      "<td><b>reroutes</td>\n"
+			      "<td><b>hedges</td>\n"
+			      "<td><b>hedge wins</td>\n"
 			      "<td><b>dropped</td>\n"
 			      "<td><b>cancels read</td>\n"
 			      "<td><b>errors</td>\n"
@@ -1072,6 +1347,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			// skip it if has no handler
 			if ( ! g_udpServer.hasHandler(i1) ) continue;
 			if ( ! g_stats.m_reroutes   [i1][i3] &&
+			     ! g_stats.m_hedges     [i1][i3] &&
 			     ! g_stats.m_packetsIn  [i1][i3] &&
 			     ! g_stats.m_packetsOut [i1][i3] &&
 			     ! g_stats.m_errors     [i1][i3] &&
@@ -1092,6 +1368,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     "<td>%" PRId32"</td>" // acks in
 					     "<td>%" PRId32"</td>" // acks out
 					     "<td>%" PRId32"</td>" // reroutes
+					     "<td>%" PRId32"</td>" // hedges
+					     "<td>%" PRId32"</td>" // hedge wins
 					     "<td>%" PRId32"</td>" // dropped
 					     "<td>%" PRId32"</td>" // cancel read
 					     "<td>%" PRId32"</td>" // errors
@@ -1106,6 +1384,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     g_stats.m_acksIn [i1][i3],
 					     g_stats.m_acksOut[i1][i3],
 					     g_stats.m_reroutes[i1][i3],
+					     g_stats.m_hedges[i1][i3],
+					     g_stats.m_hedgeWins[i1][i3],
 					     g_stats.m_dropped[i1][i3],
 					     g_stats.m_cancelRead[i1][i3],
 					     g_stats.m_errors[i1][i3],
@@ -1122,6 +1402,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     "\t\t<acksIn>%" PRId32"</acksIn>\n"
 					     "\t\t<acksOut>%" PRId32"</acksOut>\n"
 					     "\t\t<reroutes>%" PRId32"</reroutes>\n"
+					     "\t\t<hedges>%" PRId32"</hedges>\n"
+					     "\t\t<hedgeWins>%" PRId32"</hedgeWins>\n"
 					     "\t\t<dropped>%" PRId32"</dropped>\n"
 					     "\t\t<cancelsRead>%" PRId32"</cancelsRead>\n"
 					     "\t\t<errors>%" PRId32"</errors>\n"
@@ -1135,6 +1417,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     g_stats.m_acksIn [i1][i3],
 					     g_stats.m_acksOut[i1][i3],
 					     g_stats.m_reroutes[i1][i3],
+					     g_stats.m_hedges[i1][i3],
+					     g_stats.m_hedgeWins[i1][i3],
 					     g_stats.m_dropped[i1][i3],
 					     g_stats.m_cancelRead[i1][i3],
 					     g_stats.m_errors[i1][i3],
@@ -1151,6 +1435,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     "\t\t\"acksIn\":%" PRId32",\n"
 					     "\t\t\"acksOut\":%" PRId32",\n"
 					     "\t\t\"reroutes\":%" PRId32",\n"
+					     "\t\t\"hedges\":%" PRId32",\n"
+					     "\t\t\"hedgeWins\":%" PRId32",\n"
 					     "\t\t\"dropped\":%" PRId32",\n"
 					     "\t\t\"cancelsRead\":%" PRId32",\n"
 					     "\t\t\"errors\":%" PRId32",\n"
@@ -1164,6 +1450,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     g_stats.m_acksIn [i1][i3],
 					     g_stats.m_acksOut[i1][i3],
 					     g_stats.m_reroutes[i1][i3],
+					     g_stats.m_hedges[i1][i3],
+					     g_stats.m_hedgeWins[i1][i3],
 					     g_stats.m_dropped[i1][i3],
 					     g_stats.m_cancelRead[i1][i3],
 					     g_stats.m_errors[i1][i3],
@@ -1566,6 +1854,36 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 	}
 	p.safePrintf("<td>%" PRId64"</td></tr>\n",total);
 
+	// print index mem
+	p.safePrintf("<tr class=poo><td><b>index mem</b></td>");
+	total = 0LL;
+	for ( int32_t i = 0 ; i < nr ; i++ ) {
+		int64_t val = rdbs[i]->getIndexMemAllocated();
+		total += val;
+		p.safePrintf("<td>%" PRIu64"</td>",val);
+	}
+	p.safePrintf("<td>%" PRId64"</td></tr>\n",total);
+
+	// print time spent loading maps and indexes
+	p.safePrintf("<tr class=poo><td><b>load time (ms)</b></td>");
+	total = 0LL;
+	for ( int32_t i = 0 ; i < nr ; i++ ) {
+		int64_t val = rdbs[i]->getLoadTimeMs();
+		total += val;
+		p.safePrintf("<td>%" PRId64"</td>",val);
+	}
+	p.safePrintf("<td>%" PRId64"</td></tr>\n",total);
+
+	// print # of cold collections not loaded yet
+	p.safePrintf("<tr class=poo><td><b>unloaded collections</b></td>");
+	total = 0LL;
+	for ( int32_t i = 0 ; i < nr ; i++ ) {
+		int64_t val = rdbs[i]->getNumUnloadedBases();
+		total += val;
+		p.safePrintf("<td>%" PRId64"</td>",val);
+	}
+	p.safePrintf("<td>%" PRId64"</td></tr>\n",total);
+
 	/*
 	// print rec cache hits %
 	p.safePrintf("<tr class=poo><td><b>rec cache hits %%</b></td>");
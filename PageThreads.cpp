@@ -148,6 +148,7 @@ bool sendPageThreads ( TcpSocket *s , HttpRequest *r ) {
 	p.safePrintf("    <td><b>Time executing</b></td>\n");
 	p.safePrintf("    <td><b>Time waiting for cleanup</b></td>\n");
 	p.safePrintf("    <td><b>Cleanup time</b></td>\n");
+	p.safePrintf("    <td><b>Stolen</b></td>\n");
 	p.safePrintf("   </tr>\n");
 	for(const auto &js : g_jobScheduler.query_job_statistics(true)) {
 		p.safePrintf("  <tr bgcolor=#%s>\n",LIGHT_BLUE);
@@ -165,6 +166,7 @@ bool sendPageThreads ( TcpSocket *s , HttpRequest *r ) {
 			p.safePrintf("    <td>-</td>\n");
 			p.safePrintf("    <td>-</td>\n");
 		}
+		p.safePrintf("    <td>%lu</td>\n",js.second.stolen_count);
 		p.safePrintf("   </tr>\n");
 	}
 
@@ -4806,7 +4806,7 @@ void Parms::init ( ) {
 		"pages the spider is allowed to download "
 		"simultaneously for ALL collections PER HOST? Caution: "
 		"raising this too high could result in some Out of Memory "
-		"(OOM) errors. The hard limit is currently 300. Each "
+		"(OOM) errors. Each "
 		"collection has its own limit in the <i>spider controls</i> "
 		"that you may have to increase as well.";
 	m->m_cgi   = "mtsp";
@@ -5226,6 +5226,32 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "mem table tracking";
+	m->m_desc  = "Keep every allocation in a table so unbalanced frees "
+		"are caught and buffer breeches can be checked for on all "
+		"allocations. This takes a global lock on every allocation. "
+		"When disabled the memory breakdown is kept with per thread "
+		"counters.";
+	m->m_cgi   = "memtbl";
+	simple_m_set(Conf,m_memTableTracking);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "mem sample rate";
+	m->m_desc  = "Record 1 in this many allocations along with a "
+		"backtrace, shown on the stats page, for finding leaks. "
+		"0 disables sampling.";
+	m->m_cgi   = "memsr";
+	simple_m_set(Conf,m_memSampleRate);
+	m->m_def   = "0";
+	m->m_units = "allocations";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "do consistency testing";
 	m->m_desc  = "When enabled Gigablast will make sure it reparses "
 		"the document exactly the same way. It does this every "
@@ -5689,6 +5715,70 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "min cpu threads";
+	m->m_desc  = "The cpu thread pool shrinks to this many threads when idle, "
+		"and grows up to max cpu threads when jobs queue up. (Changes requires restart)";
+	m->m_cgi   = "min_cpu_threads";
+	simple_m_set(Conf,m_minCpuThreads);
+	m->m_def   = "1";
+	m->m_units = "threads";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "min summary threads";
+	m->m_desc  = "The summary thread pool shrinks to this many threads when idle, "
+		"and grows up to max summary threads when jobs queue up. (Changes requires restart)";
+	m->m_cgi   = "min_summary_threads";
+	simple_m_set(Conf,m_minSummaryThreads);
+	m->m_def   = "1";
+	m->m_units = "threads";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "min merge threads";
+	m->m_desc  = "The merge thread pool shrinks to this many threads when idle, "
+		"and grows up to max merge threads when jobs queue up. (Changes requires restart)";
+	m->m_cgi   = "min_merge_threads";
+	simple_m_set(Conf,m_minMergeThreads);
+	m->m_def   = "1";
+	m->m_units = "threads";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "job thread idle timeout";
+	m->m_desc  = "Threads above the min cpu/summary/merge threads exit after being idle this long. "
+		"Disable with =0, then the pools keep the max number of threads. (Changes requires restart)";
+	m->m_cgi   = "job_thread_idle_timeout";
+	simple_m_set(Conf,m_jobThreadIdleTimeout);
+	m->m_def   = "0";
+	m->m_units = "milliseconds";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "job work stealing";
+	m->m_desc  = "Let idle cpu, summary and merge threads run jobs queued for the other pools, "
+		"so eg. query intersections don't wait while the summary threads are idle. "
+		"Cpu and summary threads never take merge jobs. (Changes requires restart)";
+	m->m_cgi   = "job_work_stealing";
+	simple_m_set(Conf,m_jobWorkStealing);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "max job cleanup time";
 	m->m_desc  = "Maximum number of milliseconds the main thread is allow to spend on cleanup up finished jobs. "
 		"Disable with =0. If enabled the main thraed will abort the process if it detects a job cleanup taking too long.";
@@ -5702,6 +5792,87 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "loop edge triggered";
+	m->m_desc  = "If enabled then the main loop waits for socket events with "
+		"edge triggered epoll instead of level triggered. Fewer wakeups, but "
+		"a read callback that doesn't read everything available is not "
+		"called again until more data arrives. (Changes requires restart)";
+	m->m_cgi   = "loop_edge_triggered";
+	simple_m_set(Conf,m_loopEdgeTriggered);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "udp batch size";
+	m->m_desc  = "Maximum number of datagrams the udp server reads or sends "
+		"with one system call. 1 disables batching. Values above 64 are "
+		"treated as 64.";
+	m->m_cgi   = "udp_batch_size";
+	simple_m_set(Conf,m_udpBatchSize);
+	m->m_def   = "32";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "udp receive threads";
+	m->m_desc  = "Number of threads reading the udp port, each with its own "
+		"SO_REUSEPORT socket and its own share of the udp slots. They "
+		"read dgrams, send ACKs and call the handlers registered as "
+		"thread-safe (msg 0x00, 0x20 and 0x39). Other handlers and "
+		"callbacks are still called from the main loop. 0 reads the "
+		"port from the main loop. (Changes requires restart)";
+	m->m_cgi   = "udp_receive_threads";
+	simple_m_set(Conf,m_udpReceiveThreads);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "udp congestion control";
+	m->m_desc  = "If enabled then the number of unacknowledged datagrams a "
+		"udp transaction may have outstanding to a host is a congestion "
+		"window that grows with acks and is halved on loss, sends are "
+		"paced over the round trip time, and the resend time is computed "
+		"from the measured round trip time of the host. If disabled then "
+		"fixed windows and resend times are used.";
+	m->m_cgi   = "udp_congestion_control";
+	simple_m_set(Conf,m_udpCongestionControl);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "multicast latency aware selection";
+	m->m_desc  = "If enabled then a request to one host of a shard goes to "
+		"the host with the lowest recent response time for that message "
+		"type if the host it would normally go to is a lot slower.";
+	m->m_cgi   = "multicast_latency_aware_selection";
+	simple_m_set(Conf,m_multicastLatencyAwareSelection);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "multicast hedging";
+	m->m_desc  = "If enabled then a query time request (msg 0x00, 0x20, "
+		"0x22 and 0x39) that has not been answered within the 95th "
+		"percentile response time for its message type is sent to a twin "
+		"as well. The first reply is used and the other request is "
+		"cancelled. Costs about 5% more of those requests.";
+	m->m_cgi   = "multicast_hedging";
+	simple_m_set(Conf,m_multicastHedging);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 
 	m->m_title = "flush disk writes";
 	m->m_desc  = "If enabled then all writes will be flushed to disk. "
@@ -5714,6 +5885,174 @@ void Parms::init ( ) {
 	m->m_group = true;
 	m++;
 
+	m->m_title = "use io_uring for disk i/o";
+	m->m_desc  = "If enabled then asynchronous file reads and writes are "
+		"submitted through io_uring from the main thread instead of being "
+		"done by the io threads. Falls back to the io threads if io_uring "
+		"is not available. (Changes requires restart)";
+	m->m_cgi   = "use_io_uring";
+	simple_m_set(Conf,m_useIoUring);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "io_uring queue depth";
+	m->m_desc  = "Number of submission queue entries in the io_uring. "
+		"(Changes requires restart)";
+	m->m_cgi   = "io_uring_queue_depth";
+	simple_m_set(Conf,m_ioUringQueueDepth);
+	m->m_def   = "256";
+	m->m_units = "entries";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "drop merge output from page cache";
+	m->m_desc  = "If enabled then data written by merges is written back and "
+		"dropped from the page cache so merges do not evict the data "
+		"used by queries.";
+	m->m_cgi   = "merge_drop_page_cache";
+	simple_m_set(Conf,m_mergeDropPageCache);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "mmap map files";
+	m->m_desc  = "If enabled then the .map files are memory mapped when they "
+		"are loaded instead of being read into allocated memory. The "
+		"mapped pages are shared with the page cache and are only "
+		"brought in when used. (Changes requires restart)";
+	m->m_cgi   = "mmap_rdb_maps";
+	simple_m_set(Conf,m_mmapRdbMaps);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "mmap posdb reads";
+	m->m_desc  = "If enabled then small posdb reads whose pages are already "
+		"in the page cache are copied straight out of a memory mapping "
+		"of the data file in the main thread, without going through "
+		"the io threads.";
+	m->m_cgi   = "mmap_posdb_reads";
+	simple_m_set(Conf,m_mmapPosdbReads);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "mmap read max size";
+	m->m_desc  = "Reads larger than this are never served from the mapping. "
+		"At most 1MB.";
+	m->m_cgi   = "mmap_read_max_bytes";
+	simple_m_set(Conf,m_mmapReadMaxBytes);
+	m->m_def   = "65536";
+	m->m_units = "bytes";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "parallel startup load";
+	m->m_desc  = "If enabled then the map and index files of all "
+		"collections are read in parallel by the io threads at startup "
+		"instead of one file after the other. (Changes requires restart)";
+	m->m_cgi   = "parallel_startup_load";
+	simple_m_set(Conf,m_parallelStartupLoad);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "lazy load cold collections";
+	m->m_desc  = "If enabled then the map and index files of collections "
+		"that are not spidering are not loaded at startup, but by the "
+		"io threads when the collection is first queried or merged. "
+		"(Changes requires restart)";
+	m->m_cgi   = "lazy_load_cold_collections";
+	simple_m_set(Conf,m_lazyLoadColdCollections);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "pack rdb indexes";
+	m->m_desc  = "If enabled then the docids of the index files and the "
+		"global docid-to-file index are kept Elias-Fano encoded in memory, "
+		"which takes about a third of the memory of a plain sorted array. "
+		"Applies to indexes loaded or generated after the change.";
+	m->m_cgi   = "pack_rdb_indexes";
+	simple_m_set(Conf,m_packRdbIndexes);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "msg4 max batch size";
+	m->m_desc  = "The most incoming add requests (msg4) that are coalesced and added to the "
+		"tree/buckets together, sorted and with one lock per rdb. 1 adds them one request at a time. "
+		"Takes effect on restart.";
+	m->m_cgi   = "msgfourbatch";
+	simple_m_set(Conf,m_msg4MaxBatchSize);
+	m->m_def   = "32";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "parallel indexing min words";
+	m->m_desc  = "Documents with at least this many words have their posdb terms, word spam, "
+		"repeated fragments and linkdb keys computed in parallel stages on the cpu threads "
+		"instead of one after the other. 0 disables.";
+	m->m_cgi   = "pidxminwords";
+	simple_m_set(Conf,m_parallelIndexMinWords);
+	m->m_def   = "20000";
+	m->m_units = "words";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "spider doc arena keep size";
+	m->m_desc  = "Each spider slot allocates the parsing buffers and term tables of its "
+		"documents from an arena and keeps up to this much of it for the next document, "
+		"so they are not malloc'd and page faulted in again for every url. "
+		"0 gives all of it back after each document.";
+	m->m_cgi   = "docarenakeep";
+	simple_m_set(Conf,m_docArenaKeepSize);
+	m->m_def   = "2097152";
+	m->m_units = "bytes";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "verify spider winners";
+	m->m_desc  = "When new spider requests or replies only change a few urls of an IP whose "
+		"best urls are cached, just those urls are read from spiderdb again. With this on "
+		"all of spiderdb is scanned for the IP afterwards as well and differences in the "
+		"winners are logged. Used for debugging.";
+	m->m_cgi   = "spwincheck";
+	simple_m_set(Conf,m_spiderWinnerCheck);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "verify tree integrity";
 	m->m_desc  = "Ensure that tree/buckets have not been corrupted after modifcations. "
 		"Helps isolate sources of corruption. Used for debugging.";
@@ -7255,6 +7594,45 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "titledb codec";
+	m->m_desc  = "Compression used for new titledb records. 0 is zlib, "
+		"1 is zstd and 2 is lz4. Records are read with whatever codec "
+		"they were written with, but hosts running an older gb can "
+		"only read zlib.";
+	m->m_cgi   = "tdcodec";
+	simple_m_set(Conf,m_titleRecCodec);
+	m->m_def   = "0";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "titledb compression level";
+	m->m_desc  = "zstd compression level for new titledb records. "
+		"Higher is smaller but slower.";
+	m->m_cgi   = "tdclevel";
+	simple_m_set(Conf,m_titleRecCompressionLevel);
+	m->m_def   = "3";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "titledb use dictionary";
+	m->m_desc  = "Compress new zstd titledb records with the newest "
+		"dictionary trained for the collection by "
+		"recompress_titledb. The dictionary must be copied to "
+		"all hosts first.";
+	m->m_cgi   = "tddict";
+	simple_m_set(Conf,m_titleRecUseDict);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
 	//////////////
 	// merge space
 
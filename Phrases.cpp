@@ -6,9 +6,10 @@
 #include "Mem.h"
 #include "Conf.h"
 #include "Sanity.h"
+#include "Arena.h"
 
 
-Phrases::Phrases() : m_buf(NULL) {
+Phrases::Phrases() : m_buf(NULL), m_arena(NULL) {
 
 	memset(m_localBuf, 0, sizeof(m_localBuf));
 
@@ -31,7 +32,7 @@ Phrases::~Phrases ( ) {
 }
 
 void Phrases::reset() {
-	if ( m_buf && m_buf != m_localBuf ) {
+	if ( m_buf && m_buf != m_localBuf && ! m_arena ) {
 		mfree ( m_buf , m_bufSize , "Phrases" );
 	}
 	m_buf = NULL;
@@ -54,7 +55,9 @@ bool Phrases::set( const Words *words, const Bits *bits ) {
 	int32_t need = m_numPhrases * (8+1);
 
 	// alloc if we need to
-	if ( (unsigned)need > sizeof(m_localBuf) )
+	if ( (unsigned)need > sizeof(m_localBuf) && m_arena )
+		m_buf = (char *)m_arena->alloc ( need );
+	else if ( (unsigned)need > sizeof(m_localBuf) )
 		m_buf = (char *)mmalloc ( need , "Phrases" );
 	else
 		m_buf = m_localBuf;
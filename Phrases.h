@@ -23,6 +23,12 @@ public:
 	~Phrases();
 	void reset() ;
 
+	// . get the phrase arrays from "arena" instead of the heap when they
+	//   do not fit the local buffer. stays set across reset()
+	void setArena ( class Arena *arena ) {
+		m_arena = arena;
+	}
+
 	// . set the hashes (m_phraseIds) of the phrases for these words
 	// . a phraseSpam of PSKIP means word is not in a phrase
 	// . "bits" describes the words in a phrasing context
@@ -54,6 +60,7 @@ private:
 
 	char *m_buf;
 	int32_t  m_bufSize;
+	class Arena *m_arena;
 
 	// the two word hash
 	int64_t *m_phraseIds2;
@@ -5,11 +5,13 @@
 #include "Sections.h"
 #include "Conf.h"
 #include "Mem.h"
+#include "Arena.h"
 
 
 Pos::Pos() {
 	m_buf = NULL;
 	m_needsFree = false;
+	m_arena = NULL;
 	m_pos = NULL;
 	m_bufSize = 0;
 	memset(m_localBuf, 0, sizeof(m_localBuf));
@@ -550,7 +552,10 @@ bool Pos::set( const Words *words, int32_t a, int32_t b ) {
 	m_needsFree = false;
 
 	m_buf = m_localBuf;
-	if ( need > POS_LOCALBUFSIZE ) {
+	if ( need > POS_LOCALBUFSIZE && m_arena ) {
+		// freed by the arena's owner
+		m_buf = (char *)m_arena->alloc(need);
+	} else if ( need > POS_LOCALBUFSIZE ) {
 		m_buf = (char *)mmalloc(need,"Pos");
 		m_needsFree = true;
 	}
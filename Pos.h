@@ -22,6 +22,12 @@ class Pos {
 	~Pos();
 	void reset();
 
+	// . get the positions from "arena" instead of the heap when they do
+	//   not fit the local buffer. stays set across reset()
+	void setArena ( class Arena *arena ) {
+		m_arena = arena;
+	}
+
 	bool set(const Words *words, int32_t a = 0, int32_t b = -1 );
 
 	// . filter out xml words [a,b] into plain text, stores into "f"
@@ -42,6 +48,7 @@ private:
 	int32_t  m_bufSize;
 
 	bool  m_needsFree;
+	class Arena *m_arena;
 };
 
 #endif // GB_POS_H
@@ -271,7 +271,9 @@ static void initializeCaches() {
 					     "tfcache", // dbname
 					     false    , // load from disk?
 					     8        , // cache key size
-					     0          // data key size
+					     0        , // data key size
+					     -1       , // numptrsmax
+					     4          // shards
 					     ))
 			log("posdb: failed to init termfreqcache: %s",
 			    mstrerror(g_errno));
@@ -283,7 +285,9 @@ static void initializeCaches() {
 					"tscache", // dbname
 					false    , // load from disk?
 					8        , // cache key size
-					0          // data key size
+					0        , // data key size
+					-1       , // numptrsmax
+					4          // shards
 		                       ))
 			log("posdb: failed to init termlistsizecache: %s",
 			    mstrerror(g_errno));
@@ -303,13 +307,10 @@ int64_t Posdb::getTermFreq ( collnum_t collnum, int64_t termId ) {
 	
 	// . check cache for super speed
 	// . colnum is 0 for now
-	RdbCacheLock rcl(g_termFreqCache); //todo: we should really release the lock while scanning the posdb-freq
-	int64_t val = g_termFreqCache.getLongLong2 ( collnum ,
-						       termId  , // key
-						       500   , // maxage secs
-						       true    );// promote?
-
-
+	// . no lock held while we estimate, every query term lands here
+	int64_t val = g_termFreqCache.peekLongLong2 ( collnum ,
+							termId  , // key
+							500     );// maxage secs
 
 	// -1 means not found in cache. if found, return it though.
 	if ( val >= 0 ) {
@@ -347,6 +348,8 @@ int64_t Posdb::getTermFreq ( collnum_t collnum, int64_t termId ) {
 	maxRecs *= g_hostdb.m_numShards;
 
 	// now cache it. it sets g_errno to zero.
+	key96_t ck = RdbCache::getLongLong2Key ( termId );
+	RdbCacheLock rcl(g_termFreqCache, (const char *)&ck);
 	g_termFreqCache.addLongLong2 ( collnum, termId, maxRecs );
 	// return it
 	return maxRecs;
@@ -358,13 +361,10 @@ int64_t Posdb::estimateLocalTermListSize(collnum_t collnum, int64_t termId) {
 	
 	// . check cache for super speed
 	// . colnum is 0 for now
-	RdbCacheLock rcl(g_termListSize); //todo: we should really release the lock while scanning the posdb-freq
-	int64_t val = g_termListSize.getLongLong2(collnum,
-						  termId,  // key
-						  500,     // maxage secs
-						  true);   // promote?
-
-
+	// . no lock held while we estimate
+	int64_t val = g_termListSize.peekLongLong2(collnum,
+						   termId,  // key
+						   500);    // maxage secs
 
 	// -1 means not found in cache. if found, return it though.
 	if(val>=0) {
@@ -398,6 +398,8 @@ int64_t Posdb::estimateLocalTermListSize(collnum_t collnum, int64_t termId) {
 	maxBytes += bucketsBytes;
 
 	// now cache it. it sets g_errno to zero.
+	key96_t ck = RdbCache::getLongLong2Key(termId);
+	RdbCacheLock rcl(g_termListSize, (const char *)&ck);
 	g_termListSize.addLongLong2(collnum, termId, maxBytes);
 
 	return maxBytes;
@@ -10,6 +10,7 @@
 #include "BitOperations.h"
 #include "Msg2.h"
 #include "Msg39.h"
+#include "JobScheduler.h"
 #include "Sanity.h"
 #include "Stats.h"
 #include "Conf.h"
@@ -79,13 +80,17 @@ void PosdbTable::reset() {
 	// has init() been called?
 	m_initialized          = false;
 	//freeMem(); // not implemented
-	// does not free the mem of this safebuf, only resets length
-	m_docIdVoteBuf.reset();
+	// . these are carved out of m_arena again for the next docid split.
+	//   the arena keeps the chunks it grew to
+	m_docIdVoteBuf.purge();
 	m_filtered = 0;
-	m_qiBuf.reset();
+	m_qiBuf.purge();
+	m_whiteListTable.reset();
+	m_bt.reset();
+	m_ct.reset();
+	m_arena.rewind(m_arena.getAllocated());
 	// assume no-op
 	m_t1 = 0LL;
-	m_whiteListTable.reset();
 	m_addedSites = false;
 
 	// Coverity
@@ -1500,7 +1505,7 @@ bool PosdbTable::setQueryTermInfo ( ) {
 
 	// alloc space. assume max
 	int32_t qneed = sizeof(QueryTermInfo) * m_q->m_numTerms;
-	if ( ! m_qiBuf.reserve(qneed,"qibuf") ) {
+	if ( ! m_arena.reserve(&m_qiBuf, qneed, "qibuf") ) {
 		return false; // label it too!
 	}
 	
@@ -1947,7 +1952,7 @@ bool PosdbTable::setQueryTermInfo ( ) {
 	need += 8;
 
 	// get max # of docids we got in an intersection from all the lists
-	if ( ! m_docIdVoteBuf.reserve ( need,"divbuf" ) ) {
+	if ( ! m_arena.reserve(&m_docIdVoteBuf, need, "divbuf") ) {
 		logTrace(g_conf.m_logTracePosdb, "END.");
 		return false;
 	}
@@ -1975,7 +1980,7 @@ bool PosdbTable::setQueryTermInfo ( ) {
 	if ( m_numQueryTermInfos % 8 ) m_vecSize++;
 	// now preallocate the hashtable. 0 niceness.
 	if ( m_q->m_isBoolean &&  // true = useKeyMagic
-	     ! m_bt.set (8,m_vecSize,maxSlots,NULL,0,false,"booltbl",true)) {
+	     ! m_arena.setTable(&m_bt,8,m_vecSize,maxSlots,false,"booltbl",true)) {
 		logTrace(g_conf.m_logTracePosdb, "END.");
 		return false;
 	}
@@ -1984,7 +1989,7 @@ bool PosdbTable::setQueryTermInfo ( ) {
 	// . each "bit" in the "bit vector" indicates if docid has that 
 	//   particular query term
 	if ( m_q->m_isBoolean && // true = useKeyMagic
-	     ! m_ct.set (8,1,maxSlots,NULL,0,false,"booltbl",true)) {
+	     ! m_arena.setTable(&m_ct,8,1,maxSlots,false,"booltbl",true)) {
 		logTrace(g_conf.m_logTracePosdb, "END.");
 		return false;
 	}
@@ -3962,9 +3967,20 @@ void PosdbTable::intersectLists_real() {
 		//#
 
 		bool allDone = false;
+		int32_t docIdsSinceCancelCheck = 0;
 		while( !allDone && docIdPtr < docIdEnd ) {
 //			logTrace(g_conf.m_logTracePosdb, "Handling next docId");
 
+			// the query may have been given up while we were busy
+			if ( ++docIdsSinceCancelCheck >= 1024 ) {
+				docIdsSinceCancelCheck = 0;
+				if ( JobScheduler::is_job_cancelled() ) {
+					logTrace(g_conf.m_logTracePosdb, "END. job cancelled");
+					g_errno = ECANCELLED;
+					return;
+				}
+			}
+
 			bool skipToNextDocId = false;
 			siteRank				= 0;
 			docLang					= langUnknown;
@@ -4723,7 +4739,7 @@ bool PosdbTable::allocWhiteListTable ( ) {
 		// 5 bytes (which includes 1 siterank bit as the lowbit,
 		// but should be ok since it should be set the same in
 		// all termlists that have that docid)
-		if (!m_whiteListTable.set(5, 0, numSlots, NULL, 0, false, "wtall", true)) {
+		if (!m_arena.setTable(&m_whiteListTable, 5, 0, numSlots, false, "wtall", true)) {
 			return false;
 		}
 	}
@@ -4926,7 +4942,7 @@ bool PosdbTable::allocateScoringInfo() {
 		
 		// and for singles
 		int32_t numSingles = numTerms * m_realMaxTop * xx; // MAX_TOP *xx;
-		if ( !m_singleScoreBuf.reserve(numSingles*sizeof(SingleScore))) {
+		if ( ! m_singleScoreBuf.reserve(numSingles*sizeof(SingleScore)) ) {
 			return false;
 		}
 	}
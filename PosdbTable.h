@@ -3,6 +3,7 @@
 
 #include "RdbList.h"
 #include "HashTableX.h"
+#include "Arena.h"
 #include <vector>
 
 float getDiversityWeight ( unsigned char diversityRank );
@@ -240,6 +241,15 @@ private:
 
 	int32_t m_filtered;
 
+	// . m_qiBuf, m_docIdVoteBuf, m_whiteListTable, m_bt and m_ct are
+	//   carved out of this so a docid split costs a few pooled chunks
+	//   instead of a malloc per buffer
+	// . rewound by reset() after those are purged, so the docid splits of
+	//   a query reuse the same chunks
+	// . the score info buffers and the top tree outlive a split and the
+	//   termlists belong to Msg2, so they stay on the heap
+	Arena m_arena;
+
 	// boolean truth table for boolean queries
 	HashTableX m_bt;
 	HashTableX m_ct;
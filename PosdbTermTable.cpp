@@ -0,0 +1,239 @@
+#include "gb-include.h"
+
+#include "PosdbTermTable.h"
+#include "BitOperations.h"
+#include "Mem.h"
+#include "Errno.h"
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+static const int32_t s_groupSize = 16;
+
+// at most half the slots are used so the probe sequences stay short
+static int32_t getNumSlots ( int32_t maxTerms ) {
+	int32_t n = (int32_t)getHighestLitBitValueLL ( (uint64_t)maxTerms * 4 - 1 );
+	return ( n < s_groupSize ) ? s_groupSize : n;
+}
+
+static int32_t getMaxTermsFor ( int32_t numTerms ) {
+	return ( numTerms < s_groupSize ) ? s_groupSize : numTerms;
+}
+
+static inline uint64_t hashKey ( const key144_t *k ) {
+	// the termid is in the top of n2. the positions and ranks are in n1
+	uint64_t h = k->n2 * 0x9e3779b97f4a7c15ULL;
+	h ^= k->n1 * 0xc2b2ae3d27d4eb4fULL;
+	h ^= (uint64_t)k->n0 * 0x165667b19e3779f9ULL;
+	return h ^ ( h >> 29 );
+}
+
+static inline uint8_t getTag ( uint64_t h ) {
+	return 0x80 | (uint8_t)( h >> 57 );
+}
+
+static inline bool keysEqual ( const key144_t *a , const key144_t *b ) {
+	return a->n2 == b->n2 && a->n1 == b->n1 && a->n0 == b->n0;
+}
+
+// a functor so std::sort inlines it
+struct KeyLess {
+	bool operator() ( const key144_t &a , const key144_t &b ) const {
+		if ( a.n2 != b.n2 ) return a.n2 < b.n2;
+		if ( a.n1 != b.n1 ) return a.n1 < b.n1;
+		return a.n0 < b.n0;
+	}
+};
+
+// bit i of "match" is set if slot i of the group has "tag", of "empty" if
+// slot i is empty
+static inline void getGroupMasks ( const uint8_t *tags , uint8_t tag , uint32_t *match , uint32_t *empty ) {
+#ifdef __SSE2__
+	__m128i v = _mm_loadu_si128 ( (const __m128i *)tags );
+	*match = (uint32_t)_mm_movemask_epi8 ( _mm_cmpeq_epi8 ( v , _mm_set1_epi8 ( (char)tag ) ) );
+	*empty = (uint32_t)_mm_movemask_epi8 ( _mm_cmpeq_epi8 ( v , _mm_setzero_si128 ( ) ) );
+#else
+	*match = 0;
+	*empty = 0;
+	for ( int32_t i = 0 ; i < s_groupSize ; i++ ) {
+		if ( tags[i] == tag ) *match |= 1U << i;
+		if ( tags[i] == 0   ) *empty |= 1U << i;
+	}
+#endif
+}
+
+
+PosdbTermTable::PosdbTermTable()
+	: m_buf(NULL)
+	, m_bufSize(0)
+	, m_doFree(false)
+	, m_keys(NULL)
+	, m_numTerms(0)
+	, m_maxTerms(0)
+	, m_tags(NULL)
+	, m_slots(NULL)
+	, m_groupMask(0)
+	, m_indexValid(false) {
+}
+
+PosdbTermTable::~PosdbTermTable() {
+	reset();
+}
+
+void PosdbTermTable::reset ( ) {
+	if ( m_doFree && m_buf ) {
+		mfree ( m_buf , m_bufSize , "PosdbTermTable" );
+	}
+	m_buf = NULL;
+	m_bufSize = 0;
+	m_doFree = false;
+	m_keys = NULL;
+	m_numTerms = 0;
+	m_maxTerms = 0;
+	m_tags = NULL;
+	m_slots = NULL;
+	m_groupMask = 0;
+	m_indexValid = false;
+}
+
+int32_t PosdbTermTable::getBufSize ( int32_t numTerms ) {
+	int32_t maxTerms = getMaxTermsFor ( numTerms );
+	int32_t numSlots = getNumSlots ( maxTerms );
+	return numSlots * ( sizeof(int32_t) + 1 ) + maxTerms * sizeof(key144_t);
+}
+
+// the slots first, then the tags and the keys, which only need 2 byte
+// alignment
+void PosdbTermTable::setPointers ( char *buf , int32_t maxTerms ) {
+	int32_t numSlots = getNumSlots ( maxTerms );
+	m_slots = (int32_t *)buf;
+	m_tags = (uint8_t *)( buf + numSlots * sizeof(int32_t) );
+	m_keys = (key144_t *)( m_tags + numSlots );
+	m_maxTerms = maxTerms;
+	m_groupMask = numSlots / s_groupSize - 1;
+}
+
+bool PosdbTermTable::set ( int32_t numTerms , char *buf , int32_t bufSize ) {
+	reset();
+
+	int32_t maxTerms = getMaxTermsFor ( numTerms );
+	int32_t need = getBufSize ( maxTerms );
+
+	if ( buf ) {
+		if ( bufSize < need ) gbshutdownLogicError();
+	} else {
+		buf = (char *)mmalloc ( need , "PosdbTermTable" );
+		if ( ! buf ) return false;
+		bufSize = need;
+		m_doFree = true;
+	}
+
+	m_buf = buf;
+	m_bufSize = bufSize;
+	setPointers ( buf , maxTerms );
+	rebuildIndex();
+	return true;
+}
+
+bool PosdbTermTable::grow ( ) {
+	int32_t maxTerms = m_maxTerms * 2;
+	int32_t need = getBufSize ( maxTerms );
+	char *buf = (char *)mmalloc ( need , "PosdbTermTable" );
+	if ( ! buf ) return false;
+
+	int32_t numSlots = getNumSlots ( maxTerms );
+	key144_t *keys = (key144_t *)( buf + numSlots * ( sizeof(int32_t) + 1 ) );
+	memcpy ( keys , m_keys , m_numTerms * sizeof(key144_t) );
+
+	if ( m_doFree ) {
+		mfree ( m_buf , m_bufSize , "PosdbTermTable" );
+	}
+	m_buf = buf;
+	m_bufSize = need;
+	m_doFree = true;
+	setPointers ( buf , maxTerms );
+	rebuildIndex();
+	return true;
+}
+
+// add key #n, which is not in the index yet
+void PosdbTermTable::addToIndex ( int32_t n ) {
+	uint64_t h = hashKey ( &m_keys[n] );
+	uint8_t tag = getTag ( h );
+	for ( uint32_t g = (uint32_t)h & m_groupMask ; ; g = ( g + 1 ) & m_groupMask ) {
+		uint8_t *tags = m_tags + g * s_groupSize;
+		uint32_t match;
+		uint32_t empty;
+		getGroupMasks ( tags , tag , &match , &empty );
+		if ( empty ) {
+			int32_t i = __builtin_ctz ( empty );
+			tags[i] = tag;
+			m_slots[g * s_groupSize + i] = n;
+			return;
+		}
+	}
+}
+
+void PosdbTermTable::rebuildIndex ( ) {
+	memset ( m_tags , 0 , ( m_groupMask + 1 ) * s_groupSize );
+	for ( int32_t i = 0 ; i < m_numTerms ; i++ ) {
+		addToIndex ( i );
+	}
+	m_indexValid = true;
+}
+
+bool PosdbTermTable::addTerm144 ( const key144_t *key ) {
+	if ( m_numTerms >= m_maxTerms ) {
+		if ( ! m_keys ) gbshutdownLogicError();
+		if ( ! grow() ) return false;
+	} else if ( ! m_indexValid ) {
+		rebuildIndex();
+	}
+
+	// . probe the groups in order until one has an empty slot. there are
+	//   no deletes so the key can not be after that
+	uint64_t h = hashKey ( key );
+	uint8_t tag = getTag ( h );
+	for ( uint32_t g = (uint32_t)h & m_groupMask ; ; g = ( g + 1 ) & m_groupMask ) {
+		uint8_t *tags = m_tags + g * s_groupSize;
+		int32_t *slots = m_slots + g * s_groupSize;
+		uint32_t match;
+		uint32_t empty;
+		getGroupMasks ( tags , tag , &match , &empty );
+
+		for ( ; match ; match &= match - 1 ) {
+			if ( keysEqual ( &m_keys[slots[__builtin_ctz ( match )]] , key ) ) {
+				return true;
+			}
+		}
+
+		if ( empty ) {
+			int32_t i = __builtin_ctz ( empty );
+			tags[i] = tag;
+			slots[i] = m_numTerms;
+			m_keys[m_numTerms++] = *key;
+			return true;
+		}
+	}
+}
+
+void PosdbTermTable::sortKeys ( ) {
+	std::sort ( m_keys , m_keys + m_numTerms , KeyLess() );
+	m_indexValid = false;
+}
+
+int32_t PosdbTermTable::getKeyChecksum32 ( ) const {
+	int32_t checksum = 0;
+	for ( int32_t i = 0 ; i < m_numTerms ; i++ ) {
+		const char *kp = (const char *)&m_keys[i];
+		checksum ^= *(const int32_t *)(kp);
+		checksum ^= *(const int32_t *)(kp+4);
+		checksum ^= *(const int32_t *)(kp+8);
+		checksum ^= *(const int32_t *)(kp+12);
+		checksum ^= *(const int16_t *)(kp+16);
+	}
+	return checksum;
+}
@@ -0,0 +1,82 @@
+// . the posdb keys of a document while it is being hashed for indexing
+// . replaces a HashTableX with 18 byte keys. that one spreads the keys over
+//   a table 4 times bigger than the number of keys with a separate flags
+//   array, so every add is a cache miss or two and getMetaList() has to scan
+//   all the empty slots
+// . here the keys are stored one after the other in the order they are
+//   added. an open addressing index of 16 slot groups, with a tag byte of
+//   the key hash per slot, finds the duplicates. a lookup compares the 16
+//   tags of a group at once with sse2 and then mostly only one key
+// . sortKeys() sorts the keys in place so they can be copied into the
+//   metalist in posdb order
+// . adding a key that is already there does nothing
+
+#ifndef GB_POSDBTERMTABLE_H
+#define GB_POSDBTERMTABLE_H
+
+#include "types.h"
+#include <inttypes.h>
+
+
+class PosdbTermTable {
+public:
+	PosdbTermTable();
+	~PosdbTermTable();
+
+	// . room for "numTerms" keys before having to grow
+	// . uses "buf" if given, which must be getBufSize(numTerms) bytes and
+	//   is not freed by us. growing allocates from the heap
+	// . returns false and sets g_errno on error
+	bool set ( int32_t numTerms , char *buf = NULL , int32_t bufSize = 0 );
+
+	static int32_t getBufSize ( int32_t numTerms );
+
+	void reset ( );
+
+	// returns false and sets g_errno on error
+	bool addTerm144 ( const key144_t *key );
+
+	bool isInitialized ( ) const { return ( m_keys != NULL ); }
+
+	int32_t getNumTerms ( ) const { return m_numTerms; }
+	// number of keys we have room for before growing
+	int32_t getMaxTerms ( ) const { return m_maxTerms; }
+
+	const key144_t *getKeys ( ) const { return m_keys; }
+
+	// . sort the keys in place, smallest first
+	// . adding a key after this rebuilds the index
+	void sortKeys ( );
+
+	// same as HashTableX::getKeyChecksum32() for the same keys
+	int32_t getKeyChecksum32 ( ) const;
+
+private:
+	PosdbTermTable(const PosdbTermTable&);
+	PosdbTermTable& operator=(const PosdbTermTable&);
+
+	bool grow ( );
+	void setPointers ( char *buf , int32_t maxTerms );
+	void rebuildIndex ( );
+	void addToIndex ( int32_t n );
+
+	char     *m_buf;
+	int32_t   m_bufSize;
+	bool      m_doFree;
+
+	// the keys, in the order they were added unless sorted
+	key144_t *m_keys;
+	int32_t   m_numTerms;
+	int32_t   m_maxTerms;
+
+	// . the index. 0 is an empty slot, otherwise 0x80 | 7 bits of the
+	//   hash, and m_slots[] has the key number
+	uint8_t  *m_tags;
+	int32_t  *m_slots;
+	uint32_t  m_groupMask;
+
+	// false after sortKeys() moved the keys
+	bool      m_indexValid;
+};
+
+#endif // GB_POSDBTERMTABLE_H
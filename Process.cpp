@@ -40,6 +40,7 @@
 #include "Mem.h"
 #include "Msg4In.h"
 #include "SummaryCache.h"
+#include "GbIoUring.h"
 #include <sys/statvfs.h>
 #include <pthread.h>
 #include <fcntl.h>
@@ -531,6 +532,10 @@ bool Process::shutdown ( bool urgent, void  *state, void (*callback) (void *stat
 	return true;
 }
 
+bool Process::isMainThread() const {
+	return pthread_self() == s_mainThreadTid;
+}
+
 // return false if blocked/waiting
 bool Process::save2 ( ) {
 	// only the main process can call this
@@ -979,6 +984,7 @@ void Process::resetAll ( ) {
 	g_dns             .reset();
 	g_udpServer       .reset();
 	g_httpServer      .reset();
+	g_ioUring         .finalize();
 	g_loop            .reset();
 	g_speller         .reset();
 	g_spiderCache     .reset();
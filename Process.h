@@ -43,6 +43,8 @@ class Process {
 	bool shutdown2          ( ) ;
 
 	bool isShuttingDown() const { return m_mode == EXIT_MODE; }
+	// true if called from the thread that called init()
+	bool isMainThread() const;
 	bool isRdbDumping       ( ) ;
 	bool isRdbMerging       ( ) ;
 	bool saveRdbTrees(bool shuttingDown);
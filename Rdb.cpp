@@ -794,7 +794,7 @@ bool Rdb::dumpTree() {
 
 	// do not do chain testing because that is too slow
 	if (m_useTree) {
-		ScopedLock sl(m_tree.getLock());
+		ScopedWriteLock sl(m_tree.getLock());
 		if (!m_tree.checkTree_unlocked(false, false)) {
 			log(LOG_ERROR, "db: %s tree was corrupted in memory. Trying to fix. Your memory is probably bad. "
 				"Please replace it.", m_dbname);
@@ -1096,24 +1096,9 @@ void attemptMergeAll() {
 }
 
 
-// . return false and set g_errno on error
-// . TODO: speedup with m_tree.addSortedKeys() already partially written
-bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
-	// pick it
-	if ( collnum < 0 || collnum > getNumBases() || ! getBase(collnum) ) {
-		g_errno = ENOCOLLREC;
-		log(LOG_WARN, "db: %s bad collnum of %i.",m_dbname,collnum);
-		return false;
-	}
-	// make sure list is reset
-	list->resetListPtr();
-	// if nothing then just return true
-	if ( list->isExhausted() ) {
-		return true;
-	}
-	// sanity check
-	if ( list->getKeySize() != m_ks ) { g_process.shutdownAbort(true); }
-
+// . returns false and sets g_errno to EREPAIRING if we can not add to this
+//   rdb because the collection is being repaired
+bool Rdb::checkRepairMode(collnum_t collnum, int32_t listSize) const {
 	// if we are well into repair mode, level 2, do not add anything
 	// to spiderdb or titledb... that can mess up our titledb scan.
 	// we always rebuild tfndb, clusterdb and spiderdb
@@ -1125,7 +1110,7 @@ bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
 		// exception, spider status docs can be deleted from titledb
 		// if user turns off 'index spider replies' before doing
 		// the rebuild, when not rebuilding titledb.
-	     ((m_rdbId == RDB_TITLEDB && list->getListSize() != 12 )    ||
+	     ((m_rdbId == RDB_TITLEDB && listSize != 12 )    ||
 	       m_rdbId == RDB_POSDB      ||
 	       m_rdbId == RDB_CLUSTERDB  ||
 	       m_rdbId == RDB_LINKDB     ||
@@ -1138,6 +1123,31 @@ bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
 		return false;
 	}
 
+	return true;
+}
+
+// . return false and set g_errno on error
+// . TODO: speedup with m_tree.addSortedKeys() already partially written
+bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
+	// pick it
+	if ( collnum < 0 || collnum > getNumBases() || ! getBase(collnum) ) {
+		g_errno = ENOCOLLREC;
+		log(LOG_WARN, "db: %s bad collnum of %i.",m_dbname,collnum);
+		return false;
+	}
+	// make sure list is reset
+	list->resetListPtr();
+	// if nothing then just return true
+	if ( list->isExhausted() ) {
+		return true;
+	}
+	// sanity check
+	if ( list->getKeySize() != m_ks ) { g_process.shutdownAbort(true); }
+
+	if ( ! checkRepairMode(collnum, list->getListSize()) ) {
+		return false;
+	}
+
 	// . if we don't have enough room to store list, initiate a dump and
 	//   return g_errno of ETRYAGAIN
 	// . otherwise, we're guaranteed to have room for this list
@@ -1178,26 +1188,7 @@ bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
 		}
 
 		if ( ! addRecord ( collnum , key , data , dataSize ) ) {
-			// bitch
-			static int32_t s_last = 0;
-			int32_t now = time(NULL);
-
-			// . do not log this more than once per second to stop log spam
-			// . i think this can really lockup the cpu, too
-			if ( now - s_last != 0 ) {
-				log( LOG_INFO, "db: Had error adding data to %s: %s.", m_dbname, mstrerror( g_errno ));
-			}
-
-			s_last = now;
-
-			// force initiate the dump now if addRecord failed for no mem
-			if ( g_errno == ENOMEM ) {
-				// start dumping the tree to disk so we have room 4 add
-				logTrace( g_conf.m_logTraceRdb, "%s: Not enough memory. Calling dumpTree", m_dbname );
-				submitRdbDumpJob(true);
-				// tell caller to try again later (1 second or so)
-				g_errno = ETRYAGAIN;
-			}
+			handleAddError();
 
 			// discontinue adding any more of the list
 			return false;
@@ -1209,6 +1200,154 @@ bool Rdb::addList(collnum_t collnum, RdbList *list, bool checkForRoom) {
 	return true;
 }
 
+// . log an add error and start a dump if we ran out of memory
+// . g_errno is set to ETRYAGAIN in that case
+void Rdb::handleAddError() {
+	// bitch
+	static int32_t s_last = 0;
+	int32_t now = time(NULL);
+
+	// . do not log this more than once per second to stop log spam
+	// . i think this can really lockup the cpu, too
+	if ( now - s_last != 0 ) {
+		log( LOG_INFO, "db: Had error adding data to %s: %s.", m_dbname, mstrerror( g_errno ));
+	}
+
+	s_last = now;
+
+	// force initiate the dump now if addRecord failed for no mem
+	if ( g_errno == ENOMEM ) {
+		// start dumping the tree to disk so we have room 4 add
+		logTrace( g_conf.m_logTraceRdb, "%s: Not enough memory. Calling dumpTree", m_dbname );
+		submitRdbDumpJob(true);
+		// tell caller to try again later (1 second or so)
+		g_errno = ETRYAGAIN;
+	}
+}
+
+// . add records, possibly of different collections, taking the buckets lock
+//   only once instead of once per record. the tree already adds concurrently
+//   so there we just add them one by one
+// . records are added in the given order. records of collections that are
+//   gone are skipped
+// . the caller must have checked for room
+// . returns false and sets g_errno on error. the records before the failing
+//   one may have been added
+bool Rdb::addBatch(const RdbBatchRec *recs, int32_t numRecs) {
+	if (m_useTree) {
+		for (int32_t i = 0; i < numRecs; i++) {
+			RdbList list;
+			// todo: dodgy cast to char*. RdbList should be fixed
+			list.set((char *)recs[i].m_rec, recs[i].m_recSize, (char *)recs[i].m_rec, recs[i].m_recSize,
+			         m_fixedDataSize, false, m_useHalfKeys, m_ks);
+
+			if (!addList(recs[i].m_collnum, &list, false)) {
+				if (g_errno != ENOCOLLREC) {
+					return false;
+				}
+				g_errno = 0;
+			}
+		}
+		return true;
+	}
+
+	struct BatchKey {
+		collnum_t m_collnum;
+		char m_key[MAX_KEY_BYTES];
+		char *m_dataCopy;
+		int32_t m_dataSize;
+	};
+
+	// . do the sanity checks and copy the data before taking the lock
+	std::vector<BatchKey> keys;
+	keys.reserve(numRecs);
+
+	bool failed = false;
+	for (int32_t i = 0; i < numRecs; i++) {
+		collnum_t collnum = recs[i].m_collnum;
+
+		// bad coll #? skip it. common when deleting and resetting collections
+		if (collnum < 0 || collnum > getNumBases() || !getBase(collnum)) {
+			log(LOG_WARN, "db: %s bad collnum of %i.", m_dbname, collnum);
+			continue;
+		}
+
+		if (!checkRepairMode(collnum, recs[i].m_recSize)) {
+			failed = true;
+			break;
+		}
+
+		RdbList list;
+		list.set((char *)recs[i].m_rec, recs[i].m_recSize, (char *)recs[i].m_rec, recs[i].m_recSize,
+		         m_fixedDataSize, false, m_useHalfKeys, m_ks);
+
+		BatchKey bk;
+		bk.m_collnum = collnum;
+		list.getCurrentKey(bk.m_key);
+
+		const char *data = NULL;
+		bk.m_dataSize = 0;
+		// negative keys have no data
+		if (!KEYNEG(bk.m_key)) {
+			bk.m_dataSize = list.getCurrentDataSize();
+			data = list.getCurrentData();
+		}
+
+		if (!prepareRecord(collnum, bk.m_key, data, bk.m_dataSize, &bk.m_dataCopy)) {
+			failed = true;
+			break;
+		}
+
+		keys.push_back(bk);
+	}
+
+	// . add them all in one go. keys that end up not being added are
+	//   marked with a collnum of -1
+	int32_t numAdded = 0;
+	if (!keys.empty()) {
+		ScopedLock sl(m_buckets.getLock());
+
+		for (auto &bk : keys) {
+			if (m_useIndexFile) {
+				const char *key = bk.m_key;
+				char newKey[MAX_KEY_BYTES];
+				if (!resolveIndexFileKey_unlocked(bk.m_collnum, &key, newKey)) {
+					bk.m_collnum = -1;
+					++numAdded;
+					continue;
+				}
+				if (key != bk.m_key) {
+					KEYSET(bk.m_key, key, m_ks);
+				}
+			}
+
+			if (!m_buckets.addNode_unlocked(bk.m_collnum, bk.m_key, bk.m_dataCopy, bk.m_dataSize)) {
+				failed = true;
+				break;
+			}
+			++numAdded;
+		}
+	}
+
+	// we only add to index after adding to the buckets
+	for (int32_t i = 0; i < numAdded; i++) {
+		if (keys[i].m_collnum < 0) {
+			continue;
+		}
+		RdbIndex *index = getBase(keys[i].m_collnum)->getTreeIndex();
+		if (index) {
+			index->addRecord(keys[i].m_key);
+		}
+	}
+
+	if (failed) {
+		handleAddError();
+		return false;
+	}
+
+	return true;
+}
+
 
 //delete node and data in tree. Currently only called by SpiderLoop
 bool Rdb::deleteTreeNode(collnum_t collnum, const char *key) {
@@ -1318,19 +1457,10 @@ bool Rdb::hasRoom(RdbList *list) {
 	return true;
 }
 
-// . NOTE: low bit should be set , only antiKeys (deletes) have low bit clear
-// . returns false and sets g_errno on error, true otherwise
-// . if RdbMem, m_mem, has no mem, sets g_errno to ETRYAGAIN and returns false
-//   because dump should complete soon and free up some mem
-// . this overwrites dups
-bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_t dataSize) {
-	if (g_conf.m_logTraceRdb) {
-		char keyStrBuf[MAX_KEYSTR_BYTES];
-		KEYSTR(key, m_ks, keyStrBuf);
-		logTrace(g_conf.m_logTraceRdb, "BEGIN %s: collnum=%" PRId32" key=%s dataSize=%" PRId32,
-		         m_dbname, collnum, keyStrBuf, dataSize);
-	}
-
+// . prepare a record for adding to the tree/buckets: sanity checks and
+//   copying the data into m_mem
+// . returns false and sets g_errno on error
+bool Rdb::prepareRecord(collnum_t collnum, const char *key, const char *data, int32_t dataSize, char **dataCopy) {
 	if (!getBase(collnum)) {
 		g_errno = EBADENGINEER;
 		log(LOG_LOGIC,"db: addRecord: collection #%i is gone.", collnum);
@@ -1355,7 +1485,7 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 	}
 
 	// copy the data before adding if we don't already own it
-	char *dataCopy = NULL;
+	*dataCopy = NULL;
 	if (data) {
 		// sanity check
 		if ( m_fixedDataSize == 0 && dataSize > 0 ) {
@@ -1363,8 +1493,8 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 			gbshutdownLogicError();
 		}
 
-		dataCopy = (char *) m_mem.dupData(data, dataSize);
-		if ( ! dataCopy ) {
+		*dataCopy = (char *) m_mem.dupData(data, dataSize);
+		if ( ! *dataCopy ) {
 			g_errno = ETRYAGAIN; 
 			log(LOG_WARN, "db: Could not allocate %" PRId32" bytes to add data to %s. Retrying.",dataSize,m_dbname);
 			logTrace(g_conf.m_logTraceRdb, "END. %s: Unable to allocate data. Returning false", m_dbname);
@@ -1391,7 +1521,7 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 		} else {
 			// do not overflow!
 			// log debug
-			const SpiderRequest *sreq = reinterpret_cast<const SpiderRequest *>(dataCopy);
+			const SpiderRequest *sreq = reinterpret_cast<const SpiderRequest *>(*dataCopy);
 			logf(LOG_DEBUG, "spider: added doledb key for pri=%" PRId32" time=%" PRIu32" uh48=%" PRIu64" u=%s",
 			     (int32_t)Doledb::getPriority(&doleKey),
 			     (uint32_t)Doledb::getSpiderTime(&doleKey),
@@ -1400,57 +1530,197 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 		}
 	}
 
-	// make the opposite key of "key"
+	return true;
+}
+
+// . the tree locks itself, the buckets lock must be held by the caller
+bool Rdb::deleteFromMemory_unlocked(collnum_t collnum, const char *key) {
+	return m_useTree ? m_tree.deleteNode(collnum, key, true) : m_buckets.deleteNode_unlocked(collnum, key);
+}
+
+// . with an index file a key may only delete its opposite in memory, or be
+//   changed into a delete doc key (newKey)
+// . returns false if there is nothing left to add, otherwise *keyPtr is the
+//   key to add
+bool Rdb::resolveIndexFileKey_unlocked(collnum_t collnum, const char **keyPtr, char *newKey) {
+	const char *key = *keyPtr;
+
 	char oppKey[MAX_KEY_BYTES];
 	KEYSET(oppKey, key, m_ks);
 	KEYXOR(oppKey, 0x01);
 
-	char newKey[MAX_KEY_BYTES];
-
-	if (m_useIndexFile) {
-		char specialOppKey[MAX_KEY_BYTES];
+	char specialOppKey[MAX_KEY_BYTES];
 
-		bool isSpecialKey;
-		bool isShardedByTermId;
-		bool isShardedByTermIdSameHost = false;
+	bool isSpecialKey;
+	bool isShardedByTermId;
+	bool isShardedByTermIdSameHost = false;
 
-		if (m_rdbId == RDB_POSDB || m_rdbId == RDB2_POSDB2) {
-			isSpecialKey = (Posdb::getTermId(key) == POSDB_DELETEDOC_TERMID);
-			isShardedByTermId = Posdb::isShardedByTermId(key);
+	if (m_rdbId == RDB_POSDB || m_rdbId == RDB2_POSDB2) {
+		isSpecialKey = (Posdb::getTermId(key) == POSDB_DELETEDOC_TERMID);
+		isShardedByTermId = Posdb::isShardedByTermId(key);
 
-			if (isShardedByTermId) {
-				isShardedByTermIdSameHost = (g_hostdb.getShard(g_hostdb.getShardNum(m_rdbId, key)) == g_hostdb.getShard(g_hostdb.getShardNumFromDocId(Posdb::getDocId(key))));
+		if (isShardedByTermId) {
+			isShardedByTermIdSameHost = (g_hostdb.getShard(g_hostdb.getShardNum(m_rdbId, key)) == g_hostdb.getShard(g_hostdb.getShardNumFromDocId(Posdb::getDocId(key))));
 
-				// if it's a positive key, we need to delete the existing delete doc key that could be present in tree/bucket
-				if (!isShardedByTermIdSameHost && !KEYNEG(key)) {
-					Posdb::makeDeleteDocKey(specialOppKey, Posdb::getDocId(key), false);
-					(void)(m_useTree ? m_tree.deleteNode(collnum, oppKey, true) : m_buckets.deleteNode(collnum, oppKey));
-				}
+			// if it's a positive key, we need to delete the existing delete doc key that could be present in tree/bucket
+			if (!isShardedByTermIdSameHost && !KEYNEG(key)) {
+				Posdb::makeDeleteDocKey(specialOppKey, Posdb::getDocId(key), false);
+				(void)deleteFromMemory_unlocked(collnum, oppKey);
 			}
-		} else {
-			/// @todo ALC cater for other rdb types here
-			gbshutdownLogicError();
 		}
+	} else {
+		/// @todo ALC cater for other rdb types here
+		gbshutdownLogicError();
+	}
+
+	// there are no negative keys when we're using index (except special keys eg: posdb with termId 0)
+	// if we're adding key that have a corresponding opposite key, it means we want to remove the key from the tree
+	// even if it's a positive key (how else would we remove the special negative key?)
+
+	// we only need to delete opposing key when it's a negative key, or it's a special key (even if it's positive)
+	if (KEYNEG(key) || isSpecialKey) {
+		bool deleted = deleteFromMemory_unlocked(collnum, oppKey);
+
+		// only return if we don't need to add special deleteDoc key for shardByTermId
+		if (deleted && (!isShardedByTermId || (isShardedByTermId && isShardedByTermIdSameHost))) {
+			// assume that we don't need to delete from index even when we get positive special key
+			// since positive special key will only be inserted when a new document is added
+			// this means that other keys should overwrite the existing deleted docId
+			logTrace(g_conf.m_logTraceRdb,
+			         "END. %s: Key with corresponding opposite key deleted in tree. Nothing to add", m_dbname);
+			return false;
+		}
+	}
+
+	// if we have no files on disk for this db, don't bother preserving a a negative rec, it just wastes tree space
+	if (KEYNEG(key)) {
+		// return if all data is in the tree
+		if (getBase(collnum)->getNumFiles() == 0) {
+			logTrace(g_conf.m_logTraceRdb, "END. %s: Negative key with all data in tree. Nothing to add", m_dbname);
+			return false;
+		}
+
+		// we need to change shard by termId delete key to a doc delete key
+		// this is to avoid dangling positive termId when docId is deleted
+		if (isShardedByTermId && !isShardedByTermIdSameHost) {
+			// we only make special key if termId do not belong to the same shard as docId
+			logTrace(g_conf.m_logTraceRdb, "%s: Shard by termId key found. Making special key.", m_dbname);
+			Posdb::makeDeleteDocKey(newKey, Posdb::getDocId(key), true);
+			key = newKey;
+			isSpecialKey = true;
+		}
+
+		// we should only store special delete keys (eg: posdb with termId 0)
+		// we will have non-special keys here to simplify logic in XmlDoc::getMetaList (and we can't really be sure
+		// if the key we're adding is in RdbTree/RdbBuckets at that point of time. It could potentially be dumped
+		// after the check.
+		if (!isSpecialKey) {
+			logTrace(g_conf.m_logTraceRdb, "END. %s: Negative key with non-zero termId found. Nothing to add", m_dbname);
+			return false;
+		}
+	} else {
+		// make sure that positive special key is not persisted (reasons as delete key above; the XmlDoc::getMetaList part)
+		if (isSpecialKey) {
+			logTrace(g_conf.m_logTraceRdb, "END. %s: Positive key with zero termId found. Nothing to add", m_dbname);
+			return false;
+		}
+	}
+
+	*keyPtr = key;
+	return true;
+}
+
+bool Rdb::canReorderAdd(const char *key) const {
+	// the spider dup cache depends on the order of the requests
+	if (m_rdbId == RDB_SPIDERDB || m_rdbId == RDB2_SPIDERDB2) {
+		return false;
+	}
 
-		// there are no negative keys when we're using index (except special keys eg: posdb with termId 0)
-		// if we're adding key that have a corresponding opposite key, it means we want to remove the key from the tree
-		// even if it's a positive key (how else would we remove the special negative key?)
+	// a delete of a posdb key sharded by termId on another host than its
+	// docId becomes a delete doc key (see resolveIndexFileKey_unlocked)
+	if (m_useIndexFile && (m_rdbId == RDB_POSDB || m_rdbId == RDB2_POSDB2) &&
+	    KEYNEG(key) && Posdb::isShardedByTermId(key)) {
+		return (g_hostdb.getShard(g_hostdb.getShardNum(m_rdbId, key)) ==
+		        g_hostdb.getShard(g_hostdb.getShardNumFromDocId(Posdb::getDocId(key))));
+	}
 
-		// we only need to delete opposing key when it's a negative key, or it's a special key (even if it's positive)
-		if (KEYNEG(key) || isSpecialKey) {
-			bool deleted = m_useTree ? m_tree.deleteNode(collnum, oppKey, true) : m_buckets.deleteNode(collnum, oppKey);
+	return true;
+}
 
-			// only return if we don't need to add special deleteDoc key for shardByTermId
-			if (deleted && (!isShardedByTermId || (isShardedByTermId && isShardedByTermIdSameHost))) {
-				// assume that we don't need to delete from index even when we get positive special key
-				// since positive special key will only be inserted when a new document is added
-				// this means that other keys should overwrite the existing deleted docId
-				logTrace(g_conf.m_logTraceRdb,
-				         "END. %s: Key with corresponding opposite key deleted in tree. Returning true", m_dbname);
+// . NOTE: low bit should be set , only antiKeys (deletes) have low bit clear
+// . returns false and sets g_errno on error, true otherwise
+// . if RdbMem, m_mem, has no mem, sets g_errno to ETRYAGAIN and returns false
+//   because dump should complete soon and free up some mem
+// . this overwrites dups
+bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_t dataSize) {
+	if (g_conf.m_logTraceRdb) {
+		char keyStrBuf[MAX_KEYSTR_BYTES];
+		KEYSTR(key, m_ks, keyStrBuf);
+		logTrace(g_conf.m_logTraceRdb, "BEGIN %s: collnum=%" PRId32" key=%s dataSize=%" PRId32,
+		         m_dbname, collnum, keyStrBuf, dataSize);
+	}
+
+	char *dataCopy;
+	if (!prepareRecord(collnum, key, data, dataSize, &dataCopy)) {
+		return false;
+	}
+
+	char newKey[MAX_KEY_BYTES];
+
+	if (!m_useTree) {
+		// . only posdb uses buckets so none of the spiderdb logic below applies
+		// . TODO: add using "lastNode" as a start node for the insertion point
+		// . should set g_errno if failed
+		// . caller should retry on g_errno of ETRYAGAIN or ENOMEM
+		bool added;
+		{
+			ScopedLock sl(m_buckets.getLock());
+			if (m_useIndexFile && !resolveIndexFileKey_unlocked(collnum, &key, newKey)) {
+				logTrace(g_conf.m_logTraceRdb, "END. %s: Nothing to add. Returning true", m_dbname);
 				return true;
 			}
+			added = m_buckets.addNode_unlocked(collnum, key, dataCopy, dataSize);
+		}
+
+		if (!added) {
+			log(LOG_INFO, "db: Had error adding data to %s: %s", m_dbname, mstrerror(g_errno));
+			return false;
 		}
 
+		RdbIndex *index = getBase(collnum)->getTreeIndex();
+		if (index) {
+			index->addRecord(key);
+		}
+
+		logTrace(g_conf.m_logTraceRdb, "END. %s: Done. Returning true", m_dbname);
+		return true;
+	}
+
+	if (m_useIndexFile) {
+		if (!resolveIndexFileKey_unlocked(collnum, &key, newKey)) {
+			logTrace(g_conf.m_logTraceRdb, "END. %s: Nothing to add. Returning true", m_dbname);
+			return true;
+		}
+	} else {
+		// make the opposite key of "key"
+		char oppKey[MAX_KEY_BYTES];
+		KEYSET(oppKey, key, m_ks);
+		KEYXOR(oppKey, 0x01);
+
+		// . TODO: save this tree-walking state for adding the node!!!
+		// . TODO: use something like getNode_unlocked(key,&lastNode) then addNode (lastNode,key,dataCopy,dataSize)
+		// . #1) if we're adding a positive key, replace negative counterpart
+		//       in the tree, because we'll override the positive rec it was
+		//       deleting
+		// . #2) if we're adding a negative key, replace positive counterpart
+		//       in the tree, but we must keep negative rec in tree in case
+		//       the positive counterpart was overriding one on disk (as in #1)
+
+		// . freeData should be true, the tree doesn't own the data
+		//   so it shouldn't free it really
+		m_tree.deleteNode(collnum, oppKey, true);
+
+		/// @todo ALC is this necessary? we remove delete keys when we dump to Rdb anyway for the first file
 		// if we have no files on disk for this db, don't bother preserving a a negative rec, it just wastes tree space
 		if (KEYNEG(key)) {
 			// return if all data is in the tree
@@ -1458,57 +1728,7 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 				logTrace(g_conf.m_logTraceRdb, "END. %s: Negative key with all data in tree. Returning true", m_dbname);
 				return true;
 			}
-
-			// we need to change shard by termId delete key to a doc delete key
-			// this is to avoid dangling positive termId when docId is deleted
-			if (isShardedByTermId && !isShardedByTermIdSameHost) {
-				// we only make special key if termId do not belong to the same shard as docId
-				logTrace(g_conf.m_logTraceRdb, "%s: Shard by termId key found. Making special key.", m_dbname);
-				Posdb::makeDeleteDocKey(newKey, Posdb::getDocId(key), true);
-				key = newKey;
-				isSpecialKey = true;
-			}
-
-			// we should only store special delete keys (eg: posdb with termId 0)
-			// we will have non-special keys here to simplify logic in XmlDoc::getMetaList (and we can't really be sure
-			// if the key we're adding is in RdbTree/RdbBuckets at that point of time. It could potentially be dumped
-			// after the check.
-			if (!isSpecialKey) {
-				logTrace(g_conf.m_logTraceRdb, "END. %s: Negative key with non-zero termId found. Returning true", m_dbname);
-				return true;
-			}
-		} else {
-			// make sure that positive special key is not persisted (reasons as delete key above; the XmlDoc::getMetaList part)
-			if (isSpecialKey) {
-				logTrace(g_conf.m_logTraceRdb, "END. %s: Positive key with zero termId found. Returning true", m_dbname);
-				return true;
-			}
-		}
-	} else {
-		if (m_useTree) {
-			// . TODO: save this tree-walking state for adding the node!!!
-			// . TODO: use something like getNode_unlocked(key,&lastNode) then addNode (lastNode,key,dataCopy,dataSize)
-			// . #1) if we're adding a positive key, replace negative counterpart
-			//       in the tree, because we'll override the positive rec it was
-			//       deleting
-			// . #2) if we're adding a negative key, replace positive counterpart
-			//       in the tree, but we must keep negative rec in tree in case
-			//       the positive counterpart was overriding one on disk (as in #1)
-
-			// . freeData should be true, the tree doesn't own the data
-			//   so it shouldn't free it really
-			m_tree.deleteNode(collnum, oppKey, true);
-
-			/// @todo ALC is this necessary? we remove delete keys when we dump to Rdb anyway for the first file
-			// if we have no files on disk for this db, don't bother preserving a a negative rec, it just wastes tree space
-			if (KEYNEG(key)) {
-				// return if all data is in the tree
-				if (getBase(collnum)->getNumFiles() == 0) {
-					logTrace(g_conf.m_logTraceRdb, "END. %s: Negative key with all data in tree. Returning true", m_dbname);
-					return true;
-				}
-				// . otherwise, assume we match a positive...
-			}
+			// . otherwise, assume we match a positive...
 		}
 	}
 
@@ -1552,19 +1772,9 @@ bool Rdb::addRecord(collnum_t collnum, const char *key, const char *data, int32_
 		}
 	}
 
-	if (m_useTree) {
-		if (!m_tree.addNode(collnum, key, dataCopy, dataSize)) {
-			log(LOG_INFO, "db: Had error adding data to %s: %s", m_dbname, mstrerror(g_errno));
-			return false;
-		}
-	} else {
-		// . TODO: add using "lastNode" as a start node for the insertion point
-		// . should set g_errno if failed
-		// . caller should retry on g_errno of ETRYAGAIN or ENOMEM
-		if (!m_buckets.addNode(collnum, key, dataCopy, dataSize)) {
-			log(LOG_INFO, "db: Had error adding data to %s: %s", m_dbname, mstrerror(g_errno));
-			return false;
-		}
+	if (!m_tree.addNode(collnum, key, dataCopy, dataSize)) {
+		log(LOG_INFO, "db: Had error adding data to %s: %s", m_dbname, mstrerror(g_errno));
+		return false;
 	}
 
 	// Add data record to the current index file for the -saved.dat file.
@@ -1814,6 +2024,43 @@ int64_t Rdb::getMapMemAllocated() const {
 	return total;
 }
 
+// . how much mem is used by the docid indexes of our files?
+int64_t Rdb::getIndexMemAllocated() const {
+	int64_t total = 0;
+	for ( int32_t i = 0 ; i < getNumBases() ; i++ ) {
+		CollectionRec *cr = g_collectiondb.getRec(i);
+		if ( ! cr ) continue;
+		RdbBase *base = cr->getBase(m_rdbId);
+		if ( ! base ) continue;
+		total += base->getIndexMemAllocated();
+	}
+	return total;
+}
+
+int64_t Rdb::getLoadTimeMs() const {
+	int64_t total = 0;
+	for ( int32_t i = 0 ; i < getNumBases() ; i++ ) {
+		CollectionRec *cr = g_collectiondb.getRec(i);
+		if ( ! cr ) continue;
+		RdbBase *base = cr->getBase(m_rdbId);
+		if ( ! base ) continue;
+		total += base->getLoadTimeMs();
+	}
+	return total;
+}
+
+int32_t Rdb::getNumUnloadedBases() const {
+	int32_t count = 0;
+	for ( int32_t i = 0 ; i < getNumBases() ; i++ ) {
+		CollectionRec *cr = g_collectiondb.getRec(i);
+		if ( ! cr ) continue;
+		RdbBase *base = cr->getBase(m_rdbId);
+		if ( ! base ) continue;
+		if ( ! base->areFilesLoaded() ) count++;
+	}
+	return count;
+}
+
 // sum of all parts of all big files
 int32_t Rdb::getNumSmallFiles() const {
 	int32_t total = 0;
@@ -2047,7 +2294,7 @@ bool Rdb::getTreeCollExist(collnum_t collnum) const {
 // memory from deleted nodes. works by condensing the used memory.
 // returns how much we reclaimed.
 int32_t Rdb::reclaimMemFromDeletedTreeNodes() {
-	ScopedLock sl(m_tree.getLock());
+	ScopedWriteLock sl(m_tree.getLock());
 
 	log("rdb: reclaiming tree mem for doledb");
 
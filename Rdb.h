@@ -6,7 +6,7 @@
 #define GB_RDB_H
 
 #include "RdbBase.h"
-#include "RdbTree.h"
+#include "RdbSkipList.h"
 #include "RdbMem.h"
 #include "RdbDump.h"
 #include "RdbBuckets.h"
@@ -14,6 +14,7 @@
 #include "Hostdb.h"
 #include "rdbid_t.h"
 #include <atomic>
+#include <vector>
 
 bool makeTrashDir() ;
 
@@ -41,6 +42,19 @@ void forceMergeAll(rdbid_t rdbId);
 void attemptMergeAllCallback ( int fd , void *state ) ;
 void attemptMergeAll ( );
 
+// a record as serialized in an RdbList, for Rdb::addBatch()
+struct RdbBatchRec {
+	RdbBatchRec(collnum_t collnum, const char *rec, int32_t recSize)
+		: m_collnum(collnum)
+		, m_rec(rec)
+		, m_recSize(recSize) {
+	}
+
+	collnum_t m_collnum;
+	const char *m_rec;
+	int32_t m_recSize;
+};
+
 class Rdb {
 public:
 
@@ -99,6 +113,15 @@ public:
 		return addList(collnum,list,false);
 	}
 
+	// . add records of possibly different collections in order, taking
+	//   the buckets lock only once. see Msg4In
+	// . does not check for room. returns false and sets g_errno on error
+	bool addBatch(const RdbBatchRec *recs, int32_t numRecs);
+
+	// . false if adding this record may affect records with keys other than
+	//   its opposite key, so it must not be reordered with the records around it
+	bool canReorderAdd(const char *key) const;
+
 	bool deleteTreeNode(collnum_t collnum, const char *key);
 
 	void verifyTreeIntegrity();
@@ -117,7 +140,7 @@ public:
 
 	bool isTitledb() const { return m_rdbId==RDB_TITLEDB || m_rdbId==RDB2_TITLEDB2; }
 
-	RdbTree* getTree() { return (m_useTree ? &m_tree : NULL); }
+	RdbSkipList* getTree() { return (m_useTree ? &m_tree : NULL); }
 	RdbBuckets *getBuckets() { return (m_useTree ? NULL : &m_buckets); }
 
 	int32_t getAvailMem() const { return m_mem.getAvailMem(); }
@@ -139,6 +162,11 @@ public:
 
 	// how much mem is allocated for our maps?
 	int64_t getMapMemAllocated() const;
+	int64_t getIndexMemAllocated() const;
+
+	// time spent loading maps/indexes and # of collections not loaded yet
+	int64_t getLoadTimeMs() const;
+	int32_t getNumUnloadedBases() const;
 
 	int32_t getNumFiles() const;
 
@@ -241,6 +269,12 @@ private:
 	bool dumpTree();
 
 	bool addList(collnum_t collnum, RdbList *list, bool checkForRoom);
+	bool checkRepairMode(collnum_t collnum, int32_t listSize) const;
+	void handleAddError();
+
+	bool prepareRecord(collnum_t collnum, const char *key, const char *data, int32_t dataSize, char **dataCopy);
+	bool deleteFromMemory_unlocked(collnum_t collnum, const char *key);
+	bool resolveIndexFileKey_unlocked(collnum_t collnum, const char **keyPtr, char *newKey);
 	// get the directory name where this rdb stores its files
 	const char *getDir() const { return g_hostdb.m_dir; }
 
@@ -260,7 +294,7 @@ private:
 	bool		m_useIndexFile;
 
 	// for storing records in memory
-	RdbTree    m_tree;  
+	RdbSkipList m_tree;
 	RdbBuckets m_buckets;
 
 	bool       m_useTree;
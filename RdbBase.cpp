@@ -16,6 +16,7 @@
 #include "Rebalance.h"
 #include "JobScheduler.h"
 #include "Process.h"
+#include "UdpServer.h"
 #include "Sanity.h"
 #include "Dir.h"
 #include "File.h"
@@ -27,6 +28,7 @@
 #include <fcntl.h>
 #include <algorithm>
 #include <set>
+#include <map>
 #include <signal.h>
 #include <algorithm>
 
@@ -84,15 +86,56 @@ static const int32_t absoluteMaxFilesToMerge = 50;
 
 GbThreadQueue RdbBase::m_globalIndexThreadQueue;
 
+// startup loading state. main thread only
+static bool s_parallelLoad = false;
+static std::vector<RdbBase*> s_parallelLoadBases;
+static int64_t s_parallelLoadStart = 0;
+
+// load jobs of all bases still running in the job threads
+static std::atomic<int32_t> s_numLoadJobsOutstanding(0);
+
+// the map and index of a file being loaded, and how reading them went
+struct RdbBase::FileLoad {
+	int32_t   m_fileId;
+	BigFile  *m_file;
+	RdbMap   *m_map;
+	RdbIndex *m_index;
+	bool      m_mapOk;
+	int32_t   m_mapErrno;
+	bool      m_indexOk;
+	int32_t   m_indexErrno;
+	int64_t   m_took;
+};
+
+// . a submitted job reading m_fileLoads[m_num] of m_base
+// . deleted by loadFileJobDone(), after the base may be done with loading
+struct RdbBase::FileLoadJob {
+	RdbBase *m_base;
+	size_t   m_num;
+	bool     m_done;
+};
+
 RdbBase::RdbBase()
   : m_numFiles(0),
     m_mtxFileInfo(),
     m_docIdFileIndex(new docids_t),
+    m_docIdFileIndexPacked(),
     m_attemptOnlyMergeResumption(true),
     m_dumpingFileId(-1),
     m_submittingJobs(false),
     m_outstandingJobCount(0),
-    m_mtxJobCount()
+    m_mtxJobCount(),
+    m_filesLoaded(true),
+    m_loadTimeMs(0),
+    m_numFilesLoaded(0),
+    m_mtxLoad(),
+    m_loadCond(PTHREAD_COND_INITIALIZER),
+    m_loading(false),
+    m_finishLoadInJobThread(false),
+    m_fileLoads(),
+    m_numLoadJobsOutstanding(0),
+    m_loadStartMs(0),
+    m_loadDoneMs(0)
 {
 	m_rdb = NULL;
 	m_nextMergeForced = false;
@@ -128,6 +171,9 @@ RdbBase::RdbBase()
 }
 
 void RdbBase::reset ( ) {
+	// the load jobs use our files
+	waitForLoad();
+
 	for ( int32_t i = 0 ; i < m_numFiles ; i++ ) {
 		mdelete(m_fileInfo[i].m_file, sizeof(BigFile), "RdbBFile");
 		delete m_fileInfo[i].m_file;
@@ -141,11 +187,18 @@ void RdbBase::reset ( ) {
 
 	m_numFiles  = 0;
 	m_isMerging = false;
+
+	m_filesLoaded = true;
+	m_loadTimeMs = 0;
+	m_numFilesLoaded = 0;
 }
 
 RdbBase::~RdbBase ( ) {
 	//close ( NULL , NULL );
 	reset();
+
+	// in case we die before finishParallelLoad() got to us
+	s_parallelLoadBases.erase(std::remove(s_parallelLoadBases.begin(), s_parallelLoadBases.end(), this), s_parallelLoadBases.end());
 }
 
 bool RdbBase::init(const char *dir,
@@ -157,7 +210,7 @@ bool RdbBase::init(const char *dir,
                    int32_t pageSize,
                    const char *coll,
                    collnum_t collnum,
-                   RdbTree *tree,
+                   RdbSkipList *tree,
                    RdbBuckets *buckets,
                    Rdb *rdb,
                    bool useIndexFile) {
@@ -471,13 +524,115 @@ bool RdbBase::setFiles ( ) {
 		return fixNonfirstSpiderdbFiles();
 	}
 
+	// cold collections are not loaded until they are used
+	if ( isColdCollection() ) {
+		log(LOG_DEBUG, "db: Deferring load of %s files for cold collection %s (%" PRId32")",
+		    m_dbname, m_coll, (int32_t)m_collnum);
+		m_filesLoaded = false;
+		return true;
+	}
+
+	// . at startup the files of all bases are read in parallel, and
+	//   finishParallelLoad() waits for them
+	// . only then are they used, so they count as loaded already
+	if ( s_parallelLoad ) {
+		m_filesLoaded = false;
+		startLoad(false);
+		s_parallelLoadBases.push_back(this);
+		return true;
+	}
+
+	if ( ! loadPendingFiles() ) {
+		return false;
+	}
+
+	return true;
+}
+
+// a collection that is not spidering is only loaded on first access when
+// lazy loading is enabled. only applies at startup
+bool RdbBase::isColdCollection() const {
+	if ( ! g_conf.m_lazyLoadColdCollections || g_loop.m_isDoingLoop ) {
+		return false;
+	}
+	const CollectionRec *cr = g_collectiondb.getRec(m_collnum);
+	return cr && ! cr->m_spideringEnabled;
+}
+
+// create the global index and check the sharding once the maps and indexes
+// of all files are loaded
+void RdbBase::finishLoading() {
 	// create global index
 	generateGlobalIndex();
 
-	// ensure files are sharded correctly
-	verifyFileSharding();
+	m_filesLoaded = true;
 
-	return true;
+	// . ensure files are sharded correctly
+	// . only at startup, and it reads the files like any other access
+	if ( g_process.isMainThread() ) {
+		verifyFileSharding();
+	}
+
+	if ( m_numFilesLoaded > 0 ) {
+		log(LOG_INFO, "db: Loaded %" PRId32" %s files for collection %s (%" PRId32") in %" PRId64" ms (%" PRId64" ms per file summed)",
+		    m_numFilesLoaded, m_dbname, m_coll, (int32_t)m_collnum,
+		    m_loadDoneMs - m_loadStartMs, m_loadTimeMs);
+	}
+}
+
+// . the files of a cold collection are loaded on first access, using the
+//   io threads. the main thread and the udp receive threads must not block
+//   on that, so they only start the load and see "not loaded" until it is
+//   done. the other threads wait for it
+// . if loading fails the files stay unloaded and the next access retries
+// . returns false if the files are not loaded
+bool RdbBase::ensureFilesLoaded() {
+	if ( m_filesLoaded ) {
+		return true;
+	}
+
+	ScopedLock sl(m_mtxLoad);
+	bool loading = m_loading;
+	sl.unlock();
+
+	if ( ! loading ) {
+		log(LOG_INFO, "db: Loading %s files for collection %s (%" PRId32") on first access",
+		    m_dbname, m_coll, (int32_t)m_collnum);
+		startLoad(true);
+	}
+
+	if ( g_process.isMainThread() || UdpServer::isReceiveThread() ) {
+		return m_filesLoaded;
+	}
+	return waitForLoad();
+}
+
+// . wait for a load started by startLoad() to finish
+// . the main thread reaps the jobs itself because the main loop is not
+//   running while it waits
+// . returns false if the files are not loaded
+bool RdbBase::waitForLoad() {
+	bool isMainThread = g_process.isMainThread();
+	for ( ; ; ) {
+		ScopedLock sl(m_mtxLoad);
+		if ( ! m_loading ) {
+			break;
+		}
+		if ( ! isMainThread ) {
+			pthread_cond_wait(&m_loadCond, &(m_mtxLoad.mtx));
+			continue;
+		}
+		// a startup load is finished by finishParallelLoad(), unless
+		// we get to it first
+		if ( ! m_finishLoadInJobThread && m_numLoadJobsOutstanding == 0 ) {
+			sl.unlock();
+			return finishLoad();
+		}
+		sl.unlock();
+		g_jobScheduler.cleanup_finished_jobs();
+		usleep(1000);
+	}
+	return m_filesLoaded;
 }
 
 
@@ -888,19 +1043,132 @@ int32_t RdbBase::addFile ( bool isNew, int32_t fileId, int32_t fileId2, int32_t
 	char mapName[1024];
 	generateMapFilename(mapName,sizeof(mapName),fileId,fileId2,0,-1);
 	m->set(dirName, mapName, m_fixedDataSize, m_useHalfKeys, m_ks, m_pageSize);
-	if ( ! isNew && !isInMergeDir && ! m->readMap ( f ) ) {
+	if( m_useIndexFile ) {
+		char indexName[1024];
+
+		// set the index file's  filename
+		generateIndexFilename(indexName,sizeof(indexName),fileId,fileId2,0,-1);
+		in->set(dirName, indexName, m_fixedDataSize, m_useHalfKeys, m_ks, m_rdb->getRdbId(), (!isNew && !isInMergeDir));
+	}
+
+	if (!isNew) {
+		// open this big data file for reading only
+		if ( mergeNum < 0 ) {
+			f->open(O_RDONLY);
+		} else {
+			// otherwise, merge will have to be resumed so this file
+			// should be writable
+			f->open(O_RDWR);
+		}
+		f->setFlushingIsApplicable();
+	}
+
+	// posdb lookups are small and mostly hit the page cache
+	if ( m_rdb->getRdbId() == RDB_POSDB || m_rdb->getRdbId() == RDB2_POSDB2 ) {
+		f->setMmapReads(true);
+	}
+
+	// find the position to add so we maintain order by fileId
+	int32_t i ;
+	for ( i = 0 ; i < m_numFiles ; i++ ) {
+		if ( m_fileInfo[i].m_fileId >= fileId ) {
+			break;
+		}
+	}
+
+	// cannot collide here
+	if ( i < m_numFiles && m_fileInfo[i].m_fileId == fileId ) {
+		log(LOG_LOGIC,"db: addFile: fileId collided.");
+		return -1;
+	}
+
+	// shift everyone up if we need to fit this file in the middle somewhere
+	memmove( m_fileInfo+i+1, m_fileInfo+i, (m_numFiles-i)*sizeof(m_fileInfo[0]));
+
+	// insert this file into position #i
+	m_fileInfo[i].m_fileId  = fileId;
+	m_fileInfo[i].m_fileId2 = fileId2;
+	m_fileInfo[i].m_file    = f;
+	m_fileInfo[i].m_map     = m;
+	m_fileInfo[i].m_index   = in;
+	if(!isInMergeDir) {
+		if(fileId&1)
+			m_fileInfo[i].m_allowReads = true;
+		else
+			m_fileInfo[i].m_allowReads = false;
+	} else {
+		m_fileInfo[i].m_allowReads = false;//until we know for sure it is finished
+	}
+	m_fileInfo[i].m_pendingGenerateIndex = false;
+	// the map and index of an existing file are read by loadPendingFiles()
+	// once all the files have been added
+	m_fileInfo[i].m_pendingLoad = ( !isNew && !isInMergeDir );
+
+	// are we resuming a killed merge?
+	if ( g_conf.m_readOnlyMode && ((fileId & 0x01)==0) ) {
+		log("db: Cannot start in read only mode with an incomplete "
+		    "merge, because we might be a temporary cluster and "
+		    "the merge might be active.");
+
+		gbshutdownCorrupted();
+	}
+
+	// inc # of files we have
+	m_numFiles++;
+
+	// if we added a merge file, mark it
+	if ( mergeNum >= 0 ) {
+		m_mergeStartFileNum = i + 1 ; //merge was starting w/ this file
+	}
+
+	return i;
+}
+
+// read the map and index of a file. may be called in a job thread
+void RdbBase::readFileMapAndIndex(FileLoad *job) {
+	int64_t start = gettimeofdayInMilliseconds();
+
+	g_errno = 0;
+	job->m_mapOk = job->m_map->readMap(job->m_file);
+	job->m_mapErrno = g_errno;
+
+	g_errno = 0;
+	job->m_indexOk = true;
+	job->m_indexErrno = 0;
+	if ( m_useIndexFile ) {
+		job->m_indexOk = job->m_index->readIndex() && job->m_index->verifyIndex();
+		job->m_indexErrno = g_errno;
+		if ( job->m_indexOk && g_conf.m_packRdbIndexes ) {
+			job->m_index->packDocIds();
+		}
+	}
+	g_errno = 0;
+
+	job->m_took = gettimeofdayInMilliseconds() - start;
+}
+
+// . regenerate the map or index if they could not be read
+// . returns false and sets g_errno on error
+bool RdbBase::finishFileLoad(const FileLoad *job) {
+	int64_t start = gettimeofdayInMilliseconds();
+	BigFile  *f  = job->m_file;
+	RdbMap   *m  = job->m_map;
+	RdbIndex *in = job->m_index;
+
+	if ( ! job->m_mapOk ) {
 		// if out of memory, do not try to regen for that
-		if ( g_errno == ENOMEM ) {
-			return -1;
+		if ( job->m_mapErrno == ENOMEM ) {
+			g_errno = ENOMEM;
+			return false;
 		}
 
 		g_errno = 0;
-		log("db: Could not read map file %s",mapName);
+		log("db: Could not read map file %s",m->getFilename());
 
 		// if 'gb dump X collname' was called, bail, we do not
 		// want to write any data
 		if ( g_dumpMode ) {
-			return -1;
+			return false;
 		}
 
 		log( LOG_INFO, "db: Attempting to generate map file for data file %s* of %" PRId64" bytes. May take a while.",
@@ -923,33 +1191,27 @@ int32_t RdbBase::addFile ( bool isNew, int32_t fileId, int32_t fileId2, int32_t
 		bool status = m->writeMap( true );
 		if ( ! status ) {
 			log( LOG_ERROR, "db: Save failed." );
-			return -1;
+			return false;
 		}
 	}
 
-	if (!isNew) {
-		log(LOG_DEBUG, "db: Added %s for collnum=%" PRId32" pages=%" PRId32,
-		    mapName, (int32_t)m_collnum, m->getNumPages());
-	}
+	log(LOG_DEBUG, "db: Added %s for collnum=%" PRId32" pages=%" PRId32,
+	    m->getFilename(), (int32_t)m_collnum, m->getNumPages());
 
 	if( m_useIndexFile ) {
-		char indexName[1024];
-
-		// set the index file's  filename
-		generateIndexFilename(indexName,sizeof(indexName),fileId,fileId2,0,-1);
-		in->set(dirName, indexName, m_fixedDataSize, m_useHalfKeys, m_ks, m_rdb->getRdbId(), (!isNew && !isInMergeDir));
-		if (!isNew && !isInMergeDir && !(in->readIndex() && in->verifyIndex())) {
+		if ( ! job->m_indexOk ) {
 			// if out of memory, do not try to regen for that
-			if (g_errno == ENOMEM) {
-				return -1;
+			if (job->m_indexErrno == ENOMEM) {
+				g_errno = ENOMEM;
+				return false;
 			}
 
 			g_errno = 0;
-			log(LOG_WARN, "db: Could not read index file %s",indexName);
+			log(LOG_WARN, "db: Could not read index file %s",in->getFilename());
 
 			// if 'gb dump X collname' was called, bail, we do not want to write any data
 			if (g_dumpMode) {
-				return -1;
+				return false;
 			}
 
 			log(LOG_INFO, "db: Attempting to generate index file for data file %s* of %" PRId64" bytes. May take a while.",
@@ -971,79 +1233,219 @@ int32_t RdbBase::addFile ( bool isNew, int32_t fileId, int32_t fileId2, int32_t
 			bool status = in->writeIndex(true);
 			if ( ! status ) {
 				log( LOG_ERROR, "db: Save failed." );
-				return -1;
+				return false;
+			}
+
+			if ( g_conf.m_packRdbIndexes ) {
+				in->packDocIds();
 			}
 		}
 
-		if (!isNew) {
-			log(LOG_DEBUG, "db: Added %s for collnum=%" PRId32" docId count=%" PRIu64,
-			    indexName, (int32_t)m_collnum, in->getDocIds()->size());
+		log(LOG_DEBUG, "db: Added %s for collnum=%" PRId32" docId count=%" PRIu64,
+		    in->getFilename(), (int32_t)m_collnum, (uint64_t)in->getNumDocIds());
+	}
+
+	ScopedLock sl(m_mtxFileInfo);
+	for ( int32_t i = 0 ; i < m_numFiles ; i++ ) {
+		if ( m_fileInfo[i].m_fileId == job->m_fileId ) {
+			m_fileInfo[i].m_pendingLoad = false;
+			break;
 		}
 	}
+	sl.unlock();
+	m_numFilesLoaded++;
+	m_loadTimeMs += job->m_took + ( gettimeofdayInMilliseconds() - start );
+	return true;
+}
 
-	if (!isNew) {
-		// open this big data file for reading only
-		if ( mergeNum < 0 ) {
-			f->open(O_RDONLY);
-		} else {
-			// otherwise, merge will have to be resumed so this file
-			// should be writable
-			f->open(O_RDWR);
+// list the files whose map and index have not been read yet in m_fileLoads
+void RdbBase::prepareLoad() {
+	m_fileLoads.clear();
+	m_numFilesLoaded = 0;
+	m_loadTimeMs = 0;
+	m_loadStartMs = gettimeofdayInMilliseconds();
+	m_loadDoneMs = 0;
+
+	ScopedLock sl(m_mtxFileInfo);
+	for ( int32_t i = 0 ; i < m_numFiles ; i++ ) {
+		if ( ! m_fileInfo[i].m_pendingLoad ) {
+			continue;
 		}
-		f->setFlushingIsApplicable();
+		FileLoad load;
+		memset(&load, 0, sizeof(load));
+		load.m_fileId = m_fileInfo[i].m_fileId;
+		load.m_file = m_fileInfo[i].m_file;
+		load.m_map = m_fileInfo[i].m_map;
+		load.m_index = m_fileInfo[i].m_index;
+		m_fileLoads.push_back(load);
 	}
+}
 
-	// find the position to add so we maintain order by fileId
-	int32_t i ;
-	for ( i = 0 ; i < m_numFiles ; i++ ) {
-		if ( m_fileInfo[i].m_fileId >= fileId ) {
+// . read the maps and indexes of our files one at a time in this thread
+// . anything that could not be read is regenerated
+// . returns false and sets g_errno on error
+bool RdbBase::loadPendingFiles() {
+	{
+		ScopedLock sl(m_mtxLoad);
+		m_loading = true;
+		m_finishLoadInJobThread = false;
+		prepareLoad();
+	}
+	for ( auto &load : m_fileLoads ) {
+		readFileMapAndIndex(&load);
+	}
+	m_loadDoneMs = gettimeofdayInMilliseconds();
+	return finishLoad();
+}
+
+// . read the maps and indexes of our files in parallel using the io threads
+// . if "finishInJobThread" the job reading the last file also regenerates
+//   what could not be read and finishes the load, otherwise
+//   finishParallelLoad() does that
+void RdbBase::startLoad(bool finishInJobThread) {
+	ScopedLock sl(m_mtxLoad);
+	if ( m_loading ) {
+		return;
+	}
+	m_loading = true;
+	m_finishLoadInJobThread = finishInJobThread;
+	prepareLoad();
+
+	// m_fileLoads[] must not be resized from here on. the extra count
+	// keeps the jobs from finishing the load before all are submitted
+	m_numLoadJobsOutstanding = m_fileLoads.size() + 1;
+	sl.unlock();
+
+	for ( size_t i = 0 ; i < m_fileLoads.size() ; i++ ) {
+		FileLoadJob *job = new FileLoadJob;
+		job->m_base = this;
+		job->m_num = i;
+		job->m_done = false;
+		s_numLoadJobsOutstanding++;
+		if ( ! g_jobScheduler.are_new_jobs_allowed() ||
+		     ! g_jobScheduler.submit(loadFileJob, loadFileJobDone, job, thread_type_unspecified_io, 0) ) {
+			loadFileJob(job);
+			loadFileJobDone(job, job_exit_normal);
+		}
+	}
+
+	loadJobDone();
+}
+
+void RdbBase::loadFileJob(void *state) {
+	FileLoadJob *job = static_cast<FileLoadJob*>(state);
+	RdbBase *base = job->m_base;
+	base->readFileMapAndIndex(&base->m_fileLoads[job->m_num]);
+	job->m_done = true;
+	base->loadJobDone();
+	s_numLoadJobsOutstanding--;
+}
+
+void RdbBase::loadFileJobDone(void *state, job_exit_t /*exit_type*/) {
+	FileLoadJob *job = static_cast<FileLoadJob*>(state);
+	// a job that was cancelled never ran, so do it here
+	if ( ! job->m_done ) {
+		loadFileJob(job);
+	}
+	delete job;
+}
+
+// called when a load job is done and once all of them are submitted
+void RdbBase::loadJobDone() {
+	if ( --m_numLoadJobsOutstanding > 0 ) {
+		return;
+	}
+	m_loadDoneMs = gettimeofdayInMilliseconds();
+	if ( m_finishLoadInJobThread ) {
+		finishLoad();
+	}
+}
+
+// . regenerate the maps and indexes that could not be read and set up the
+//   global index once all of the files are read
+// . if that fails the files stay unloaded, and the next access tries again
+// . wakes up the threads waiting in waitForLoad()
+// . returns false and sets g_errno on error
+bool RdbBase::finishLoad() {
+	bool status = true;
+	for ( const auto &load : m_fileLoads ) {
+		if ( ! finishFileLoad(&load) ) {
+			log(LOG_ERROR, "db: Failed to load %s files for collection %s (%" PRId32"): %s",
+			    m_dbname, m_coll, (int32_t)m_collnum, mstrerror(g_errno));
+			status = false;
 			break;
 		}
 	}
 
-	// cannot collide here
-	if ( i < m_numFiles && m_fileInfo[i].m_fileId == fileId ) {
-		log(LOG_LOGIC,"db: addFile: fileId collided.");
-		return -1;
+	if ( status ) {
+		finishLoading();
 	}
 
-	// shift everyone up if we need to fit this file in the middle somewhere
-	memmove( m_fileInfo+i+1, m_fileInfo+i, (m_numFiles-i)*sizeof(m_fileInfo[0]));
+	int32_t err = g_errno;
+	ScopedLock sl(m_mtxLoad);
+	m_loading = false;
+	pthread_cond_broadcast(&m_loadCond);
+	sl.unlock();
+	g_errno = err;
 
-	// insert this file into position #i
-	m_fileInfo[i].m_fileId  = fileId;
-	m_fileInfo[i].m_fileId2 = fileId2;
-	m_fileInfo[i].m_file    = f;
-	m_fileInfo[i].m_map     = m;
-	m_fileInfo[i].m_index   = in;
-	if(!isInMergeDir) {
-		if(fileId&1)
-			m_fileInfo[i].m_allowReads = true;
-		else
-			m_fileInfo[i].m_allowReads = false;
-	} else {
-		m_fileInfo[i].m_allowReads = false;//until we know for sure it is finished
+	return status;
+}
+
+void RdbBase::beginParallelLoad() {
+	if ( ! g_conf.m_parallelStartupLoad ) {
+		return;
 	}
-	m_fileInfo[i].m_pendingGenerateIndex = false;
+	s_parallelLoad = true;
+	s_parallelLoadBases.clear();
+	s_parallelLoadStart = gettimeofdayInMilliseconds();
+}
 
-	// are we resuming a killed merge?
-	if ( g_conf.m_readOnlyMode && ((fileId & 0x01)==0) ) {
-		log("db: Cannot start in read only mode with an incomplete "
-		    "merge, because we might be a temporary cluster and "
-		    "the merge might be active.");
+// . wait for the load jobs submitted since beginParallelLoad() and finish
+//   loading the bases
+// . logs how long it took per rdb
+void RdbBase::finishParallelLoad() {
+	if ( ! s_parallelLoad ) {
+		return;
+	}
+	s_parallelLoad = false;
 
-		gbshutdownCorrupted();
+	// the main loop is not running yet so reap the finished jobs here
+	while ( s_numLoadJobsOutstanding > 0 ) {
+		g_jobScheduler.cleanup_finished_jobs();
+		if ( s_numLoadJobsOutstanding > 0 ) {
+			usleep(1000);
+		}
 	}
+	int64_t readDone = gettimeofdayInMilliseconds();
 
-	// inc # of files we have
-	m_numFiles++;
+	struct RdbLoadTotals {
+		int32_t m_numBases;
+		int32_t m_numFiles;
+		int64_t m_took;
+	};
+	std::map<rdbid_t,RdbLoadTotals> totals;
+	int32_t numFiles = 0;
+	for ( auto base : s_parallelLoadBases ) {
+		// waitForLoad() may have finished it already
+		if ( base->m_loading ) {
+			base->finishLoad();
+			g_errno = 0;
+		}
 
-	// if we added a merge file, mark it
-	if ( mergeNum >= 0 ) {
-		m_mergeStartFileNum = i + 1 ; //merge was starting w/ this file
+		RdbLoadTotals &t = totals[base->m_rdb->getRdbId()];
+		t.m_numBases++;
+		t.m_numFiles += base->m_numFilesLoaded;
+		t.m_took += base->m_loadTimeMs;
+		numFiles += base->m_numFilesLoaded;
 	}
+	s_parallelLoadBases.clear();
 
-	return i;
+	for ( const auto &t : totals ) {
+		log(LOG_INFO, "db: Startup load of %s: %" PRId32" files in %" PRId32" collections took %" PRId64" ms per file summed",
+		    getDbnameFromId(t.first), t.second.m_numFiles, t.second.m_numBases, t.second.m_took);
+	}
+	log(LOG_INFO, "db: Read maps and indexes of %" PRId32" files in %" PRId64" ms, loaded them in %" PRId64" ms",
+	    numFiles, readDone - s_parallelLoadStart, gettimeofdayInMilliseconds() - s_parallelLoadStart);
 }
 
 int32_t RdbBase::addNewFile(int32_t *fileIdPtr) {
@@ -1127,11 +1529,13 @@ int32_t RdbBase::isRootFile(int32_t n) const {
 }
 
 RdbMap* RdbBase::getMap(int32_t n) {
+	ensureFilesLoaded();
 	ScopedLock sl(m_mtxFileInfo);
 	return m_fileInfo[n].m_map;
 }
 
 RdbMap* RdbBase::getMapById(int32_t fileId) {
+	ensureFilesLoaded();
 	ScopedLock sl(m_mtxFileInfo);
 	for (auto i = 0; i < m_numFiles; ++i) {
 		if (m_fileInfo[i].m_fileId == fileId) {
@@ -1142,6 +1546,7 @@ RdbMap* RdbBase::getMapById(int32_t fileId) {
 }
 
 RdbIndex* RdbBase::getIndex(int32_t n) {
+	ensureFilesLoaded();
 	ScopedLock sl(m_mtxFileInfo);
 	return m_fileInfo[n].m_index;
 }
@@ -1216,6 +1621,11 @@ void RdbBase::saveRdbIndexRdbMap(void *state) {
 			log(LOG_ERROR, "db: Could not write index for %s, Exiting.", that->m_dbname);
 			gbshutdownAbort(true);
 		}
+
+		// the merged file is final now
+		if (g_conf.m_packRdbIndexes) {
+			that->m_fileInfo[x].m_index->packDocIds();
+		}
 	}
 }
 
@@ -1569,7 +1979,7 @@ void RdbBase::renamesDone() {
 	bool wait = false;
 	for ( int32_t i = a ; i < b ; i++ ) {
 		BigFile *bf = m_fileInfo[i].m_file;
-		if ( g_jobScheduler.is_reading_file(bf) ) wait = true;
+		if ( bf->isBeingRead() ) wait = true;
 	}
 	if ( wait ) {
 		log("db: waiting for read thread to exit on unlinked file");
@@ -1813,6 +2223,13 @@ bool RdbBase::attemptMerge(int32_t niceness, bool forceMergeAll, int32_t minToMe
 		return false;
 	}
 
+	// a cold collection that needs merging must be loaded first. try
+	// again once it is
+	if ( ! ensureFilesLoaded() ) {
+		logTrace( g_conf.m_logTraceRdbBase, "END, files not loaded yet" );
+		return false;
+	}
+
 	// remember niceness for calling g_merge.merge()
 	m_niceness = niceness;
 
@@ -2259,6 +2676,8 @@ void RdbBase::selectFilesToMerge(int32_t mergeFileCount, int32_t numFiles, int32
 // . used by Indexdb.cpp to get the size of a list for IDF weighting purposes
 int64_t RdbBase::estimateListSize(const char *startKey, const char *endKey, char *maxKey,
 			          int64_t oldTruncationLimit) const {
+	// only the tree if the main thread gets here while loading the files
+	bool filesLoaded = const_cast<RdbBase*>(this)->ensureFilesLoaded();
 	// . reset this to low points
 	// . this is on
 	KEYSET(maxKey,endKey,m_ks);
@@ -2266,7 +2685,7 @@ int64_t RdbBase::estimateListSize(const char *startKey, const char *endKey, char
 	// do some looping
 	char newGuy[MAX_KEY_BYTES];
 	int64_t totalBytes = 0;
-	for ( int32_t i = 0 ; i < m_numFiles ; i++ ) {
+	for ( int32_t i = 0 ; filesLoaded && i < m_numFiles ; i++ ) {
 		// the start and end pages for a page range
 		int32_t pg1 , pg2;
 		// get the start and end pages for this startKey/endKey
@@ -2335,6 +2754,7 @@ int64_t RdbBase::estimateListSize(const char *startKey, const char *endKey, char
 }
 
 int64_t RdbBase::estimateNumGlobalRecs() const {
+	const_cast<RdbBase*>(this)->ensureFilesLoaded();
 	return getNumTotalRecs() * g_hostdb.m_numShards;
 }
 
@@ -2342,7 +2762,8 @@ int64_t RdbBase::estimateNumGlobalRecs() const {
 int64_t RdbBase::getNumTotalRecs() const {
 	int64_t numPositiveRecs = 0;
 	int64_t numNegativeRecs = 0;
-	for ( int32_t i = 0 ; i < m_numFiles ; i++ ) {
+	// the maps may be being loaded
+	for ( int32_t i = 0 ; m_filesLoaded && i < m_numFiles ; i++ ) {
 		// skip even #'d files -- those are merge files
 		if ( (m_fileInfo[i].m_fileId & 0x01) == 0 ) continue;
 		numPositiveRecs += m_fileInfo[i].m_map->getNumPositiveRecs();
@@ -2617,6 +3038,32 @@ bool RdbBase::hasPendingGlobalIndexJob() {
 	return !m_globalIndexThreadQueue.isEmpty();
 }
 
+// . Elias-Fano encode a global index. The docId+delBit part of the keys are
+//   the values and the file index is the payload
+// . returns NULL if packing is disabled
+static packeddocids_ptr_t packGlobalIndex(const docids_t &docIdFileIndex) {
+	if (!g_conf.m_packRdbIndexes) {
+		return packeddocids_ptr_t();
+	}
+
+	uint64_t maxFilePos = 0;
+	for (auto key : docIdFileIndex) {
+		maxFilePos = std::max(maxFilePos, key & RdbBase::s_docIdFileIndex_filePosMask);
+	}
+	unsigned filePosBits = maxFilePos ? 64 - __builtin_clzll(maxFilePos) : 0;
+
+	std::shared_ptr<EliasFano> packed(new EliasFano);
+	packed->init(docIdFileIndex.size(),
+	             docIdFileIndex.empty() ? 0 : (docIdFileIndex.back() >> RdbBase::s_docIdFileIndex_docIdOffset),
+	             filePosBits);
+	for (auto key : docIdFileIndex) {
+		packed->append(key >> RdbBase::s_docIdFileIndex_docIdOffset, key & RdbBase::s_docIdFileIndex_filePosMask);
+	}
+	packed->finalize();
+
+	return packed;
+}
+
 void RdbBase::generateGlobalIndex(void *item) {
 	ThreadQueueItem *queueItem = static_cast<ThreadQueueItem*>(item);
 
@@ -2649,10 +3096,12 @@ void RdbBase::generateGlobalIndex(void *item) {
 	// free up used space
 	tmpDocIdFileIndex->shrink_to_fit();
 
+	packeddocids_ptr_t packedDocIdFileIndex = packGlobalIndex(*tmpDocIdFileIndex);
+
 	// replace with new index
 	ScopedLock sl(queueItem->m_base->m_mtxFileInfo);
 	ScopedLock sl2(queueItem->m_base->m_docIdFileIndexMtx);
-	queueItem->m_base->m_docIdFileIndex.swap(tmpDocIdFileIndex);
+	queueItem->m_base->swapGlobalIndex_unlocked(tmpDocIdFileIndex, packedDocIdFileIndex);
 
 	if (queueItem->m_markFileReadable) {
 		for (auto i = 0; i < queueItem->m_base->m_numFiles; ++i) {
@@ -2710,16 +3159,29 @@ void RdbBase::generateGlobalIndex() {
 	// free up used space
 	tmpDocIdFileIndex->shrink_to_fit();
 
+	packeddocids_ptr_t packedDocIdFileIndex = packGlobalIndex(*tmpDocIdFileIndex);
+
 	// replace with new index
 	ScopedLock sl2(m_docIdFileIndexMtx);
-	m_docIdFileIndex.swap(tmpDocIdFileIndex);
+	swapGlobalIndex_unlocked(tmpDocIdFileIndex, packedDocIdFileIndex);
+}
+
+void RdbBase::swapGlobalIndex_unlocked(docids_ptr_t docIdFileIndex, packeddocids_ptr_t packedDocIdFileIndex) {
+	if (packedDocIdFileIndex) {
+		// the packed index replaces the vector
+		m_docIdFileIndex.reset(new docids_t);
+	} else {
+		m_docIdFileIndex.swap(docIdFileIndex);
+	}
+	m_docIdFileIndexPacked.swap(packedDocIdFileIndex);
 }
 
 void RdbBase::printGlobalIndex() {
 	logf(LOG_TRACE, "db: global index");
 
-	auto globalIndex = getGlobalIndex();
-	for (auto key : *globalIndex) {
+	GlobalIndexIterator it(this);
+	uint64_t key;
+	while (it.next(&key)) {
 		logf(LOG_TRACE, "db: docId=%" PRId64" index=%" PRId64" isDel=%d key=%" PRIx64,
 		     key >> RdbBase::s_docIdFileIndex_docIdDelKeyOffset,
 		     key & RdbBase::s_docIdFileIndex_filePosMask,
@@ -2729,6 +3191,85 @@ void RdbBase::printGlobalIndex() {
 }
 
 docidsconst_ptr_t RdbBase::getGlobalIndex() {
+	ensureFilesLoaded();
+	ScopedLock sl(m_docIdFileIndexMtx);
+	if (!m_docIdFileIndexPacked) {
+		return m_docIdFileIndex;
+	}
+
+	packeddocids_ptr_t packedDocIdFileIndex = m_docIdFileIndexPacked;
+	sl.unlock();
+
+	docids_ptr_t docIdFileIndex(new docids_t);
+	packedDocIdFileIndex->decode(docIdFileIndex.get());
+	for (size_t i = 0; i < docIdFileIndex->size(); i++) {
+		(*docIdFileIndex)[i] = ((*docIdFileIndex)[i] << s_docIdFileIndex_docIdOffset) | packedDocIdFileIndex->getPayload(i);
+	}
+	return docIdFileIndex;
+}
+
+void RdbBase::getGlobalIndex(packeddocids_ptr_t *packed, docidsconst_ptr_t *plain) {
+	ensureFilesLoaded();
 	ScopedLock sl(m_docIdFileIndexMtx);
-	return m_docIdFileIndex;
+	*packed = m_docIdFileIndexPacked;
+	if (m_docIdFileIndexPacked) {
+		plain->reset();
+	} else {
+		*plain = m_docIdFileIndex;
+	}
+}
+
+RdbBase::GlobalIndexIterator::GlobalIndexIterator(RdbBase *base)
+	: m_packed()
+	, m_plain()
+	, m_packedIter(NULL)
+	, m_plainPos(0) {
+	base->getGlobalIndex(&m_packed, &m_plain);
+	m_packedIter = EliasFano::Iterator(m_packed.get());
+}
+
+bool RdbBase::GlobalIndexIterator::next(uint64_t *key) {
+	if (m_packed) {
+		uint64_t value;
+		uint64_t filePos;
+		if (!m_packedIter.next(&value, &filePos)) {
+			return false;
+		}
+		*key = (value << s_docIdFileIndex_docIdOffset) | filePos;
+		return true;
+	}
+
+	if (!m_plain || m_plainPos >= m_plain->size()) {
+		return false;
+	}
+	*key = (*m_plain)[m_plainPos++];
+	return true;
+}
+
+packeddocids_ptr_t RdbBase::getPackedGlobalIndex() {
+	ensureFilesLoaded();
+	ScopedLock sl(m_docIdFileIndexMtx);
+	return m_docIdFileIndexPacked;
+}
+
+int64_t RdbBase::getIndexMemAllocated() {
+	int64_t allocated = 0;
+	if (!m_useIndexFile) {
+		return allocated;
+	}
+
+	ScopedLock sl(m_mtxFileInfo);
+	for (int32_t i = 0; i < m_numFiles; i++) {
+		allocated += m_fileInfo[i].m_index->getMemUsed();
+	}
+	sl.unlock();
+
+	allocated += m_treeIndex.getMemUsed();
+
+	ScopedLock sl2(m_docIdFileIndexMtx);
+	allocated += m_docIdFileIndex->capacity() * sizeof((*m_docIdFileIndex)[0]);
+	if (m_docIdFileIndexPacked) {
+		allocated += m_docIdFileIndexPacked->getMemUsed();
+	}
+	return allocated;
 }
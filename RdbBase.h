@@ -32,10 +32,11 @@
 #include "GbThreadQueue.h"
 #include "rdbid_t.h"
 #include "GbMutex.h"
+#include <atomic>
 
 
 class RdbBuckets;
-class RdbTree;
+class RdbSkipList;
 class CollectionRec;
 
 class RdbBase {
@@ -65,7 +66,7 @@ class RdbBase {
 		    int32_t   pageSize        ,
 		    const char                *coll    ,
 		    collnum_t            collnum ,
-		    RdbTree             *tree    ,
+		    RdbSkipList         *tree    ,
 		    RdbBuckets          *buckets ,
 		    Rdb           *rdb    ,
 		    bool           useIndexFile);
@@ -89,12 +90,59 @@ class RdbBase {
 
 	void clearTreeIndex() { m_treeIndex.clear(); }
 
+	// . make sure the maps and indexes of our files are loaded. those of
+	//   a cold collection are not loaded at startup if
+	//   g_conf.m_lazyLoadColdCollections is set
+	// . they are loaded by the io threads. other threads wait for that,
+	//   the main thread does not
+	// . returns false if they are not loaded (yet)
+	bool ensureFilesLoaded();
+	bool areFilesLoaded() const { return m_filesLoaded; }
+
+	// time spent loading the maps and indexes of our files
+	int64_t getLoadTimeMs() const { return m_loadTimeMs; }
+	int32_t getNumFilesLoaded() const { return m_numFilesLoaded; }
+
+	// . bases set up between these two calls read the maps and indexes of
+	//   their files in parallel using the io threads. finishParallelLoad()
+	//   waits for all of them and logs how long it took per rdb
+	// . used at startup for all rdbs of all collections
+	static void beginParallelLoad();
+	static void finishParallelLoad();
+
 	collnum_t  getCollnum() const { return m_collnum; }
 
 	const char *getDbName() const { return m_dbname; }
 
+	// . if the global index is packed this decodes it into a new vector on
+	//   every call. lookups should use getPackedGlobalIndex() first, walks
+	//   should use GlobalIndexIterator
 	docidsconst_ptr_t getGlobalIndex();
 
+	// the global index as it is stored. one of them is set, the other NULL
+	void getGlobalIndex(packeddocids_ptr_t *packed, docidsconst_ptr_t *plain);
+
+	// walks the global index keys in order, packed or not, without copying
+	class GlobalIndexIterator {
+	public:
+		explicit GlobalIndexIterator(RdbBase *base);
+		// returns false when there are no more keys
+		bool next(uint64_t *key);
+	private:
+		packeddocids_ptr_t m_packed;
+		docidsconst_ptr_t m_plain;
+		EliasFano::Iterator m_packedIter;
+		size_t m_plainPos;
+	};
+
+	// . Elias-Fano packed global index (NULL unless g_conf.m_packRdbIndexes)
+	// . values are the docId+delBit part of the global index key
+	//   (key >> s_docIdFileIndex_docIdOffset), payloads are the file index
+	packeddocids_ptr_t getPackedGlobalIndex();
+
+	// heap memory used by the per-file and global indexes
+	int64_t getIndexMemAllocated();
+
 	// how much mem is allocated for our maps?
 	int64_t getMapMemAllocated() const;
 
@@ -204,6 +252,7 @@ private:
 		RdbIndex *m_index;
 		bool m_allowReads;
 		bool m_pendingGenerateIndex;
+		bool m_pendingLoad; //map and index not read yet
 	} m_fileInfo[MAX_RDB_FILES + 1];
 	int32_t m_numFiles;
 	mutable GbMutex m_mtxFileInfo;  //protects modification of m_fileInfo/m_numFiles
@@ -213,9 +262,13 @@ private:
 	// dddddddd dddddddd dddddddd dddddddd  d = docId
 	// dddddd.Z ........ ffffffff ffffffff  Z = delBit
 	//                                      f = fileIndex
+	// empty when m_docIdFileIndexPacked is set
 	docids_ptr_t m_docIdFileIndex;
+	packeddocids_ptr_t m_docIdFileIndexPacked;
 	GbMutex m_docIdFileIndexMtx;
 
+	void swapGlobalIndex_unlocked(docids_ptr_t docIdFileIndex, packeddocids_ptr_t packedDocIdFileIndex);
+
 public:
 	static bool initializeGlobalIndexThread();
 	static void finalizeGlobalIndexThread();
@@ -269,6 +322,21 @@ private:
 	}
 
 	bool cleanupAnyChrashedMerged();
+
+	struct FileLoad;
+	struct FileLoadJob;
+	void readFileMapAndIndex(FileLoad *job);
+	bool finishFileLoad(const FileLoad *job);
+	void prepareLoad();
+	bool loadPendingFiles();
+	void startLoad(bool finishInJobThread);
+	void loadJobDone();
+	bool finishLoad();
+	bool waitForLoad();
+	void finishLoading();
+	bool isColdCollection() const;
+	static void loadFileJob(void *state);
+	static void loadFileJobDone(void *state, job_exit_t exit_type);
 	bool loadFilesFromDir(const char *dirName, bool isInMergeDir);
 	bool fixNonfirstSpiderdbFiles();
 
@@ -307,7 +375,7 @@ private:
 	bool m_didRepair;
 
 	// for storing records in memory
-	RdbTree    *m_tree;  
+	RdbSkipList *m_tree;
 	RdbBuckets *m_buckets;
 
 	// index for in memory records
@@ -355,6 +423,21 @@ private:
 
 	void incrementOutstandingJobs();
 	bool decrementOustandingJobs();
+
+	// false while our files have not been loaded yet (startup/lazy load)
+	std::atomic<bool> m_filesLoaded;
+	int64_t m_loadTimeMs;
+	int32_t m_numFilesLoaded;
+
+	// a load of our files by startLoad() or loadPendingFiles()
+	GbMutex m_mtxLoad;
+	pthread_cond_t m_loadCond;
+	bool m_loading;
+	bool m_finishLoadInJobThread;
+	std::vector<FileLoad> m_fileLoads;
+	std::atomic<int32_t> m_numLoadJobsOutstanding;
+	int64_t m_loadStartMs;
+	int64_t m_loadDoneMs;
 };
 
 extern bool g_dumpMode;
@@ -1719,6 +1719,11 @@ bool RdbBucket::getList(RdbList* list, const char* startKey, const char* endKey,
 
 bool RdbBuckets::deleteNode(collnum_t collnum, const char *key) {
 	ScopedLock sl(m_mtx);
+	return deleteNode_unlocked(collnum, key);
+}
+
+bool RdbBuckets::deleteNode_unlocked(collnum_t collnum, const char *key) {
+	m_mtx.verify_is_locked();
 
 	int32_t i = getBucketNum_unlocked(collnum, key);
 
@@ -2013,9 +2018,9 @@ bool RdbBuckets::delColl_unlocked(collnum_t collnum) {
 	return true;
 }
 
-int32_t RdbBuckets::addTree(RdbTree *rt) {
+int32_t RdbBuckets::addTree(RdbSkipList *rt) {
 	ScopedLock sl(m_mtx);
-	ScopedLock sl2(rt->getLock());
+	ScopedWriteLock sl2(rt->getLock());
 
 	int32_t n = rt->getFirstNode_unlocked();
 	int32_t count = 0;
@@ -33,7 +33,7 @@
 
 class BigFile;
 class RdbList;
-class RdbTree;
+class RdbSkipList;
 class RdbBucket;
 
 class RdbBuckets {
@@ -55,6 +55,12 @@ public:
 
 	bool deleteNode(collnum_t collnum, const char *key);
 
+	// . for adding a batch of records with one lock acquisition, see
+	//   Rdb::addBatch()
+	GbMutex& getLock() { return m_mtx; }
+	bool addNode_unlocked(collnum_t collnum, const char *key, const char *data, int32_t dataSize);
+	bool deleteNode_unlocked(collnum_t collnum, const char *key);
+
 	int64_t estimateListSize(collnum_t collnum, const char *startKey, const char *endKey, char *minKey, char *maxKey) const;
 
 	bool collExists(collnum_t coll) const;
@@ -88,7 +94,7 @@ public:
 
 	//DEBUG
 	void verifyIntegrity();
-	int32_t addTree(RdbTree *rt);
+	int32_t addTree(RdbSkipList *rt);
 	void printBuckets(std::function<void(const char *, int32_t)> print_fn = nullptr);
 	void printBucketsStartEnd();
 
@@ -99,8 +105,6 @@ public:
 	bool loadBuckets(const char *dbname);
 
 private:
-	GbMutex& getLock() { return m_mtx; }
-
 	static void saveWrapper(void *state);
 	static void saveDoneWrapper(void *state, job_exit_t exit_type);
 
@@ -110,8 +114,6 @@ private:
 	bool selfTest_unlocked(bool thorough, bool core);
 	bool repair_unlocked();
 
-	bool addNode_unlocked(collnum_t collnum, const char *key, const char *data, int32_t dataSize);
-
 	bool getList_unlocked(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes, RdbList *list,
 	                      int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const;
 
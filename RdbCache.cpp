@@ -1,6 +1,7 @@
 #include "gb-include.h"
 
 #include <unistd.h>
+#include <sched.h>
 #include "JobScheduler.h"
 #include "RdbCache.h"
 #include "Collectiondb.h"
@@ -10,7 +11,6 @@
 #include "BigFile.h"
 #include "Spider.h"
 #include "File.h"
-#include "ScopedLock.h"
 #include "Sanity.h"
 #include "Conf.h"
 #include "Mem.h"
@@ -22,7 +22,22 @@ bool g_cacheWritesEnabled = true;
 static const int64_t m_maxColls = (1LL << (sizeof(collnum_t)*8));	// 65536
 
 
-RdbCache::RdbCache() : m_dbname(NULL) {
+RdbCache::RdbCache()
+  : m_dbname(NULL),
+    m_shards(NULL),
+    m_numShards(0),
+    m_seq(0),
+    m_writeDepth(0),
+    m_numPeekers(0),
+    m_numLockAcquires(0),
+    m_numLockContended(0),
+    m_lockWaitTime(0),
+    m_numLockFreeReads(0),
+    m_numLockFreeFallbacks(0),
+    m_numHits(0),
+    m_numMisses(0)
+{
+	m_shardDbname[0] = '\0';
 	m_totalBufSize = 0;
 	m_numBufs      = 0;
 	m_ptrs         = NULL;
@@ -50,13 +65,62 @@ RdbCache::RdbCache() : m_dbname(NULL) {
 
 RdbCache::~RdbCache ( ) {
 	reset ();
+	freeShards();
 	pthread_mutex_destroy(&m_mtx);
 }
 
 #define BUFSIZE (128*1024*1024)
 
+// don't split a cache into shards smaller than this
+#define MIN_SHARD_MEM (1024*1024)
+
+
+RdbCache::WriteScope::WriteScope ( RdbCache *cache ) : m_cache(cache) {
+	// odd means a writer is busy
+	if ( m_cache->m_writeDepth++ > 0 ) return;
+	uint32_t seq = m_cache->m_seq.load(std::memory_order_relaxed);
+	m_cache->m_seq.store(seq+1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+RdbCache::WriteScope::~WriteScope ( ) {
+	if ( --m_cache->m_writeDepth > 0 ) return;
+	uint32_t seq = m_cache->m_seq.load(std::memory_order_relaxed);
+	m_cache->m_seq.store(seq+1, std::memory_order_release);
+}
+
+void RdbCache::waitForPeekers ( ) {
+	if ( m_writeDepth <= 0 ) gbshutdownLogicError();
+	// pairs with the increment of m_numPeekers before m_seq is read in
+	// tryPeekRecord(). either it sees our odd m_seq or we see it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while ( m_numPeekers.load(std::memory_order_seq_cst) > 0 )
+		sched_yield();
+}
+
+
+void RdbCache::freeShards ( ) {
+	if ( ! m_shards ) return;
+	mdelete ( m_shards , sizeof(RdbCache) * m_numShards , "RdbCacheShard" );
+	delete [] m_shards;
+	m_shards    = NULL;
+	m_numShards = 0;
+}
+
+RdbCache *RdbCache::getShard ( const char *cacheKey ) {
+	// the shard's hash table uses the low bits of the same hash
+	uint32_t h = hash32 ( cacheKey , m_cks );
+	return &m_shards [ ( h >> 16 ) % (uint32_t)m_numShards ];
+}
+
 
 void RdbCache::reset ( ) {
+	// keep the shards, Msg3 re-inits its caches while they are in use
+	for ( int32_t i = 0 ; m_shards && i < m_numShards ; i++ )
+		m_shards[i].reset();
+
+	WriteScope ws(this);
+	waitForPeekers();
 
 	//if ( m_numBufs > 0 )
 	//	log("db: resetting record cache");
@@ -101,7 +165,11 @@ bool RdbCache::init ( int32_t  maxMem        ,
 		      bool  loadFromDisk  ,
 		      char  cacheKeySize  ,
 		      char  dataKeySize   ,
-		      int32_t  numPtrsMax    ) {
+		      int32_t  numPtrsMax    ,
+		      int32_t  numShards     ) {
+	// . the hash table and buffers are replaced below, keep peekRecord()
+	//   out until we're done
+	WriteScope ws(this);
 	// reset all
 	reset();
 	// watch out 
@@ -138,6 +206,11 @@ bool RdbCache::init ( int32_t  maxMem        ,
 	if ( th ==  robots                              ) maxMem = 0;
 	if ( th ==  others                              ) maxMem = 0;
 
+	// give each shard at least MIN_SHARD_MEM
+	if ( numShards > m_maxMem / MIN_SHARD_MEM )
+		numShards = m_maxMem / MIN_SHARD_MEM;
+	if ( numShards <= 1 ) freeShards();
+
 	// this is the fixed dataSize of all records in a list, not the
 	// fixed dataSize of a list itself. Note that.
 	m_fixedDataSize = fixedDataSize;
@@ -150,6 +223,44 @@ bool RdbCache::init ( int32_t  maxMem        ,
 	// if maxMem is zero just return true
 	if ( m_maxMem <= 0 ) return true;
 
+	// . split into shards. each is a regular cache with its own share of
+	//   the mem and recs
+	// . reuse them if the cache is re-inited with the same # of shards
+	if ( numShards > 1 ) {
+		if ( m_numShards != numShards ) {
+			freeShards();
+			try {
+				m_shards = new RdbCache[numShards];
+			} catch ( std::bad_alloc & ) {
+				g_errno = ENOMEM;
+				log(LOG_WARN, "db: Could not allocate %" PRId32" shards for cache for %s.",
+				    numShards, dbname);
+				return false;
+			}
+			mnew ( m_shards , sizeof(RdbCache) * numShards , "RdbCacheShard" );
+			m_numShards = numShards;
+		}
+		for ( int32_t i = 0 ; i < m_numShards ; i++ ) {
+			RdbCache *shard = &m_shards[i];
+			snprintf ( shard->m_shardDbname , sizeof(shard->m_shardDbname) ,
+				   "%s.%" PRId32 , dbname , i );
+			if ( ! shard->init ( m_maxMem / m_numShards ,
+					     fixedDataSize ,
+					     supportLists ,
+					     maxRecs / m_numShards ,
+					     useHalfKeys ,
+					     shard->m_shardDbname ,
+					     loadFromDisk ,
+					     cacheKeySize ,
+					     dataKeySize ,
+					     numPtrsMax > 0 ? numPtrsMax / m_numShards : -1 ) ) {
+				freeShards();
+				return false;
+			}
+		}
+		return true;
+	}
+
 	// assume no need to call convertCache()
 	m_convert = false;
 
@@ -229,24 +340,44 @@ bool RdbCache::init ( int32_t  maxMem        ,
 }
 
 
-int64_t RdbCache::getNumHits() const {
-	ScopedLock sl(const_cast<GbMutex&>(mtx_hits_misses));
-	return m_numHits;
+bool RdbCache::isInitialized ( ) const {
+	if ( m_shards ) return m_shards[0].isInitialized();
+	if ( m_ptrs ) return true;
+	return false;
 }
 
-int64_t RdbCache::getNumMisses() const {
-	ScopedLock sl(const_cast<GbMutex&>(mtx_hits_misses));
-	return m_numMisses;
-}
+// sum a stat over the shards if we have them
+#define SUM_SHARDS(type,getter,member) \
+	type RdbCache::getter() const { \
+		if ( ! m_shards ) return member; \
+		type sum = 0; \
+		for ( int32_t i = 0 ; i < m_numShards ; i++ ) \
+			sum += m_shards[i].getter(); \
+		return sum; \
+	}
+
+SUM_SHARDS(int32_t,getMemOccupied,m_memOccupied)
+SUM_SHARDS(int32_t,getMemAllocated,m_memAllocated)
+SUM_SHARDS(int64_t,getNumHits,m_numHits.load(std::memory_order_relaxed))
+SUM_SHARDS(int64_t,getNumMisses,m_numMisses.load(std::memory_order_relaxed))
+SUM_SHARDS(int32_t,getNumUsedNodes,m_numPtrsUsed)
+SUM_SHARDS(int32_t,getNumTotalNodes,m_numPtrsMax)
+SUM_SHARDS(int64_t,getNumAdds,m_adds)
+SUM_SHARDS(int64_t,getNumDeletes,m_deletes)
+SUM_SHARDS(int64_t,getNumLockAcquires,m_numLockAcquires.load(std::memory_order_relaxed))
+SUM_SHARDS(int64_t,getNumLockContended,m_numLockContended.load(std::memory_order_relaxed))
+SUM_SHARDS(int64_t,getLockWaitTime,m_lockWaitTime.load(std::memory_order_relaxed))
+SUM_SHARDS(int64_t,getNumLockFreeReads,m_numLockFreeReads.load(std::memory_order_relaxed))
+SUM_SHARDS(int64_t,getNumLockFreeFallbacks,m_numLockFreeFallbacks.load(std::memory_order_relaxed))
+
+#undef SUM_SHARDS
 
 void RdbCache::incrementHits() {
-	ScopedLock sl(mtx_hits_misses);
-	m_numHits++;
+	m_numHits.fetch_add(1, std::memory_order_relaxed);
 }
 
 void RdbCache::incrementMisses() {
-	ScopedLock sl(mtx_hits_misses);
-	m_numMisses++;
+	m_numMisses.fetch_add(1, std::memory_order_relaxed);
 }
 
 
@@ -291,9 +422,7 @@ int64_t RdbCache::getLongLong2 ( collnum_t collnum ,
 				  bool promoteRecord ) {
 	char *rec;
 	int32_t  recSize;
-	key96_t k;
-	k.n0 = (uint64_t)key;
-	k.n1 = 0;
+	key96_t k = getLongLong2Key ( key );
 	// sanity check
 	if ( m_cks != 8 ) gbshutdownLogicError();
 	if ( m_dks != 0 ) gbshutdownLogicError();
@@ -316,13 +445,30 @@ int64_t RdbCache::getLongLong2 ( collnum_t collnum ,
 	// otherwise, it was found and the right length, so return it
 	return *(int64_t *)rec;
 }
+
+int64_t RdbCache::peekLongLong2 ( collnum_t collnum ,
+				  uint64_t key , int32_t maxAge ) {
+	key96_t k = getLongLong2Key ( key );
+	// sanity check
+	if ( m_cks != 8 ) gbshutdownLogicError();
+	if ( m_dks != 0 ) gbshutdownLogicError();
+	int64_t value;
+	int32_t recSize;
+	if ( ! peekRecord ( collnum , (char *)&k , (char *)&value ,
+			    sizeof(value) , &recSize , maxAge , true ) )
+		return -1LL;
+	if ( recSize != 8 ) {
+		log(LOG_LOGIC,"db: cache: Bad engineer. RecSize = %" PRId32".",
+		    recSize);
+		return -1LL;
+	}
+	return value;
+}
 	
 // this puts a int32_t in there
 void RdbCache::addLongLong2 ( collnum_t collnum ,
 			      uint64_t key , int64_t value ) {
-	key96_t k;
-	k.n0 = (uint64_t)key;
-	k.n1 = 0;
+	key96_t k = getLongLong2Key ( key );
 	// sanity check
 	if ( m_cks != 8 ) gbshutdownLogicError();
 	if ( m_dks != 0 ) gbshutdownLogicError();
@@ -427,6 +573,11 @@ bool RdbCache::getRecord ( collnum_t collnum   ,
 			   bool     incCounts  ,
 			   time_t  *cachedTime ,
 			   bool     promoteRecord ) {
+	if ( m_shards )
+		return getShard(cacheKey)->getRecord ( collnum , cacheKey , rec ,
+						       recSize , doCopy , maxAge ,
+						       incCounts , cachedTime ,
+						       promoteRecord );
 	// maxAge of 0 means don't check cache
 	if ( maxAge == 0 ) return false;
 	// bail if no cache
@@ -521,22 +672,9 @@ bool RdbCache::getRecord ( collnum_t collnum   ,
 	// sanity check
 	if ( m_tail < 0 || m_tail > m_totalBufSize )
 		gbshutdownLogicError();
-	// get the window of promotion
-	int32_t  tenPercent = (int32_t)(((float)m_totalBufSize) * .10);
-	char *start1     = m_bufs[0] + m_tail ;
-	char *end1       = start1 + tenPercent;
-	char *start2     = NULL;
-	char *end2       = NULL;
-	char *max        = m_bufs[0] + m_totalBufSize;
-	if ( end1 > max ) {
-		start2 = m_bufs[0];
-		end2   = start2 + (end1 - max);
-		end1   = max;
-	}
 	// are we in 10% range? if so, promote to head of the ring buffer
 	// to avoid losing it in a delete operation
-	if ( check && *rec >= start1 && *rec <= end1 ) promoteRecord = true;
-	if ( check && *rec >= start2 && *rec <= end2 ) promoteRecord = true;
+	if ( check && isNearTail ( *rec ) ) promoteRecord = true;
 	// debug
 	//if ( check )
 	//	logf(LOG_DEBUG,
@@ -578,6 +716,159 @@ bool RdbCache::getRecord ( collnum_t collnum   ,
 	return true;
 }
 
+bool RdbCache::isNearTail ( const char *rec ) const {
+	// get the window of promotion
+	int32_t  tenPercent = (int32_t)(((float)m_totalBufSize) * .10);
+	const char *start1 = m_bufs[0] + m_tail ;
+	const char *end1   = start1 + tenPercent;
+	const char *start2 = NULL;
+	const char *end2   = NULL;
+	const char *max    = m_bufs[0] + m_totalBufSize;
+	if ( end1 > max ) {
+		start2 = m_bufs[0];
+		end2   = start2 + (end1 - max);
+		end1   = max;
+	}
+	if ( rec >= start1 && rec <= end1 ) return true;
+	if ( rec >= start2 && rec <= end2 ) return true;
+	return false;
+}
+
+bool RdbCache::isAlmostFull ( ) const {
+	if ( m_numPtrsUsed >= m_threshold - m_threshold / 10 ) return true;
+	if ( m_memOccupied >= m_totalBufSize - m_totalBufSize / 10 ) return true;
+	return false;
+}
+
+bool RdbCache::isInBufs ( const char *p , int32_t size ) const {
+	for ( int32_t i = 0 ; i < m_numBufs ; i++ ) {
+		if ( p >= m_bufs[i] && size >= 0 &&
+		     p + size <= m_bufs[i] + m_bufSizes[i] )
+			return true;
+	}
+	return false;
+}
+
+bool RdbCache::peekRecord ( collnum_t collnum   ,
+			    const char *cacheKey ,
+			    char    *buf        ,
+			    int32_t  bufSize    ,
+			    int32_t *recSize    ,
+			    int32_t  maxAge     ,
+			    bool     incCounts  ,
+			    time_t  *cachedTime ) {
+	if ( m_shards )
+		return getShard(cacheKey)->peekRecord ( collnum , cacheKey , buf ,
+							bufSize , recSize , maxAge ,
+							incCounts , cachedTime );
+	// maxAge of 0 means don't check cache
+	if ( maxAge == 0 ) return false;
+
+	// a writer that gets in the way twice is probably adding a lot, so
+	// just wait for it
+	for ( int32_t i = 0 ; i < 2 ; i++ ) {
+		int32_t status = tryPeekRecord ( collnum , cacheKey , buf , bufSize ,
+						 recSize , maxAge , cachedTime );
+		// bail if no cache
+		if ( status == -2 ) return false;
+		if ( status < 0 ) continue;
+		m_numLockFreeReads.fetch_add(1, std::memory_order_relaxed);
+		if ( incCounts ) {
+			if ( status ) incrementHits();
+			else          incrementMisses();
+		}
+		return status == 1;
+	}
+
+	m_numLockFreeFallbacks.fetch_add(1, std::memory_order_relaxed);
+	RdbCacheLock rcl(*this);
+	char *rec;
+	int32_t size;
+	if ( ! getRecord ( collnum , cacheKey , &rec , &size , false , maxAge ,
+			   incCounts , cachedTime ) )
+		return false;
+	if ( size > bufSize ) return false;
+	gbmemcpy ( buf , rec , size );
+	*recSize = size;
+	return true;
+}
+
+// . everything we read may be changed under us by a writer, so check every
+//   ptr before following it and validate the copy against m_seq at the end
+int32_t RdbCache::tryPeekRecord ( collnum_t collnum, const char *cacheKey,
+				  char *buf, int32_t bufSize, int32_t *recSize,
+				  int32_t maxAge, time_t *cachedTime ) {
+	// . announce ourselves before checking m_seq so reset()/init()/load()
+	//   wait for us before freeing what we follow, see waitForPeekers()
+	m_numPeekers.fetch_add(1, std::memory_order_seq_cst);
+	int32_t status = tryPeekRecord_unlocked ( collnum , cacheKey , buf ,
+						  bufSize , recSize , maxAge ,
+						  cachedTime );
+	m_numPeekers.fetch_sub(1, std::memory_order_release);
+	return status;
+}
+
+int32_t RdbCache::tryPeekRecord_unlocked ( collnum_t collnum, const char *cacheKey,
+					   char *buf, int32_t bufSize, int32_t *recSize,
+					   int32_t maxAge, time_t *cachedTime ) {
+	uint32_t seq = m_seq.load(std::memory_order_seq_cst);
+	if ( seq & 1 ) return -1;
+
+	// the table can only be replaced in a WriteScope, so these are
+	// consistent with each other if m_seq is still "seq" at the end
+	char **ptrs = m_ptrs;
+	int32_t numPtrsMax = m_numPtrsMax;
+	if ( numPtrsMax <= 0 || ! ptrs ) {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ( m_seq.load(std::memory_order_relaxed) != seq ) return -1;
+		return -2;
+	}
+
+	// collnum, key, timestamp
+	int32_t headerSize = sizeof(collnum_t) + m_cks + 4;
+	bool hasDataSize = ( m_fixedDataSize == -1 || m_supportLists );
+	if ( hasDataSize ) headerSize += 4;
+
+	int32_t n = hash32 ( cacheKey , m_cks ) % numPtrsMax;
+	const char *p = NULL;
+	for ( int32_t probes = 0 ; probes < numPtrsMax ; probes++ ) {
+		const char *ptr = ptrs[n];
+		if ( ! ptr ) break;
+		if ( ! isInBufs ( ptr , headerSize ) ) return -1;
+		if ( *(const collnum_t *)ptr == collnum &&
+		     KEYCMP(ptr+sizeof(collnum_t),cacheKey,m_cks) == 0 ) {
+			p = ptr;
+			break;
+		}
+		if ( ++n >= numPtrsMax ) n = 0;
+	}
+
+	int32_t status = 0;
+	if ( p ) {
+		int32_t timestamp = *(const int32_t *)(p + sizeof(collnum_t) + m_cks);
+		int32_t dataSize = hasDataSize ? *(const int32_t *)(p + headerSize - 4) : m_fixedDataSize;
+		const char *data = p + headerSize;
+		if ( dataSize < 0 || ! isInBufs ( p , headerSize + dataSize ) )
+			return -1;
+		// . leave it to getRecord() to promote it before it's overwritten
+		// . nothing is overwritten until we run out of slots or buffer
+		//   space, everything is near the tail until then
+		if ( isNearTail ( p ) && isAlmostFull() ) return -1;
+		if ( maxAge > 0 && getTimeLocal() - timestamp > maxAge ) {
+			status = 0;
+		} else if ( dataSize <= bufSize ) {
+			gbmemcpy ( buf , data , dataSize );
+			*recSize = dataSize;
+			if ( cachedTime ) *cachedTime = timestamp;
+			status = 1;
+		}
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if ( m_seq.load(std::memory_order_relaxed) != seq ) return -1;
+	return status;
+}
+
 
 // . returns true if found, 
 // . returns false if not found or on error
@@ -710,6 +1001,11 @@ bool RdbCache::addRecord ( collnum_t collnum ,
 			   int32_t   recSize2  ,
 			   int32_t   timestamp ,
 			   char **retRecPtr ) {
+	if ( m_shards )
+		return getShard(cacheKey)->addRecord ( collnum , cacheKey ,
+						       rec1 , recSize1 ,
+						       rec2 , recSize2 ,
+						       timestamp , retRecPtr );
 
 	// bail if cache empty. maybe m_maxMem is 0.
 	if ( m_totalBufSize <= 0 ) return true;
@@ -762,6 +1058,9 @@ bool RdbCache::addRecord ( collnum_t collnum ,
 		return false;
 	}
 
+	// peekRecord() must not trust what it reads from here on
+	WriteScope ws(this);
+
 	// if too many slots in hash table used free one up
 	while ( m_numPtrsUsed >= m_threshold ) {
 		if ( ! deleteRec() ) {
@@ -1160,6 +1459,10 @@ void RdbCache::clear ( collnum_t collnum ) {
 	// bail if no writing ops allowed now
 	if ( ! g_cacheWritesEnabled ) gbshutdownLogicError();
 
+	for ( int32_t i = 0 ; m_shards && i < m_numShards ; i++ )
+		m_shards[i].clear ( collnum );
+
+	WriteScope ws(this);
 	for ( int32_t i = 0 ; i < m_numPtrsMax ; i++ ) {
 		// skip if empty bucket
 		if ( ! m_ptrs[i] ) continue;
@@ -1186,6 +1489,9 @@ bool RdbCache::save () {
 		return true;
 	}
 
+	for ( int32_t i = 0 ; m_shards && i < m_numShards ; i++ )
+		m_shards[i].save();
+
 	// if we do not need it, don't bother
 	if ( ! m_needsSave ) {
 		return true;
@@ -1367,6 +1673,8 @@ bool RdbCache::load ( const char *dbname ) {
 	// log
 	log(LOG_INIT,"db: Loading cache from %s/%s.cache",
 	     g_hostdb.m_dir,dbname);
+	// keep peekRecord() out while the hash table and buffers are replaced
+	WriteScope ws(this);
 	// clear everything
 	reset();
 	int n;
@@ -1557,6 +1865,8 @@ bool RdbCache::convertCache ( int32_t numPtrsMax , int32_t maxMem ) {
 // goes through all the pointers and checks the integrity of the data they 
 // point to. Also checks if m_tail is pointing right or not
 void RdbCache::verify(){
+	 for ( int32_t i = 0 ; m_shards && i < m_numShards ; i++ )
+		 m_shards[i].verify();
 	 bool foundTail = false;
 	 int32_t count = 0;
 	 logf(LOG_DEBUG,"db: cachebug: verifying");
@@ -1610,11 +1920,40 @@ void RdbCache::verify(){
 
 
 
+void RdbCache::lockCache() {
+	if(pthread_mutex_trylock(&m_mtx)!=0) {
+		uint64_t start = gettimeofdayInMicroseconds();
+		pthread_mutex_lock(&m_mtx);
+		m_numLockContended.fetch_add(1, std::memory_order_relaxed);
+		m_lockWaitTime.fetch_add(gettimeofdayInMicroseconds()-start, std::memory_order_relaxed);
+	}
+	m_numLockAcquires.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RdbCache::unlockCache() {
+	pthread_mutex_unlock(&m_mtx);
+}
+
+
 RdbCacheLock::RdbCacheLock(RdbCache &rdc_)
   : rdc(rdc_),
+    shard(NULL),
+    locked(true)
+{
+	if(rdc.m_shards) {
+		//always in the same order so we can't deadlock with another whole-cache lock
+		for(int32_t i=0; i<rdc.m_numShards; i++)
+			rdc.m_shards[i].lockCache();
+	} else
+		rdc.lockCache();
+}
+
+RdbCacheLock::RdbCacheLock(RdbCache &rdc_, const char *cacheKey)
+  : rdc(rdc_),
+    shard(rdc_.m_shards ? rdc_.getShard(cacheKey) : &rdc_),
     locked(true)
 {
-	pthread_mutex_lock(&rdc.m_mtx);
+	shard->lockCache();
 }
 
 RdbCacheLock::~RdbCacheLock() {
@@ -1623,7 +1962,13 @@ RdbCacheLock::~RdbCacheLock() {
 
 void RdbCacheLock::unlock() {
 	if(locked) {
-		pthread_mutex_unlock(&rdc.m_mtx);
+		if(shard)
+			shard->unlockCache();
+		else if(rdc.m_shards) {
+			for(int32_t i=rdc.m_numShards-1; i>=0; i--)
+				rdc.m_shards[i].unlockCache();
+		} else
+			rdc.unlockCache();
 		locked = false;
 	}
 }
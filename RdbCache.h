@@ -27,6 +27,13 @@
 //   list takes like 2.4ms on a new pentium, so we should allow regular
 //   allocating if the record size is 256k or more. Copying 256k only
 //   takes .1 ms on the P4 2.60CGHz. This is on the TODO list.
+// . a cache can be split into shards when it is initialized. the records are
+//   then hashed by key into independent child caches, each with its own
+//   buffers, hash table and mutex, so lookups of different keys do not wait
+//   for each other
+// . small records can be read without the lock with peekRecord(). it copies
+//   the record out and retries (and finally takes the lock) if a writer
+//   touched the shard in the meantime
 
 #ifndef GB_RDBCACHE_H
 #define GB_RDBCACHE_H
@@ -41,8 +48,10 @@
 //   and free the tailing memory buffer to make room for a large unbuffered rec
 //#define MEM_LIMIT (256*1024)
 
+#include "types.h"
 #include "JobScheduler.h" //job_exit_t
 #include <time.h>       // time_t
+#include <atomic>
 #include "GbMutex.h"
 
 class RdbList;
@@ -66,15 +75,15 @@ class RdbCache {
 	//   clear out the collection's stuff in the cache
 	void clear ( collnum_t collnum ) ;
 
-	bool isInitialized () const { 
-		if ( m_ptrs ) return true; 
-		return false;
-	}
+	bool isInitialized () const;
 
 	// . we are allowed to keep a min mem of "minCacheSize"
 	// . a fixedDataSize of -1 means the dataSize varies from rec to rec
 	// . set "maxNumNodes" to -1 for it to be auto determined
 	// . can only do this if fixedDataSize is not -1
+	// . "numShards" splits the memory and records evenly over that many
+	//   independently locked child caches. it is lowered if the shards
+	//   would get less than 1MB each
 	bool init ( int32_t maxCacheMem   , 
 		    int32_t fixedDataSize , 
 		    bool supportLists  ,
@@ -84,7 +93,8 @@ class RdbCache {
 		    bool  loadFromDisk ,
 		    char  cacheKeySize = 12 ,
 		    char  dataKeySize  = 12 ,
-		    int32_t  numPtrsMax   = -1 );
+		    int32_t  numPtrsMax   = -1 ,
+		    int32_t  numShards    = 1 );
 
 	// . a quick hack for SpiderCache.cpp
 	// . if your record is always a 4 byte int32_t call this
@@ -108,6 +118,20 @@ class RdbCache {
         void addLongLong2 ( collnum_t collnum ,
 			   uint64_t key , int64_t value ) ;
 
+	// the cache key getLongLong2()/addLongLong2() use for "key", so the
+	// caller can take a RdbCacheLock for just that key
+	static key96_t getLongLong2Key ( uint64_t key ) {
+		key96_t k;
+		k.n0 = key;
+		k.n1 = 0;
+		return k;
+	}
+
+	// . getLongLong2() without holding the lock, see peekRecord()
+	// . returns -1 if not found
+	int64_t peekLongLong2 ( collnum_t collnum , uint64_t key ,
+				int32_t maxAge );
+
 	// same routines for int32_ts now, but key is a int64_t
 	int32_t getLong ( collnum_t collnum ,
 		       uint64_t key , int32_t maxAge , // in seconds
@@ -165,6 +189,22 @@ class RdbCache {
 				  maxAge,incCounts,cachedTime, promoteRecord);
 	}
 
+	// . like getRecord() but the caller must NOT hold the lock
+	// . copies the record into "buf" and sets *recSize. records that do
+	//   not fit in "bufSize" bytes are treated as not found
+	// . reads the shard optimistically without locking it. if a writer
+	//   changed the shard while we were reading, or the record is about to
+	//   be overwritten and has to be promoted, it falls back to a locked
+	//   getRecord()
+	bool peekRecord ( collnum_t collnum   ,
+			  const char *cacheKey ,
+			  char    *buf        ,
+			  int32_t  bufSize    ,
+			  int32_t *recSize    ,
+			  int32_t  maxAge     , // in seconds
+			  bool     incCounts  ,
+			  time_t  *cachedTime = NULL );
+
 	// . returns true if found, false if not found
 	// . sets errno no error
 	// . if "copyRecords" is true then COPIES into a new buffer
@@ -231,24 +271,28 @@ class RdbCache {
 
 	void verify();
 
-	// these include our mem AND our tree's mem combined
-	int32_t getMemOccupied () const {
-		return m_memOccupied ;
-	}
-
-	int32_t getMemAllocated() const {
-		return m_memAllocated;
-	}
+	// . these include our mem AND our tree's mem combined
+	// . the stats of a sharded cache are summed over the shards
+	int32_t getMemOccupied () const;
+	int32_t getMemAllocated() const;
 
 	int32_t getMaxMem      () const { return m_maxMem; }
 
 	// cache stats
 	int64_t getNumHits() const;
 	int64_t getNumMisses() const;
-	int32_t getNumUsedNodes  () const { return m_numPtrsUsed; }
-	int32_t getNumTotalNodes () const { return m_numPtrsMax ; }
-	int64_t getNumAdds() const { return m_adds; }
-	int64_t getNumDeletes() const { return m_deletes; }
+	int32_t getNumUsedNodes  () const;
+	int32_t getNumTotalNodes () const;
+	int64_t getNumAdds() const;
+	int64_t getNumDeletes() const;
+
+	// lock contention stats
+	int32_t getNumShards() const { return m_shards ? m_numShards : 1; }
+	int64_t getNumLockAcquires() const;
+	int64_t getNumLockContended() const; // had to wait for the lock
+	int64_t getLockWaitTime() const;     // microseconds spent waiting
+	int64_t getNumLockFreeReads() const; // peekRecord() without the lock
+	int64_t getNumLockFreeFallbacks() const; // peekRecord() had to lock
 
 	bool useDisk ( ) const { return m_useDisk; }
 	bool load ( const char *dbname );
@@ -295,11 +339,76 @@ private:
 	void incrementHits();
 	void incrementMisses();
 
+	// the shard "cacheKey" belongs to
+	RdbCache *getShard ( const char *cacheKey ) ;
+	void freeShards ( );
+
+	// . is "rec" in the 10% of the ring buffer that will be overwritten
+	//   next? we only promote those records
+	bool isNearTail ( const char *rec ) const;
+	// are we about to overwrite records to make room?
+	bool isAlmostFull ( ) const;
+	// is [p,p+size) inside one of our buffers?
+	bool isInBufs ( const char *p , int32_t size ) const;
+	// . 1 if found, 0 if not found, -1 if we raced with a writer, -2 if
+	//   there is no hash table
+	int32_t tryPeekRecord ( collnum_t collnum, const char *cacheKey,
+				char *buf, int32_t bufSize, int32_t *recSize,
+				int32_t maxAge, time_t *cachedTime );
+	int32_t tryPeekRecord_unlocked ( collnum_t collnum, const char *cacheKey,
+					 char *buf, int32_t bufSize, int32_t *recSize,
+					 int32_t maxAge, time_t *cachedTime );
+
+	// . marks the records and hash table as being changed for as long as
+	//   it exists, see m_seq. scopes can nest
+	class WriteScope {
+	public:
+		explicit WriteScope ( RdbCache *cache );
+		~WriteScope ( );
+	private:
+		WriteScope ( const WriteScope & );
+		WriteScope &operator= ( const WriteScope & );
+		RdbCache *m_cache;
+	};
+
+	// . tryPeekRecord() follows m_ptrs and m_bufs without the lock, so
+	//   they must not be freed or replaced under it. in a WriteScope this
+	//   waits until the peeks that started before it are done. later ones
+	//   see the odd m_seq and don't touch them
+	void waitForPeekers ( );
+
+	// lock m_mtx and keep the contention stats
+	void lockCache ( );
+	void unlockCache ( );
+
 	bool m_convert;
 	int32_t m_convertNumPtrsMax;
 	int32_t m_convertMaxMem;
 
 	pthread_mutex_t m_mtx; //big fat mutex protecting everything
+
+	// . a sharded cache keeps no records itself. they are all in one of
+	//   the m_numShards child caches which are set up like we are
+	RdbCache *m_shards;
+	int32_t   m_numShards;
+	// dbname of a child cache, "<parent dbname>.<shard #>"
+	char      m_shardDbname[64];
+
+	// . sequence number of the records and hash table. odd while a writer
+	//   (who holds m_mtx) is changing them, so peekRecord() can tell if what
+	//   it read without the lock is consistent
+	std::atomic<uint32_t> m_seq;
+	// nesting depth of WriteScopes. writers only
+	int32_t m_writeDepth;
+	// # of tryPeekRecord() calls in progress
+	std::atomic<int32_t> m_numPeekers;
+
+	// lock contention stats
+	std::atomic<int64_t> m_numLockAcquires;
+	std::atomic<int64_t> m_numLockContended;
+	std::atomic<int64_t> m_lockWaitTime;
+	std::atomic<int64_t> m_numLockFreeReads;
+	std::atomic<int64_t> m_numLockFreeFallbacks;
 	
 	int32_t m_errno;
 
@@ -335,9 +444,8 @@ private:
 	char m_memoryLabelBufs[128];
 
 	// cache hits and misses
-	int64_t m_numHits; // includes partial hits & cached not-founds too
-	int64_t m_numMisses;
-	GbMutex mtx_hits_misses; //mutex protecting just hits&misses
+	std::atomic<int64_t> m_numHits; // includes partial hits & cached not-founds too
+	std::atomic<int64_t> m_numMisses;
 
 	int32_t m_fixedDataSize;
 	bool m_supportLists;
@@ -368,9 +476,13 @@ class RdbCacheLock {
 	RdbCacheLock(const RdbCacheLock&);
 	RdbCacheLock& operator=(const RdbCacheLock&);
 	RdbCache &rdc;
+	RdbCache *shard; //the shard we locked, NULL if we locked all of them
 	bool locked;
 public:
+	//lock the whole cache
 	RdbCacheLock(RdbCache &rdc_);
+	//lock only what is needed to get/add the record with "cacheKey"
+	RdbCacheLock(RdbCache &rdc_, const char *cacheKey);
 	~RdbCacheLock();
 	void unlock();
 };
@@ -50,7 +50,7 @@ RdbDump::RdbDump() {
 bool RdbDump::set(collnum_t collnum,
                   BigFile *file,
                   RdbBuckets *buckets, // optional buckets to dump
-                  RdbTree *tree, // optional tree to dump
+                  RdbSkipList *tree, // optional tree to dump
                   RdbMap *map,
                   RdbIndex *index,
                   int32_t maxBufSize,
@@ -212,6 +212,11 @@ void RdbDump::doneDumping() {
 
 	if (m_index) {
 		m_index->writeIndex(true);
+
+		// the dumped file is final now
+		if (g_conf.m_packRdbIndexes) {
+			m_index->packDocIds();
+		}
 	}
 #ifdef GBSANITYCHECK
 	// sanity check
@@ -14,7 +14,7 @@
 #include "RdbList.h"
 
 class Rdb;
-class RdbTree;
+class RdbSkipList;
 class RdbBuckets;
 class RdbMap;
 class RdbIndex;
@@ -30,7 +30,7 @@ public:
 	bool set(collnum_t collnum,
 	         BigFile *file,
 	         RdbBuckets *buckets, // optional buckets to dump
-	         RdbTree *tree, // optional tree to dump
+	         RdbSkipList *tree, // optional tree to dump
 	         RdbMap *map,
 	         RdbIndex *index,
 	         int32_t maxBufSize,
@@ -73,7 +73,7 @@ private:
 	bool doneDumpingList();
 	void continueDumping();
 
-	RdbTree *m_tree;
+	RdbSkipList *m_tree;
 	RdbBuckets *m_buckets;
 	RdbMap *m_map;
 	RdbIndex *m_index;
@@ -8,7 +8,7 @@
 #include <set>
 #include <unordered_set>
 #include <algorithm>
-#include "RdbTree.h"
+#include "RdbSkipList.h"
 #include "RdbBuckets.h"
 #include "JobScheduler.h"
 #include "ScopedLock.h"
@@ -35,6 +35,7 @@ RdbIndex::RdbIndex()
 	, m_rdbId(RDB_NONE)
 	, m_version(s_rdbIndexCurrentVersion)
 	, m_docIds(new docids_t)
+	, m_packedDocIds()
 	, m_docIdsMtx()
 	, m_pendingMergeMtx()
 	, m_pendingMergeCond(PTHREAD_COND_INITIALIZER)
@@ -65,6 +66,7 @@ void RdbIndex::reset(bool isStatic) {
 
 	/// @todo ALC do we need to lock here?
 	m_docIds.reset(new docids_t);
+	m_packedDocIds.reset();
 
 	m_pendingDocIds.reset(new docids_t);
 	if (!isStatic) {
@@ -80,7 +82,7 @@ void RdbIndex::reset(bool isStatic) {
 void RdbIndex::clear() {
 	ScopedLock sl(m_pendingDocIdsMtx);
 
-	m_docIds.reset(new docids_t);
+	swapDocIds(docidsconst_ptr_t(new docids_t));
 	m_pendingDocIds.reset(new docids_t);
 	m_pendingDocIds->reserve(m_generatingIndex ? s_generateReserveSize : s_defaultReserveSize);
 
@@ -344,7 +346,8 @@ docidsconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
 
 	// don't need to merge when there are no pending docIds
 	// except when it's forWrite then we need to free memory from vector
-	if (!finalWrite && m_pendingDocIds->empty()) {
+	// (packed docids are already as small as they get)
+	if (m_pendingDocIds->empty() && (!finalWrite || isPacked())) {
 		logTrace(g_conf.m_logTraceRdbIndex, "END %s[%p]", m_file.getFilename(), this);
 		return getDocIds();
 	}
@@ -455,7 +458,7 @@ void RdbIndex::addList(RdbList *list) {
 	}
 }
 
-bool RdbIndex::generateIndex(collnum_t collnum, const RdbTree *tree) {
+bool RdbIndex::generateIndex(collnum_t collnum, const RdbSkipList *tree) {
 	reset(false);
 
 	if (g_conf.m_readOnlyMode) {
@@ -723,16 +726,45 @@ bool RdbIndex::generateIndex(BigFile *f) {
 
 docidsconst_ptr_t RdbIndex::getDocIds() {
 	ScopedLock sl(m_docIdsMtx);
-	return m_docIds;
+	if (!m_packedDocIds) {
+		return m_docIds;
+	}
+
+	packeddocids_ptr_t packedDocIds = m_packedDocIds;
+	sl.unlock();
+
+	docids_ptr_t docIds(new docids_t);
+	packedDocIds->decode(docIds.get());
+	return docIds;
+}
+
+size_t RdbIndex::getNumDocIds() {
+	ScopedLock sl(m_docIdsMtx);
+	if (m_packedDocIds) {
+		return m_packedDocIds->size();
+	}
+	return m_docIds->size();
 }
 
 bool RdbIndex::exist(uint64_t docId) {
 	ScopedLock sl(m_pendingDocIdsMtx);
 
-	auto docIds = getDocIds();
-	auto it = std::lower_bound(docIds->cbegin(), docIds->cend(), docId << RdbIndex::s_docIdOffset);
-	if (it != docIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId)) {
-		return true;
+	ScopedLock sl2(m_docIdsMtx);
+	packeddocids_ptr_t packedDocIds = m_packedDocIds;
+	docidsconst_ptr_t docIds = m_docIds;
+	sl2.unlock();
+
+	if (packedDocIds) {
+		uint64_t key;
+		if (packedDocIds->lowerBound(docId << RdbIndex::s_docIdOffset, &key) < packedDocIds->size() &&
+		    ((key >> RdbIndex::s_docIdOffset) == docId)) {
+			return true;
+		}
+	} else {
+		auto it = std::lower_bound(docIds->cbegin(), docIds->cend(), docId << RdbIndex::s_docIdOffset);
+		if (it != docIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId)) {
+			return true;
+		}
 	}
 
 	auto cmplt_fn = [](uint64_t a, uint64_t b) {
@@ -742,11 +774,53 @@ bool RdbIndex::exist(uint64_t docId) {
 	// std::lower_bound works on sorted list
 	std::stable_sort(m_pendingDocIds->begin(), m_pendingDocIds->end(), cmplt_fn);
 
-	it = std::lower_bound(m_pendingDocIds->cbegin(), m_pendingDocIds->cend(), docId << RdbIndex::s_docIdOffset);
+	auto it = std::lower_bound(m_pendingDocIds->cbegin(), m_pendingDocIds->cend(), docId << RdbIndex::s_docIdOffset);
 	return (it != m_pendingDocIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId));
 }
 
 void RdbIndex::swapDocIds(docidsconst_ptr_t docIds) {
 	ScopedLock sl(m_docIdsMtx);
 	m_docIds.swap(docIds);
+	m_packedDocIds.reset();
+}
+
+void RdbIndex::packDocIds() {
+	ScopedLock sl(m_pendingDocIdsMtx);
+	if (!m_pendingDocIds->empty()) {
+		return;
+	}
+
+	if (isPacked()) {
+		return;
+	}
+
+	// m_docIds can't change while we hold m_pendingDocIdsMtx
+	docidsconst_ptr_t docIds = getDocIds();
+	std::shared_ptr<EliasFano> packedDocIds(new EliasFano);
+	packedDocIds->set(*docIds);
+
+	logTrace(g_conf.m_logTraceRdbIndex, "%s: packed %zu docIds from %zu to %zu bytes", m_file.getFilename(),
+	         docIds->size(), docIds->capacity() * sizeof((*docIds)[0]), packedDocIds->getMemUsed());
+
+	ScopedLock sl2(m_docIdsMtx);
+	m_packedDocIds = packedDocIds;
+	m_docIds.reset(new docids_t);
+}
+
+bool RdbIndex::isPacked() {
+	ScopedLock sl(m_docIdsMtx);
+	return m_packedDocIds.get() != NULL;
+}
+
+size_t RdbIndex::getMemUsed() {
+	ScopedLock sl(m_pendingDocIdsMtx);
+	size_t memUsed = m_pendingDocIds->capacity() * sizeof((*m_pendingDocIds)[0]);
+
+	ScopedLock sl2(m_docIdsMtx);
+	memUsed += m_docIds->capacity() * sizeof((*m_docIds)[0]);
+	if (m_packedDocIds) {
+		memUsed += m_packedDocIds->getMemUsed();
+	}
+
+	return memUsed;
 }
@@ -5,17 +5,19 @@
 #include "rdbid_t.h"
 #include "Sanity.h"
 #include "GbMutex.h"
+#include "EliasFano.h"
 #include <vector>
 #include <memory>
 #include <atomic>
 
-class RdbTree;
+class RdbSkipList;
 class RdbBuckets;
 class RdbList;
 
 typedef std::vector<uint64_t> docids_t;
 typedef std::shared_ptr<docids_t> docids_ptr_t;
 typedef std::shared_ptr<const docids_t> docidsconst_ptr_t;
+typedef std::shared_ptr<const EliasFano> packeddocids_ptr_t;
 
 class RdbIndex {
 public:
@@ -65,7 +67,7 @@ public:
 	// . returns false and sets g_errno on error
 	bool generateIndex(BigFile *f);
 	bool generateIndex(collnum_t collnum, const RdbBuckets *buckets);
-	bool generateIndex(collnum_t collnum, const RdbTree *tree);
+	bool generateIndex(collnum_t collnum, const RdbSkipList *tree);
 
 	void addList(RdbList *list);
 
@@ -74,10 +76,26 @@ public:
 	// key format
 	// ........ ........ ........ dddddddd  d = docId
 	// dddddddd dddddddd dddddddd dddddd.Z  Z = delBit
+	// . if the docids are packed this decodes them into a new vector
 	docidsconst_ptr_t getDocIds();
 
+	// number of docids, without decoding packed ones
+	size_t getNumDocIds();
+
 	bool exist(uint64_t docId);
 
+	// . replace the sorted docid vector with an Elias-Fano encoded copy
+	//   (~20 bits per docid instead of 64)
+	// . only for indexes that are not added to anymore (those of finished
+	//   files). Does nothing if there are docids pending merge.
+	// . adding records later is still fine, but the next merge of pending
+	//   docids unpacks the index again
+	void packDocIds();
+	bool isPacked();
+
+	// heap memory used by the docids
+	size_t getMemUsed();
+
 	void printIndex();
 
 	static const char s_docIdOffset = 2;
@@ -106,8 +124,9 @@ private:
 	// verification
 	int64_t m_version;
 
-	// always sorted
+	// always sorted. empty when m_packedDocIds is set
 	docidsconst_ptr_t m_docIds;
+	packeddocids_ptr_t m_packedDocIds;
 	GbMutex m_docIdsMtx;
 
 	GbMutex m_pendingMergeMtx;
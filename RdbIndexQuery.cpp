@@ -3,14 +3,21 @@
 #include <algorithm>
 
 RdbIndexQuery::RdbIndexQuery(RdbBase *base)
-	: RdbIndexQuery(base ? (base->getGlobalIndex() ? base->getGlobalIndex() : docidsconst_ptr_t()) : docidsconst_ptr_t(),
+	: RdbIndexQuery(packeddocids_ptr_t(),
+	                docidsconst_ptr_t(),
 	                base ? (base->getTreeIndex() ? base->getTreeIndex()->getDocIds() : docidsconst_ptr_t()) : docidsconst_ptr_t(),
 	                base ? base->getNumFiles() : 0,
 	                base ? base->hasPendingGlobalIndexJob() : false) {
+	// never decode a packed global index
+	if (base) {
+		base->getGlobalIndex(&m_packedGlobalIndexData, &m_globalIndexData);
+	}
 }
 
-RdbIndexQuery::RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob)
-	: m_globalIndexData(globalIndexData)
+RdbIndexQuery::RdbIndexQuery(packeddocids_ptr_t packedGlobalIndexData, docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData,
+                             int32_t numFiles, bool hasPendingGlobalIndexJob)
+	: m_packedGlobalIndexData(packedGlobalIndexData)
+	, m_globalIndexData(globalIndexData)
 	, m_treeIndexData(treeIndexData)
 	, m_numFiles(numFiles)
 	, m_hasPendingGlobalIndexJob(hasPendingGlobalIndexJob) {
@@ -27,9 +34,9 @@ int32_t RdbIndexQuery::getFilePos(uint64_t docId, bool isMerging) const {
 		}
 	}
 
-	auto it = std::lower_bound(m_globalIndexData->cbegin(), m_globalIndexData->cend(), docId << RdbBase::s_docIdFileIndex_docIdDelKeyOffset);
-	if (it != m_globalIndexData->cend() && ((*it >> RdbBase::s_docIdFileIndex_docIdDelKeyOffset) == docId)) {
-		return static_cast<int32_t>(*it & RdbBase::s_docIdFileIndex_filePosMask);
+	int32_t filePos = getGlobalFilePos(docId);
+	if (filePos >= 0) {
+		return filePos;
 	}
 
 	// if we're merging, docId should always be present in global index
@@ -51,13 +58,27 @@ bool RdbIndexQuery::documentIsInFile(uint64_t docId, int32_t fileNum) const {
 		}
 	}
 
+	int32_t filePos = getGlobalFilePos(docId);
+	return (filePos >= 0 && filePos == fileNum);
+}
+
+int32_t RdbIndexQuery::getGlobalFilePos(uint64_t docId) const {
+	if (m_packedGlobalIndexData) {
+		// packed values are the key without the file index (docId+delBit)
+		uint64_t value;
+		size_t i = m_packedGlobalIndexData->lowerBound(docId << RdbIndex::s_docIdOffset, &value);
+		if (i < m_packedGlobalIndexData->size() && ((value >> RdbIndex::s_docIdOffset) == docId)) {
+			return static_cast<int32_t>(m_packedGlobalIndexData->getPayload(i));
+		}
+		return -1;
+	}
 
 	auto it = std::lower_bound(m_globalIndexData->cbegin(), m_globalIndexData->cend(), docId << RdbBase::s_docIdFileIndex_docIdDelKeyOffset);
 	if (it != m_globalIndexData->cend() && ((*it >> RdbBase::s_docIdFileIndex_docIdDelKeyOffset) == docId)) {
-		return (static_cast<int32_t>(*it & RdbBase::s_docIdFileIndex_filePosMask) == fileNum);
+		return static_cast<int32_t>(*it & RdbBase::s_docIdFileIndex_filePosMask);
 	}
 
-	return false;
+	return -1;
 }
 
 void RdbIndexQuery::printIndex() const {
@@ -70,7 +91,23 @@ void RdbIndexQuery::printIndex() const {
 		}
 	}
 
-	for (auto key : *m_globalIndexData) {
+	EliasFano::Iterator packedIter(m_packedGlobalIndexData.get());
+	size_t plainPos = 0;
+	for (;;) {
+		uint64_t key;
+		if (m_packedGlobalIndexData) {
+			uint64_t value;
+			uint64_t filePos;
+			if (!packedIter.next(&value, &filePos)) {
+				break;
+			}
+			key = (value << RdbBase::s_docIdFileIndex_docIdOffset) | filePos;
+		} else {
+			if (!m_globalIndexData || plainPos >= m_globalIndexData->size()) {
+				break;
+			}
+			key = (*m_globalIndexData)[plainPos++];
+		}
 		logf(LOG_TRACE, "db: docId=%" PRId64" index=%" PRId64" isDel=%d key=%" PRIx64,
 		     (key & RdbBase::s_docIdFileIndex_docIdMask) >> RdbBase::s_docIdFileIndex_docIdDelKeyOffset,
 		     key & RdbBase::s_docIdFileIndex_filePosMask,
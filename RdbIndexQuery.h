@@ -24,8 +24,14 @@ private:
 	RdbIndexQuery(const RdbIndexQuery&);
 	RdbIndexQuery& operator=(const RdbIndexQuery&);
 
-	RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob);
+	RdbIndexQuery(packeddocids_ptr_t packedGlobalIndexData, docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData,
+	              int32_t numFiles, bool hasPendingGlobalIndexJob);
 
+	// file index of docId according to the global index, or -1
+	int32_t getGlobalFilePos(uint64_t docId) const;
+
+	// only one of these is set
+	packeddocids_ptr_t m_packedGlobalIndexData;
 	docidsconst_ptr_t m_globalIndexData;
 	docidsconst_ptr_t m_treeIndexData;
 	int32_t m_numFiles;
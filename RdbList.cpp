@@ -6,6 +6,7 @@
 #include "RdbIndexQuery.h"
 #include "Posdb.h"
 #include "Linkdb.h"
+#include "TitleRecCodec.h"
 #include "Conf.h"
 #include "Mem.h"
 #include <set>
@@ -719,8 +720,8 @@ bool RdbList::checkList_r(bool abortOnProblem, rdbid_t rdbId) {
 			char *data = NULL;
 			if ( dataSize >= 4 ) data = getCurrentData();
 			if ( data &&
-			     (*(int32_t *)data < 0 ||
-			      *(int32_t *)data > 100000000 ) ) {
+			     (getTitleRecUncompressedSize(*(int32_t *)data) < 0 ||
+			      getTitleRecUncompressedSize(*(int32_t *)data) > 100000000 ) ) {
 				gbshutdownAbort(true); }
 		}
 		// tagrec?
@@ -750,7 +751,7 @@ bool RdbList::checkList_r(bool abortOnProblem, rdbid_t rdbId) {
 		// title bad uncompress size?
 		if ( rdbId == RDB_TITLEDB && ! KEYNEG(k) ) {
 			char *rec = getCurrentRec();
-			int32_t usize = *(int32_t *)(rec+12+4);
+			int32_t usize = getTitleRecUncompressedSize(*(int32_t *)(rec+12+4));
 			if ( usize <= 0 || usize>100000000 ) {
 				log(LOG_ERROR, "db: bad titlerec uncompress size");
 				gbshutdownAbort(true);
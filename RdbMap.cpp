@@ -8,6 +8,7 @@
 #include "Conf.h"
 #include "Mem.h"
 #include <fcntl.h>
+#include <sys/mman.h>
 
 
 RdbMap::RdbMap() {
@@ -17,6 +18,9 @@ RdbMap::RdbMap() {
 	m_newPagesPerSegment = 0;
 	m_keys = NULL;
 	m_offsets = NULL;
+	m_mmapBuf = NULL;
+	m_mmapSize = 0;
+	m_numMappedSegments = 0;
 
 	// Coverity	
 	m_fixedDataSize = 0;
@@ -94,13 +98,23 @@ void RdbMap::reset ( ) {
 	}
 
 	for ( int32_t i = 0 ; i < m_numSegments; i++ ) {
-		mfree(m_keys[i],m_ks *pps,"RdbMap");
-		mfree(m_offsets[i], 2*pps,"RdbMap");
+		// mapped segments are released by the munmap() below
+		if ( i >= m_numMappedSegments ) {
+			mfree(m_keys[i],m_ks *pps,"RdbMap");
+			mfree(m_offsets[i], 2*pps,"RdbMap");
+		}
 		// set to NULL so we know if accessed illegally
 		m_keys   [i] = NULL;
 		m_offsets[i] = NULL;
 	}
 
+	if ( m_mmapBuf ) {
+		munmap ( m_mmapBuf, m_mmapSize );
+		m_mmapBuf = NULL;
+	}
+	m_mmapSize = 0;
+	m_numMappedSegments = 0;
+
 	// the ptrs themselves are now a dynamic array to save mem
 	// when we have thousands of collections
 	mfree(m_keys,m_numSegmentPtrs*sizeof(char *),"MapPtrs1");
@@ -147,6 +161,14 @@ bool RdbMap::writeMap ( bool allDone ) {
 
 	log(LOG_INFO, "db: Saving %s", m_file.getFilename());
 
+	// . the mapped segments are pages of the file we are about to
+	//   truncate, so move them to the heap first
+	if ( ! copyMappedSegments ( ) ) {
+		log(LOG_ERROR, "%s:%s: END. Could not copy mapped segments of %s: %s. Returning false.",
+		    __FILE__, __func__, m_file.getFilename(), mstrerror(g_errno));
+		return false;
+	}
+
 	// open a new file
 	if ( ! m_file.open ( O_RDWR | O_CREAT | O_TRUNC ) ) {
 		log(LOG_ERROR, "%s:%s: END. Could not open %s for writing: %s. Returning false.",
@@ -583,8 +605,18 @@ bool RdbMap::readMap2 ( ) {
 		return false;
 	}
 
-	// read in the segments
-	for ( int32_t i = 0 ; offset < fileSize ; i++ ) {
+	// . map the full segments directly if enabled. the keys and the
+	//   offsets of a segment are already stored contiguously in the file
+	// . fall back to reading them if mmap fails
+	if ( g_conf.m_mmapRdbMaps && offset < fileSize ) {
+		int64_t mappedOffset = mapSegments ( offset, fileSize );
+		if ( mappedOffset > 0 ) {
+			offset = mappedOffset;
+		}
+	}
+
+	// read in the (remaining) segments
+	for ( int32_t i = m_numSegments ; offset < fileSize ; i++ ) {
 		// . this advance offset passed the read segment
 		// . it uses fileSize for reading the last partial segment
 		offset = readSegment ( i , offset , fileSize ) ;
@@ -633,6 +665,91 @@ int64_t RdbMap::readSegment ( int32_t seg , int64_t offset , int32_t fileSize )
 	return offset ;
 }
 
+// . the last partial segment is never mapped because addRecord() may append
+//   pages to it, and in the file its offsets follow right after its keys
+// . returns the offset of the first byte not mapped, or -1 if nothing was
+int64_t RdbMap::mapSegments ( int64_t offset , int32_t fileSize ) {
+	// the int16_t offsets must be aligned in the mapping. the header is
+	// 32+m_ks bytes so this holds for all the key sizes we have
+	if ( ( offset % 2 ) != 0 || ( m_ks % 2 ) != 0 ) {
+		return -1;
+	}
+
+	int32_t slotSize = m_ks + 2;
+	int32_t numFullSegments = (fileSize - offset) / (PAGES_PER_SEGMENT * slotSize);
+	if ( numFullSegments <= 0 ) {
+		return -1;
+	}
+
+	// a map is always far below MAX_PART_SIZE so it only has part 0
+	if ( m_file.getNumParts() != 1 ) {
+		return -1;
+	}
+	int fd = m_file.getfd ( 0 , true );
+	if ( fd < 0 ) {
+		return -1;
+	}
+
+	void *p = mmap ( NULL, fileSize, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	if ( p == MAP_FAILED ) {
+		log( LOG_WARN, "db: mmap of %s failed: %s. Reading it instead.", m_file.getFilename(), mstrerror(errno) );
+		return -1;
+	}
+	// lookups are binary searches so readahead is mostly wasted
+	madvise ( p, fileSize, MADV_RANDOM );
+
+	m_mmapBuf  = (char *)p;
+	m_mmapSize = fileSize;
+
+	for ( int32_t i = 0 ; i < numFullSegments ; i++ ) {
+		// on failure let readSegment() have a go at the rest
+		if ( ! addSegmentPtr ( m_numSegments ) ) {
+			break;
+		}
+		m_keys   [m_numSegments] = m_mmapBuf + offset;
+		offset += PAGES_PER_SEGMENT * m_ks;
+		m_offsets[m_numSegments] = (int16_t *)(m_mmapBuf + offset);
+		offset += PAGES_PER_SEGMENT * 2;
+
+		m_numSegments++;
+		m_numMappedSegments++;
+		m_maxNumPages += PAGES_PER_SEGMENT;
+		m_numPages    += PAGES_PER_SEGMENT;
+	}
+
+	return offset;
+}
+
+// . copy the mapped segments to the heap and drop the mapping
+// . the last mapped segment is copied first so the segments from
+//   m_numMappedSegments on are always on the heap, also if we run out of mem
+// . returns false and sets g_errno on error
+bool RdbMap::copyMappedSegments ( ) {
+	for ( int32_t i = m_numMappedSegments - 1 ; i >= 0 ; i-- ) {
+		char *keys = (char *)mmalloc ( m_ks * PAGES_PER_SEGMENT , "RdbMap" );
+		if ( ! keys ) {
+			return false;
+		}
+		int16_t *offsets = (int16_t *)mmalloc ( 2 * PAGES_PER_SEGMENT , "RdbMap" );
+		if ( ! offsets ) {
+			mfree ( keys , m_ks * PAGES_PER_SEGMENT , "RdbMap" );
+			return false;
+		}
+		memcpy ( keys    , m_keys[i]    , m_ks * PAGES_PER_SEGMENT );
+		memcpy ( offsets , m_offsets[i] , 2 * PAGES_PER_SEGMENT );
+		m_keys   [i] = keys;
+		m_offsets[i] = offsets;
+		m_numMappedSegments = i;
+	}
+
+	if ( m_mmapBuf ) {
+		munmap ( m_mmapBuf, m_mmapSize );
+		m_mmapBuf = NULL;
+		m_mmapSize = 0;
+	}
+	return true;
+}
+
 // . add a record to the map
 // . returns false and sets g_errno on error
 // . offset is the current offset of the rdb file where the key/data was added
@@ -1106,8 +1223,9 @@ int64_t RdbMap::getMemAllocated() const {
 	// . how much space per segment?
 	// . each page has a key and a 2 byte offset
 	int64_t space = PAGES_PER_SEGMENT * (m_ks + 2);
-	// how many segments we use * segment allocation
-	return (int64_t)m_numSegments * space;
+	// how many segments we use * segment allocation. mapped segments
+	// live in the page cache, not in our memory
+	return (int64_t)(m_numSegments - m_numMappedSegments) * space;
 }
 
 bool RdbMap::addSegmentPtr ( int32_t n ) {
@@ -1159,6 +1277,11 @@ void RdbMap::reduceMemFootPrint () {
 		return;
 	}
 
+	// nothing to save if it is not on the heap
+	if ( m_numMappedSegments > 0 ) {
+		return;
+	}
+
 	// if it is like posdb0054.map then it is being merged into and
 	// we'll resume a killed merge, so don't mess with it, we'll need to add more pages.
 	const char *s = m_file.getFilename();
@@ -1286,12 +1409,18 @@ bool RdbMap::chopHead ( int32_t fileHeadSize ) {
 	int32_t ks = m_ks;
 	// remove segments before segNum
 	for ( int32_t i = 0 ; i < segNum ; i++ ) {
-		mfree ( m_keys   [i] , ks * PAGES_PER_SEGMENT , "RdbMap" );
-		mfree ( m_offsets[i] , 2  * PAGES_PER_SEGMENT , "RdbMap" );
+		// mapped segments stay in the mapping until reset()
+		if ( i >= m_numMappedSegments ) {
+			mfree ( m_keys   [i] , ks * PAGES_PER_SEGMENT , "RdbMap" );
+			mfree ( m_offsets[i] , 2  * PAGES_PER_SEGMENT , "RdbMap" );
+		}
 		// set to NULL so we know if accessed illegally
 		m_keys   [i] = NULL;
 		m_offsets[i] = NULL;
 	}
+	// the mapped segments are always the leading ones
+	m_numMappedSegments -= segNum;
+	if ( m_numMappedSegments < 0 ) m_numMappedSegments = 0;
 	// adjust # of segments down
 	m_numSegments -= segNum;
 	// same with max # of used pages
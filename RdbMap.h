@@ -240,6 +240,12 @@ class RdbMap {
 	bool readMap     ( BigFile *dataFile );
 	bool readMap2    ( );
 	int64_t readSegment ( int32_t segment, int64_t offset, int32_t fileSize);
+	// point the full segments into an mmap of the map file. returns the
+	// offset of the first segment not mapped or -1 if mmap failed
+	int64_t mapSegments ( int64_t offset, int32_t fileSize );
+	// move the mapped segments to the heap, before the map file is
+	// rewritten. returns false and sets g_errno on error
+	bool copyMappedSegments ( );
 
 	// due to disk corruption keys or offsets can be out of order in map
 	bool verifyMap   ( BigFile *dataFile );
@@ -308,6 +314,13 @@ class RdbMap {
 
 	bool m_reducedMem;
 
+	// . when the map file is mmap'ed the first m_numMappedSegments
+	//   segments point into m_mmapBuf instead of being mmalloc'ed
+	// . the mapping is MAP_PRIVATE so writing to those pages is safe
+	char   *m_mmapBuf;
+	int64_t m_mmapSize;
+	int32_t m_numMappedSegments;
+
 	// number of valid pages in the map.
 	int32_t          m_numPages;     
 
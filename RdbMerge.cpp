@@ -86,6 +86,7 @@ bool RdbMerge::merge(rdbid_t rdbId,
 	m_rdbId           = rdbId;
 	m_collnum         = collnum;
 	m_targetFile      = targetFile;
+	m_targetFile->setDropPageCache(g_conf.m_mergeDropPageCache);
 	m_targetMap       = targetMap;
 	m_targetIndex     = targetIndex;
 	m_startFileNum    = startFileNum;
@@ -0,0 +1,1632 @@
+#include "RdbSkipList.h"
+#include "Collectiondb.h"
+#include "JobScheduler.h"
+#include "Mem.h"
+#include "RdbMem.h"
+#include "BigFile.h"
+#include "RdbList.h"
+#include "Spider.h"
+#include "TitleRecCodec.h"
+#include "Process.h"
+#include "Conf.h"
+#include "Sanity.h"
+#include "ScopedLock.h"
+#include <fcntl.h>
+#include <algorithm>
+#include <new>
+
+// same block size as the RdbTree save file
+#define BLOCK_SIZE 10000
+
+// purge deleted nodes when there are more of them than used nodes
+static const int32_t s_purgeThreshold = 10000;
+
+
+// . skip list level of a new node. each level holds ~1/4 of the nodes of
+//   the level below it
+static int randomLevel(int maxLevel) {
+	static thread_local uint64_t s_seed = 0;
+	if (s_seed == 0) {
+		s_seed = ((uint64_t)(uintptr_t)&s_seed ^ (uint64_t)time(NULL)) | 1;
+	}
+
+	// xorshift64
+	s_seed ^= s_seed << 13;
+	s_seed ^= s_seed >> 7;
+	s_seed ^= s_seed << 17;
+
+	uint64_t r = s_seed;
+	int level = 1;
+	while (level < maxLevel && (r & 3) == 0) {
+		level++;
+		r >>= 2;
+	}
+	return level;
+}
+
+
+RdbSkipList::RdbSkipList()
+	: m_lock()
+	, m_isSaving(false)
+	, m_needsSave(false)
+	, m_rdbId(-1)
+	, m_state(NULL)
+	, m_callback(NULL)
+	, m_ownData(false)
+	, m_collnums(NULL)
+	, m_keys(NULL)
+	, m_data(NULL)
+	, m_sizes(NULL)
+	, m_addSeqs(NULL)
+	, m_states(NULL)
+	, m_levels(NULL)
+	, m_towers(NULL)
+	, m_next(NULL)
+	, m_towerPool(NULL)
+	, m_numNodes(0)
+	, m_towerPoolSize(0)
+	, m_towerPoolUsed(0)
+	, m_minUnusedNode(0)
+	, m_numUsedNodes(0)
+	, m_numDeletedNodes(0)
+	, m_numNegativeKeys(0)
+	, m_numPositiveKeys(0)
+	, m_memAllocated(0)
+	, m_memOccupied(0)
+	, m_addSeq(0)
+	, m_freeNodesMtx()
+	, m_freeNodes()
+	, m_numFreeNodes(0)
+	, m_overhead(0)
+	, m_maxMem(0)
+	, m_fixedDataSize(-1)
+	, m_allocName(NULL)
+	, m_bytesWritten(0)
+	, m_errno(0)
+	, m_ks(0)
+	, m_corrupt(0) {
+	memset(m_dir, 0, sizeof(m_dir));
+	memset(m_dbname, 0, sizeof(m_dbname));
+	for (int level = 0; level < s_maxLevel; level++) {
+		m_head[level] = -1;
+	}
+}
+
+RdbSkipList::~RdbSkipList() {
+	reset_unlocked();
+}
+
+
+// "memMax" includes records plus the overhead
+bool RdbSkipList::set(int32_t fixedDataSize, int32_t maxNumNodes, int32_t memMax, bool ownData,
+                      const char *allocName, const char *dbname, char keySize, char rdbId) {
+	ScopedWriteLock sl(m_lock);
+
+	reset_unlocked();
+	m_fixedDataSize = fixedDataSize;
+	m_maxMem        = memMax;
+	m_ownData       = ownData;
+	m_allocName     = allocName;
+	m_ks            = keySize;
+	m_needsSave     = false;
+
+	m_dbname[0] = '\0';
+	if (dbname) {
+		int32_t dlen = strlen(dbname);
+		if (dlen > 30) dlen = 30;
+		memcpy(m_dbname, dbname, dlen);
+		m_dbname[dlen] = '\0';
+	}
+
+	m_rdbId = rdbId;
+	// sanity
+	if (rdbId < -1) { g_process.shutdownAbort(true); }
+	if (rdbId >= RDB_END) { g_process.shutdownAbort(true); }
+
+	// adjust m_maxMem to virtual infinity if it was -1
+	if (m_maxMem < 0) m_maxMem = 0x7fffffff;
+
+	// . each node's memory overhead: key, collnum, level 0 link, tower
+	//   offset, level, state and add sequence
+	// . plus 2 bytes for the average share of the tower pool
+	m_overhead = m_ks + sizeof(collnum_t) + 4 + 4 + 1 + 1 + 4 + 2;
+	// data ptr if we have data
+	if (m_fixedDataSize != 0) m_overhead += sizeof(char *);
+	// dataSize if our dataSize is variable (-1)
+	if (m_fixedDataSize == -1) m_overhead += 4;
+
+	if (maxNumNodes == -1) {
+		maxNumNodes = m_maxMem / m_overhead;
+		if (maxNumNodes > 10000000) maxNumNodes = 10000000;
+	}
+
+	return allocNodes_unlocked(maxNumNodes);
+}
+
+bool RdbSkipList::allocNodes_unlocked(int32_t nn) {
+	int32_t poolSize = nn / 2 + s_maxLevel;
+
+	m_collnums  = (collnum_t *)mmalloc(nn * sizeof(collnum_t), m_allocName);
+	m_keys      = (char *)mmalloc(nn * m_ks, m_allocName);
+	m_addSeqs   = (uint32_t *)mmalloc(nn * sizeof(uint32_t), m_allocName);
+	m_states    = (std::atomic<char> *)mmalloc(nn * sizeof(std::atomic<char>), m_allocName);
+	m_levels    = (char *)mmalloc(nn, m_allocName);
+	m_towers    = (int32_t *)mmalloc(nn * sizeof(int32_t), m_allocName);
+	m_next      = (std::atomic<int32_t> *)mmalloc(nn * sizeof(std::atomic<int32_t>), m_allocName);
+	m_towerPool = (std::atomic<int32_t> *)mmalloc(poolSize * sizeof(std::atomic<int32_t>), m_allocName);
+	if (m_fixedDataSize != 0) {
+		m_data = (char **)mmalloc(nn * sizeof(char *), m_allocName);
+	}
+	if (m_fixedDataSize == -1) {
+		m_sizes = (int32_t *)mmalloc(nn * sizeof(int32_t), m_allocName);
+	}
+
+	m_numNodes = nn;
+	m_towerPoolSize = poolSize;
+	m_memAllocated += m_overhead * nn;
+
+	if (nn > 0 &&
+	    (!m_collnums || !m_keys || !m_addSeqs || !m_states || !m_levels || !m_towers || !m_next || !m_towerPool ||
+	     (m_fixedDataSize != 0 && !m_data) || (m_fixedDataSize == -1 && !m_sizes))) {
+		log(LOG_ERROR, "db: Failed to allocate %" PRId32" nodes for %s: %s.", nn, m_dbname, mstrerror(g_errno));
+		freeNodes_unlocked();
+		return false;
+	}
+
+	for (int32_t i = 0; i < nn; i++) {
+		new (&m_states[i]) std::atomic<char>(state_free);
+		new (&m_next[i]) std::atomic<int32_t>(-1);
+		m_levels[i] = 1;
+		m_towers[i] = -1;
+	}
+	for (int32_t i = 0; i < poolSize; i++) {
+		new (&m_towerPool[i]) std::atomic<int32_t>(-1);
+	}
+
+	// bitch if too much
+	if (m_memAllocated > m_maxMem) {
+		log(LOG_ERROR, "db: Trying to grow tree for %s to %" PRId32", but max is %" PRId32". Consider changing gb.conf.",
+		    m_dbname, (int32_t)m_memAllocated, m_maxMem);
+		return false;
+	}
+
+	return true;
+}
+
+void RdbSkipList::freeNodes_unlocked() {
+	int32_t nn = m_numNodes;
+	if (m_collnums) mfree(m_collnums, nn * sizeof(collnum_t), m_allocName);
+	if (m_keys) mfree(m_keys, nn * m_ks, m_allocName);
+	if (m_addSeqs) mfree(m_addSeqs, nn * sizeof(uint32_t), m_allocName);
+	if (m_states) mfree(m_states, nn * sizeof(std::atomic<char>), m_allocName);
+	if (m_levels) mfree(m_levels, nn, m_allocName);
+	if (m_towers) mfree(m_towers, nn * sizeof(int32_t), m_allocName);
+	if (m_next) mfree(m_next, nn * sizeof(std::atomic<int32_t>), m_allocName);
+	if (m_towerPool) mfree(m_towerPool, m_towerPoolSize * sizeof(std::atomic<int32_t>), m_allocName);
+	if (m_data) mfree(m_data, nn * sizeof(char *), m_allocName);
+	if (m_sizes) mfree(m_sizes, nn * sizeof(int32_t), m_allocName);
+
+	m_collnums  = NULL;
+	m_keys      = NULL;
+	m_addSeqs   = NULL;
+	m_states    = NULL;
+	m_levels    = NULL;
+	m_towers    = NULL;
+	m_next      = NULL;
+	m_towerPool = NULL;
+	m_data      = NULL;
+	m_sizes     = NULL;
+
+	m_memAllocated -= m_overhead * nn;
+	m_numNodes = 0;
+	m_towerPoolSize = 0;
+}
+
+void RdbSkipList::reset() {
+	ScopedWriteLock sl(m_lock);
+	reset_unlocked();
+}
+
+void RdbSkipList::reset_unlocked() {
+	if (m_numNodes > 0 && m_dbname[0]) {
+		log(LOG_INFO, "db: Resetting tree for %s.", m_dbname);
+	}
+
+	// liberate all the nodes
+	clear_unlocked();
+
+	// do not require saving after a reset
+	m_needsSave = false;
+
+	freeNodes_unlocked();
+
+	m_memAllocated  = 0;
+	m_memOccupied   = 0;
+	m_fixedDataSize = -1;
+	m_isSaving      = false;
+}
+
+void RdbSkipList::delColl(collnum_t collnum) {
+	ScopedWriteLock sl(m_lock);
+
+	m_needsSave = true;
+
+	int32_t minUnusedNode = m_minUnusedNode;
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		if (m_states[i] == state_used && m_collnums[i] == collnum) {
+			deleteNode_locked(i);
+		}
+	}
+
+	purgeDeletedNodes_unlocked();
+}
+
+int32_t RdbSkipList::clear() {
+	ScopedWriteLock sl(m_lock);
+	return clear_unlocked();
+}
+
+// . this just makes all the nodes available for occupation (liberates them)
+// . it does not free the node arrays
+// . returns # of occupied nodes we liberated
+int32_t RdbSkipList::clear_unlocked() {
+	if (m_numUsedNodes > 0) m_needsSave = true;
+
+	int32_t count = 0;
+	int32_t minUnusedNode = m_minUnusedNode;
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		char state = m_states[i];
+		m_states[i] = state_free;
+		if (state != state_used) continue;
+
+		// we no longer count the overhead of this node as occupied
+		m_memOccupied -= m_overhead;
+		count++;
+
+		// continue if we have no data to free
+		if (!m_data) continue;
+
+		int32_t dataSize = getDataSize_unlocked(i);
+		if (m_ownData) mfree(m_data[i], dataSize, m_allocName);
+		m_memAllocated -= dataSize;
+		m_memOccupied -= dataSize;
+	}
+
+	for (int level = 0; level < s_maxLevel; level++) {
+		m_head[level] = -1;
+	}
+
+	m_minUnusedNode   = 0;
+	m_numUsedNodes    = 0;
+	m_numDeletedNodes = 0;
+	m_numNegativeKeys = 0;
+	m_numPositiveKeys = 0;
+	m_towerPoolUsed   = 0;
+
+	{
+		ScopedLock sl(m_freeNodesMtx);
+		m_freeNodes.clear();
+		m_numFreeNodes = 0;
+	}
+
+	// clear tree counts for all collections, but only if we are an Rdb::m_tree
+	if (m_rdbId >= 0) {
+		int32_t nc = g_collectiondb.getNumRecs();
+		for (int32_t i = 0; i < nc; i++) {
+			CollectionRec *cr = g_collectiondb.getRec(i);
+			if (!cr) continue;
+			cr->m_numNegKeysInTree[(unsigned char)m_rdbId] = 0;
+			cr->m_numPosKeysInTree[(unsigned char)m_rdbId] = 0;
+		}
+	}
+
+	return count;
+}
+
+int RdbSkipList::compareNode(int32_t node, collnum_t collnum, const char *key) const {
+	if (m_collnums[node] < collnum) return -1;
+	if (m_collnums[node] > collnum) return 1;
+	return KEYCMP(m_keys + node * m_ks, key, m_ks);
+}
+
+int32_t RdbSkipList::findPosition(collnum_t collnum, const char *key, int32_t *preds, int32_t *succs) const {
+	int32_t pred = -1;
+	int32_t cur = -1;
+	for (int level = s_maxLevel - 1; level >= 0; level--) {
+		cur = nextPtr(pred, level)->load(std::memory_order_acquire);
+		while (cur >= 0 && compareNode(cur, collnum, key) < 0) {
+			pred = cur;
+			cur = nextPtr(cur, level)->load(std::memory_order_acquire);
+		}
+		preds[level] = pred;
+		succs[level] = cur;
+	}
+
+	if (cur >= 0 && compareNode(cur, collnum, key) == 0) {
+		return cur;
+	}
+	return -1;
+}
+
+int32_t RdbSkipList::lowerBound(collnum_t collnum, const char *key) const {
+	int32_t pred = -1;
+	int32_t cur = -1;
+	for (int level = s_maxLevel - 1; level >= 0; level--) {
+		cur = nextPtr(pred, level)->load(std::memory_order_acquire);
+		while (cur >= 0 && compareNode(cur, collnum, key) < 0) {
+			pred = cur;
+			cur = nextPtr(cur, level)->load(std::memory_order_acquire);
+		}
+	}
+	return cur;
+}
+
+void RdbSkipList::setLevel(int32_t node, int level) {
+	int32_t offset = -1;
+	if (level > 1) {
+		offset = m_towerPoolUsed.fetch_add(level - 1);
+		if (offset + level - 1 > m_towerPoolSize) {
+			// pool is exhausted. node only goes on level 0
+			offset = -1;
+			level = 1;
+		}
+	}
+	m_levels[node] = level;
+	m_towers[node] = offset;
+}
+
+int32_t RdbSkipList::allocNode() {
+	// re-use nodes freed by a purge first
+	if (m_numFreeNodes.load(std::memory_order_relaxed) > 0) {
+		ScopedLock sl(m_freeNodesMtx);
+		if (!m_freeNodes.empty()) {
+			int32_t node = m_freeNodes.back();
+			m_freeNodes.pop_back();
+			m_numFreeNodes--;
+			if (m_towers[node] < 0) {
+				setLevel(node, randomLevel(s_maxLevel));
+			}
+			return node;
+		}
+	}
+
+	int32_t node = m_minUnusedNode.load(std::memory_order_relaxed);
+	do {
+		if (node >= m_numNodes) {
+			return -1;
+		}
+	} while (!m_minUnusedNode.compare_exchange_weak(node, node + 1));
+
+	setLevel(node, randomLevel(s_maxLevel));
+	return node;
+}
+
+// give back a node that was never linked in
+void RdbSkipList::releaseNode(int32_t node) {
+	m_states[node].store(state_free, std::memory_order_relaxed);
+
+	ScopedLock sl(m_freeNodesMtx);
+	m_freeNodes.push_back(node);
+	m_numFreeNodes++;
+}
+
+void RdbSkipList::increaseNodeCount(collnum_t collnum, const char *key) {
+	m_numUsedNodes++;
+
+	if (KEYNEG(key)) {
+		m_numNegativeKeys++;
+		if (m_rdbId >= 0) {
+			CollectionRec *cr = g_collectiondb.getRec(collnum);
+			if (cr) {
+				__atomic_fetch_add(&cr->m_numNegKeysInTree[(unsigned char)m_rdbId], 1, __ATOMIC_RELAXED);
+			}
+		}
+	} else {
+		m_numPositiveKeys++;
+		if (m_rdbId >= 0) {
+			CollectionRec *cr = g_collectiondb.getRec(collnum);
+			if (cr) {
+				__atomic_fetch_add(&cr->m_numPosKeysInTree[(unsigned char)m_rdbId], 1, __ATOMIC_RELAXED);
+			}
+		}
+	}
+}
+
+void RdbSkipList::decreaseNodeCount(collnum_t collnum, const char *key) {
+	m_numUsedNodes--;
+
+	if (KEYNEG(key)) {
+		m_numNegativeKeys--;
+		if (m_rdbId >= 0) {
+			CollectionRec *cr = g_collectiondb.getRec(collnum);
+			if (cr) {
+				__atomic_fetch_sub(&cr->m_numNegKeysInTree[(unsigned char)m_rdbId], 1, __ATOMIC_RELAXED);
+			}
+		}
+	} else {
+		m_numPositiveKeys--;
+		if (m_rdbId >= 0) {
+			CollectionRec *cr = g_collectiondb.getRec(collnum);
+			if (cr) {
+				__atomic_fetch_sub(&cr->m_numPosKeysInTree[(unsigned char)m_rdbId], 1, __ATOMIC_RELAXED);
+			}
+		}
+	}
+}
+
+bool RdbSkipList::shouldPurge() const {
+	int32_t numDeleted = m_numDeletedNodes;
+	return (numDeleted > s_purgeThreshold && numDeleted > m_numUsedNodes);
+}
+
+bool RdbSkipList::addNode(collnum_t collnum, const char *key, char *data, int32_t dataSize) {
+	// sanity check - no empty positive keys for doledb
+	if (m_rdbId == RDB_DOLEDB && dataSize == 0 && (key[0] & 0x01) == 0x01) {
+		g_process.shutdownAbort(true);
+	}
+
+	// for posdb
+	if (m_ks == 18 && (key[0] & 0x06)) {
+		g_process.shutdownAbort(true);
+	}
+
+	for (int attempt = 0; ; attempt++) {
+		{
+			ScopedReadLock sl(m_lock);
+			if (addNode_shared(collnum, key, data, dataSize) >= 0) {
+				break;
+			}
+		}
+
+		// out of nodes. deleted nodes still take up room until purged
+		if (attempt > 0 || m_numDeletedNodes == 0) {
+			g_errno = ENOMEM;
+			return false;
+		}
+
+		ScopedWriteLock sl(m_lock);
+		purgeDeletedNodes_unlocked();
+	}
+
+	// long chains of deleted nodes slow down everybody
+	if (shouldPurge()) {
+		ScopedWriteLock sl(m_lock);
+		if (shouldPurge()) {
+			purgeDeletedNodes_unlocked();
+		}
+	}
+
+	return true;
+}
+
+// . caller holds the shared lock
+// . returns node # we added it to on success, -1 if out of nodes
+int32_t RdbSkipList::addNode_shared(collnum_t collnum, const char *key, char *data, int32_t dataSize) {
+	int32_t preds[s_maxLevel];
+	int32_t succs[s_maxLevel];
+	int32_t node = -1;
+
+	for (;;) {
+		int32_t found = findPosition(collnum, key, preds, succs);
+		if (found >= 0) {
+			// another thread may have linked in the same key first
+			if (node >= 0) {
+				releaseNode(node);
+			}
+			replaceNode(found, data, dataSize);
+			return found;
+		}
+
+		if (node < 0) {
+			node = allocNode();
+			if (node < 0) {
+				return -1;
+			}
+
+			// nobody can see the node until it is linked in
+			m_collnums[node] = collnum;
+			KEYSET(m_keys + node * m_ks, key, m_ks);
+			if (m_fixedDataSize != 0) m_data[node] = data;
+			if (m_fixedDataSize == -1) m_sizes[node] = dataSize;
+			m_addSeqs[node] = m_addSeq.fetch_add(1) + 1;
+			m_states[node].store(state_used, std::memory_order_relaxed);
+		}
+
+		m_next[node].store(succs[0], std::memory_order_relaxed);
+		int32_t expected = succs[0];
+		if (nextPtr(preds[0], 0)->compare_exchange_strong(expected, node, std::memory_order_release, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	m_needsSave = true;
+
+	// ack used and occupied mem
+	m_memOccupied += m_overhead;
+	if (m_fixedDataSize != 0) {
+		int32_t size = (m_fixedDataSize >= 0) ? m_fixedDataSize : dataSize;
+		m_memAllocated += size;
+		m_memOccupied += size;
+	}
+	increaseNodeCount(collnum, key);
+
+	// the node is in the list now. the upper levels only speed up searches
+	for (int level = 1; level < m_levels[node]; level++) {
+		for (;;) {
+			int32_t succ = succs[level];
+			nextPtr(node, level)->store(succ, std::memory_order_relaxed);
+			if (nextPtr(preds[level], level)->compare_exchange_strong(succ, node, std::memory_order_release, std::memory_order_relaxed)) {
+				break;
+			}
+			findPosition(collnum, key, preds, succs);
+		}
+	}
+
+	return node;
+}
+
+void RdbSkipList::replaceNode(int32_t node, char *data, int32_t dataSize) {
+	ScopedLock sl(getNodeLock(node));
+
+	m_needsSave = true;
+
+	int32_t newDataSize = (m_fixedDataSize >= 0) ? m_fixedDataSize : dataSize;
+
+	if (m_states[node].load(std::memory_order_relaxed) == state_used) {
+		// if we don't support any data then we're done
+		if (m_fixedDataSize == 0) {
+			return;
+		}
+
+		int32_t oldDataSize = getDataSize_unlocked(node);
+		if (m_data[node] && m_ownData) {
+			mfree(m_data[node], oldDataSize, m_allocName);
+		}
+		m_memOccupied += newDataSize - oldDataSize;
+		m_memAllocated += newDataSize - oldDataSize;
+
+		m_data[node] = data;
+		if (m_fixedDataSize == -1) m_sizes[node] = dataSize;
+		return;
+	}
+
+	// revive a deleted node
+	if (m_fixedDataSize != 0) {
+		m_data[node] = data;
+		if (m_fixedDataSize == -1) m_sizes[node] = dataSize;
+		m_memAllocated += newDataSize;
+		m_memOccupied += newDataSize;
+	}
+	m_memOccupied += m_overhead;
+	// . keep the add sequence number. the key was in the list before, so a
+	//   read that started earlier must not skip it as a new record. it sees
+	//   the new data like it does for a replace
+	m_states[node].store(state_used, std::memory_order_release);
+	m_numDeletedNodes--;
+	increaseNodeCount(m_collnums[node], getKey_unlocked(node));
+}
+
+bool RdbSkipList::getNode(collnum_t collnum, const char *key) const {
+	ScopedReadLock sl(m_lock);
+	int32_t node = lowerBound(collnum, key);
+	return (node >= 0 && compareNode(node, collnum, key) == 0 && !isEmpty_unlocked(node));
+}
+
+bool RdbSkipList::deleteNode(collnum_t collnum, const char *key, bool freeData) {
+	ScopedReadLock sl(m_lock);
+
+	int32_t node = lowerBound(collnum, key);
+	if (node < 0 || compareNode(node, collnum, key) != 0) {
+		return false;
+	}
+
+	ScopedLock sl2(getNodeLock(node));
+	if (m_states[node].load(std::memory_order_relaxed) != state_used) {
+		return false;
+	}
+
+	deleteNode_locked(node);
+	return true;
+}
+
+void RdbSkipList::deleteNode_locked(int32_t node) {
+	m_needsSave = true;
+
+	m_memOccupied -= m_overhead;
+	if (m_data) {
+		int32_t dataSize = getDataSize_unlocked(node);
+		if (m_ownData) mfree(m_data[node], dataSize, m_allocName);
+		m_data[node] = NULL;
+		m_memAllocated -= dataSize;
+		m_memOccupied -= dataSize;
+	}
+
+	m_states[node].store(state_deleted, std::memory_order_release);
+	m_numDeletedNodes++;
+	decreaseNodeCount(m_collnums[node], getKey_unlocked(node));
+}
+
+// unlink the deleted nodes on every level and put them on the free list
+void RdbSkipList::purgeDeletedNodes_unlocked() {
+	if (m_numDeletedNodes == 0) {
+		return;
+	}
+
+	for (int level = 0; level < s_maxLevel; level++) {
+		int32_t pred = -1;
+		int32_t cur = m_head[level].load(std::memory_order_relaxed);
+		while (cur >= 0) {
+			int32_t next = nextPtr(cur, level)->load(std::memory_order_relaxed);
+			if (m_states[cur].load(std::memory_order_relaxed) == state_deleted) {
+				nextPtr(pred, level)->store(next, std::memory_order_relaxed);
+			} else {
+				pred = cur;
+			}
+			cur = next;
+		}
+	}
+
+	ScopedLock sl(m_freeNodesMtx);
+	int32_t count = 0;
+	int32_t minUnusedNode = m_minUnusedNode;
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		if (m_states[i].load(std::memory_order_relaxed) == state_deleted) {
+			m_states[i].store(state_free, std::memory_order_relaxed);
+			m_freeNodes.push_back(i);
+			count++;
+		}
+	}
+	m_numFreeNodes = m_freeNodes.size();
+	m_numDeletedNodes = 0;
+
+	log(LOG_DEBUG, "db: Purged %" PRId32" deleted nodes from %s tree.", count, m_dbname);
+}
+
+// relink all used nodes in key order with fresh levels. drops duplicate keys
+void RdbSkipList::rebuild_unlocked() {
+	std::vector<int32_t> nodes;
+	nodes.reserve(m_numUsedNodes);
+
+	int32_t minUnusedNode = m_minUnusedNode;
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		if (m_states[i] == state_used) {
+			nodes.push_back(i);
+		}
+	}
+
+	std::stable_sort(nodes.begin(), nodes.end(), [this](int32_t a, int32_t b) {
+		if (m_collnums[a] != m_collnums[b]) return m_collnums[a] < m_collnums[b];
+		return KEYCMP(m_keys + a * m_ks, m_keys + b * m_ks, m_ks) < 0;
+	});
+
+	for (int level = 0; level < s_maxLevel; level++) {
+		m_head[level] = -1;
+	}
+	m_towerPoolUsed = 0;
+
+	int32_t last[s_maxLevel];
+	for (int level = 0; level < s_maxLevel; level++) {
+		last[level] = -1;
+	}
+
+	int32_t numDups = 0;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		int32_t node = nodes[i];
+
+		// keep the later one of duplicate keys, like an add would
+		if (i + 1 < nodes.size() && compareNode(nodes[i + 1], m_collnums[node], getKey_unlocked(node)) == 0) {
+			deleteNode_locked(node);
+			numDups++;
+			continue;
+		}
+
+		setLevel(node, randomLevel(s_maxLevel));
+		for (int level = 0; level < m_levels[node]; level++) {
+			nextPtr(last[level], level)->store(node, std::memory_order_relaxed);
+			last[level] = node;
+		}
+	}
+
+	for (int level = 0; level < s_maxLevel; level++) {
+		nextPtr(last[level], level)->store(-1, std::memory_order_relaxed);
+	}
+
+	// everything that is not linked in is free
+	ScopedLock sl(m_freeNodesMtx);
+	m_freeNodes.clear();
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		if (m_states[i] != state_used) {
+			m_states[i] = state_free;
+			m_towers[i] = -1;
+			m_levels[i] = 1;
+			m_freeNodes.push_back(i);
+		}
+	}
+	m_numFreeNodes = m_freeNodes.size();
+	m_numDeletedNodes = 0;
+
+	if (numDups) {
+		log(LOG_WARN, "db: Removed %" PRId32" duplicate keys from %s tree.", numDups, m_dbname);
+	}
+}
+
+int32_t RdbSkipList::getFirstNode_unlocked() const {
+	int32_t node = m_head[0].load(std::memory_order_acquire);
+	while (node >= 0 && isEmpty_unlocked(node)) {
+		node = m_next[node].load(std::memory_order_acquire);
+	}
+	return node;
+}
+
+int32_t RdbSkipList::getNextNode_unlocked(int32_t node) const {
+	node = m_next[node].load(std::memory_order_acquire);
+	while (node >= 0 && isEmpty_unlocked(node)) {
+		node = m_next[node].load(std::memory_order_acquire);
+	}
+	return node;
+}
+
+int32_t RdbSkipList::getNextNode_unlocked(collnum_t collnum, const char *key) const {
+	int32_t node = lowerBound(collnum, key);
+	while (node >= 0 && isEmpty_unlocked(node)) {
+		node = m_next[node].load(std::memory_order_acquire);
+	}
+	return node;
+}
+
+int32_t RdbSkipList::getDataSize_unlocked(int32_t node) const {
+	if (m_fixedDataSize == -1) {
+		return m_sizes[node];
+	}
+	return m_fixedDataSize;
+}
+
+bool RdbSkipList::fixTree() {
+	ScopedWriteLock sl(m_lock);
+	return fixTree_unlocked();
+}
+
+// . drop records that are obviously bad and relink the rest
+// . returns false if could not fix tree and sets g_errno, otherwise true
+bool RdbSkipList::fixTree_unlocked() {
+	log(LOG_WARN, "db: Trying to fix tree for %s.", m_dbname);
+	log(LOG_WARN, "db: %" PRId32" occupied nodes and %" PRId32" deleted of top %" PRId32" nodes.",
+	    (int32_t)m_numUsedNodes, (int32_t)m_numDeletedNodes, (int32_t)m_minUnusedNode);
+
+	int32_t max = g_collectiondb.getNumRecs();
+	log("db: Valid collection numbers range from 0 to %" PRId32".", max);
+
+	bool isTitledb = (m_rdbId == RDB_TITLEDB || m_rdbId == RDB2_TITLEDB2);
+	bool isSpiderdb = (m_rdbId == RDB_SPIDERDB || m_rdbId == RDB2_SPIDERDB2);
+
+	int32_t count = 0;
+	int32_t minUnusedNode = m_minUnusedNode;
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		if (m_states[i] != state_used) continue;
+
+		if (isTitledb && m_data[i]) {
+			int32_t ucompSize = getTitleRecUncompressedSize(*(int32_t *)m_data[i]);
+			if (ucompSize < 0 || ucompSize > 100000000) {
+				log("db: removing titlerec with uncompressed size of %i from tree", (int)ucompSize);
+				deleteNode_locked(i);
+				count++;
+				continue;
+			}
+		}
+
+		const char *key = getKey_unlocked(i);
+		if (isSpiderdb && m_data[i] && Spiderdb::isSpiderRequest((const key128_t *)key)) {
+			const SpiderRequest *sreq = (const SpiderRequest *)(m_data[i] - sizeof(spiderdbkey_t) - 4);
+			if (strncmp(sreq->m_url, "http", 4) != 0) {
+				log("db: removing spiderrequest bad url %s from tree", sreq->m_url);
+				deleteNode_locked(i);
+				count++;
+				continue;
+			}
+		}
+
+		collnum_t cn = m_collnums[i];
+		if (m_rdbId >= 0 && (cn < 0 || cn >= max || !g_collectiondb.getRec(cn))) {
+			deleteNode_locked(i);
+			count++;
+			continue;
+		}
+	}
+
+	rebuild_unlocked();
+
+	log("db: Fix tree removed %" PRId32" nodes for %s.", count, m_dbname);
+
+	if (!checkTree_unlocked(false, true)) {
+		log(LOG_WARN, "db: Fix tree failed.");
+		return false;
+	}
+	log("db: Fix tree succeeded for %s.", m_dbname);
+	return true;
+}
+
+void RdbSkipList::verifyIntegrity() {
+	ScopedWriteLock sl(m_lock);
+
+	if (!checkTree_unlocked(false, true)) {
+		gbshutdownCorrupted();
+	}
+}
+
+// . returns false if the list had problem, true otherwise
+// . must hold the exclusive lock for the counts to add up
+bool RdbSkipList::checkTree_unlocked(bool printMsgs, bool doChainTest) const {
+	int32_t minUnusedNode = m_minUnusedNode;
+	int32_t count = 0;
+	int32_t numLinked = 0;
+	int32_t prev = -1;
+	for (int32_t node = m_head[0]; node >= 0; node = m_next[node]) {
+		if (node >= minUnusedNode) {
+			if (printMsgs) log(LOG_WARN, "db: Tree for %s links to node #%" PRId32" beyond %" PRId32".", m_dbname, node, minUnusedNode);
+			return false;
+		}
+
+		if (++numLinked > minUnusedNode) {
+			if (printMsgs) log(LOG_WARN, "db: Tree for %s has a loop.", m_dbname);
+			return false;
+		}
+
+		char state = m_states[node];
+		if (state == state_free) {
+			if (printMsgs) log(LOG_WARN, "db: Tree for %s links to free node #%" PRId32".", m_dbname, node);
+			return false;
+		}
+
+		if (prev >= 0 && compareNode(prev, m_collnums[node], getKey_unlocked(node)) >= 0) {
+			if (printMsgs) log(LOG_WARN, "db: Tree for %s has node #%" PRId32" out of order.", m_dbname, node);
+			return false;
+		}
+
+		if (state == state_used) {
+			count++;
+		}
+		prev = node;
+	}
+
+	if (count != m_numUsedNodes) {
+		if (printMsgs) log(LOG_WARN, "db: Tree for %s has %" PRId32" used nodes linked but counted %" PRId32".",
+		                   m_dbname, count, (int32_t)m_numUsedNodes);
+		return false;
+	}
+
+	if (!doChainTest) {
+		return true;
+	}
+
+	// the upper levels must be ordered and only contain nodes that tall
+	for (int level = 1; level < s_maxLevel; level++) {
+		prev = -1;
+		numLinked = 0;
+		for (int32_t node = m_head[level]; node >= 0; node = nextPtr(node, level)->load()) {
+			if (node >= minUnusedNode || ++numLinked > minUnusedNode || m_levels[node] <= level || m_towers[node] < 0) {
+				if (printMsgs) log(LOG_WARN, "db: Tree for %s has bad node #%" PRId32" on level %d.", m_dbname, node, level);
+				return false;
+			}
+			if (prev >= 0 && compareNode(prev, m_collnums[node], getKey_unlocked(node)) >= 0) {
+				if (printMsgs) log(LOG_WARN, "db: Tree for %s has node #%" PRId32" out of order on level %d.", m_dbname, node, level);
+				return false;
+			}
+			prev = node;
+		}
+	}
+
+	return true;
+}
+
+int32_t RdbSkipList::getMemOccupiedForList_unlocked(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes) const {
+	int32_t size = 0;
+	for (int32_t node = getNextNode_unlocked(collnum, startKey); node >= 0; node = getNextNode_unlocked(node)) {
+		if (KEYCMP(getKey_unlocked(node), endKey, m_ks) > 0) break;
+		if (m_collnums[node] != collnum) break;
+		if (size >= minRecSizes) break;
+
+		if (m_data) {
+			size += getDataSize_unlocked(node);
+		}
+		size += m_ks;
+		// dataSize overhead (-1 means variable data size)
+		if (m_fixedDataSize < 0) size += 4;
+	}
+	return size;
+}
+
+int32_t RdbSkipList::getMemOccupiedForList() const {
+	int32_t numUsedNodes = m_numUsedNodes;
+	if (m_fixedDataSize >= 0) {
+		return numUsedNodes * (m_ks + m_fixedDataSize);
+	}
+
+	// data plus key and dataSize for each record
+	int32_t mem = m_memOccupied - m_overhead * numUsedNodes + (m_ks + 4) * numUsedNodes;
+	return (mem > 0) ? mem : 0;
+}
+
+// . returns false and sets g_errno on error
+// . throw all the records in this range into this list
+// . records added after we started are left out
+bool RdbSkipList::getList(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes,
+                          RdbList *list, int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const {
+	ScopedReadLock sl(m_lock);
+
+	uint32_t snapshot = m_addSeq.load(std::memory_order_acquire);
+
+	int32_t numNeg = 0;
+	int32_t numPos = 0;
+	if (numNegRecs) *numNegRecs = 0;
+	if (numPosRecs) *numPosRecs = 0;
+
+	// . set the start and end keys of this list
+	// . set lists's m_ownData member to true
+	list->reset();
+	// got set m_ks first so the set ( startKey, endKey ) works!
+	list->setKeySize(m_ks);
+	list->set(startKey, endKey);
+	list->setFixedDataSize(m_fixedDataSize);
+	list->setUseHalfKeys(useHalfKeys);
+	// bitch if list does not own his own data
+	if (!list->getOwnData()) {
+		g_errno = EBADENGINEER;
+		log(LOG_LOGIC, "db: rdbskiplist: getList: List does not own data");
+		return false;
+	}
+
+	if (minRecSizes == 0) return true;
+	if (m_numUsedNodes == 0) return true;
+
+	// get first node >= startKey
+	int32_t node = getNextNode_unlocked(collnum, startKey);
+	if (node < 0) return true;
+	// if it's already beyond endKey, give up
+	if (KEYCMP(getKey_unlocked(node), endKey, m_ks) > 0) return true;
+	// or if we hit a different collection number
+	if (m_collnums[node] > collnum) return true;
+
+	int32_t lastNode = -1;
+
+	// how much space would all records take if we stored them in a list?
+	int32_t growth = getMemOccupiedForList();
+
+	// do not allocate everything if we have a fixed data size and a finite minRecSizes
+	if (m_fixedDataSize >= 0 && minRecSizes >= 0) {
+		int32_t ng = minRecSizes + m_fixedDataSize + m_ks;
+		if (ng < growth && ng > minRecSizes) growth = ng;
+	}
+
+	// raise to virtual inifinite if not constraining us
+	if (minRecSizes < 0) minRecSizes = 0x7fffffff;
+
+	if (m_fixedDataSize < 0 || minRecSizes >= 2 * 1024 * 1024) {
+		growth = getMemOccupiedForList_unlocked(collnum, startKey, endKey, minRecSizes);
+	}
+
+	if (!list->growList(growth)) {
+		log(LOG_WARN, "db: Failed to grow list to %" PRId32" bytes for storing records from tree: %s.",
+		    growth, mstrerror(g_errno));
+		return false;
+	}
+
+	// stop when we've hit or just exceed minRecSizes or we're out of nodes
+	for (; node >= 0 && list->getListSize() < minRecSizes; node = getNextNode_unlocked(node)) {
+		const char *key = getKey_unlocked(node);
+
+		// stop before exceeding endKey
+		if (KEYCMP(key, endKey, m_ks) > 0) break;
+		// or if we hit a different collection number
+		if (m_collnums[node] != collnum) break;
+
+		ScopedLock sl2(getNodeLock(node));
+
+		// deleted since we found it, or added after we started
+		if (m_states[node].load(std::memory_order_relaxed) != state_used) continue;
+		if ((int32_t)(m_addSeqs[node] - snapshot) > 0) continue;
+
+		if (m_fixedDataSize == 0) {
+			if (!list->addRecord(key, 0, NULL)) {
+				log(LOG_WARN, "db: Failed to add record to tree list for %s: %s. Fix the growList algo.",
+				    m_dbname, mstrerror(g_errno));
+				return false;
+			}
+		} else {
+			int32_t dataSize = getDataSize_unlocked(node);
+
+			// do not allow negative keys to have data
+			if (KEYNEG(key)) {
+				dataSize = 0;
+			}
+
+			if (!list->addRecord(key, dataSize, m_data[node])) {
+				log(LOG_WARN, "db: Failed to add record to tree list for %s: %s. Fix the growList algo.",
+				    m_dbname, mstrerror(g_errno));
+				return false;
+			}
+		}
+
+		if (KEYNEG(key)) numNeg++;
+		else             numPos++;
+
+		lastNode = node;
+	}
+
+	if (numNegRecs) *numNegRecs = numNeg;
+	if (numPosRecs) *numPosRecs = numPos;
+
+	// record the last key inserted into the list
+	if (lastNode >= 0) {
+		list->setLastKey(getKey_unlocked(lastNode));
+	}
+
+	// reset the list's endKey if we hit the minRecSizes barrier cuz
+	// there may be more records before endKey than we put in "list"
+	if (list->getListSize() >= minRecSizes && lastNode >= 0) {
+		// use the last key we read as the new endKey
+		char newEndKey[MAX_KEY_BYTES];
+		KEYSET(newEndKey, getKey_unlocked(lastNode), m_ks);
+		// endKeys aren't allowed to be negative
+		if (KEYNEG(newEndKey, 0, m_ks)) KEYINC(newEndKey, m_ks);
+		// if we're using half keys set his half key bit
+		if (useHalfKeys) KEYOR(newEndKey, 0x02);
+		list->set(startKey, newEndKey);
+	}
+
+	// reset list ptr to point to first record
+	list->resetListPtr();
+
+	return true;
+}
+
+// number of nodes in [startKey,endKey] on a level, up to limit
+int32_t RdbSkipList::countRange(collnum_t collnum, const char *startKey, const char *endKey, int level, int32_t limit) const {
+	int32_t pred = -1;
+	for (int l = s_maxLevel - 1; l >= level; l--) {
+		int32_t cur = nextPtr(pred, l)->load(std::memory_order_acquire);
+		while (cur >= 0 && compareNode(cur, collnum, startKey) < 0) {
+			pred = cur;
+			cur = nextPtr(cur, l)->load(std::memory_order_acquire);
+		}
+	}
+
+	int32_t count = 0;
+	for (int32_t cur = nextPtr(pred, level)->load(std::memory_order_acquire);
+	     cur >= 0 && count < limit;
+	     cur = nextPtr(cur, level)->load(std::memory_order_acquire)) {
+		if (compareNode(cur, collnum, endKey) > 0) break;
+		if (level == 0 && isEmpty_unlocked(cur)) continue;
+		count++;
+	}
+	return count;
+}
+
+// . this just estimates the size of the list
+// . this returns total recSizes not # of NODES
+// . if the count is < 200 it returns an EXACT count
+// . right now it only works for dataless nodes (keys only)
+int32_t RdbSkipList::estimateListSize(collnum_t collnum, const char *startKey, const char *endKey, char *minKey, char *maxKey) const {
+	ScopedReadLock sl(m_lock);
+
+	// make these as benign as possible
+	if (minKey) KEYSET(minKey, endKey, m_ks);
+	if (maxKey) KEYSET(maxKey, startKey, m_ks);
+
+	int32_t count = countRange(collnum, startKey, endKey, 0, 200);
+	if (count < 200) {
+		return count * m_ks;
+	}
+
+	// count on the lowest level that has less than 200 nodes in the range.
+	// each level up holds ~1/4 of the nodes of the level below
+	for (int level = 1; level < s_maxLevel; level++) {
+		count = countRange(collnum, startKey, endKey, level, 200);
+		if (count < 200 || level == s_maxLevel - 1) {
+			int64_t estimate = (int64_t)count << (2 * level);
+			if (estimate < 200) estimate = 200;
+			int64_t size = estimate * m_ks;
+			return (size > 0x7fffffff) ? 0x7fffffff : (int32_t)size;
+		}
+	}
+
+	return count * m_ks;
+}
+
+bool RdbSkipList::collExists(collnum_t coll) const {
+	ScopedReadLock sl(m_lock);
+	int32_t node = getNextNode_unlocked(coll, KEYMIN());
+	return (node >= 0 && m_collnums[node] == coll);
+}
+
+bool RdbSkipList::is90PercentFull() const {
+	// now we /90 and /100 since multiplying overflowed
+	return (m_numUsedNodes / 90 >= m_numNodes / 100);
+}
+
+int32_t RdbSkipList::getNumNegativeKeys(collnum_t collnum) const {
+	// fix for collectionless rdbs
+	if (m_rdbId < 0) return m_numNegativeKeys;
+
+	CollectionRec *cr = g_collectiondb.getRec(collnum);
+	if (!cr) return 0;
+	return __atomic_load_n(&cr->m_numNegKeysInTree[(unsigned char)m_rdbId], __ATOMIC_RELAXED);
+}
+
+int32_t RdbSkipList::getNumPositiveKeys(collnum_t collnum) const {
+	// fix for collectionless rdbs
+	if (m_rdbId < 0) return m_numPositiveKeys;
+
+	CollectionRec *cr = g_collectiondb.getRec(collnum);
+	if (!cr) return 0;
+	return __atomic_load_n(&cr->m_numPosKeysInTree[(unsigned char)m_rdbId], __ATOMIC_RELAXED);
+}
+
+void RdbSkipList::cleanTree() {
+	ScopedWriteLock sl(m_lock);
+
+	// some trees always use 0 for all node collnum_t's
+	if (m_rdbId < 0) return;
+
+	int32_t count = 0;
+	collnum_t collnum = 0;
+	int32_t max = g_collectiondb.getNumRecs();
+
+	int32_t minUnusedNode = m_minUnusedNode;
+	for (int32_t i = 0; i < minUnusedNode; i++) {
+		if (m_states[i] != state_used) continue;
+		// is collnum valid?
+		if (m_collnums[i] >= 0 && m_collnums[i] < max && g_collectiondb.getRec(m_collnums[i])) continue;
+
+		collnum = m_collnums[i];
+		deleteNode_locked(i);
+		count++;
+	}
+
+	purgeDeletedNodes_unlocked();
+
+	if (count == 0) return;
+	log(LOG_LOGIC, "db: Removed %" PRId32" records from %s tree for invalid collection number %i.",
+	    count, m_dbname, collnum);
+}
+
+
+// . caller should call f->set() himself
+// . returns false if blocked, true otherwise
+// . sets g_errno on error
+bool RdbSkipList::fastSave(const char *dir, bool useThread, void *state, void (*callback)(void *)) {
+	logTrace(g_conf.m_logTraceRdbTree, "BEGIN. dir=%s", dir);
+
+	if (g_conf.m_readOnlyMode) {
+		logTrace(g_conf.m_logTraceRdbTree, "END. Read only mode. Returning true.");
+		return true;
+	}
+
+	// we do not need a save
+	if (!m_needsSave) {
+		logTrace(g_conf.m_logTraceRdbTree, "END. Don't need to save. Returning true.");
+		return true;
+	}
+
+	// return false if already in the middle of saving
+	if (m_isSaving.exchange(true)) {
+		logTrace(g_conf.m_logTraceRdbTree, "END. Is already saving. Returning false.");
+		return false;
+	}
+
+	logf(LOG_INFO, "db: Saving %s%s-saved.dat", dir, m_dbname);
+
+	strncpy(m_dir, dir, sizeof(m_dir) - 1);
+	m_dir[sizeof(m_dir) - 1] = '\0';
+
+	m_state    = state;
+	m_callback = callback;
+	m_errno    = 0;
+
+	if (useThread) {
+		if (g_jobScheduler.submit(saveWrapper, saveDoneWrapper, this, thread_type_unspecified_io, 1/*niceness*/)) {
+			return false;
+		}
+
+		if (g_jobScheduler.are_new_jobs_allowed()) {
+			log(LOG_WARN, "db: Thread creation failed. Blocking while saving tree. Hurts performance.");
+		}
+	}
+
+	// no threads
+	saveWrapper(this);
+	saveDoneWrapper(this, job_exit_normal);
+
+	logTrace(g_conf.m_logTraceRdbTree, "END. Returning true.");
+
+	// we did not block
+	return true;
+}
+
+void RdbSkipList::saveWrapper(void *state) {
+	logTrace(g_conf.m_logTraceRdbTree, "BEGIN");
+
+	RdbSkipList *that = (RdbSkipList *)state;
+
+	// anything added or deleted from now on makes us need another save
+	that->m_needsSave = false;
+
+	that->m_errno = 0;
+
+	if (that->m_ownData) {
+		// we free data on replace/delete so nothing may change while we write it
+		ScopedWriteLock sl(that->m_lock);
+		that->fastSave_unlocked();
+	} else {
+		// adds and reads go on while we save. the data is not freed by us
+		ScopedReadLock sl(that->m_lock);
+		that->fastSave_unlocked();
+	}
+
+	if (g_errno && !that->m_errno) {
+		that->m_errno = g_errno;
+	}
+
+	if (that->m_errno) {
+		that->m_needsSave = true;
+		log(LOG_ERROR, "db: Had error saving tree to disk for %s: %s.", that->m_dbname, mstrerror(that->m_errno));
+	} else {
+		log(LOG_INFO, "db: Done saving %s with %" PRId32" keys (%" PRId64" bytes)",
+		    that->m_dbname, that->getNumUsedNodes(), that->m_bytesWritten);
+	}
+
+	// resume adding
+	that->m_isSaving = false;
+
+	logTrace(g_conf.m_logTraceRdbTree, "END");
+}
+
+void RdbSkipList::saveDoneWrapper(void *state, job_exit_t exit_type) {
+	logTrace(g_conf.m_logTraceRdbTree, "BEGIN");
+
+	RdbSkipList *that = (RdbSkipList *)state;
+
+	// store save error into g_errno
+	g_errno = that->m_errno;
+
+	if (that->m_callback) {
+		that->m_callback(that->m_state);
+	}
+
+	logTrace(g_conf.m_logTraceRdbTree, "END");
+}
+
+// . lay out the sorted nodes [lo,hi) as a perfectly balanced tree
+// . returns the head node, or -1 if empty
+static int32_t layoutBalancedTree(int32_t lo, int32_t hi, int32_t parent, int32_t *left, int32_t *right, int32_t *parents, char *depth) {
+	if (lo >= hi) {
+		return -1;
+	}
+
+	int32_t mid = lo + (hi - lo) / 2;
+	parents[mid] = parent;
+	left[mid] = layoutBalancedTree(lo, mid, mid, left, right, parents, depth);
+	right[mid] = layoutBalancedTree(mid + 1, hi, mid, left, right, parents, depth);
+
+	char leftDepth = (left[mid] >= 0) ? depth[left[mid]] : 0;
+	char rightDepth = (right[mid] >= 0) ? depth[right[mid]] : 0;
+	depth[mid] = std::max(leftDepth, rightDepth) + 1;
+	return mid;
+}
+
+// . write the records in the RdbTree save format
+// . returns false and sets m_errno on error
+// . NO USING g_errno IN A DAMN THREAD!!!!!!!!!!!!!!!!!!!!!!!!!
+bool RdbSkipList::fastSave_unlocked() {
+	if (g_conf.m_readOnlyMode) return true;
+
+	char s[1024];
+	sprintf(s, "%s/%s-saving.dat", m_dir, m_dbname);
+	int fd = ::open(s, O_RDWR | O_CREAT | O_TRUNC, getFileCreationFlags());
+	if (fd < 0) {
+		m_errno = errno;
+		log(LOG_ERROR, "db: Could not open %s for writing: %s.", s, mstrerror(errno));
+		return false;
+	}
+
+	// take a snapshot of the records in key order
+	struct SavedNode {
+		int32_t m_node;
+		const char *m_data;
+		int32_t m_dataSize;
+	};
+	std::vector<SavedNode> nodes;
+	nodes.reserve(m_numUsedNodes);
+
+	uint32_t snapshot = m_addSeq.load(std::memory_order_acquire);
+	for (int32_t node = getFirstNode_unlocked(); node >= 0; node = getNextNode_unlocked(node)) {
+		ScopedLock sl(getNodeLock(node));
+		if (m_states[node].load(std::memory_order_relaxed) != state_used) continue;
+		if ((int32_t)(m_addSeqs[node] - snapshot) > 0) continue;
+
+		SavedNode savedNode;
+		savedNode.m_node = node;
+		savedNode.m_data = m_data ? m_data[node] : NULL;
+		savedNode.m_dataSize = m_data ? getDataSize_unlocked(node) : 0;
+		nodes.push_back(savedNode);
+	}
+
+	// the tree structure is not used by our fastLoad() but makes the file
+	// loadable by RdbTree
+	int32_t numNodes = nodes.size();
+	std::vector<int32_t> left(numNodes);
+	std::vector<int32_t> right(numNodes);
+	std::vector<int32_t> parents(numNodes);
+	std::vector<char> depth(numNodes);
+	int32_t headNode = layoutBalancedTree(0, numNodes, -1, left.data(), right.data(), parents.data(), depth.data());
+
+	errno = 0;
+	int64_t offset = 0;
+	int64_t br = 0;
+	static const bool doBalancing = true;
+	int32_t totalNodes = std::max(m_numNodes, numNodes);
+	br += pwrite(fd, &totalNodes, 4, offset); offset += 4;
+	br += pwrite(fd, &m_fixedDataSize, 4, offset); offset += 4;
+	br += pwrite(fd, &numNodes, 4, offset); offset += 4;
+	br += pwrite(fd, &headNode, 4, offset); offset += 4;
+	br += pwrite(fd, &numNodes, 4, offset); offset += 4; // next node
+	br += pwrite(fd, &numNodes, 4, offset); offset += 4; // min unused node
+	br += pwrite(fd, &doBalancing, sizeof(doBalancing), offset);
+	offset += sizeof(doBalancing);
+	br += pwrite(fd, &m_ownData, sizeof(m_ownData), offset);
+	offset += sizeof(m_ownData);
+	if (br != offset) {
+		m_errno = errno;
+		close(fd);
+		log(LOG_WARN, "db: Failed to save tree1 for %s: %s.", m_dbname, mstrerror(errno));
+		return false;
+	}
+
+	std::vector<collnum_t> collnums;
+	std::vector<char> keys;
+	std::vector<int32_t> sizes;
+	std::vector<char> zeroes(m_fixedDataSize > 0 ? m_fixedDataSize : 0, 0);
+
+	for (int32_t start = 0; start < numNodes; start += BLOCK_SIZE) {
+		int32_t n = std::min(numNodes - start, BLOCK_SIZE);
+
+		collnums.resize(n);
+		keys.resize(n * m_ks);
+		sizes.resize(n);
+		for (int32_t i = 0; i < n; i++) {
+			int32_t node = nodes[start + i].m_node;
+			collnums[i] = m_collnums[node];
+			memcpy(&keys[i * m_ks], getKey_unlocked(node), m_ks);
+			sizes[i] = nodes[start + i].m_dataSize;
+		}
+
+		int64_t blockOffset = offset;
+		br = 0;
+		br += pwrite(fd, collnums.data(), n * sizeof(collnum_t), offset); offset += n * sizeof(collnum_t);
+		br += pwrite(fd, keys.data(), n * m_ks, offset); offset += n * m_ks;
+		br += pwrite(fd, &left[start], n * 4, offset); offset += n * 4;
+		br += pwrite(fd, &right[start], n * 4, offset); offset += n * 4;
+		br += pwrite(fd, &parents[start], n * 4, offset); offset += n * 4;
+		br += pwrite(fd, &depth[start], n, offset); offset += n;
+		if (m_fixedDataSize == -1) {
+			br += pwrite(fd, sizes.data(), n * 4, offset); offset += n * 4;
+		}
+
+		if (m_fixedDataSize != 0) {
+			for (int32_t i = start; i < start + n; i++) {
+				const SavedNode &savedNode = nodes[i];
+				if (savedNode.m_dataSize <= 0) continue;
+				const char *data = savedNode.m_data ? savedNode.m_data : zeroes.data();
+				br += pwrite(fd, data, savedNode.m_dataSize, offset);
+				offset += savedNode.m_dataSize;
+			}
+		}
+
+		if (br != offset - blockOffset) {
+			m_errno = errno;
+			close(fd);
+			log(LOG_WARN, "db: Failed to save tree2 for %s: %s.", m_dbname, mstrerror(errno));
+			return false;
+		}
+	}
+
+	m_bytesWritten = offset;
+	close(fd);
+
+	char s2[1024];
+	sprintf(s2, "%s/%s-saved.dat", m_dir, m_dbname);
+	if (::rename(s, s2) == -1) {
+		logError("Error renaming file [%s] to [%s] (%d: %s)", s, s2, errno, mstrerror(errno));
+	}
+
+	return true;
+}
+
+// . loads a file written by us or by RdbTree
+// . caller should call f->set() himself
+// . returns false and sets g_errno on error (sometimes g_errno not set)
+bool RdbSkipList::fastLoad(BigFile *f, RdbMem *stack) {
+	ScopedWriteLock sl(m_lock);
+
+	log(LOG_INIT, "db: Loading %s.", f->getFilename());
+
+	if (!f->open(O_RDONLY)) {
+		log(LOG_ERROR, "db: open failed");
+		return false;
+	}
+
+	int32_t fsize = f->getFileSize();
+	int64_t offset = 0;
+	int32_t header = 4 * 6 + 1 + sizeof(m_ownData);
+	if (fsize < header) {
+		f->close();
+		g_errno = EBADFILE;
+		log(LOG_ERROR, "db: file size smaller than header");
+		return false;
+	}
+
+	int32_t n, fixedDataSize, numUsedNodes;
+	bool doBalancing, ownData;
+	int32_t headNode, nextNode, minUnusedNode;
+	f->read(&n, 4, offset); offset += 4;
+	f->read(&fixedDataSize, 4, offset); offset += 4;
+	f->read(&numUsedNodes, 4, offset); offset += 4;
+	f->read(&headNode, 4, offset); offset += 4;
+	f->read(&nextNode, 4, offset); offset += 4;
+	f->read(&minUnusedNode, 4, offset); offset += 4;
+	f->read(&doBalancing, sizeof(doBalancing), offset);
+	offset += sizeof(doBalancing);
+	f->read(&ownData, sizeof(m_ownData), offset);
+	offset += sizeof(m_ownData);
+	if (g_errno) {
+		f->close();
+		log(LOG_ERROR, "db: read error: %s", mstrerror(g_errno));
+		return false;
+	}
+
+	if (m_fixedDataSize != fixedDataSize || !doBalancing || m_ownData != ownData) {
+		f->close();
+		log(LOG_LOGIC, "db: rdbskiplist: fastload: Bad parms. File may be corrupt or a key attribute was changed in "
+		    "the code and is not reflected in this file.");
+		return false;
+	}
+
+	int32_t nodeSize = (sizeof(collnum_t) + m_ks + 4 + 4 + 4);
+	int32_t minFileSize = header + minUnusedNode * nodeSize;
+	minFileSize += minUnusedNode;
+	if (fixedDataSize == -1) minFileSize += minUnusedNode * 4;
+	if ((fixedDataSize == 0 && fsize != minFileSize) || fsize < minFileSize) {
+		g_errno = EBADFILE;
+		log(LOG_ERROR, "db: File size of %s is %" PRId32", should be %" PRId32". File may be corrupted.",
+		    f->getFilename(), fsize, minFileSize);
+		f->close();
+		return false;
+	}
+
+	clear_unlocked();
+
+	// we store the nodes compacted so we only need room for the used ones
+	if (m_numNodes < numUsedNodes) {
+		log(LOG_INIT, "db: Growing tree to make room for %s", f->getFilename());
+		freeNodes_unlocked();
+		if (!allocNodes_unlocked(numUsedNodes)) {
+			f->close();
+			log(LOG_ERROR, "db: Failed to grow tree");
+			return false;
+		}
+	}
+
+	m_corrupt = 0;
+
+	for (int32_t start = 0; start < minUnusedNode; start += BLOCK_SIZE) {
+		int32_t bytesRead = fastLoadBlock_unlocked(f, start, minUnusedNode, stack, offset);
+		if (bytesRead < 0) {
+			f->close();
+			if (!g_errno) g_errno = EBADFILE;
+			return false;
+		}
+		offset += bytesRead;
+	}
+
+	if (m_corrupt) {
+		log(LOG_WARN, "admin: Loaded %" PRId32" corrupted recs in tree for %s.", m_corrupt, m_dbname);
+	}
+
+	rebuild_unlocked();
+
+	m_needsSave = false;
+
+	return true;
+}
+
+// . return bytes loaded
+// . returns -1 and sets g_errno on error
+int32_t RdbSkipList::fastLoadBlock_unlocked(BigFile *f, int32_t start, int32_t totalNodes, RdbMem *stack, int64_t offset) {
+	int32_t n = std::min(totalNodes - start, BLOCK_SIZE);
+	int64_t oldOffset = offset;
+
+	std::vector<collnum_t> collnums(n);
+	std::vector<char> keys(n * m_ks);
+	std::vector<int32_t> parents(n);
+	std::vector<int32_t> sizes(n, m_fixedDataSize > 0 ? m_fixedDataSize : 0);
+
+	f->read(collnums.data(), n * sizeof(collnum_t), offset); offset += n * sizeof(collnum_t);
+	f->read(keys.data(), n * m_ks, offset); offset += n * m_ks;
+	// left and right kids are not needed. we link the nodes ourselves
+	offset += n * 4 * 2;
+	f->read(parents.data(), n * 4, offset); offset += n * 4;
+	// nor the depths
+	offset += n;
+	if (m_fixedDataSize == -1) {
+		f->read(sizes.data(), n * 4, offset); offset += n * 4;
+	}
+	if (g_errno) {
+		log(LOG_ERROR, "db: Failed to read %s: %s.", f->getFilename(), mstrerror(g_errno));
+		return -1;
+	}
+
+	// the data of all non-empty nodes follows
+	int32_t bufSize = 0;
+	if (m_fixedDataSize != 0) {
+		for (int32_t i = 0; i < n; i++) {
+			if (parents[i] == -2) continue;
+			if (sizes[i] < 0) {
+				g_errno = EBADFILE;
+				log(LOG_ERROR, "db: Encountered record with corrupted size parameter of %" PRId32" in %s.",
+				    sizes[i], f->getFilename());
+				return -1;
+			}
+			bufSize += sizes[i];
+		}
+	}
+
+	char *buf = NULL;
+	if (bufSize > 0) {
+		buf = (char *)stack->allocData(bufSize);
+		if (!buf) {
+			log(LOG_ERROR, "db: Failed to allocate %" PRId32" bytes to read %s. Increase tree size for it in gb.conf.",
+			    bufSize, f->getFilename());
+			return -1;
+		}
+
+		f->read(buf, bufSize, offset);
+		if (g_errno) return -1;
+		offset += bufSize;
+	}
+
+	int32_t max = g_collectiondb.getNumRecs();
+	for (int32_t i = 0; i < n; i++) {
+		if (parents[i] == -2) continue;
+
+		char *data = buf;
+		int32_t dataSize = (m_fixedDataSize != 0) ? sizes[i] : 0;
+		buf += dataSize;
+
+		// watch out for bad collnums... corruption...
+		collnum_t c = collnums[i];
+		if (m_rdbId >= 0 && (c < 0 || c >= max || !g_collectiondb.getRec(c))) {
+			m_corrupt++;
+			continue;
+		}
+
+		if (m_minUnusedNode >= m_numNodes) {
+			g_errno = EBADFILE;
+			log(LOG_ERROR, "db: %s has more records than it says.", f->getFilename());
+			return -1;
+		}
+
+		int32_t node = m_minUnusedNode++;
+		const char *key = &keys[i * m_ks];
+		m_collnums[node] = c;
+		KEYSET(m_keys + node * m_ks, key, m_ks);
+		if (m_fixedDataSize != 0) m_data[node] = data;
+		if (m_fixedDataSize == -1) m_sizes[node] = dataSize;
+		m_addSeqs[node] = m_addSeq.fetch_add(1) + 1;
+		m_states[node] = state_used;
+
+		m_memOccupied += m_overhead + dataSize;
+		m_memAllocated += dataSize;
+		increaseNodeCount(c, key);
+	}
+
+	return offset - oldOffset;
+}
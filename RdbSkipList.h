@@ -0,0 +1,288 @@
+// . the in-memory part (memtable) of Rdbs that don't use RdbBuckets, ie.
+//   titledb, spiderdb and doledb
+// . a skip list over parallel node arrays. Replaces RdbTree for Rdb::m_tree,
+//   which serialized every add from Msg4In and every getList from Msg5 on a
+//   single mutex
+// . adds, deletes and reads all run concurrently under a shared lock:
+//   . new nodes are linked in with compare-and-swap, level 0 first and then
+//     the upper levels. A node that is linked in is never unlinked while the
+//     shared lock is held
+//   . deletes are logical. The node is marked deleted and stays in the list
+//     until the next purge (under the exclusive lock). Re-adding the key
+//     revives the node with its original add sequence number, so to
+//     getList() a revive is a replace
+//   . the data pointer/size of a node is guarded by one of a set of striped
+//     mutexes so a reader never sees half of a replace
+// . getList() is a snapshot with respect to adds: records added after the
+//   read started are not returned, so a dump or a Msg5 read doesn't chase an
+//   ever-growing range
+// . clear/delColl/fastLoad/fixTree and the doledb memory reclaim take the
+//   exclusive lock (getLock())
+// . node storage is allocated up front in set() and never moves, the same
+//   maxNumNodes limit as RdbTree applies
+// . the save file is in the RdbTree format (nodes are written in key order
+//   as a balanced tree) so saved trees can be loaded by either
+
+#ifndef GB_RDBSKIPLIST_H
+#define GB_RDBSKIPLIST_H
+
+#include <atomic>
+#include <vector>
+#include "JobScheduler.h" //for job_exit_t
+#include "types.h"
+#include "GbMutex.h"
+#include "GbRwLock.h"
+
+class RdbList;
+class BigFile;
+class RdbMem;
+
+class RdbSkipList {
+public:
+	RdbSkipList();
+	~RdbSkipList();
+
+	// . a fixedDataSize of -1 means each node has data of a variable size
+	// . set maxMem to -1 for no max
+	// . returns false & sets errno if fails to alloc "maxNumNodes" nodes
+	bool set(int32_t fixedDataSize, int32_t maxNumNodes, int32_t maxMem, bool ownData,
+	         const char *allocName, const char *dbname = NULL, char keySize = 12, char rdbId = -1);
+
+	// frees the used memory, etc.
+	void reset();
+
+	// . this just makes all the nodes available for occupation
+	// . returns # of occupied nodes we liberated
+	int32_t clear();
+
+	// . shared: the node accessors below (the _unlocked methods)
+	// . exclusive: setData_unlocked(), fixTree_unlocked()
+	GbRwLock& getLock() { return m_lock; }
+
+	// . this will overwrite nodes with the same key
+	// . returns false and sets g_errno if there are no more nodes
+	// . don't free your data because we don't copy it!
+	bool addNode(collnum_t collnum, const char *key, char *data, int32_t dataSize);
+
+	bool getNode(collnum_t collnum, const char *key) const;
+
+	// . returns true iff was found and deleted
+	// . frees the data if we own it
+	bool deleteNode(collnum_t collnum, const char *key, bool freeData);
+
+	// . throw all the records in this range into this list
+	// . sets list->m_lastKey to last key inserted into the list
+	// . returns false if outta memory
+	bool getList(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes, RdbList *list,
+	             int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const;
+
+	// estimate the size of the list defined by these keys (exact if small)
+	int32_t estimateListSize(collnum_t collnum, const char *startKey, const char *endKey, char *minKey, char *maxKey) const;
+
+	bool collExists(collnum_t coll) const;
+
+	bool isSaving() const { return m_isSaving; }
+	bool needsSave() const { return m_needsSave; }
+
+	// node iteration. deleted nodes are skipped. returns -1 at the end
+	int32_t getFirstNode_unlocked() const;
+	int32_t getNextNode_unlocked(int32_t node) const;
+	// first node whose key is >= key
+	int32_t getNextNode_unlocked(collnum_t collnum, const char *key) const;
+
+	collnum_t getCollnum_unlocked(int32_t node) const { return m_collnums[node]; }
+	const char *getKey_unlocked(int32_t node) const { return m_keys + node * m_ks; }
+	const char *getData_unlocked(int32_t node) const { return m_data[node]; }
+	void setData_unlocked(int32_t node, char *data) { m_data[node] = data; }
+	int32_t getDataSize_unlocked(int32_t node) const;
+
+	// true if the node is not holding a record (free or deleted)
+	bool isEmpty_unlocked(int32_t node) const { return m_states[node].load(std::memory_order_acquire) != state_used; }
+
+	// highest node # ever used + 1
+	int32_t getMinUnusedNode_unlocked() const { return m_minUnusedNode; }
+
+	bool isEmpty() const { return m_numUsedNodes == 0; }
+
+	int32_t getNumUsedNodes() const { return m_numUsedNodes; }
+	int32_t getNumUsedNodes_unlocked() const { return m_numUsedNodes; }
+
+	int32_t getNumAvailNodes() const { return m_numNodes - m_numUsedNodes; }
+
+	// negative and postive counts
+	int32_t getNumNegativeKeys() const { return m_numNegativeKeys; }
+	int32_t getNumPositiveKeys() const { return m_numPositiveKeys; }
+
+	int32_t getNumNegativeKeys(collnum_t collnum) const;
+	int32_t getNumPositiveKeys(collnum_t collnum) const;
+
+	// how much mem, including data, is used by this class?
+	int32_t getMemAllocated() const { return m_memAllocated; }
+
+	// how much of the alloc'd mem is actually in use holding data
+	int32_t getMemOccupied() const { return m_memOccupied; }
+
+	int32_t getMaxMem() const { return m_maxMem; }
+
+	// how much mem the tree would take if it were made into a list
+	int32_t getMemOccupiedForList() const;
+
+	// how much mem does this use, not including stored data
+	int32_t getTreeOverhead() const { return m_overhead * m_numNodes; }
+
+	// . Rdb uses this to determine when to dump to disk
+	bool is90PercentFull() const;
+
+	// . load & save quickly
+	// . returns false on error, true otherwise
+	bool fastLoad(BigFile *f, RdbMem *memStack);
+
+	// . saves with a thread if useThread is true
+	// . returns false if blocked, true otherwise
+	// . sets g_errno on error
+	bool fastSave(const char *dir, bool useThread, void *state, void (*callback)(void *));
+
+	void verifyIntegrity();
+
+	bool checkTree_unlocked(bool printMsgs, bool doChainTest) const;
+
+	bool fixTree();
+	bool fixTree_unlocked();
+
+	// remove recs that have invalid collnums
+	void cleanTree();
+
+	void delColl(collnum_t collnum);
+
+	// number of logically deleted nodes waiting to be purged
+	int32_t getNumDeletedNodes() const { return m_numDeletedNodes; }
+
+private:
+	static const int s_maxLevel = 16;
+	static const int s_numNodeLocks = 256;
+
+	enum {
+		state_free    = 0,
+		state_used    = 1,
+		state_deleted = 2,
+	};
+
+	static void saveWrapper(void *state);
+	static void saveDoneWrapper(void *state, job_exit_t exit_type);
+
+	void reset_unlocked();
+	int32_t clear_unlocked();
+
+	bool allocNodes_unlocked(int32_t numNodes);
+	void freeNodes_unlocked();
+
+	std::atomic<int32_t> *nextPtr(int32_t node, int level) const {
+		if (node < 0) return &m_head[level];
+		if (level == 0) return &m_next[node];
+		return &m_towerPool[m_towers[node] + level - 1];
+	}
+
+	int compareNode(int32_t node, collnum_t collnum, const char *key) const;
+
+	// . fill preds/succs with the nodes around key on each level
+	// . returns the node with key, or -1
+	int32_t findPosition(collnum_t collnum, const char *key, int32_t *preds, int32_t *succs) const;
+
+	// first node >= key, deleted ones included
+	int32_t lowerBound(collnum_t collnum, const char *key) const;
+
+	// returns the node, or -1 if there are no free nodes
+	int32_t addNode_shared(collnum_t collnum, const char *key, char *data, int32_t dataSize);
+	// set the data of an existing node, reviving it if it was deleted
+	void replaceNode(int32_t node, char *data, int32_t dataSize);
+	int32_t allocNode();
+	void releaseNode(int32_t node);
+	void setLevel(int32_t node, int level);
+
+	void increaseNodeCount(collnum_t collnum, const char *key);
+	void decreaseNodeCount(collnum_t collnum, const char *key);
+
+	// mark node deleted. caller holds the node lock
+	void deleteNode_locked(int32_t node);
+
+	// unlink and free deleted nodes
+	void purgeDeletedNodes_unlocked();
+
+	// relink all used nodes in key order from scratch. drops duplicates
+	void rebuild_unlocked();
+
+	bool shouldPurge() const;
+
+	int32_t getMemOccupiedForList_unlocked(collnum_t collnum, const char *startKey, const char *endKey,
+	                                       int32_t minRecSizes) const;
+	int32_t countRange(collnum_t collnum, const char *startKey, const char *endKey, int level, int32_t limit) const;
+
+	GbMutex &getNodeLock(int32_t node) const { return m_nodeMtx[node & (s_numNodeLocks - 1)]; }
+
+	bool fastSave_unlocked();
+	int32_t fastLoadBlock_unlocked(BigFile *f, int32_t start, int32_t totalNodes, RdbMem *stack, int64_t offset);
+
+	mutable GbRwLock m_lock;
+	mutable GbMutex m_nodeMtx[s_numNodeLocks];
+
+	// cannot add while saving
+	std::atomic<bool> m_isSaving;
+	// true if modified and needs to be saved
+	std::atomic<bool> m_needsSave;
+
+	char  m_rdbId;
+	char  m_dir[128];
+	char  m_dbname[32];
+
+	// this callback called when fastSave is complete
+	void     *m_state;
+	void    (* m_callback) (void *state );
+
+	// are we responsible for freeing nodes' data
+	bool    m_ownData;
+
+	// each node has these datum
+	collnum_t *m_collnums;
+	char      *m_keys;
+	char     **m_data;      // NULL iff m_fixedDataSize is 0
+	int32_t   *m_sizes;     // NULL unless m_fixedDataSize is -1
+	uint32_t  *m_addSeqs;   // m_addSeq when the node was linked in. for snapshot reads
+	std::atomic<char> *m_states;
+	char      *m_levels;
+	int32_t   *m_towers;    // offset of levels 1.. in m_towerPool, or -1
+	mutable std::atomic<int32_t> *m_next;      // level 0
+	mutable std::atomic<int32_t> *m_towerPool; // levels 1..
+
+	mutable std::atomic<int32_t> m_head[s_maxLevel];
+
+	int32_t m_numNodes;      // capacity
+	int32_t m_towerPoolSize;
+	std::atomic<int32_t> m_towerPoolUsed;
+
+	std::atomic<int32_t> m_minUnusedNode;
+	std::atomic<int32_t> m_numUsedNodes;
+	std::atomic<int32_t> m_numDeletedNodes;
+	std::atomic<int32_t> m_numNegativeKeys;
+	std::atomic<int32_t> m_numPositiveKeys;
+	std::atomic<int32_t> m_memAllocated;
+	std::atomic<int32_t> m_memOccupied;
+	std::atomic<uint32_t> m_addSeq;
+
+	// nodes freed by purge, reused before m_minUnusedNode grows
+	GbMutex m_freeNodesMtx;
+	std::vector<int32_t> m_freeNodes;
+	std::atomic<int32_t> m_numFreeNodes;
+
+	int32_t    m_overhead;
+	int32_t    m_maxMem;
+	int32_t    m_fixedDataSize;
+
+	const char *m_allocName;
+
+	int64_t m_bytesWritten;
+	int32_t m_errno;
+	char m_ks;
+	int32_t m_corrupt;
+};
+
+#endif // GB_RDBSKIPLIST_H
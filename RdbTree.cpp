@@ -6,6 +6,7 @@
 #include "BigFile.h"
 #include "RdbList.h"
 #include "Spider.h"
+#include "TitleRecCodec.h"
 #include "Process.h"
 #include "Conf.h"
 #include "ScopedLock.h"
@@ -934,7 +935,7 @@ bool RdbTree::fixTree_unlocked() {
 			
 		if ( isTitledb && m_data[i] ) {
 			char *data = m_data[i];
-			int32_t ucompSize = *(int32_t *)data;
+			int32_t ucompSize = getTitleRecUncompressedSize(*(int32_t *)data);
 			if ( ucompSize < 0 || ucompSize > 100000000 ) {
 				log("db: removing titlerec with uncompressed "
 				     "size of %i from tree",(int)ucompSize);
@@ -1025,7 +1026,7 @@ bool RdbTree::checkTree_unlocked(bool printMsgs, bool doChainTest) const {
 
 		if ( isTitledb && m_data[i] ) {
 			char *data = m_data[i];
-			int32_t ucompSize = *(int32_t *)data;
+			int32_t ucompSize = getTitleRecUncompressedSize(*(int32_t *)data);
 			if ( ucompSize < 0 || ucompSize > 100000000 ) {
 				log("db: found titlerec with uncompressed "
 					"size of %i from tree",(int)ucompSize);
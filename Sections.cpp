@@ -18,12 +18,21 @@
 #include "Abbreviations.h"
 #include "Process.h"
 #include "Posdb.h"
+#include "Arena.h"
 
 Sections::Sections ( ) {
 	m_sections = NULL;
+	m_arena = NULL;
 	reset();
 }
 
+bool Sections::reserveBuf ( SafeBuf *sb, int32_t need, const char *label ) {
+	if ( m_arena ) {
+		return m_arena->reserve ( sb, need, label );
+	}
+	return sb->reserve ( need, label );
+}
+
 void Sections::reset() {
 	m_sectionBuf.purge();
 	m_sectionPtrBuf.purge();
@@ -173,7 +182,7 @@ bool Sections::set( Words *w, Bits *bits, Url *url, char *coll, uint8_t contentT
 	m_sectionPtrBuf.setLabel("psectbuf");
 
 	// separate buf now for section ptr for each word
-	if ( ! m_sectionPtrBuf.reserve ( nw *sizeof(Section *)) ) return true;
+	if ( ! reserveBuf ( &m_sectionPtrBuf, nw *sizeof(Section *), "psectbuf" ) ) return true;
 	m_sectionPtrs = (Section **)m_sectionPtrBuf.getBufStart();
 
 	// allocate m_sectionBuf
@@ -181,7 +190,7 @@ bool Sections::set( Words *w, Bits *bits, Url *url, char *coll, uint8_t contentT
 
 	m_sectionBuf.setLabel ( "sectbuf" );
 
-	if ( ! m_sectionBuf.reserve ( need ) )
+	if ( ! reserveBuf ( &m_sectionBuf, need, "sectbuf" ) )
 		return true;
 
 	// point into it
@@ -182,6 +182,12 @@ public:
 
 	void reset();
 
+	// . get the section buffers from "arena" instead of the heap. stays
+	//   set across reset()
+	void setArena ( class Arena *arena ) {
+		m_arena = arena;
+	}
+
 	// . returns false if blocked, true otherwise
 	// . returns true and sets g_errno on error
 	// . sets m_sections[] array, 1-1 with words array "w"
@@ -248,6 +254,9 @@ public:
 	// see what section a word is in.
 	SafeBuf m_sectionPtrBuf;
 
+	class Arena *m_arena;
+	bool reserveBuf ( SafeBuf *sb, int32_t need, const char *label );
+
 	// assume no malloc
 	char  m_localBuf [ SECTIONS_LOCALBUFSIZE ];
 
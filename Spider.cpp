@@ -654,14 +654,6 @@ bool isAssignedToUs ( int32_t firstIp ) {
 //
 ///////////////////////////////////
 
-#define SIGN_EQ 1
-#define SIGN_NE 2
-#define SIGN_GT 3
-#define SIGN_LT 4
-#define SIGN_GE 5
-#define SIGN_LE 6
-
-
 class PatternData {
 public:
 	// hash of the subdomain or domain for this line in sitelist
@@ -1028,7 +1020,7 @@ bool updateSiteListBuf ( collnum_t collnum ,
 // . the url patterns all contain a domain now, so this can use the domain
 //   hash to speed things up
 // . return ptr to the start of the line in case it has "tag:" i guess
-static char *getMatchingUrlPattern(SpiderColl *sc, const SpiderRequest *sreq, char *tagArg) { // tagArg can be NULL
+static char *getMatchingUrlPattern(SpiderColl *sc, const SpiderRequest *sreq, const char *tagArg) { // tagArg can be NULL
 	logTrace( g_conf.m_logTraceSpider, "BEGIN" );
 
 	// if it is just a bunch of comments or blank lines, it is empty
@@ -1200,10 +1192,34 @@ static char *getMatchingUrlPattern(SpiderColl *sc, const SpiderRequest *sreq, ch
 	return NULL;
 }
 
+// . compare "a" to the number "b" of a url filter expression
+// . no sign matches anything
+static inline bool compareInt ( char sign , int32_t a , int32_t b ) {
+	if ( sign == SIGN_EQ && a != b ) return false;
+	if ( sign == SIGN_NE && a == b ) return false;
+	if ( sign == SIGN_GT && a <= b ) return false;
+	if ( sign == SIGN_LT && a >= b ) return false;
+	if ( sign == SIGN_GE && a <  b ) return false;
+	if ( sign == SIGN_LE && a >  b ) return false;
+	return true;
+}
+
+static inline bool compareFloat ( char sign , float a , float b ) {
+	if ( sign == SIGN_EQ && !almostEqualFloat(a, b) ) return false;
+	if ( sign == SIGN_NE && almostEqualFloat(a, b) ) return false;
+	if ( sign == SIGN_GT && a <= b ) return false;
+	if ( sign == SIGN_LT && a >= b ) return false;
+	if ( sign == SIGN_GE && a <  b ) return false;
+	if ( sign == SIGN_LE && a >  b ) return false;
+	return true;
+}
+
 // . this is called by SpiderCache.cpp for every url it scans in spiderdb
 // . we must skip certain rules in getUrlFilterNum() when doing to for Msg20
 //   because things like "parentIsRSS" can be both true or false since a url
 //   can have multiple spider recs associated with it!
+// . the rules are compiled into CollectionRec::m_urlFilterProgram when they
+//   change, so this just runs their ops
 int32_t getUrlFilterNum(const SpiderRequest *sreq,
 			SpiderReply	*srep,
 			int32_t		nowGlobal,
@@ -1243,1285 +1259,591 @@ int32_t getUrlFilterNum(const SpiderRequest *sreq,
 
 	if ( ! quotaTable ) quotaTable = &sc->m_localTable;
 
-	// CONSIDER COMPILING FOR SPEED:
-	// 1) each command can be combined into a bitmask on the spiderRequest
-	//    bits, or an access to m_siteNumInlinks, or a substring match
-	// 2) put all the strings we got into the list of Needles
-	// 3) then generate the list of needles the SpiderRequest/url matches
-	// 4) then reduce each line to a list of needles to have, a
-	//    min/max/equal siteNumInlinks, min/max/equal hopCount,
-	//    and a bitMask to match the bit flags in the SpiderRequest
+	// . rebuildUrlFilters() compiles them whenever they change
+	// . hold on to this one, it may swap in a new one while we run it
+	urlfilterprogram_ptr_t prog = cr->getUrlFilterProgram();
 
 	// stop at first regular expression it matches
-	for ( int32_t i = 0 ; i < cr->m_numRegExs ; i++ ) {
-		// get the ith rule
-		SafeBuf *sb = &cr->m_regExs[i];
-		//char *p = cr->m_regExs[i];
-		char *p = sb->getBufStart();
-
-checkNextRule:
-		// skip leading whitespace
-		while ( *p && isspace(*p) ) p++;
-
-		// do we have a leading '!'
-		bool val = 0;
-		if ( *p == '!' ) { val = 1; p++; }
-		// skip whitespace after the '!'
-		while ( *p && isspace(*p) ) p++;
-
-		if ( *p=='h' && strncmp(p,"hasauthorityinlink",18) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// skip if not valid (pageaddurl? injection?)
-			if ( ! sreq->m_hasAuthorityInlinkValid ) continue;
-			// if no match continue
-			if ( (bool)sreq->m_hasAuthorityInlink==val)continue;
-			// skip
-			p += 18;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+	for ( int32_t i = 0 ; i < prog->getNumRules() ; i++ ) {
+		// the op of the first expression of the ith rule
+		int32_t n = prog->getFirstOp ( i );
+
+		// . run the ops of the rule until one does not match, or
+		//   the last one did and the rule matches
+		// . "goto nextRule" if an expression does not match
+		while ( n >= 0 ) {
+			const UrlFilterOp *op = prog->getOp ( n );
+			// do we have a leading '!'
+			bool val = op->m_negate;
+
+			switch ( op->m_type ) {
+
+			case UFOP_FAIL:
+				goto nextRule;
+
+			// . we always match the "default" reg ex
+			// . this line must ALWAYS exist!
+			case UFOP_DEFAULT:
+				break;
 
-		if ( *p=='h' && strncmp(p,"hasreply",8) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if we got a reply, we are not new!!
-			//if ( (bool)srep == (bool)val ) continue;
-			if ( (bool)(sreq->m_hadReply) == (bool)val ) continue;
-			// skip it for speed
-			p += 8;
-			// check for &&
-			p = strstr(p, "&&");
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_HASAUTHORITYINLINK:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// skip if not valid (pageaddurl? injection?)
+				if ( ! sreq->m_hasAuthorityInlinkValid ) goto nextRule;
+				// if no match continue
+				if ( (bool)sreq->m_hasAuthorityInlink==val) goto nextRule;
+				break;
 
-		// hastmperror, if while spidering, the last reply was
-		// like EDNSTIMEDOUT or ETCPTIMEDOUT or some kind of
-		// usually temporary condition that warrants a retry
-		if ( *p=='h' && strncmp(p,"hastmperror",11) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// reply based
-			if ( ! srep ) continue;
-			// get our error code
-			int32_t errCode = srep->m_errCode;
-			// . make it zero if not tmp error
-			// . now have EDOCUNCHANGED and EDOCNOGOODDATE from
-			//   Msg13.cpp, so don't count those here...
-			if ( errCode != EDNSTIMEDOUT &&
-			     errCode != ETCPTIMEDOUT &&
-			     errCode != EDNSDEAD &&
-			     // add this here too now because we had some
-			     // seeds that failed one time and the crawl
-			     // never repeated after that!
-			     errCode != EBADIP &&
-			     // out of memory while crawling?
-			     errCode != ENOMEM &&
-			     errCode != ENETUNREACH &&
-			     errCode != EHOSTUNREACH )
-				errCode = 0;
-			// if no match continue
-			if ( (bool)errCode == val ) continue;
-			// skip
-			p += 11;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_HASREPLY:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if we got a reply, we are not new!!
+				if ( (bool)(sreq->m_hadReply) == (bool)val ) goto nextRule;
+				break;
 
-		if ( *p != 'i' ) goto skipi;
-
-		if ( strncmp(p,"isinjected",10) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if no match continue
-			if ( (bool)sreq->m_isInjecting==val ) continue;
-			// skip
-			p += 10;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// hastmperror, if while spidering, the last reply was
+			// like EDNSTIMEDOUT or ETCPTIMEDOUT or some kind of
+			// usually temporary condition that warrants a retry
+			case UFOP_HASTMPERROR: {
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// reply based
+				if ( ! srep ) goto nextRule;
+				// get our error code
+				int32_t errCode = srep->m_errCode;
+				// . make it zero if not tmp error
+				// . now have EDOCUNCHANGED and EDOCNOGOODDATE from
+				//   Msg13.cpp, so don't count those here...
+				if ( errCode != EDNSTIMEDOUT &&
+				     errCode != ETCPTIMEDOUT &&
+				     errCode != EDNSDEAD &&
+				     // add this here too now because we had some
+				     // seeds that failed one time and the crawl
+				     // never repeated after that!
+				     errCode != EBADIP &&
+				     // out of memory while crawling?
+				     errCode != ENOMEM &&
+				     errCode != ENETUNREACH &&
+				     errCode != EHOSTUNREACH )
+					errCode = 0;
+				// if no match continue
+				if ( (bool)errCode == val ) goto nextRule;
+				break;
 			}
-			p += 2;
-			goto checkNextRule;
-		}
 
-		if ( strncmp(p,"isdocidbased",12) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if no match continue
-			//if ( (bool)sreq->m_urlIsDocId==val ) continue;
-			if ( (bool)sreq->m_isPageReindex==val ) continue;
-			// skip
-			p += 12;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_ISINJECTED:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if no match continue
+				if ( (bool)sreq->m_isInjecting==val ) goto nextRule;
+				break;
 
-		if ( strncmp(p,"isreindex",9) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if no match continue
-			if ( (bool)sreq->m_isPageReindex==val ) continue;
-			// skip
-			p += 9;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_ISDOCIDBASED:
+			case UFOP_ISREINDEX:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if no match continue
+				if ( (bool)sreq->m_isPageReindex==val ) goto nextRule;
+				break;
 
-		// is it in the big list of sites?
-		if ( strncmp(p,"insitelist",10) == 0 ) {
-			// rebuild site list
-			if ( !sc->m_siteListIsEmptyValid ) {
-				updateSiteListBuf( sc->m_collnum, false, cr->m_siteListBuf.getBufStart() );
-			}
+			// is it in the big list of sites?
+			case UFOP_INSITELIST:
+				// rebuild site list
+				if ( !sc->m_siteListIsEmptyValid ) {
+					updateSiteListBuf( sc->m_collnum, false, cr->m_siteListBuf.getBufStart() );
+				}
 
-			// if there is no domain or url explicitly listed
-			// then assume user is spidering the whole internet
-			// and we basically ignore "insitelist"
-			if ( sc->m_siteListIsEmptyValid && sc->m_siteListIsEmpty ) {
-				// use a dummy row match
-				row = (char *)1;
-			} else if ( ! checkedRow ) {
-				// only do once for speed
-				checkedRow = true;
-				// this function is in PageBasic.cpp
-				row = getMatchingUrlPattern ( sc, sreq ,NULL);
-			}
+				// if there is no domain or url explicitly listed
+				// then assume user is spidering the whole internet
+				// and we basically ignore "insitelist"
+				if ( sc->m_siteListIsEmptyValid && sc->m_siteListIsEmpty ) {
+					// use a dummy row match
+					row = (char *)1;
+				} else if ( ! checkedRow ) {
+					// only do once for speed
+					checkedRow = true;
+					// this function is in PageBasic.cpp
+					row = getMatchingUrlPattern ( sc, sreq ,NULL);
+				}
 
-			// if we are not submitted from the add url api, skip
-			if ( (bool)row == val ) {
-				continue;
-			}
-			// skip
-			p += 10;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+				// if we are not submitted from the add url api, skip
+				if ( (bool)row == val ) goto nextRule;
+				break;
 
-		// . was it submitted from PageAddUrl.cpp?
-		// . replaces the "add url priority" parm
-		if ( strncmp(p,"isaddurl",8) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if we are not submitted from the add url api, skip
-			if ( (bool)sreq->m_isAddUrl == val ) continue;
-			// skip
-			p += 8;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			// . was it submitted from PageAddUrl.cpp?
+			// . replaces the "add url priority" parm
+			case UFOP_ISADDURL:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if we are not submitted from the add url api, skip
+				if ( (bool)sreq->m_isAddUrl == val ) goto nextRule;
+				break;
 
-		if ( p[0]=='i' && strncmp(p,"ismanualadd",11) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// . if we are not submitted from the add url api, skip
-			// . if we have '!' then val is 1
-			if ( sreq->m_isAddUrl    || 
-			     sreq->m_isInjecting ||
-			     sreq->m_isPageReindex ||
-			     sreq->m_isPageParser ) {
-				if ( val ) continue;
-			}
-			else {
-				if ( ! val ) continue;
-			}
-			// skip
-			p += 11;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_ISMANUALADD:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// . if we are not submitted from the add url api, skip
+				// . if we have '!' then val is 1
+				if ( sreq->m_isAddUrl    || 
+				     sreq->m_isInjecting ||
+				     sreq->m_isPageReindex ||
+				     sreq->m_isPageParser ) {
+					if ( val ) goto nextRule;
+				}
+				else {
+					if ( ! val ) goto nextRule;
+				}
+				break;
 
-		// does it have an rss inlink? we want to expedite indexing
-		// of such pages. i.e. that we gather from an rss feed that
-		// we got from a pingserver...
-		if ( strncmp(p,"isroot",6) == 0 ) {
-			// skip for msg20
-			//if ( isForMsg20 ) continue;
-			// this is a docid only url, no actual url, so skip
-			if ( sreq->m_isPageReindex ) continue;
-			// a fast check
-			const char *u = sreq->m_url;
-			// skip http
-			u += 4;
-			// then optional s for https
-			if ( *u == 's' ) u++;
-			// then ://
-			u += 3;
-			// scan until \0 or /
-			for ( ; *u && *u !='/' ; u++ );
-			// if \0 we are root
-			bool isRoot = true;
-			if ( *u == '/' ) {
-				u++;
-				if ( *u ) isRoot = false;
-			}
-			// if we are not root
-			if ( isRoot == val ) continue;
-			// skip
-			p += 6;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			case UFOP_ISROOT: {
+				// this is a docid only url, no actual url, so skip
+				if ( sreq->m_isPageReindex ) goto nextRule;
+				// a fast check
+				const char *u = sreq->m_url;
+				// skip http
+				u += 4;
+				// then optional s for https
+				if ( *u == 's' ) u++;
+				// then ://
+				u += 3;
+				// scan until \0 or /
+				for ( ; *u && *u !='/' ; u++ );
+				// if \0 we are root
+				bool isRoot = true;
+				if ( *u == '/' ) {
+					u++;
+					if ( *u ) isRoot = false;
+				}
+				// if we are not root
+				if ( isRoot == val ) goto nextRule;
+				break;
 			}
-			
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// we can now handle this guy since we have the latest
-		// SpiderReply, pretty much guaranteed
-		if ( strncmp(p,"isindexed",9) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// skip if reply does not KNOW because of an error
-			// since XmDoc::indexDoc() called
-			// XmlDoc::getNewSpiderReply() and did not have this
-			// info...
-			if ( srep && (bool)srep->m_isIndexedINValid ) continue;
-			// if no match continue
-			if ( srep && (bool)srep->m_isIndexed==val ) continue;
-			// allow "!isindexed" if no SpiderReply at all
-			if ( ! srep && val == 0 ) continue;
-			// skip
-			p += 9;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			// we can now handle this guy since we have the latest
+			// SpiderReply, pretty much guaranteed
+			case UFOP_ISINDEXED:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// skip if reply does not KNOW because of an error
+				// since XmDoc::indexDoc() called
+				// XmlDoc::getNewSpiderReply() and did not have this
+				// info...
+				if ( srep && (bool)srep->m_isIndexedINValid ) goto nextRule;
+				// if no match continue
+				if ( srep && (bool)srep->m_isIndexed==val ) goto nextRule;
+				// allow "!isindexed" if no SpiderReply at all
+				if ( ! srep && val == 0 ) goto nextRule;
+				break;
 
-		if ( strncmp(p,"ispingserver",12) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if no match continue
-			if ( (bool)sreq->m_isPingServer == val ) continue;
-			// skip
-			p += 12;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_ISPINGSERVER:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if no match continue
+				if ( (bool)sreq->m_isPingServer == val ) goto nextRule;
+				break;
 
-		if ( strncmp ( p , "isfakeip",8 ) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if no match continue
-			if ( (bool)sreq->m_fakeFirstIp == val ) continue;
-			p += 8;
-			p = strstr(p, "&&");
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_ISFAKEIP:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if no match continue
+				if ( (bool)sreq->m_fakeFirstIp == val ) goto nextRule;
+				break;
 
-		// check for "isrss" aka "rss"
-		if ( strncmp(p,"isrss",5) == 0 ) {
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// must have a reply
-			if ( ! srep ) continue;
-			// if we are not rss, we do not match this rule
-			if ( (bool)srep->m_isRSS == val ) continue; 
-			// skip it
-			p += 5;
-			// check for &&
-			p = strstr(p, "&&");
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+			// check for "isrss" aka "rss"
+			case UFOP_ISRSS:
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// must have a reply
+				if ( ! srep ) goto nextRule;
+				// if we are not rss, we do not match this rule
+				if ( (bool)srep->m_isRSS == val ) goto nextRule;
+				break;
 
-		// check for "isrss" aka "rss"
-		if ( strncmp(p,"isrssext",8) == 0 ) {
-			// if we are not rss, we do not match this rule
-			if ( (bool)sreq->m_isRSSExt == val ) continue; 
-			// skip it
-			p += 8;
-			// check for &&
-			p = strstr(p, "&&");
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+			// check for permalinks. for new outlinks we *guess* if its
+			// a permalink by calling isPermalink() function.
+			case UFOP_ISPERMALINK:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// must have a reply
+				if ( ! srep ) goto nextRule;
+				// if we are not rss, we do not match this rule
+				if ( (bool)srep->m_isPermalink == val ) goto nextRule;
+				break;
 
-		// check for permalinks. for new outlinks we *guess* if its
-		// a permalink by calling isPermalink() function.
-		if (!strncmp(p,"ispermalink",11) ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// must have a reply
-			if ( ! srep ) continue;
-			// if we are not rss, we do not match this rule
-			if ( (bool)srep->m_isPermalink == val ) continue; 
-			// skip it
-			p += 11;
-			// check for &&
-			p = strstr(p, "&&");
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
+			case UFOP_ISNEWREQUEST:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// skip if we are a new request and val is 1 (has '!')
+				if ( ! srep && val ) goto nextRule;
+				// skip if we are a new request and val is 1 (has '!')
+				if(srep&&sreq->m_addedTime>srep->m_spideredTime &&val)
+					goto nextRule;
+				// skip if we are old and val is 0 (does not have '!')
+				if(srep&&sreq->m_addedTime<=srep->m_spideredTime&&!val)
+					goto nextRule;
+				break;
 
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+			// kinda like isnewrequest, but has no reply. use hasreply?
+			case UFOP_ISNEW:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// if we got a reply, we are not new!!
+				if ( (bool)sreq->m_hadReply != (bool)val ) goto nextRule;
+				break;
 
-		// supports LF_ISPERMALINK bit for outlinks that *seem* to
-		// be permalinks but might not
-		if (!strncmp(p,"ispermalinkformat",17) ) {
-			// if we are not rss, we do not match this rule
-			if ( (bool)sreq->m_isUrlPermalinkFormat == val ) {
-				continue;
+			// iswww, means url is like www.xyz.com/...
+			case UFOP_ISWWW: {
+				// skip over http:// or https://
+				const char *u = sreq->m_url;
+				if ( u[4] == ':' ) u += 7;
+				if ( u[5] == ':' ) u += 8;
+				// url MUST be a www url
+				char isWWW = 0;
+				if( u[0] == 'w' &&
+				    u[1] == 'w' &&
+				    u[2] == 'w' ) isWWW = 1;
+				// skip if no match
+				if ( isWWW == val ) goto nextRule;
+				// TODO: fix www.knightstown.skepter.com
+				// maybe just have a bit in the spider request
+				// another rule?
+				break;
 			}
 
-			// check for &&
-			p = strstr(p, "&&");
-
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_TAG:
+				// if there is no domain or url explicitly listed
+				// then assume user is spidering the whole internet
+				// and we basically ignore "insitelist"
+				if ( sc->m_siteListIsEmpty && sc->m_siteListIsEmptyValid ) {
+					row = NULL;// no row
+				} else if ( ! checkedRow ) {
+					// only do once for speed
+					checkedRow = true;
+					// this function is in PageBasic.cpp
+					// . it also has to match the tag after "tag:"
+					row = getMatchingUrlPattern ( sc, sreq, op->m_str.c_str() );
+				}
+				// if we are not submitted from the add url api, skip
+				if ( (bool)row == val ) goto nextRule;
+				break;
 
-		// check for this
-		if ( strncmp(p,"isnewrequest",12) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// skip if we are a new request and val is 1 (has '!')
-			if ( ! srep && val ) continue;
-			// skip if we are a new request and val is 1 (has '!')
-			if(srep&&sreq->m_addedTime>srep->m_spideredTime &&val)
-				continue;
-			// skip if we are old and val is 0 (does not have '!')
-			if(srep&&sreq->m_addedTime<=srep->m_spideredTime&&!val)
-				continue;
-			// skip it for speed
-			p += 12;
-			// check for &&
-			p = strstr(p, "&&");
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// new quotas. 'sitepages' = pages from site.
+			// 'sitepages > 20 && seedcount <= 1 --> FILTERED'
+			case UFOP_SITEPAGES: {
+				// need a quota table for this
+				if ( ! quotaTable ) goto nextRule;
+				int32_t *valPtr ;
+				valPtr=(int32_t*)quotaTable->getValue(&sreq->m_siteHash32);
+				// if no count in table, that is strange, i guess
+				// skip for now???
+				int32_t a;
+				if ( ! valPtr ) a = 0;
+				else a = *valPtr;
+				if ( ! compareInt ( op->m_sign , a , op->m_intArg ) ) goto nextRule;
+				break;
 			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// kinda like isnewrequest, but has no reply. use hasreply?
-		if ( strncmp(p,"isnew",5) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// if we got a reply, we are not new!!
-			if ( (bool)sreq->m_hadReply != (bool)val ) continue;
-			// skip it for speed
-			p += 5;
-			// check for &&
-			p = strstr(p, "&&");
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
-		// iswww, means url is like www.xyz.com/...
-		if ( strncmp(p,"iswww", 5) == 0 ) {
-			// now this is a bit - doesn't seem to be working yet
-			//if ( (bool)sreq->m_isWWWSubdomain == (bool)val ) 
-			//	continue;
-			// skip "iswww"
-			p += 5;
-			// skip over http:// or https://
-			const char *u = sreq->m_url;
-			if ( u[4] == ':' ) u += 7;
-			if ( u[5] == ':' ) u += 8;
-			// url MUST be a www url
-			char isWWW = 0;
-			if( u[0] == 'w' &&
-			    u[1] == 'w' &&
-			    u[2] == 'w' ) isWWW = 1;
-			// skip if no match
-			if ( isWWW == val ) continue;
-			// TODO: fix www.knightstown.skepter.com
-			// maybe just have a bit in the spider request
-			// another rule?
-			p = strstr(p,"&&");
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// tld:cn 
+			case UFOP_TLD: {
+				// set it on demand
+				if ( tld == (char *)-1 )
+					tld = getTLDFast ( sreq->m_url , &tldLen );
+				// no match if we have no tld. might be an IP only url,
+				// or not in our list in Domains.cpp::isTLD()
+				if ( ! tld || tldLen == 0 ) goto nextRule;
+				// loop for the comma-separated list of tlds
+				// like tld:us,uk,fr,it,de
+				const std::vector<UrlFilterListItem> &items = op->m_items;
+				for ( size_t k = 0 ; k < items.size() ; k++ ) {
+					if ( (int32_t)items[k].m_str.size() != tldLen ||
+					     strncasecmp(items[k].m_str.c_str(),tld,tldLen) != 0 )
+						continue;
+					// if we had tld==com,org,... and matched
+					// any, that's great
+					if ( op->m_sign == SIGN_EQ ) {
+						n = items[k].m_next;
+						goto nextOp;
+					}
+					// if its tld!=com,org,... and we equal the
+					// string, then we do not match this rule
+					if ( op->m_sign == SIGN_NE ) goto nextRule;
+				}
+				// if that was the end of the list and the sign was
+				// != then we win! otherwise skip this rule
+				if ( op->m_sign != SIGN_NE ) goto nextRule;
+				break;
 			}
-			// skip the '&&'
-			p += 2;
-			goto checkNextRule;
-		}
-
-		// non-boolen junk
- skipi:
 
-		// . we always match the "default" reg ex
-		// . this line must ALWAYS exist!
-		if ( *p=='d' && ! strcmp(p,"default" ) ) {
-			logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-			return i;
-		}
-
-		// is it in the big list of sites?
-		if ( *p == 't' && strncmp(p,"tag:",4) == 0 ) {
-			// skip for msg20
-			//if ( isForMsg20 ) continue;
-			// if only seeds in the sitelist and no
-
-			// if there is no domain or url explicitly listed
-			// then assume user is spidering the whole internet
-			// and we basically ignore "insitelist"
-			if ( sc->m_siteListIsEmpty && sc->m_siteListIsEmptyValid ) {
-				row = NULL;// no row
-			} else if ( ! checkedRow ) {
-				// only do once for speed
-				checkedRow = true;
-				// this function is in PageBasic.cpp
-				// . it also has to match "tag" at (p+4)
-				row = getMatchingUrlPattern ( sc, sreq ,p+4);
-			}
-			// if we are not submitted from the add url api, skip
-			if ( (bool)row == val ) continue;
-			// skip tag:
-			p += 4;
-			// skip to next constraint
-			p = strstr(p, "&&");
-			// all done?
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// lang:en,zh_cn
+			case UFOP_LANG: {
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// must have a reply
+				if ( langId == -1 ) goto nextRule;
+				// loop for the comma-separated list of langids
+				// like lang==en,es,...
+				const std::vector<UrlFilterListItem> &items = op->m_items;
+				for ( size_t k = 0 ; lang && k < items.size() ; k++ ) {
+					if ( (int32_t)items[k].m_str.size() != langLen ||
+					     strncasecmp(items[k].m_str.c_str(),lang,langLen) != 0 )
+						continue;
+					// if we had lang==en,es,...
+					if ( op->m_sign == SIGN_EQ ) {
+						n = items[k].m_next;
+						goto nextOp;
+					}
+					// if its lang!=en,es,...
+					if ( op->m_sign == SIGN_NE ) goto nextRule;
+				}
+				if ( op->m_sign != SIGN_NE ) goto nextRule;
+				break;
 			}
-			p += 2;
-			goto checkNextRule;
-		}
-		
-
 
+			// hopcount == 20 [&&]
+			case UFOP_HOPCOUNT:
+				// skip if not valid
+				if ( ! sreq->m_hopCountValid ) goto nextRule;
+				if ( ! compareInt ( op->m_sign , sreq->m_hopCount , op->m_intArg ) ) goto nextRule;
+				break;
 
-		// set the sign
-		char *s = p;
-		// skip s to after
-		while ( *s && is_alpha_a(*s) ) s++;
-
-		// skip white space before the operator
-		//char *saved = s;
-		while ( *s && is_wspace_a(*s) ) s++;
-
-		char sign = 0;
-		if ( *s == '=' ) {
-			s++;
-			if ( *s == '=' ) s++;
-			sign = SIGN_EQ;
-		}
-		else if ( *s == '!' && s[1] == '=' ) {
-			s += 2;
-			sign = SIGN_NE;
-		}
-		else if ( *s == '<' ) {
-			s++;
-			if ( *s == '=' ) { sign = SIGN_LE; s++; }
-			else               sign = SIGN_LT; 
-		} 
-		else if ( *s == '>' ) {
-			s++;
-			if ( *s == '=' ) { sign = SIGN_GE; s++; }
-			else               sign = SIGN_GT; 
-		} 
-
-		// skip whitespace after the operator
-		while ( *s && is_wspace_a(*s) ) s++;
-
-
-		// new quotas. 'sitepages' = pages from site.
-		// 'sitepages > 20 && seedcount <= 1 --> FILTERED'
-		if ( *p == 's' &&
-		     p[1] == 'i' &&
-		     p[2] == 't' &&
-		     p[3] == 'e' &&
-		     p[4] == 'p' &&
-		     p[5] == 'a' &&
-		     p[6] == 'g' &&
-		     p[7] == 'e' &&
-		     p[8] == 's' ) {
-			// need a quota table for this
-			if ( ! quotaTable ) continue;
-			int32_t *valPtr ;
-		       valPtr=(int32_t*)quotaTable->getValue(&sreq->m_siteHash32);
-			// if no count in table, that is strange, i guess
-			// skip for now???
-			int32_t a;
-			if ( ! valPtr ) a = 0;//{ g_process.shutdownAbort(true); }
-			else a = *valPtr;
-			//log("sitepgs=%" PRId32" for %s",a,sreq->m_url);
-			// what is the provided value in the url filter rule?
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
-
-		// tld:cn 
-		if ( *p=='t' && strncmp(p,"tld",3)==0){
-			// set it on demand
-			if ( tld == (char *)-1 )
-				tld = getTLDFast ( sreq->m_url , &tldLen );
-			// no match if we have no tld. might be an IP only url,
-			// or not in our list in Domains.cpp::isTLD()
-			if ( ! tld || tldLen == 0 ) continue;
-			// set these up
-			//char *a    = tld;
-			//int32_t  alen = tldLen;
-			char *b    = s;
-			// loop for the comma-separated list of tlds
-			// like tld:us,uk,fr,it,de
-		subloop1:
-			// get length of it in the regular expression box
-			char *start = b;
-			while ( *b && !is_wspace_a(*b) && *b!=',' ) b++;
-			int32_t  blen = b - start;
-			//char sm;
-			// if we had tld==com,org,...
-			if ( sign == SIGN_EQ &&
-			     blen == tldLen && 
-			     strncasecmp(start,tld,tldLen)==0 ) 
-				// if we matched any, that's great
-				goto matched1;
-			// if its tld!=com,org,...
-			// and we equal the string, then we do not matcht his
-			// particular rule!!!
-			if ( sign == SIGN_NE &&
-			     blen == tldLen && 
-			     strncasecmp(start,tld,tldLen)==0 ) 
-				// we do not match this rule if we matched
-				// and of the tlds in the != list
-				continue;
-			// might have another tld in a comma-separated list
-			if ( *b != ',' ) {
-				// if that was the end of the list and the
-				// sign was == then skip this rule
-				if ( sign == SIGN_EQ ) continue;
-				// otherwise, if the sign was != then we win!
-				if ( sign == SIGN_NE ) goto matched1;
-				// otherwise, bad sign?
-				continue;
-			}
-			// advance to next tld if there was a comma after us
-			b++;
-			// and try again
-			goto subloop1;
-			// otherwise
-			// do we match, if not, try next regex
-			//sm = strncasecmp(a,b,blen);
-			//if ( sm != 0 && sign == SIGN_EQ ) goto miss1;
-			//if ( sm == 0 && sign == SIGN_NE ) goto miss1;
-			// come here on a match
-		matched1:
-			// we matched, now look for &&
-			p = strstr ( b , "&&" );
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// selector using the first time it was added to the Spiderdb
+			// added by Sam, May 5th 2015
+			case UFOP_URLAGE: {
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// get the age of the spider_request. 
+				// (substraction of uint with int, hope
+				// every thing goes well there)
+				int32_t sreq_age = 0;
+				// if m_discoveryTime is available, we use it. Otherwise we use m_addedTime
+				if ( sreq->m_discoveryTime!=0) sreq_age = nowGlobal-sreq->m_discoveryTime;
+				if ( sreq->m_discoveryTime==0) sreq_age = nowGlobal-sreq->m_addedTime;
+				if ( ! compareInt ( op->m_sign , sreq_age , op->m_intArg ) ) goto nextRule;
+				break;
 			}
-			
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-			// come here if we did not match the tld
-		}
 
+			case UFOP_ERRORCOUNT:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// reply based
+				if ( ! srep ) goto nextRule;
+				if ( ! compareInt ( op->m_sign , srep->m_errCount , op->m_intArg ) ) goto nextRule;
+				break;
 
-		// lang:en,zh_cn
-		if ( *p=='l' && strncmp(p,"lang",4)==0){
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			
-			// must have a reply
-			if ( langId == -1 ) continue;
-			// skip if unknown? no, we support "xx" as unknown now
-			//if ( srep->m_langId == 0 ) continue;
-			// set these up
-			char *b = s;
-			// loop for the comma-separated list of langids
-			// like lang==en,es,...
-		subloop2:
-			// get length of it in the regular expression box
-			char *start = b;
-			while ( *b && !is_wspace_a(*b) && *b!=',' ) b++;
-			int32_t  blen = b - start;
-			//char sm;
-			// if we had lang==en,es,...
-			if ( sign == SIGN_EQ &&
-			     blen == langLen && 
-			     lang &&
-			     strncasecmp(start,lang,langLen)==0 ) 
-				// if we matched any, that's great
-				goto matched2;
-			// if its lang!=en,es,...
-			// and we equal the string, then we do not matcht his
-			// particular rule!!!
-			if ( sign == SIGN_NE &&
-			     blen == langLen && 
-			     lang && 
-			     strncasecmp(start,lang,langLen)==0 ) 
-				// we do not match this rule if we matched
-				// and of the langs in the != list
-				continue;
-			// might have another in the comma-separated list
-			if ( *b != ',' ) {
-				// if that was the end of the list and the
-				// sign was == then skip this rule
-				if ( sign == SIGN_EQ ) continue;
-				// otherwise, if the sign was != then we win!
-				if ( sign == SIGN_NE ) goto matched2;
-				// otherwise, bad sign?
-				continue;
-			}
-			// advance to next list item if was a comma after us
-			b++;
-			// and try again
-			goto subloop2;
-			// come here on a match
-		matched2:
-			// we matched, now look for &&
-			p = strstr ( b , "&&" );
-			// if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			// skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-			// come here if we did not match the tld
-		}
+			// EBADURL malformed url is ... 32880
+			case UFOP_ERRORCODE:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// reply based
+				if ( ! srep ) goto nextRule;
+				if ( ! compareInt ( op->m_sign , srep->m_errCode , op->m_intArg ) ) goto nextRule;
+				break;
 
-		// hopcount == 20 [&&]
-		if ( *p=='h' && strncmp(p, "hopcount", 8) == 0){
-			// skip if not valid
-			if ( ! sreq->m_hopCountValid ) continue;
-			// shortcut
-			int32_t a = sreq->m_hopCount;
-			// make it point to the priority
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+			case UFOP_NUMINLINKS:
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				// these are -1 if they are NOT valid
+				if ( ! compareInt ( op->m_sign , sreq->m_pageNumInlinks , op->m_intArg ) ) goto nextRule;
+				break;
 
-		// selector using the first time it was added to the Spiderdb
-		// added by Sam, May 5th 2015
-		if ( *p=='u' && strncmp(p,"urlage",6) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) {
-				//log("was for message 20");
-				continue;
+			// siteNumInlinks >= 300 [&&]
+			case UFOP_SITENUMINLINKS: {
+				// these are -1 if they are NOT valid
+				int32_t a1 = sreq->m_siteNumInlinks;
 
-			}
-			// get the age of the spider_request. 
-			// (substraction of uint with int, hope
-			// every thing goes well there)
-			int32_t sreq_age = 0;
-
-			// if m_discoveryTime is available, we use it. Otherwise we use m_addedTime
-			if ( sreq && sreq->m_discoveryTime!=0) sreq_age = nowGlobal-sreq->m_discoveryTime;
-			if ( sreq && sreq->m_discoveryTime==0) sreq_age = nowGlobal-sreq->m_addedTime;
-			//log("spiderage=%d",sreq_age);
-			// the argument entered by user
-			int32_t argument_age=atoi(s) ;
-			if ( sign == SIGN_EQ && sreq_age != argument_age ) continue;
-			if ( sign == SIGN_NE && sreq_age == argument_age ) continue;
-			if ( sign == SIGN_GT && sreq_age <= argument_age ) continue;
-			if ( sign == SIGN_LT && sreq_age >= argument_age ) continue;
-			if ( sign == SIGN_GE && sreq_age <  argument_age ) continue;
-			if ( sign == SIGN_LE && sreq_age >  argument_age ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+				// only assign if valid
+				int32_t a2 = -1; 
+				if ( srep ) a2 = srep->m_siteNumInlinks;
 
+				// assume a1 is the best
+				int32_t a = -1;
 
-		if ( *p=='e' && strncmp(p,"errorcount",10) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// reply based
-			if ( ! srep ) continue;
-			// shortcut
-			int32_t a = srep->m_errCount;
-			// make it point to the retry count
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			// skip fast
-			//p += 10;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+				// assign to the first valid one
+				if      ( a1 != -1 ) a = a1;
+				else if ( a2 != -1 ) a = a2;
 
-		// EBADURL malformed url is ... 32880
-		if ( *p=='e' && strncmp(p,"errorcode",9) == 0 ) {
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// reply based
-			if ( ! srep ) continue;
-			// shortcut
-			int32_t a = srep->m_errCode;
-			// make it point to the retry count
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			// skip fast
-			//p += 9;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+				// swap if both are valid, but srep is more recent
+				if ( a1 != -1 && a2 != -1 && srep->m_spideredTime > sreq->m_addedTime )
+					a = a2;
 
-		if ( *p == 'n' && strncmp(p,"numinlinks",10) == 0 ) {
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// these are -1 if they are NOT valid
-			int32_t a = sreq->m_pageNumInlinks;
-			// make it point to the priority
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			// skip fast
-			//p += 10;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+				// skip if nothing valid
+				if ( a == -1 ) goto nextRule;
 
-		// siteNumInlinks >= 300 [&&]
-		if ( *p=='s' && strncmp(p, "sitenuminlinks", 14) == 0){
-			// these are -1 if they are NOT valid
-			int32_t a1 = sreq->m_siteNumInlinks;
-
-			// only assign if valid
-			int32_t a2 = -1; 
-			if ( srep ) a2 = srep->m_siteNumInlinks;
-
-			// assume a1 is the best
-			int32_t a = -1;
-
-			// assign to the first valid one
-			if      ( a1 != -1 ) a = a1;
-			else if ( a2 != -1 ) a = a2;
-
-			// swap if both are valid, but srep is more recent
-			if ( a1 != -1 && a2 != -1 && srep->m_spideredTime > sreq->m_addedTime )
-				a = a2;
-
-			// skip if nothing valid
-			if ( a == -1 ) continue;
-
-			// make it point to the priority
-			int32_t b = atoi(s);
-
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			// skip fast
-			//p += 14;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+				if ( ! compareInt ( op->m_sign , a , op->m_intArg ) ) goto nextRule;
+				break;
 			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// how many days have passed since it was last attempted
-		// to be spidered? used in conjunction with percentchanged
-		// to assign when to re-spider it next
-		if ( *p=='s' && strncmp(p, "spiderwaited", 12) == 0){
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1");
-				return -1;
-			}
+			// how many days have passed since it was last attempted
+			// to be spidered? used in conjunction with percentchanged
+			// to assign when to re-spider it next
+			case UFOP_SPIDERWAITED:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1");
+					return -1;
+				}
+				// must have a reply
+				if ( ! srep ) goto nextRule;
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				if ( ! compareInt ( op->m_sign , nowGlobal - srep->m_spideredTime , op->m_intArg ) ) goto nextRule;
+				break;
 
-			// must have a reply
-			if ( ! srep ) continue;
+			// percentchanged >= 50 [&&] ...
+			case UFOP_PERCENTCHANGEDPERDAY:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// must have a reply
+				if ( ! srep ) goto nextRule;
+				// skip for msg20
+				if ( isForMsg20 ) goto nextRule;
+				if ( ! compareFloat ( op->m_sign , srep->m_percentChangedPerDay , op->m_floatArg ) ) goto nextRule;
+				break;
 
-			// skip for msg20
-			if ( isForMsg20 ) continue;
+			// httpStatus == 400
+			case UFOP_HTTPSTATUS:
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// must have a reply
+				if ( ! srep ) goto nextRule;
+				// shortcut (errCode doubles as g_errno)
+				if ( ! compareInt ( op->m_sign , srep->m_errCode , op->m_intArg ) ) goto nextRule;
+				break;
 
-			// shortcut
-			int32_t a = nowGlobal - srep->m_spideredTime;
-
-			// make it point to the priority
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// how old is the doc in seconds? age is the pubDate age
+			case UFOP_AGE: {
+				// if we do not have enough info for outlink, all done
+				if ( isOutlink ) {
+					logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
+					return -1;
+				}
+				// must have a reply
+				if ( ! srep ) goto nextRule;
+				// shortcut
+				int32_t age;
+				if ( srep->m_pubDate <= 0 ) age = -1;
+				else age = nowGlobal - srep->m_pubDate;
+				// we can not match if invalid
+				if ( age <= 0 ) goto nextRule;
+				if ( ! compareInt ( op->m_sign , age , op->m_intArg ) ) goto nextRule;
+				break;
 			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// percentchanged >= 50 [&&] ...
-		if ( *p=='p' && strncmp(p, "percentchangedperday", 20) == 0){
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// must have a reply
-			if ( ! srep ) continue;
-			// skip for msg20
-			if ( isForMsg20 ) continue;
-			// shortcut
-			float a = srep->m_percentChangedPerDay;
-			// make it point to the priority
-			float b = atof(s);
-			// compare
-			if ( sign == SIGN_EQ && !almostEqualFloat(a, b) ) continue;
-			if ( sign == SIGN_NE && almostEqualFloat(a, b) ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// our own regex thing (match front of url)
+			case UFOP_PREFIX: {
+				int32_t plen = op->m_str.size();
+				int32_t m = 1;
+				// check to see if we matched if url was long enough
+				if ( urlLen >= plen )
+					m = strncmp(op->m_str.c_str(),url,plen);
+				// if they used the '!' operator and we did not
+				// match the string, that's a row match
+				if ( ( m == 0 && val ) || ( m && ! val ) ) goto nextRule;
+				break;
 			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// httpStatus == 400
-		if ( *p=='h' && strncmp(p, "httpstatus", 10) == 0){
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
-			}
-			// must have a reply
-			if ( ! srep ) continue;
-			// shortcut (errCode doubles as g_errno)
-			int32_t a = srep->m_errCode;
-			// make it point to the priority
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && a != b ) continue;
-			if ( sign == SIGN_NE && a == b ) continue;
-			if ( sign == SIGN_GT && a <= b ) continue;
-			if ( sign == SIGN_LT && a >= b ) continue;
-			if ( sign == SIGN_GE && a <  b ) continue;
-			if ( sign == SIGN_LE && a >  b ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
+			// our own regex thing (match end of url)
+			case UFOP_SUFFIX: {
+				int32_t plen = op->m_str.size();
+				int32_t m = 1;
+				// url has to be at least as big
+				if ( urlLen >= plen )
+					m = strncmp(op->m_str.c_str(),url+urlLen-plen,plen);
+				if ( ( m == 0 && val ) || ( m && ! val ) ) goto nextRule;
+				break;
 			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// how old is the doc in seconds? age is the pubDate age
-		if ( *p =='a' && strncmp(p, "age", 3) == 0){
-			// if we do not have enough info for outlink, all done
-			if ( isOutlink ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning -1" );
-				return -1;
+			// . by default a substring match
+			// . action=edit
+			// . action=history
+			case UFOP_SUBSTRING: {
+				// does url contain it? haystack=u needle=p
+				const char *found = strstr ( url , op->m_str.c_str() );
+
+				// kinda of a hack fix. if they inject a filtered url
+				// into test coll, do not filter it! fixes the fact that
+				// we filtered facebook, but still add it in our test
+				// collection injection in urls.txt
+				if ( found && 
+				     sreq->m_isInjecting &&
+				     cr->m_coll[0]=='t' &&
+				     cr->m_coll[1]=='e' &&
+				     cr->m_coll[2]=='s' &&
+				     cr->m_coll[3]=='t' &&
+				     cr->m_coll[4]=='\0' &&
+				     cr->m_spiderPriorities[i] < 0 )
+					goto nextRule;
+
+				// support "!company" meaning if it does NOT match
+				// then do this ...
+				if ( ( found && val ) || ( ! found && ! val ) ) goto nextRule;
+				break;
 			}
-			// must have a reply
-			if ( ! srep ) continue;
-			// shortcut
-			int32_t age;
-			if ( srep->m_pubDate <= 0 ) age = -1;
-			else age = nowGlobal - srep->m_pubDate;
-			// we can not match if invalid
-			if ( age <= 0 ) continue;
-			// make it point to the priority
-			int32_t b = atoi(s);
-			// compare
-			if ( sign == SIGN_EQ && age != b ) continue;
-			if ( sign == SIGN_NE && age == b ) continue;
-			if ( sign == SIGN_GT && age <= b ) continue;
-			if ( sign == SIGN_LT && age >= b ) continue;
-			if ( sign == SIGN_GE && age <  b ) continue;
-			if ( sign == SIGN_LE && age >  b ) continue;
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) 
-			{
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
 			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
 
-		// our own regex thing (match front of url)
-		if ( *p=='^' ) {
-			// advance over caret
-			p++;
-			// now pstart pts to the string we will match
-			char *pstart = p;
-			// make "p" point to one past the last char in string
-			while ( *p && ! is_wspace_a(*p) ) p++;
-			// how long is the string to match?
-			int32_t plen = p - pstart;
-			// empty? that's kinda an error
-			if ( plen == 0 ) 
-				continue;
-			int32_t m = 1;
-			// check to see if we matched if url was long enough
-			if ( urlLen >= plen )
-				m = strncmp(pstart,url,plen);
-			if ( ( m == 0 && val == 0 ) ||
-			     // if they used the '!' operator and we
-			     // did not match the string, that's a 
-			     // row match
-			     ( m && val == 1 ) ) {
-				// another expression follows?
-				p = strstr(s, "&&");
-				//if nothing, else then it is a match
-				if ( ! p ) {
-					logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-					return i;
-				}
-				//skip the '&&' and go to next rule
-				p += 2;
-				goto checkNextRule;
-			}
-			// no match
-			continue;
+			// this expression matched, on to the one after the "&&"
+			n = op->m_next;
+		nextOp:
+			;
 		}
 
-		// our own regex thing (match end of url)
-		if ( *p=='$' ) {
-			// advance over dollar sign
-			p++;
-			// a hack for $\.css, skip over the backslash too
-			if ( *p=='\\' && *(p+1)=='.' ) p++;
-			// now pstart pts to the string we will match
-			char *pstart = p;
-			// make "p" point to one past the last char in string
-			while ( *p && ! is_wspace_a(*p) ) p++;
-			// how long is the string to match?
-			int32_t plen = p - pstart;
-			// empty? that's kinda an error
-			if ( plen == 0 ) 
-				continue;
-			// . do we match it?
-			// . url has to be at least as big
-			// . match our tail
-			int32_t m = 1;
-			// check to see if we matched if url was long enough
-			if ( urlLen >= plen )
-				m = strncmp(pstart,url+urlLen-plen,plen);
-			if ( ( m == 0 && val == 0 ) ||
-			     // if they used the '!' operator and we
-			     // did not match the string, that's a 
-			     // row match
-			     ( m && val == 1 ) ) {
-				// another expression follows?
-				p = strstr(s, "&&");
-				//if nothing, else then it is a match
-				if ( ! p ) {
-					logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-					return i;
-				}
-
-				//skip the '&&' and go to next rule
-				p += 2;
-				goto checkNextRule;
-			}
-			// no match
-			continue;
-		}
-
-		// . by default a substring match
-		// . action=edit
-		// . action=history
-
-		// now pstart pts to the string we will match
-		char *pstart = p;
-		// make "p" point to one past the last char in string
-		while ( *p && ! is_wspace_a(*p) ) p++;
-		// how long is the string to match?
-		int32_t plen = p - pstart;
-		// need something...
-		if ( plen <= 0 ) continue;
-		// must be at least as big
-		//if ( urlLen < plen ) continue;
-		// nullilfy it temporarily
-		char c = *p;
-		*p     = '\0';
-		// does url contain it? haystack=u needle=p
-		const char *found = strstr ( url , pstart );
-		// put char back
-		*p     = c;
-
-		// kinda of a hack fix. if they inject a filtered url
-		// into test coll, do not filter it! fixes the fact that
-		// we filtered facebook, but still add it in our test
-		// collection injection in urls.txt
-		if ( found && 
-		     sreq->m_isInjecting &&
-		     cr->m_coll[0]=='t' &&
-		     cr->m_coll[1]=='e' &&
-		     cr->m_coll[2]=='s' &&
-		     cr->m_coll[3]=='t' &&
-		     cr->m_coll[4]=='\0' &&
-		     cr->m_spiderPriorities[i] < 0 )
-			continue;
-
-		// support "!company" meaning if it does NOT match
-		// then do this ...
-		if ( ( found && val == 0 ) ||
-		     // if they used the '!' operator and we
-		     // did not match the string, that's a 
-		     // row match
-		     ( ! found && val == 1 ) ) {
-			// another expression follows?
-			p = strstr(s, "&&");
-			//if nothing, else then it is a match
-			if ( ! p ) {
-				logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
-				return i;
-			}
-			//skip the '&&' and go to next rule
-			p += 2;
-			goto checkNextRule;
-		}
+		// all the expressions of the rule matched
+		prog->addHit ( i );
+		logTrace( g_conf.m_logTraceSpider, "END, returning i (%" PRId32")", i );
+		return i;
 
+	nextRule:
+		;
 	}
 
 	// return -1 if no match, caller should use a default
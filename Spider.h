@@ -399,6 +399,15 @@ public:
 		return makeKey( firstIp, 0xffffffffffffLL, true, MAX_DOCID, false );
 	}
 
+	// the range of the requests and replies of one url of a firstip
+	static key128_t makeFirstKey( int32_t firstIp, int64_t urlHash48 ) {
+		return makeKey( firstIp, urlHash48, false, 0LL, true );
+	}
+
+	static key128_t makeLastKey( int32_t firstIp, int64_t urlHash48 ) {
+		return makeKey( firstIp, urlHash48, true, MAX_DOCID, false );
+	}
+
 	// print the spider rec
 	static int32_t print( char *srec , SafeBuf *sb = NULL );
 	static void printKey(const char *k);
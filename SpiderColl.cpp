@@ -14,6 +14,7 @@
 #include "Conf.h"
 #include "Mem.h"
 #include "ScopedLock.h"
+#include <algorithm>
 
 static key96_t makeWaitingTreeKey ( uint64_t spiderTimeMS , int32_t firstIp ) {
 	// sanity
@@ -87,6 +88,7 @@ SpiderColl::SpiderColl(CollectionRec *cr) {
 	m_lastRepUh48 = 0;
 	m_waitingTreeKeyValid = false;
 	m_scanningIp = 0;
+	m_waitingTreeDueTimeMS = 0;
 	m_gotNewDataForScanningIp = 0;
 	m_lastListSize = 0;
 	m_lastScanningIp = 0;
@@ -102,6 +104,10 @@ SpiderColl::SpiderColl(CollectionRec *cr) {
 	m_pageNumInlinks = 0;
 	m_lastCBlockIp = 0;
 	m_lastOverflowFirstIp = 0;
+	m_incrementalScan = false;
+	m_incrementalMaxWinners = 0;
+	m_changedUh48Index = 0;
+	m_checkingWinners = false;
 
 	reset();
 
@@ -177,6 +183,8 @@ bool SpiderColl::load ( ) {
 		return false;
 	if (!m_cdTable.set    (4,4,0,NULL,0,false,"cdtbl"))
 		return false;
+	if (!m_changedUrlTable.set(4,8,0,NULL,0,true,"chgurltbl"))
+		return false;
 	// doledb seems to have like 32000 entries in it
 	int32_t numSlots = 0; // was 128000
 	if(!m_doledbIpTable.set(4,4,numSlots,NULL,0,false,"doleip"))
@@ -196,6 +204,7 @@ bool SpiderColl::load ( ) {
 	}
 	m_waitingTreeKeyValid = false;
 	m_scanningIp = 0;
+	m_waitingTreeDueTimeMS = 0;
 
 	// make dir
 	char dir[500];
@@ -388,6 +397,7 @@ void SpiderColl::reset ( ) {
 	m_winnerTree.reset();
 	m_winnerTable .reset();
 	m_dupCache    .reset();
+	m_changedUrlTable.reset();
 
 	if ( m_overflowList ) {
 		mfree ( m_overflowList , OVERFLOWLISTSIZE * 4 ,"olist" );
@@ -538,6 +548,9 @@ bool SpiderColl::addSpiderReply(const SpiderReply *srep) {
 		    srep->m_key.n1,
 		    srep->m_key.n0);
 
+	// so the cached winners of the ip get this url re-evaluated
+	addChangedUrl(srep->m_firstIp, srep->getUrlHash48());
+
 	// . add to wait tree and let it populate doledb on its batch run
 	// . use a spiderTime of 0 which means unknown and that it needs to
 	//   scan spiderdb to get that
@@ -702,6 +715,7 @@ bool SpiderColl::addSpiderRequest(const SpiderRequest *sreq, int64_t nowGlobalMS
 	// each firstIp in waiting tree in spiderdb to get the best
 	// SpiderRequest for that firstIp, then we can add it to doledb
 	// as long as it can be spidered now
+	addChangedUrl(sreq->m_firstIp, sreq->getUrlHash48());
 	bool added = addToWaitingTree(sreq->m_firstIp);
 
 	// if already doled and we beat the priority/spidertime of what
@@ -936,6 +950,9 @@ bool SpiderColl::addToWaitingTree(int32_t firstIp) {
 	logDebug(g_conf.m_logDebugSpider, "spider: added time=%" PRId64" ip=%s to waiting tree node=%" PRId32,
 	         spiderTimeMS, iptoa(firstIp,ipbuf), wn);
 
+	// wake up populateDoledbFromWaitingTree()
+	m_waitingTreeDueTimeMS = spiderTimeMS;
+
 	// add to table now since its in the tree
 	if (!addToWaitingTable(firstIp, spiderTimeMS)) {
 		// remove from tree then
@@ -972,6 +989,8 @@ int32_t SpiderColl::getNextIpFromWaitingTree ( ) {
 
 		// we might have deleted the only node below...
 		if (m_waitingTree.isEmpty_unlocked()) {
+			// nothing to do until addToWaitingTree() is called
+			m_waitingTreeDueTimeMS = INT64_MAX;
 			return 0;
 		}
 
@@ -981,6 +1000,7 @@ int32_t SpiderColl::getNextIpFromWaitingTree ( ) {
 		int32_t node = m_waitingTree.getNextNode_unlocked(0, (char *)&m_waitingTreeKey);
 		// if empty, stop
 		if (node < 0) {
+			m_waitingTreeDueTimeMS = INT64_MAX;
 			return 0;
 		}
 
@@ -1024,6 +1044,8 @@ int32_t SpiderColl::getNextIpFromWaitingTree ( ) {
 
 		// stop if need to wait for this one
 		if (spiderTimeMS > nowMS) {
+			// the tree is sorted by time so nothing is due before it
+			m_waitingTreeDueTimeMS = spiderTimeMS;
 			return 0;
 		}
 
@@ -1465,6 +1487,14 @@ void SpiderColl::populateDoledbFromWaitingTree ( ) { // bool reentry ) {
 		return;
 	}
 
+	// . nothing in the waiting tree is due yet. we are called every 50ms
+	//   for every collection so do not bother looking at the tree
+	// . addToWaitingTree() resets this when an ip is added
+	if ( gettimeofdayInMilliseconds() < m_waitingTreeDueTimeMS ) {
+		logTrace( g_conf.m_logTraceSpider, "END, nothing due in waiting tree" );
+		return;
+	}
+
 	// set this flag so we are not re-entered
 	m_isPopulatingDoledb = true;
  loop:
@@ -1686,6 +1716,219 @@ void SpiderColl::gotSpiderdbListWrapper(void *state, RdbList *list, Msg5 *msg5)
 
 
 
+// . at most this many changed urls are kept per firstip. after that the
+//   ip is rescanned from spiderdb like before
+// . if the table gets this big the winner list cache of the collection is
+//   cleared and every ip is rescanned
+static const int32_t s_maxChangedUrlsPerIp = 100;
+static const int32_t s_maxChangedUrls = 500000;
+
+// . note that the spiderdb recs of this url changed, so if the winners of
+//   its firstip are in m_winnerListCache only this url needs to be
+//   re-evaluated and merged into them by evalIpLoop()
+void SpiderColl::addChangedUrl(int32_t firstIp, int64_t uh48) {
+	// we never evaluate the winners of an ip of another shard
+	if ( ! isAssignedToUs ( firstIp ) ) return;
+
+	ScopedLock sl(m_changedUrlTableMtx);
+
+	if ( ! m_changedUrlTable.isInitialized() ) return;
+
+	if ( m_changedUrlTable.getNumUsedSlots() >= s_maxChangedUrls ) {
+		log(LOG_INFO, "spider: too many changed urls for cn=%" PRId32". clearing winner list cache.",
+		    (int32_t)m_collnum);
+		m_changedUrlTable.clear();
+		RdbCacheLock rcl(g_spiderLoop.m_winnerListCache);
+		g_spiderLoop.m_winnerListCache.clear(m_collnum);
+		return;
+	}
+
+	int32_t count = 0;
+	for ( int32_t slot = m_changedUrlTable.getSlot(&firstIp); slot >= 0;
+	      slot = m_changedUrlTable.getNextSlot(slot, &firstIp) ) {
+		int64_t old = *(int64_t *)m_changedUrlTable.getValueFromSlot(slot);
+		// already in there, or the ip gets a full rescan anyway
+		if ( old == uh48 || old == -1 ) return;
+		count++;
+	}
+
+	// too many. rescan all of spiderdb for this ip
+	if ( count >= s_maxChangedUrlsPerIp ) uh48 = -1;
+
+	if ( ! m_changedUrlTable.addKey(&firstIp, &uh48) ) {
+		// forget all cached winners so nothing stale is doled
+		log(LOG_WARN, "spider: failed to add changed url: %s", mstrerror(g_errno));
+		g_errno = 0;
+		m_changedUrlTable.clear();
+		RdbCacheLock rcl(g_spiderLoop.m_winnerListCache);
+		g_spiderLoop.m_winnerListCache.clear(m_collnum);
+	}
+}
+
+// . move the changed urls of "firstIp" into "uh48s"
+// . returns false if there were too many to keep track of, in which case
+//   all of spiderdb has to be rescanned for the ip
+bool SpiderColl::takeChangedUrls(int32_t firstIp, std::vector<int64_t> *uh48s) {
+	ScopedLock sl(m_changedUrlTableMtx);
+
+	uh48s->clear();
+	bool listed = true;
+	for ( int32_t slot = m_changedUrlTable.getSlot(&firstIp); slot >= 0;
+	      slot = m_changedUrlTable.getSlot(&firstIp) ) {
+		int64_t uh48 = *(int64_t *)m_changedUrlTable.getValueFromSlot(slot);
+		if ( uh48 == -1 ) listed = false;
+		else uh48s->push_back(uh48);
+		m_changedUrlTable.removeSlot(slot);
+	}
+	return listed;
+}
+
+// . put the winners left in a dolebuf from m_winnerListCache back into
+//   m_winnerTree, except those of the changed urls which are read again
+// . returns false on error or if the ip has to be rescanned
+bool SpiderColl::seedWinnersFromDoleBuf(const char *doleBuf, int32_t doleBufSize) {
+	const char *pstart = doleBuf + *(const int32_t *)doleBuf;
+	const char *pend = doleBuf + doleBufSize;
+	int32_t firstIp = m_waitingTreeKey.n0 & 0xffffffff;
+
+	int32_t numCached = 0;
+	for ( const char *p = pstart ; p < pend ; ) {
+		p += sizeof(key96_t);
+		p += 4 + *(const int32_t *)p;
+		numCached++;
+	}
+
+	// . a scan of less than 25000 bytes keeps one winner only, so with
+	//   one left we can't tell how many a full scan would keep now
+	// . those ips are cheap to rescan anyway
+	if ( numCached <= 1 ) return false;
+
+	m_changedWinnerKeys.clear();
+	for ( const char *p = pstart ; p < pend ; ) {
+		key96_t doleKey = *(const key96_t *)p;
+		p += sizeof(key96_t);
+		int32_t recSize = *(const int32_t *)p;
+		p += 4;
+		const SpiderRequest *sreq = (const SpiderRequest *)p;
+		p += recSize;
+
+		// doledb keys only have the spider time in seconds
+		int64_t uh48 = sreq->getUrlHash48();
+		int64_t spiderTimeMS = (int64_t)Doledb::getSpiderTime(&doleKey) * 1000LL;
+		key192_t wk = makeWinnerTreeKey(firstIp, sreq->m_priority, sreq->m_hopCount, spiderTimeMS, uh48);
+
+		if ( std::find(m_changedUh48s.begin(), m_changedUh48s.end(), uh48) != m_changedUh48s.end() ) {
+			m_changedWinnerKeys.push_back(wk);
+			continue;
+		}
+
+		if ( ! m_winnerTable.addKey(&uh48, &wk) ) return false;
+
+		char *newMem = (char *)mdup(sreq, recSize, "sreqbuf");
+		if ( ! newMem ) return false;
+
+		if ( ! m_winnerTree.addNode(0, (char *)&wk, newMem, recSize) ) {
+			mfree(newMem, recSize, "sreqbuf");
+			return false;
+		}
+	}
+
+	// keep as many winners as the full scan that cached them did
+	m_incrementalMaxWinners = ( numCached > 400 ) ? (int32_t)MAX_WINNER_NODES : 400;
+
+	ScopedLock sl(m_winnerTree.getLock());
+	if ( m_winnerTree.getNumUsedNodes_unlocked() >= m_incrementalMaxWinners ) {
+		int32_t tailNode = m_winnerTree.getLastNode_unlocked();
+		const key192_t *tailKey = reinterpret_cast<const key192_t *>(m_winnerTree.getKey_unlocked(tailNode));
+		parseWinnerTreeKey(tailKey, &m_tailIp, &m_tailPriority, &m_tailHopCount, &m_tailTimeMS, &m_tailUh48);
+	}
+
+	return true;
+}
+
+// . true if a changed url that was a cached winner is no longer a winner
+//   or got a worse key after the merge
+// . a url that was not cached can beat it now, and only a full scan of
+//   the ip finds that url
+bool SpiderColl::changedWinnerGotWorse() {
+	for ( size_t i = 0 ; i < m_changedWinnerKeys.size() ; i++ ) {
+		int64_t uh48 = m_changedWinnerKeys[i].n0 >> 16;
+		const key192_t *wk = (const key192_t *)m_winnerTable.getValue(&uh48);
+		if ( ! wk ) return true;
+		if ( KEYCMP((const char *)wk, (const char *)&m_changedWinnerKeys[i], sizeof(key192_t)) > 0 ) return true;
+	}
+	return false;
+}
+
+// set the spiderdb read range to the recs of the next changed url
+void SpiderColl::startChangedUrlRead() {
+	int64_t uh48 = m_changedUh48s[m_changedUh48Index];
+	m_nextKey = Spiderdb::makeFirstKey(m_scanningIp, uh48);
+	m_endKey  = Spiderdb::makeLastKey (m_scanningIp, uh48);
+	m_firstKey = m_nextKey;
+	m_didRead = false;
+}
+
+// throw away the winners so far and scan all of spiderdb for m_scanningIp
+void SpiderColl::restartFullScan() {
+	m_incrementalScan = false;
+	m_incrementalMaxWinners = 0;
+
+	m_winnerTree.clear();
+	m_winnerTable.clear();
+	m_minFutureTimeMS = 0LL;
+	m_totalBytesScanned = 0LL;
+	m_totalNewSpiderRequests = 0LL;
+	m_lastOverflowFirstIp = 0;
+	m_lastReplyValid = false;
+
+	m_nextKey = Spiderdb::makeFirstKey(m_scanningIp);
+	m_endKey  = Spiderdb::makeLastKey (m_scanningIp);
+	m_firstKey = m_nextKey;
+	m_didRead = false;
+}
+
+// . compare the winners of the full rescan in m_winnerTree with those the
+//   incremental evaluation got, saved in m_checkWinnerUh48s
+// . they can differ a bit because the cached winners are not re-evaluated
+//   for the current time, but the next url to spider should be the same
+void SpiderColl::checkWinners() {
+	std::vector<int64_t> fullUh48s;
+	{
+		ScopedLock sl(m_winnerTree.getLock());
+		for ( int32_t node = m_winnerTree.getFirstNode_unlocked(); node >= 0;
+		      node = m_winnerTree.getNextNode_unlocked(node) ) {
+			const SpiderRequest *sreq = reinterpret_cast<const SpiderRequest *>(m_winnerTree.getData_unlocked(node));
+			fullUh48s.push_back(sreq->getUrlHash48());
+		}
+	}
+
+	int32_t numMissing = 0;
+	for ( size_t i = 0 ; i < m_checkWinnerUh48s.size() ; i++ ) {
+		if ( std::find(fullUh48s.begin(), fullUh48s.end(), m_checkWinnerUh48s[i]) == fullUh48s.end() ) {
+			numMissing++;
+		}
+	}
+
+	int64_t incTop  = m_checkWinnerUh48s.empty() ? 0 : m_checkWinnerUh48s[0];
+	int64_t fullTop = fullUh48s.empty() ? 0 : fullUh48s[0];
+
+	if ( incTop == fullTop && ! g_conf.m_logDebugSpider ) {
+		m_checkWinnerUh48s.clear();
+		return;
+	}
+
+	char ipbuf[16];
+	log(incTop == fullTop ? LOG_DEBUG : LOG_WARN,
+	    "spider: winner check for firstip=%s cn=%" PRId32": incremental top uh48=%" PRId64" full top uh48=%" PRId64" "
+	    "incremental winners=%" PRId32" full winners=%" PRId32" not in full=%" PRId32,
+	    iptoa(m_scanningIp,ipbuf), (int32_t)m_collnum, incTop, fullTop,
+	    (int32_t)m_checkWinnerUh48s.size(), (int32_t)fullUh48s.size(), numMissing);
+
+	m_checkWinnerUh48s.clear();
+}
+
+
 ///////////////////
 //
 // KEYSTONE FUNCTION
@@ -1742,8 +1985,22 @@ bool SpiderColl::evalIpLoop ( ) {
 		useCache = false;
 	if ( m_countingPagesIndexed )
 		useCache = false;
+
+	// . on the first call for this ip take the urls whose spiderdb recs
+	//   changed since its winners were cached. a full scan covers them
+	//   as well
+	// . m_didRead is true if we are called back from a spiderdb read
+	bool changesListed = true;
+	if ( ! m_didRead ) {
+		m_incrementalScan = false;
+		m_incrementalMaxWinners = 0;
+		m_changedWinnerKeys.clear();
+		m_checkingWinners = false;
+		changesListed = takeChangedUrls(m_scanningIp, &m_changedUh48s);
+	}
+
 	// assume not from cache
-	if ( useCache ) {
+	if ( useCache && ! m_didRead ) {
 		//wc->verify();
 		RdbCacheLock rcl(*wc);
 		bool inCache = wc->getRecord ( m_collnum     ,
@@ -1759,7 +2016,30 @@ bool SpiderColl::evalIpLoop ( ) {
 					  true ,// incCounts
 					  &cachedTimestamp , // rec timestamp
 					  true );  // promote rec?
-		if ( inCache ) {
+		// . if urls of the ip changed only re-evaluate those and merge
+		//   them into the cached winners
+		// . fall back to a full scan if we can not
+		if ( inCache && ( ! changesListed || ! m_changedUh48s.empty() ) ) {
+			bool seeded = changesListed && seedWinnersFromDoleBuf(doleBuf, doleBufSize);
+			rcl.unlock();
+
+			char ipbuf[16];
+			logDebug( g_conf.m_logDebugSpider, "spider: %s %" PRId32" changed urls of ip %s into "
+				"%" PRId32" cached winners",
+				seeded ? "merging" : "not merging",
+				(int32_t)m_changedUh48s.size(), iptoa(m_scanningIp,ipbuf),
+				m_winnerTree.getNumUsedNodes() );
+
+			if ( seeded ) {
+				m_incrementalScan = true;
+				m_changedUh48Index = 0;
+				startChangedUrlRead();
+			}
+			else {
+				restartFullScan();
+			}
+		}
+		else if ( inCache ) {
 			int32_t crc = hash32 ( doleBuf + 4 , doleBufSize - 4 );
 	
 			char ipbuf[16];
@@ -1832,6 +2112,15 @@ bool SpiderColl::evalIpLoop ( ) {
 	if ( g_errno ) {
 		log("spider: Had error getting list of urls from spiderdb: %s.",mstrerror(g_errno));
 
+		// the changed urls were not merged into the cached winners
+		if ( m_incrementalScan ) {
+			int32_t err = g_errno;
+			for ( size_t i = 0 ; i < m_changedUh48s.size() ; i++ ) {
+				addChangedUrl(m_scanningIp, m_changedUh48s[i]);
+			}
+			g_errno = err;
+		}
+
 		// save mem
 		m_list.freeList();
 
@@ -1899,6 +2188,42 @@ bool SpiderColl::evalIpLoop ( ) {
 		goto top;
 	}
 
+	if ( m_incrementalScan ) {
+		// read the recs of the next changed url
+		if ( m_changedUh48Index + 1 < (int32_t)m_changedUh48s.size() ) {
+			m_changedUh48Index++;
+			startChangedUrlRead();
+			goto top;
+		}
+
+		// . the cached winners are all gone so we need the min future
+		//   time of the ip, or to know it has none, from a full scan
+		// . same if a cached winner got worse, see changedWinnerGotWorse()
+		// . with the winner check on always do the full scan and
+		//   compare what it gets with what we got
+		bool gotWorse = changedWinnerGotWorse();
+		if ( m_winnerTree.isEmpty() || gotWorse || g_conf.m_spiderWinnerCheck ) {
+			m_checkWinnerUh48s.clear();
+			if ( ! m_winnerTree.isEmpty() && ! gotWorse ) {
+				ScopedLock sl(m_winnerTree.getLock());
+				for ( int32_t node = m_winnerTree.getFirstNode_unlocked(); node >= 0;
+				      node = m_winnerTree.getNextNode_unlocked(node) ) {
+					const SpiderRequest *sreq = reinterpret_cast<const SpiderRequest *>(m_winnerTree.getData_unlocked(node));
+					m_checkWinnerUh48s.push_back(sreq->getUrlHash48());
+				}
+				m_checkingWinners = true;
+			}
+			restartFullScan();
+			goto top;
+		}
+
+		m_incrementalScan = false;
+	}
+	else if ( m_checkingWinners ) {
+		m_checkingWinners = false;
+		checkWinners();
+	}
+
 	// free list to save memory
 	m_list.freeList();
 
@@ -2600,6 +2925,10 @@ bool SpiderColl::scanListForWinners ( ) {
 		// mdw: for testing take this out!
 		if ( m_totalBytesScanned < 25000 ) maxWinners = 1;
 
+		// only the changed urls are read when merging them into the
+		// cached winners, so keep as many as the scan that cached them
+		if ( m_incrementalScan ) maxWinners = m_incrementalMaxWinners;
+
 		// sanity. make sure read is somewhat hefty for our maxWinners=1 thing
 		static_assert(SR_READ_SIZE >= 500000, "ensure read size is big enough");
 
@@ -2716,6 +3045,8 @@ gotNewWinner:
 	// reset any errno cuz we're just a cache
 	g_errno = 0;
 
+	// we only read a few urls of the ip so do not know if it overflows
+	if ( m_incrementalScan ) return true;
 
 	/////
 	//
@@ -3079,6 +3410,10 @@ bool SpiderColl::addDoleBufIntoDoledb ( SafeBuf *doleBuf, bool isFromCache ) {
 			// this should never fail since we deleted one above
 			m_waitingTree.addKey_unlocked(&wk2);
 
+			if (m_minFutureTimeMS < m_waitingTreeDueTimeMS) {
+				m_waitingTreeDueTimeMS = m_minFutureTimeMS;
+			}
+
 			logDebug(g_conf.m_logDebugSpider, "spider: RE-added time=%" PRId64" ip=%s to waiting tree node",
 			         m_minFutureTimeMS, iptoa(firstIp,ipbuf));
 
@@ -15,6 +15,7 @@
 #include "types.h"
 #include "max_coll_len.h"
 #include <time.h>
+#include <vector>
 
 
 class CollectionRec;
@@ -151,6 +152,15 @@ private:
 	bool scanListForWinners ( ) ;
 	bool addWinnersIntoDoledb ( ) ;
 
+	// incremental re-evaluation of an ip from its cached winners
+	void addChangedUrl(int32_t firstIp, int64_t uh48);
+	bool takeChangedUrls(int32_t firstIp, std::vector<int64_t> *uh48s);
+	bool seedWinnersFromDoleBuf(const char *doleBuf, int32_t doleBufSize);
+	bool changedWinnerGotWorse();
+	void startChangedUrlRead();
+	void restartFullScan();
+	void checkWinners();
+
 	key128_t m_firstKey;
 	key128_t m_nextKey;
 	key128_t m_endKey;
@@ -223,6 +233,12 @@ private:
 	int32_t m_lastScanningIp;
 	int64_t m_totalBytesScanned;
 
+	// . no ip in the waiting tree can be spidered before this time, so
+	//   populateDoledbFromWaitingTree() does nothing until then
+	// . 0 when a new ip was added and it has to look. only changed while
+	//   holding the waiting tree lock
+	std::atomic<int64_t> m_waitingTreeDueTimeMS;
+
 	// for reading lists from spiderdb
 	Msg5 m_msg5;
 	bool m_gettingList1;
@@ -237,10 +253,35 @@ private:
 		
 	int32_t  m_lastOverflowFirstIp;
 
+	// . the urls of each firstip that got a new request or reply since
+	//   its winners were put in m_winnerListCache. key is the firstip,
+	//   data is the uh48, with dups
+	// . a uh48 of -1 means there were too many, so rescan all of spiderdb
+	HashTableX m_changedUrlTable;
+	GbMutex m_changedUrlTableMtx;
+
+	// . true while evalIpLoop() only reads the spiderdb recs of the
+	//   changed urls of m_scanningIp and merges them into the cached
+	//   winners it put in m_winnerTree
+	bool m_incrementalScan;
+	int32_t m_incrementalMaxWinners;
+	std::vector<int64_t> m_changedUh48s;
+	int32_t m_changedUh48Index;
+	// winner tree keys the changed urls had in the cached winners
+	std::vector<key192_t> m_changedWinnerKeys;
+
+	// with g_conf.m_spiderWinnerCheck the winners of an incremental
+	// evaluation, in order, to compare with those of a full rescan
+	bool m_checkingWinners;
+	std::vector<int64_t> m_checkWinnerUh48s;
+
 	CollectionRec *m_cr;
 
 	static void gotSpiderdbListWrapper(void *state, RdbList *list, Msg5 *msg5);
 	static void gotSpiderdbWaitingTreeListWrapper(void *state, RdbList *list, Msg5 *msg5);
+
+	// the unit tests compare the incremental merge with a full scan
+	friend class SpiderCollTest;
 };
 
 #endif // GB_SPIDERCOLL_H
@@ -46,13 +46,10 @@ SpiderLoop g_spiderLoop;
 
 SpiderLoop::SpiderLoop ( ) {
 	m_crx = NULL;
-	// clear array of ptrs to Doc's
-	memset ( m_docs , 0 , sizeof(XmlDoc *) * MAX_SPIDERS );
 
 	// Coverity
 	m_numSpidersOut = 0;
 	m_launches = 0;
-	m_maxUsed = 0;
 	m_sc = NULL;
 	m_gettingDoledbList = false;
 	m_activeList = NULL;
@@ -71,13 +68,19 @@ SpiderLoop::~SpiderLoop ( ) {
 // free all doc's
 void SpiderLoop::reset() {
 	// delete all doc's in use
-	for ( int32_t i = 0 ; i < MAX_SPIDERS ; i++ ) {
+	for ( size_t i = 0 ; i < m_docs.size() ; i++ ) {
 		if ( m_docs[i] ) {
 			mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
 			delete (m_docs[i]);
 		}
-		m_docs[i] = NULL;
-	}
+		delete m_docArenas[i];
+	}
+	m_docs.clear();
+	m_docArenas.clear();
+	m_docFirstIps.clear();
+	m_freeDocSlots.clear();
+	m_docSlotTable.reset();
+	m_ipOutTable.reset();
 	m_list.freeList();
 	m_lockTable.reset();
 	m_winnerListCache.reset();
@@ -95,16 +98,17 @@ void SpiderLoop::init() {
 	// we aren't in the middle of waiting to get a list of SpiderRequests
 	m_gettingDoledbList = false;
 
-	// clear array of ptrs to Doc's
-	memset ( m_docs , 0 , sizeof(XmlDoc *) * MAX_SPIDERS );
-	// . m_maxUsed is the largest i such that m_docs[i] is in use
-	// . -1 means there are no used m_docs's
-	m_maxUsed = -1;
 	m_numSpidersOut = 0;
 
 	// for locking. key size is 8 for easier debugging
 	m_lockTable.set ( 8,sizeof(UrlLock),0,NULL,0,false, "splocks", true ); // useKeyMagic? yes.
 
+	// xmldoc ptr to its slot in m_docs
+	m_docSlotTable.set ( 8,4,0,NULL,0,false, "spdocslot", true ); // useKeyMagic? yes, the low bits of a ptr are 0
+
+	// firstip/collnum to the number of docs out
+	m_ipOutTable.set ( 8,4,0,NULL,0,false, "spipout" );
+
 	if ( ! m_winnerListCache.init ( 20000000 , // maxcachemem, 20MB
 					-1     , // fixedatasize
 					false , // supportlists?
@@ -343,12 +347,6 @@ subloop:
 		return;
 	}
 	
-	// stop if too many out. this is now 50 down from 500.
-	if ( m_numSpidersOut >= MAX_SPIDERS ) {
-		logTrace( g_conf.m_logTraceSpider, "END, reached max spiders"  );
-		return;
-	}
-	
 	// a new global conf rule
 	if ( m_numSpidersOut >= g_conf.m_maxTotalSpiders ) {
 		logTrace( g_conf.m_logTraceSpider, "END, reached max total spiders"  );
@@ -650,7 +648,7 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// skip if too many udp slots being used
 	if (g_udpServer.getNumUsedSlotsIncoming() >= MAXUDPSLOTS ) bail =true;
 	// stop if too many out
-	if ( m_numSpidersOut >= MAX_SPIDERS ) bail = true;
+	if ( m_numSpidersOut >= g_conf.m_maxTotalSpiders ) bail = true;
 
 	if ( bail ) {
 		// return false to indicate to try another
@@ -781,22 +779,15 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// . how many spiders out for this ip now?
 	// . TODO: count locks in case twin is spidering... but it did not seem
 	//   to work right for some reason
-	for ( int32_t i = 0 ; i <= m_maxUsed ; i++ ) {
-		// get it
-		XmlDoc *xd = m_docs[i];
-		if ( ! xd ) continue;
-		if ( ! xd->m_sreqValid ) continue;
-		// to prevent one collection from hogging all the urls for
-		// particular IP and starving other collections, let's make 
-		// this a per collection count.
-		// then allow msg13.cpp to handle the throttling on its end.
-		// also do a global count over all collections now
-		if ( xd->m_sreq.m_firstIp == sreq->m_firstIp ) globalOut++;
-		// only count for our same collection otherwise another
-		// collection can starve us out
-		if ( xd->m_collnum != cr->m_collnum ) continue;
-		if ( xd->m_sreq.m_firstIp == sreq->m_firstIp ) ipOut++;
-	}
+	// . to prevent one collection from hogging all the urls for
+	//   particular IP and starving other collections, let's make
+	//   this a per collection count.
+	//   then allow msg13.cpp to handle the throttling on its end.
+	//   also do a global count over all collections now
+	globalOut = getNumSpidersOutPerIp ( sreq->m_firstIp , -1 );
+	// only count for our same collection otherwise another
+	// collection can starve us out
+	ipOut = getNumSpidersOutPerIp ( sreq->m_firstIp , cr->m_collnum );
 
 	// don't give up on this priority, just try next in the list.
 	// we now read 50k instead of 2k from doledb in order to fix
@@ -955,7 +946,7 @@ bool SpiderLoop::spiderUrl(SpiderRequest *sreq, key96_t *doledbKey, collnum_t co
 	     // repairing the collection's rdbs?
 	     g_repairMode ) {
 		// try to cancel outstanding spiders, ignore injects
-		for ( int32_t i = 0 ; i <= m_maxUsed ; i++ ) {
+		for ( size_t i = 0 ; i < m_docs.size() ; i++ ) {
 			// get it
 			XmlDoc *xd = m_docs[i];
 			if ( ! xd                      ) continue;
@@ -1010,7 +1001,7 @@ bool SpiderLoop::spiderUrl(SpiderRequest *sreq, key96_t *doledbKey, collnum_t co
 	// to zero, we do a re-scan and get a doledbkey that is currently
 	// being spidered or is waiting for its negative doledb key to
 	// get into our doledb tree
-	for ( int32_t i = 0 ; i <= m_maxUsed ; i++ ) {
+	for ( size_t i = 0 ; i < m_docs.size() ; i++ ) {
 		// get it
 		XmlDoc *xd = m_docs[i];
 		if ( ! xd ) continue;
@@ -1117,18 +1108,6 @@ bool SpiderLoop::spiderUrl(SpiderRequest *sreq, key96_t *doledbKey, collnum_t co
 bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, key96_t *doledbKey, collnum_t collnum) {
 	logTrace( g_conf.m_logTraceSpider, "BEGIN" );
 
-	// . find an available doc slot
-	// . we can have up to MAX_SPIDERS spiders (300)
-	int32_t i;
-	for ( i=0 ; i<MAX_SPIDERS ; i++ ) if (! m_docs[i]) break;
-
-	// come back later if we're full
-	if ( i >= MAX_SPIDERS ) {
-		log(LOG_DEBUG,"build: Already have %" PRId32" outstanding spiders.",
-		    (int32_t)MAX_SPIDERS);
-		g_process.shutdownAbort(true);
-	}
-
 	XmlDoc *xd;
 	// otherwise, make a new one if we have to
 	try { xd = new (XmlDoc); }
@@ -1144,8 +1123,20 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, key96_t *doledbKey, collnum_t c
 	}
 	// register it's mem usage with Mem.cpp class
 	mnew ( xd , sizeof(XmlDoc) , "XmlDoc" );
+
+	// find an available doc slot
+	int32_t i = getFreeDocSlot();
+	if ( i < 0 ) {
+		mdelete ( xd , sizeof(XmlDoc) , "Doc" );
+		delete ( xd );
+		log("build: Could not allocate a doc slot to spider the url %s. Will retry later.", sreq->m_url);
+		logTrace( g_conf.m_logTraceSpider, "END, getFreeDocSlot failed" );
+		return true;
+	}
+
 	// add to the array
 	m_docs [ i ] = xd;
+	xd->setArena ( m_docArenas[i] );
 
 	CollectionRec *cr = g_collectiondb.getRec(collnum);
 	const char *coll = "collnumwasinvalid";
@@ -1169,6 +1160,7 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, key96_t *doledbKey, collnum_t c
 		mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
 		delete (m_docs[i]);
 		m_docs[i] = NULL;
+		m_freeDocSlots.push_back ( i );
 		// error, g_errno should be set!
 		logTrace( g_conf.m_logTraceSpider, "END, xd->set4 returned false" );
 		return true;
@@ -1177,10 +1169,21 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, key96_t *doledbKey, collnum_t c
 	// call this after doc gets indexed
 	xd->setCallback ( xd  , indexedDocWrapper );
 
-	// increase m_maxUsed if we have to
-	if ( i > m_maxUsed ) m_maxUsed = i;
+	// remember the slot for indexedDoc()
+	int64_t docKey = (int64_t)(intptr_t)xd;
+	if ( ! m_docSlotTable.addKey ( &docKey , &i ) ) {
+		mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
+		delete (m_docs[i]);
+		m_docs[i] = NULL;
+		m_freeDocSlots.push_back ( i );
+		logTrace( g_conf.m_logTraceSpider, "END, m_docSlotTable.addKey failed" );
+		return true;
+	}
+
 	// count it
 	m_numSpidersOut++;
+	m_docFirstIps[i] = sreq->m_firstIp;
+	changeNumSpidersOutPerIp ( sreq->m_firstIp , xd->m_collnum , 1 );
 	// count this
 	m_sc->m_spidersOut++;
 
@@ -1239,22 +1242,19 @@ bool SpiderLoop::indexedDoc ( XmlDoc *xd ) {
 	logTrace( g_conf.m_logTraceSpider, "BEGIN" );
 
 	// get our doc #, i
-	int32_t i = 0;
-	for ( ; i < MAX_SPIDERS ; i++ ) if ( m_docs[i] == xd) break;
+	int64_t docKey = (int64_t)(intptr_t)xd;
+	int32_t *slot = (int32_t *)m_docSlotTable.getValue ( &docKey );
 	// sanity check
-	if ( i >= MAX_SPIDERS ) { g_process.shutdownAbort(true); }
-
-	// . decrease m_maxUsed if we need to
-	// . we can decrease all the way to -1, which means no spiders going on
-	if ( m_maxUsed == i ) {
-		m_maxUsed--;
-		while ( m_maxUsed >= 0 && ! m_docs[m_maxUsed] ) m_maxUsed--;
-	}
-	// count it
-	m_numSpidersOut--;
+	if ( ! slot || m_docs[*slot] != xd ) { g_process.shutdownAbort(true); }
+	int32_t i = *slot;
+	m_docSlotTable.removeKey ( &docKey );
 
 	// get coll
 	collnum_t collnum = xd->m_collnum;
+
+	// count it
+	m_numSpidersOut--;
+	changeNumSpidersOutPerIp ( m_docFirstIps[i] , collnum , -1 );
 	// if coll was deleted while spidering, sc will be NULL
 	SpiderColl *sc = g_spiderCache.getSpiderColl(collnum);
 	// decrement this
@@ -1288,6 +1288,7 @@ bool SpiderLoop::indexedDoc ( XmlDoc *xd ) {
 	mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
 	delete (m_docs[i]);
 	m_docs[i] = NULL;
+	m_freeDocSlots.push_back ( i );
 
 	// we did not block, so return true
 	logTrace( g_conf.m_logTraceSpider, "END" );
@@ -1296,40 +1297,64 @@ bool SpiderLoop::indexedDoc ( XmlDoc *xd ) {
 
 
 
-// use -1 for any collnum
-int32_t SpiderLoop::getNumSpidersOutPerIp(int32_t firstIp, collnum_t collnum) {
-	ScopedLock sl(m_lockTableMtx);
-	int32_t count = 0;
-
-	// scan the slots
-	for (int32_t i = 0; i < m_lockTable.getNumSlots(); i++) {
-		// skip if empty
-		if (!m_lockTable.m_flags[i]) {
-			continue;
-		}
+// . returns a free slot in m_docs, adding one if they are all in use
+// . returns -1 and sets g_errno on error
+int32_t SpiderLoop::getFreeDocSlot ( ) {
+	if ( ! m_freeDocSlots.empty() ) {
+		int32_t i = m_freeDocSlots.back();
+		m_freeDocSlots.pop_back();
+		return i;
+	}
 
-		// cast lock
-		UrlLock *lock = (UrlLock *)m_lockTable.getValueFromSlot(i);
+	Arena *arena;
+	try { arena = new Arena ( "spiderdoc" ); }
+	catch(std::bad_alloc&) {
+		g_errno = ENOMEM;
+		return -1;
+	}
 
-		// skip if not outstanding, just a 5-second expiration wait
-		// when the spiderReply returns, so that in case a lock
-		// request for the same url was in progress, it will be denied.
-		if (!lock->m_spiderOutstanding) {
-			continue;
-		}
+	m_docs.push_back ( NULL );
+	m_docArenas.push_back ( arena );
+	m_docFirstIps.push_back ( 0 );
+	// make sure indexedDoc() can free the slot without allocating
+	m_freeDocSlots.reserve ( m_docs.size() );
+	return (int32_t)m_docs.size() - 1;
+}
 
-		// correct collnum?
-		if (lock->m_collnum != collnum && collnum != -1) {
-			continue;
-		}
+static int64_t makeIpOutKey ( int32_t firstIp , collnum_t collnum ) {
+	return ( (int64_t)(uint32_t)firstIp << 16 ) | (uint16_t)collnum;
+}
 
-		// skip if not yet expired
-		if (lock->m_firstIp == firstIp) {
-			count++;
+void SpiderLoop::changeNumSpidersOutPerIp ( int32_t firstIp , collnum_t collnum , int32_t delta ) {
+	ScopedLock sl(m_ipOutTableMtx);
+
+	// once for the collection and once for all collections
+	for ( int32_t j = 0 ; j < 2 ; j++ ) {
+		int64_t key = makeIpOutKey ( firstIp , j ? (collnum_t)-1 : collnum );
+		int32_t *count = (int32_t *)m_ipOutTable.getValue ( &key );
+		int32_t newCount = ( count ? *count : 0 ) + delta;
+
+		if ( newCount > 0 ) {
+			if ( count ) {
+				*count = newCount;
+			} else if ( ! m_ipOutTable.addKey ( &key , &newCount ) ) {
+				// only the throttling per ip is off then
+				log(LOG_WARN, "spider: could not count spider out for firstip %" PRId32": %s",
+				    firstIp, mstrerror(g_errno));
+				g_errno = 0;
+			}
+		} else if ( count ) {
+			m_ipOutTable.removeKey ( &key );
 		}
 	}
+}
 
-	return count;
+// use -1 for any collnum
+int32_t SpiderLoop::getNumSpidersOutPerIp(int32_t firstIp, collnum_t collnum) {
+	ScopedLock sl(m_ipOutTableMtx);
+	int64_t key = makeIpOutKey ( firstIp , collnum );
+	const int32_t *count = (const int32_t *)m_ipOutTable.getValue ( &key );
+	return count ? *count : 0;
 }
 
 
@@ -8,8 +8,10 @@
 #include "Msg5.h"
 #include "hash.h"
 #include "RdbCache.h"
+#include "Arena.h"
 #include <time.h>
 #include <atomic>
+#include <vector>
 
 // . the spider loop
 // . it gets urls to spider from the SpiderCache global class, g_spiderCache
@@ -17,10 +19,8 @@
 // . supports <META NAME="ROBOTS" CONTENT="NOINDEX">  (no indexing)
 // . supports <META NAME="ROBOTS" CONTENT="NOFOLLOW"> (no links)
 // . supports limiting spiders per domain
-
-// . max spiders we can have going at once for this process
-// . limit to 50 to preven OOM conditions
-#define MAX_SPIDERS 300
+// . the number of spiders out at once is limited by
+//   g_conf.m_maxTotalSpiders and the collection's m_maxNumSpiders
 
 
 class UdpSlot;
@@ -52,8 +52,10 @@ public:
 	void removeLock(int64_t key);
 	void clearLocks(collnum_t collnum);
 
-	// for spidering/parsing/indexing a url(s)
-	XmlDoc *m_docs [ MAX_SPIDERS ];
+	// . for spidering/parsing/indexing a url(s)
+	// . NULL if the slot is free. grows to the most spiders we have had
+	//   out at once and never shrinks
+	std::vector<XmlDoc *> m_docs;
 
 	RdbCache   m_winnerListCache;
 
@@ -75,14 +77,31 @@ private:
 
 	bool indexedDoc ( XmlDoc *doc );
 
+	int32_t getFreeDocSlot ( );
+	void changeNumSpidersOutPerIp ( int32_t firstIp , collnum_t collnum , int32_t delta );
+
 	CollectionRec *getActiveList();
 	void buildActiveList ( ) ;
 
 	std::atomic<int32_t> m_numSpidersOut;
 
-	// . this is "i" where m_msg14[i] is the highest m_msg14 in use
-	// . we use it to limit our scanning to the first "i" m_msg14's
-	int32_t m_maxUsed;
+	// . the arena of the doc in each slot of m_docs. it is rewound but
+	//   keeps up to g_conf.m_docArenaKeepSize bytes when the doc is done,
+	//   so the next doc in the slot reuses its memory
+	std::vector<Arena *> m_docArenas;
+	// the firstip each doc in m_docs was counted under in m_ipOutTable
+	std::vector<int32_t> m_docFirstIps;
+	// the free slots of m_docs
+	std::vector<int32_t> m_freeDocSlots;
+	// maps an XmlDoc ptr to its slot in m_docs
+	HashTableX m_docSlotTable;
+
+	// . number of docs out per firstip and collnum, and per firstip over
+	//   all collections with a collnum of -1
+	// . kept up to date as spiders are launched and return so we do not
+	//   have to scan m_docs or the lock table to count them
+	HashTableX m_ipOutTable;
+	mutable GbMutex m_ipOutTableMtx;
 
 	int32_t m_launches;
 
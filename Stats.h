@@ -93,6 +93,8 @@ class Stats {
 	int32_t m_acksIn     [MAX_MSG_TYPES][2];
 	int32_t m_acksOut    [MAX_MSG_TYPES][2];
 	int32_t m_reroutes   [MAX_MSG_TYPES][2];
+	int32_t m_hedges     [MAX_MSG_TYPES][2]; // multicast sent to a twin too
+	int32_t m_hedgeWins  [MAX_MSG_TYPES][2]; // and the twin replied first
 	int32_t m_errors     [MAX_MSG_TYPES][2];
 	int32_t m_timeouts   [MAX_MSG_TYPES][2]; // specific error
 	int32_t m_nomem      [MAX_MSG_TYPES][2]; // specific error
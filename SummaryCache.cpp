@@ -85,14 +85,18 @@ void SummaryCache::insert(int64_t key, const void *data, size_t datalen)
 }
 
 
-bool SummaryCache::lookup(int64_t key, const void **data, size_t *datalen)
+bool SummaryCache::lookup(int64_t key, void **data, size_t *datalen)
 {
 	ScopedLock sl(mtx);
 	
 	purge_step();
 	std::map<int64_t,Item>::iterator iter = m.find(key);
 	if(iter!=m.end() && iter->second.timestamp+max_age>=gettimeofdayInMilliseconds()) {
-		*data = iter->second.data;
+		void *datacopy = mmalloc(iter->second.datalen, memory_note);
+		if(!datacopy)
+			return false;
+		memcpy(datacopy,iter->second.data,iter->second.datalen);
+		*data = datacopy;
 		*datalen = iter->second.datalen;
 		return true;
 	} else
@@ -31,7 +31,9 @@ public:
 	void clear();
 
 	void insert(int64_t key, const void *data, size_t datalen);
-	bool lookup(int64_t key, const void **data, size_t *datalen);
+	// on a hit *data is a mmalloc()'ed copy the caller must free. the
+	// entry itself can be purged by another thread right after we unlock
+	bool lookup(int64_t key, void **data, size_t *datalen);
 
 private:
 	void purge_step();
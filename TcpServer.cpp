@@ -792,14 +792,10 @@ TcpSocket *TcpServer::getNewSocket ( ) {
 		sd = newSock;
 	}
 	if ( sd >= MAX_NUM_FDS ) {
-		log("tcp: using statically linked libc that only supports "
-		    "an fd of up to %" PRId32", but got an fd = %" PRId32". fd_set is "
-		    "only geared for 1024 bits of file descriptors for "
-		    "doing poll() in Loop.cpp. Ensure 'ulimit -a' limits "
-		    "open files to 1024. "
-		    "Check open fds using ls /proc/<gb-pid>/fds/ and ensure "
-		    "they are all BELOW 1024.",
-		    (int32_t)MAX_NUM_FDS,(int32_t)sd);
+		log("tcp: Loop only supports an fd of up to %" PRId32", but got "
+		    "an fd = %" PRId32". Ensure 'ulimit -n' limits open files "
+		    "to %" PRId32" or raise MAX_NUM_FDS in Loop.h.",
+		    (int32_t)MAX_NUM_FDS,(int32_t)sd,(int32_t)MAX_NUM_FDS);
 		g_process.shutdownAbort(true); 
 	}
 	// return NULL and set g_errno on failure
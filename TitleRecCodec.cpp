@@ -0,0 +1,522 @@
+#include "gb-include.h"
+
+#include "TitleRecCodec.h"
+#include "GbCompress.h"
+#include "Collectiondb.h"
+#include "Hostdb.h"
+#include "Dir.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Errno.h"
+#include "ScopedLock.h"
+#include <zstd.h>
+#include <zdict.h>
+#include <lz4.h>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+
+// zstd reserves dictionary ids below this one for a future registry
+static const uint32_t s_firstDictId = 32768;
+
+// titledict.<id>.zdict
+static const char s_dictPrefix[] = "titledict.";
+static const char s_dictSuffix[] = ".zdict";
+
+
+const char *getTitleRecCodecName(titlerec_codec_t codec) {
+	switch ( codec ) {
+		case TITLEREC_CODEC_ZLIB: return "zlib";
+		case TITLEREC_CODEC_ZSTD: return "zstd";
+		case TITLEREC_CODEC_LZ4:  return "lz4";
+	}
+	return "unknown";
+}
+
+titlerec_codec_t getTitleRecCodecFromName(const char *name) {
+	if ( strcasecmp(name, "zstd") == 0 ) return TITLEREC_CODEC_ZSTD;
+	if ( strcasecmp(name, "lz4") == 0 )  return TITLEREC_CODEC_LZ4;
+	return TITLEREC_CODEC_ZLIB;
+}
+
+
+TitleRecDicts::TitleRecDicts()
+  : m_mtx(),
+    m_dicts(),
+    m_retiredCDicts(),
+    m_newestId(0)
+{
+	m_dir[0] = '\0';
+}
+
+TitleRecDicts::~TitleRecDicts() {
+	reset();
+}
+
+void TitleRecDicts::reset() {
+	for ( std::map<uint32_t, Dict>::iterator it = m_dicts.begin(); it != m_dicts.end(); ++it ) {
+		Dict &d = it->second;
+		ZSTD_freeDDict((ZSTD_DDict *)d.m_ddict);
+		ZSTD_freeCDict((ZSTD_CDict *)d.m_cdict);
+		mfree(d.m_buf, d.m_size, "titledict");
+	}
+	m_dicts.clear();
+	for ( size_t i = 0; i < m_retiredCDicts.size(); i++ ) {
+		ZSTD_freeCDict((ZSTD_CDict *)m_retiredCDicts[i]);
+	}
+	m_retiredCDicts.clear();
+	m_newestId = 0;
+}
+
+bool TitleRecDicts::addDict(uint32_t dictId, char *buf, size_t size) {
+	ZSTD_DDict *ddict = ZSTD_createDDict(buf, size);
+	if ( ! ddict ) {
+		log(LOG_WARN, "db: Could not digest titledb dictionary %" PRIu32" in %s", dictId, m_dir);
+		mfree(buf, size, "titledict");
+		g_errno = EBADFILE;
+		return false;
+	}
+
+	Dict d;
+	d.m_buf = buf;
+	d.m_size = size;
+	d.m_ddict = ddict;
+	d.m_cdict = NULL;
+	d.m_cdictLevel = 0;
+	m_dicts[dictId] = d;
+
+	if ( dictId > m_newestId ) {
+		m_newestId = dictId;
+	}
+	return true;
+}
+
+bool TitleRecDicts::load(const char *dir) {
+	ScopedLock sl(m_mtx);
+	reset();
+
+	snprintf(m_dir, sizeof(m_dir), "%s", dir);
+
+	Dir d;
+	d.set(m_dir);
+	if ( ! d.open() ) {
+		// no dir, no dictionaries
+		return true;
+	}
+
+	char pattern[64];
+	sprintf(pattern, "%s*", s_dictPrefix);
+
+	while ( const char *filename = d.getNextFilename(pattern) ) {
+		// skip titledict.<id>.zdict.tmp left by a failed train()
+		size_t len = strlen(filename);
+		if ( len < sizeof(s_dictSuffix) || strcmp(filename + len - strlen(s_dictSuffix), s_dictSuffix) != 0 ) {
+			continue;
+		}
+
+		uint32_t dictId;
+		if ( sscanf(filename + strlen(s_dictPrefix), "%" SCNu32, &dictId) != 1 ) {
+			continue;
+		}
+
+		char path[1200];
+		snprintf(path, sizeof(path), "%s%s", m_dir, filename);
+
+		FILE *fp = fopen(path, "r");
+		if ( ! fp ) {
+			log(LOG_WARN, "db: Couldn't open %s, errno=%d (%s)", path, errno, strerror(errno));
+			continue;
+		}
+
+		struct stat st;
+		if ( fstat(fileno(fp), &st) != 0 || st.st_size <= 8 ) {
+			log(LOG_WARN, "db: %s is empty or unreadable", path);
+			fclose(fp);
+			continue;
+		}
+
+		size_t size = st.st_size;
+		char *buf = (char *)mmalloc(size, "titledict");
+		if ( ! buf ) {
+			fclose(fp);
+			return false;
+		}
+
+		bool ok = ( fread(buf, 1, size, fp) == size );
+		fclose(fp);
+
+		// the id in the file must match its name or records would be
+		// looked up with the wrong dictionary
+		if ( ! ok || ZDICT_getDictID(buf, size) != dictId ) {
+			log(LOG_WARN, "db: %s is damaged or its id doesn't match its name", path);
+			mfree(buf, size, "titledict");
+			continue;
+		}
+
+		if ( ! addDict(dictId, buf, size) ) {
+			continue;
+		}
+
+		log(LOG_INFO, "db: Loaded titledb dictionary %s (%" PRId64" bytes)", path, (int64_t)size);
+	}
+
+	d.close();
+	return true;
+}
+
+bool TitleRecDicts::train(const char *samples, const size_t *sampleSizes, uint32_t numSamples, size_t maxDictSize, uint32_t *dictId) {
+	char *buf = (char *)mmalloc(maxDictSize, "titledict");
+	if ( ! buf ) {
+		return false;
+	}
+
+	size_t size = ZDICT_trainFromBuffer(buf, maxDictSize, samples, sampleSizes, numSamples);
+	if ( ZDICT_isError(size) ) {
+		log(LOG_WARN, "db: Training titledb dictionary from %" PRIu32" samples failed: %s",
+		    numSamples, ZDICT_getErrorName(size));
+		mfree(buf, maxDictSize, "titledict");
+		g_errno = ECOMPRESSFAILED;
+		return false;
+	}
+
+	// shrink to fit
+	char *tmp = (char *)mrealloc(buf, maxDictSize, size, "titledict");
+	if ( ! tmp ) {
+		mfree(buf, maxDictSize, "titledict");
+		return false;
+	}
+	buf = tmp;
+
+	ScopedLock sl(m_mtx);
+
+	// . ids are sequential so the newest one is the one used for compressing
+	// . the id is in the dictionary header (after the magic) in little endian
+	uint32_t newId = m_newestId ? m_newestId + 1 : s_firstDictId;
+	buf[4] = (char)(newId);
+	buf[5] = (char)(newId >> 8);
+	buf[6] = (char)(newId >> 16);
+	buf[7] = (char)(newId >> 24);
+
+	char path[1200];
+	char tmpPath[1300];
+	snprintf(path, sizeof(path), "%s%s%" PRIu32"%s", m_dir, s_dictPrefix, newId, s_dictSuffix);
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+	FILE *fp = fopen(tmpPath, "w");
+	if ( ! fp ) {
+		log(LOG_WARN, "db: Couldn't create %s, errno=%d (%s)", tmpPath, errno, strerror(errno));
+		mfree(buf, size, "titledict");
+		g_errno = errno;
+		return false;
+	}
+	bool ok = ( fwrite(buf, 1, size, fp) == size );
+	if ( fclose(fp) != 0 ) {
+		ok = false;
+	}
+	if ( ! ok || rename(tmpPath, path) != 0 ) {
+		log(LOG_WARN, "db: Couldn't write %s, errno=%d (%s)", path, errno, strerror(errno));
+		unlink(tmpPath);
+		mfree(buf, size, "titledict");
+		g_errno = errno;
+		return false;
+	}
+
+	if ( ! addDict(newId, buf, size) ) {
+		return false;
+	}
+
+	log(LOG_INFO, "db: Trained titledb dictionary %s (%" PRId64" bytes) from %" PRIu32" samples",
+	    path, (int64_t)size, numSamples);
+
+	if ( dictId ) {
+		*dictId = newId;
+	}
+	return true;
+}
+
+uint32_t TitleRecDicts::getNewestId() const {
+	ScopedLock sl(m_mtx);
+	return m_newestId;
+}
+
+int32_t TitleRecDicts::getNumDicts() const {
+	ScopedLock sl(m_mtx);
+	return (int32_t)m_dicts.size();
+}
+
+const void *TitleRecDicts::getCDict(int32_t level) {
+	ScopedLock sl(m_mtx);
+	if ( ! m_newestId ) {
+		return NULL;
+	}
+
+	Dict &d = m_dicts[m_newestId];
+	if ( d.m_cdict && d.m_cdictLevel == level ) {
+		return d.m_cdict;
+	}
+
+	// . the level changed. the old one may still be in use by another
+	//   thread, so keep it around until we are reset
+	// . this only happens when the level parm is changed
+	if ( d.m_cdict ) {
+		m_retiredCDicts.push_back(d.m_cdict);
+	}
+
+	d.m_cdict = ZSTD_createCDict(d.m_buf, d.m_size, level);
+	d.m_cdictLevel = level;
+	return d.m_cdict;
+}
+
+const void *TitleRecDicts::getDDict(uint32_t dictId) const {
+	ScopedLock sl(m_mtx);
+	std::map<uint32_t, Dict>::const_iterator it = m_dicts.find(dictId);
+	if ( it == m_dicts.end() ) {
+		return NULL;
+	}
+	return it->second.m_ddict;
+}
+
+
+static GbMutex s_mtxDicts;
+static std::map<collnum_t, TitleRecDicts *> s_dicts;
+// dictionaries of deleted/reused collnums. another thread may still be using
+// them
+static std::vector<TitleRecDicts *> s_retiredDicts;
+
+TitleRecDicts *getTitleRecDicts(collnum_t collnum) {
+	CollectionRec *cr = g_collectiondb.getRec(collnum);
+	if ( ! cr ) {
+		return NULL;
+	}
+
+	char dir[1024];
+	snprintf(dir, sizeof(dir), "%scoll.%s.%" PRId32"/", g_hostdb.m_dir, cr->m_coll, (int32_t)collnum);
+
+	ScopedLock sl(s_mtxDicts);
+
+	std::map<collnum_t, TitleRecDicts *>::iterator it = s_dicts.find(collnum);
+	if ( it != s_dicts.end() ) {
+		if ( strcmp(it->second->getDir(), dir) == 0 ) {
+			return it->second;
+		}
+		s_retiredDicts.push_back(it->second);
+		s_dicts.erase(it);
+	}
+
+	TitleRecDicts *dicts;
+	try {
+		dicts = new TitleRecDicts();
+	} catch ( std::bad_alloc & ) {
+		g_errno = ENOMEM;
+		log(LOG_WARN, "db: Could not allocate titledb dictionaries");
+		return NULL;
+	}
+	mnew(dicts, sizeof(TitleRecDicts), "titledicts");
+
+	dicts->load(dir);
+	s_dicts[collnum] = dicts;
+	return dicts;
+}
+
+void resetTitleRecDicts() {
+	ScopedLock sl(s_mtxDicts);
+	for ( std::map<collnum_t, TitleRecDicts *>::iterator it = s_dicts.begin(); it != s_dicts.end(); ++it ) {
+		mdelete(it->second, sizeof(TitleRecDicts), "titledicts");
+		delete it->second;
+	}
+	s_dicts.clear();
+	for ( size_t i = 0; i < s_retiredDicts.size(); i++ ) {
+		mdelete(s_retiredDicts[i], sizeof(TitleRecDicts), "titledicts");
+		delete s_retiredDicts[i];
+	}
+	s_retiredDicts.clear();
+}
+
+
+// . contexts are expensive to set up, so each thread keeps one of each
+// . they are freed by the key destructors when the thread exits
+static __thread ZSTD_CCtx *s_cctx = NULL;
+static __thread ZSTD_DCtx *s_dctx = NULL;
+static pthread_key_t s_cctxKey;
+static pthread_key_t s_dctxKey;
+static pthread_once_t s_ctxKeysOnce = PTHREAD_ONCE_INIT;
+
+static void freeCCtx(void *arg) {
+	ZSTD_freeCCtx((ZSTD_CCtx *)arg);
+	s_cctx = NULL;
+}
+
+static void freeDCtx(void *arg) {
+	ZSTD_freeDCtx((ZSTD_DCtx *)arg);
+	s_dctx = NULL;
+}
+
+static void initCtxKeys() {
+	pthread_key_create(&s_cctxKey, freeCCtx);
+	pthread_key_create(&s_dctxKey, freeDCtx);
+}
+
+static ZSTD_CCtx *getCCtx() {
+	if ( ! s_cctx ) {
+		pthread_once(&s_ctxKeysOnce, initCtxKeys);
+		s_cctx = ZSTD_createCCtx();
+		if ( s_cctx ) {
+			pthread_setspecific(s_cctxKey, s_cctx);
+		}
+	}
+	return s_cctx;
+}
+
+static ZSTD_DCtx *getDCtx() {
+	if ( ! s_dctx ) {
+		pthread_once(&s_ctxKeysOnce, initCtxKeys);
+		s_dctx = ZSTD_createDCtx();
+		if ( s_dctx ) {
+			pthread_setspecific(s_dctxKey, s_dctx);
+		}
+	}
+	return s_dctx;
+}
+
+int32_t getTitleRecCompressBound(titlerec_codec_t codec, int32_t srcSize) {
+	switch ( codec ) {
+		case TITLEREC_CODEC_ZSTD:
+			return (int32_t)ZSTD_compressBound(srcSize);
+		case TITLEREC_CODEC_LZ4:
+			return LZ4_compressBound(srcSize);
+		case TITLEREC_CODEC_ZLIB:
+			break;
+	}
+	// . according to zlib.h line 613 compress buffer must be .1% larger
+	//   than source plus 12 bytes. (i add one for round off error)
+	// . now i added another extra 12 bytes cuz compress seemed to want it
+	return ((int64_t)srcSize * 1001LL) / 1000LL + 13 + 12;
+}
+
+bool titleRecCompress(titlerec_codec_t codec, int32_t level, TitleRecDicts *dicts,
+                      char *dst, int32_t *dstSize, const char *src, int32_t srcSize) {
+	switch ( codec ) {
+		case TITLEREC_CODEC_ZLIB: {
+			uint32_t size = *dstSize;
+			int err = gbcompress((unsigned char *)dst, &size, (const unsigned char *)src, srcSize);
+			if ( err != Z_OK || size > (uint32_t)*dstSize ) {
+				log(LOG_ERROR, "db: zlib compression of %" PRId32" bytes failed. err=%d", srcSize, err);
+				g_errno = ECOMPRESSFAILED;
+				return false;
+			}
+			*dstSize = size;
+			return true;
+		}
+
+		case TITLEREC_CODEC_ZSTD: {
+			ZSTD_CCtx *cctx = getCCtx();
+			if ( ! cctx ) {
+				g_errno = ENOMEM;
+				return false;
+			}
+			const ZSTD_CDict *cdict = dicts ? (const ZSTD_CDict *)dicts->getCDict(level) : NULL;
+			size_t size;
+			if ( cdict ) {
+				size = ZSTD_compress_usingCDict(cctx, dst, *dstSize, src, srcSize, cdict);
+			} else {
+				size = ZSTD_compressCCtx(cctx, dst, *dstSize, src, srcSize, level);
+			}
+			if ( ZSTD_isError(size) ) {
+				log(LOG_ERROR, "db: zstd compression of %" PRId32" bytes failed: %s", srcSize, ZSTD_getErrorName(size));
+				g_errno = ECOMPRESSFAILED;
+				return false;
+			}
+			*dstSize = (int32_t)size;
+			return true;
+		}
+
+		case TITLEREC_CODEC_LZ4: {
+			int size = LZ4_compress_default(src, dst, srcSize, *dstSize);
+			if ( size <= 0 ) {
+				log(LOG_ERROR, "db: lz4 compression of %" PRId32" bytes failed", srcSize);
+				g_errno = ECOMPRESSFAILED;
+				return false;
+			}
+			*dstSize = size;
+			return true;
+		}
+	}
+
+	log(LOG_ERROR, "db: Unknown titlerec codec %d", (int)codec);
+	g_errno = ECOMPRESSFAILED;
+	return false;
+}
+
+bool titleRecUncompress(titlerec_codec_t codec, TitleRecDicts *dicts,
+                        char *dst, int32_t *dstSize, const char *src, int32_t srcSize) {
+	switch ( codec ) {
+		case TITLEREC_CODEC_ZLIB: {
+			uint32_t size = *dstSize;
+			int err = gbuncompress((unsigned char *)dst, &size, (const unsigned char *)src, srcSize);
+			if ( err == Z_BUF_ERROR ) {
+				log(LOG_ERROR, "!!! Buffer is too small to hold uncompressed document. Probable disk corruption in a titledb file.");
+				g_errno = EUNCOMPRESSERROR;
+				return false;
+			}
+			if ( err != Z_OK ) {
+				log(LOG_ERROR, "!!! Uncompress of document failed. ZG_ERRNO=%i. srcSize=%" PRId32" dstSize=%" PRId32,
+				    err, srcSize, *dstSize);
+				g_errno = EUNCOMPRESSERROR;
+				return false;
+			}
+			*dstSize = size;
+			return true;
+		}
+
+		case TITLEREC_CODEC_ZSTD: {
+			ZSTD_DCtx *dctx = getDCtx();
+			if ( ! dctx ) {
+				g_errno = ENOMEM;
+				return false;
+			}
+			size_t size;
+			uint32_t dictId = ZSTD_getDictID_fromFrame(src, srcSize);
+			if ( dictId ) {
+				const ZSTD_DDict *ddict = dicts ? (const ZSTD_DDict *)dicts->getDDict(dictId) : NULL;
+				if ( ! ddict ) {
+					log(LOG_ERROR, "db: titlerec needs dictionary %" PRIu32" which isn't loaded. Copy %s%" PRIu32"%s from another host.",
+					    dictId, s_dictPrefix, dictId, s_dictSuffix);
+					g_errno = EUNCOMPRESSERROR;
+					return false;
+				}
+				size = ZSTD_decompress_usingDDict(dctx, dst, *dstSize, src, srcSize, ddict);
+			} else {
+				size = ZSTD_decompressDCtx(dctx, dst, *dstSize, src, srcSize);
+			}
+			if ( ZSTD_isError(size) ) {
+				log(LOG_ERROR, "!!! Uncompress of document failed: %s. srcSize=%" PRId32" dstSize=%" PRId32,
+				    ZSTD_getErrorName(size), srcSize, *dstSize);
+				g_errno = EUNCOMPRESSERROR;
+				return false;
+			}
+			*dstSize = (int32_t)size;
+			return true;
+		}
+
+		case TITLEREC_CODEC_LZ4: {
+			int size = LZ4_decompress_safe(src, dst, srcSize, *dstSize);
+			if ( size < 0 ) {
+				log(LOG_ERROR, "!!! Uncompress of document failed. lz4 err=%d srcSize=%" PRId32" dstSize=%" PRId32,
+				    size, srcSize, *dstSize);
+				g_errno = EUNCOMPRESSERROR;
+				return false;
+			}
+			*dstSize = size;
+			return true;
+		}
+	}
+
+	log(LOG_ERROR, "db: Unknown titlerec codec %d", (int)codec);
+	g_errno = EUNCOMPRESSERROR;
+	return false;
+}
@@ -0,0 +1,122 @@
+// . compression of the data part of titledb records
+// . a titlerec is key96 | dataSize | ubufSize | compressed data. the codec
+//   used is kept in bits 28-30 of the ubufSize field, so records written
+//   before there was a choice (all zlib) read as TITLEREC_CODEC_ZLIB
+// . zstd can use a dictionary trained from a sample of the titlerecs of a
+//   collection. they are kept in the collection dir as
+//   titledict.<id>.zdict and a dictionary is never changed once written,
+//   records compressed with it name it by id in the zstd frame header, so
+//   a newer dictionary can be trained without recompressing everything
+// . dictionaries are not distributed by gb. they must be copied to all the
+//   hosts (see tools/recompress_titledb.cpp) before turning them on
+
+#ifndef GB_TITLERECCODEC_H
+#define GB_TITLERECCODEC_H
+
+#include "types.h"
+#include "GbMutex.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+
+enum titlerec_codec_t {
+	TITLEREC_CODEC_ZLIB = 0,
+	TITLEREC_CODEC_ZSTD = 1,
+	TITLEREC_CODEC_LZ4  = 2,
+	TITLEREC_CODEC_MAX  = 2
+};
+
+#define TITLEREC_CODEC_SHIFT 28
+#define TITLEREC_USIZE_MASK  0x0fffffff
+
+// . uncompressed size from the ubufSize field of a titlerec
+// . a negative (corrupt) field is passed through so the callers' sanity
+//   checks still catch it
+static inline int32_t getTitleRecUncompressedSize(int32_t usizeField) {
+	if ( usizeField < 0 ) {
+		return usizeField;
+	}
+	return usizeField & TITLEREC_USIZE_MASK;
+}
+
+static inline titlerec_codec_t getTitleRecCodec(int32_t usizeField) {
+	return (titlerec_codec_t)(((uint32_t)usizeField >> TITLEREC_CODEC_SHIFT) & 0x07);
+}
+
+static inline int32_t makeTitleRecUsizeField(titlerec_codec_t codec, int32_t usize) {
+	return (int32_t)(((uint32_t)codec << TITLEREC_CODEC_SHIFT) | ((uint32_t)usize & TITLEREC_USIZE_MASK));
+}
+
+const char *getTitleRecCodecName(titlerec_codec_t codec);
+
+// returns TITLEREC_CODEC_ZLIB if the name is not known
+titlerec_codec_t getTitleRecCodecFromName(const char *name);
+
+// the dictionaries of one collection
+class TitleRecDicts {
+public:
+	TitleRecDicts();
+	~TitleRecDicts();
+
+	// load all titledict.*.zdict files in "dir" (ends with a slash)
+	bool load(const char *dir);
+
+	const char *getDir() const { return m_dir; }
+
+	// . train a new dictionary of at most maxDictSize bytes from the
+	//   uncompressed titlerecs in "samples" and save it in our dir
+	// . it becomes the newest one, used for compressing from now on
+	bool train(const char *samples, const size_t *sampleSizes, uint32_t numSamples, size_t maxDictSize, uint32_t *dictId);
+
+	// id of the dictionary new records are compressed with. 0 if none
+	uint32_t getNewestId() const;
+	int32_t getNumDicts() const;
+
+	// . digested dictionaries. returned pointers are valid as long as we are
+	// . getCDict() is the newest one, prepared for "level"
+	const void *getCDict(int32_t level);
+	const void *getDDict(uint32_t dictId) const;
+
+private:
+	struct Dict {
+		char    *m_buf;
+		size_t   m_size;
+		void    *m_ddict;
+		void    *m_cdict;
+		int32_t  m_cdictLevel;
+	};
+
+	bool addDict(uint32_t dictId, char *buf, size_t size);
+	void reset();
+
+	char m_dir[1024];
+	mutable GbMutex m_mtx;
+	std::map<uint32_t, Dict> m_dicts;
+	// compression dictionaries for a previous level
+	std::vector<void *> m_retiredCDicts;
+	uint32_t m_newestId;
+};
+
+// . dictionaries of the collection, loaded from its dir on first use
+// . NULL if the collection is gone
+TitleRecDicts *getTitleRecDicts(collnum_t collnum);
+void resetTitleRecDicts();
+
+// worst case compressed size of srcSize bytes
+int32_t getTitleRecCompressBound(titlerec_codec_t codec, int32_t srcSize);
+
+// . compress "src" into "dst" which has room for *dstSize bytes
+// . *dstSize is set to the compressed size
+// . "dicts" may be NULL. only zstd uses them
+// . returns false and sets g_errno on error
+bool titleRecCompress(titlerec_codec_t codec, int32_t level, TitleRecDicts *dicts,
+                      char *dst, int32_t *dstSize, const char *src, int32_t srcSize);
+
+// . uncompress "src" into "dst" which has room for *dstSize bytes
+// . *dstSize is set to the uncompressed size
+// . returns false and sets g_errno on error
+bool titleRecUncompress(titlerec_codec_t codec, TitleRecDicts *dicts,
+                        char *dst, int32_t *dstSize, const char *src, int32_t srcSize);
+
+#endif // GB_TITLERECCODEC_H
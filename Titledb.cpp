@@ -8,12 +8,16 @@
 #include "Conf.h"
 #include "XmlDoc.h"
 #include "UrlBlockList.h"
+#include "TitleRecCodec.h"
 
 Titledb g_titledb;
 Titledb g_titledb2;
 
 // reset rdb
-void Titledb::reset() { m_rdb.reset(); }
+void Titledb::reset() {
+	m_rdb.reset();
+	resetTitleRecDicts();
+}
 
 // init our rdb
 bool Titledb::init ( ) {
@@ -230,7 +234,7 @@ void Titledb::validateSerializedRecord(const char *rec, int32_t recSize) {
 		debugp += 4;
 
 		// what's the size of the uncompressed compressed stuff below here?
-		int32_t debug_ubufSize = *(int32_t  *) debugp; 
+		int32_t debug_ubufSize = getTitleRecUncompressedSize(*(int32_t  *) debugp);
 		if( debug_ubufSize <= 0 ) {
 			log(LOG_ERROR, "TITLEDB CORRUPTION. Record shows uncompressed size of %" PRId32". DocId=%" PRId64 "", debug_ubufSize, debug_docId);
 			gbshutdownLogicError();
@@ -0,0 +1,226 @@
+#include "gb-include.h"
+
+#include "UdpBatch.h"
+#include "UdpSlot.h"
+#include "UdpStatistic.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Errno.h"
+
+// big enough for any udp dgram
+static const int32_t s_recvBufSize = 64*1024;
+
+
+UdpRecvBatch::UdpRecvBatch()
+	: m_bufs(NULL)
+	, m_msgs(NULL)
+	, m_iovs(NULL)
+	, m_addrs(NULL)
+	, m_count(0)
+	, m_next(0) {
+}
+
+UdpRecvBatch::~UdpRecvBatch() {
+	reset();
+}
+
+bool UdpRecvBatch::init() {
+	reset();
+
+	m_bufs  = (char *)mmalloc(UDP_MAX_BATCH * s_recvBufSize, "UdpRecvBatch");
+	m_msgs  = (struct mmsghdr *)mmalloc(UDP_MAX_BATCH * sizeof(struct mmsghdr), "UdpRecvBatch");
+	m_iovs  = (struct iovec *)mmalloc(UDP_MAX_BATCH * sizeof(struct iovec), "UdpRecvBatch");
+	m_addrs = (struct sockaddr_in *)mmalloc(UDP_MAX_BATCH * sizeof(struct sockaddr_in), "UdpRecvBatch");
+	if ( ! m_bufs || ! m_msgs || ! m_iovs || ! m_addrs ) {
+		log(LOG_WARN, "udp: Failed to allocate receive batch buffers.");
+		reset();
+		return false;
+	}
+
+	m_count = 0;
+	m_next = 0;
+	return true;
+}
+
+void UdpRecvBatch::reset() {
+	if ( m_bufs  ) mfree(m_bufs, UDP_MAX_BATCH * s_recvBufSize, "UdpRecvBatch");
+	if ( m_msgs  ) mfree(m_msgs, UDP_MAX_BATCH * sizeof(struct mmsghdr), "UdpRecvBatch");
+	if ( m_iovs  ) mfree(m_iovs, UDP_MAX_BATCH * sizeof(struct iovec), "UdpRecvBatch");
+	if ( m_addrs ) mfree(m_addrs, UDP_MAX_BATCH * sizeof(struct sockaddr_in), "UdpRecvBatch");
+	m_bufs = NULL;
+	m_msgs = NULL;
+	m_iovs = NULL;
+	m_addrs = NULL;
+	m_count = 0;
+	m_next = 0;
+}
+
+int32_t UdpRecvBatch::fill(int sock, int32_t maxBatch) {
+	m_count = 0;
+	m_next = 0;
+
+	if ( maxBatch > UDP_MAX_BATCH ) maxBatch = UDP_MAX_BATCH;
+	if ( maxBatch < 1 ) maxBatch = 1;
+
+	// the kernel overwrites msg_namelen and msg_len
+	for ( int32_t i = 0 ; i < maxBatch ; i++ ) {
+		m_iovs[i].iov_base = m_bufs + i * s_recvBufSize;
+		m_iovs[i].iov_len  = s_recvBufSize;
+		memset(&m_msgs[i], 0, sizeof(m_msgs[i]));
+		m_msgs[i].msg_hdr.msg_name    = &m_addrs[i];
+		m_msgs[i].msg_hdr.msg_namelen = sizeof(m_addrs[i]);
+		m_msgs[i].msg_hdr.msg_iov     = &m_iovs[i];
+		m_msgs[i].msg_hdr.msg_iovlen  = 1;
+	}
+
+	int rc = recvmmsg(sock, m_msgs, maxBatch, MSG_DONTWAIT, NULL);
+	if ( rc < 0 ) {
+		if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+			return 0;
+		}
+		return -1;
+	}
+
+	m_count = rc;
+	return rc;
+}
+
+bool UdpRecvBatch::getNext(const char **dgram, int32_t *dgramSize, struct sockaddr_in *from) {
+	if ( m_next >= m_count ) {
+		return false;
+	}
+
+	*dgram     = (const char *)m_iovs[m_next].iov_base;
+	*dgramSize = m_msgs[m_next].msg_len;
+	*from      = m_addrs[m_next];
+	m_next++;
+	return true;
+}
+
+
+UdpSendBatch::UdpSendBatch()
+	: m_entries(NULL)
+	, m_msgs(NULL)
+	, m_iovs(NULL)
+	, m_addrs(NULL)
+	, m_count(0) {
+}
+
+UdpSendBatch::~UdpSendBatch() {
+	reset();
+}
+
+bool UdpSendBatch::init() {
+	reset();
+
+	m_entries = (Entry *)mmalloc(UDP_MAX_BATCH * sizeof(Entry), "UdpSendBatch");
+	m_msgs    = (struct mmsghdr *)mmalloc(UDP_MAX_BATCH * sizeof(struct mmsghdr), "UdpSendBatch");
+	// header and data of each dgram
+	m_iovs    = (struct iovec *)mmalloc(UDP_MAX_BATCH * 2 * sizeof(struct iovec), "UdpSendBatch");
+	m_addrs   = (struct sockaddr_in *)mmalloc(UDP_MAX_BATCH * sizeof(struct sockaddr_in), "UdpSendBatch");
+	if ( ! m_entries || ! m_msgs || ! m_iovs || ! m_addrs ) {
+		log(LOG_WARN, "udp: Failed to allocate send batch buffers.");
+		reset();
+		return false;
+	}
+
+	m_count = 0;
+	return true;
+}
+
+void UdpSendBatch::reset() {
+	if ( m_entries ) mfree(m_entries, UDP_MAX_BATCH * sizeof(Entry), "UdpSendBatch");
+	if ( m_msgs    ) mfree(m_msgs, UDP_MAX_BATCH * sizeof(struct mmsghdr), "UdpSendBatch");
+	if ( m_iovs    ) mfree(m_iovs, UDP_MAX_BATCH * 2 * sizeof(struct iovec), "UdpSendBatch");
+	if ( m_addrs   ) mfree(m_addrs, UDP_MAX_BATCH * sizeof(struct sockaddr_in), "UdpSendBatch");
+	m_entries = NULL;
+	m_msgs = NULL;
+	m_iovs = NULL;
+	m_addrs = NULL;
+	m_count = 0;
+}
+
+void UdpSendBatch::add(UdpSlot *slot, int32_t dgramNum, bool isAck, const struct sockaddr_in &to,
+                       const char *header, int32_t headerSize, const char *data, int32_t dataSize) {
+	// caller must flush first
+	if ( m_count >= UDP_MAX_BATCH || headerSize > s_maxHeaderSize ) {
+		gbshutdownLogicError();
+	}
+
+	Entry *e = &m_entries[m_count];
+	e->m_slot     = slot;
+	e->m_dgramNum = dgramNum;
+	e->m_isAck    = isAck;
+	memcpy(e->m_header, header, headerSize);
+
+	m_addrs[m_count] = to;
+
+	struct iovec *iov = &m_iovs[m_count * 2];
+	iov[0].iov_base = e->m_header;
+	iov[0].iov_len  = headerSize;
+	iov[1].iov_base = const_cast<char*>(data);
+	iov[1].iov_len  = dataSize;
+
+	struct mmsghdr *msg = &m_msgs[m_count];
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_hdr.msg_name    = &m_addrs[m_count];
+	msg->msg_hdr.msg_namelen = sizeof(m_addrs[m_count]);
+	msg->msg_hdr.msg_iov     = iov;
+	msg->msg_hdr.msg_iovlen  = dataSize > 0 ? 2 : 1;
+
+	m_count++;
+}
+
+bool UdpSendBatch::flush(int sock, int32_t maxBatch, UdpBatchStatistic *stats) {
+	bool blocked = false;
+
+	if ( maxBatch > UDP_MAX_BATCH ) maxBatch = UDP_MAX_BATCH;
+	if ( maxBatch < 1 ) maxBatch = 1;
+
+	int32_t pos = 0;
+	while ( pos < m_count ) {
+		int32_t n = m_count - pos;
+		if ( n > maxBatch ) n = maxBatch;
+
+		int rc = sendmmsg(sock, m_msgs + pos, n, MSG_DONTWAIT);
+		if ( rc > 0 ) {
+			stats->addSendBatch(rc);
+			pos += rc;
+			continue;
+		}
+
+		if ( rc < 0 && errno == EINTR ) {
+			continue;
+		}
+
+		// . socket buffer is full. try again when it is writable
+		// . linux gives ENOBUFS instead of EAGAIN when the interface
+		//   queue is full
+		if ( rc == 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ) {
+			stats->addSendBlocked();
+			blocked = true;
+			break;
+		}
+
+		// . an error on this dgram. pretend we sent it, we won't get an
+		//   ACK and the resend algo will deal with it
+		log(LOG_WARN, "udp: Call to sendmmsg had error (ignoring): %s.", mstrerror(errno));
+		pos++;
+	}
+
+	// give back what we could not send
+	for ( int32_t i = pos ; i < m_count ; i++ ) {
+		Entry *e = &m_entries[i];
+		if ( ! e->m_slot ) {
+			continue;
+		}
+		if ( e->m_isAck ) {
+			e->m_slot->unsendAck(e->m_dgramNum);
+		} else {
+			e->m_slot->unsendDatagram(e->m_dgramNum);
+		}
+	}
+
+	m_count = 0;
+	return ! blocked;
+}
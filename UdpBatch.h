@@ -0,0 +1,92 @@
+// . batched udp i/o for UdpServer
+// . UdpRecvBatch reads up to a batch of dgrams with one recvmmsg() and hands
+//   them out one at a time
+// . UdpSendBatch collects the dgrams and ACKs UdpSlot wants to send and sends
+//   them with one sendmmsg()
+
+#ifndef GB_UDPBATCH_H
+#define GB_UDPBATCH_H
+
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+class UdpSlot;
+class UdpBatchStatistic;
+
+// most dgrams we read or send with one syscall
+#define UDP_MAX_BATCH 64
+
+class UdpRecvBatch {
+public:
+	UdpRecvBatch();
+	~UdpRecvBatch();
+
+	// returns false and sets g_errno on error
+	bool init();
+	void reset();
+
+	// . read up to "maxBatch" dgrams
+	// . returns # of dgrams read, 0 if none were waiting, -1 on error
+	//   (errno is set)
+	int32_t fill(int sock, int32_t maxBatch);
+
+	// . returns false if all dgrams of the last fill() were handed out
+	// . the dgram is valid until the next fill()
+	bool getNext(const char **dgram, int32_t *dgramSize, struct sockaddr_in *from);
+
+	bool isEmpty() const { return m_next >= m_count; }
+
+private:
+	char *m_bufs;
+	struct mmsghdr *m_msgs;
+	struct iovec *m_iovs;
+	struct sockaddr_in *m_addrs;
+	int32_t m_count;
+	int32_t m_next;
+};
+
+class UdpSendBatch {
+public:
+	UdpSendBatch();
+	~UdpSendBatch();
+
+	// returns false and sets g_errno on error
+	bool init();
+	void reset();
+
+	// . queue a dgram or an ACK for "to"
+	// . "header" is copied, "data" is not and must not change or be freed
+	//   until flush()
+	// . if flush() can't send it "slot" is told to send it again later.
+	//   use a NULL slot for fire-and-forget ACKs (cancel ACKs)
+	void add(UdpSlot *slot, int32_t dgramNum, bool isAck, const struct sockaddr_in &to,
+	         const char *header, int32_t headerSize, const char *data, int32_t dataSize);
+
+	bool isFull() const { return m_count >= UDP_MAX_BATCH; }
+	bool isEmpty() const { return m_count == 0; }
+
+	// . send everything queued, up to "maxBatch" dgrams per sendmmsg()
+	// . returns false if the socket buffer filled up. dgrams we could not
+	//   send are given back to their slots
+	bool flush(int sock, int32_t maxBatch, UdpBatchStatistic *stats);
+
+private:
+	// max dgram header size, see UdpSlot::sendDatagramOrAck()
+	static const int32_t s_maxHeaderSize = 32;
+
+	struct Entry {
+		UdpSlot *m_slot;
+		int32_t m_dgramNum;
+		bool m_isAck;
+		char m_header[s_maxHeaderSize];
+	};
+
+	Entry *m_entries;
+	struct mmsghdr *m_msgs;
+	struct iovec *m_iovs;
+	struct sockaddr_in *m_addrs;
+	int32_t m_count;
+};
+
+#endif // GB_UDPBATCH_H
@@ -0,0 +1,128 @@
+#include "gb-include.h"
+
+#include "UdpCongestion.h"
+
+
+void UdpCongestion::reset() {
+	m_srtt = 0;
+	m_rttVar = 0;
+	m_cwnd = 0;
+	m_ssthresh = 0;
+	m_lastDecreaseTime = 0;
+	m_numRttSamples = 0;
+	m_numWindowDecreases = 0;
+}
+
+void UdpCongestion::resetStats() {
+	m_numRttSamples = hasRttSample() ? 1 : 0;
+	m_numWindowDecreases = 0;
+}
+
+void UdpCongestion::addRttSample(int32_t rttUs) {
+	if ( rttUs < 0 ) {
+		return;
+	}
+
+	// first sample sets the deviation to half of it (RFC 6298)
+	if ( ! hasRttSample() ) {
+		m_srtt.store(rttUs, std::memory_order_relaxed);
+		m_rttVar.store(rttUs / 2, std::memory_order_relaxed);
+		m_numRttSamples.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// rttvar = 3/4 rttvar + 1/4 |srtt - rtt|, srtt = 7/8 srtt + 1/8 rtt
+	int32_t srtt = getSrtt();
+	int32_t rttVar = getRttVar();
+	int32_t delta = srtt - rttUs;
+	if ( delta < 0 ) delta = -delta;
+	rttVar = rttVar - rttVar / 4 + delta / 4;
+	srtt = srtt - srtt / 8 + rttUs / 8;
+
+	m_srtt.store(srtt, std::memory_order_relaxed);
+	m_rttVar.store(rttVar, std::memory_order_relaxed);
+	m_numRttSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+int32_t UdpCongestion::getResendTimeout(int32_t minMs, int32_t maxMs) const {
+	if ( ! hasRttSample() ) {
+		return -1;
+	}
+
+	int64_t rtoUs = (int64_t)getSrtt() + 4 * (int64_t)getRttVar();
+	// round up
+	int64_t rto = ( rtoUs + 999 ) / 1000;
+	if ( rto < minMs ) rto = minMs;
+	if ( rto > maxMs ) rto = maxMs;
+	return (int32_t)rto;
+}
+
+int32_t UdpCongestion::getScaledWindow() const {
+	int32_t cwnd = m_cwnd.load(std::memory_order_relaxed);
+	if ( cwnd <= 0 ) {
+		return UDP_CWND_INITIAL * s_cwndScale;
+	}
+	return cwnd;
+}
+
+int32_t UdpCongestion::getScaledSsthresh() const {
+	int32_t ssthresh = m_ssthresh.load(std::memory_order_relaxed);
+	if ( ssthresh <= 0 ) {
+		return UDP_CWND_MAX * s_cwndScale;
+	}
+	return ssthresh;
+}
+
+int32_t UdpCongestion::getWindow() const {
+	return getScaledWindow() / s_cwndScale;
+}
+
+int32_t UdpCongestion::getPacingInterval() const {
+	if ( ! hasRttSample() ) {
+		return 0;
+	}
+	return getSrtt() / getWindow() / 1000;
+}
+
+void UdpCongestion::onAck() {
+	int32_t cwnd = getScaledWindow();
+	if ( cwnd >= UDP_CWND_MAX * s_cwndScale ) {
+		return;
+	}
+
+	// slow start grows by a dgram per ack, congestion avoidance by a dgram
+	// per window
+	if ( cwnd < getScaledSsthresh() ) {
+		cwnd += s_cwndScale;
+	} else {
+		cwnd += s_cwndScale * s_cwndScale / cwnd;
+	}
+	if ( cwnd > UDP_CWND_MAX * s_cwndScale ) {
+		cwnd = UDP_CWND_MAX * s_cwndScale;
+	}
+
+	m_cwnd.store(cwnd, std::memory_order_relaxed);
+}
+
+void UdpCongestion::onLoss(int64_t nowMs) {
+	// one decrease per round trip (at least a ms)
+	int64_t lastDecrease = m_lastDecreaseTime.load(std::memory_order_relaxed);
+	int64_t rtt = getSrtt() / 1000;
+	if ( rtt < 1 ) rtt = 1;
+	if ( lastDecrease && nowMs >= lastDecrease && nowMs - lastDecrease < rtt ) {
+		return;
+	}
+	if ( ! m_lastDecreaseTime.compare_exchange_strong(lastDecrease, nowMs, std::memory_order_relaxed) ) {
+		// another slot just did it
+		return;
+	}
+
+	int32_t cwnd = getScaledWindow() / 2;
+	if ( cwnd < UDP_CWND_MIN * s_cwndScale ) {
+		cwnd = UDP_CWND_MIN * s_cwndScale;
+	}
+
+	m_ssthresh.store(cwnd, std::memory_order_relaxed);
+	m_cwnd.store(cwnd, std::memory_order_relaxed);
+	m_numWindowDecreases.fetch_add(1, std::memory_order_relaxed);
+}
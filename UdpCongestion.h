@@ -0,0 +1,75 @@
+// . per host congestion state for UdpSlot sends, kept in Host
+// . smoothed round trip time and deviation (Jacobson/Karels) for the resend
+//   timeout, and an AIMD congestion window (in dgrams) that limits how many
+//   unacked dgrams a slot may have outstanding to the host
+// . all slots sending to a host share it, so when many hosts fan in to one
+//   coordinator each of them backs off on its own
+// . Host is memset() to zero, so all zeroes must be a valid initial state
+// . updates are not serialized. two slots updating at once may lose a sample
+//   which is fine for an estimate
+
+#ifndef GB_UDPCONGESTION_H
+#define GB_UDPCONGESTION_H
+
+#include <inttypes.h>
+#include <atomic>
+
+// window the slots start with, the old fixed ACK_WINDOW_SIZE
+#define UDP_CWND_INITIAL 4
+#define UDP_CWND_MIN     2
+#define UDP_CWND_MAX     64
+
+class UdpCongestion {
+public:
+	void reset();
+	// for the reset link on PageHosts, keeps the estimates
+	void resetStats();
+
+	// . round trip time of a dgram that was not resent, in microseconds
+	void addRttSample(int32_t rttUs);
+
+	bool hasRttSample() const { return m_numRttSamples.load(std::memory_order_relaxed) > 0; }
+	int32_t getSrtt() const { return m_srtt.load(std::memory_order_relaxed); }
+	int32_t getRttVar() const { return m_rttVar.load(std::memory_order_relaxed); }
+
+	// . srtt + 4*rttvar in milliseconds, clamped to [minMs,maxMs]
+	// . returns -1 if we have no samples yet
+	int32_t getResendTimeout(int32_t minMs, int32_t maxMs) const;
+
+	// # of unacked dgrams a slot may have outstanding
+	int32_t getWindow() const;
+
+	// . min milliseconds between dgrams of a slot while it has dgrams in
+	//   flight, so a window is spread over a round trip instead of burst
+	// . 0 if we have no samples or the rtt is less than a ms per dgram
+	int32_t getPacingInterval() const;
+
+	// a new dgram was acked. slow start, then additive increase
+	void onAck();
+
+	// . dgrams were lost (resend timeout or a gap in the acks)
+	// . halves the window, but only once per round trip since all the
+	//   slots to the host see the same loss
+	void onLoss(int64_t nowMs);
+
+	int64_t getNumRttSamples() const { return m_numRttSamples.load(std::memory_order_relaxed); }
+	int32_t getNumWindowDecreases() const { return m_numWindowDecreases.load(std::memory_order_relaxed); }
+
+private:
+	// window is kept in 1/256 dgrams so congestion avoidance can grow it by
+	// 1/cwnd per ack
+	static const int32_t s_cwndScale = 256;
+
+	int32_t getScaledWindow() const;
+	int32_t getScaledSsthresh() const;
+
+	std::atomic<int32_t> m_srtt;     // microseconds
+	std::atomic<int32_t> m_rttVar;   // microseconds
+	std::atomic<int32_t> m_cwnd;     // scaled, 0 means UDP_CWND_INITIAL
+	std::atomic<int32_t> m_ssthresh; // scaled, 0 means UDP_CWND_MAX
+	std::atomic<int64_t> m_lastDecreaseTime;
+	std::atomic<int64_t> m_numRttSamples;
+	std::atomic<int32_t> m_numWindowDecreases;
+};
+
+#endif // GB_UDPCONGESTION_H
@@ -21,6 +21,12 @@
 #include "ip.h"
 #include "Conf.h"
 #include <assert.h>
+#include <sys/eventfd.h>
+#include <linux/filter.h>
+#include <poll.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
 
 // . any changes made to the slots should only be done without risk of
 //   interruption because makeCallbacks() reads from the slots to call
@@ -44,16 +50,119 @@ static void defaultCallbackWrapper(void * /*state*/, UdpSlot * /*slot*/) {
 }
 
 
+// a receive thread and the socket it reads, see startReceiveThreads()
+class UdpReceiveThread {
+public:
+	UdpReceiveThread()
+		: m_server(NULL)
+		, m_sock(-1)
+		, m_thread()
+		, m_threadStarted(false)
+		, m_recvBatch()
+		, m_readySlots()
+		, m_wakeMainLoop(false)
+		, m_touchedShards(0) {
+	}
+
+	UdpServer *m_server;
+	int m_sock;
+	pthread_t m_thread;
+	bool m_threadStarted;
+	UdpRecvBatch m_recvBatch;
+
+	// fully read requests whose handler is thread-safe. we call them
+	// after sending the ACKs
+	std::vector<UdpSlot*> m_readySlots;
+
+	// we added slots to the callback list, main loop needs to call them
+	bool m_wakeMainLoop;
+
+	// bit i is set if we queued ACKs in the send batch of shard i
+	uint64_t m_touchedShards;
+};
+
+
+// . the slots of the transactions whose transId % m_numShards is the same
+// . everything in here is protected by m_mtx
+class UdpShard {
+public:
+	UdpShard()
+		: m_mtx()
+		, m_ptrs(NULL)
+		, m_numBuckets(0)
+		, m_bucketMask(0)
+		, m_bufSize(0)
+		, m_activeListHead(NULL)
+		, m_activeListTail(NULL)
+		, m_callbackListHead(NULL)
+		, m_callbackListTail(NULL)
+		, m_sendBatch() {
+	}
+
+	~UdpShard() {
+		if ( m_ptrs ) mfree ( m_ptrs , m_bufSize , "UdpServer" );
+	}
+
+	GbMutex m_mtx;
+
+	// . hash table for converting keys to slots
+	// . if m_ptrs[i] is NULL, ith bucket is empty
+	UdpSlot **m_ptrs;
+	int32_t m_numBuckets;
+	uint32_t m_bucketMask;
+	int32_t m_bufSize;
+
+	// linked list of slots in use
+	UdpSlot *m_activeListHead;
+	UdpSlot *m_activeListTail;
+
+	// linked list of callback candidates
+	UdpSlot *m_callbackListHead;
+	UdpSlot *m_callbackListTail;
+
+	// dgrams/ACKs waiting for one sendmmsg()
+	UdpSendBatch m_sendBatch;
+};
+
+
+// set in the receive threads, see UdpServer::isReceiveThread()
+static __thread bool s_isReceiveThread = false;
+
+bool UdpServer::isReceiveThread() {
+	return s_isReceiveThread;
+}
+
+
+UdpShard *UdpServer::getShard(int32_t transId) const {
+	return &m_shards[(uint32_t)transId % (uint32_t)m_numShards];
+}
+
+UdpShard *UdpServer::getShard(const UdpSlot *slot) const {
+	return getShard(slot->getTransId());
+}
+
+GbMutex& UdpServer::getLock(int32_t transId) {
+	return getShard(transId)->m_mtx;
+}
+
+
 // free send/readBufs
 void UdpServer::reset() {
+	stopReceiveThreads();
+
+	if ( m_shards ) {
+		mdelete(m_shards, sizeof(UdpShard) * m_numShards, "UdpShard");
+		delete[] m_shards;
+		m_shards = NULL;
+		m_numShards = 0;
+	}
 
 	// clear our slots
 	if ( ! m_slots ) return;
 	log(LOG_DEBUG,"db: resetting udp server");
 	mfree ( m_slots , m_maxSlots * sizeof(UdpSlot) , "UdpServer" );
 	m_slots = NULL;
-	if ( m_buf ) mfree ( m_buf , m_bufSize , "UdpServer");
-	m_buf = NULL;
+	m_recvBatch.reset();
 }
 
 
@@ -61,12 +170,18 @@ UdpServer::UdpServer ( ) {
 	m_sock = -1;
 	m_slots = NULL;
 	m_maxSlots = 0;
-	m_buf = NULL;
+	m_shards = NULL;
+	m_numShards = 0;
 	m_writeRegistered = false;
+	m_receiveThreads = NULL;
+	m_numReceiveThreads = 0;
+	m_stopReceiveThreads = false;
+	m_callbackFd = -1;
 
 	// Coverity
 	m_nextTransId = 0;
 	memset(m_handlers, 0, sizeof(m_handlers));
+	memset(m_threadSafeHandlers, 0, sizeof(m_threadSafeHandlers));
 	m_needToSend = false;
 	m_port = 0;
 	m_proto = NULL;
@@ -79,15 +194,7 @@ UdpServer::UdpServer ( ) {
 	m_msg20sInWaiting = 0;
 	m_msg0csInWaiting = 0;
 	m_msg0sInWaiting = 0;
-	m_ptrs = NULL;
-	m_numBuckets = 0;
-	m_bucketMask = 0;
-	m_bufSize = 0;
 	m_availableListHead = NULL;
-	m_activeListHead = NULL;
-	m_activeListTail = NULL;
-	m_callbackListHead = NULL;
-	m_callbackListTail = NULL;
 	m_numUsedSlots = 0;
 	m_numUsedSlotsIncoming = 0;
 	m_isDns = false;
@@ -181,30 +288,56 @@ bool UdpServer::init ( uint16_t port, UdpProtocol *proto,
 	}
 	m_slots[m_maxSlots - 1].m_availableListNext = NULL;
 
-	// the linked list of slots in use
-	m_activeListHead = NULL;
-	m_activeListTail = NULL;
-
-	// linked list of callback candidates
-	m_callbackListHead = NULL;
-
-	// . set up hash table that converts key (ip/port/transId) to a slot
-	// . m_numBuckets must be power of 2
-	m_numBuckets = getHighestLitBitValue ( m_maxSlots * 6 );
-	m_bucketMask = m_numBuckets - 1;
-	// alloc space for hash table
-	m_bufSize = m_numBuckets * sizeof(UdpSlot *);
-	m_buf     = (char *)mmalloc ( m_bufSize , "UdpServer" );
-	if ( ! m_buf ) {
-		log("udp: Failed to allocate %" PRId32" bytes for table.",m_bufSize);
+	// . read with receive threads instead of the main loop? the dns
+	//   client port doesn't get enough traffic to bother
+	// . one shard per receive thread so the threads don't fight over locks
+	int32_t numReceiveThreads = m_isDns ? 0 : g_conf.m_udpReceiveThreads;
+	if ( numReceiveThreads > 64 ) numReceiveThreads = 64;
+	int32_t numShards = numReceiveThreads > 0 ? numReceiveThreads : 1;
+
+	try {
+		m_shards = new UdpShard[numShards];
+	} catch ( std::bad_alloc & ) {
+		g_errno = ENOMEM;
+		log(LOG_WARN, "udp: Failed to allocate %" PRId32" shards.", numShards);
 		return false;
 	}
+	mnew(m_shards, sizeof(UdpShard) * numShards, "UdpShard");
+	m_numShards = numShards;
+
+	// . set up hash tables that convert key (ip/port/transId) to a slot
+	// . m_numBuckets must be power of 2. any shard may end up with more
+	//   than its share of the slots, so don't go below 2 * m_maxSlots
+	int32_t numBuckets = std::max(getHighestLitBitValue(m_maxSlots * 6 / m_numShards),
+	                              getHighestLitBitValue(m_maxSlots) * 2);
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		UdpShard *shard = &m_shards[i];
+		shard->m_numBuckets = numBuckets;
+		shard->m_bucketMask = numBuckets - 1;
+		// alloc space for hash table
+		shard->m_bufSize = numBuckets * sizeof(UdpSlot *);
+		shard->m_ptrs    = (UdpSlot **)mmalloc ( shard->m_bufSize , "UdpServer" );
+		if ( ! shard->m_ptrs ) {
+			log("udp: Failed to allocate %" PRId32" bytes for table.",shard->m_bufSize);
+			return false;
+		}
 
-	m_ptrs = (UdpSlot **)m_buf;
+		// clear
+		memset ( shard->m_ptrs , 0 , sizeof(UdpSlot *)*numBuckets );
 
-	// clear
-	memset ( m_ptrs , 0 , sizeof(UdpSlot *)*m_numBuckets );
-	log(LOG_DEBUG,"udp: Allocated %" PRId32" bytes for table.",m_bufSize);
+		// buffer for sendmmsg()
+		if ( ! shard->m_sendBatch.init() ) {
+			return false;
+		}
+	}
+	log(LOG_DEBUG,"udp: Allocated %" PRId32" bytes for %" PRId32" tables.",
+	    numBuckets*(int32_t)sizeof(UdpSlot *),m_numShards);
+
+	// buffer for recvmmsg()
+	if ( ! m_recvBatch.init() ) {
+		return false;
+	}
+	m_batchStats.reset();
 
 	m_numUsedSlots   = 0;
 	m_numUsedSlotsIncoming   = 0;
@@ -215,6 +348,7 @@ bool UdpServer::init ( uint16_t port, UdpProtocol *proto,
 	m_nextTransId = g_hostdb.getMyHostId() << 19;
 	// clear handlers
 	memset ( m_handlers, 0 , sizeof(void(* )(UdpSlot *slot,int32_t)) * 128);
+	memset ( m_threadSafeHandlers, 0, sizeof(m_threadSafeHandlers) );
 
 	// save the port in case we need it later
 	m_port = port;
@@ -259,13 +393,21 @@ bool UdpServer::init ( uint16_t port, UdpProtocol *proto,
 		return false;
 	}
 
+	if ( numReceiveThreads > 0 &&
+	     setsockopt(m_sock, SOL_SOCKET, SO_REUSEPORT, &options, sizeof(options)) < 0 ) {
+		log( LOG_WARN, "udp: Call to setsockopt(SO_REUSEPORT) failed: %s. Not using receive threads.",
+		     mstrerror(errno));
+		numReceiveThreads = 0;
+	}
+
 	// the lower the RT signal we use, the higher our priority
 
 	// . before we start getting signals on this socket let's make sure
 	//   we have a handler registered with the Loop class
 	// . this makes m_sock non-blocking, too
 	// . use the original niceness for this
-	if (!g_loop.registerReadCallback(m_sock, this, readPollWrapper, "UdpServer::readPollWrapper", 0)) {
+	if ( numReceiveThreads == 0 &&
+	     !g_loop.registerReadCallback(m_sock, this, readPollWrapper, "UdpServer::readPollWrapper", 0)) {
 		return false;
 	}
 
@@ -299,6 +441,11 @@ bool UdpServer::init ( uint16_t port, UdpProtocol *proto,
 		return false;
 	}
 
+	if ( numReceiveThreads > 0 && ! startReceiveThreads(numReceiveThreads, name, readBufSize) ) {
+		stopReceiveThreads();
+		return false;
+	}
+
 	// init stats
 	m_eth0BytesIn    = 0LL;
 	m_eth0BytesOut   = 0LL;
@@ -394,17 +541,18 @@ bool UdpServer::sendRequest(char *msg,
 		ip2 = h->m_ip;
 	}
 
-	ScopedLock sl(m_mtx);
-
 	// get a new transId
-	int32_t transId = getTransId_unlocked();
+	int32_t transId = getTransId();
+
+	UdpShard *shard = getShard(transId);
+	ScopedLock sl(shard->m_mtx);
 
 	// make a key for this new slot
 	key96_t key = m_proto->makeKey (ip2,port,transId,true/*weInitiated?*/);
 
 	// . create a new slot to control the transmission of this request
 	// . should set g_errno on failure
-	UdpSlot *slot = getEmptyUdpSlot_unlocked(key, false);
+	UdpSlot *slot = getEmptyUdpSlot_unlocked(shard, key, false);
 	if ( ! slot ) {
 		log( LOG_WARN, "udp: All %" PRId32" slots are in use.",m_maxSlots);
 		static time_t lastLogTime = 0;
@@ -444,7 +592,7 @@ bool UdpServer::sendRequest(char *msg,
 
 	// set up for a send
 	if (!slot->sendSetup(msg, msgSize, msg, msgSize, msgType, now, state, callback, niceness, extraInfo)) {
-		freeUdpSlot_unlocked(slot);
+		freeUdpSlot_unlocked(shard, slot);
 		log( LOG_WARN, "udp: Failed to initialize udp socket for sending req: %s",mstrerror(g_errno));
 		return false;
 	}
@@ -457,8 +605,8 @@ bool UdpServer::sendRequest(char *msg,
 	slot->m_maxResends = maxResends;
 
 	// keep sending dgrams until we have no more or hit ACK_WINDOW limit
-	if ( !doSending_unlocked(slot, true /*allow resends?*/, now) ) {
-		freeUdpSlot_unlocked(slot);
+	if ( !doSending_unlocked(shard, slot, true /*allow resends?*/, now) ) {
+		freeUdpSlot_unlocked(shard, slot);
 		log(LOG_WARN, "udp: Failed to send dgrams for udp socket.");
 		return false;
 	}
@@ -472,13 +620,14 @@ bool UdpServer::sendRequest(char *msg,
 }
 
 void UdpServer::sendErrorReply(UdpSlot *slot, int32_t errnum) {
-	ScopedLock sl(m_mtx);
-	sendErrorReply_unlocked(slot, errnum);
+	UdpShard *shard = getShard(slot);
+	ScopedLock sl(shard->m_mtx);
+	sendErrorReply_unlocked(shard, slot, errnum);
 }
 
 // returns false and sets g_errno on error, true otherwise
-void UdpServer::sendErrorReply_unlocked(UdpSlot *slot, int32_t errnum) {
-	m_mtx.verify_is_locked();
+void UdpServer::sendErrorReply_unlocked(UdpShard *shard, UdpSlot *slot, int32_t errnum) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: sendErrorReply slot=%p errnum=%" PRId32, slot, errnum);
 
@@ -498,20 +647,21 @@ void UdpServer::sendErrorReply_unlocked(UdpSlot *slot, int32_t errnum) {
 	// set the m_localErrno in "slot" so it will set the dgrams error bit
 	slot->m_localErrno = errnum;
 
-	sendReply_unlocked(msg, 4, msg, 4, slot);
+	sendReply_unlocked(shard, msg, 4, msg, 4, slot);
 }
 
 void UdpServer::sendReply(char *msg, int32_t msgSize, char *alloc, int32_t allocSize, UdpSlot *slot, void *state,
                           void (*callback2)(void *state, UdpSlot *slot)) {
-	ScopedLock sl(m_mtx);
-	sendReply_unlocked(msg, msgSize, alloc, allocSize, slot, state, callback2);
+	UdpShard *shard = getShard(slot);
+	ScopedLock sl(shard->m_mtx);
+	sendReply_unlocked(shard, msg, msgSize, alloc, allocSize, slot, state, callback2);
 }
 
 // . destroys slot on error or completion (frees m_readBuf,m_sendBuf)
 // . use a backoff of -1 for the default
-void UdpServer::sendReply_unlocked(char *msg, int32_t msgSize, char *alloc, int32_t allocSize, UdpSlot *slot, void *state,
-                                   void (*callback2)(void *state, UdpSlot *slot)) {
-	m_mtx.verify_is_locked();
+void UdpServer::sendReply_unlocked(UdpShard *shard, char *msg, int32_t msgSize, char *alloc, int32_t allocSize,
+                                   UdpSlot *slot, void *state, void (*callback2)(void *state, UdpSlot *slot)) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: sendReply slot=%p", slot);
 
@@ -565,7 +715,7 @@ void UdpServer::sendReply_unlocked(char *msg, int32_t msgSize, char *alloc, int3
 		mfree ( alloc , allocSize , "UdpServer");
 		// was EBADENGINEER
 		log(LOG_ERROR,"%s:%s:%d: call sendErrorReply.", __FILE__, __func__, __LINE__);
-		sendErrorReply_unlocked(slot, g_errno);
+		sendErrorReply_unlocked(shard, slot, g_errno);
 		return ;
 	}
 	// set the callback2 , it might not be NULL if we're recording stats
@@ -578,7 +728,7 @@ void UdpServer::sendReply_unlocked(char *msg, int32_t msgSize, char *alloc, int3
 	logDebug(g_conf.m_logDebugUdp, "udp: Sending reply tid=%" PRId32" msgType=0x%02x (niceness=%" PRId32").",
 	         slot->getTransId(), (int)slot->getMsgType(), (int32_t)slot->getNiceness());
 	// keep sending dgrams until we have no more or hit ACK_WINDOW limit
-	if ( !doSending_unlocked(slot, true /*allow resends?*/, now) ) {
+	if ( !doSending_unlocked(shard, slot, true /*allow resends?*/, now) ) {
 		// . on error deal with that
 		// . errors from doSending() are from 
 		//   UdpSlot::sendDatagramOrAck()
@@ -586,7 +736,7 @@ void UdpServer::sendReply_unlocked(char *msg, int32_t msgSize, char *alloc, int3
 		// . TODO: we may have to destroy this slot ourselves now...
 		log(LOG_WARN, "udp: Got error sending dgrams.");
 		// destroy it i guess
-		destroySlot_unlocked(slot);
+		destroySlot_unlocked(shard, slot);
 	}
 }
 
@@ -606,8 +756,8 @@ void UdpServer::sendPollWrapper(int fd, void *state) {
 // . that means we can be calling doSending() on a slot made in
 //   sendRequest() and then be interrupted by sendPollWrapper()
 // . Fortunately, we have a lock around it in sendRequest()!
-bool UdpServer::doSending_unlocked(UdpSlot *slot, bool allowResends, int64_t now) {
-	m_mtx.verify_is_locked();
+bool UdpServer::doSending_unlocked(UdpShard *shard, UdpSlot *slot, bool allowResends, int64_t now, bool flushBatch) {
+	shard->m_mtx.verify_is_locked();
 
 	// if UdpServer::cancel() was called and this slot's callback was
 	// called, make sure to hault sending if we are in a quickpoll
@@ -622,42 +772,81 @@ bool UdpServer::doSending_unlocked(UdpSlot *slot, bool allowResends, int64_t now
 			//enough or all sent
 			if(slot->m_callback && slot->m_host)
 				slot->m_host->updateLastRequestSendTimestamp(getCurrentTimeNanoseconds());
+			break;
+		}
+
+		// make room. if the socket blocked the dgrams we could not
+		// send are unsent again and sendPoll() will pick them up
+		if ( shard->m_sendBatch.isFull() && ! flushSendBatch_unlocked(shard) ) {
 			return true;
 		}
 
-		// . returns -2 if nothing to send, -1 on error, 0 if blocked,
-		//   1 if sent something
-		// . it will send a dgram or an ACK
-		int32_t status = slot->sendDatagramOrAck ( m_sock , allowResends , now );
+		// . returns -2 if nothing to send, -1 on error, 1 if queued
+		//   something in m_sendBatch
+		// . it will queue a dgram or an ACK
+		int32_t status = slot->sendDatagramOrAck ( &shard->m_sendBatch , allowResends , now );
 		// return 1 if nothing to send
 		if ( status == -2 ) {
 			//all sent
 			if(slot->m_callback && slot->m_host)
 				slot->m_host->updateLastRequestSendTimestamp(getCurrentTimeNanoseconds());
-			return true;
+			break;
 		}
 		// return -1 on error
 		if ( status == -1 ) {
 			log("udp: Had error sending dgram: %s.",mstrerror(g_errno));
-			return false;
-		}
-		// return 0 if we blocked on this dgram
-		if ( status ==  0 ) {
-			// but Loop should call us again asap because I don't think
-			// we'll get a ready to write signal... don't count on it
-			m_needToSend = true;
-			// ok, now it should
-			if ( ! m_writeRegistered ) {
-				if (!g_loop.registerWriteCallback(m_sock, this, sendPollWrapper,
-				                                  "UdpServer::sendPollWrapper", 0)) {
-					logError("registerWriteCallback failed");
-					return false;
-				}
-				m_writeRegistered = true;
+			if ( flushBatch ) {
+				flushSendBatch_unlocked(shard);
 			}
-			return true;
+			return false;
 		}
 	}
+
+	if ( flushBatch ) {
+		flushSendBatch_unlocked(shard);
+	}
+	return true;
+}
+
+bool UdpServer::flushSendBatch_unlocked(UdpShard *shard) {
+	shard->m_mtx.verify_is_locked();
+
+	if ( shard->m_sendBatch.isEmpty() ) {
+		return true;
+	}
+
+	if ( shard->m_sendBatch.flush(m_sock, g_conf.m_udpBatchSize, &m_batchStats) ) {
+		return true;
+	}
+
+	// but Loop should call us again asap because I don't think
+	// we'll get a ready to write signal... don't count on it
+	m_needToSend = true;
+	// ok, now it should
+	registerWriteCallback();
+	return false;
+}
+
+void UdpServer::flushSendBatches() {
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		ScopedLock sl(m_shards[i].m_mtx);
+		flushSendBatch_unlocked(&m_shards[i]);
+	}
+}
+
+bool UdpServer::registerWriteCallback() {
+	ScopedLock sl(m_writeMtx);
+
+	if ( m_writeRegistered ) {
+		return true;
+	}
+
+	if (!g_loop.registerWriteCallback(m_sock, this, sendPollWrapper, "UdpServer::sendPollWrapper", 0)) {
+		logError("registerWriteCallback failed");
+		return false;
+	}
+	m_writeRegistered = true;
+	return true;
 }
 
 // . should only be called from process() since this is not re-entrant
@@ -670,8 +859,6 @@ bool UdpServer::doSending_unlocked(UdpSlot *slot, bool allowResends, int64_t now
 // . MDW: THIS IS NOW called by Loop.cpp when our udp socket is ready for
 //   sending on, and a previous sendto() would have blocked.
 bool UdpServer::sendPoll(bool allowResends, int64_t now) {
-	ScopedLock sl(m_mtx);
-
 	// just so caller knows we don't need to send again yet
 	m_needToSend = false;
 
@@ -680,37 +867,50 @@ bool UdpServer::sendPoll(bool allowResends, int64_t now) {
 	// assume we didn't process anything
 	bool something = false;
 
-	for(;;) {
-		// . don't do any sending until we leave the wait state
-		// or if is shutting down
-		if ( m_isShuttingDown )
-			return false;
-		// . get the next slot to send on
-		// . it sets "isResend" to true if it's a resend
-		// . this sets g_errno to ETIMEOUT if the slot it returns has timed out
-		// . in that case we'll destroy that slot
-		UdpSlot *slot = getBestSlotToSend_unlocked(now);
-		// . slot is NULL if no more slots need sending
-		// . return true if we processed something
-		if ( ! slot ) {
-			// if nobody needs to send now unregister write callback
-			// so select() loop in Loop.cpp does not keep freaking out
-			if ( ! m_needToSend && m_writeRegistered ) {
-				g_loop.unregisterWriteCallback(m_sock, this, sendPollWrapper);
-				m_writeRegistered = false;
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		UdpShard *shard = &m_shards[i];
+		ScopedLock sl(shard->m_mtx);
+
+		for(;;) {
+			// . don't do any sending until we leave the wait state
+			// or if is shutting down
+			if ( m_isShuttingDown )
+				return false;
+			// . get the next slot to send on
+			// . it sets "isResend" to true if it's a resend
+			// . this sets g_errno to ETIMEOUT if the slot it returns has timed out
+			// . in that case we'll destroy that slot
+			UdpSlot *slot = getBestSlotToSend_unlocked(shard, now);
+			// . slot is NULL if no more slots need sending in this shard
+			if ( ! slot ) {
+				break;
 			}
-			return something;
+			// otherwise, we can send something
+			something = true;
+
+			// . send all we can from this slot
+			// . when shutting down during a dump we can get EBADF during a send
+			//   so do not loop forever
+			// . this returns false on error, i haven't seen it happen though
+			if ( !doSending_unlocked(shard, slot, allowResends, now) )
+				return true;
+
+			// socket is full, wait for sendPollWrapper()
+			if ( m_needToSend )
+				return true;
 		}
-		// otherwise, we can send something
-		something = true;
+	}
 
-		// . send all we can from this slot
-		// . when shutting down during a dump we can get EBADF during a send
-		//   so do not loop forever
-		// . this returns false on error, i haven't seen it happen though
-		if ( !doSending_unlocked(slot, allowResends, now) )
-			return true;
+	// if nobody needs to send now unregister write callback
+	// so select() loop in Loop.cpp does not keep freaking out
+	ScopedLock sl(m_writeMtx);
+	if ( ! m_needToSend && m_writeRegistered ) {
+		g_loop.unregisterWriteCallback(m_sock, this, sendPollWrapper);
+		m_writeRegistered = false;
 	}
+
+	// return true if we processed something
+	return something;
 }
 
 // . returns NULL if no slots need sending
@@ -721,8 +921,8 @@ bool UdpServer::sendPoll(bool allowResends, int64_t now) {
 // . let's send the shortest first, but weight by how long it's been waiting!
 // . f(x) = a*(now - startTime) + b/msgSize
 // . verified that this is not interruptible
-UdpSlot *UdpServer::getBestSlotToSend_unlocked(int64_t now) {
-	m_mtx.verify_is_locked();
+UdpSlot *UdpServer::getBestSlotToSend_unlocked(UdpShard *shard, int64_t now) {
+	shard->m_mtx.verify_is_locked();
 
 	// . we send msgs that are mostly "caught up" with their acks first
 	// . the slot with the lowest score gets sent
@@ -736,7 +936,7 @@ UdpSlot *UdpServer::getBestSlotToSend_unlocked(int64_t now) {
 	//   are considered faster so we send to them first
 	// . we set the hi bit in the score for non-resends so dgrams that 
 	//   are being resent take precedence
-	for ( UdpSlot *slot = m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
+	for ( UdpSlot *slot = shard->m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
 		// . we don't allow time out on slots waiting for us to send
 		//   stuff, because we'd just end up calling the handler
 		//   too many times. we could invent a "stop" cmd or something.
@@ -763,16 +963,37 @@ UdpSlot *UdpServer::getBestSlotToSend_unlocked(int64_t now) {
 }
 
 // . must give level of niceness for continuing the transaction at that lvl
-bool UdpServer::registerHandler( msg_type_t msgType, void (* handler)(UdpSlot *, int32_t niceness) ) {
+bool UdpServer::registerHandler( msg_type_t msgType, void (* handler)(UdpSlot *, int32_t niceness), bool threadSafe ) {
 	if (m_handlers[msgType]) {
 		log(LOG_LOGIC, "udp: msgType %02x already in use.", (int)msgType);
 		return false;
 	}
 
 	m_handlers[msgType] = handler;
+	m_threadSafeHandlers[msgType] = threadSafe;
 	return true;
 }
 
+// . queue "slot" for makeCallbacks() again, this time to call "handler"
+// . the slot can be read by a receive thread and handled by the main loop
+//   the moment we unlock, so we don't touch it after that
+void UdpServer::callHandlerFromMainLoop(UdpSlot *slot, void (*handler)(UdpSlot *, int32_t)) {
+	{
+		UdpShard *shard = getShard(slot);
+		ScopedLock sl(shard->m_mtx);
+		slot->m_mainLoopHandler = handler;
+		slot->m_calledHandler = false;
+		addToCallbackLinkedList_unlocked(shard, slot);
+	}
+
+	if ( m_callbackFd >= 0 ) {
+		uint64_t one = 1;
+		if ( write(m_callbackFd, &one, sizeof(one)) != sizeof(one) ) {
+			// the counter is already non-zero, main loop will wake up
+		}
+	}
+}
+
 // . read and send as much as we can before calling any callbacks
 // . if forceCallbacks is true we call them regardless if we read/sent anything
 void UdpServer::process(int64_t now, int32_t maxNiceness) {
@@ -785,7 +1006,8 @@ void UdpServer::process(int64_t now, int32_t maxNiceness) {
 	// gettimeofdayInMilliseconds() is not async safe
 	int64_t startTimer = gettimeofdayInMilliseconds();
  bigloop:
-	bool needCallback = false;
+	// with receive threads we are only called to make callbacks
+	bool needCallback = ( m_receiveThreads != NULL );
  loop:
 	// did we read or send something?
 	bool something = false;
@@ -800,31 +1022,19 @@ void UdpServer::process(int64_t now, int32_t maxNiceness) {
 	// . *slot will be NULL on some errors (read errors or alloc errors)
 	// . *slot will be NULL if we read and processed a slotless ACK
 	// . *slot will be NULL if we read nothing (0 bytes read & 0 returned)
-	int32_t status = readSock(&slot, now);
+	// . readSock() queues the ACK for the slot, and puts it on the
+	//   callback list if there was a read error
+	int32_t status = m_receiveThreads ? 0 : readSock(&slot, now);
+	// nothing left to read, send the ACKs we queued up
+	if ( status == 0 ) {
+		flushSendBatches();
+	}
 	// if we read something
 	if ( status != 0 ) {
 		// if no slot was set, it was a slotless read so keep looping
 		if ( ! slot ) { g_errno = 0; goto readAgain; }
-		// if there was a read error let makeCallback() know about it
-		if ( status == -1 ) {
-			slot->m_errno = g_errno;
-			// prepare to call the callback by adding it to this
-			// special linked list
-			if ( g_errno ) {
-				ScopedLock sl(m_mtx);
-				addToCallbackLinkedList_unlocked(slot);
-			}
-			// sanity
-			if ( ! g_errno )
-				log("udp: missing g_errno from read error");
-		}
 		// we read something
 		something = true;
-		{
-			ScopedLock sl(m_mtx);
-			// try sending an ACK on the slot we read something from
-			doSending_unlocked(slot, false, now);
-		}
 	}
 	// if we read something, try for more
 	if ( something ) {
@@ -880,36 +1090,271 @@ void UdpServer::readPollWrapper(int fd, void *state) {
 }
 
 
-// . returns -1 on error, 0 if blocked, 1 if completed reading dgram
-int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
-	ScopedLock sl(m_mtx);
+// called by Loop when a receive thread added slots to the callback list
+void UdpServer::callbackPollWrapper(int fd, void *state) {
+	UdpServer *that = static_cast<UdpServer*>(state);
 
-	// NULLify slot
-	*slotPtr = NULL;
-	sockaddr_in from;
-	socklen_t fromLen = sizeof ( struct sockaddr );
-	char readBuffer[64*1024];
-	int readSize = recvfrom ( m_sock,
-				  readBuffer,
-				  sizeof(readBuffer),
-				  0,                        //flags
-				  (sockaddr *)(void*)&from,
-				  &fromLen);
-
-	logDebug(g_conf.m_logDebugLoop, "loop: readsock: readSize=%i m_sock/fd=%i", readSize,m_sock);
-
-	// cancel silly g_errnos and return 0 since we blocked
-	if ( readSize < 0 ) {
+	uint64_t value;
+	if ( read(fd, &value, sizeof(value)) != sizeof(value) ) {
+		return;
+	}
+
+	that->process(gettimeofdayInMilliseconds());
+}
+
+
+// . returns false and sets g_errno on error
+// . caller calls stopReceiveThreads() on error
+bool UdpServer::startReceiveThreads(int32_t numThreads, const struct sockaddr_in &name, int32_t readBufSize) {
+	m_callbackFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if ( m_callbackFd < 0 ) {
 		g_errno = errno;
+		log(LOG_WARN, "udp: Failed to create eventfd: %s.", mstrerror(g_errno));
+		return false;
+	}
 
-		if ( g_errno == 0 || g_errno == EILSEQ || g_errno == EAGAIN ) {
+	if ( ! g_loop.registerReadCallback(m_callbackFd, this, callbackPollWrapper, "UdpServer::callbackPollWrapper", 0) ) {
+		return false;
+	}
+
+	try {
+		m_receiveThreads = new UdpReceiveThread[numThreads];
+	} catch ( std::bad_alloc & ) {
+		g_errno = ENOMEM;
+		log(LOG_WARN, "udp: Failed to allocate %" PRId32" receive threads.", numThreads);
+		return false;
+	}
+	mnew(m_receiveThreads, sizeof(UdpReceiveThread) * numThreads, "UdpRecvThread");
+	m_numReceiveThreads = numThreads;
+	m_stopReceiveThreads = false;
+
+	for ( int32_t i = 0; i < numThreads; i++ ) {
+		UdpReceiveThread *t = &m_receiveThreads[i];
+		t->m_server = this;
+
+		if ( ! t->m_recvBatch.init() ) {
+			return false;
+		}
+
+		// the first thread reads m_sock
+		if ( i == 0 ) {
+			t->m_sock = m_sock;
+			continue;
+		}
+
+		t->m_sock = socket(AF_INET, SOCK_DGRAM, 0);
+		if ( t->m_sock < 0 ) {
+			g_errno = errno;
+			log(LOG_WARN, "udp: Failed to create socket: %s.", mstrerror(g_errno));
+			return false;
+		}
+
+		int options = 1;
+		if ( setsockopt(t->m_sock, SOL_SOCKET, SO_REUSEADDR, &options, sizeof(options)) < 0 ||
+		     setsockopt(t->m_sock, SOL_SOCKET, SO_REUSEPORT, &options, sizeof(options)) < 0 ) {
+			g_errno = errno;
+			log(LOG_WARN, "udp: Call to setsockopt: %s.", mstrerror(g_errno));
+			return false;
+		}
+
+		enlargeUdpSocketBufffer(t->m_sock, "Receive", SO_RCVBUF, readBufSize);
+
+		if ( bind(t->m_sock, (const struct sockaddr *)(const void *)&name, sizeof(name)) < 0 ) {
+			g_errno = errno;
+			log(LOG_WARN, "udp: Failed to bind receive socket to port %hu: %s.", m_port, mstrerror(g_errno));
+			return false;
+		}
+	}
+
+	// . steer each dgram to socket transId % numThreads so all dgrams of
+	//   a transaction go to the thread owning its shard. the sockets of a
+	//   reuseport group are numbered in bind order
+	// . the program sees the udp payload, the transId is the low 30 bits
+	//   of its second word
+	// . without it we still work, the threads just share the shards
+	struct sock_filter steerCode[] = {
+		BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 4),
+		BPF_STMT(BPF_ALU | BPF_AND | BPF_K,   UDP_MAX_TRANSID),
+		BPF_STMT(BPF_ALU | BPF_MOD | BPF_K,   (uint32_t)numThreads),
+		BPF_STMT(BPF_RET | BPF_A,             0),
+	};
+	struct sock_fprog steerProg;
+	steerProg.len = sizeof(steerCode) / sizeof(steerCode[0]);
+	steerProg.filter = steerCode;
+	if ( numThreads > 1 &&
+	     setsockopt(m_sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &steerProg, sizeof(steerProg)) < 0 ) {
+		log(LOG_WARN, "udp: Could not attach reuseport program: %s. Receive threads will share slot shards.",
+		    mstrerror(errno));
+	}
+
+	for ( int32_t i = 0; i < numThreads; i++ ) {
+		UdpReceiveThread *t = &m_receiveThreads[i];
+		int rc = pthread_create(&t->m_thread, NULL, receiveThreadFunction, t);
+		if ( rc != 0 ) {
+			g_errno = rc;
+			log(LOG_ERROR, "udp: pthread_create() failed with rc=%d (%s)", rc, strerror(rc));
+			return false;
+		}
+		t->m_threadStarted = true;
+	}
+
+	log(LOG_INIT, "udp: Started %" PRId32" receive threads for UDP port %hu.", numThreads, m_port);
+	return true;
+}
+
+
+void UdpServer::stopReceiveThreads() {
+	if ( m_receiveThreads ) {
+		m_stopReceiveThreads = true;
+
+		for ( int32_t i = 0; i < m_numReceiveThreads; i++ ) {
+			UdpReceiveThread *t = &m_receiveThreads[i];
+			if ( t->m_threadStarted ) {
+				pthread_join(t->m_thread, NULL);
+				t->m_threadStarted = false;
+			}
+			// m_sock is closed by shutdown()
+			if ( i > 0 && t->m_sock >= 0 ) {
+				close(t->m_sock);
+			}
+			t->m_sock = -1;
+		}
+
+		mdelete(m_receiveThreads, sizeof(UdpReceiveThread) * m_numReceiveThreads, "UdpRecvThread");
+		delete[] m_receiveThreads;
+		m_receiveThreads = NULL;
+		m_numReceiveThreads = 0;
+	}
+
+	if ( m_callbackFd >= 0 ) {
+		g_loop.unregisterReadCallback(m_callbackFd, this, callbackPollWrapper);
+		close(m_callbackFd);
+		m_callbackFd = -1;
+	}
+}
+
+
+void *UdpServer::receiveThreadFunction(void *args) {
+	UdpReceiveThread *thread = static_cast<UdpReceiveThread*>(args);
+	s_isReceiveThread = true;
+	thread->m_server->receiveLoop(thread);
+	return NULL;
+}
+
+
+// . the receive thread equivalent of process(): read what is waiting on our
+//   socket, send the ACKs, then call the thread-safe handlers
+// . everything else goes on the callback list for the main loop
+void UdpServer::receiveLoop(UdpReceiveThread *thread) {
+	while ( ! m_stopReceiveThreads ) {
+		// time out so we notice m_stopReceiveThreads
+		struct pollfd pfd;
+		pfd.fd = thread->m_sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if ( poll(&pfd, 1, 100) <= 0 ) {
+			continue;
+		}
+
+		int64_t now = gettimeofdayInMilliseconds();
+
+		// . handle one recvmmsg() worth of dgrams
+		// . readSock() queues the ACKs, they are flushed below
+		do {
+			UdpSlot *slot;
+			int32_t status = readSock(&slot, now, thread);
+			if ( status == 0 ) {
+				break;
+			}
+			if ( ! slot ) {
+				g_errno = 0;
+				if ( status == -1 ) {
+					break;
+				}
+			}
+		} while ( ! thread->m_recvBatch.isEmpty() );
+
+		for ( int32_t i = 0; thread->m_touchedShards; i++ ) {
+			if ( thread->m_touchedShards & (1ULL << i) ) {
+				thread->m_touchedShards &= ~(1ULL << i);
+				ScopedLock sl(m_shards[i].m_mtx);
+				flushSendBatch_unlocked(&m_shards[i]);
+			}
+		}
+
+		for ( auto slot : thread->m_readySlots ) {
 			g_errno = 0;
+			makeCallback(slot);
+		}
+		thread->m_readySlots.clear();
+		g_errno = 0;
+
+		if ( thread->m_wakeMainLoop ) {
+			thread->m_wakeMainLoop = false;
+			uint64_t one = 1;
+			if ( write(m_callbackFd, &one, sizeof(one)) != sizeof(one) ) {
+				// the counter is already non-zero, main loop will wake up
+			}
+		}
+	}
+}
+
+
+// . returns -1 on error, 0 if blocked, 1 if completed reading dgram
+int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now, UdpReceiveThread *thread) {
+	// NULLify slot
+	*slotPtr = NULL;
+
+	// . receive threads read their own socket into their own batch, the
+	//   main thread only uses m_recvBatch if there are none. so the
+	//   socket is read without holding a lock
+	UdpRecvBatch *recvBatch = thread ? &thread->m_recvBatch : &m_recvBatch;
+	int sock = thread ? thread->m_sock : m_sock;
+
+	// . read as many dgrams as we can with one recvmmsg() and hand them
+	//   out one at a time
+	int32_t numRead = 0;
+	if ( recvBatch->isEmpty() ) {
+		numRead = recvBatch->fill(sock, g_conf.m_udpBatchSize);
+
+		logDebug(g_conf.m_logDebugLoop, "loop: readsock: numRead=%" PRId32" sock/fd=%i", numRead, sock);
+
+		// cancel silly g_errnos and return 0 since we blocked
+		if ( numRead < 0 ) {
+			g_errno = errno;
+
+			if ( g_errno == 0 || g_errno == EILSEQ || g_errno == EAGAIN ) {
+				g_errno = 0;
+				return 0;
+			}
+
+			// Interrupted system call (4) (from valgrind)
+			log( LOG_WARN, "udp: readDgram: %s (%d).", mstrerror( g_errno ), g_errno );
+			return -1;
+		}
+
+		if ( numRead == 0 ) {
 			return 0;
 		}
+	}
+
+	sockaddr_in from;
+	const char *readBuffer;
+	int32_t dgramSize;
+	if ( ! recvBatch->getNext(&readBuffer, &dgramSize, &from) ) {
+		return 0;
+	}
+	int readSize = dgramSize;
+
+	// . the slot lookup and handling of the dgram need the lock of the
+	//   shard the transaction is in
+	// . everybody has a transId
+	int32_t transId = m_proto->getTransId ( readBuffer, readSize );
+	UdpShard *shard = getShard(transId);
+	ScopedLock sl(shard->m_mtx);
 
-		// Interrupted system call (4) (from valgrind)
-		log( LOG_WARN, "udp: readDgram: %s (%d).", mstrerror( g_errno ), g_errno );
-		return -1;
+	if ( numRead > 0 ) {
+		m_batchStats.addRecvBatch(numRead);
 	}
 
 	uint32_t ip2;
@@ -918,7 +1363,6 @@ int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 	UdpSlot *slot;
 	int32_t dgramNum;
 	bool wasAck;
-	int32_t transId;
 	bool status;
 	msg_type_t msgType;
 	int32_t niceness;
@@ -973,13 +1417,11 @@ int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 				 //ip                  , // network order
 				 ntohs(from.sin_port)  );// host order
 	// get the corresponding slot for this key, if it exists
-	slot = getUdpSlot_unlocked(key);
+	slot = getUdpSlot_unlocked(shard, key);
 	// get the dgram number on this dgram
 	dgramNum = m_proto->getDgramNum ( readBuffer, readSize );
 	// was it an ack?
 	wasAck   = m_proto->isAck       ( readBuffer, readSize );
-	// everybody has a transId
-	transId  = m_proto->getTransId  ( readBuffer, readSize );
 	// other vars we'll use later
 	status  = true;
 	// if we don't already have a slot set up for it then it can be:
@@ -1065,7 +1507,13 @@ int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 			// . if this blocks, that sucks, we'll probably get
 			//   another untethered read... oh well...
 			// . ack from 0 to infinite to prevent more from coming
-			tmp.sendCancelAck(m_sock, now, dgramNum);
+			if ( shard->m_sendBatch.isFull() ) {
+				flushSendBatch_unlocked(shard);
+			}
+			tmp.sendCancelAck(&shard->m_sendBatch, now, dgramNum);
+			if ( thread ) {
+				thread->m_touchedShards |= 1ULL << (shard - m_shards);
+			}
 			//return 1;
 			goto discard;
 		}
@@ -1154,7 +1602,7 @@ int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 		
 		if ( getSlot ) 
 			// get a new UdpSlot
-			slot = getEmptyUdpSlot_unlocked(key, true);
+			slot = getEmptyUdpSlot_unlocked(shard, key, true);
 		// return -1 on failure
 		if ( ! slot ) {
 			// return -1
@@ -1242,12 +1690,46 @@ int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 	// we have to put slots with NULL callbacks in here since they
 	// are incoming requests to handle.
 	if ((slot->isDoneReading() || slot->getErrno())) {
-		// prepare to call the callback by adding it to this
-		// special linked list
-		addToCallbackLinkedList_unlocked(slot);
+		if ( thread && ! slot->getErrno() && slot->isIncoming() && ! slot->hasCalledHandler() &&
+		     m_threadSafeHandlers[slot->getMsgType()] && ! isInCallbackLinkedList_unlocked(shard, slot) ) {
+			// the receive thread calls the handler itself
+			if ( std::find(thread->m_readySlots.begin(), thread->m_readySlots.end(), slot) == thread->m_readySlots.end() ) {
+				thread->m_readySlots.push_back(slot);
+			}
+		} else {
+			// prepare to call the callback by adding it to this
+			// special linked list
+			addToCallbackLinkedList_unlocked(shard, slot);
+			if ( thread ) {
+				thread->m_wakeMainLoop = true;
+			}
+		}
 	}
 
  discard:
+	if ( *slotPtr ) {
+		// if there was a read error let makeCallback() know about it
+		if ( ! status ) {
+			(*slotPtr)->m_errno = g_errno;
+			// prepare to call the callback by adding it to this
+			// special linked list
+			if ( g_errno ) {
+				addToCallbackLinkedList_unlocked(shard, *slotPtr);
+				if ( thread ) {
+					thread->m_wakeMainLoop = true;
+				}
+			} else {
+				log("udp: missing g_errno from read error");
+			}
+		}
+		// . try sending an ACK on the slot we read something from
+		// . ACKs are flushed by the caller when it runs out of dgrams
+		doSending_unlocked(shard, *slotPtr, false, now, false);
+		if ( thread ) {
+			thread->m_touchedShards |= 1ULL << (shard - m_shards);
+		}
+	}
+
 	// . update stats, just put them all in g_udpServer
 	// . do not count acks
 	// . do not count discarded dgrams here
@@ -1291,8 +1773,13 @@ int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 // . the problem is when we call this with niceness 1 and we convert
 //   a niceness 1 callback to 0...
 bool UdpServer::makeCallbacks(int32_t niceness) {
-	// if nothing to call, forget it
-	if (!m_callbackListHead) {
+	// if nothing to call, forget it. this peeks without the locks, a slot
+	// added right now wakes us up again
+	bool haveCallbacks = false;
+	for ( int32_t i = 0; i < m_numShards && ! haveCallbacks; i++ ) {
+		haveCallbacks = ( m_shards[i].m_callbackListHead != NULL );
+	}
+	if ( ! haveCallbacks ) {
 		return false;
 	}
 
@@ -1304,121 +1791,132 @@ bool UdpServer::makeCallbacks(int32_t niceness) {
 
 	int64_t startTime = gettimeofdayInMilliseconds();
 
-	ScopedLock sl(m_mtx);
-
  fullRestart:
 
 	// take care of certain handlers/callbacks before any others
 	// regardless of niceness levels because these handlers are so fast
 	for(int pass=0; pass<2; pass++) {
-
-		UdpSlot *nextSlot = NULL;
-
-		// only scan those slots that are ready
-		for ( UdpSlot *slot = m_callbackListHead ; slot ; slot = nextSlot ) {
-			// because makeCallback() can delete the slot, use this
-			nextSlot = slot->m_callbackListNext;
-			// call quick handlers in pass 0, they do not take any time
-			// and if they do not get called right away can cause this host
-			// to bottleneck many hosts
-			if ( pass == 0 ) {
-				// only call handlers in pass 0, not reply callbacks
-				if ( slot->hasCallback() ) continue;
-				// only call certain msg handlers...
-				if ( slot->getMsgType() != msg_type_0   ) // read RdbList
-					continue;
-				// only allow niceness 0 msg 0x00 requests here since
-				// we call a msg8a from msg20.cpp summary generation
-				// which uses msg0 to read tagdb list from disk
-				if ( slot->getMsgType() == msg_type_0 && slot->getNiceness() ) {
-					// to keep udp slots from clogging up with 
-					// tagdb reads allow even niceness 1 tagdb 
-					// reads through. cache rate should be super
-					// higher and reads short.
-					char rdbId = 0;
-					if ( slot->m_readBuf &&
-					     slot->m_readBufSize > RDBIDOFFSET ) 
-						rdbId = slot->m_readBuf[RDBIDOFFSET];
-					if ( rdbId != RDB_TAGDB )
+		for(int32_t shardNum=0; shardNum<m_numShards; shardNum++) {
+			UdpShard *shard = &m_shards[shardNum];
+			ScopedLock sl(shard->m_mtx);
+
+			UdpSlot *nextSlot = NULL;
+
+			// only scan those slots that are ready
+			for ( UdpSlot *slot = shard->m_callbackListHead ; slot ; slot = nextSlot ) {
+				// because makeCallback() can delete the slot, use this
+				nextSlot = slot->m_callbackListNext;
+				// call quick handlers in pass 0, they do not take any time
+				// and if they do not get called right away can cause this host
+				// to bottleneck many hosts
+				if ( pass == 0 ) {
+					// only call handlers in pass 0, not reply callbacks
+					if ( slot->hasCallback() ) continue;
+					// only call certain msg handlers...
+					if ( slot->getMsgType() != msg_type_0   ) // read RdbList
 						continue;
+					// only allow niceness 0 msg 0x00 requests here since
+					// we call a msg8a from msg20.cpp summary generation
+					// which uses msg0 to read tagdb list from disk
+					if ( slot->getMsgType() == msg_type_0 && slot->getNiceness() ) {
+						// to keep udp slots from clogging up with 
+						// tagdb reads allow even niceness 1 tagdb 
+						// reads through. cache rate should be super
+						// higher and reads short.
+						char rdbId = 0;
+						if ( slot->m_readBuf &&
+						     slot->m_readBufSize > RDBIDOFFSET ) 
+							rdbId = slot->m_readBuf[RDBIDOFFSET];
+						if ( rdbId != RDB_TAGDB )
+							continue;
+					}
 				}
-			}
 
-			// skip if not level we want
-			if ( niceness <= 0 && slot->getNiceness() > 0 && pass>0) continue;
-			// set g_errno before calling
-			g_errno = slot->getErrno();
-			// if we got an error from him, set his stats
-			Host *h = NULL;
-			if ( g_errno && slot->getHostId() >= 0 )
-				h = g_hostdb.getHost ( slot->getHostId() );
-			if ( h ) {
-				h->m_errorReplies++;
-				if ( g_errno == ETRYAGAIN ) 
-					h->m_etryagains++;
-			}
+				// skip if not level we want
+				if ( niceness <= 0 && slot->getNiceness() > 0 && pass>0) continue;
+				// set g_errno before calling
+				g_errno = slot->getErrno();
+				// if we got an error from him, set his stats
+				Host *h = NULL;
+				if ( g_errno && slot->getHostId() >= 0 )
+					h = g_hostdb.getHost ( slot->getHostId() );
+				if ( h ) {
+					h->m_errorReplies++;
+					if ( g_errno == ETRYAGAIN ) 
+						h->m_etryagains++;
+				}
 
-			// try to call the callback for this slot
-			// time it now
-			int64_t start2 = 0;
-			bool logIt = false;
-			if ( slot->getNiceness() == 0 ) logIt = true;
-			if ( logIt ) start2 = gettimeofdayInMilliseconds();
-
-			logDebug(g_conf.m_logDebugUdp,"udp: calling callback/handler for slot=%p pass=%" PRId32" nice=%" PRId32,
-		        	 slot, (int32_t)pass,(int32_t)slot->getNiceness());
-
-			// . crap, this can alter the linked list we are scanning
-			//   if it deletes the slot! yes, but now we use "nextSlot"
-			// . return false on error and sets g_errno, true otherwise
-			// . return true if we called one
-			// . skip to next slot if did not call callback/handler
-			pthread_mutex_unlock(&m_mtx.mtx);
-			if (!makeCallback(slot)) {
-				pthread_mutex_lock(&m_mtx.mtx);
-				continue;
-			}
-			pthread_mutex_lock(&m_mtx.mtx);
-
-			// remove it from the callback list to avoid re-call
-			removeFromCallbackLinkedList_unlocked(slot);
-
-			int64_t took = logIt ? (gettimeofdayInMilliseconds()-start2) : 0;
-			if ( took > 1000 || (slot->getNiceness()==0 && took>100))
-				logf(LOG_DEBUG,"udp: took %" PRId64" ms to call "
-				     "callback/handler for "
-				     "msgtype=0x%" PRIx32" "
-				     "nice=%" PRId32" "
-				     "callback=%p",
-				     took,
-				     (int32_t)slot->getMsgType(),
-				     (int32_t)slot->getNiceness(),
-				     slot->m_callback);
-			numCalled++;
-
-			// log how long callback took
-			if(niceness > 0 && 
-			   (gettimeofdayInMilliseconds() - startTime) > 5 ) {
-				//bail if we're taking too long and we're a 
-				//low niceness request.  we can always come 
-				//back.
-				//TODO: call sigqueue if we need to
-				m_needBottom = true;
-				// now we just finish out the list with a 
-				// lower niceness
-				//niceness = 0;
-				return numCalled;
-			}
+				// try to call the callback for this slot
+				// time it now
+				int64_t start2 = 0;
+				bool logIt = false;
+				if ( slot->getNiceness() == 0 ) logIt = true;
+				if ( logIt ) start2 = gettimeofdayInMilliseconds();
+
+				logDebug(g_conf.m_logDebugUdp,"udp: calling callback/handler for slot=%p pass=%" PRId32" nice=%" PRId32,
+			        	 slot, (int32_t)pass,(int32_t)slot->getNiceness());
+
+				// once called the slot may be destroyed and reused by
+				// another thread, so remember these for the log
+				msg_type_t msgType = slot->getMsgType();
+				int32_t slotNiceness = slot->getNiceness();
+				void (*callback)(void *state, UdpSlot *slot) = slot->m_callback;
+
+				// . crap, this can alter the linked list we are scanning
+				//   if it deletes the slot! yes, but now we use "nextSlot"
+				// . return false on error and sets g_errno, true otherwise
+				// . return true if we called one
+				// . skip to next slot if did not call callback/handler
+				// . makeCallback() removes the slot from the callback list
+				//   before calling it
+				pthread_mutex_unlock(&shard->m_mtx.mtx);
+				if (!makeCallback(slot)) {
+					pthread_mutex_lock(&shard->m_mtx.mtx);
+					// the slot may be gone, and nextSlot with it
+					if ( nextSlot && ! isInCallbackLinkedList_unlocked(shard, nextSlot) ) {
+						nextSlot = shard->m_callbackListHead;
+					}
+					continue;
+				}
+				pthread_mutex_lock(&shard->m_mtx.mtx);
+
+				int64_t took = logIt ? (gettimeofdayInMilliseconds()-start2) : 0;
+				if ( took > 1000 || (slotNiceness==0 && took>100))
+					logf(LOG_DEBUG,"udp: took %" PRId64" ms to call "
+					     "callback/handler for "
+					     "msgtype=0x%" PRIx32" "
+					     "nice=%" PRId32" "
+					     "callback=%p",
+					     took,
+					     (int32_t)msgType,
+					     slotNiceness,
+					     callback);
+				numCalled++;
+
+				// log how long callback took
+				if(niceness > 0 && 
+				   (gettimeofdayInMilliseconds() - startTime) > 5 ) {
+					//bail if we're taking too long and we're a 
+					//low niceness request.  we can always come 
+					//back.
+					//TODO: call sigqueue if we need to
+					m_needBottom = true;
+					// now we just finish out the list with a 
+					// lower niceness
+					//niceness = 0;
+					return numCalled;
+				}
 
-			// CRAP, what happens is we are not in a quickpoll,
-			// we call some handler/callback, we enter a quickpoll,
-			// we convert him, send him, delete him, then return
-			// back to this function and the linked list is
-			// altered because we double entered this function
-			// from within a quickpoll. so if we are not in a 
-			// quickpoll, we have to reset the linked list scan after
-			// calling makeCallback(slot) below.
-			goto fullRestart;
+				// CRAP, what happens is we are not in a quickpoll,
+				// we call some handler/callback, we enter a quickpoll,
+				// we convert him, send him, delete him, then return
+				// back to this function and the linked list is
+				// altered because we double entered this function
+				// from within a quickpoll. so if we are not in a 
+				// quickpoll, we have to reset the linked list scan after
+				// calling makeCallback(slot) below.
+				goto fullRestart;
+			}
 		}
 		// clear
 		g_errno = 0;
@@ -1520,9 +2018,17 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 			log(LOG_DEBUG,"loop: enter callback for 0x%" PRIx32" "
 			    "nice=%" PRId32,(int32_t)slot->getMsgType(),slot->getNiceness());
 
-		// sanity check. has this slot been excised from linked list?
-		if (slot->m_activeListPrev && slot->m_activeListPrev->m_activeListNext != slot) {
-			g_process.shutdownAbort(true);
+		{
+			UdpShard *shard = getShard(slot);
+			ScopedLock sl(shard->m_mtx);
+
+			// sanity check. has this slot been excised from linked list?
+			if (slot->m_activeListPrev && slot->m_activeListPrev->m_activeListNext != slot) {
+				g_process.shutdownAbort(true);
+			}
+
+			// so nobody calls it again
+			removeFromCallbackLinkedList_unlocked(shard, slot);
 		}
 
 		slot->m_callback(slot->m_state, slot);
@@ -1651,9 +2157,14 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 	}
 
 	// . otherwise it was an incoming request we haven't answered yet
-	// . call the registered handler to handle it
+	// . call the registered handler to handle it, or the one a thread-safe
+	//   handler passed to callHandlerFromMainLoop()
 	// . bail if no handler
-	if ( ! m_handlers [ msgType ] ) {
+	void (*handler)(UdpSlot *slot, int32_t niceness) = slot->m_mainLoopHandler;
+	if ( ! handler ) {
+		handler = m_handlers [ msgType ];
+	}
+	if ( ! handler ) {
 		log(LOG_LOGIC,
 		    "udp: makeCallback: Recvd unsupported msg type 0x%02x."
 		    " Did you forget to call registerHandler() for your "
@@ -1665,44 +2176,72 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 	logDebug(g_conf.m_logDebugUdp, "udp: Calling handler for tid=%" PRId32" slot=%p msgType=0x%02x.",
 	         slot->getTransId(), slot, (int)msgType);
 
-	// record some statistics on how long this was waiting to be called
+	// record some statistics on how long this was waiting to be called.
+	// the first handler already did if it passed us on to the main loop
 	now = gettimeofdayInMilliseconds();
-	delta = now - slot->m_queuedTime;
-	// sanity check
-	if ( slot->m_queuedTime == -1 ) { g_process.shutdownAbort(true); }
-	n = slot->getNiceness();
-	if ( n < 0 ) n = 0;
-	if ( n > 1 ) n = 1;
-	// add to average
-	g_stats.m_msgTotalOfQueuedTimes [msgType][n] += delta;
-	g_stats.m_msgTotalQueued        [msgType][n]++;
-	// bucket number is log base 2 of the delta
-	if ( delta > 64000 ) delta = 64000;
-	bucket = getHighestLitBit ( (uint16_t)delta );
-	// MAX_BUCKETS is probably 16 and #define'd in Stats.h
-	if ( bucket >= MAX_BUCKETS ) bucket = MAX_BUCKETS-1;
-	g_stats.m_msgTotalQueuedByTime [msgType][n][bucket]++;
-
+	if ( ! slot->m_mainLoopHandler ) {
+		delta = now - slot->m_queuedTime;
+		// sanity check
+		if ( slot->m_queuedTime == -1 ) { g_process.shutdownAbort(true); }
+		n = slot->getNiceness();
+		if ( n < 0 ) n = 0;
+		if ( n > 1 ) n = 1;
+		// add to average
+		g_stats.m_msgTotalOfQueuedTimes [msgType][n] += delta;
+		g_stats.m_msgTotalQueued        [msgType][n]++;
+		// bucket number is log base 2 of the delta
+		if ( delta > 64000 ) delta = 64000;
+		bucket = getHighestLitBit ( (uint16_t)delta );
+		// MAX_BUCKETS is probably 16 and #define'd in Stats.h
+		if ( bucket >= MAX_BUCKETS ) bucket = MAX_BUCKETS-1;
+		g_stats.m_msgTotalQueuedByTime [msgType][n][bucket]++;
+
+		// use this for recording how long it takes to generate the reply
+		slot->m_queuedTime = now;
+	}
 
 	// time it
 	start = now; // gettimeofdayInMilliseconds();
 
-	// use this for recording how long it takes to generate the reply
-	slot->m_queuedTime = now;
+	// . the reply can be sent, acked and the slot destroyed by another
+	//   thread before the handler returns, so don't touch the slot after
+	//   calling it. remember these for the logs
+	// . we called the handler, don't call it again. g_errno was set from
+	//   m_errno before calling the handler, but to make sure the slot
+	//   doesn't get destroyed now, reset this to 0. see comment about
+	//   Msg20 above
+	// . set this here now so it doesn't get its niceness converted
+	//   then it re-enters the same handler here but in a quickpoll!
+	int32_t transId = slot->getTransId();
+	int32_t niceness = slot->getNiceness();
+	int32_t readBufSize = slot->m_readBufSize;
+	{
+		UdpShard *shard = getShard(slot);
+		ScopedLock sl(shard->m_mtx);
+
+		// sanity
+		if ( slot->hasCalledHandler() ) {
+			g_process.shutdownAbort(true);
+		}
+
+		slot->m_calledHandler = true;
+		slot->m_errno = 0;
+		removeFromCallbackLinkedList_unlocked(shard, slot);
+	}
 
 	// log it now
 	if ( g_conf.m_logDebugLoop )
 		log(LOG_DEBUG,"loop: enter handler for 0x%" PRIx32" nice=%" PRId32,
-		    (int32_t)slot->getMsgType(),(int32_t)slot->getNiceness());
+		    (int32_t)msgType,niceness);
 
 	bool oom = g_mem.getUsedMemPercentage() >= 99.0;
 
 	// if we are out of mem basically, do not waste time fucking around
-	if ( slot->getNiceness() == 0 && oom ) {
+	if ( niceness == 0 && oom ) {
 		// log it
 		static int32_t lcount = 0;
 		if ( lcount == 0 )
-			log(LOG_DEBUG,"loop: sending back enomem for ""msg 0x%02x", (int)slot->getMsgType());
+			log(LOG_DEBUG,"loop: sending back enomem for ""msg 0x%02x", (int)msgType);
 		if ( ++lcount == 20 ) lcount = 0;
 		
 		g_consecutiveOOMErrors++;
@@ -1722,33 +2261,16 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 			g_consecutiveOOMErrors = 0;
 		}
 
-		// sanity
-		if ( slot->hasCalledHandler() ) {
-			g_process.shutdownAbort(true);
-		}
-
-		// set this here now so it doesn't get its niceness converted
-		// then it re-enters the same handler here but in a quickpoll!
-		slot->m_calledHandler = true;
-
 		// sanity so msg0.cpp hack works
-		if ( slot->getNiceness() == 99 ) { g_process.shutdownAbort(true); }
+		if ( niceness == 99 ) { g_process.shutdownAbort(true); }
 		// . this is the niceness of the server, not the slot
 		// . NO, now it is the slot's niceness. that makes sense.
-		m_handlers [ slot->getMsgType() ] ( slot , slot->getNiceness() ) ;
+		handler ( slot , niceness ) ;
 	}
 
 	if ( g_conf.m_logDebugLoop )
 		log(LOG_DEBUG,"loop: exit handler for 0x%" PRIx32" nice=%" PRId32,
-		    (int32_t)slot->getMsgType(),(int32_t)slot->getNiceness());
-
-	// we called the handler, don't call it again
-	slot->m_calledHandler = true;
-
-	// g_errno was set from m_errno before calling the handler, but to
-	// make sure the slot doesn't get destroyed now, reset this to 0. see
-	// comment about Msg20 above.
-	slot->m_errno = 0;
+		    (int32_t)msgType,niceness);
 
 	if ( g_conf.m_maxCallbackDelay >= 0 ) {
 		int64_t elapsed = gettimeofdayInMilliseconds() - start;
@@ -1756,7 +2278,7 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 		if ( elapsed >= g_conf.m_maxCallbackDelay ) {
 			log(LOG_WARN, "UdpServer Took %" PRId64" ms to call "
 			    "HANDLER for msgType=0x%02x niceness=%" PRId32,
-			    elapsed, (int)slot->getMsgType(), (int32_t)slot->getNiceness());
+			    elapsed, (int)msgType, niceness);
 		}
 	}
 
@@ -1765,13 +2287,12 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 		int64_t took = gettimeofdayInMilliseconds() - start;
 		log(LOG_DEBUG,"net: Handler tid=%" PRId32" slot=%p "
 		    "msgType=0x%02x msgSize=%" PRId32" "
-		    "g_errno=%s callback=%p "
+		    "g_errno=%s "
 		    "niceness=%" PRId32" "
 		    "took %" PRId64" ms.",
-		    (int32_t)slot->getTransId() , slot,
-		    (int)msgType, (int32_t)slot->m_readBufSize , mstrerror(g_errno),
-		    slot->m_callback,
-		    (int32_t)slot->getNiceness(),
+		    transId , slot,
+		    (int)msgType, readBufSize , mstrerror(g_errno),
+		    niceness,
 		    took );
 	}
 
@@ -1789,10 +2310,7 @@ void UdpServer::timePollWrapper(int fd, void *state) {
 
 void UdpServer::timePoll ( ) {
 	//no active slots -> nothing to do
-	{
-		ScopedLock sl(m_mtx);
-		if ( ! m_activeListHead ) return;
-	}
+	if ( m_numUsedSlots == 0 ) return;
 
 	// get time now
 	int64_t now = gettimeofdayInMilliseconds();
@@ -1823,225 +2341,246 @@ void UdpServer::timePoll ( ) {
 bool UdpServer::readTimeoutPoll ( int64_t now ) {
 	// did we do something? assume not.
 	bool something = false;
-	// loop over occupied slots
-	ScopedLock sl(m_mtx);
-	for ( UdpSlot *slot = m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
-		// clear g_errno
-		g_errno = 0;
-		// debug msg
-		if ( g_conf.m_logDebugUdp ) {
-			char ipbuf[16];
-			log(LOG_DEBUG,
-			    "udp: resend TRY tid=%" PRId32" "
-			    "dst=%s:%hu "
-			    "doneReading=%" PRId32" "
-			    "dgramsToSend=%" PRId32" "
-			    "resendTime=%" PRId32" "
-			    "lastReadTime=%" PRIu64" "
-			    "delta=%" PRIu64" "
-			    "lastSendTime=%" PRIu64" "
-			    "delta=%" PRIu64" "
-			    "timeout=%" PRIu64" "
-			    "sentBitsOn=%" PRId32" "
-			    "readAckBitsOn=%" PRId32" ",
-			    slot->getTransId(),
-			    iptoa(slot->getIp(),ipbuf),
-			    (uint16_t) slot->getPort(),
-			    (int32_t) slot->isDoneReading(),
-			    slot->getDatagramsToSend(),
-			    slot->getResendTime(),
-			    (uint64_t) slot->getLastReadTime(),
-			    (uint64_t) (now - slot->getLastReadTime()),
-			    (uint64_t) slot->getLastSendTime(),
-			    (uint64_t) (now - slot->getLastSendTime()),
-			    (uint64_t) slot->getTimeout(),
-			    slot->m_sentBitsOn,
-			    slot->m_readAckBitsOn);
-		}
+	for ( int32_t shardNum = 0; shardNum < m_numShards; shardNum++ ) {
+		UdpShard *shard = &m_shards[shardNum];
+		ScopedLock sl(shard->m_mtx);
 
-		// if the reading is completed, but we haven't generated a
-		// reply yet, then continue because when reply is generated
-		// UdpServer::sendReply(slot) will be called and we don't
-		// want slot to be destroyed because it timed out...
-		if ( slot->isDoneReading() && slot->getDatagramsToSend() <= 0 ) {
-			continue;
-		}
+		// loop over occupied slots
+		for ( UdpSlot *slot = shard->m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
+			// clear g_errno
+			g_errno = 0;
+			// debug msg
+			if ( g_conf.m_logDebugUdp ) {
+				char ipbuf[16];
+				log(LOG_DEBUG,
+				    "udp: resend TRY tid=%" PRId32" "
+				    "dst=%s:%hu "
+				    "doneReading=%" PRId32" "
+				    "dgramsToSend=%" PRId32" "
+				    "resendTime=%" PRId32" "
+				    "lastReadTime=%" PRIu64" "
+				    "delta=%" PRIu64" "
+				    "lastSendTime=%" PRIu64" "
+				    "delta=%" PRIu64" "
+				    "timeout=%" PRIu64" "
+				    "sentBitsOn=%" PRId32" "
+				    "readAckBitsOn=%" PRId32" ",
+				    slot->getTransId(),
+				    iptoa(slot->getIp(),ipbuf),
+				    (uint16_t) slot->getPort(),
+				    (int32_t) slot->isDoneReading(),
+				    slot->getDatagramsToSend(),
+				    slot->getResendTime(),
+				    (uint64_t) slot->getLastReadTime(),
+				    (uint64_t) (now - slot->getLastReadTime()),
+				    (uint64_t) slot->getLastSendTime(),
+				    (uint64_t) (now - slot->getLastSendTime()),
+				    (uint64_t) slot->getTimeout(),
+				    slot->m_sentBitsOn,
+				    slot->m_readAckBitsOn);
+			}
 
-		// fix if clock changed!
-		if ( slot->getLastReadTime() > now ) {
-			slot->m_lastReadTime = now;
-		}
-		if ( slot->getLastSendTime() > now ) {
-			slot->m_lastSendTime = now;
-		}
+			// if the reading is completed, but we haven't generated a
+			// reply yet, then continue because when reply is generated
+			// UdpServer::sendReply(slot) will be called and we don't
+			// want slot to be destroyed because it timed out...
+			if ( slot->isDoneReading() && slot->getDatagramsToSend() <= 0 ) {
+				continue;
+			}
 
-		// get time elapsed since last read
-		int64_t elapsed = now - slot->getLastReadTime();
-		// set all timeouts to 4 secs if we are shutting down
-		if ( m_isShuttingDown && slot->getTimeout() > 4000 ) {
-			slot->m_timeout = 4000;
-		}
+			// fix if clock changed!
+			if ( slot->getLastReadTime() > now ) {
+				slot->m_lastReadTime = now;
+			}
+			if ( slot->getLastSendTime() > now ) {
+				slot->m_lastSendTime = now;
+			}
+
+			// get time elapsed since last read
+			int64_t elapsed = now - slot->getLastReadTime();
+			// set all timeouts to 4 secs if we are shutting down
+			if ( m_isShuttingDown && slot->getTimeout() > 4000 ) {
+				slot->m_timeout = 4000;
+			}
 		
-		// . deal w/ slots that are timed out
-		// . could be 1 of the 4 things:
-		// . 1. they take too long to send their reply
-		// . 2. they take too long to send their request
-		// . 3. they take too long to ACK our reply 
-		// . 4. they take too long to ACK our request
-		// . only flag it if we haven't already...
-		if ( elapsed >= slot->getTimeout() && slot->getErrno() != EUDPTIMEDOUT ) {
-			logDebug(g_conf.m_logDebugUdp, "udp: timeout reached for tid=%" PRId32" slot=%p ", slot->m_transId, slot);
-
-			// . set slot's m_errno field
-			// . makeCallbacks() should call its callback
-			slot->m_errno = EUDPTIMEDOUT;
-			// prepare to call the callback by adding it to this
-			// special linked list
-			addToCallbackLinkedList_unlocked(slot);
-			// let caller know we did something
-			something = true;
-			// keep going
-			continue;
-		}
+			// . deal w/ slots that are timed out
+			// . could be 1 of the 4 things:
+			// . 1. they take too long to send their reply
+			// . 2. they take too long to send their request
+			// . 3. they take too long to ACK our reply 
+			// . 4. they take too long to ACK our request
+			// . only flag it if we haven't already...
+			if ( elapsed >= slot->getTimeout() && slot->getErrno() != EUDPTIMEDOUT ) {
+				logDebug(g_conf.m_logDebugUdp, "udp: timeout reached for tid=%" PRId32" slot=%p ", slot->m_transId, slot);
+
+				// . set slot's m_errno field
+				// . makeCallbacks() should call its callback
+				slot->m_errno = EUDPTIMEDOUT;
+				// prepare to call the callback by adding it to this
+				// special linked list
+				addToCallbackLinkedList_unlocked(shard, slot);
+				// let caller know we did something
+				something = true;
+				// keep going
+				continue;
+			}
 
-		// Time out the slot if the host has been detected as unresponsive.
-		if(slot->m_host && g_hostdb.isDead(slot->m_host)) {
-			logDebug(g_conf.m_logDebugUdp, "udp: host #%" PRId32" is dead for tid=%" PRId32" slot=%p ",
-			         slot->m_host->m_hostId, slot->m_transId, slot);
+			// Time out the slot if the host has been detected as unresponsive.
+			if(slot->m_host && g_hostdb.isDead(slot->m_host)) {
+				logDebug(g_conf.m_logDebugUdp, "udp: host #%" PRId32" is dead for tid=%" PRId32" slot=%p ",
+				         slot->m_host->m_hostId, slot->m_transId, slot);
 
-			slot->m_errno = EUDPTIMEDOUT;
-			addToCallbackLinkedList_unlocked(slot);
-			something = true;
-			continue;
-		}
+				slot->m_errno = EUDPTIMEDOUT;
+				addToCallbackLinkedList_unlocked(shard, slot);
+				something = true;
+				continue;
+			}
 
-		// how long since last send?
-		int64_t delta = now - slot->getLastSendTime();
+			// how long since last send?
+			int64_t delta = now - slot->getLastSendTime();
 
-		// if elapsed is negative, then someone changed the system
-		// clock on us, so it won't hurt to resend just to update
-		// otherwise, we could be waiting years to resend
-		if ( delta < 0 ) {
-			delta = slot->getResendTime();
-		}
+			// if elapsed is negative, then someone changed the system
+			// clock on us, so it won't hurt to resend just to update
+			// otherwise, we could be waiting years to resend
+			if ( delta < 0 ) {
+				delta = slot->getResendTime();
+			}
 
-		// continue if we just sent something
-		if ( delta < slot->getResendTime() ) {
-			continue;
-		}
+			// continue if we just sent something
+			if ( delta < slot->getResendTime() ) {
+				continue;
+			}
 
-		// if we don't have anything ready to send continue
-		if ( slot->getDatagramsToSend() <= 0 ) continue;
-		// if shutting down, rather than resending the reply, just
-		// force it as if it were sent. then makeCallbacks can 
-		// destroy it.
-		if ( m_isShuttingDown ) {
-			// do not let this function free the buffers, they
-			// may not be allocated really. this may cause a memory
-			// leak.
-			slot->m_readBuf      = NULL;
-			slot->m_sendBufAlloc = NULL;
-			// just nuke the slot... this will leave the memory
-			// leaked... (memleak, memory leak, memoryleak)
-			destroySlot_unlocked(slot);
-			continue;
-		}
-		// should we resend all dgrams?
-		bool resendAll = false;
-		// . HACK: if our request was sent but 30 seconds have passed
-		//   and we got no reply, resend our whole request!
-		// . this fixes the stuck Msg10 fiasco because it uses
-		//   timeouts of 1 year
-		// . this is mainly for msgs with infinite timeouts
-		// . so if recpipient crashes and comes back up later then
-		//   we can resend him EVERYTHING!!
-		// . TODO: what if we get reply before we sent everything!?!?
-		// . if over 30 secs has passed, resend it ALL!!
-		// . this will reset the sent bits and read ack bits
-		if ( slot->m_sentBitsOn == slot->m_readAckBitsOn ) {
-			// give him 30 seconds to send a reply 
-			if ( elapsed < 30000 ) continue;
-			// otherwise, resend the whole thing, he
-			resendAll = true;
-		}
+			// if we don't have anything ready to send continue
+			if ( slot->getDatagramsToSend() <= 0 ) continue;
+			// if shutting down, rather than resending the reply, just
+			// force it as if it were sent. then makeCallbacks can 
+			// destroy it.
+			if ( m_isShuttingDown ) {
+				// do not let this function free the buffers, they
+				// may not be allocated really. this may cause a memory
+				// leak.
+				slot->m_readBuf      = NULL;
+				slot->m_sendBufAlloc = NULL;
+				// just nuke the slot... this will leave the memory
+				// leaked... (memleak, memory leak, memoryleak)
+				destroySlot_unlocked(shard, slot);
+				continue;
+			}
+			// should we resend all dgrams?
+			bool resendAll = false;
+			// . HACK: if our request was sent but 30 seconds have passed
+			//   and we got no reply, resend our whole request!
+			// . this fixes the stuck Msg10 fiasco because it uses
+			//   timeouts of 1 year
+			// . this is mainly for msgs with infinite timeouts
+			// . so if recpipient crashes and comes back up later then
+			//   we can resend him EVERYTHING!!
+			// . TODO: what if we get reply before we sent everything!?!?
+			// . if over 30 secs has passed, resend it ALL!!
+			// . this will reset the sent bits and read ack bits
+			if ( slot->m_sentBitsOn == slot->m_readAckBitsOn ) {
+				// give him 30 seconds to send a reply 
+				if ( elapsed < 30000 ) continue;
+				// otherwise, resend the whole thing, he
+				resendAll = true;
+			}
 
-		//
-		// SHIT, sometimes a summary generator on a huge asian lang
-		// page takes over 1 second and we are unable to send acks
-		// for an incoming msg20 request etc, and this code triggers..
-		// maybe QUICKPOLL(0) should at least send/read the udp ports?
-		//
-		// FOR NOW though since hosts do not go down that much
-		// let's also require that it has been 5 secs or more...
-		//
-
-		int64_t timeout = 5000;
-		// spider time requests typically have timeouts of 1 year!
-		// so we end up waiting for the host to come back online
-		// before the spider can proceed.
-		if ( slot->getNiceness() ) {
-			timeout = slot->getTimeout();
-		}
+			//
+			// SHIT, sometimes a summary generator on a huge asian lang
+			// page takes over 1 second and we are unable to send acks
+			// for an incoming msg20 request etc, and this code triggers..
+			// maybe QUICKPOLL(0) should at least send/read the udp ports?
+			//
+			// FOR NOW though since hosts do not go down that much
+			// let's also require that it has been 5 secs or more...
+			//
+
+			int64_t timeout = 5000;
+			// spider time requests typically have timeouts of 1 year!
+			// so we end up waiting for the host to come back online
+			// before the spider can proceed.
+			if ( slot->getNiceness() ) {
+				timeout = slot->getTimeout();
+			}
+
+			// check it
+			if ( slot->m_maxResends >= 0 &&
+			     // if maxResends it 0, do not do ANY resend! just err out.
+			     slot->getResendCount() >= slot->m_maxResends &&
+			     // did not get all acks
+			     slot->m_sentBitsOn > slot->m_readAckBitsOn &&
+			     // respect slot's timeout too!
+			     elapsed > timeout &&
+			     // only do this when sending a request
+			     slot->hasCallback() ) {
+				// should this be ENOACK or something?
+				slot->m_errno = EUDPTIMEDOUT;
+				// prepare to call the callback by adding it to this
+				// special linked list
+				addToCallbackLinkedList_unlocked(shard, slot);
+				// let caller know we did something
+				something = true;
+				// note it
+				log(LOG_INFO, "udp: Timing out slot (msgType=0x%" PRIx32") "
+				    "after %" PRId32" resends. hostid=%" PRId32" "
+				    "(elapsed=%" PRId64")" ,
+				    (int32_t)slot->getMsgType(),
+				    (int32_t)slot->getResendCount() ,
+				    slot->getHostId(),elapsed);
+				// keep going
+				continue;
+			}
+			// . this should clear the sentBits of all unacked dgrams
+			//   so they can be resent
+			// . this doubles m_resendTime and updates m_resendCount
+			slot->prepareForResend ( now , resendAll );
+			// . we resend our first unACKed dgram if some time has passed
+			// . send as much as we can on this slot
+			doSending_unlocked(shard, slot, true /*allow resends?*/, now);
+			// return if we had an error sending, like EBADF we get
+			// when we've shut down the servers...
+			if ( g_errno == EBADF ) return something;
 
-		// check it
-		if ( slot->m_maxResends >= 0 &&
-		     // if maxResends it 0, do not do ANY resend! just err out.
-		     slot->getResendCount() >= slot->m_maxResends &&
-		     // did not get all acks
-		     slot->m_sentBitsOn > slot->m_readAckBitsOn &&
-		     // respect slot's timeout too!
-		     elapsed > timeout &&
-		     // only do this when sending a request
-		     slot->hasCallback() ) {
-			// should this be ENOACK or something?
-			slot->m_errno = EUDPTIMEDOUT;
-			// prepare to call the callback by adding it to this
-			// special linked list
-			addToCallbackLinkedList_unlocked(slot);
-			// let caller know we did something
 			something = true;
-			// note it
-			log(LOG_INFO, "udp: Timing out slot (msgType=0x%" PRIx32") "
-			    "after %" PRId32" resends. hostid=%" PRId32" "
-			    "(elapsed=%" PRId64")" ,
-			    (int32_t)slot->getMsgType(),
-			    (int32_t)slot->getResendCount() ,
-			    slot->getHostId(),elapsed);
-			// keep going
-			continue;
 		}
-		// . this should clear the sentBits of all unacked dgrams
-		//   so they can be resent
-		// . this doubles m_resendTime and updates m_resendCount
-		slot->prepareForResend ( now , resendAll );
-		// . we resend our first unACKed dgram if some time has passed
-		// . send as much as we can on this slot
-		doSending_unlocked(slot, true /*allow resends?*/, now);
-		// return if we had an error sending, like EBADF we get
-		// when we've shut down the servers...
-		if ( g_errno == EBADF ) return something;
-
-		something = true;
 	}
 	// return true if we did something
 	return something;
 }
 
 void UdpServer::destroySlot(UdpSlot *slot) {
-	ScopedLock sl(m_mtx);
-	destroySlot_unlocked(slot);
+	UdpShard *shard = getShard(slot);
+	ScopedLock sl(shard->m_mtx);
+	destroySlot_unlocked(shard, slot);
 }
 
 // . IMPORTANT: only called for transactions that we initiated!!!
 //   so we know to set the key.n0 hi bit
 // . may be called twice on same slot by Multicast::destroySlotsInProgress()
-void UdpServer::destroySlot_unlocked( UdpSlot *slot ) {
+void UdpServer::destroySlot_unlocked( UdpShard *shard, UdpSlot *slot ) {
 	if (!slot) {
 		gbshutdownLogicError();
 	}
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: destroy tid=%d slot=%p", slot->getTransId(), slot);
 
+	// . if we give up on our request before we got the whole reply (timed
+	//   out, cancelled or a losing hedged request) tell the remote host so
+	//   its handler can stop working on it. see UdpSlot::isRequesterCancelled()
+	// . a reply dgram arriving after we closed gets one too, but that only
+	//   happens once the handler is done
+	if ( slot->hasCallback() && m_proto->useAcks() && slot->m_sentBitsOn > 0 && ! slot->isDoneReading() ) {
+		if ( shard->m_sendBatch.isFull() ) {
+			flushSendBatch_unlocked(shard);
+		}
+		slot->sendCancelAck(&shard->m_sendBatch, gettimeofdayInMilliseconds(), 0);
+	}
+
+	// m_sendBatch may still point into the send buffer we free below
+	flushSendBatch_unlocked(shard);
+
 	// if we're deleting a slot that was an incoming request then
 	// decrement m_requestsInWaiting (exclude pings)
 	if ( ! slot->hasCallback() ) {
@@ -2076,7 +2615,7 @@ void UdpServer::destroySlot_unlocked( UdpSlot *slot ) {
 	//   since we turned interrupts off
 	// . free this slot available right away so sig handler won't
 	//   write into m_readBuf or use m_sendBuf, but it may claim it!
-	freeUdpSlot_unlocked(slot);
+	freeUdpSlot_unlocked(shard, slot);
 
 	// free the send/read buffers
 	if ( rbuf ) mfree ( rbuf , rbufSize , "UdpServer");
@@ -2105,16 +2644,15 @@ bool UdpServer::shutdown ( bool urgent ) {
 	else if ( ! m_isShuttingDown ) 
 		log(LOG_INFO,"gb: Shutting down udp server port %hu.",m_port);
 
-	ScopedLock sl(m_mtx);
-
 	// so we know not to accept new connections
 	m_isShuttingDown = true;
 
 	// wait for all transactions to complete
 	time_t now = getTime();
 	int32_t count = 0;
-	if(!urgent) {
-		for ( UdpSlot *slot = m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
+	for ( int32_t i = 0; i < m_numShards && ! urgent; i++ ) {
+		ScopedLock sl(m_shards[i].m_mtx);
+		for ( UdpSlot *slot = m_shards[i].m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
 			// if we initiated, then don't count it
 			if ( slot->hasCallback() ) continue;
 			// set all timeouts to 3 secs
@@ -2141,6 +2679,9 @@ bool UdpServer::shutdown ( bool urgent ) {
 	else
 		log(LOG_INFO,"gb: Closing udp server socket port %hu.",m_port);
 
+	// stop reading before we close the socket
+	stopReceiveThreads();
+
 	// close our socket descriptor, may block to finish sending
 	int s = m_sock;
 	// . make it -1 so thread exits
@@ -2163,21 +2704,23 @@ bool UdpServer::shutdown ( bool urgent ) {
 	return true;
 }
 
-int32_t UdpServer::getTransId_unlocked() {
-	m_mtx.verify_is_locked();
-
-	int32_t tid = m_nextTransId++;
-	if ( m_nextTransId >= UDP_MAX_TRANSID ) {
-		m_nextTransId = 0;
-	}
+int32_t UdpServer::getTransId() {
+	int32_t tid = m_nextTransId.load();
+	int32_t next;
+	do {
+		next = tid + 1;
+		if ( next >= UDP_MAX_TRANSID ) {
+			next = 0;
+		}
+	} while ( ! m_nextTransId.compare_exchange_weak(tid, next) );
 	return tid;
 }
 
 // verified that this is not interruptible
-UdpSlot *UdpServer::getEmptyUdpSlot_unlocked(key96_t k, bool incoming) {
-	m_mtx.verify_is_locked();
+UdpSlot *UdpServer::getEmptyUdpSlot_unlocked(UdpShard *shard, key96_t k, bool incoming) {
+	shard->m_mtx.verify_is_locked();
 
-	UdpSlot *slot = removeFromAvailableLinkedList_unlocked();
+	UdpSlot *slot = removeFromAvailableLinkedList();
 	if (!slot) {
 		// return NULL if none left
 		g_errno = ENOSLOTS;
@@ -2188,7 +2731,7 @@ UdpSlot *UdpServer::getEmptyUdpSlot_unlocked(key96_t k, bool incoming) {
 		return NULL;
 	}
 
-	addToActiveLinkedList_unlocked(slot);
+	addToActiveLinkedList_unlocked(shard, slot);
 
 	// count it
 	m_numUsedSlots++;
@@ -2201,45 +2744,74 @@ UdpSlot *UdpServer::getEmptyUdpSlot_unlocked(key96_t k, bool incoming) {
 
 	// now store ptr in hash table
 	slot->m_key = k;
-	addKey_unlocked(k, slot);
+	addKey_unlocked(shard, k, slot);
 
 	logDebug(g_conf.m_logDebugUdp, "udp: get %s empty slot=%p with key=%s", incoming ? "incoming" : "outgoing", slot, KEYSTR(&k, sizeof(key96_t)));
 	return slot;
 }
 
-void UdpServer::addKey_unlocked(key96_t k, UdpSlot *ptr) {
-	m_mtx.verify_is_locked();
+void UdpServer::addKey_unlocked(UdpShard *shard, key96_t k, UdpSlot *ptr) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: add key=%s with slot=%p", KEYSTR(&k, sizeof(key96_t)), ptr);
 
 	// we assume that k.n1 is the transId. if this changes we should
 	// change this to keep our hash lookups fast
-	int32_t i = hashLong(k.n1) & m_bucketMask;
-	while ( m_ptrs[i] )
-		if ( ++i >= m_numBuckets ) i = 0;
-	m_ptrs[i] = ptr;
+	int32_t i = hashLong(k.n1) & shard->m_bucketMask;
+	while ( shard->m_ptrs[i] )
+		if ( ++i >= shard->m_numBuckets ) i = 0;
+	shard->m_ptrs[i] = ptr;
 }
 
 // verify that interrupts are always off before calling this
-UdpSlot *UdpServer::getUdpSlot_unlocked(key96_t k) {
-	m_mtx.verify_is_locked();
+UdpSlot *UdpServer::getUdpSlot_unlocked(UdpShard *shard, key96_t k) {
+	shard->m_mtx.verify_is_locked();
 
 	// . hash into table
 	// . transId is key.n1, use that as hash
 	// . m_numBuckets must be a power of 2
-	int32_t i = hashLong(k.n1) & m_bucketMask;
-	while ( m_ptrs[i] && m_ptrs[i]->m_key != k ) {
-		if (++i >= m_numBuckets) {
+	int32_t i = hashLong(k.n1) & shard->m_bucketMask;
+	while ( shard->m_ptrs[i] && shard->m_ptrs[i]->m_key != k ) {
+		if (++i >= shard->m_numBuckets) {
 			i = 0;
 		}
 	}
 
 	// if empty, return NULL
-	return m_ptrs[i];
+	return shard->m_ptrs[i];
 }
 
-void UdpServer::addToAvailableLinkedList_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+void UdpServer::removeKey_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
+
+	// . get bucket number in hash table
+	// . may have change since table often gets rehashed
+	key96_t k = slot->m_key;
+	int32_t i = hashLong(k.n1) & shard->m_bucketMask;
+	while ( shard->m_ptrs[i] && shard->m_ptrs[i]->m_key != k ) 
+		if ( ++i >= shard->m_numBuckets ) i = 0;
+	// sanity check
+	if ( ! shard->m_ptrs[i] ) {
+		log(LOG_LOGIC,"udp: removeKey: Not in hash table.");
+		g_process.shutdownAbort(true);
+	}
+
+	// remove the bucket
+	shard->m_ptrs [ i ] = NULL;
+	// rehash all buckets below
+	if ( ++i >= shard->m_numBuckets ) i = 0;
+	// keep looping until we hit an empty slot
+	while ( shard->m_ptrs[i] ) {
+		UdpSlot *ptr = shard->m_ptrs[i];
+		shard->m_ptrs[i] = NULL;
+		// re-hash it
+		addKey_unlocked(shard, ptr->m_key, ptr);
+		if ( ++i >= shard->m_numBuckets ) i = 0;
+	}
+}
+
+void UdpServer::addToAvailableLinkedList(UdpSlot *slot) {
+	ScopedLock sl(m_availableMtx);
 
 	log(LOG_DEBUG, "udp: adding tid=%d slot=%p to available list", slot->getTransId(), slot);
 
@@ -2247,8 +2819,8 @@ void UdpServer::addToAvailableLinkedList_unlocked(UdpSlot *slot) {
 	m_availableListHead = slot;
 }
 
-UdpSlot* UdpServer::removeFromAvailableLinkedList_unlocked() {
-	m_mtx.verify_is_locked();
+UdpSlot* UdpServer::removeFromAvailableLinkedList() {
+	ScopedLock sl(m_availableMtx);
 
 	// return NULL if none left
 	if ( ! m_availableListHead ) {
@@ -2266,8 +2838,8 @@ UdpSlot* UdpServer::removeFromAvailableLinkedList_unlocked() {
 	return slot;
 }
 
-void UdpServer::addToCallbackLinkedList_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+void UdpServer::addToCallbackLinkedList_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
 
 	// debug log
 	if (g_conf.m_logDebugUdp) {
@@ -2280,7 +2852,7 @@ void UdpServer::addToCallbackLinkedList_unlocked(UdpSlot *slot) {
 	}
 
 	// must not be in there already, lest we double add it
-	if (isInCallbackLinkedList_unlocked(slot) ) {
+	if (isInCallbackLinkedList_unlocked(shard, slot) ) {
 		logDebug(g_conf.m_logDebugUdp, "udp: avoided double add slot=%p", slot);
 		return;
 	}
@@ -2288,43 +2860,43 @@ void UdpServer::addToCallbackLinkedList_unlocked(UdpSlot *slot) {
 	slot->m_callbackListNext = NULL;
 	slot->m_callbackListPrev = NULL;
 
-	if ( ! m_callbackListTail ) {
-		m_callbackListHead = slot;
-		m_callbackListTail = slot;
+	if ( ! shard->m_callbackListTail ) {
+		shard->m_callbackListHead = slot;
+		shard->m_callbackListTail = slot;
 	} else {
 		// insert at end of linked list otherwise
-		m_callbackListTail->m_callbackListNext = slot;
-		slot->m_callbackListPrev = m_callbackListTail;
-		m_callbackListTail = slot;
+		shard->m_callbackListTail->m_callbackListNext = slot;
+		slot->m_callbackListPrev = shard->m_callbackListTail;
+		shard->m_callbackListTail = slot;
 	}
 }
 
-bool UdpServer::isInCallbackLinkedList_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+bool UdpServer::isInCallbackLinkedList_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
 
 	// return if not in the linked list
-	if (slot->m_callbackListPrev || slot->m_callbackListNext || m_callbackListHead == slot) {
+	if (slot->m_callbackListPrev || slot->m_callbackListNext || shard->m_callbackListHead == slot) {
 		return true;
 	}
 	return false;
 }
 
-void UdpServer::removeFromCallbackLinkedList_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+void UdpServer::removeFromCallbackLinkedList_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: removing tid=%d slot=%p from callback list", slot->getTransId(), slot);
 
 	// return if not in the linked list
-	if ( slot->m_callbackListPrev == NULL && slot->m_callbackListNext == NULL && m_callbackListHead != slot ) {
+	if ( slot->m_callbackListPrev == NULL && slot->m_callbackListNext == NULL && shard->m_callbackListHead != slot ) {
 		return;
 	}
 
 	// excise from linked list otherwise
-	if ( m_callbackListHead == slot ) {
-		m_callbackListHead = slot->m_callbackListNext;
+	if ( shard->m_callbackListHead == slot ) {
+		shard->m_callbackListHead = slot->m_callbackListNext;
 	}
-	if ( m_callbackListTail == slot )
-		m_callbackListTail = slot->m_callbackListPrev;
+	if ( shard->m_callbackListTail == slot )
+		shard->m_callbackListTail = slot->m_callbackListPrev;
 
 	if ( slot->m_callbackListPrev ) {
 		slot->m_callbackListPrev->m_callbackListNext = slot->m_callbackListNext;
@@ -2339,8 +2911,8 @@ void UdpServer::removeFromCallbackLinkedList_unlocked(UdpSlot *slot) {
 	slot->m_callbackListNext = NULL;
 }
 
-void UdpServer::addToActiveLinkedList_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+void UdpServer::addToActiveLinkedList_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: adding slot=%p to active list", slot);
 
@@ -2351,33 +2923,33 @@ void UdpServer::addToActiveLinkedList_unlocked(UdpSlot *slot) {
 	slot->m_activeListNext = NULL;
 	slot->m_activeListPrev = NULL;
 
-	if (m_activeListTail) {
+	if (shard->m_activeListTail) {
 		// insert at end of linked list otherwise
-		m_activeListTail->m_activeListNext = slot;
-		slot->m_activeListPrev = m_activeListTail;
-		m_activeListTail = slot;
+		shard->m_activeListTail->m_activeListNext = slot;
+		slot->m_activeListPrev = shard->m_activeListTail;
+		shard->m_activeListTail = slot;
 	} else {
-		m_activeListHead = slot;
-		m_activeListTail = slot;
+		shard->m_activeListHead = slot;
+		shard->m_activeListTail = slot;
 	}
 }
 
-void UdpServer::removeFromActiveLinkedList_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+void UdpServer::removeFromActiveLinkedList_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: removing tid=%d slot=%p from active list", slot->getTransId(), slot);
 
 	// return if not in the linked list
-	if ( slot->m_activeListPrev == NULL && slot->m_activeListNext == NULL && m_activeListHead != slot ) {
+	if ( slot->m_activeListPrev == NULL && slot->m_activeListNext == NULL && shard->m_activeListHead != slot ) {
 		return;
 	}
 
 	// excise from linked list otherwise
-	if ( m_activeListHead == slot ) {
-		m_activeListHead = slot->m_activeListNext;
+	if ( shard->m_activeListHead == slot ) {
+		shard->m_activeListHead = slot->m_activeListNext;
 	}
-	if ( m_activeListTail == slot )
-		m_activeListTail = slot->m_activeListPrev;
+	if ( shard->m_activeListTail == slot )
+		shard->m_activeListTail = slot->m_activeListPrev;
 
 	if ( slot->m_activeListPrev ) {
 		slot->m_activeListPrev->m_activeListNext = slot->m_activeListNext;
@@ -2393,15 +2965,22 @@ void UdpServer::removeFromActiveLinkedList_unlocked(UdpSlot *slot) {
 }
 
 // verified that this is not interruptible
-void UdpServer::freeUdpSlot_unlocked(UdpSlot *slot) {
-	m_mtx.verify_is_locked();
+void UdpServer::freeUdpSlot_unlocked(UdpShard *shard, UdpSlot *slot) {
+	shard->m_mtx.verify_is_locked();
 
 	logDebug(g_conf.m_logDebugUdp, "udp: free tid=%d slot=%p", slot->getTransId(), slot);
 
-	removeFromActiveLinkedList_unlocked(slot);
+	removeFromActiveLinkedList_unlocked(shard, slot);
 
 	// also from callback candidates if we should
-	removeFromCallbackLinkedList_unlocked(slot);
+	removeFromCallbackLinkedList_unlocked(shard, slot);
+
+	char ipbuf[16];
+	logDebug(g_conf.m_logDebugUdp, "udp: freeUdpSlot: Freeing slot tid=%" PRId32" dst=%s:%" PRIu32" slot=%p",
+	         slot->getTransId(), iptoa(slot->getIp(),ipbuf), (uint32_t)slot->getPort(), slot);
+
+	// and from the hash table
+	removeKey_unlocked(shard, slot);
 
 	// discount it
 	m_numUsedSlots--;
@@ -2425,60 +3004,38 @@ void UdpServer::freeUdpSlot_unlocked(UdpSlot *slot) {
 		slot->m_sendBufAllocSize = 0;
 	}
 
-	// add to linked list of available slots
-	addToAvailableLinkedList_unlocked(slot);
-
-	// . get bucket number in hash table
-	// . may have change since table often gets rehashed
-	key96_t k = slot->m_key;
-	int32_t i = hashLong(k.n1) & m_bucketMask;
-	while ( m_ptrs[i] && m_ptrs[i]->m_key != k ) 
-		if ( ++i >= m_numBuckets ) i = 0;
-	// sanity check
-	if ( ! m_ptrs[i] ) {
-		log(LOG_LOGIC,"udp: freeUdpSlot: Not in hash table.");
-		g_process.shutdownAbort(true);
-	}
-
-	char ipbuf[16];
-	logDebug(g_conf.m_logDebugUdp, "udp: freeUdpSlot: Freeing slot tid=%" PRId32" dst=%s:%" PRIu32" slot=%p",
-	         slot->getTransId(), iptoa(slot->getIp(),ipbuf), (uint32_t)slot->getPort(), slot);
-
-	// remove the bucket
-	m_ptrs [ i ] = NULL;
-	// rehash all buckets below
-	if ( ++i >= m_numBuckets ) i = 0;
-	// keep looping until we hit an empty slot
-	while ( m_ptrs[i] ) {
-		UdpSlot *ptr = m_ptrs[i];
-		m_ptrs[i] = NULL;
-		// re-hash it
-		addKey_unlocked(ptr->m_key, ptr);
-		if ( ++i >= m_numBuckets ) i = 0;
-	}
+	// . add to linked list of available slots
+	// . do this last, another shard can take it right away
+	addToAvailableLinkedList(slot);
 }
 
 void UdpServer::cancel ( void *state , msg_type_t msgType ) {
 	// . if we have transactions in progress wait
 	// . but if we're waiting for a reply, don't bother
-	pthread_mutex_lock(&m_mtx.mtx);
-	for ( UdpSlot *slot = m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
-		// skip if not a match
-		if (slot->m_state != state || slot->getMsgType() != msgType) {
-			continue;
-		}
-
-		// note it
-		log(LOG_INFO,"udp: cancelled udp tid=%d slot=%p msgType=0x%02x.", slot->getTransId(), slot, (int)slot->getMsgType());
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		UdpShard *shard = &m_shards[i];
+		pthread_mutex_lock(&shard->m_mtx.mtx);
+	restart:
+		for ( UdpSlot *slot = shard->m_activeListHead ; slot ; slot = slot->m_activeListNext ) {
+			// skip if not a match
+			if (slot->m_state != state || slot->getMsgType() != msgType) {
+				continue;
+			}
 
-		// let them know why we are calling the callback prematurely
-		g_errno = ECANCELLED;
-		// stop waiting for reply, this will call destroySlot(), too
-		pthread_mutex_unlock(&m_mtx.mtx);
-		makeCallback(slot);
-		pthread_mutex_lock(&m_mtx.mtx);
+			// note it
+			log(LOG_INFO,"udp: cancelled udp tid=%d slot=%p msgType=0x%02x.", slot->getTransId(), slot, (int)slot->getMsgType());
+
+			// let them know why we are calling the callback prematurely
+			g_errno = ECANCELLED;
+			// . stop waiting for reply, this will call destroySlot(), too
+			// . so the list may have changed, scan it again
+			pthread_mutex_unlock(&shard->m_mtx.mtx);
+			makeCallback(slot);
+			pthread_mutex_lock(&shard->m_mtx.mtx);
+			goto restart;
+		}
+		pthread_mutex_unlock(&shard->m_mtx.mtx);
 	}
-	pthread_mutex_unlock(&m_mtx.mtx);
 }
 
 void UdpServer::replaceHost ( Host *oldHost, Host *newHost ) {
@@ -2487,119 +3044,101 @@ void UdpServer::replaceHost ( Host *oldHost, Host *newHost ) {
 	      (uint32_t)oldHost->m_ip, 
 	      (uint32_t)oldHost->m_ipShotgun,
 	      (uint32_t)oldHost->m_port );//, oldHost->m_port2 );
-	ScopedLock sl(m_mtx);
 	// . loop over outstanding transactions looking for ones to oldHost
-	for ( UdpSlot *slot = m_activeListHead; slot; slot = slot->m_activeListNext ) {
-		// ignore incoming
-		if ( ! slot->hasCallback() ) continue;
-		// check for ip match
-		if ( slot->getIp() != oldHost->m_ip &&
-		     slot->getIp() != oldHost->m_ipShotgun )
-			continue;
-		// check for port match
-		if ( this == &g_udpServer && slot->getPort() != oldHost->m_port )
-			continue;
-		// . match, replace the slot ip/port with the newHost
-		// . first remove the old hashed key for this slot
-		// . get bucket number in hash table
-		// . may have change since table often gets rehashed
-		key96_t k = slot->m_key;
-		int32_t i = hashLong(k.n1) & m_bucketMask;
-		while ( m_ptrs[i] && m_ptrs[i]->m_key != k ) 
-			if ( ++i >= m_numBuckets ) i = 0;
-		// sanity check
-		if ( ! m_ptrs[i] ) {
-			log(LOG_LOGIC,"udp: replaceHost: Slot not in hash table.");
-			g_process.shutdownAbort(true);
-		}
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		UdpShard *shard = &m_shards[i];
+		ScopedLock sl(shard->m_mtx);
+		for ( UdpSlot *slot = shard->m_activeListHead; slot; slot = slot->m_activeListNext ) {
+			// ignore incoming
+			if ( ! slot->hasCallback() ) continue;
+			// check for ip match
+			if ( slot->getIp() != oldHost->m_ip &&
+			     slot->getIp() != oldHost->m_ipShotgun )
+				continue;
+			// check for port match
+			if ( this == &g_udpServer && slot->getPort() != oldHost->m_port )
+				continue;
 
-		char ipbuf[16];
-		logDebug(g_conf.m_logDebugUdp, "udp: replaceHost: Rehashing slot tid=%" PRId32" dst=%s:%" PRIu32" slot=%p",
-		         slot->getTransId(), iptoa(slot->getIp(),ipbuf), (uint32_t)slot->getPort(), slot);
-
-		// remove the bucket
-		m_ptrs [ i ] = NULL;
-		// rehash all buckets below
-		if ( ++i >= m_numBuckets ) i = 0;
-		// keep looping until we hit an empty slot
-		while ( m_ptrs[i] ) {
-			UdpSlot *ptr = m_ptrs[i];
-			m_ptrs[i] = NULL;
-			// re-hash it
-			addKey_unlocked(ptr->m_key, ptr);
-			if ( ++i >= m_numBuckets ) i = 0;		
+			char ipbuf[16];
+			logDebug(g_conf.m_logDebugUdp, "udp: replaceHost: Rehashing slot tid=%" PRId32" dst=%s:%" PRIu32" slot=%p",
+			         slot->getTransId(), iptoa(slot->getIp(),ipbuf), (uint32_t)slot->getPort(), slot);
+
+			// . match, replace the slot ip/port with the newHost
+			// . first remove the old hashed key for this slot. the
+			//   transId stays the same so it stays in this shard
+			removeKey_unlocked(shard, slot);
+
+			// careful with this! if we were using shotgun, use that
+			// otherwise We core in PingServer because the 
+			// m_inProgress[1-2] does net mesh
+			if ( slot->getIp() == oldHost->m_ip )
+				slot->m_ip = newHost->m_ip;
+			else
+				slot->m_ip = newHost->m_ipShotgun;
+
+			// replace the data in the slot
+			slot->m_port = newHost->m_port;
+
+			// . now readd the slot to the hash table
+			key96_t key = m_proto->makeKey ( slot->getIp(),
+						       slot->getPort(),
+						       slot->getTransId(),
+						       true/*weInitiated?*/);
+			addKey_unlocked(shard, key, slot);
+			slot->m_key = key;
+			slot->resetConnect();
+			// log it
+			log(LOG_INFO, "udp: Reset Slot For Replaced Host: tid=%" PRId32" msgType=%i",
+			    slot->getTransId(), (int)slot->getMsgType());
 		}
-
-		// careful with this! if we were using shotgun, use that
-		// otherwise We core in PingServer because the 
-		// m_inProgress[1-2] does net mesh
-		if ( slot->getIp() == oldHost->m_ip )
-			slot->m_ip = newHost->m_ip;
-		else
-			slot->m_ip = newHost->m_ipShotgun;
-
-		// replace the data in the slot
-		slot->m_port = newHost->m_port;
-
-		// . now readd the slot to the hash table
-		key96_t key = m_proto->makeKey ( slot->getIp(),
-					       slot->getPort(),
-					       slot->getTransId(),
-					       true/*weInitiated?*/);
-		addKey_unlocked(key, slot);
-		slot->m_key = key;
-		slot->resetConnect();
-		// log it
-		log(LOG_INFO, "udp: Reset Slot For Replaced Host: tid=%" PRId32" msgType=%i",
-		    slot->getTransId(), (int)slot->getMsgType());
 	}
 }
 
-
 int32_t UdpServer::getNumUsedSlots() const {
-	ScopedLock sl(m_mtx);
 	return m_numUsedSlots;
 }
 
 int32_t UdpServer::getNumUsedSlotsIncoming() const {
-	ScopedLock sl(m_mtx);
 	return m_numUsedSlotsIncoming;
 }
 
 void UdpServer::saveActiveSlots(int fd, msg_type_t msg_type) {
-	ScopedLock sl(m_mtx);
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		ScopedLock sl(m_shards[i].m_mtx);
 
-	for (const UdpSlot *slot = m_activeListHead; slot; slot = slot->m_activeListNext) {
-		// skip if not wanted msg type
-		if (slot->getMsgType() != msg_type) {
-			continue;
-		}
+		for (const UdpSlot *slot = m_shards[i].m_activeListHead; slot; slot = slot->m_activeListNext) {
+			// skip if not wanted msg type
+			if (slot->getMsgType() != msg_type) {
+				continue;
+			}
 
-		// skip if got reply
-		if (slot->m_readBuf) {
-			continue;
-		}
+			// skip if got reply
+			if (slot->m_readBuf) {
+				continue;
+			}
 
-		// shut up gcc warning: ignoring return value
+			// shut up gcc warning: ignoring return value
 
-		// write hostid sent to
-		int32_t hostId = slot->getHostId();
-		ssize_t ignored1 __attribute__((unused)) = write(fd, &hostId, 4);
+			// write hostid sent to
+			int32_t hostId = slot->getHostId();
+			ssize_t ignored1 __attribute__((unused)) = write(fd, &hostId, 4);
 
-		// write that
-		ssize_t ignored2 __attribute__((unused)) = write(fd, &slot->m_sendBufSize, 4);
+			// write that
+			ssize_t ignored2 __attribute__((unused)) = write(fd, &slot->m_sendBufSize, 4);
 
-		// then the buf data itself
-		ssize_t ignored3 __attribute__((unused)) = write(fd, slot->m_sendBuf, slot->m_sendBufSize);
+			// then the buf data itself
+			ssize_t ignored3 __attribute__((unused)) = write(fd, slot->m_sendBuf, slot->m_sendBufSize);
+		}
 	}
 }
 
 std::vector<UdpStatistic> UdpServer::getStatistics() const {
-	ScopedLock sl(m_mtx);
-
 	std::vector<UdpStatistic> statistics;
-	for (const UdpSlot *slot = m_activeListHead; slot; slot = slot->m_activeListNext) {
-		statistics.push_back(UdpStatistic(*slot));
+	for ( int32_t i = 0; i < m_numShards; i++ ) {
+		ScopedLock sl(m_shards[i].m_mtx);
+		for (const UdpSlot *slot = m_shards[i].m_activeListHead; slot; slot = slot->m_activeListNext) {
+			statistics.push_back(UdpStatistic(*slot));
+		}
 	}
 
 	return statistics;
@@ -32,6 +32,7 @@
 
 #include "UdpStatistic.h"
 #include "UdpProtocol.h"
+#include "UdpBatch.h"
 #include "GbMutex.h"
 #include <inttypes.h>
 #include <atomic>
@@ -41,6 +42,8 @@ static const int64_t udpserver_sendrequest_infinite_timeout = 999999999999;
 
 class UdpSlot;
 class Host;
+class UdpReceiveThread;
+class UdpShard;
 
 class UdpServer {
 public:
@@ -126,9 +129,20 @@ public:
 	// . handler MUST call sendReply() or sendErrorReply() no matter what
 	// . returns true if handler registered successfully
 	// . returns false on error
-	// . if you want the handler to be called while in an async signal
-	//   handler then set "isHandlerHot" to true
-	bool registerHandler ( msg_type_t msgType, void(* handler)(UdpSlot *,int32_t) );
+	// . if "threadSafe" is true and we run receive threads (see
+	//   Conf::m_udpReceiveThreads) the handler is called right from the
+	//   receive thread that read the request instead of from the main loop
+	// . such a handler must not touch main-thread-only state. it can hand
+	//   the rest of the work to the main loop with callHandlerFromMainLoop()
+	bool registerHandler ( msg_type_t msgType, void(* handler)(UdpSlot *,int32_t), bool threadSafe = false );
+
+	// . called by a thread-safe handler to have "handler" called for
+	//   "slot" from the main loop instead
+	// . caller must not touch "slot" after this returns
+	void callHandlerFromMainLoop(UdpSlot *slot, void (*handler)(UdpSlot *, int32_t));
+
+	// true if we are running in one of the receive threads
+	static bool isReceiveThread();
 
 	// . frees the m_readBuf and m_sendBuf
 	// . marks the slot as available
@@ -159,7 +173,7 @@ public:
 
 	bool needBottom() const { return m_needBottom; }
 
-	bool getWriteRegistered() const { return m_writeRegistered; }
+	bool getWriteRegistered() const { return m_writeRegistered.load(); }
 
 	bool hasHandler(int i) const { return (m_handlers[i]); }
 
@@ -171,16 +185,30 @@ public:
 	// . store a shutdown bit with it so we know if we crashed
 	// . on crashes add 1024 or so to the read value
 	// . TODO: make somewhat random cuz it's easy to spoof like it is now
-	int32_t m_nextTransId;
+	std::atomic<int32_t> m_nextTransId;
 
 	std::vector<UdpStatistic> getStatistics() const;
 
-	GbMutex& getLock() { return m_mtx; }
+	const UdpBatchStatistic& getBatchStatistic() const { return m_batchStats; }
+
+	// the lock of the shard holding the slots of transaction "transId"
+	GbMutex& getLock(int32_t transId);
 
 private:
 	static void readPollWrapper(int fd, void *state);
 	static void timePollWrapper(int fd, void *state);
 	static void sendPollWrapper(int fd, void *state);
+	static void callbackPollWrapper(int fd, void *state);
+
+	// . receive threads each read their own SO_REUSEPORT socket bound to
+	//   m_port. a reuseport bpf program steers a dgram to the socket of
+	//   transId % numThreads so a thread only uses its own shard. without
+	//   it the kernel hashes a peer's ip/port to one of them
+	// . m_sock is the socket of the first receive thread
+	bool startReceiveThreads(int32_t numThreads, const struct sockaddr_in &name, int32_t readBufSize);
+	void stopReceiveThreads();
+	static void *receiveThreadFunction(void *args);
+	void receiveLoop(UdpReceiveThread *thread);
 
 	// these *Poll() routines must be public so wrappers can call them
 
@@ -205,31 +233,50 @@ private:
 	//   or timed a slot out so it's callback should be called
 	bool readTimeoutPoll ( int64_t now ) ;
 
-	// available linked list functions (m_availableListHead)
-	void addToAvailableLinkedList_unlocked(UdpSlot *slot);
-	UdpSlot* removeFromAvailableLinkedList_unlocked();
+	// available linked list functions (m_availableListHead). these lock
+	// m_availableMtx themselves
+	void addToAvailableLinkedList(UdpSlot *slot);
+	UdpSlot* removeFromAvailableLinkedList();
 
-	// callback linked list functions (m_callbackListHead)
-	void addToCallbackLinkedList_unlocked(UdpSlot *slot);
-	bool isInCallbackLinkedList_unlocked(UdpSlot *slot);
-	void removeFromCallbackLinkedList_unlocked(UdpSlot *slot);
+	// callback linked list functions (UdpShard::m_callbackListHead)
+	void addToCallbackLinkedList_unlocked(UdpShard *shard, UdpSlot *slot);
+	bool isInCallbackLinkedList_unlocked(UdpShard *shard, UdpSlot *slot);
+	void removeFromCallbackLinkedList_unlocked(UdpShard *shard, UdpSlot *slot);
 
-	// active linkedlist functions (m_activeListHead)
-	void addToActiveLinkedList_unlocked(UdpSlot *slot);
-	void removeFromActiveLinkedList_unlocked(UdpSlot *slot);
+	// active linkedlist functions (UdpShard::m_activeListHead)
+	void addToActiveLinkedList_unlocked(UdpShard *shard, UdpSlot *slot);
+	void removeFromActiveLinkedList_unlocked(UdpShard *shard, UdpSlot *slot);
 
 	// . we maintain a sequential list of transaction ids to guarantee
 	//   uniquness to a point
 	// . if server is restarted this will go back to 0 though 
 	// . the key of a UdpSlot is based on this, the endpoint ip/port and
 	//   whether it's a request/reply by/from us
-	int32_t getTransId_unlocked();
+	int32_t getTransId();
 
-	void destroySlot_unlocked(UdpSlot *slot);
+	// the shard holding the slots of transaction "transId"
+	UdpShard *getShard(int32_t transId) const;
+	UdpShard *getShard(const UdpSlot *slot) const;
+
+	void destroySlot_unlocked(UdpShard *shard, UdpSlot *slot);
 
 	// . send as many dgrams as you can from slot's m_sendBuf
 	// . returns false and sets errno on error, true otherwise
-	bool doSending_unlocked(UdpSlot *slot, bool allowResends, int64_t now);
+	// . if flushBatch is false what we queued in the shard's m_sendBatch is
+	//   left for the caller to flush so ACKs for many slots go out in one
+	//   sendmmsg()
+	bool doSending_unlocked(UdpShard *shard, UdpSlot *slot, bool allowResends, int64_t now, bool flushBatch = true);
+
+	// . send what is queued in the shard's m_sendBatch
+	// . returns false if the socket blocked. m_needToSend is set and
+	//   sendPoll() will be called when we can write again
+	bool flushSendBatch_unlocked(UdpShard *shard);
+
+	// flush the send batches of all shards
+	void flushSendBatches();
+
+	// ask Loop to call sendPollWrapper() when m_sock is writable
+	bool registerWriteCallback();
 
 	// . calls a m_handler request handler if slot->m_callback is NULL
 	//   which means it was an incoming request
@@ -240,92 +287,100 @@ private:
 	// . picks the slot that is most caught up to it's ACKs
 	// . picks resends first, however
 	// . then we send a dgram from that slot
-	UdpSlot *getBestSlotToSend_unlocked(int64_t now);
+	UdpSlot *getBestSlotToSend_unlocked(UdpShard *shard, int64_t now);
 
 	// . reads a pending dgram on the udp stack
 	// . returns -1 on error, 0 if blocked, 1 if completed reading dgram
-	// . called by readPoll()
-	int32_t readSock(UdpSlot **slot, int64_t now);
+	// . called by process() or by a receive thread for its own socket
+	int32_t readSock(UdpSlot **slot, int64_t now, UdpReceiveThread *thread = NULL);
 
-	void sendReply_unlocked(char *msg, int32_t msgSize, char *alloc, int32_t allocSize, UdpSlot *slot, void *state = NULL,
-	                        void (*callback2)(void *state, UdpSlot *slot) = NULL);
+	void sendReply_unlocked(UdpShard *shard, char *msg, int32_t msgSize, char *alloc, int32_t allocSize, UdpSlot *slot,
+	                        void *state = NULL, void (*callback2)(void *state, UdpSlot *slot) = NULL);
 
-	void sendErrorReply_unlocked(UdpSlot *slot, int32_t errnum);
+	void sendErrorReply_unlocked(UdpShard *shard, UdpSlot *slot, int32_t errnum);
 
 	// . we have up to 1 handler routine for each msg type
 	// . call these handlers for the corresponding msgType
 	// . msgTypes go from 0 to 64 i think (see UdpProtocol.h dgram header)
 	void (* m_handlers[MAX_MSG_TYPES])(UdpSlot *slot, int32_t niceness);
+	bool m_threadSafeHandlers[MAX_MSG_TYPES];
 
-	mutable GbMutex m_mtx; //mutex protecting this instance.
+	// . the slots in use are split by transId over the shards, each with
+	//   its own lock, hash table, lists and send batch
+	// . lock order is shard, then m_availableMtx / m_writeMtx
+	UdpShard *m_shards;
+	int32_t m_numShards;
 
 	// when a call to sendto() blocks we set this to true so Loop.cpp
 	// will know to manually call sendPoll() rather than counting
 	// on receiving a fd-ready-for-writing signal for this UdpServer
-	bool m_needToSend;
+	std::atomic<bool> m_needToSend;
 
 	// our listening/sending udp socket and port
 	int m_sock;
 	uint16_t m_port;
 
+	// dgrams read with one recvmmsg() by the main thread. the dgrams/ACKs
+	// waiting for one sendmmsg() are in the shards
+	UdpRecvBatch m_recvBatch;
+	UdpBatchStatistic m_batchStats;
+
+	UdpReceiveThread *m_receiveThreads;
+	int32_t m_numReceiveThreads;
+	std::atomic<bool> m_stopReceiveThreads;
+
+	// receive threads wake up the main loop with this eventfd when there
+	// are callbacks/handlers for it to call
+	int m_callbackFd;
+
 	// for defining your own protocol on top of udp
 	UdpProtocol *m_proto;
 
-	bool m_isShuttingDown;
+	std::atomic<bool> m_isShuttingDown;
 
 	// did we have to give back control before we called all of the
 	bool m_needBottom;
 
-	bool m_writeRegistered;
+	// protects registering/unregistering the write callback
+	GbMutex m_writeMtx;
+	std::atomic<bool> m_writeRegistered;
 
 	// . how many requests are we handling at this momment
 	// . does not include requests whose replies we are sending, only
 	//   those whose replies have not yet been generated
 	// . starts counting as soon as first dgram of request is recvd
-	int32_t m_requestsInWaiting;
+	std::atomic<int32_t> m_requestsInWaiting;
 
 	// like m_requestsInWaiting but requests which spawn other requests
-	int32_t m_msg07sInWaiting;
-	int32_t m_msg25sInWaiting;
-	int32_t m_msg39sInWaiting;
-	int32_t m_msg20sInWaiting;
-	int32_t m_msg0csInWaiting;
-	int32_t m_msg0sInWaiting;
+	std::atomic<int32_t> m_msg07sInWaiting;
+	std::atomic<int32_t> m_msg25sInWaiting;
+	std::atomic<int32_t> m_msg39sInWaiting;
+	std::atomic<int32_t> m_msg20sInWaiting;
+	std::atomic<int32_t> m_msg0csInWaiting;
+	std::atomic<int32_t> m_msg0sInWaiting;
 
 	// but alloc MAX_UDP_SLOTS of these in init so we don't blow the stack
 	UdpSlot *m_slots;
 	int32_t m_maxSlots;
 
 	// routines
-	UdpSlot *getEmptyUdpSlot_unlocked(key96_t k, bool incoming);
-	void freeUdpSlot_unlocked(UdpSlot *slot);
+	UdpSlot *getEmptyUdpSlot_unlocked(UdpShard *shard, key96_t k, bool incoming);
+	void freeUdpSlot_unlocked(UdpShard *shard, UdpSlot *slot);
 
-	void addKey_unlocked(key96_t key, UdpSlot *ptr);
+	void addKey_unlocked(UdpShard *shard, key96_t key, UdpSlot *ptr);
 
 	// verified these are only called from within _ass routines that
 	// turn them interrupts off before calling this
-	UdpSlot *getUdpSlot_unlocked(key96_t k);
+	UdpSlot *getUdpSlot_unlocked(UdpShard *shard, key96_t k);
 
-	// . hash table for converting keys to slots
-	// . if m_ptrs[i] is NULL, ith bucket is empty
-	UdpSlot **m_ptrs;
-	int32_t m_numBuckets;
-	uint32_t m_bucketMask;
-	char *m_buf;     // memory to hold m_ptrs
-	int32_t m_bufSize;
+	// remove "slot" from the shard's hash table
+	void removeKey_unlocked(UdpShard *shard, UdpSlot *slot);
 
 	// linked list of available slots (uses UdpSlot::m_next)
+	GbMutex m_availableMtx;
 	UdpSlot *m_availableListHead;
 
-	// linked list of slots in use
-	UdpSlot *m_activeListHead;
-	UdpSlot *m_activeListTail;
-
-	// linked list of callback candidates
-	UdpSlot *m_callbackListHead;
-	UdpSlot *m_callbackListTail;
-
-	int32_t m_numUsedSlots;
+	std::atomic<int32_t> m_numUsedSlots;
 	std::atomic<int32_t> m_numUsedSlotsIncoming;
 
 
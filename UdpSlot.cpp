@@ -2,6 +2,7 @@
 
 #include "UdpSlot.h"
 #include "UdpServer.h"
+#include "UdpBatch.h"
 #include "Hostdb.h"
 #include "Stats.h"
 #include "Proxy.h"
@@ -67,6 +68,11 @@ int32_t g_cancelAcksRead = 0;
 // try to fix a bunch of msg99 replies coming into host 0 at once
 #define RESEND_1_LOCAL 100
 
+// . lowest resend time when it is computed from the rtt of the host
+// . intra-cluster rtts are well below a ms, but we only check for resends
+//   every 20ms and the receiver may be busy for a while before it acks
+#define RESEND_MIN_RTT 40
+
 
 // . the ack window is back and bigger, now 100 dgrams
 // . this gives the receives a chance to respond to being blasted
@@ -178,6 +184,8 @@ void UdpSlot::resetConnect ( ) {
 	m_nextToSend = 0;
 	m_firstUnlitSentAckBit = 0;
 	m_numBitsInitialized = 0;
+	m_rttSendTime = 0;
+	m_firstUnsentDgram = 0;
 
 	// . set m_dgramsToSend
 	// . similar to UdpProtocol::getNumDgrams(char *dgram,int32_t dgramSize)
@@ -373,6 +381,8 @@ void UdpSlot::prepareForResend ( int64_t now , bool resendAll ) {
 	// . tally the count
 	// . need to increment since won't resend to eth1 unless this is 2
 	m_resendCount++; 
+	// Karn's rule: an ack for the timed dgram could be for either send
+	m_rttSendTime = 0;
 	// debug msg
 	if ( g_conf.m_logDebugUdp || (g_conf.m_logDebugDns && !m_proto->useAcks()) ) {
 		char ipbuf[16];
@@ -406,11 +416,24 @@ void UdpSlot::prepareForResend ( int64_t now , bool resendAll ) {
 	Host *h = m_host;
 	if ( ! h && m_hostId >= 0 ) h = g_hostdb.getHost ( m_hostId );
 	if ( h                    ) h->m_totalResends += cleared;
+	// the resend timer went off, so shrink the window to this host
+	UdpCongestion *congestion = getCongestion();
+	if ( congestion ) congestion->onLoss ( now );
 	// . set the resend time based on m_resendCount and m_niceness
 	// . this typically doubles m_resendTime with each resendCount
 	setResendTime ();
 }
 
+UdpCongestion *UdpSlot::getCongestion() const {
+	// loopback sends keep their big fixed window, and dns and hosts
+	// outside the cluster have no Host to keep the state in
+	if ( ! g_conf.m_udpCongestionControl || ! m_host || ! m_proto->useAcks() ||
+	     ip_distance(m_ip) == ip_distance_ourselves ) {
+		return NULL;
+	}
+	return &m_host->m_udpCongestion;
+}
+
 void UdpSlot::setResendTime() {
 	// otherwise, calculate how much time since our last send
 	int32_t max ;
@@ -439,6 +462,24 @@ void UdpSlot::setResendTime() {
 		return;
 	}
 
+	// . if we have rtt samples for the host use srtt + 4*rttvar as the
+	//   starting point and double it with each resend
+	// . the niceness max still applies
+	const UdpCongestion *congestion = getCongestion();
+	int32_t rto = congestion ? congestion->getResendTimeout(RESEND_MIN_RTT, max) : -1;
+	if ( rto > 0 ) {
+		// watch out for overflow
+		int64_t resendTime = max;
+		if ( m_resendCount < 16 ) resendTime = (int64_t)rto << m_resendCount;
+		if ( resendTime > max ) resendTime = max;
+		m_resendTime = (int32_t)resendTime;
+		//try to prevent everyone from synching up on 
+		//a bogged down host when spidering.
+		if ( m_niceness > 0 && m_resendTime > 0 ) m_resendTime += rand() % m_resendTime;
+		if ( m_resendTime > max ) m_resendTime = max;
+		return;
+	}
+
 	// is it a local ip?
 	bool isLocal = ip_distance(m_ip)<=ip_distance_nearby;
 	// . keep our resend times up-to-date
@@ -485,17 +526,16 @@ void UdpSlot::setResendTime() {
 // . returns values:
 // . -2 if nothing to send
 // . -1 on error, 
-// .  0 if blocked, 
-// .  1 if completed sending a datagram/ACK
+// .  1 if queued a datagram/ACK in "batch"
 // . sets g_errno on error
 // . this is only called by UdpServer::doSending()
 // . we try to do ALL the reading before calling this so we can send
 //   many ACKs back in one packet
-int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
+int32_t UdpSlot::sendDatagramOrAck ( UdpSendBatch *batch, bool allowResends, int64_t now ){
 	//log("sendDatagramOrAck");
 	// if acks we've sent isn't caught up to what we read, send an ack
 	if ( m_sentAckBitsOn < m_readBitsOn && m_proto->useAcks() ) 
-		return sendPlainAck ( sock , now );
+		return sendPlainAck ( batch , now );
 	// we may have received an ack for an implied resend (from ack gap)
 	// so we clear some bits, but then got an ACK back later
 	while ( m_nextToSend < m_dgramsToSend &&
@@ -523,10 +563,9 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	int32_t dgramNum = m_nextToSend;
 
 	// . store dgram #dgramNum from this send buf into "dgram"
-	// . let the protocol set the dgram from the m_sendBuf for us
-	char buf [ DGRAM_SIZE_CEILING ];
-	// should hold all headers
-	char saved [ 32 ];
+	// . let the protocol set the header for us. the batch copies it and
+	//   sends the data straight out of m_sendBuf
+	char header [ 32 ];
 	// the header size
 	int32_t headerSize = m_proto->getHeaderSize(0);
 	// bitch if too big
@@ -539,7 +578,7 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	// offset into send buffer, the data to send
 	int32_t offset = dgramNum * ( m_maxDgramSize - headerSize );
 	// what should we send, and how much?
-	char *send      = m_sendBuf     + offset;
+	const char *send      = m_sendBuf     + offset;
 	int32_t  sendSize  = m_sendBufSize - offset;
 #ifdef _VALGRIND_
 	VALGRIND_CHECK_MEM_IS_DEFINED(send,sendSize);
@@ -547,26 +586,13 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	// truncate to max size of dgram we're allowed
 	if ( sendSize > m_maxDgramSize - headerSize ) 
 		sendSize = m_maxDgramSize - headerSize;
-	// where to store the dgram, header and data, assume "buf"
-	char *dgram = buf;
 	// size of dgram, header and data
 	int32_t  dgramSize = headerSize + sendSize;
-	// if we're NOT the 1st dgram we can store into send buf directly
-	if ( dgramNum != 0 ) {
-		// where to store the header? right into send buf
-		dgram = send - headerSize;
-		// but save before overwriting
-		gbmemcpy ( saved , dgram , headerSize );
-	}
-	// store header into "dgram"
-	m_proto->setHeader(dgram, m_sendBufSize, m_msgType, dgramNum, m_transId, m_callback, m_localErrno, m_niceness);
+	// store header into "header"
+	m_proto->setHeader(header, m_sendBufSize, m_msgType, dgramNum, m_transId, m_callback, m_localErrno, m_niceness);
 #ifdef _VALGRIND_
-	VALGRIND_CHECK_MEM_IS_DEFINED(dgram,headerSize);
+	VALGRIND_CHECK_MEM_IS_DEFINED(header,headerSize);
 #endif
-	// . if we're the first dgram, we can't back up for the header...
-	// . copy data into dgram if we're the 1st dgram
-	if ( dgramNum == 0 )
-		gbmemcpy ( dgram + headerSize , send , sendSize );
 
 	// if we are the proxy sending a udp packet to our flock, then make
 	// sure that we send to tmp cluster if we should
@@ -609,54 +635,12 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 		g_udpServer.m_outsiderBytesOut   += dgramSize;
 	}
 
-	// . this socket should be non-blocking (i.e. return immediately)
-	// . this should set g_errno on error!
-	// MSG_DONTROUTE makes dns fail
-	int bytesSent = sendto(sock, dgram, dgramSize, 0, (struct sockaddr *) (void *) &to, sizeof(to));
-
-	// restore what we overwrote
-	if ( dgramNum != 0 ) {
-		gbmemcpy ( dgram , saved , headerSize );
-	}
+	// . queue it. UdpServer sends the whole batch with one sendmmsg()
+	// . if the socket buffer is full the batch calls unsendDatagram() and
+	//   we send it again when the socket is writable
+	batch->add(this, dgramNum, false, to, header, headerSize, send, sendSize);
+	int32_t bytesSent = dgramSize;
 
-	// return -1 on error or 0 if blocked
-	if ( bytesSent < 0 ) {
-		// copy errno to g_errno
-		g_errno = errno;
-		if ( g_errno == EAGAIN  ) { g_errno = 0; return 0;}
-		// not in linux
-		// . "output queue for a network interface was full"
-		// . however, linux just silently drops packets!!!!!!!
-		// . i think using more than 1GB in this process brings this
-		//   problem up, the kernel's kmalloc fails...
-		if ( g_errno == ENOBUFS ) { 
-			// log it once every 3 seconds so they know
-			static int32_t s_lastTime = 0;
-			static int32_t s_count    = 0;
-			int32_t t = getTime();
-			if ( t - s_lastTime > 3 ||
-			     s_lastTime - t > 3   ) { // clock skew?
-				s_lastTime = getTime();
-				log(LOG_WARN, "udp: got ENOBUFS kernel bug %" PRId32" times.", ++s_count);
-			}
-			//g_errno = 0; 
-			//return 0;
-			return -1;
-		} 
-		// log the error
-		log(LOG_WARN, "udp: Call to sendto had error (ignoring): %s.", mstrerror(g_errno)) ;
-		// . now immediately switch the eth port to see if that helps!
-		// . actually, just pretend we sent it. we won't get an ack
-		//   and the resend algo will switch ports
-		//return -1;
-		bytesSent = dgramSize;
-	}
-	// this should not happen
-	if ( bytesSent != dgramSize ) {
-		g_errno = EBADENGINEER;
-		log(LOG_WARN, "udp: sendto only sent %i bytes, not %" PRId32". Undersend.", bytesSent,dgramSize);
-		return -1;
-	}
 	// general count
 	if ( m_niceness == 0 ) g_stats.m_packetsOut[m_msgType][0]++;
 	else                   g_stats.m_packetsOut[m_msgType][1]++;
@@ -673,6 +657,15 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	setBit ( dgramNum , m_sentBits2 );
 	// count the bit we lit
 	m_sentBitsOn++;
+	// . time this dgram for the rtt estimate if it is the first send of it
+	//   and we aren't timing another one already
+	if ( dgramNum >= m_firstUnsentDgram ) {
+		m_firstUnsentDgram = dgramNum + 1;
+		if ( m_rttSendTime == 0 && getCongestion() ) {
+			m_rttSendTime = gettimeofdayInMicroseconds();
+			m_rttDgram    = dgramNum;
+		}
+	}
 	// update last send time stamp even if we're a resend
 	m_lastSendTime = now;
 	// update m_nextToSend
@@ -739,6 +732,27 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	return 1;
 }
 
+// . the batch could not send this dgram, so send it again later
+// . m_firstSendTime and the stats were updated when it was queued, that's ok
+void UdpSlot::unsendDatagram ( int32_t dgramNum ) {
+	if ( dgramNum < 0 || dgramNum >= m_dgramsToSend ) return;
+	if ( ! isOn ( dgramNum , m_sentBits2 ) ) return;
+	clrBit ( dgramNum , m_sentBits2 );
+	m_sentBitsOn--;
+	if ( dgramNum < m_nextToSend ) m_nextToSend = dgramNum;
+	// it never went out, so don't time it
+	if ( dgramNum == m_rttDgram ) m_rttSendTime = 0;
+}
+
+// . the batch could not send this ACK, so send it again later
+void UdpSlot::unsendAck ( int32_t dgramNum ) {
+	if ( dgramNum < 0 || dgramNum >= m_dgramsToRead ) return;
+	if ( ! isOn ( dgramNum , m_sentAckBits2 ) ) return;
+	clrBit ( dgramNum , m_sentAckBits2 );
+	m_sentAckBitsOn--;
+	if ( dgramNum < m_firstUnlitSentAckBit ) m_firstUnlitSentAckBit = dgramNum;
+}
+
 // assume m_readBits2, m_sendBits2, m_sentAckBits2 and m_readAckBits2 are 
 // correct and update m_firstUnlitSentAckBit, m_sentAckBitsOn, m_readBitsOn,
 // m_readAckBitsOn and m_sentBitsOn
@@ -800,14 +814,13 @@ void UdpSlot::fixSlot ( ) {
 // . returns values:
 // . -2 if nothing to send
 // . -1 on error, 
-// .  0 if blocked, 
-// .  1 if completed sending a datagram/ACK
+// .  1 if queued the ACK in "batch"
 // . if we Initiated is the default -2, then we use m_callback to determine
 //   if we initiated the transaction or not
 // . if m_callback is NULL we did NOT intiate the transaction
 // . we should only be called if m_sentAckBitsOn < m_readBitsOn, i.e.
 //   when we're not caught up with ACKing with what we've read
-int32_t UdpSlot::sendAck ( int sock , int64_t now , 
+int32_t UdpSlot::sendAck ( UdpSendBatch *batch , int64_t now , 
 			int32_t dgramNum , int32_t weInitiated ,
 			bool cancelTrans ) {
 	// protection from garbled dgrams
@@ -885,31 +898,9 @@ int32_t UdpSlot::sendAck ( int sock , int64_t now ,
 
 	// stat count
 	if ( cancelTrans ) g_cancelAcksSent++;
-	// . this socket should be non-blocking (i.e. return immediately)
-	// . this should set g_errno on error
-	int bytesSent = sendto ( sock      , 
-				 dgram     ,
-				 dgramSize ,
-				 0         ,
-				 (struct sockaddr *)(void*)&to , 
-				 sizeof ( to ) );
-	// return -1 on error, 0 if blocked
-	if ( bytesSent < 0 ) {
-		// copy errno to g_errno
-		g_errno = errno;
-		if ( g_errno == EAGAIN  ) { g_errno = 0; return 0; }
-		if ( g_errno == ENOBUFS ) { g_errno = 0; return 0; }
-		log("udp: error sending ack: %s",mstrerror(g_errno));
-		return -1;
-	}
-	// this should not happen
-	if ( bytesSent != dgramSize ) {
-		g_errno = EBADENGINEER;
-		log("udp: sendto only sent %i bytes, not %" PRId32". Undersend.",
-		    bytesSent,dgramSize);
-		//sleep(50000);
-		return -1;
-	}
+	// . queue it. UdpServer sends the whole batch with one sendmmsg()
+	// . a cancel ACK is sent from a temporary slot so nobody can resend it
+	batch->add(cancelTrans ? NULL : this, dgramNum, true, to, dgram, dgramSize, NULL, 0);
 	// general count
 	if ( m_niceness == 0 ) g_stats.m_packetsOut[m_msgType][0]++;
 	else                   g_stats.m_packetsOut[m_msgType][1]++;
@@ -1018,6 +1009,10 @@ bool UdpSlot::readDatagramOrAck ( const void *readBuffer_,
 		    (uint32_t)m_sendBufSize);
 		// stat count
 		g_cancelAcksRead++;
+		// let the handler know the requester gave up on it
+		if ( isIncoming() ) {
+			__atomic_store_n(&m_requesterCancelled, true, __ATOMIC_RELAXED);
+		}
 		// what happens is that if we are handling a request and we
 		// try to send back the reply on this slot, it will have been
 		// destroyed by a call to makeCallbacks(). but really the
@@ -1220,7 +1215,7 @@ bool UdpSlot::readDatagramOrAck ( const void *readBuffer_,
 	
 	// message size shouldn't change
 	if (msgSize > m_readBufMaxSize) {
-		g_udpServer.getLock().unlock();
+		g_udpServer.getLock(m_transId).unlock();
 		gbshutdownLogicError();
 	}
 
@@ -1306,6 +1301,15 @@ void UdpSlot::readAck ( int32_t dgramNum, int64_t now ) {
 	setBit ( dgramNum , m_readAckBits2 );
 	// update lit bit count
 	m_readAckBitsOn++;
+	// . update the rtt estimate and grow the congestion window
+	UdpCongestion *congestion = getCongestion();
+	if ( congestion ) {
+		if ( m_rttSendTime != 0 && dgramNum == m_rttDgram ) {
+			congestion->addRttSample ( (int32_t)(gettimeofdayInMicroseconds() - m_rttSendTime) );
+			m_rttSendTime = 0;
+		}
+		congestion->onAck();
+	}
 	// if it was marked as unsent, fix that
 	if ( ! isOn ( dgramNum , m_sentBits2 ) ) {
 		// bitch if we do not even have a send buffer. why is he acking
@@ -1324,6 +1328,7 @@ void UdpSlot::readAck ( int32_t dgramNum, int64_t now ) {
 	// . we detect this gap and automatically re-send the dgrams w/o delay
 	// . if our right neighbor read ack bit is off then mark all off bits 
 	//   on our right as having sent bits of 0, until we hit a lit ack bit
+	int32_t cleared = 0;
 	for ( int32_t i = dgramNum - 1 ; i >= 0 ; i-- ) {
 		// stop after hitting a lit bit
 		if ( isOn ( i , m_readAckBits2 ) ) break;
@@ -1335,7 +1340,12 @@ void UdpSlot::readAck ( int32_t dgramNum, int64_t now ) {
 		m_sentBitsOn--;
 		// update m_nextToSend
 		if ( i < m_nextToSend ) m_nextToSend = i;
+		// Karn's rule, see prepareForResend()
+		if ( i == m_rttDgram ) m_rttSendTime = 0;
+		cleared++;
 	}
+	// a gap in the acks is a loss as well
+	if ( cleared > 0 && congestion ) congestion->onLoss ( now );
 
 	// if the reply or request was fully acknowledged by the receiver
 	// then record some statistics
@@ -1476,7 +1486,14 @@ int32_t UdpSlot::getScore ( int64_t now ) const {
 
 	// . let's use a window now, give acks a chance to catch up somewhat
 	// . if send is local, use a larger ack window of ?64? dgrams
-	if ( ip_distance(m_ip)!=ip_distance_ourselves &&
+	// . with congestion control the window and pacing come from the host
+	const UdpCongestion *congestion = getCongestion();
+	if ( congestion ) {
+		int32_t inFlight = m_sentBitsOn - m_readAckBitsOn;
+		if ( inFlight >= congestion->getWindow() ) return -1;
+		// spread the window over a round trip
+		if ( inFlight > 0 && now - m_lastSendTime < congestion->getPacingInterval() ) return -1;
+	} else if ( ip_distance(m_ip)!=ip_distance_ourselves &&
 	     m_sentBitsOn >= m_readAckBitsOn + ACK_WINDOW_SIZE    ) return -1;
 	// well, give a window size of 100 to loopbacks
 	if ( ip_distance(m_ip)==ip_distance_ourselves &&
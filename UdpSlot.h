@@ -57,10 +57,13 @@
 #define SHORTSENDBUFFERSIZE (250)
 
 class Host;
+class UdpSendBatch;
+class UdpCongestion;
 
 class UdpSlot {
 	// this will help to hide more of UdpSlot implementation from the rest of the codebase
 	friend class UdpServer;
+	friend class UdpSendBatch;
 
 public:
 	int32_t getNumDgramsRead() const { return m_readBitsOn; }
@@ -100,6 +103,13 @@ public:
 	bool hasCalledHandler() const { return m_calledHandler; }
 	bool hasCalledCallback() const { return m_calledCallback; }
 
+	// . the requester sent a cancel ack for a request we are handling, so
+	//   nobody is waiting for the reply anymore. it sends one when it
+	//   destroys its slot before it got our reply, see
+	//   UdpServer::destroySlot()
+	// . may be polled by the handler from another thread
+	bool isRequesterCancelled() const { return __atomic_load_n(&m_requesterCancelled, __ATOMIC_RELAXED); }
+
 	bool isIncoming() const { return (m_slotStatus == slot_status_incoming); }
 	bool isOutgoing() const { return (m_slotStatus == slot_status_outgoing); }
 
@@ -139,10 +149,16 @@ protected: //actually private but UdpServer references it.
 	bool sendSetup(char *msg, int32_t msgSize, char *alloc, int32_t allocSize, msg_type_t msgType, int64_t now,
 	               void *state, void (*callback)(void *state, class UdpSlot *), int32_t niceness, const char* extraInfo = NULL);
 
-	// . send a datagram from this slot on "sock" (call after sendSetup())
-	// . returns -2 if nothing to send, -1 on error, 0 if blocked, 
-	//   1 if sent something
-	int32_t sendDatagramOrAck(int sock, bool allowResends, int64_t now);
+	// . queue a datagram or ACK from this slot in "batch" (call after
+	//   sendSetup())
+	// . returns -2 if nothing to send, -1 on error, 1 if queued something
+	int32_t sendDatagramOrAck(UdpSendBatch *batch, bool allowResends, int64_t now);
+
+	// . called by UdpSendBatch::flush() for a dgram or ACK it could not
+	//   send because the socket buffer was full
+	// . marks it as unsent so sendDatagramOrAck() picks it up again
+	void unsendDatagram(int32_t dgramNum);
+	void unsendAck(int32_t dgramNum);
 
 	// . returns false and sets errno on error, true otherwise
 	// . tries to send ACK on "sock" if we read a dgram
@@ -243,6 +259,10 @@ protected: //actually private but UdpServer references it.
 	bool m_calledHandler;
 	bool m_calledCallback;
 
+	// handler to call from the main loop instead of the registered one.
+	// see UdpServer::callHandlerFromMainLoop()
+	void (*m_mainLoopHandler)(UdpSlot *slot, int32_t niceness);
+
 	// and for doubly linked list of callback candidates
 	UdpSlot *m_callbackListNext;
 	UdpSlot *m_callbackListPrev;
@@ -254,16 +274,15 @@ protected: //actually private but UdpServer references it.
 
 private:
 	// . send an ACK
-	// . returns -2 if nothing to send, -1 on error, 0 if blocked,
-	//   1 if sent something
+	// . returns -2 if nothing to send, -1 on error, 1 if queued something
 	// . should only be called by sendDatagramOrAck() above
-	int32_t sendPlainAck(int sock, int64_t now) {
-		return sendAck(sock, now, -1, -2, false);
+	int32_t sendPlainAck(UdpSendBatch *batch, int64_t now) {
+		return sendAck(batch, now, -1, -2, false);
 	}
-	int32_t sendCancelAck(int sock, int64_t now, int32_t dgramNum) {
-		return sendAck(sock, now, dgramNum, 1, true);
+	int32_t sendCancelAck(UdpSendBatch *batch, int64_t now, int32_t dgramNum) {
+		return sendAck(batch, now, dgramNum, 1, true);
 	}
-	int32_t sendAck(int sock, int64_t now, int32_t dgramNum, int32_t weInitiated, bool cancelTrans);
+	int32_t sendAck(UdpSendBatch *batch, int64_t now, int32_t dgramNum, int32_t weInitiated, bool cancelTrans);
 
 	// . or by readDataGramOrAck() to read a faked ack for protocols that
 	//   don't use ACKs
@@ -272,6 +291,10 @@ private:
 	// reset/set m_resendTime based on m_resendCount
 	void setResendTime();
 
+	// congestion state of m_host, NULL if not doing congestion control
+	// for this slot
+	UdpCongestion *getCongestion() const;
+
 	// . returns false and sets errno on error
 	// . like sendSetup() but setting up for reading
 	// . called when an incoming request arrives
@@ -392,6 +415,16 @@ private:
 	// these are for measuring bps (bandwidth) for g_stats
 	int64_t m_firstSendTime;
 
+	// . one dgram at a time is timed for the rtt estimate of m_host
+	// . m_rttSendTime is in microseconds, 0 if no dgram is being timed
+	// . dgrams below m_firstUnsentDgram were sent before, so acks for them
+	//   could be for an earlier send (Karn's rule)
+	int64_t m_rttSendTime;
+	int32_t m_rttDgram;
+	int32_t m_firstUnsentDgram;
+
+	bool m_requesterCancelled;
+
 	// now caller can decide initial backoff, doubles each time no ack rcvd
 	int16_t m_backoff;
 
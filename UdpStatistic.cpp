@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <inttypes.h>
 #include "UdpStatistic.h"
 #include "UdpSlot.h"
 #include "Msg13.h"
@@ -90,3 +91,68 @@ UdpStatistic::UdpStatistic(const UdpSlot &slot)
 	}
 }
 
+
+static const char * const s_bucketNames[UdpBatchStatistic::s_numBuckets] = {
+	"1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+"
+};
+
+UdpBatchStatistic::UdpBatchStatistic() {
+	reset();
+}
+
+void UdpBatchStatistic::reset() {
+	m_numRecvCalls = 0;
+	m_numRecvDgrams = 0;
+	m_numSendCalls = 0;
+	m_numSendDgrams = 0;
+	m_numSendBlocked = 0;
+	for (int32_t i = 0; i < s_numBuckets; i++) {
+		m_recvBuckets[i] = 0;
+		m_sendBuckets[i] = 0;
+	}
+}
+
+int32_t UdpBatchStatistic::getBucket(int32_t numDgrams) {
+	int32_t bucket = 0;
+	while (numDgrams > 1 && bucket < s_numBuckets - 1) {
+		numDgrams >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void UdpBatchStatistic::addRecvBatch(int32_t numDgrams) {
+	m_numRecvCalls++;
+	m_numRecvDgrams += numDgrams;
+	m_recvBuckets[getBucket(numDgrams)]++;
+}
+
+void UdpBatchStatistic::addSendBatch(int32_t numDgrams) {
+	m_numSendCalls++;
+	m_numSendDgrams += numDgrams;
+	m_sendBuckets[getBucket(numDgrams)]++;
+}
+
+void UdpBatchStatistic::printHistogram(const std::atomic<int64_t> *buckets, char *buf, int32_t bufSize) {
+	if (bufSize <= 0) {
+		return;
+	}
+
+	buf[0] = '\0';
+	int32_t pos = 0;
+	for (int32_t i = 0; i < s_numBuckets && pos < bufSize; i++) {
+		int n = snprintf(buf + pos, bufSize - pos, "%s%s:%" PRId64, i ? " " : "", s_bucketNames[i], buckets[i].load());
+		if (n < 0) {
+			break;
+		}
+		pos += n;
+	}
+}
+
+void UdpBatchStatistic::printRecvHistogram(char *buf, int32_t bufSize) const {
+	printHistogram(m_recvBuckets, buf, bufSize);
+}
+
+void UdpBatchStatistic::printSendHistogram(char *buf, int32_t bufSize) const {
+	printHistogram(m_sendBuckets, buf, bufSize);
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <atomic>
 #include "msgtype_t.h"
 
 class UdpSlot;
@@ -73,4 +74,45 @@ private:
 	char m_extraInfo[64];
 };
 
+// counters for UdpServer's batched recvmmsg()/sendmmsg() calls
+class UdpBatchStatistic {
+public:
+	// batch size buckets: 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64+
+	static const int32_t s_numBuckets = 7;
+
+	UdpBatchStatistic();
+
+	void reset();
+
+	// called after each recvmmsg()/sendmmsg() that moved dgrams
+	void addRecvBatch(int32_t numDgrams);
+	void addSendBatch(int32_t numDgrams);
+
+	// a sendmmsg() that could not send anything because the socket
+	// buffer was full
+	void addSendBlocked() { m_numSendBlocked++; }
+
+	int64_t getNumRecvCalls() const { return m_numRecvCalls; }
+	int64_t getNumRecvDgrams() const { return m_numRecvDgrams; }
+	int64_t getNumSendCalls() const { return m_numSendCalls; }
+	int64_t getNumSendDgrams() const { return m_numSendDgrams; }
+	int64_t getNumSendBlocked() const { return m_numSendBlocked; }
+
+	// prints "1:n 2-3:n ..." into buf
+	void printRecvHistogram(char *buf, int32_t bufSize) const;
+	void printSendHistogram(char *buf, int32_t bufSize) const;
+
+private:
+	static int32_t getBucket(int32_t numDgrams);
+	static void printHistogram(const std::atomic<int64_t> *buckets, char *buf, int32_t bufSize);
+
+	std::atomic<int64_t> m_numRecvCalls;
+	std::atomic<int64_t> m_numRecvDgrams;
+	std::atomic<int64_t> m_numSendCalls;
+	std::atomic<int64_t> m_numSendDgrams;
+	std::atomic<int64_t> m_numSendBlocked;
+	std::atomic<int64_t> m_recvBuckets[s_numBuckets];
+	std::atomic<int64_t> m_sendBuckets[s_numBuckets];
+};
+
 #endif // GB_UDPSTATISTIC_H
@@ -0,0 +1,245 @@
+#include "gb-include.h"
+
+#include "UrlFilterProgram.h"
+#include "SafeBuf.h"
+
+
+// the boolean expressions in the order getUrlFilterNum() used to check them.
+// they are prefix matches, so "isnewrequest" has to come before "isnew"
+static const struct {
+	const char *m_name;
+	int32_t m_len;
+	UrlFilterOpType m_type;
+} s_booleans[] = {
+	{ "hasauthorityinlink" , 18 , UFOP_HASAUTHORITYINLINK },
+	{ "hasreply"           ,  8 , UFOP_HASREPLY },
+	{ "hastmperror"        , 11 , UFOP_HASTMPERROR },
+	{ "isinjected"         , 10 , UFOP_ISINJECTED },
+	{ "isdocidbased"       , 12 , UFOP_ISDOCIDBASED },
+	{ "isreindex"          ,  9 , UFOP_ISREINDEX },
+	{ "insitelist"         , 10 , UFOP_INSITELIST },
+	{ "isaddurl"           ,  8 , UFOP_ISADDURL },
+	{ "ismanualadd"        , 11 , UFOP_ISMANUALADD },
+	{ "isroot"             ,  6 , UFOP_ISROOT },
+	{ "isindexed"          ,  9 , UFOP_ISINDEXED },
+	{ "ispingserver"       , 12 , UFOP_ISPINGSERVER },
+	{ "isfakeip"           ,  8 , UFOP_ISFAKEIP },
+	// this also catches "isrssext"
+	{ "isrss"              ,  5 , UFOP_ISRSS },
+	// this also catches "ispermalinkformat"
+	{ "ispermalink"        , 11 , UFOP_ISPERMALINK },
+	{ "isnewrequest"       , 12 , UFOP_ISNEWREQUEST },
+	{ "isnew"              ,  5 , UFOP_ISNEW },
+	{ "iswww"              ,  5 , UFOP_ISWWW }
+};
+
+// the comparisons, in the order getUrlFilterNum() used to check them
+static const struct {
+	const char *m_name;
+	int32_t m_len;
+	UrlFilterOpType m_type;
+} s_comparisons[] = {
+	{ "sitepages"            ,  9 , UFOP_SITEPAGES },
+	{ "tld"                  ,  3 , UFOP_TLD },
+	{ "lang"                 ,  4 , UFOP_LANG },
+	{ "hopcount"             ,  8 , UFOP_HOPCOUNT },
+	{ "urlage"               ,  6 , UFOP_URLAGE },
+	{ "errorcount"           , 10 , UFOP_ERRORCOUNT },
+	{ "errorcode"            ,  9 , UFOP_ERRORCODE },
+	{ "numinlinks"           , 10 , UFOP_NUMINLINKS },
+	{ "sitenuminlinks"       , 14 , UFOP_SITENUMINLINKS },
+	{ "spiderwaited"         , 12 , UFOP_SPIDERWAITED },
+	{ "percentchangedperday" , 20 , UFOP_PERCENTCHANGEDPERDAY },
+	{ "httpstatus"           , 10 , UFOP_HTTPSTATUS },
+	// this also catches "agent" or whatever starts with "age"
+	{ "age"                  ,  3 , UFOP_AGE }
+};
+
+
+UrlFilterOp::UrlFilterOp()
+	: m_type(UFOP_FAIL)
+	, m_negate(false)
+	, m_sign(0)
+	, m_intArg(0)
+	, m_floatArg(0.0)
+	, m_str()
+	, m_items()
+	, m_next(-1) {
+}
+
+
+UrlFilterProgram::UrlFilterProgram()
+	: m_ops()
+	, m_firstOps()
+	, m_hits(NULL)
+	, m_numHits(0) {
+}
+
+UrlFilterProgram::~UrlFilterProgram() {
+	delete [] m_hits;
+}
+
+void UrlFilterProgram::compile ( const SafeBuf *rules , int32_t numRules ) {
+	m_ops.clear();
+	m_firstOps.clear();
+
+	delete [] m_hits;
+	m_hits = new std::atomic<int64_t>[numRules];
+	m_numHits = numRules;
+	for ( int32_t i = 0 ; i < m_numHits ; i++ ) {
+		m_hits[i].store ( 0 , std::memory_order_relaxed );
+	}
+
+	for ( int32_t i = 0 ; i < numRules ; i++ ) {
+		const char *rule = rules[i].getBufStart();
+		if ( ! rule ) rule = "";
+		// the op of the expression at each offset in the rule, so the
+		// items of "tld==com,org && isroot" share the "isroot" op
+		std::vector<int32_t> opAtOffset ( strlen ( rule ) + 1 , -1 );
+		m_firstOps.push_back ( compileExpression ( rule , rule , &opAtOffset ) );
+	}
+}
+
+// the op of the expression after the next "&&" from "p", or -1 if there is
+// none and the rule matches
+int32_t UrlFilterProgram::getNext ( const char *rule , const char *p , std::vector<int32_t> *opAtOffset ) {
+	p = strstr ( p , "&&" );
+	if ( ! p ) return -1;
+	return compileExpression ( rule , p + 2 , opAtOffset );
+}
+
+// . compile the expression at "p" and the ones after it in "rule"
+// . returns the number of its op
+int32_t UrlFilterProgram::compileExpression ( const char *rule , const char *p , std::vector<int32_t> *opAtOffset ) {
+	int32_t offset = p - rule;
+	if ( (*opAtOffset)[offset] >= 0 ) return (*opAtOffset)[offset];
+
+	int32_t n = (int32_t)m_ops.size();
+	m_ops.push_back ( UrlFilterOp() );
+	(*opAtOffset)[offset] = n;
+
+	// skip leading whitespace
+	while ( *p && isspace(*p) ) p++;
+
+	// do we have a leading '!'
+	bool val = false;
+	if ( *p == '!' ) { val = true; p++; }
+	// skip whitespace after the '!'
+	while ( *p && isspace(*p) ) p++;
+
+	m_ops[n].m_negate = val;
+
+	for ( size_t k = 0 ; k < sizeof(s_booleans)/sizeof(s_booleans[0]) ; k++ ) {
+		if ( strncmp ( p , s_booleans[k].m_name , s_booleans[k].m_len ) != 0 ) continue;
+		m_ops[n].m_type = s_booleans[k].m_type;
+		int32_t next = getNext ( rule , p + s_booleans[k].m_len , opAtOffset );
+		m_ops[n].m_next = next;
+		return n;
+	}
+
+	// . we always match the "default" reg ex
+	// . this line must ALWAYS exist!
+	if ( *p == 'd' && ! strcmp ( p , "default" ) ) {
+		m_ops[n].m_type = UFOP_DEFAULT;
+		return n;
+	}
+
+	if ( *p == 't' && strncmp ( p , "tag:" , 4 ) == 0 ) {
+		m_ops[n].m_type = UFOP_TAG;
+		m_ops[n].m_str = p + 4;
+		int32_t next = getNext ( rule , p + 4 , opAtOffset );
+		m_ops[n].m_next = next;
+		return n;
+	}
+
+	// set the sign
+	const char *s = p;
+	// skip s to after
+	while ( *s && is_alpha_a(*s) ) s++;
+
+	// skip white space before the operator
+	while ( *s && is_wspace_a(*s) ) s++;
+
+	char sign = 0;
+	if ( *s == '=' ) {
+		s++;
+		if ( *s == '=' ) s++;
+		sign = SIGN_EQ;
+	}
+	else if ( *s == '!' && s[1] == '=' ) {
+		s += 2;
+		sign = SIGN_NE;
+	}
+	else if ( *s == '<' ) {
+		s++;
+		if ( *s == '=' ) { sign = SIGN_LE; s++; }
+		else               sign = SIGN_LT;
+	}
+	else if ( *s == '>' ) {
+		s++;
+		if ( *s == '=' ) { sign = SIGN_GE; s++; }
+		else               sign = SIGN_GT;
+	}
+
+	// skip whitespace after the operator
+	while ( *s && is_wspace_a(*s) ) s++;
+
+	for ( size_t k = 0 ; k < sizeof(s_comparisons)/sizeof(s_comparisons[0]) ; k++ ) {
+		if ( strncmp ( p , s_comparisons[k].m_name , s_comparisons[k].m_len ) != 0 ) continue;
+		UrlFilterOpType type = s_comparisons[k].m_type;
+		m_ops[n].m_type = type;
+		m_ops[n].m_sign = sign;
+
+		if ( type != UFOP_TLD && type != UFOP_LANG ) {
+			m_ops[n].m_intArg = atoi ( s );
+			m_ops[n].m_floatArg = atof ( s );
+			int32_t next = getNext ( rule , s , opAtOffset );
+			m_ops[n].m_next = next;
+			return n;
+		}
+
+		// the comma separated list like tld==us,uk,fr,it,de. on a
+		// match of an item we continue after that item, if none
+		// matched after the last one
+		std::vector<UrlFilterListItem> items;
+		const char *b = s;
+		for ( ; ; ) {
+			const char *start = b;
+			while ( *b && ! is_wspace_a(*b) && *b != ',' ) b++;
+			UrlFilterListItem item;
+			item.m_str.assign ( start , b - start );
+			item.m_next = getNext ( rule , b , opAtOffset );
+			items.push_back ( item );
+			if ( *b != ',' ) break;
+			b++;
+		}
+		m_ops[n].m_next = items.back().m_next;
+		m_ops[n].m_items.swap ( items );
+		return n;
+	}
+
+	// our own regex thing. '^' matches the front of the url, '$' the end
+	// and anything else is a substring match
+	UrlFilterOpType type = UFOP_SUBSTRING;
+	const char *pstart = p;
+	if ( *p == '^' ) {
+		type = UFOP_PREFIX;
+		pstart = p + 1;
+	} else if ( *p == '$' ) {
+		type = UFOP_SUFFIX;
+		pstart = p + 1;
+		// a hack for $\.css, skip over the backslash too
+		if ( *pstart == '\\' && pstart[1] == '.' ) pstart++;
+	}
+	const char *pend = pstart;
+	while ( *pend && ! is_wspace_a(*pend) ) pend++;
+
+	// empty? that's kinda an error. the rule never matches
+	if ( pend == pstart ) return n;
+
+	m_ops[n].m_type = type;
+	m_ops[n].m_str.assign ( pstart , pend - pstart );
+	int32_t next = getNext ( rule , s , opAtOffset );
+	m_ops[n].m_next = next;
+	return n;
+}
@@ -0,0 +1,147 @@
+// . the url filters of a collection compiled into a list of ops, so
+//   getUrlFilterNum() does not have to parse the rule strings again for
+//   every SpiderRequest it looks at
+// . compiled by CollectionRec::rebuildUrlFilters() whenever the url filters
+//   change. it is also where the hits of each rule are counted
+// . a compiled program is never changed. rebuildUrlFilters() compiles a new
+//   one and swaps it in, so getUrlFilterNum() on the other threads keeps
+//   using the one it got until it is done
+// . a rule is a chain of ops, one for each "&&" separated expression. the
+//   ops only hold what can be known from the rule string, like the sign and
+//   the number of "hopcount>=3" or the needle of a substring match.
+//   getUrlFilterNum() evaluates them against the SpiderRequest
+// . the rules are parsed exactly like getUrlFilterNum() used to do it, so
+//   odd rules like "age" matching "agent" behave the same as before
+
+#ifndef GB_URLFILTERPROGRAM_H
+#define GB_URLFILTERPROGRAM_H
+
+#include <inttypes.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+
+class SafeBuf;
+
+#define SIGN_EQ 1
+#define SIGN_NE 2
+#define SIGN_GT 3
+#define SIGN_LT 4
+#define SIGN_GE 5
+#define SIGN_LE 6
+
+enum UrlFilterOpType {
+	// an empty expression, never matches
+	UFOP_FAIL = 0,
+	// "default", always matches
+	UFOP_DEFAULT,
+
+	// the boolean expressions. m_negate is true if it had a leading '!'
+	UFOP_HASAUTHORITYINLINK,
+	UFOP_HASREPLY,
+	UFOP_HASTMPERROR,
+	UFOP_ISINJECTED,
+	UFOP_ISDOCIDBASED,
+	UFOP_ISREINDEX,
+	UFOP_INSITELIST,
+	UFOP_ISADDURL,
+	UFOP_ISMANUALADD,
+	UFOP_ISROOT,
+	UFOP_ISINDEXED,
+	UFOP_ISPINGSERVER,
+	UFOP_ISFAKEIP,
+	UFOP_ISRSS,
+	UFOP_ISPERMALINK,
+	UFOP_ISNEWREQUEST,
+	UFOP_ISNEW,
+	UFOP_ISWWW,
+
+	// "tag:xyz". m_str is the rest of the rule after "tag:"
+	UFOP_TAG,
+
+	// the comparisons. m_sign is one of SIGN_* or 0 if there was no
+	// operator, and m_intArg/m_floatArg is the number after it
+	UFOP_SITEPAGES,
+	UFOP_HOPCOUNT,
+	UFOP_URLAGE,
+	UFOP_ERRORCOUNT,
+	UFOP_ERRORCODE,
+	UFOP_NUMINLINKS,
+	UFOP_SITENUMINLINKS,
+	UFOP_SPIDERWAITED,
+	UFOP_PERCENTCHANGEDPERDAY,
+	UFOP_HTTPSTATUS,
+	UFOP_AGE,
+
+	// "tld==com,org" and "lang!=en,de". the list is in m_items
+	UFOP_TLD,
+	UFOP_LANG,
+
+	// "^http://", "$.css" and "foo.com". the needle is in m_str
+	UFOP_PREFIX,
+	UFOP_SUFFIX,
+	UFOP_SUBSTRING
+};
+
+// an item of the comma separated list of "tld" and "lang"
+struct UrlFilterListItem {
+	std::string m_str;
+	// the op to go to if this item matched with SIGN_EQ
+	int32_t m_next;
+};
+
+struct UrlFilterOp {
+	UrlFilterOp();
+
+	UrlFilterOpType m_type;
+	bool m_negate;
+	char m_sign;
+	int32_t m_intArg;
+	float m_floatArg;
+	std::string m_str;
+	std::vector<UrlFilterListItem> m_items;
+	// . the op of the expression after the "&&", or -1 if this is the
+	//   last one and the rule matches
+	// . for "tld" and "lang" it is the one to go to if no item matched
+	//   with SIGN_NE
+	int32_t m_next;
+};
+
+class UrlFilterProgram {
+public:
+	UrlFilterProgram();
+	~UrlFilterProgram();
+
+	// . compile the rules. only call it on a new program
+	// . "rules" are CollectionRec::m_regExs
+	void compile ( const SafeBuf *rules , int32_t numRules );
+
+	int32_t getNumRules ( ) const { return (int32_t)m_firstOps.size(); }
+
+	// the first op of rule #i
+	int32_t getFirstOp ( int32_t i ) const { return m_firstOps[i]; }
+	const UrlFilterOp *getOp ( int32_t n ) const { return &m_ops[n]; }
+
+	// . number of times rule #i was the one getUrlFilterNum() returned
+	//   since the rules were compiled
+	void addHit ( int32_t i ) { m_hits[i].fetch_add ( 1 , std::memory_order_relaxed ); }
+	int64_t getHits ( int32_t i ) const { return m_hits[i].load ( std::memory_order_relaxed ); }
+
+private:
+	UrlFilterProgram(const UrlFilterProgram&);
+	UrlFilterProgram& operator=(const UrlFilterProgram&);
+
+	int32_t compileExpression ( const char *rule , const char *p , std::vector<int32_t> *opAtOffset );
+	int32_t getNext ( const char *rule , const char *p , std::vector<int32_t> *opAtOffset );
+
+	std::vector<UrlFilterOp> m_ops;
+	std::vector<int32_t> m_firstOps;
+
+	std::atomic<int64_t> *m_hits;
+	int32_t m_numHits;
+};
+
+typedef std::shared_ptr<UrlFilterProgram> urlfilterprogram_ptr_t;
+
+#endif // GB_URLFILTERPROGRAM_H
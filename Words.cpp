@@ -10,11 +10,14 @@
 #include "XmlNode.h" // getTagLen()
 #include "Mem.h"
 #include "Sanity.h"
+#include "AsciiSimd.h"
+#include "Arena.h"
 
 
 Words::Words ( ) {
 	m_buf = NULL;
 	m_bufSize = 0;
+	m_arena = NULL;
 	memset(m_localBuf, 0, sizeof(m_localBuf));
 	reset();
 }
@@ -26,7 +29,7 @@ void Words::reset ( ) {
 	m_numAlnumWords = 0;
 	m_xml = NULL;
 	m_preCount = 0;
-	if ( m_buf && m_buf != m_localBuf && m_buf != m_localBuf2 )
+	if ( m_buf && m_buf != m_localBuf && m_buf != m_localBuf2 && ! m_arena )
 		mfree ( m_buf , m_bufSize , "Words" );
 	m_buf = NULL;
 	m_bufSize = 0;
@@ -75,6 +78,12 @@ static int32_t countWords ( const char *p , int32_t plen ) {
 
 		// sequence of punct
 		for  ( ; p < pend && ! is_alnum_utf8 (p) ; p += getUtf8CharSize(p) ) {
+			// skip the ascii punct quickly
+			p += getAsciiPunctSpanLen ( p, pend - p, true );
+			if ( p >= pend || is_alnum_utf8 ( p ) ) {
+				break;
+			}
+
 			// in case being set from xml tags, count as words now
 			if ( *p == '<' ) {
 				count++;
@@ -83,34 +92,17 @@ static int32_t countWords ( const char *p , int32_t plen ) {
 		count++;
 
 		// sequence of alnum
-		for  ( ; p < pend && is_alnum_utf8 (p) ; p += getUtf8CharSize(p) )
-			;
-
-		count++;
-
-	};
-	// some extra for good meaure
-	return count+10;
-}
-
-static int32_t countWords ( const char *p ) {
-	int32_t  count = 1;
-
-	while ( *p ) {
-		// sequence of punct
-		for  ( ; *p && ! is_alnum_utf8 (p) ; p += getUtf8CharSize(p) ) {
-			// in case being set from xml tags, count as words now
-			if ( *p=='<') count++; 
+		for  ( ; p < pend && is_alnum_utf8 (p) ; p += getUtf8CharSize(p) ) {
+			// skip the ascii alnum quickly
+			p += getAsciiAlnumSpanLen ( p, pend - p );
+			if ( p >= pend || ! is_alnum_utf8 ( p ) ) {
+				break;
+			}
 		}
-		count++;
-
-		// sequence of alnum
-		for  ( ; *p && is_alnum_utf8 (p) ; p += getUtf8CharSize(p) )
-			;
 
 		count++;
 
-	}
+	};
 	// some extra for good meaure
 	return count+10;
 }
@@ -155,43 +147,62 @@ bool Words::set( Xml *xml, bool computeWordIds, int32_t node1, int32_t node2 ) {
 
 	// are we done?
 	for ( int32_t k = node1; k < node2 && m_numWords < m_preCount; ++k ) {
-		// get the kth node
-		char *node = xml->getNode( k );
-		int32_t nodeLen = xml->getNodeLen( k );
-
-		// is the kth node a tag?
-		if ( !xml->isTag( k ) ) {
-			/// @todo ALC why are we adding NULL and restoring it after?
-			/// addWords should be change to use nodeLen and not null terminated string
-			char c = node[nodeLen];
-			node[nodeLen] = '\0';
-			addWords( node, nodeLen, computeWordIds );
-			node[nodeLen] = c;
-			continue;
-		}
+		addNode( k, computeWordIds );
+	}
 
-		// it is a tag
-		m_words    [m_numWords] = node;
-		m_wordLens [m_numWords] = nodeLen;
-		m_tagIds   [m_numWords] = xml->getNodeId(k);
-		m_wordIds  [m_numWords] = 0LL;
-		m_nodes    [m_numWords] = k;
-
-		// we have less than 127 HTML tags, so set 
-		// the high bit for back tags
-		if ( xml->isBackTag(k)) {
-			m_tagIds[m_numWords] |= BACKBIT;
-		}
+	return true;
+}
 
-		m_numWords++;
+bool Words::startXml( Xml *xml, int32_t maxNumWords ) {
+	// prevent setting with the same string
+	if ( m_xml == xml ) gbshutdownLogicError();
+
+	reset();
+
+	m_xml = xml;
+	m_preCount = maxNumWords;
+
+	return allocateWordBuffers( m_preCount, true );
+}
 
-		// used by XmlDoc.cpp
-		m_numTags++;
+// add the words of the kth node of m_xml
+void Words::addNode( int32_t k, bool computeWordIds ) {
+	if ( m_numWords >= m_preCount ) {
+		return;
+	}
 
-		continue;
+	// get the kth node
+	char *node = m_xml->getNode( k );
+	int32_t nodeLen = m_xml->getNodeLen( k );
+
+	// is the kth node a tag?
+	if ( !m_xml->isTag( k ) ) {
+		/// @todo ALC why are we adding NULL and restoring it after?
+		/// addWords should be change to use nodeLen and not null terminated string
+		char c = node[nodeLen];
+		node[nodeLen] = '\0';
+		addWords( node, nodeLen, computeWordIds );
+		node[nodeLen] = c;
+		return;
 	}
 
-	return true;
+	// it is a tag
+	m_words    [m_numWords] = node;
+	m_wordLens [m_numWords] = nodeLen;
+	m_tagIds   [m_numWords] = m_xml->getNodeId(k);
+	m_wordIds  [m_numWords] = 0LL;
+	m_nodes    [m_numWords] = k;
+
+	// we have less than 127 HTML tags, so set 
+	// the high bit for back tags
+	if ( m_xml->isBackTag(k)) {
+		m_tagIds[m_numWords] |= BACKBIT;
+	}
+
+	m_numWords++;
+
+	// used by XmlDoc.cpp
+	m_numTags++;
 }
 
 // . set words from a string
@@ -205,14 +216,16 @@ bool Words::set( Xml *xml, bool computeWordIds, int32_t node1, int32_t node2 ) {
 bool Words::set( char *s, bool computeWordIds ) {
 	reset();
 
+	int32_t slen = strlen ( s );
+
 	// determine rough upper bound on number of words by counting
 	// punct/alnum boundaries
-	m_preCount = countWords ( s );
+	m_preCount = countWords ( s, slen );
 	if ( !allocateWordBuffers( m_preCount ) ) {
 		return false;
 	}
 
-	return addWords( s, 0x7fffffff, computeWordIds );
+	return addWords( s, slen, computeWordIds );
 }
 
 bool Words::addWords( char *s, int32_t nodeLen, bool computeWordIds ) {
@@ -271,6 +284,10 @@ bool Words::addWords( char *s, int32_t nodeLen, bool computeWordIds ) {
 
 		// it is a punct word, find end of it
 		char *start = s+i;
+
+		// skip the ascii punct quickly
+		i += getAsciiPunctSpanLen( s + i, nodeLen - i, m_hasTags );
+
 		for ( ; s[i] ; i += getUtf8CharSize(s+i)) {
 			// stop on < if we got tags
 			if ( s[i] == '<' && m_hasTags ) {
@@ -321,6 +338,9 @@ bool Words::addWords( char *s, int32_t nodeLen, bool computeWordIds ) {
 	// get an alnum word
 	j = i;
  again:
+	// skip the ascii alnum quickly
+	i += getAsciiAlnumSpanLen( s + i, nodeLen - i );
+
 	for ( ; s[i] ; i += getUtf8CharSize(s+i) ) {
 		// simple ascii?
 		if ( is_ascii(s[i]) ) {
@@ -458,7 +478,11 @@ bool Words::allocateWordBuffers(int32_t count, bool tagIds) {
 		m_buf = m_localBuf;
 	}
 	else {
-		m_buf = (char *)mmalloc ( m_bufSize , "Words" );
+		if ( m_arena ) {
+			m_buf = (char *)m_arena->alloc ( m_bufSize );
+		} else {
+			m_buf = (char *)mmalloc ( m_bufSize , "Words" );
+		}
 		if ( ! m_buf ) {
 			log(LOG_WARN, "build: Could not allocate %" PRId32" bytes for parsing document.", m_bufSize);
 			return false;
@@ -49,6 +49,12 @@ class Words {
 	// . use range (node1,node2] and if node2 is -1 that means the last one
 	bool set( Xml *xml, bool computeIds, int32_t node1 = 0, int32_t node2 = -1 );
 
+	// . used by Xml::set() to tokenize the nodes as it makes them so the
+	//   document is only walked once
+	// . "maxNumWords" must be an upper bound of the number of words
+	bool startXml( Xml *xml, int32_t maxNumWords );
+	void addNode( int32_t k, bool computeIds );
+
 	inline bool addWords( char *s, int32_t nodeLen, bool computeIds );
 
 	// get the spam modified score of the ith word (baseScore is the 
@@ -260,6 +266,14 @@ class Words {
 	~Words     ( );
 	void reset ( ); 
 
+	// . get the word arrays from "arena" instead of the heap when they do
+	//   not fit the local buffer. reset() leaves freeing them to the arena's
+	//   owner
+	// . stays set across reset()
+	void setArena ( class Arena *arena ) {
+		m_arena = arena;
+	}
+
 	char *getContent() { 
 		if ( m_numWords == 0 ) return NULL;
 		return m_words[0]; 
@@ -278,6 +292,7 @@ private:
 
 	char *m_buf;
 	int32_t  m_bufSize;
+	class Arena *m_arena;
 	Xml  *m_xml ;  // if the class is set from xml, rather than a string
 
 	int32_t           m_preCount  ; // estimate of number of words in the doc
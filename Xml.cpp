@@ -9,6 +9,7 @@
 #include "Pos.h"
 #include "Sanity.h"
 #include "Conf.h"
+#include "Arena.h"
 
 
 Xml::Xml  () { 
@@ -18,6 +19,7 @@ Xml::Xml  () {
 	m_numNodes=0;
 	m_maxNumNodes = 0;
 	m_version = 0;
+	m_arena = NULL;
 }
 
 // . should free m_xml if m_copy is true
@@ -166,9 +168,17 @@ int32_t Xml::getNodeNum ( int32_t n0 , int32_t n1 , const char *tagName , int32_
 	return i;
 }
 
+XmlNode *Xml::allocNodes ( int32_t numNodes, const char *note ) {
+	size_t size = sizeof(XmlNode) * numNodes;
+	if ( m_arena ) {
+		return (XmlNode *)m_arena->alloc ( size );
+	}
+	return (XmlNode *)mmalloc ( size, note );
+}
+
 void Xml::reset ( ) {
-	// free old nodes array if any
-	if ( m_nodes ) {
+	// free old nodes array if any. the arena frees its memory itself
+	if ( m_nodes && ! m_arena ) {
 		mfree ( m_nodes, m_maxNumNodes*sizeof(XmlNode),"Xml1");
 	}
 
@@ -210,10 +220,15 @@ bool Xml::getCompoundName ( int32_t node , SafeBuf *sb ) {
 #include "HttpMime.h" // CT_JSON
 
 // "s" must be in utf8
-bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
+bool Xml::set( char *s, int32_t slen, int32_t version, char contentType,
+		Words *words, bool computeWordIds ) {
 	// just in case
 	reset();
 
+	if ( words ) {
+		words->reset();
+	}
+
 	m_version = version;
 
 	// clear it
@@ -243,7 +258,7 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		m_numNodes = 0;
 		// make the array
 		m_maxNumNodes = 1;
-		m_nodes =(XmlNode *)mmalloc(sizeof(XmlNode)*m_maxNumNodes,"x");
+		m_nodes = allocNodes ( m_maxNumNodes, "x" );
 		if ( ! m_nodes ) return false;
 		XmlNode *xd = &m_nodes[m_numNodes];
 		// hack the node
@@ -256,6 +271,11 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		xd->m_hash       = 0;
 		xd->m_pairTagNum = -1;
 		m_numNodes++;
+
+		if ( words ) {
+			return words->set( this, computeWordIds );
+		}
+
 		return true;
 	}
 
@@ -276,17 +296,56 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 	/// Shouldn't all string be valid utf-8 at this point?
 	// . replacing NULL bytes with spaces in the buffer
 	// . utf8 should never have any 0 bytes in it either!
-	for ( i = 0 ; i < slen ; i++ ) {
-		if ( !s[i] ) {
-			s[i] = ' ';
+	int32_t maxNumWords = 0;
+	if ( ! words ) {
+		for ( i = 0 ; i < slen ; i++ ) {
+			if ( !s[i] ) {
+				s[i] = ' ';
+			}
 		}
-	}
 
-	// counting the max num nodes
-	for ( i = 0 ; s[i] ; i++ ) {
-		if ( s[i] == '<' ) {
-			m_maxNumNodes++;
+		// counting the max num nodes
+		for ( i = 0 ; s[i] ; i++ ) {
+			if ( s[i] == '<' ) {
+				m_maxNumNodes++;
+			}
+		}
+	} else {
+		// . same as above, but also get an upper bound on the number
+		//   of words for Words::startXml() while we are at it
+		// . a word can only start where the ascii alnum-ness changes,
+		//   at a non-ascii char or at/after a tag. this avoids decoding
+		//   the utf8 like Words::set(Xml*) does to count the words
+		bool prevAscii = true;
+		bool prevAlnum = false;
+		for ( i = 0 ; i < slen ; i++ ) {
+			unsigned char c = (unsigned char)s[i];
+			if ( ! c ) {
+				s[i] = ' ';
+				c = ' ';
+			}
+
+			if ( c == '<' ) {
+				m_maxNumNodes++;
+				maxNumWords += 2;
+			}
+
+			if ( c < 0x80 ) {
+				bool alnum = is_alnum_a ( c );
+				if ( alnum != prevAlnum || ! prevAscii ) {
+					maxNumWords++;
+				}
+				prevAlnum = alnum;
+				prevAscii = true;
+			} else if ( ( c & 0xc0 ) != 0x80 ) {
+				// first byte of a multibyte char
+				maxNumWords++;
+				prevAscii = false;
+			}
 		}
+
+		// some extra for good measure
+		maxNumWords += 10;
 	}
 
 	// account for the text (non-tag) nodes (padding nodes between tags)
@@ -315,7 +374,7 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		m_maxNumNodes = bigMax;
 	}
 
-	m_nodes = (XmlNode *)mmalloc( sizeof( XmlNode ) * m_maxNumNodes, "Xml1" );
+	m_nodes = allocNodes ( m_maxNumNodes, "Xml1" );
 	if ( ! m_nodes ) { 
 		reset();
 		log(LOG_WARN, "build: Could not allocate %" PRId32 " bytes need to parse document.",
@@ -323,6 +382,11 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		return false;
 	}
 
+	if ( words && ! words->startXml( this, maxNumWords ) ) {
+		reset();
+		return false;
+	}
+
 	// debug msg time
 	if ( g_conf.m_logTimingBuild ) {
 		logf( LOG_TIMING, "build: xml: set: 4c. %" PRIu64 "", gettimeofdayInMilliseconds() );
@@ -395,11 +459,17 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 
 		if ( xi->m_nodeId != TAG_SCRIPT || !xi->isFrontTag() ) {
 			++m_numNodes;
+			if ( words ) {
+				words->addNode( m_numNodes - 1, computeWordIds );
+			}
 			continue;
 		}
 
 		// ok, we got a <script> tag now
 		++m_numNodes;
+		if ( words ) {
+			words->addNode( m_numNodes - 1, computeWordIds );
+		}
 
 		// use this for parsing consistency when deleting records
 		// so they equal what we added.
@@ -579,6 +649,9 @@ bool Xml::set( char *s, int32_t slen, int32_t version, char contentType ) {
 		xn->m_hash       = 0;
 		xn->m_isVisible  = false;
 		xn->m_isBreaking = false;
+		if ( words ) {
+			words->addNode( m_numNodes - 1, computeWordIds );
+		}
 		// advance i to get to the </script> or <gbframe> etc.
 		i = p - &m_xml[0] ;
 	}
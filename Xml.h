@@ -28,10 +28,20 @@ public:
 	// . s must be NULL terminated
 	// . if it's pure xml then set pureXml to true otherwise we assume it
 	//   is html or xhtml
-	bool set( char *s, int32_t slen, int32_t version, char contentType );
+	// . if "words" is given it is set from the nodes as they are made,
+	//   same as calling Words::set(Xml*) after, but in a single pass
+	bool set( char *s, int32_t slen, int32_t version, char contentType,
+		  class Words *words = NULL, bool computeWordIds = true );
 
 	void  reset ( );
 
+	// . get the nodes array from "arena" instead of the heap. reset() then
+	//   leaves freeing it to the arena's owner
+	// . stays set across reset()
+	void setArena ( class Arena *arena ) {
+		m_arena = arena;
+	}
+
 	int32_t getVersion() const {
 		return m_version;
 	}
@@ -183,10 +193,14 @@ private:
 	// used because "s" may have words separated by periods
 	int64_t getCompoundHash( const char *s, int32_t len ) const;
 
+	XmlNode *allocNodes ( int32_t numNodes, const char *note );
+
 	XmlNode *m_nodes;
 	int32_t m_numNodes;
 	int32_t m_maxNumNodes;
 
+	class Arena *m_arena;
+
 	// If this is a unicode buffer, then m_xml is encoded in UTF-16
 	// m_xmlLen is still the size of the buffer IN BYTES
 	char *m_xml;
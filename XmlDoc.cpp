@@ -1,6 +1,7 @@
 #include "gb-include.h"
 #include "hash.h"
 #include "XmlDoc.h"
+#include "AsciiSimd.h"
 #include "Conf.h"
 #include "Query.h"     // getFieldCode()
 #include "Clusterdb.h" // g_clusterdb
@@ -38,6 +39,7 @@
 #include "Process.h"
 #include "Statistics.h"
 #include "GbCompress.h"
+#include "TitleRecCodec.h"
 #include "GbUtil.h"
 #include "ScopedLock.h"
 #include "Mem.h"
@@ -70,10 +72,13 @@ static void getMetaListWrapper ( void *state ) ;
 static void doneReadingArchiveFileWrapper ( int fd, void *state );
 #endif
 
-XmlDoc::XmlDoc() {
+XmlDoc::XmlDoc() : m_ownArena("XmlDocArena") {
 	//clear all fields in the titledb structure (which are the first fileds in this class)
 	memset(&m_headerSize, 0, (size_t)((char*)&ptr_firstUrl-(char*)&m_headerSize));
 
+	m_arena = NULL;
+	setArena ( &m_ownArena );
+
 	m_esbuf.setLabel("exputfbuf");
 	m_freed = false;
 	m_contentInjected = false;
@@ -121,6 +126,20 @@ XmlDoc::~XmlDoc() {
 	m_freed = true;
 }
 
+void XmlDoc::setArena ( Arena *arena ) {
+	// give back what we have before switching
+	if ( m_arena ) {
+		reset();
+	}
+	m_arena = arena;
+	m_xml.setArena ( arena );
+	m_words.setArena ( arena );
+	m_bits.setArena ( arena );
+	m_pos.setArena ( arena );
+	m_phrases.setArena ( arena );
+	m_sections.setArena ( arena );
+}
+
 void XmlDoc::reset ( ) {
 	m_redirUrl.reset();
 
@@ -163,6 +182,7 @@ void XmlDoc::reset ( ) {
 	m_fragBuf.purge();
 
 	m_lastTimeStart = 0LL;
+	m_statusFrozen = false;
 
 	m_req = NULL;
 	m_abortMsg20Generation = false;
@@ -389,6 +409,11 @@ void XmlDoc::reset ( ) {
 	void *pxend = &m_dummyEnd;
 	memset ( px , 0 , (char *)pxend - (char *)px );
 
+	// . everything allocated from the arena was reset above
+	// . a shared arena keeps what it grew to for the next doc, ours is
+	//   only used once so give its chunks back to the pool
+	m_arena->rewind ( m_arena == &m_ownArena ? 0 : g_conf.m_docArenaKeepSize );
+
 	//unclear if this would make things blow up:
 	//m_errno = 0;
 }
@@ -912,7 +937,10 @@ bool XmlDoc::set2 ( char    *titleRec ,
 	int32_t cbufSize = dataSize + 4 + sizeof(key96_t);
 	// . the actual data follows "dataSize"
 	// . what's the size of the uncompressed compressed stuff below here?
-	m_ubufSize = *(int32_t  *) p ; p += 4;
+	// . the top bits say which codec it was compressed with
+	int32_t usizeField = *(int32_t  *) p ; p += 4;
+	m_ubufSize = getTitleRecUncompressedSize(usizeField);
+	titlerec_codec_t codec = getTitleRecCodec(usizeField);
 
 	// . because of disk/network data corruption this may be wrong!
 	// . we can now have absolutely huge titlerecs...
@@ -967,21 +995,11 @@ bool XmlDoc::set2 ( char    *titleRec ,
 	setStatus( "Uncompressing title rec." );
 	// . uncompress the data into m_ubuf
 	// . m_ubufSize should remain unchanged since we stored it
-	int err = gbuncompress ( (unsigned char *)  m_ubuf ,
-				 (uint32_t *) &realSize   ,
-				 (unsigned char *)  p ,
-				 (uint32_t  ) (dataSize - 4) );
-	// hmmmm...
-	if ( err == Z_BUF_ERROR ) {
-		log(LOG_ERROR, "!!! Buffer is too small to hold uncompressed document. Probable disk corruption in a titledb file.");
-		g_errno = EUNCOMPRESSERROR;
-		return false;
-	}
-	// set g_errno and return false on error
-	if ( err != Z_OK ) {
-		g_errno = EUNCOMPRESSERROR;
-		log(LOG_ERROR, "!!! Uncompress of document failed. ZG_ERRNO=%i. cbufSize=%" PRId32" ubufsize=%" PRId32" realSize=%" PRId32,
-		    err , cbufSize , m_ubufSize , realSize );
+	// . only zstd records can need the collection's dictionaries
+	TitleRecDicts *dicts = ( codec == TITLEREC_CODEC_ZSTD ) ? getTitleRecDicts(m_collnum) : NULL;
+	if ( ! titleRecUncompress ( codec , dicts , m_ubuf , &realSize , p , dataSize - 4 ) ) {
+		log(LOG_ERROR, "!!! Uncompress of %s document failed. cbufSize=%" PRId32" ubufsize=%" PRId32" docId=%" PRId64,
+		    getTitleRecCodecName(codec), cbufSize, m_ubufSize, m_docId);
 		return false;
 	}
 
@@ -1217,6 +1235,8 @@ bool XmlDoc::setFirstUrl ( const char *u ) {
 
 
 void XmlDoc::setStatus ( const char *s ) {
+	if ( m_statusFrozen ) return;
+
 	bool timeIt = false;
 	if ( g_conf.m_logDebugBuildTime )
 		timeIt = true;
@@ -2858,11 +2878,23 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 	// sanity check
 	if ( p != ubuf + need1 ) { g_process.shutdownAbort(true); }
 
+	// which codec we compress with is stored in the titlerec, so it can
+	// be changed at any time
+	titlerec_codec_t codec = (titlerec_codec_t)g_conf.m_titleRecCodec;
+	if ( codec < TITLEREC_CODEC_ZLIB || codec > TITLEREC_CODEC_MAX ) {
+		codec = TITLEREC_CODEC_ZLIB;
+	}
+
+	// the uncompressed size shares its field with the codec
+	if ( need1 > TITLEREC_USIZE_MASK ) {
+		mfree ( ubuf , need1 , "trub" );
+		g_errno = ECOMPRESSFAILED;
+		log(LOG_ERROR,"!!! Document of %" PRId32" bytes is too big for a titlerec.", need1);
+		return false;
+	}
+
 	// . make a buf big enough to hold compressed, we'll realloc afterwards
-	// . according to zlib.h line 613 compress buffer must be .1% larger
-	//   than source plus 12 bytes. (i add one for round off error)
-	// . now i added another extra 12 bytes cuz compress seemed to want it
-	int32_t need2 = ((int64_t)need1 * 1001LL) / 1000LL + 13 + 12;
+	int32_t need2 = getTitleRecCompressBound ( codec , need1 );
 
 	// we also need to store a key then regular dataSize then
 	// the uncompressed size in cbuf before the compression of m_ubuf
@@ -2876,41 +2908,43 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 	need2 += hdrSize;
 
 	// return false on error
-	if ( ! tbuf->reserve ( need2 ,"titbuf" ) ) return false;
+	if ( ! tbuf->reserve ( need2 ,"titbuf" ) ) {
+		mfree ( ubuf , need1 , "trub" );
+		return false;
+	}
 
 	// shortcut
 	char *cbuf = tbuf->getBufStart();
 
-	// . how big is the buf we're passing to ::compress()?
+	// . how big is the buf we're passing to the compressor?
 	// . don't include the last 12 byte, save for del key in Msg14.cpp
 	int32_t size = need2 - hdrSize ;
 
-	// . uncompress the data into ubuf
-	// . this will reset cbufSize to a smaller value probably
+	// . zstd records can use the newest dictionary of the collection
+	TitleRecDicts *dicts = NULL;
+	if ( codec == TITLEREC_CODEC_ZSTD && g_conf.m_titleRecUseDict ) {
+		dicts = getTitleRecDicts ( m_collnum );
+	}
+
+	// . compress the data into cbuf + hdrSize
 	// . "size" is set to how many bytes we wrote into "cbuf + hdrSize"
-	int err = gbcompress ( (unsigned char *)cbuf + hdrSize,
-			       (uint32_t *)&size,
-			       (unsigned char *)ubuf ,
-			       (uint32_t  )need1 );
+	bool compressed = titleRecCompress ( codec ,
+					     g_conf.m_titleRecCompressionLevel ,
+					     dicts ,
+					     cbuf + hdrSize ,
+					     &size ,
+					     ubuf ,
+					     need1 );
 
 	// free the buf we were trying to compress now
 	mfree ( ubuf , need1 , "trub" );
 
-	// we should check ourselves
-	if ( err == Z_OK && size > (need2 - hdrSize ) ) {
-		tbuf->purge();
-		g_errno = ECOMPRESSFAILED;
-		log(LOG_ERROR, "!!! Failed to compress document of %" PRId32" bytes. "
-		    "Provided buffer of %" PRId32" bytes.",
-		    size, (need2 - hdrSize ) );
-		return false;
-	}
-
 	// check for error
-	if ( err != Z_OK ) {
+	if ( ! compressed ) {
 		tbuf->purge();
 		g_errno = ECOMPRESSFAILED;
-		log(LOG_ERROR,"!!! Failed to compress document.");
+		log(LOG_ERROR,"!!! Failed to compress document of %" PRId32" bytes with %s.",
+		    need1, getTitleRecCodecName(codec));
 		return false;
 	}
 
@@ -2929,8 +2963,8 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 	*(int32_t  *) p = dataSize ;
 	p += 4;
 
-	// store uncompressed size in header
-	*(int32_t  *) p = need1;
+	// store uncompressed size and the codec in header
+	*(int32_t  *) p = makeTitleRecUsizeField ( codec , need1 );
 	p += 4;
 
 	// sanity check
@@ -3237,8 +3271,10 @@ Xml *XmlDoc::getXml ( ) {
 
 	int64_t start = logQueryTimingStart();
 
-	// set it
-	if ( !m_xml.set( *u8, u8len, m_version, *ct ) ) {
+	// . set it
+	// . the words are tokenized in the same pass, getWords() would
+	//   only walk the nodes again
+	if ( !m_xml.set( *u8, u8len, m_version, *ct, &m_words, true ) ) {
 		// return NULL on error with g_errno set
 		return NULL;
 	}
@@ -3246,6 +3282,7 @@ Xml *XmlDoc::getXml ( ) {
 	logQueryTimingEnd( __func__, start );
 
 	m_xmlValid = true;
+	m_wordsValid = true;
 	return &m_xml;
 }
 
@@ -10012,8 +10049,15 @@ char **XmlDoc::getUtf8Content ( ) {
 	// fixes santaclarachorale.vbotickets.com/tickets/g.f._handels_israel_in_egypt/1062
 	// which has a 228,0x80,& sequence (3 chars, last is ascii)
 	char *x = m_expandedUtf8Content;
+	char *xend = m_expandedUtf8Content + m_expandedUtf8ContentSize - 1;
 	char size;
 	for ( ; *x ; x += size ) {
+		// ascii is always valid
+		x += getAsciiSpanLen( x, xend - x );
+		if ( ! *x ) {
+			break;
+		}
+
 		size = getUtf8CharSize(x);
 		/// @todo ALC we should use U+FFFD (replacement character) instead
 		// ok, make it a space i guess if it is a bad utf8 char
@@ -10063,6 +10107,19 @@ char **XmlDoc::getUtf8Content ( ) {
 	uint8_t *pend = p + n;
 
 	for ( ; *p ; p += size ) {
+		// quick copy of the ascii
+		int32_t asciiLen = getAsciiSpanLen( (char *)p, pend - p );
+		if ( asciiLen > 0 ) {
+			if ( dst != p ) {
+				memmove( dst, p, asciiLen );
+			}
+			dst += asciiLen;
+			p += asciiLen;
+			if ( ! *p ) {
+				break;
+			}
+		}
+
 		size = getUtf8CharSize(p);
 
 		// quick copy
@@ -12984,66 +13041,28 @@ char *XmlDoc::getMetaList(bool forDelete) {
 	// . hash our documents terms into "tt1"
 	// . hash the old document's terms into "tt2"
 	// . by old, we mean the older versioned doc of this url spidered b4
-	HashTableX tt1;
+	PosdbTermTable tt1;
 
-	// . prepare it, 5000 initial terms
-	// . make it nw*8 to avoid have to re-alloc the table!!!
+	// . prepare it, room for a word and a phrase term per word
 	// . i guess we can have link and neighborhood text too! we don't
-	//   count it here though... but add 5k for it...
-	int32_t need4 = m_words.getNumWords() * 4 + 5000;
-	if (m_usePosdb && addPosRec) {
-		if (!tt1.set(18, 4, need4, NULL, 0, false, "posdb-indx")) {
-			logTrace(g_conf.m_logTraceXmlDoc, "tt1.set failed");
+	//   count it here though... but add 2.5k for it...
+	int32_t need4 = m_words.getNumWords() * 2 + 2500;
+	bool hashPosdb = (m_usePosdb && addPosRec);
+	if (hashPosdb) {
+		// the table is big, take it from the arena. if it has to grow
+		// while hashing it goes to the heap
+		int32_t tt1Size = PosdbTermTable::getBufSize(need4);
+		char *tt1Buf = (char *)m_arena->alloc(tt1Size);
+		if (!tt1Buf) {
+			logTrace(g_conf.m_logTraceXmlDoc, "tt1 alloc failed");
 			return NULL;
 		}
-
-		int32_t did = tt1.getNumSlots();
-		// . hash the document terms into "tt1"
-		// . this is a biggie!!!
-		// . only hash ourselves if m_indexCode is false
-		// . m_indexCode is non-zero if we should delete the doc from
-		//   index
-		// . i think this only adds to posdb
-		// shit, this blocks which is bad!!!
-		char *nod = hashAll(&tt1);
-
-		// you can't block here because if we are re-called we lose tt1
-		if (nod == (char *)-1) {
-			g_process.shutdownAbort(true);
-		}
-
-		// error?
-		if (!nod) {
-			logTrace(g_conf.m_logTraceXmlDoc, "END, hashAll failed");
+		if (!tt1.set(need4, tt1Buf, tt1Size)) {
+			logTrace(g_conf.m_logTraceXmlDoc, "tt1.set failed");
 			return NULL;
 		}
-
-		int32_t done = tt1.getNumSlots();
-		if (done != did) {
-			log(LOG_WARN, "xmldoc: reallocated big table! bad. old=%" PRId32" new=%" PRId32" nw=%" PRId32, did, done, m_words.getNumWords());
-		}
-	}
-
-	// if indexing the spider reply as well under a different docid
-	// there is no reason we can't toss it into our meta list here
-	if (spiderStatusDocMetaList) {
-		need += spiderStatusDocMetaList->length();
 	}
 
-	/// @todo ALC verify that we actually need sizeof(key128_t)
-	// space for indexdb AND DATEDB! +2 for rdbids
-	int32_t needPosdb = tt1.getNumUsedSlots() * (sizeof(posdbkey_t) + 2 + sizeof(key128_t));
-	if (!forDelete) {
-		// need 1 additional key for special key (with termid 0)
-		needPosdb += sizeof(posdbkey_t) + 1;
-	}
-
-	need += needPosdb;
-
-	// clusterdb keys. plus one for rdbId
-	int32_t needClusterdb = addClusterRec ? 13 : 0;
-	need += needClusterdb;
-
 	// . LINKDB
 	// . linkdb records. assume one per outlink
 	// . we may index 2 16-byte keys for each outlink
@@ -13077,17 +13096,57 @@ char *XmlDoc::getMetaList(bool forDelete) {
 	// linkdb keys will have the same lower 4 bytes, so make hashing fast.
 	// they are 28 byte keys. bytes 20-23 are the hash of the linkEE
 	// so that will be the most random.
-	kt1.set(sizeof(key224_t), 0, nis, NULL, 0, false, "link-indx", true, 20);
+	int32_t kt1Size = HashTableX::getBufSize(sizeof(key224_t), 0, nis);
+	char *kt1Buf = kt1Size ? (char *)m_arena->alloc(kt1Size) : NULL;
+	if (kt1Size && !kt1Buf) {
+		logTrace(g_conf.m_logTraceXmlDoc, "kt1 alloc failed");
+		return NULL;
+	}
+	kt1.set(sizeof(key224_t), 0, nis, kt1Buf, kt1Size, false, "link-indx", true, 20);
+
+	int32_t did = tt1.getMaxTerms();
 
+	// . hash the document terms into "tt1" and the outlinks into "kt1"
+	// . this is a biggie!!!
+	// . only hash ourselves if m_indexCode is false
+	// . m_indexCode is non-zero if we should delete the doc from
+	//   index
 	// . we already have a Links::hash into the Termtable for links: terms,
 	//   but this will have to be for adding to Linkdb. basically take a
 	//   lot of it from Linkdb::fillLinkdbList()
-	// . these return false with g_errno set on error
-	if (m_useLinkdb && nl2 && !hashLinksForLinkdb(&kt1)) {
-		logTrace(g_conf.m_logTraceXmlDoc, "END, hashLinksForLinkdb failed");
+	// . this returns false with g_errno set on error
+	if (!hashDocument(hashPosdb ? &tt1 : NULL, (m_useLinkdb && nl2) ? &kt1 : NULL)) {
+		logTrace(g_conf.m_logTraceXmlDoc, "END, hashDocument failed");
 		return NULL;
 	}
 
+	if (hashPosdb) {
+		int32_t done = tt1.getMaxTerms();
+		if (done != did) {
+			log(LOG_WARN, "xmldoc: reallocated big table! bad. old=%" PRId32" new=%" PRId32" nw=%" PRId32, did, done, m_words.getNumWords());
+		}
+	}
+
+	// if indexing the spider reply as well under a different docid
+	// there is no reason we can't toss it into our meta list here
+	if (spiderStatusDocMetaList) {
+		need += spiderStatusDocMetaList->length();
+	}
+
+	/// @todo ALC verify that we actually need sizeof(key128_t)
+	// space for indexdb AND DATEDB! +2 for rdbids
+	int32_t needPosdb = tt1.getNumTerms() * (sizeof(posdbkey_t) + 2 + sizeof(key128_t));
+	if (!forDelete) {
+		// need 1 additional key for special key (with termid 0)
+		needPosdb += sizeof(posdbkey_t) + 1;
+	}
+
+	need += needPosdb;
+
+	// clusterdb keys. plus one for rdbId
+	int32_t needClusterdb = addClusterRec ? 13 : 0;
+	need += needClusterdb;
+
 	// add up what we need. +1 for rdbId
 	int32_t needLinkdb = kt1.getNumUsedSlots() * (sizeof(key224_t)+1);
 	need += needLinkdb;
@@ -14974,13 +15033,7 @@ int32_t XmlDoc::getSiteRank ( ) {
 
 // . add keys/recs from the table into the metalist
 // . we store the keys into "m_p" unless "buf" is given
-bool XmlDoc::addTable144 ( HashTableX *tt1 , int64_t docId , SafeBuf *buf ) {
-
-	// sanity check
-	if ( tt1->getNumSlots() ) {
-		if ( tt1->getKeySize() != sizeof(key144_t) ) {g_process.shutdownAbort(true);}
-		if ( tt1->getDataSize() != 4                ) {g_process.shutdownAbort(true);}
-	}
+bool XmlDoc::addTable144 ( PosdbTermTable *tt1 , int64_t docId , SafeBuf *buf ) {
 
 	// assume we are storing into m_p
 	char *p = m_p;
@@ -14988,7 +15041,7 @@ bool XmlDoc::addTable144 ( HashTableX *tt1 , int64_t docId , SafeBuf *buf ) {
 	// reserve space if we had a safebuf and point into it if there
 	if ( buf ) {
 		int32_t slotSize = (sizeof(key144_t)+2+sizeof(key128_t));
-		int32_t need = tt1->getNumUsedSlots() * slotSize;
+		int32_t need = tt1->getNumTerms() * slotSize;
 		if ( ! buf->reserve ( need ) ) return false;
 		// get cursor into buf, NOT START of buf
 		p = buf->getBufStart();
@@ -15001,12 +15054,14 @@ bool XmlDoc::addTable144 ( HashTableX *tt1 , int64_t docId , SafeBuf *buf ) {
 	rdbid_t rdbId = RDB_POSDB;
 	if ( m_useSecondaryRdbs ) rdbId = RDB2_POSDB2;
 
-	// store terms from "tt1" table
-	for ( int32_t i = 0 ; i < tt1->getNumSlots() ; i++ ) {
-		// skip if empty
-		if ( tt1->m_flags[i] == 0 ) continue;
+	// . store terms from "tt1" table in posdb order. they all get the
+	//   same docid so they stay sorted, except for the siterank and langid
+	//   bits of the numeric terms
+	tt1->sortKeys();
+	const key144_t *keys = tt1->getKeys();
+	for ( int32_t i = 0 ; i < tt1->getNumTerms() ; i++ ) {
 		// get its key
-		char *kp = (char *)tt1->getKeyFromSlot( i );
+		const char *kp = (const char *)&keys[i];
 		// store rdbid
 		*p++ = rdbId; // (rdbId | f);
 		// store it as is
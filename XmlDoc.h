@@ -51,6 +51,8 @@
 #include "HttpMime.h" // ET_DEFLAT
 #include "Json.h"
 #include "Posdb.h"
+#include "Arena.h"
+#include "PosdbTermTable.h"
 
 class GetMsg20State;
 
@@ -308,6 +310,10 @@ public:
 	~XmlDoc() ; 
 	void nukeDoc ( class XmlDoc *);
 	void reset ( ) ;
+	// . use "arena" instead of our own for the parsing buffers and term
+	//   tables, eg. one kept by the spider loop across docs. it must
+	//   outlive us. reset() rewinds it
+	void setArena ( class Arena *arena ) ;
 	bool setFirstUrl ( const char *u ) ;
 	void setStatus ( const char *s ) ;
 	void setCallback ( void *state, void (*callback) (void *state) ) ;
@@ -475,37 +481,38 @@ public:
 	char *addOutlinkSpiderRecsToMetaList ( );
 
 	int32_t getSiteRank ();
-	bool addTable144 ( class HashTableX *tt1 , 
+	bool addTable144 ( class PosdbTermTable *tt1 , 
 			   int64_t docId ,
 			   class SafeBuf *buf = NULL );
 
 	bool addTable224 ( HashTableX *tt1 ) ;
 
-	bool hashNoSplit ( class HashTableX *tt ) ;
-	char *hashAll ( class HashTableX *table ) ;
-	bool hashMetaTags ( class HashTableX *table ) ;
-	bool hashContentType ( class HashTableX *table ) ;
+	bool hashNoSplit ( class PosdbTermTable *tt ) ;
+	char *hashAll ( class PosdbTermTable *table ) ;
+	bool hashMetaTags ( class PosdbTermTable *table ) ;
+	bool hashContentType ( class PosdbTermTable *table ) ;
 	
-	bool hashLinks ( class HashTableX *table ) ;
+	bool hashLinks ( class PosdbTermTable *table ) ;
 	bool getUseTimeAxis ( ) ;
 	SafeBuf *getTimeAxisUrl ( );
-	bool hashUrl ( class HashTableX *table, bool urlOnly );
-	bool hashDateNumbers ( class HashTableX *tt );
-	bool hashIncomingLinkText(HashTableX *table);
+	bool hashUrl ( class PosdbTermTable *table, bool urlOnly );
+	bool hashDateNumbers ( class PosdbTermTable *tt );
+	bool hashIncomingLinkText(PosdbTermTable *table);
 	bool hashLinksForLinkdb ( class HashTableX *table ) ;
-	bool hashNeighborhoods ( class HashTableX *table ) ;
-	bool hashTitle ( class HashTableX *table );
-	bool hashBody2 ( class HashTableX *table );
-	bool hashMetaKeywords ( class HashTableX *table );
-	bool hashMetaGeoPlacename( class HashTableX *table );
-	bool hashMetaSummary ( class HashTableX *table );
-	bool hashLanguage ( class HashTableX *table ) ;
-	bool hashLanguageString ( class HashTableX *table ) ;
-	bool hashCountry ( class HashTableX *table ) ;
-	bool hashPermalink ( class HashTableX *table ) ;
+	bool hashDocument ( class PosdbTermTable *tt, class HashTableX *kt );
+	bool hashNeighborhoods ( class PosdbTermTable *table ) ;
+	bool hashTitle ( class PosdbTermTable *table );
+	bool hashBody2 ( class PosdbTermTable *table );
+	bool hashMetaKeywords ( class PosdbTermTable *table );
+	bool hashMetaGeoPlacename( class PosdbTermTable *table );
+	bool hashMetaSummary ( class PosdbTermTable *table );
+	bool hashLanguage ( class PosdbTermTable *table ) ;
+	bool hashLanguageString ( class PosdbTermTable *table ) ;
+	bool hashCountry ( class PosdbTermTable *table ) ;
+	bool hashPermalink ( class PosdbTermTable *table ) ;
 
 	class Url *getBaseUrl ( ) ;
-	bool hashIsAdult    ( class HashTableX *table ) ;
+	bool hashIsAdult    ( class PosdbTermTable *table ) ;
 
 	void setMsg20Request(Msg20Request *req);
 	class Msg20Reply *getMsg20Reply ( ) ;
@@ -631,6 +638,13 @@ public:
 	// used by msg7 to store udp slot
 	class UdpSlot *m_injectionSlot;
 
+	// . the Xml, Words, Bits, Pos, Phrases and Sections buffers and the
+	//   posdb/linkdb term tables are allocated from m_arena, which is
+	//   m_ownArena unless setArena() was called
+	// . declared before them so it outlives them
+	Arena      m_ownArena;
+	Arena     *m_arena;
+
 	// . same thing, a little more complicated
 	// . these classes are only set on demand
 	Xml        m_xml;
@@ -983,6 +997,8 @@ public:
 	// stuff
 	int64_t m_lastTimeStart;
 	const char *m_statusMsg;
+	// set while hashing in parallel stages so they don't race on it
+	bool m_statusFrozen;
 	Msg4  m_msg4;
 
 	bool  m_deleteFromIndex;
@@ -1140,6 +1156,14 @@ public:
 	// vector is 1-1 with words in the document body.
 	char *getFragVec ( );
 
+	// the stages of hashDocument() for large documents
+	bool prepareParallelHashing ( bool hashLinks );
+	static bool hashStageWordSpam ( void *state );
+	static bool hashStageFragVec ( void *state );
+	static bool hashStageCountTable ( void *state );
+	static bool hashStagePosdb ( void *state );
+	static bool hashStageLinkdb ( void *state );
+
 	bool injectDoc ( const char *url ,
 			 class CollectionRec *cr ,
 			 char *content ,
@@ -12,6 +12,7 @@
 #include "Posdb.h"
 #include "Conf.h"
 #include "UrlBlockList.h"
+#include "JobDag.h"
 
 #ifdef _VALGRIND_
 #include <valgrind/memcheck.h>
@@ -46,7 +47,7 @@ public:
 		m_hashCommonWebWords	= true;
 		m_linkerSiteRank		= 0;
 	}
-	class HashTableX *m_tt;
+	class PosdbTermTable *m_tt;
 	const char		*m_prefix;
 	// "m_desc" should detail the algorithm
 	const char		*m_desc;
@@ -153,7 +154,7 @@ static bool storeTerm ( const char	*s        ,
 // . we do this "no splitting" so that only one disk seek is required, and
 //   we know the termlist is small, or the termlist is being used for spidering
 //   or parsing purposes and is usually not sent across the network.
-bool XmlDoc::hashNoSplit ( HashTableX *tt ) {
+bool XmlDoc::hashNoSplit ( PosdbTermTable *tt ) {
 	// constructor should set to defaults automatically
 	HashInfo hi;
 	hi.m_hashGroup = HASHGROUP_INTAG;
@@ -223,7 +224,7 @@ bool XmlDoc::hashNoSplit ( HashTableX *tt ) {
 // . returns -1 if blocked, returns NULL and sets g_errno on error
 // . "sr" is the tagdb Record
 // . "ws" store the terms for PageParser.cpp display
-char *XmlDoc::hashAll(HashTableX *table) {
+char *XmlDoc::hashAll(PosdbTermTable *table) {
 	logTrace(g_conf.m_logTraceXmlDoc, "BEGIN");
 
 	setStatus("hashing document");
@@ -233,7 +234,7 @@ char *XmlDoc::hashAll(HashTableX *table) {
 	}
 
 	// sanity checks
-	if (table->getKeySize() != 18 || table->getDataSize() != 4) {
+	if (!table->isInitialized()) {
 		g_process.shutdownAbort(true);
 	}
 
@@ -470,11 +471,192 @@ char *XmlDoc::hashAll(HashTableX *table) {
 }
 
 
+// state shared by the stages of hashDocument()
+struct HashStagesState {
+	XmlDoc         *m_doc;
+	PosdbTermTable *m_tt;
+	HashTableX     *m_kt;
+};
+
+// . hash the document terms into "tt" (posdb) and the outlinks into "kt"
+//   (linkdb). either can be NULL
+// . for large documents the independent parts run as parallel stages (see
+//   JobDag) instead of one after the other
+// . must not block
+// . returns false and sets g_errno on error
+bool XmlDoc::hashDocument ( PosdbTermTable *tt, HashTableX *kt ) {
+	int32_t minWords = g_conf.m_parallelIndexMinWords;
+
+	if ( ! tt || minWords <= 0 || m_allHashed || ! m_wordsValid ||
+	     m_words.getNumWords() < minWords ||
+	     ! prepareParallelHashing ( kt != NULL ) ) {
+		if ( tt ) {
+			char *nod = hashAll ( tt );
+
+			// you can't block here because if we are re-called we lose tt
+			if ( nod == (char *)-1 ) {
+				g_process.shutdownAbort(true);
+			}
+
+			if ( ! nod ) {
+				logTrace( g_conf.m_logTraceXmlDoc, "END, hashAll failed" );
+				return false;
+			}
+		}
+
+		if ( kt && ! hashLinksForLinkdb ( kt ) ) {
+			logTrace( g_conf.m_logTraceXmlDoc, "END, hashLinksForLinkdb failed" );
+			return false;
+		}
+
+		return true;
+	}
+
+	setStatus ( "hashing document in parallel" );
+
+	HashStagesState state;
+	state.m_doc = this;
+	state.m_tt  = tt;
+	state.m_kt  = kt;
+
+	// . the word spam and frag vectors only need the words, phrases and
+	//   bits which prepareParallelHashing() made. the count table needs
+	//   the frag vector and the posdb terms need all of them
+	// . the linkdb keys only need the links
+	JobDag dag ( "hashDocument" );
+	int spam = dag.addStage ( "wordSpam", hashStageWordSpam, &state );
+	int frag = dag.addStage ( "fragVec", hashStageFragVec, &state );
+	int count = dag.addStage ( "countTable", hashStageCountTable, &state, &frag, 1 );
+	int posdbDeps[] = { spam, frag, count };
+	dag.addStage ( "posdb", hashStagePosdb, &state, posdbDeps, 3 );
+	if ( kt ) {
+		dag.addStage ( "linkdb", hashStageLinkdb, &state );
+	}
+
+	// the stages would race on it
+	m_statusFrozen = true;
+	bool status = dag.run ( thread_type_spider_index, m_niceness );
+	m_statusFrozen = false;
+
+	if ( g_conf.m_logDebugBuildTime ) {
+		for ( int i = 0 ; i < dag.getNumStages() ; i++ ) {
+			log( LOG_DEBUG, "build: hashing stage %s took %" PRId64"us for %s",
+			     dag.getStageName(i), dag.getStageTime(i), m_firstUrl.getUrl() );
+		}
+		log( LOG_DEBUG, "build: hashing %" PRId32" words in parallel took %" PRId64"us for %s",
+		     m_words.getNumWords(), dag.getTotalTime(), m_firstUrl.getUrl() );
+	}
+
+	if ( ! status ) {
+		logTrace( g_conf.m_logTraceXmlDoc, "END, hashing stage failed" );
+		return false;
+	}
+
+	return true;
+}
+
+// . make everything the stages share before they run, so they only read it
+// . returns false if something is missing or would block, then we hash the
+//   usual way
+bool XmlDoc::prepareParallelHashing ( bool hashLinks ) {
+	uint8_t *ct = getContentType();
+	if ( ! ct || ct == (void *)-1 ) return false;
+
+	// these only hash the url
+	if ( *ct == CT_JSON || *ct == CT_XML ) return false;
+
+	if ( ! getCollRec() ) return false;
+
+	int8_t *hc = getHopCount();
+	if ( ! hc || hc == (void *)-1 ) return false;
+
+	Xml *xml = getXml();
+	if ( ! xml || xml == (void *)-1 ) return false;
+
+	Words *words = getWords();
+	if ( ! words || words == (void *)-1 ) return false;
+
+	Bits *bits = getBits();
+	if ( ! bits || bits == (void *)-1 ) return false;
+
+	Phrases *phrases = getPhrases();
+	if ( ! phrases || phrases == (void *)-1 ) return false;
+
+	Sections *sections = getSections();
+	if ( ! sections || sections == (void *)-1 ) return false;
+
+	Links *links = getLinks();
+	if ( ! links || links == (void *)-1 ) return false;
+
+	LinkInfo *info1 = getLinkInfo1();
+	if ( ! info1 || info1 == (void *)-1 ) return false;
+
+	int64_t *docId = getDocId();
+	if ( ! docId || docId == (void *)-1 ) return false;
+
+	int32_t *siteHash32 = getSiteHash32();
+	if ( ! siteHash32 || siteHash32 == (void *)-1 ) return false;
+
+	if ( m_wts ) {
+		uint8_t *lv = getLangVector();
+		if ( ! lv || lv == (void *)-1 ) return false;
+	}
+
+	if ( hashLinks ) {
+		if ( ! m_siteNumInlinksValid ) return false;
+
+		int32_t *linkSiteHashes = getLinkSiteHashes();
+		if ( ! linkSiteHashes || linkSiteHashes == (void *)-1 ) return false;
+
+		int32_t *ip = getIp();
+		if ( ! ip || ip == (void *)-1 ) return false;
+
+		getSpideredTime();
+	}
+
+	return true;
+}
+
+bool XmlDoc::hashStageWordSpam ( void *state ) {
+	XmlDoc *that = static_cast<HashStagesState *>(state)->m_doc;
+	char *wordSpamVec = that->getWordSpamVec();
+	if ( wordSpamVec == (void *)-1 ) { g_process.shutdownAbort(true); }
+	return ( wordSpamVec != NULL );
+}
+
+bool XmlDoc::hashStageFragVec ( void *state ) {
+	XmlDoc *that = static_cast<HashStagesState *>(state)->m_doc;
+	char *fragVec = that->getFragVec();
+	if ( fragVec == (void *)-1 ) { g_process.shutdownAbort(true); }
+	return ( fragVec != NULL );
+}
+
+bool XmlDoc::hashStageCountTable ( void *state ) {
+	XmlDoc *that = static_cast<HashStagesState *>(state)->m_doc;
+	HashTableX *cnt = that->getCountTable();
+	if ( cnt == (void *)-1 ) { g_process.shutdownAbort(true); }
+	return ( cnt != NULL );
+}
+
+bool XmlDoc::hashStagePosdb ( void *state ) {
+	HashStagesState *hs = static_cast<HashStagesState *>(state);
+	char *nod = hs->m_doc->hashAll ( hs->m_tt );
+	// you can't block here because if we are re-called we lose the table
+	if ( nod == (char *)-1 ) { g_process.shutdownAbort(true); }
+	return ( nod != NULL );
+}
+
+bool XmlDoc::hashStageLinkdb ( void *state ) {
+	HashStagesState *hs = static_cast<HashStagesState *>(state);
+	return hs->m_doc->hashLinksForLinkdb ( hs->m_kt );
+}
+
+
 bool XmlDoc::setSpiderStatusDocMetaList ( SafeBuf *jd , int64_t uqd ) {
 
 	// the posdb table
-	HashTableX tt4;
-	if ( !tt4.set(18,4,256,NULL,0,false,"posdb-spindx"))
+	PosdbTermTable tt4;
+	if ( !tt4.set(256))
 		return false;
 
 
@@ -506,7 +688,7 @@ bool XmlDoc::setSpiderStatusDocMetaList ( SafeBuf *jd , int64_t uqd ) {
 
 
 // returns false and sets g_errno on error
-bool XmlDoc::hashMetaTags ( HashTableX *tt ) {
+bool XmlDoc::hashMetaTags ( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing meta tags" );
 
@@ -644,7 +826,7 @@ bool XmlDoc::hashMetaTags ( HashTableX *tt ) {
 
 // . hash dates for sorting by using gbsortby: and gbrevsortby:
 // . do 'gbsortby:gbspiderdate' as your query to see this in action
-bool XmlDoc::hashDateNumbers ( HashTableX *tt ) { // , bool isStatusDoc ) {
+bool XmlDoc::hashDateNumbers ( PosdbTermTable *tt ) { // , bool isStatusDoc ) {
 
 	// stop if already set
 	if ( ! m_spideredTimeValid ) return true;
@@ -677,7 +859,7 @@ bool XmlDoc::hashDateNumbers ( HashTableX *tt ) { // , bool isStatusDoc ) {
 }
 
 // returns false and sets g_errno on error
-bool XmlDoc::hashContentType ( HashTableX *tt ) {
+bool XmlDoc::hashContentType ( PosdbTermTable *tt ) {
 
 	CollectionRec *cr = getCollRec();
 	if ( ! cr ) return false;
@@ -742,7 +924,7 @@ bool XmlDoc::hashContentType ( HashTableX *tt ) {
 // . NOTE: this is used in Msg18.cpp for extraction
 // . CAUTION: IndexList::score32to8() will warp our score if its >= 128
 //   so i moved the bits down
-bool XmlDoc::hashLinks ( HashTableX *tt ) {
+bool XmlDoc::hashLinks ( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing links" );
 
@@ -937,7 +1119,7 @@ bool XmlDoc::getUseTimeAxis ( ) {
 
 // . returns false and sets g_errno on error
 // . copied Url2.cpp into here basically, so we can now dump Url2.cpp
-bool XmlDoc::hashUrl ( HashTableX *tt, bool urlOnly ) { // , bool isStatusDoc ) {
+bool XmlDoc::hashUrl ( PosdbTermTable *tt, bool urlOnly ) { // , bool isStatusDoc ) {
 
 	setStatus ( "hashing url colon" );
 
@@ -1266,7 +1448,7 @@ bool XmlDoc::hashUrl ( HashTableX *tt, bool urlOnly ) { // , bool isStatusDoc )
 }
 
 // . returns false and sets g_errno on error
-bool XmlDoc::hashIncomingLinkText(HashTableX *tt) {
+bool XmlDoc::hashIncomingLinkText(PosdbTermTable *tt) {
 
 	setStatus ( "hashing link text" );
 
@@ -1347,7 +1529,7 @@ bool XmlDoc::hashIncomingLinkText(HashTableX *tt) {
 }
 
 // . returns false and sets g_errno on error
-bool XmlDoc::hashNeighborhoods ( HashTableX *tt ) {
+bool XmlDoc::hashNeighborhoods ( PosdbTermTable *tt ) {
 	setStatus ( "hashing neighborhoods" );
 
 	// . now we also hash the neighborhood text of each inlink, that is,
@@ -1397,7 +1579,7 @@ bool XmlDoc::hashNeighborhoods ( HashTableX *tt ) {
 //   does have an <index> block in the ruleset.
 // . the new Weights class hashes title as part of body now with a high weight
 //   given by "titleWeight" parm
-bool XmlDoc::hashTitle ( HashTableX *tt ) {
+bool XmlDoc::hashTitle ( PosdbTermTable *tt ) {
 	// sanity check
 	if ( m_hashedTitle ) { g_process.shutdownAbort(true); }
 
@@ -1463,7 +1645,7 @@ bool XmlDoc::hashTitle ( HashTableX *tt ) {
 //   than use the <index> block in the ruleset for titles.
 // . this is not to be confused with hashing the title: terms which still
 //   does have an <index> block in the ruleset.
-bool XmlDoc::hashBody2 ( HashTableX *tt ) {
+bool XmlDoc::hashBody2 ( PosdbTermTable *tt ) {
 
 	// do not index ANY of the body if it is NOT a permalink and
 	// "menu elimination" technology is enabled.
@@ -1484,7 +1666,7 @@ bool XmlDoc::hashBody2 ( HashTableX *tt ) {
 	return hashWords (&hi );
 }
 
-bool XmlDoc::hashMetaKeywords ( HashTableX *tt ) {
+bool XmlDoc::hashMetaKeywords ( PosdbTermTable *tt ) {
 
 	// do not index meta tags if "menu elimination" technology is enabled.
 	//if ( m_eliminateMenus ) return true;
@@ -1511,7 +1693,7 @@ bool XmlDoc::hashMetaKeywords ( HashTableX *tt ) {
 // . hash the meta summary, description and keyword tags
 // . we now do the title hashing here for newer titlerecs, version 80+, rather
 //   than use the <index> block in the ruleset for titles.
-bool XmlDoc::hashMetaSummary ( HashTableX *tt ) {
+bool XmlDoc::hashMetaSummary ( PosdbTermTable *tt ) {
 
 	// sanity check
 	if ( m_hashedMetas ) { g_process.shutdownAbort(true); }
@@ -1554,7 +1736,7 @@ bool XmlDoc::hashMetaSummary ( HashTableX *tt ) {
 }
 
 
-bool XmlDoc::hashMetaGeoPlacename( HashTableX *tt ) {
+bool XmlDoc::hashMetaGeoPlacename( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing meta geo.placename" );
 
@@ -1574,7 +1756,7 @@ bool XmlDoc::hashMetaGeoPlacename( HashTableX *tt ) {
 
 
 
-bool XmlDoc::hashLanguage ( HashTableX *tt ) {
+bool XmlDoc::hashLanguage ( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing language" );
 
@@ -1594,7 +1776,7 @@ bool XmlDoc::hashLanguage ( HashTableX *tt ) {
 	return true;
 }
 
-bool XmlDoc::hashLanguageString ( HashTableX *tt ) {
+bool XmlDoc::hashLanguageString ( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing language string" );
 
@@ -1615,7 +1797,7 @@ bool XmlDoc::hashLanguageString ( HashTableX *tt ) {
 	return true;
 }
 
-bool XmlDoc::hashCountry ( HashTableX *tt ) {
+bool XmlDoc::hashCountry ( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing country" );
 
@@ -1639,7 +1821,7 @@ bool XmlDoc::hashCountry ( HashTableX *tt ) {
 	return true;
 }
 
-bool XmlDoc::hashPermalink ( HashTableX *tt ) {
+bool XmlDoc::hashPermalink ( PosdbTermTable *tt ) {
 
 	setStatus ( "hashing is permalink" );
 
@@ -1657,7 +1839,7 @@ bool XmlDoc::hashPermalink ( HashTableX *tt ) {
 }
 
 // returns false and sets g_errno on error
-bool XmlDoc::hashIsAdult ( HashTableX *tt ) {
+bool XmlDoc::hashIsAdult ( PosdbTermTable *tt ) {
 
 	setStatus ("hashing isadult");
 
@@ -1705,9 +1887,7 @@ bool XmlDoc::hashSingleTerm( const char *s, int32_t slen, HashInfo *hi ) {
 
 
 	// shortcut
-	HashTableX *dt = hi->m_tt;
-	// sanity check
-	if ( dt->getKeySize() != sizeof(key144_t) ) { g_process.shutdownAbort(true); }
+	PosdbTermTable *dt = hi->m_tt;
 	// make the key like we do in hashWords()
 
 
@@ -1824,12 +2004,7 @@ bool XmlDoc::hashWords3( HashInfo *hi, const Words *words, Phrases *phrases, Sec
 	const uint64_t *wids    = reinterpret_cast<const uint64_t*>(words->getWordIds());
 	const uint64_t *pids2   = reinterpret_cast<const uint64_t*>(phrases->getPhraseIds2());
 
-	HashTableX *dt = hi->m_tt;
-
-	// . sanity checks
-	// . posdb just uses the full keys with docid
-	if ( dt->getKeySize() != 18 ) { g_process.shutdownAbort(true); }
-	if ( dt->getDataSize() != 4  ) { g_process.shutdownAbort(true); }
+	PosdbTermTable *dt = hi->m_tt;
 
 	// if provided...
 	if ( wts ) {
@@ -2251,7 +2426,7 @@ skipsingleword:
 
 bool XmlDoc::hashFieldMatchTerm ( char *val , int32_t vlen , HashInfo *hi ) {
 
-	HashTableX *tt = hi->m_tt;
+	PosdbTermTable *tt = hi->m_tt;
 
 	uint64_t val64 = hash64 ( val , vlen );
 
@@ -2288,7 +2463,7 @@ bool XmlDoc::hashFieldMatchTerm ( char *val , int32_t vlen , HashInfo *hi ) {
 			  false , // delkey?
 			  false ) ; // shardByTermId? no, by docid.
 
-	HashTableX *dt = tt;//hi->m_tt;
+	PosdbTermTable *dt = tt;//hi->m_tt;
 
 	// the key may indeed collide, but that's ok for this application
 	if ( ! dt->addTerm144 ( &k ) )
@@ -2444,7 +2619,7 @@ bool XmlDoc::hashNumberForSortingAsInt32 ( int32_t n , HashInfo *hi , const char
 	int32_t x = Posdb::getInt ( &k );
 	if ( x != n ) { g_process.shutdownAbort(true); }
 
-	HashTableX *dt = hi->m_tt;
+	PosdbTermTable *dt = hi->m_tt;
 
 	// the key may indeed collide, but that's ok for this application
 	if ( ! dt->addTerm144 ( &k ) )
@@ -6,6 +6,7 @@
 #define GB_HASH_H
 
 #include "Unicode.h"
+#include "AsciiSimd.h"
 
 //#define SEED8  148
 //#define SEED16 22081
@@ -124,6 +125,11 @@ static inline uint64_t hash64Lower_a ( const char *s, int32_t len,
 
 // utf8
 static inline uint64_t hash64Lower_utf8 ( const char *p, int32_t len, uint64_t startHash = 0) {
+	// most words are pure ascii, no need to look at the char sizes then
+	if ( isAscii ( p, len ) ) {
+		return hash64Lower_a ( p, len, startHash );
+	}
+
 	uint64_t h = startHash;
 	uint8_t i = 0;
 	const char *pend = p + len;
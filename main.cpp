@@ -79,6 +79,7 @@
 #include "Dir.h"
 #include "File.h"
 #include "UrlBlockList.h"
+#include "GbIoUring.h"
 #include <sys/stat.h> //umask()
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -1175,6 +1176,8 @@ int main2 ( int argc , char *argv[] ) {
 		log( LOG_ERROR, "db: JobScheduler init failed." );
 		return 1;
 	}
+	g_jobScheduler.set_adaptive_pools(g_conf.m_minCpuThreads, g_conf.m_minSummaryThreads, g_conf.m_minMergeThreads, g_conf.m_jobThreadIdleTimeout);
+	g_jobScheduler.set_work_stealing(g_conf.m_jobWorkStealing);
 	
 	//if ( ! g_hostdb.validateIps ( &g_conf ) ) {
 	//	log("db: Failed to validate ips." ); return 1;}
@@ -1194,6 +1197,14 @@ int main2 ( int argc , char *argv[] ) {
 		return 1;
 	}
 
+	// io_uring for disk i/o, needs g_loop for the completion callback
+	if ( g_conf.m_useIoUring ) {
+		if ( ! g_ioUring.initialize ( g_conf.m_ioUringQueueDepth ) || ! g_ioUring.registerLoopCallback() ) {
+			log( LOG_WARN, "db: io_uring not available. Using io threads for disk i/o." );
+			g_ioUring.finalize();
+		}
+	}
+
 	// the new way to save all rdbs and conf
 	// must call after Loop::init() so it can register its sleep callback
 	g_process.init();
@@ -0,0 +1 @@
+third-party/slacktee/slacktee.sh
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "Arena.h"
+#include "HashTableX.h"
+#include <string.h>
+
+TEST(ArenaTest, Alloc) {
+	Arena arena("arenatest");
+	EXPECT_EQ(0, arena.getUsed());
+	EXPECT_EQ(0, arena.getAllocated());
+
+	// aligned and not overlapping
+	char *a = (char *)arena.alloc(3);
+	char *b = (char *)arena.alloc(10);
+	ASSERT_TRUE(a != NULL);
+	ASSERT_TRUE(b != NULL);
+	EXPECT_EQ(0, (uintptr_t)a % 8);
+	EXPECT_EQ(0, (uintptr_t)b % 8);
+	EXPECT_EQ(a + 8, b);
+	EXPECT_EQ(24, arena.getUsed());
+	EXPECT_EQ(Arena::s_chunkSize, arena.getAllocated());
+
+	// fill up the first chunk and get another one
+	char *c = NULL;
+	for (int i = 0; i < 100; i++) {
+		c = (char *)arena.alloc(1024);
+		ASSERT_TRUE(c != NULL);
+		memset(c, i, 1024);
+	}
+	EXPECT_EQ(2 * Arena::s_chunkSize, arena.getAllocated());
+
+	// big allocations get a chunk of their own and don't end the current one
+	char *big = (char *)arena.alloc(Arena::s_chunkSize);
+	ASSERT_TRUE(big != NULL);
+	memset(big, 0, Arena::s_chunkSize);
+	char *d = (char *)arena.alloc(8);
+	EXPECT_EQ(c + 1024, d);
+	EXPECT_GT(arena.getAllocated(), 3 * Arena::s_chunkSize);
+
+	arena.clear();
+	EXPECT_EQ(0, arena.getUsed());
+	EXPECT_EQ(0, arena.getAllocated());
+}
+
+TEST(ArenaTest, ChunkReuse) {
+	Arena::releasePool();
+
+	int64_t misses = Arena::getNumPoolMisses();
+	int64_t hits = Arena::getNumPoolHits();
+
+	{
+		Arena arena;
+		arena.alloc(100);
+		arena.alloc(Arena::s_chunkSize / 2);
+	}
+	// only the standard chunk is pooled
+	EXPECT_EQ(1, Arena::getNumPooledChunks());
+	EXPECT_EQ(misses + 1, Arena::getNumPoolMisses());
+
+	{
+		Arena arena;
+		arena.alloc(100);
+		EXPECT_EQ(0, Arena::getNumPooledChunks());
+	}
+	EXPECT_EQ(hits + 1, Arena::getNumPoolHits());
+	EXPECT_EQ(1, Arena::getNumPooledChunks());
+
+	Arena::releasePool();
+	EXPECT_EQ(0, Arena::getNumPooledChunks());
+}
+
+TEST(ArenaTest, Rewind) {
+	Arena::releasePool();
+
+	Arena arena("arenatest");
+	// two standard chunks and a big one
+	for (int i = 0; i < 10; i++) {
+		ASSERT_TRUE(arena.alloc(Arena::s_chunkSize / 8) != NULL);
+	}
+	char *big = (char *)arena.alloc(Arena::s_chunkSize * 2);
+	ASSERT_TRUE(big != NULL);
+	size_t allocated = arena.getAllocated();
+	EXPECT_GT(allocated, 4 * Arena::s_chunkSize);
+
+	// keeps everything
+	arena.rewind(allocated);
+	EXPECT_EQ(0, arena.getUsed());
+	EXPECT_EQ(allocated, arena.getAllocated());
+	EXPECT_EQ(0, Arena::getNumPooledChunks());
+
+	// the same allocations again reuse the kept chunks
+	int64_t misses = Arena::getNumPoolMisses();
+	for (int i = 0; i < 10; i++) {
+		ASSERT_TRUE(arena.alloc(Arena::s_chunkSize / 8) != NULL);
+	}
+	ASSERT_TRUE(arena.alloc(Arena::s_chunkSize * 2) != NULL);
+	EXPECT_EQ(allocated, arena.getAllocated());
+	EXPECT_EQ(misses, Arena::getNumPoolMisses());
+
+	// keeps only the standard chunks that fit
+	arena.rewind(Arena::s_chunkSize);
+	EXPECT_EQ(Arena::s_chunkSize, arena.getAllocated());
+	EXPECT_EQ(1, Arena::getNumPooledChunks());
+
+	arena.clear();
+	EXPECT_EQ(0, arena.getAllocated());
+	EXPECT_EQ(2, Arena::getNumPooledChunks());
+
+	Arena::releasePool();
+}
+
+TEST(ArenaTest, SetTable) {
+	Arena arena("arenatest");
+
+	HashTableX ht;
+	ASSERT_TRUE(arena.setTable(&ht, 8, 4, 100, false, "arenatest", true));
+	EXPECT_EQ(HashTableX::getBufSize(8, 4, 100), (int32_t)arena.getUsed());
+	int32_t numSlots = ht.getNumSlots();
+
+	for (int64_t i = 0; i < 50; i++) {
+		int32_t v = (int32_t)i * 3;
+		ASSERT_TRUE(ht.addKey(&i, &v));
+	}
+	EXPECT_EQ(numSlots, ht.getNumSlots());
+	for (int64_t i = 0; i < 50; i++) {
+		const int32_t *v = (const int32_t *)ht.getValue(&i);
+		ASSERT_TRUE(v != NULL);
+		EXPECT_EQ(i * 3, *v);
+	}
+
+	// growing it moves it to the heap, the arena memory is not freed
+	for (int64_t i = 50; i < 1000; i++) {
+		int32_t v = (int32_t)i * 3;
+		ASSERT_TRUE(ht.addKey(&i, &v));
+	}
+	EXPECT_GT(ht.getNumSlots(), numSlots);
+	for (int64_t i = 0; i < 1000; i++) {
+		const int32_t *v = (const int32_t *)ht.getValue(&i);
+		ASSERT_TRUE(v != NULL);
+		EXPECT_EQ(i * 3, *v);
+	}
+
+	ht.reset();
+	arena.clear();
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "AsciiSimd.h"
+#include "hash.h"
+#include <random>
+#include <string>
+
+static int32_t asciiSpanLen( const std::string &s, size_t start ) {
+	size_t i = start;
+	while ( i < s.size() && s[i] != 0 && !( s[i] & 0x80 ) ) {
+		i++;
+	}
+	return i - start;
+}
+
+static int32_t alnumSpanLen( const std::string &s, size_t start ) {
+	size_t i = start;
+	while ( i < s.size() && isalnum( (unsigned char)s[i] ) ) {
+		i++;
+	}
+	return i - start;
+}
+
+static int32_t punctSpanLen( const std::string &s, size_t start, bool stopAtTag ) {
+	size_t i = start;
+	while ( i < s.size() && s[i] != 0 && !( s[i] & 0x80 ) && !isalnum( (unsigned char)s[i] ) &&
+	        !( stopAtTag && s[i] == '<' ) ) {
+		i++;
+	}
+	return i - start;
+}
+
+static bool isAsciiRef( const std::string &s, size_t start ) {
+	for ( size_t i = start; i < s.size(); i++ ) {
+		if ( s[i] & 0x80 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// mostly ascii with the odd utf8 byte, control char and nul
+static std::string makeString( std::mt19937 *rng, size_t len ) {
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ,.<>'\"-_\t\n@[`{/:";
+	std::string s;
+	for ( size_t i = 0; i < len; i++ ) {
+		uint32_t r = (*rng)() % 100;
+		if ( r == 0 ) {
+			s += (char)( 0x80 + (*rng)() % 0x80 );
+		} else if ( r == 1 ) {
+			s += (char)( (*rng)() % 0x20 );
+		} else if ( r == 2 ) {
+			s += (char)0x7f;
+		} else {
+			s += chars[(*rng)() % ( sizeof( chars ) - 1 )];
+		}
+	}
+	return s;
+}
+
+TEST(AsciiSimdTest, SpanLen) {
+	std::mt19937 rng( 1234 );
+	for ( int n = 0; n < 2000; n++ ) {
+		std::string s = makeString( &rng, rng() % 100 );
+		for ( size_t start = 0; start <= s.size(); start++ ) {
+			const char *p = s.data() + start;
+			int32_t len = s.size() - start;
+			EXPECT_EQ( asciiSpanLen( s, start ), getAsciiSpanLen( p, len ) );
+			EXPECT_EQ( alnumSpanLen( s, start ), getAsciiAlnumSpanLen( p, len ) );
+			EXPECT_EQ( punctSpanLen( s, start, false ), getAsciiPunctSpanLen( p, len, false ) );
+			EXPECT_EQ( punctSpanLen( s, start, true ), getAsciiPunctSpanLen( p, len, true ) );
+			EXPECT_EQ( isAsciiRef( s, start ), isAscii( p, len ) );
+		}
+	}
+}
+
+TEST(AsciiSimdTest, IsAscii) {
+	std::string s( 100, 'a' );
+	for ( size_t i = 0; i < s.size(); i++ ) {
+		s[i] = (char)0xc3;
+		for ( size_t len = 0; len <= s.size(); len++ ) {
+			EXPECT_EQ( len <= i, isAscii( s.data(), len ) );
+		}
+		s[i] = 'a';
+	}
+}
+
+TEST(AsciiSimdTest, Hash64LowerUtf8) {
+	hashinit();
+
+	// ascii words hash the same as before
+	const char *words[] = { "a", "Hello", "WORLD", "c++", "it's", "ThisIsAVeryLongWordWithMoreThan16Chars", "x1Y2z3" };
+	for ( size_t i = 0; i < sizeof( words ) / sizeof( words[0] ); i++ ) {
+		int32_t len = strlen( words[i] );
+		uint64_t expected = 0;
+		for ( int32_t j = 0; j < len; j++ ) {
+			expected ^= g_hashtab[(uint8_t)j][(uint8_t)tolower( (unsigned char)words[i][j] )];
+		}
+		EXPECT_EQ( expected, hash64Lower_utf8( words[i], len ) );
+		EXPECT_EQ( hash64Lower_utf8( words[i] ), hash64Lower_utf8( words[i], len ) );
+	}
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "EliasFano.h"
+#include <algorithm>
+#include <random>
+
+static std::vector<uint64_t> generateSortedValues(size_t count, uint64_t maxValue, unsigned seed) {
+	std::mt19937_64 rng(seed);
+	std::uniform_int_distribution<uint64_t> dist(0, maxValue);
+
+	std::vector<uint64_t> values;
+	for (size_t i = 0; i < count; i++) {
+		values.push_back(dist(rng));
+	}
+	std::sort(values.begin(), values.end());
+	return values;
+}
+
+TEST(EliasFanoTest, Empty) {
+	EliasFano ef;
+	ef.set(std::vector<uint64_t>());
+
+	EXPECT_TRUE(ef.empty());
+	EXPECT_EQ(0, ef.lowerBound(0));
+	EXPECT_EQ(0, ef.lowerBound(12345));
+
+	std::vector<uint64_t> decoded;
+	ef.decode(&decoded);
+	EXPECT_TRUE(decoded.empty());
+}
+
+TEST(EliasFanoTest, GetAndDecode) {
+	// docid+delbit values like the ones in an index file
+	std::vector<uint64_t> values = generateSortedValues(100000, (1ULL << 40) - 1, 1);
+
+	EliasFano ef;
+	ef.set(values);
+
+	ASSERT_EQ(values.size(), ef.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		ASSERT_EQ(values[i], ef.get(i));
+	}
+
+	std::vector<uint64_t> decoded;
+	ef.decode(&decoded);
+	EXPECT_EQ(values, decoded);
+
+	// ~2+log2(2^40/100000) bits per value instead of 64
+	EXPECT_LT(ef.getMemUsed() * 8 / values.size(), 27);
+}
+
+TEST(EliasFanoTest, LowerBound) {
+	std::vector<uint64_t> values = generateSortedValues(50000, 10000000, 2);
+
+	EliasFano ef;
+	ef.set(values);
+
+	std::mt19937_64 rng(3);
+	std::uniform_int_distribution<uint64_t> dist(0, 10000010);
+	for (int i = 0; i < 100000; i++) {
+		uint64_t value = (i < 1000) ? values[i * 50] : dist(rng);
+
+		size_t expected = std::lower_bound(values.begin(), values.end(), value) - values.begin();
+		uint64_t found = 0;
+		size_t pos = ef.lowerBound(value, &found);
+		ASSERT_EQ(expected, pos) << "value=" << value;
+		if (pos < values.size()) {
+			ASSERT_EQ(values[pos], found);
+		}
+	}
+}
+
+TEST(EliasFanoTest, Duplicates) {
+	std::vector<uint64_t> values = {0, 0, 5, 5, 5, 6, 1000, 1000};
+
+	EliasFano ef;
+	ef.set(values);
+
+	EXPECT_EQ(0, ef.lowerBound(0));
+	EXPECT_EQ(2, ef.lowerBound(1));
+	EXPECT_EQ(2, ef.lowerBound(5));
+	EXPECT_EQ(5, ef.lowerBound(6));
+	EXPECT_EQ(6, ef.lowerBound(7));
+	EXPECT_EQ(6, ef.lowerBound(1000));
+	EXPECT_EQ(8, ef.lowerBound(1001));
+}
+
+TEST(EliasFanoTest, Payload) {
+	std::vector<uint64_t> values = generateSortedValues(10000, 1ULL << 50, 4);
+
+	EliasFano ef;
+	ef.init(values.size(), values.back(), 9);
+	for (size_t i = 0; i < values.size(); i++) {
+		ef.append(values[i], i % 512);
+	}
+	ef.finalize();
+
+	for (size_t i = 0; i < values.size(); i++) {
+		ASSERT_EQ(values[i], ef.get(i));
+		ASSERT_EQ(i % 512, ef.getPayload(i));
+	}
+}
+
+TEST(EliasFanoTest, LargeValues) {
+	std::vector<uint64_t> values = {1, 0x7fffffffffffffffULL, 0xfffffffffffffff0ULL, 0xffffffffffffffffULL};
+
+	EliasFano ef;
+	ef.set(values);
+
+	for (size_t i = 0; i < values.size(); i++) {
+		EXPECT_EQ(values[i], ef.get(i));
+	}
+	EXPECT_EQ(2, ef.lowerBound(0x8000000000000000ULL));
+	EXPECT_EQ(3, ef.lowerBound(0xfffffffffffffff1ULL));
+}
+
+TEST(EliasFanoTest, Iterator) {
+	EliasFano::Iterator none(NULL);
+	uint64_t value;
+	uint64_t payload;
+	EXPECT_FALSE(none.next(&value));
+
+	std::vector<uint64_t> values = generateSortedValues(10000, 1ULL << 40, 5);
+
+	EliasFano ef;
+	ef.init(values.size(), values.back(), 9);
+	for (size_t i = 0; i < values.size(); i++) {
+		ef.append(values[i], i % 512);
+	}
+	ef.finalize();
+
+	EliasFano::Iterator it(&ef);
+	size_t i = 0;
+	while (it.next(&value, &payload)) {
+		ASSERT_LT(i, values.size());
+		ASSERT_EQ(values[i], value);
+		ASSERT_EQ(i % 512, payload);
+		i++;
+	}
+	EXPECT_EQ(values.size(), i);
+	EXPECT_FALSE(it.next(&value));
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "GbIoUring.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+static int s_numDone = 0;
+static int32_t s_results[8];
+
+static void ioDone(void *state, int32_t result) {
+	s_results[(intptr_t)state] = result;
+	s_numDone++;
+}
+
+TEST(GbIoUringTest, WriteRead) {
+	GbIoUring ring;
+	if (!ring.initialize(8)) {
+		// io_uring not available in this environment
+		return;
+	}
+
+	int fd = open("testfile_uring", O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_GE(fd, 0);
+
+	char buf[4][1024];
+	for (int i = 0; i < 4; i++) {
+		memset(buf[i], 'a' + i, sizeof(buf[i]));
+	}
+
+	s_numDone = 0;
+	for (intptr_t i = 0; i < 4; i++) {
+		unsigned flags = (i == 3) ? (GbIoUring::flag_datasync | GbIoUring::flag_drop_cache) : 0;
+		ASSERT_TRUE(ring.write(fd, buf[i], sizeof(buf[i]), i * sizeof(buf[i]), flags, (void *)i, ioDone));
+	}
+	ring.submit();
+	while (s_numDone < 4) {
+		ring.processCompletions(true);
+	}
+	for (int i = 0; i < 4; i++) {
+		EXPECT_EQ(1024, s_results[i]);
+	}
+	EXPECT_EQ(0U, ring.getNumInFlight());
+
+	char readBuf[5][1024];
+	s_numDone = 0;
+	for (intptr_t i = 0; i < 5; i++) {
+		ASSERT_TRUE(ring.read(fd, readBuf[i], sizeof(readBuf[i]), i * sizeof(readBuf[i]), (void *)i, ioDone));
+	}
+	ring.submit();
+	while (s_numDone < 5) {
+		ring.processCompletions(true);
+	}
+	for (int i = 0; i < 4; i++) {
+		EXPECT_EQ(1024, s_results[i]);
+		EXPECT_EQ(0, memcmp(buf[i], readBuf[i], sizeof(buf[i])));
+	}
+	// past end of file
+	EXPECT_EQ(0, s_results[4]);
+
+	ring.finalize();
+	close(fd);
+	unlink("testfile_uring");
+}
+
+static int s_numRetries = 0;
+
+static void retry() {
+	s_numRetries++;
+}
+
+TEST(GbIoUringTest, RetryAndCancel) {
+	GbIoUring ring;
+	if (!ring.initialize(4)) {
+		// io_uring not available in this environment
+		return;
+	}
+	ring.setRetryCallback(retry);
+
+	int fd = open("testfile_uring2", O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_GE(fd, 0);
+	char buf[64][64];
+	memset(buf, 'x', sizeof(buf));
+
+	// fill the ring until it refuses more
+	s_numDone = 0;
+	intptr_t numQueued = 0;
+	while (numQueued < 64 && ring.write(fd, buf[numQueued], sizeof(buf[numQueued]), numQueued * sizeof(buf[0]), 0, (void *)(numQueued % 8), ioDone)) {
+		numQueued++;
+	}
+	ASSERT_GT(numQueued, 0);
+	ASSERT_LT(numQueued, 64);
+
+	// completions make room and tell the user to try again
+	s_numRetries = 0;
+	ring.submit();
+	while (s_numDone < numQueued) {
+		ring.processCompletions(true);
+	}
+	EXPECT_GT(s_numRetries, 0);
+	EXPECT_TRUE(ring.write(fd, buf[0], sizeof(buf[0]), 0, 0, (void *)0, ioDone));
+
+	// finalize() doesn't call the callbacks of what is still in flight
+	int numDone = s_numDone;
+	ring.finalize();
+	EXPECT_EQ(numDone, s_numDone);
+	EXPECT_EQ(0U, ring.getNumInFlight());
+
+	close(fd);
+	unlink("testfile_uring2");
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "GbThreadQueue.h"
+#include <atomic>
+#include <vector>
+#include <unistd.h>
+
+static std::vector<size_t> s_batchSizes;
+static std::vector<intptr_t> s_items;
+static std::atomic<bool> s_blocked(false);
+static std::atomic<bool> s_started(false);
+
+static void processBatch(void **items, size_t numItems) {
+	s_started = true;
+
+	// hold up the first batch so the rest queue up behind it
+	while (s_blocked) {
+		usleep(1000);
+	}
+
+	s_batchSizes.push_back(numItems);
+	for (size_t i = 0; i < numItems; i++) {
+		s_items.push_back((intptr_t)items[i]);
+	}
+}
+
+TEST(GbThreadQueueTest, Batch) {
+	GbThreadQueue queue;
+	ASSERT_TRUE(queue.initialize(processBatch, 4, "test-batch"));
+
+	s_blocked = true;
+	queue.addItem((void *)(intptr_t)1);
+	while (!s_started) {
+		usleep(1000);
+	}
+	for (intptr_t i = 2; i <= 10; i++) {
+		queue.addItem((void *)i);
+	}
+	EXPECT_FALSE(queue.isEmpty());
+	s_blocked = false;
+
+	while (!queue.isEmpty()) {
+		usleep(1000);
+	}
+	queue.finalize();
+
+	// items are processed in order, in batches of at most 4
+	ASSERT_EQ(10U, s_items.size());
+	for (intptr_t i = 0; i < 10; i++) {
+		EXPECT_EQ(i + 1, s_items[i]);
+	}
+
+	size_t maxBatchSize = 0;
+	for (auto batchSize : s_batchSizes) {
+		maxBatchSize = std::max(maxBatchSize, batchSize);
+	}
+	EXPECT_EQ(4U, maxBatchSize);
+	EXPECT_LE(s_batchSizes.size(), 4U);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "JobDag.h"
+#include "Errno.h"
+#include <atomic>
+#include <unistd.h>
+
+struct StageState {
+	std::atomic<int> *m_counter;
+	int m_order;
+	bool m_fail;
+};
+
+static bool runStage(void *state) {
+	StageState *s = static_cast<StageState*>(state);
+	usleep(20000);
+	s->m_order = (*s->m_counter)++;
+	if (s->m_fail) {
+		g_errno = ENOMEM;
+		return false;
+	}
+	return true;
+}
+
+class JobDagTest : public ::testing::Test {
+protected:
+	void SetUp() {
+		g_jobScheduler.initialize(1, 2, 1, 1, 1, 1, 1);
+	}
+
+	void TearDown() {
+		g_jobScheduler.cleanup_finished_jobs();
+		g_jobScheduler.finalize();
+	}
+};
+
+TEST_F(JobDagTest, Dependencies) {
+	std::atomic<int> counter(0);
+	StageState a = {&counter, -1, false};
+	StageState b = {&counter, -1, false};
+	StageState c = {&counter, -1, false};
+	StageState d = {&counter, -1, false};
+
+	JobDag dag("test");
+	int sa = dag.addStage("a", runStage, &a);
+	int sb = dag.addStage("b", runStage, &b, &sa, 1);
+	int sc = dag.addStage("c", runStage, &c, &sa, 1);
+	int bc[] = {sb, sc};
+	int sd = dag.addStage("d", runStage, &d, bc, 2);
+	ASSERT_EQ(3, sd);
+
+	// only earlier stages can be depended on
+	int later = 7;
+	EXPECT_EQ(-1, dag.addStage("e", runStage, &d, &later, 1));
+
+	ASSERT_TRUE(dag.run(thread_type_spider_index, 0));
+	EXPECT_EQ(4, counter);
+	EXPECT_EQ(0, a.m_order);
+	EXPECT_LT(b.m_order, d.m_order);
+	EXPECT_LT(c.m_order, d.m_order);
+	EXPECT_EQ(3, d.m_order);
+
+	for (int i = 0; i < dag.getNumStages(); i++) {
+		EXPECT_GE(dag.getStageTime(i), 20000);
+	}
+
+	// b and c ran at the same time
+	EXPECT_LT(dag.getTotalTime(), 4 * 20000);
+
+	std::vector<JobDagStageStats> stats;
+	JobDag::getStats(&stats);
+	bool found = false;
+	for (auto const &s : stats) {
+		if (s.m_name == "test.d") {
+			found = true;
+			EXPECT_EQ(1, s.m_count);
+		}
+	}
+	EXPECT_TRUE(found);
+}
+
+TEST_F(JobDagTest, Failure) {
+	std::atomic<int> counter(0);
+	StageState a = {&counter, -1, false};
+	StageState b = {&counter, -1, true};
+	StageState c = {&counter, -1, false};
+
+	JobDag dag("fail");
+	int sa = dag.addStage("a", runStage, &a);
+	int sb = dag.addStage("b", runStage, &b, &sa, 1);
+	dag.addStage("c", runStage, &c, &sb, 1);
+
+	g_errno = 0;
+	EXPECT_FALSE(dag.run(thread_type_spider_index, 0));
+	EXPECT_EQ(ENOMEM, g_errno);
+	EXPECT_EQ(2, counter);
+	// skipped
+	EXPECT_EQ(-1, c.m_order);
+	EXPECT_EQ(-1, dag.getStageTime(2));
+}
+
+TEST(JobDagNoSchedulerTest, RunsInline) {
+	std::atomic<int> counter(0);
+	StageState a = {&counter, -1, false};
+	StageState b = {&counter, -1, false};
+
+	JobDag dag("inline");
+	dag.addStage("a", runStage, &a);
+	dag.addStage("b", runStage, &b);
+	ASSERT_TRUE(dag.run(thread_type_spider_index, 0));
+	EXPECT_EQ(2, counter);
+}
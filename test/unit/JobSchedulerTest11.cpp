@@ -0,0 +1,131 @@
+#include "JobScheduler.h"
+#include "Conf.h"
+#include "Mem.h"
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+static void msleep(int msecs) {
+	struct timespec ts;
+	ts.tv_sec = msecs/1000;
+	ts.tv_nsec = (msecs%1000)*1000000;
+	nanosleep(&ts,NULL);
+}
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool proceed = false;
+static int jobs_started = 0;
+static void start_routine(void *) {
+	pthread_mutex_lock(&mtx);
+	jobs_started++;
+	while(!proceed)
+		pthread_cond_wait(&cond,&mtx);
+	pthread_mutex_unlock(&mtx);
+}
+static void finish_routine(void *, job_exit_t) {
+}
+
+static int get_jobs_started() {
+	pthread_mutex_lock(&mtx);
+	int n = jobs_started;
+	pthread_mutex_unlock(&mtx);
+	return n;
+}
+
+static void release_jobs() {
+	pthread_mutex_lock(&mtx);
+	proceed = true;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mtx);
+}
+
+static void reset_jobs() {
+	pthread_mutex_lock(&mtx);
+	proceed = false;
+	jobs_started = 0;
+	pthread_mutex_unlock(&mtx);
+}
+
+int main(void) {
+	g_conf.m_maxMem = 1000000000LL;
+	g_mem.m_memtablesize = 8194*1024;
+	g_mem.init();
+	
+	//verify that idle summary and merge threads run queued cpu jobs
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,1,1,1);
+		js.set_work_stealing(true);
+		
+		for(int r=0; r<5; r++)
+			js.submit(start_routine, finish_routine, 0, thread_type_query_intersect, 0, 0);
+		msleep(200);
+		assert(get_jobs_started()==3);
+		assert(js.num_queued_jobs()==2);
+		
+		release_jobs();
+		msleep(200);
+		js.cleanup_finished_jobs();
+		assert(js.num_queued_jobs()==0);
+		
+		unsigned stolen = 0;
+		for(const auto &s : js.query_job_statistics(true))
+			stolen += s.second.stolen_count;
+		assert(stolen>=2);
+		
+		js.finalize();
+	}
+	
+	//but cpu and summary threads don't run merge jobs
+	{
+		reset_jobs();
+		JobScheduler js;
+		js.initialize(1,1,1,1,1,1,1);
+		js.set_work_stealing(true);
+		
+		for(int r=0; r<3; r++)
+			js.submit(start_routine, finish_routine, 0, thread_type_file_merge, 0, 0);
+		for(int r=0; r<3; r++)
+			js.submit(start_routine, finish_routine, 0, thread_type_query_intersect, 0, 0);
+		msleep(200);
+		assert(get_jobs_started()==3); //one merge, two intersect
+		assert(js.num_queued_jobs()==3);
+		
+		release_jobs();
+		msleep(200);
+		js.cleanup_finished_jobs();
+		assert(js.num_queued_jobs()==0);
+		js.finalize();
+	}
+	
+	//verify that idle pools shrink to the minimum and grow on demand
+	{
+		reset_jobs();
+		JobScheduler js;
+		js.initialize(1,4,4,1,1,1,4);
+		assert(js.num_pool_threads()==16);
+		
+		js.set_work_stealing(true);
+		js.set_adaptive_pools(1,0,1,100);
+		msleep(400);
+		assert(js.num_pool_threads()==6);
+		
+		for(int r=0; r<6; r++)
+			js.submit(start_routine, finish_routine, 0, thread_type_query_intersect, 0, 0);
+		msleep(200);
+		assert(get_jobs_started()==5); //the summary pool has no idle thread to steal with
+		assert(js.num_pool_threads()==9);
+		
+		release_jobs();
+		msleep(600);
+		js.cleanup_finished_jobs();
+		assert(js.num_pool_threads()==6);
+		
+		js.finalize();
+	}
+	
+	printf("success\n");
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include "JobScheduler.h"
+#include "Conf.h"
+#include "Mem.h"
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+static void msleep(int msecs) {
+	struct timespec ts;
+	ts.tv_sec = msecs/1000;
+	ts.tv_nsec = (msecs%1000)*1000000;
+	nanosleep(&ts,NULL);
+}
+
+static uint64_t now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+static char run_order[16];
+static int num_run = 0;
+static void start_routine_order(void *state) {
+	run_order[num_run++] = *(const char*)state;
+}
+static void start_routine_block(void *) {
+	msleep(100);
+}
+
+static volatile bool saw_cancel = false;
+static void start_routine_cooperative(void *) {
+	for(int i=0; i<100; i++) {
+		if(JobScheduler::is_job_cancelled()) {
+			saw_cancel = true;
+			return;
+		}
+		msleep(10);
+	}
+}
+
+static int num_cancelled = 0;
+static void finish_routine(void *, job_exit_t exit_type) {
+	if(exit_type==job_exit_cancelled)
+		num_cancelled++;
+}
+
+int main(void) {
+	g_conf.m_maxMem = 1000000000LL;
+	g_mem.m_memtablesize = 8194*1024;
+	g_mem.init();
+	
+	//verify that jobs with the same priority run earliest deadline first, and jobs without a deadline last
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,1,1,1);
+		
+		static const char a='a', b='b', c='c', d='d';
+		uint64_t now = now_ms();
+		js.submit(start_routine_block, finish_routine, NULL, thread_type_query_intersect, 0, 0);
+		js.submit(start_routine_order, finish_routine, (void*)&a, thread_type_query_intersect, 0, 0);
+		js.submit(start_routine_order, finish_routine, (void*)&b, thread_type_query_intersect, 0, now+5000);
+		js.submit(start_routine_order, finish_routine, (void*)&c, thread_type_query_intersect, 0, now+2000);
+		js.submit(start_routine_order, finish_routine, (void*)&d, thread_type_query_intersect, 1, now+1000);
+		
+		msleep(300);
+		assert(num_run==4);
+		assert(run_order[0]=='c');
+		assert(run_order[1]=='b');
+		assert(run_order[2]=='a');
+		assert(run_order[3]=='d');
+		
+		js.cleanup_finished_jobs();
+		js.finalize();
+	}
+	
+	//verify that cancelling a job group drops its queued jobs and tells the running ones
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,1,1,1);
+		
+		int group1, group2;
+		num_run = 0;
+		static const char a='a';
+		js.submit(start_routine_cooperative, finish_routine, NULL, thread_type_query_intersect, 0, 0, &group1);
+		js.submit(start_routine_order, finish_routine, (void*)&a, thread_type_query_intersect, 0, 0, &group1);
+		js.submit(start_routine_order, finish_routine, (void*)&a, thread_type_query_intersect, 0, 0, &group1);
+		js.submit(start_routine_order, finish_routine, (void*)&a, thread_type_query_intersect, 0, 0, &group2);
+		msleep(50);
+		assert(!saw_cancel);
+		
+		js.cancel_job_group(&group1);
+		msleep(100);
+		assert(saw_cancel);
+		assert(num_run==1); //only the group2 one
+		
+		js.cleanup_finished_jobs();
+		assert(num_cancelled==2);
+		assert(!JobScheduler::is_job_cancelled()); //not in a job
+		js.finalize();
+	}
+	
+	printf("success\n");
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "Mem.h"
+#include "Conf.h"
+#include "SafeBuf.h"
+#include <thread>
+#include <vector>
+
+static void allocAndFree(int32_t count) {
+	std::vector<char *> bufs;
+	for (int32_t i = 0; i < count; i++) {
+		size_t size = 1 + i % 300;
+		char *buf = (char *)mmalloc(size, "memtest");
+		ASSERT_TRUE(buf != NULL);
+		memset(buf, 0, size);
+		bufs.push_back(buf);
+	}
+	for (int32_t i = 0; i < count; i++) {
+		// the size is known without it
+		g_mem.gbfree(bufs[i], "memtest", 0, false);
+	}
+}
+
+TEST(MemTest, CountersWithoutTable) {
+	bool oldTableTracking = g_conf.m_memTableTracking;
+	g_conf.m_memTableTracking = false;
+
+	int32_t numAllocated = g_mem.getNumAllocated();
+	int64_t numTotalAllocated = g_mem.getNumTotalAllocated();
+
+	{
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; i++) {
+			threads.emplace_back(allocAndFree, 1000);
+		}
+		for (auto &thread : threads) {
+			thread.join();
+		}
+	}
+
+	EXPECT_EQ(numAllocated, g_mem.getNumAllocated());
+	EXPECT_LE(numTotalAllocated + 4000, g_mem.getNumTotalAllocated());
+
+	g_conf.m_memTableTracking = oldTableTracking;
+}
+
+TEST(MemTest, Breakdown) {
+	int32_t oldSampleRate = g_conf.m_memSampleRate;
+	g_conf.m_memSampleRate = 1;
+
+	char *buf = (char *)mmalloc(100000, "memtestbrkdwn");
+	ASSERT_TRUE(buf != NULL);
+	char *buf2 = (char *)mrealloc(buf, 100000, 200000, "memtestbrkdwn");
+	ASSERT_TRUE(buf2 != NULL);
+
+	SafeBuf sb;
+	EXPECT_TRUE(g_mem.printMemBreakdownTable(&sb));
+	EXPECT_TRUE(strstr(sb.getBufStart(), "memtestbrkdwn") != NULL);
+	EXPECT_TRUE(strstr(sb.getBufStart(), "Sampled Allocations") != NULL);
+
+	mfree(buf2, 200000, "memtestbrkdwn");
+
+	sb.reset();
+	EXPECT_TRUE(g_mem.printMemBreakdownTable(&sb));
+	EXPECT_TRUE(strstr(sb.getBufStart(), "memtestbrkdwn") == NULL);
+
+	g_conf.m_memSampleRate = oldSampleRate;
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "MulticastLatency.h"
+#include "Hostdb.h"
+
+TEST(MulticastLatencyTest, HostLatency) {
+	MulticastLatency latency;
+
+	Host h0, h1;
+	h0.m_hostId = 0;
+	h1.m_hostId = 1;
+
+	int64_t now = 100000;
+	EXPECT_EQ(-1, latency.getHostLatency(&h0, msg_type_39, now));
+
+	latency.addSample(&h0, msg_type_39, 100, false, true, now);
+	EXPECT_EQ(100, latency.getHostLatency(&h0, msg_type_39, now));
+	EXPECT_EQ(-1, latency.getHostLatency(&h1, msg_type_39, now));
+	EXPECT_EQ(-1, latency.getHostLatency(&h0, msg_type_20, now));
+
+	// ewma moves a quarter of the way
+	latency.addSample(&h0, msg_type_39, 20, false, true, now);
+	EXPECT_EQ(80, latency.getHostLatency(&h0, msg_type_39, now));
+
+	// a cancelled request can only make it slower
+	latency.addSample(&h0, msg_type_39, 10, true, true, now);
+	EXPECT_EQ(80, latency.getHostLatency(&h0, msg_type_39, now));
+	latency.addSample(&h0, msg_type_39, 400, true, true, now);
+	EXPECT_EQ(160, latency.getHostLatency(&h0, msg_type_39, now));
+
+	// forgotten after a while
+	EXPECT_EQ(-1, latency.getHostLatency(&h0, msg_type_39, now + 60000));
+	latency.addSample(&h0, msg_type_39, 30, false, true, now + 60000);
+	EXPECT_EQ(30, latency.getHostLatency(&h0, msg_type_39, now + 60000));
+}
+
+TEST(MulticastLatencyTest, Percentile95) {
+	MulticastLatency latency;
+
+	Host h;
+	h.m_hostId = 3;
+
+	EXPECT_EQ(-1, latency.getPercentile95(msg_type_0));
+
+	// not enough samples yet
+	for (int i = 0; i < 10; i++) {
+		latency.addSample(&h, msg_type_0, 1000, false, true, 1000);
+	}
+	EXPECT_EQ(-1, latency.getPercentile95(msg_type_0));
+
+	// 1..256ms, the oldest ones pushed out
+	for (int i = 1; i <= 256; i++) {
+		latency.addSample(&h, msg_type_0, i, false, true, 1000);
+	}
+	EXPECT_NEAR(243, latency.getPercentile95(msg_type_0), 16);
+
+	// replies from hedged twins don't count
+	for (int i = 0; i < 100; i++) {
+		latency.addSample(&h, msg_type_0, 1, false, false, 1000);
+		latency.addSample(&h, msg_type_0, 100000, true, false, 1000);
+	}
+	EXPECT_NEAR(243, latency.getPercentile95(msg_type_0), 16);
+
+	// a first send that lost to a hedge or timed out counts with its
+	// elapsed time
+	for (int i = 0; i < 32; i++) {
+		latency.addSample(&h, msg_type_0, 5000, true, true, 1000);
+	}
+	EXPECT_EQ(5000, latency.getPercentile95(msg_type_0));
+}
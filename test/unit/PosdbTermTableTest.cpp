@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "PosdbTermTable.h"
+#include "HashTableX.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static std::vector<key144_t> makeKeys(int32_t numKeys, int32_t numDistinct) {
+	std::mt19937_64 rng(1234);
+	std::vector<key144_t> distinct(numDistinct);
+	for (int32_t i = 0; i < numDistinct; i++) {
+		distinct[i].n2 = rng();
+		distinct[i].n1 = rng();
+		distinct[i].n0 = (uint16_t)rng();
+	}
+
+	std::vector<key144_t> keys(numKeys);
+	for (int32_t i = 0; i < numKeys; i++) {
+		keys[i] = distinct[rng() % numDistinct];
+	}
+	return keys;
+}
+
+TEST(PosdbTermTableTest, SameAsHashTableX) {
+	std::vector<key144_t> keys = makeKeys(20000, 5000);
+
+	HashTableX ht;
+	ASSERT_TRUE(ht.set(18, 4, 100, NULL, 0, false, "posdbtermtabletest"));
+
+	// starts small so it has to grow
+	PosdbTermTable tt;
+	ASSERT_TRUE(tt.set(10));
+	EXPECT_EQ(16, tt.getMaxTerms());
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		ASSERT_TRUE(ht.addTerm144(&keys[i]));
+		ASSERT_TRUE(tt.addTerm144(&keys[i]));
+	}
+
+	EXPECT_EQ(ht.getNumUsedSlots(), tt.getNumTerms());
+	EXPECT_EQ(ht.getKeyChecksum32(), tt.getKeyChecksum32());
+
+	// the same keys
+	std::vector<key144_t> htKeys;
+	for (int32_t i = 0; i < ht.getNumSlots(); i++) {
+		if (ht.m_flags[i]) {
+			htKeys.push_back(*(const key144_t *)ht.getKeyFromSlot(i));
+		}
+	}
+	tt.sortKeys();
+	std::sort(htKeys.begin(), htKeys.end(), [](const key144_t &a, const key144_t &b) {
+		return KEYCMP((const char *)&a, (const char *)&b, sizeof(key144_t)) < 0;
+	});
+	ASSERT_EQ((int32_t)htKeys.size(), tt.getNumTerms());
+	EXPECT_EQ(0, memcmp(&htKeys[0], tt.getKeys(), htKeys.size() * sizeof(key144_t)));
+}
+
+TEST(PosdbTermTableTest, SortKeys) {
+	std::vector<key144_t> keys = makeKeys(3000, 1000);
+
+	// with a buffer of our own
+	std::vector<char> buf(PosdbTermTable::getBufSize(1000));
+	PosdbTermTable tt;
+	ASSERT_TRUE(tt.set(1000, &buf[0], buf.size()));
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		ASSERT_TRUE(tt.addTerm144(&keys[i]));
+	}
+	EXPECT_EQ(1000, tt.getMaxTerms());
+	int32_t numTerms = tt.getNumTerms();
+	int32_t checksum = tt.getKeyChecksum32();
+
+	tt.sortKeys();
+	EXPECT_EQ(numTerms, tt.getNumTerms());
+	EXPECT_EQ(checksum, tt.getKeyChecksum32());
+	const key144_t *sorted = tt.getKeys();
+	for (int32_t i = 1; i < numTerms; i++) {
+		EXPECT_LT(KEYCMP((const char *)&sorted[i - 1], (const char *)&sorted[i], sizeof(key144_t)), 0);
+	}
+
+	// still finds the duplicates after sorting
+	for (size_t i = 0; i < keys.size(); i++) {
+		ASSERT_TRUE(tt.addTerm144(&keys[i]));
+	}
+	EXPECT_EQ(numTerms, tt.getNumTerms());
+
+	tt.reset();
+	EXPECT_FALSE(tt.isInitialized());
+	EXPECT_EQ(0, tt.getNumTerms());
+}
@@ -57,6 +57,12 @@ TEST_P(RdbBasePosdbIndexSingleDocTest, PosdbGenerateIndexSingleDocId) {
 	ASSERT_EQ(1, globalIndex->size());
 	int64_t result = (((docId << RdbIndex::s_docIdOffset) | (!termId2 == POSDB_DELETEDOC_TERMID)) << RdbBase::s_docIdFileIndex_docIdOffset | 2);
 	EXPECT_EQ(result, *globalIndex->begin());
+
+	RdbBase::GlobalIndexIterator it(base);
+	uint64_t key;
+	ASSERT_TRUE(it.next(&key));
+	EXPECT_EQ(result, key);
+	EXPECT_FALSE(it.next(&key));
 }
 
 TEST_F(RdbBaseTest, PosdbUpdateIndex) {
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "RdbCache.h"
+#include <thread>
+#include <vector>
+#include <atomic>
+
+static key96_t makeKey(uint64_t n) {
+	key96_t k;
+	k.n0 = n;
+	k.n1 = 0;
+	return k;
+}
+
+TEST(RdbCacheTest, Shards) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(8 * 1024 * 1024, 8, false, 100000, false, "testcache", false, 12, 12, -1, 4));
+	EXPECT_TRUE(cache.isInitialized());
+	EXPECT_EQ(4, cache.getNumShards());
+	EXPECT_EQ(8 * 1024 * 1024, cache.getMaxMem());
+	EXPECT_EQ(200000, cache.getNumTotalNodes());
+
+	for (uint64_t i = 1; i <= 1000; i++) {
+		key96_t k = makeKey(i);
+		int64_t value = i * 3;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		ASSERT_TRUE(cache.addRecord((collnum_t)0, k, (const char *)&value, 8));
+	}
+	EXPECT_EQ(1000, cache.getNumAdds());
+	EXPECT_EQ(1000, cache.getNumUsedNodes());
+
+	// locked lookups are routed to the right shard
+	for (uint64_t i = 1; i <= 1000; i++) {
+		key96_t k = makeKey(i);
+		char *rec;
+		int32_t recSize;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		ASSERT_TRUE(cache.getRecord((collnum_t)0, k, &rec, &recSize, false, -1, true));
+		EXPECT_EQ(8, recSize);
+		EXPECT_EQ((int64_t)i * 3, *(int64_t *)rec);
+	}
+
+	// and so are lock-free ones
+	for (uint64_t i = 1; i <= 1000; i++) {
+		key96_t k = makeKey(i);
+		int64_t value = 0;
+		int32_t recSize = 0;
+		ASSERT_TRUE(cache.peekRecord((collnum_t)0, (const char *)&k, (char *)&value, sizeof(value), &recSize, -1, true));
+		EXPECT_EQ(8, recSize);
+		EXPECT_EQ((int64_t)i * 3, value);
+	}
+
+	key96_t missing = makeKey(5000);
+	int64_t value;
+	int32_t recSize;
+	EXPECT_FALSE(cache.peekRecord((collnum_t)0, (const char *)&missing, (char *)&value, sizeof(value), &recSize, -1, true));
+
+	// wrong collection
+	key96_t k = makeKey(1);
+	EXPECT_FALSE(cache.peekRecord((collnum_t)1, (const char *)&k, (char *)&value, sizeof(value), &recSize, -1, true));
+
+	EXPECT_EQ(2000, cache.getNumHits());
+	EXPECT_EQ(2, cache.getNumMisses());
+	EXPECT_EQ(2000, cache.getNumLockAcquires());
+	EXPECT_EQ(1002, cache.getNumLockFreeReads());
+	EXPECT_EQ(0, cache.getNumLockFreeFallbacks());
+
+	// clearing a collection clears it in all shards
+	cache.clear((collnum_t)0);
+	EXPECT_FALSE(cache.peekRecord((collnum_t)0, (const char *)&k, (char *)&value, sizeof(value), &recSize, -1, false));
+}
+
+TEST(RdbCacheTest, SmallCacheIsNotSharded) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(200 * 1024, 8, false, 1000, false, "testcache", false, 12, 12, -1, 16));
+	EXPECT_EQ(1, cache.getNumShards());
+
+	key96_t k = makeKey(42);
+	int64_t value = 4242;
+	{
+		RdbCacheLock rcl(cache);
+		ASSERT_TRUE(cache.addRecord((collnum_t)0, k, (const char *)&value, 8));
+	}
+
+	int64_t got = 0;
+	int32_t recSize = 0;
+	EXPECT_TRUE(cache.peekRecord((collnum_t)0, (const char *)&k, (char *)&got, sizeof(got), &recSize, -1, false));
+	EXPECT_EQ(4242, got);
+
+	// doesn't fit
+	char small[4];
+	EXPECT_FALSE(cache.peekRecord((collnum_t)0, (const char *)&k, small, sizeof(small), &recSize, -1, false));
+}
+
+TEST(RdbCacheTest, ConcurrentPeekAndAdd) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(4 * 1024 * 1024, 8, false, 2000, false, "testcache", false, 12, 12, -1, 4));
+
+	// . writers keep overwriting a small key space so the ring buffers wrap
+	//   while the readers look without the lock
+	// . the value is always derived from the key so a torn read shows
+	std::atomic<bool> stop(false);
+	std::atomic<int64_t> found(0);
+	std::atomic<int64_t> bad(0);
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 2; t++) {
+			threads.push_back(std::thread([&cache, &stop, t]() {
+				for (uint64_t i = 0; !stop; i++) {
+					uint64_t n = (i * 7 + t) % 5000 + 1;
+					key96_t k = makeKey(n);
+					int64_t value = n * 11;
+					RdbCacheLock rcl(cache, (const char *)&k);
+					cache.addRecord((collnum_t)0, k, (const char *)&value, 8);
+				}
+			}));
+		}
+		for (int t = 0; t < 4; t++) {
+			threads.push_back(std::thread([&cache, &found, &bad, t]() {
+				for (uint64_t i = 0; i < 200000; i++) {
+					uint64_t n = (i * 13 + t) % 5000 + 1;
+					key96_t k = makeKey(n);
+					int64_t value;
+					int32_t recSize;
+					if (cache.peekRecord((collnum_t)0, (const char *)&k, (char *)&value, sizeof(value), &recSize, -1, true)) {
+						found++;
+						if (recSize != 8 || value != (int64_t)n * 11) {
+							bad++;
+						}
+					}
+				}
+			}));
+		}
+		for (size_t i = 2; i < threads.size(); i++) {
+			threads[i].join();
+		}
+		stop = true;
+		threads[0].join();
+		threads[1].join();
+	}
+
+	EXPECT_EQ(0, bad);
+	EXPECT_GT(found, 0);
+	EXPECT_EQ(800000, cache.getNumLockFreeReads() + cache.getNumLockFreeFallbacks());
+	EXPECT_EQ(800000, cache.getNumHits() + cache.getNumMisses());
+}
+
+TEST(RdbCacheTest, ConcurrentPeekAndReinit) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(1024 * 1024, 8, false, 1000, false, "testcache", false, 12, 12, -1, 1));
+
+	// . the writer keeps replacing the hash table and buffers while the
+	//   readers look without the lock
+	std::atomic<bool> stop(false);
+	std::atomic<int64_t> bad(0);
+	{
+		std::vector<std::thread> threads;
+		threads.push_back(std::thread([&cache, &stop]() {
+			for (int32_t i = 0; !stop; i++) {
+				int32_t maxRecs = (i % 2) ? 500 : 2000;
+				RdbCacheLock rcl(cache);
+				if (!cache.init(1024 * 1024, 8, false, maxRecs, false, "testcache", false, 12, 12, -1, 1)) {
+					return;
+				}
+				for (uint64_t n = 1; n <= 200; n++) {
+					key96_t k = makeKey(n);
+					int64_t value = n * 11;
+					cache.addRecord((collnum_t)0, k, (const char *)&value, 8);
+				}
+			}
+		}));
+		for (int t = 0; t < 4; t++) {
+			threads.push_back(std::thread([&cache, &bad, t]() {
+				for (uint64_t i = 0; i < 200000; i++) {
+					uint64_t n = (i * 13 + t) % 200 + 1;
+					key96_t k = makeKey(n);
+					int64_t value;
+					int32_t recSize;
+					if (cache.peekRecord((collnum_t)0, (const char *)&k, (char *)&value, sizeof(value), &recSize, -1, true)) {
+						if (recSize != 8 || value != (int64_t)n * 11) {
+							bad++;
+						}
+					}
+				}
+			}));
+		}
+		for (size_t i = 1; i < threads.size(); i++) {
+			threads[i].join();
+		}
+		stop = true;
+		threads[0].join();
+	}
+
+	EXPECT_EQ(0, bad);
+}
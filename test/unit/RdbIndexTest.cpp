@@ -257,3 +257,44 @@ TEST(RdbIndexTest, DeleteAddKeySave) {
 	// cleanup
 	index.unlink();
 }
+
+TEST(RdbIndexTest, PackDocIds) {
+	RdbBuckets buckets;
+	buckets.set(Posdb::getFixedDataSize(), 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+
+	static const int64_t termId = 1;
+	static const int total_records = 1000;
+	for (int i = 0; i < total_records; ++i) {
+		GbTest::addPosdbKey(&buckets, termId, i * 7 + 3, 0, (i % 5 == 0));
+	}
+
+	RdbIndex index;
+	index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, false);
+	index.generateIndex(0, &buckets);
+
+	auto unpackedDocIds = index.getDocIds();
+	size_t unpackedMemUsed = index.getMemUsed();
+
+	index.packDocIds();
+	EXPECT_TRUE(index.isPacked());
+	EXPECT_LT(index.getMemUsed(), unpackedMemUsed);
+
+	auto docIds = index.getDocIds();
+	EXPECT_EQ(*unpackedDocIds, *docIds);
+	EXPECT_EQ(unpackedDocIds->size(), index.getNumDocIds());
+
+	for (int i = 0; i < total_records; ++i) {
+		EXPECT_TRUE(index.exist(i * 7 + 3));
+		EXPECT_FALSE(index.exist(i * 7 + 4));
+	}
+
+	// adding to a packed index unpacks it on next merge
+	GbTest::addPosdbKey(&index, termId, 1, 0);
+	index.writeIndex(true);
+	EXPECT_FALSE(index.isPacked());
+	EXPECT_EQ(total_records + 1, index.getDocIds()->size());
+	EXPECT_EQ(total_records + 1, index.getNumDocIds());
+
+	// cleanup
+	index.unlink();
+}
@@ -0,0 +1,348 @@
+#include <gtest/gtest.h>
+#include <fctypes.h>
+#include <Mem.h>
+#include <sort.h>
+#include "RdbSkipList.h"
+#include "RdbList.h"
+#include "Log.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static int keycmp(const void *p1, const void *p2) {
+	// returns 0 if equal, -1 if p1 < p2, +1 if p1 > p2
+	if ( *(key96_t *)p1 < *(key96_t *)p2 ) return -1;
+	if ( *(key96_t *)p1 > *(key96_t *)p2 ) return  1;
+	return 0;
+}
+
+static key96_t makeKey(uint32_t n1, uint64_t n0, bool positive = true) {
+	key96_t k;
+	k.n1 = n1;
+	k.n0 = (n0 << 1) | (positive ? 0x01 : 0x00);
+	return k;
+}
+
+static int32_t getAllKeys(const RdbSkipList *list, std::vector<key96_t> *keys) {
+	int32_t numPosRecs = 0;
+	int32_t numNegRecs = 0;
+
+	RdbList rdbList;
+	if (!list->getList(0, KEYMIN(), KEYMAX(), -1, &rdbList, &numPosRecs, &numNegRecs, false)) {
+		return -1;
+	}
+
+	keys->clear();
+	for (rdbList.resetListPtr(); !rdbList.isExhausted(); rdbList.skipCurrentRecord()) {
+		key96_t k;
+		rdbList.getCurrentKey(&k);
+		keys->push_back(k);
+	}
+	return numPosRecs + numNegRecs;
+}
+
+// ported from RdbTreeTest
+TEST(RdbSkipListTest, HashTest) {
+	int32_t numKeys = 500000;
+	log(LOG_INFO, "db: speedtest: generating %" PRId32" random keys.", numKeys);
+
+	// seed randomizer
+	srand((int32_t)gettimeofdayInMilliseconds());
+
+	// make list of one million random keys
+	key96_t *k = (key96_t *)mmalloc(sizeof(key96_t) * numKeys, "main");
+	ASSERT_TRUE(k);
+
+	int32_t *r = (int32_t *)(void *)k;
+	int32_t first = 0;
+	for (int32_t i = 0; i < numKeys * 3; i++) {
+		if ((i % 3) == 2 && first++ < 50000) {
+			r[i] = 1234567;
+		} else
+			r[i] = rand();
+	}
+
+	// init the list
+	RdbSkipList rt;
+	ASSERT_TRUE(rt.set(0, numKeys + 1000, numKeys * 40, false, "tree-test"));
+
+	// add to regular list
+	int64_t t = gettimeofdayInMilliseconds();
+	for (int32_t i = 0; i < numKeys; i++) {
+		ASSERT_TRUE(rt.addNode((collnum_t)0, (const char *)&(k[i]), NULL, 0));
+	}
+	// print time it took
+	int64_t e = gettimeofdayInMilliseconds();
+	log(LOG_INFO, "db: added %" PRId32" keys to rdb skiplist in %" PRId64" ms", numKeys, e - t);
+
+	// sort the list of keys
+	t = gettimeofdayInMilliseconds();
+	gbsort(k, numKeys, sizeof(key96_t), keycmp);
+	// print time it took
+	e = gettimeofdayInMilliseconds();
+	log(LOG_INFO, "db: sorted %" PRId32" in %" PRId64" ms", numKeys, e - t);
+
+	ScopedReadLock sl(rt.getLock());
+
+	// get the list
+	key96_t kk;
+	kk.n0 = 0LL;
+	kk.n1 = 1234567;
+	int32_t n = rt.getNextNode_unlocked((collnum_t)0, (char *)&kk);
+	// loop it
+	t = gettimeofdayInMilliseconds();
+	int32_t count = 0;
+	while (n >= 0 && --first >= 0) {
+		n = rt.getNextNode_unlocked(n);
+		count++;
+	}
+	e = gettimeofdayInMilliseconds();
+	log(LOG_INFO, "db: getList for %" PRId32" nodes in %" PRId64" ms", count, e - t);
+
+	// all nodes are in key order
+	int32_t numNodes = 0;
+	int32_t prev = -1;
+	for (n = rt.getFirstNode_unlocked(); n >= 0; n = rt.getNextNode_unlocked(n)) {
+		if (prev >= 0) {
+			ASSERT_LT(KEYCMP(rt.getKey_unlocked(prev), rt.getKey_unlocked(n), sizeof(key96_t)), 0);
+		}
+		prev = n;
+		numNodes++;
+	}
+	EXPECT_EQ(rt.getNumUsedNodes(), numNodes);
+	EXPECT_TRUE(rt.checkTree_unlocked(true, true));
+
+	mfree(k, sizeof(key96_t) * numKeys, "main");
+}
+
+TEST(RdbSkipListTest, AddReplaceDelete) {
+	RdbSkipList list;
+	ASSERT_TRUE(list.set(-1, 100, 1024 * 1024, false, "skiplist-test"));
+
+	static char data1[] = "one";
+	static char data2[] = "second";
+
+	key96_t k1 = makeKey(1, 1);
+	key96_t k2 = makeKey(1, 2);
+	ASSERT_TRUE(list.addNode(0, (const char *)&k2, data1, sizeof(data1)));
+	ASSERT_TRUE(list.addNode(0, (const char *)&k1, data1, sizeof(data1)));
+	EXPECT_EQ(2, list.getNumUsedNodes());
+	EXPECT_EQ(2, list.getNumPositiveKeys());
+	EXPECT_TRUE(list.getNode(0, (const char *)&k1));
+
+	// replace
+	ASSERT_TRUE(list.addNode(0, (const char *)&k1, data2, sizeof(data2)));
+	EXPECT_EQ(2, list.getNumUsedNodes());
+	{
+		ScopedReadLock sl(list.getLock());
+		int32_t n = list.getFirstNode_unlocked();
+		ASSERT_GE(n, 0);
+		EXPECT_EQ(data2, list.getData_unlocked(n));
+		EXPECT_EQ((int32_t)sizeof(data2), list.getDataSize_unlocked(n));
+	}
+
+	// delete
+	EXPECT_TRUE(list.deleteNode(0, (const char *)&k1, true));
+	EXPECT_FALSE(list.deleteNode(0, (const char *)&k1, true));
+	EXPECT_FALSE(list.getNode(0, (const char *)&k1));
+	EXPECT_EQ(1, list.getNumUsedNodes());
+	EXPECT_EQ(1, list.getNumDeletedNodes());
+
+	std::vector<key96_t> keys;
+	EXPECT_EQ(1, getAllKeys(&list, &keys));
+	ASSERT_EQ(1U, keys.size());
+	EXPECT_EQ(k2, keys[0]);
+
+	// re-adding the key revives the deleted node
+	ASSERT_TRUE(list.addNode(0, (const char *)&k1, data1, sizeof(data1)));
+	EXPECT_EQ(2, list.getNumUsedNodes());
+	EXPECT_EQ(0, list.getNumDeletedNodes());
+
+	// negative key is a different key
+	key96_t k1neg = makeKey(1, 1, false);
+	ASSERT_TRUE(list.addNode(0, (const char *)&k1neg, NULL, 0));
+	EXPECT_EQ(3, list.getNumUsedNodes());
+	EXPECT_EQ(1, list.getNumNegativeKeys());
+
+	EXPECT_EQ(3, getAllKeys(&list, &keys));
+	ASSERT_EQ(3U, keys.size());
+	EXPECT_EQ(k1neg, keys[0]);
+	EXPECT_EQ(k1, keys[1]);
+	EXPECT_EQ(k2, keys[2]);
+
+	EXPECT_EQ(3, list.clear());
+	EXPECT_EQ(0, list.getNumUsedNodes());
+	EXPECT_EQ(0, getAllKeys(&list, &keys));
+}
+
+TEST(RdbSkipListTest, GetListMinRecSizes) {
+	RdbSkipList list;
+	ASSERT_TRUE(list.set(0, 1000, 1024 * 1024, false, "skiplist-test"));
+
+	for (int i = 0; i < 100; i++) {
+		key96_t k = makeKey(0, i);
+		ASSERT_TRUE(list.addNode(0, (const char *)&k, NULL, 0));
+	}
+
+	key96_t startKey = makeKey(0, 10, false);
+	key96_t endKey = makeKey(0, 50);
+
+	RdbList rdbList;
+	int32_t numPosRecs = 0;
+	int32_t numNegRecs = 0;
+	ASSERT_TRUE(list.getList(0, (const char *)&startKey, (const char *)&endKey, 10 * sizeof(key96_t), &rdbList,
+	                         &numPosRecs, &numNegRecs, false));
+	EXPECT_EQ(10, numPosRecs);
+	EXPECT_EQ(0, numNegRecs);
+
+	// end key is moved to the last key in the list
+	key96_t lastKey = makeKey(0, 19);
+	EXPECT_EQ(0, KEYCMP(rdbList.getEndKey(), (const char *)&lastKey, sizeof(key96_t)));
+
+	int i = 10;
+	for (rdbList.resetListPtr(); !rdbList.isExhausted(); rdbList.skipCurrentRecord(), i++) {
+		key96_t k;
+		rdbList.getCurrentKey(&k);
+		EXPECT_EQ(makeKey(0, i), k);
+	}
+	EXPECT_EQ(20, i);
+
+	// exact below 200 keys
+	EXPECT_EQ(41 * (int32_t)sizeof(key96_t), list.estimateListSize(0, (const char *)&startKey, (const char *)&endKey, NULL, NULL));
+}
+
+TEST(RdbSkipListTest, PurgeReusesNodes) {
+	RdbSkipList list;
+	ASSERT_TRUE(list.set(0, 100, 1024 * 1024, false, "skiplist-test"));
+
+	for (int i = 0; i < 100; i++) {
+		key96_t k = makeKey(0, i);
+		ASSERT_TRUE(list.addNode(0, (const char *)&k, NULL, 0));
+	}
+
+	key96_t extra = makeKey(0, 1000);
+	EXPECT_FALSE(list.addNode(0, (const char *)&extra, NULL, 0));
+
+	for (int i = 0; i < 50; i++) {
+		key96_t k = makeKey(0, i);
+		ASSERT_TRUE(list.deleteNode(0, (const char *)&k, true));
+	}
+	EXPECT_EQ(50, list.getNumAvailNodes());
+
+	// deleted nodes are purged and reused when we run out
+	for (int i = 0; i < 50; i++) {
+		key96_t k = makeKey(0, 1000 + i);
+		ASSERT_TRUE(list.addNode(0, (const char *)&k, NULL, 0));
+	}
+	EXPECT_EQ(100, list.getNumUsedNodes());
+	EXPECT_EQ(0, list.getNumDeletedNodes());
+
+	std::vector<key96_t> keys;
+	EXPECT_EQ(100, getAllKeys(&list, &keys));
+	EXPECT_EQ(makeKey(0, 50), keys.front());
+	EXPECT_EQ(makeKey(0, 1049), keys.back());
+
+	ScopedWriteLock sl(list.getLock());
+	EXPECT_TRUE(list.checkTree_unlocked(true, true));
+}
+
+TEST(RdbSkipListTest, ConcurrentAddAndRead) {
+	static const int numWriters = 4;
+	static const int numKeysPerWriter = 50000;
+
+	RdbSkipList list;
+	ASSERT_TRUE(list.set(0, numWriters * numKeysPerWriter, -1, false, "skiplist-test"));
+
+	std::atomic<bool> done(false);
+	std::atomic<int> numBadReads(0);
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 2; r++) {
+		readers.emplace_back([&]() {
+			int32_t lastCount = 0;
+			while (!done) {
+				std::vector<key96_t> keys;
+				int32_t count = getAllKeys(&list, &keys);
+				// sorted, no duplicates and never shrinking
+				for (size_t i = 1; i < keys.size(); i++) {
+					if (!(keys[i - 1] < keys[i])) {
+						numBadReads++;
+					}
+				}
+				if (count < lastCount || count != (int32_t)keys.size()) {
+					numBadReads++;
+				}
+				lastCount = count;
+			}
+		});
+	}
+
+	std::vector<std::thread> writers;
+	for (int w = 0; w < numWriters; w++) {
+		writers.emplace_back([&list, w]() {
+			// interleave the writers' keys so they insert next to each other
+			for (int i = 0; i < numKeysPerWriter; i++) {
+				key96_t k = makeKey(0, (uint64_t)i * numWriters + w);
+				list.addNode(0, (const char *)&k, NULL, 0);
+			}
+		});
+	}
+
+	for (auto &t : writers) {
+		t.join();
+	}
+	done = true;
+	for (auto &t : readers) {
+		t.join();
+	}
+
+	EXPECT_EQ(0, numBadReads);
+	EXPECT_EQ(numWriters * numKeysPerWriter, list.getNumUsedNodes());
+
+	std::vector<key96_t> keys;
+	EXPECT_EQ(numWriters * numKeysPerWriter, getAllKeys(&list, &keys));
+	for (size_t i = 0; i < keys.size(); i++) {
+		ASSERT_EQ(makeKey(0, i), keys[i]);
+	}
+
+	ScopedWriteLock sl(list.getLock());
+	EXPECT_TRUE(list.checkTree_unlocked(true, true));
+}
+
+TEST(RdbSkipListTest, ConcurrentAddAndDeleteSameKeys) {
+	static const int numThreads = 4;
+	static const int numKeys = 1000;
+
+	RdbSkipList list;
+	ASSERT_TRUE(list.set(0, numKeys * 2, -1, false, "skiplist-test"));
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < numThreads; t++) {
+		threads.emplace_back([&list, t]() {
+			for (int round = 0; round < 20; round++) {
+				for (int i = 0; i < numKeys; i++) {
+					key96_t k = makeKey(0, i);
+					if ((i + round + t) % 3 == 0) {
+						list.deleteNode(0, (const char *)&k, true);
+					} else {
+						list.addNode(0, (const char *)&k, NULL, 0);
+					}
+				}
+			}
+		});
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+
+	std::vector<key96_t> keys;
+	int32_t count = getAllKeys(&list, &keys);
+	EXPECT_EQ(list.getNumUsedNodes(), count);
+	EXPECT_EQ(list.getNumPositiveKeys(), count);
+	for (size_t i = 1; i < keys.size(); i++) {
+		ASSERT_LT(keys[i - 1], keys[i]);
+	}
+
+	ScopedWriteLock sl(list.getLock());
+	EXPECT_TRUE(list.checkTree_unlocked(true, true));
+}
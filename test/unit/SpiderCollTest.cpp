@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+#include "SpiderColl.h"
+#include "SpiderCache.h"
+#include "Spider.h"
+#include "Doledb.h"
+#include "GigablastTestUtils.h"
+#include "Lang.h"
+#include "fctypes.h"
+#include "ScopedLock.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+static const int32_t s_firstIp = 0x0100007f;
+
+class SpiderCollTest : public ::testing::Test {
+protected:
+	void SetUp() {
+		GbTest::initializeRdbs();
+
+		m_sc = g_spiderCache.getSpiderColl(0);
+		ASSERT_TRUE(m_sc != NULL);
+		ASSERT_TRUE(isAssignedToUs(s_firstIp));
+
+		// like populateDoledbFromWaitingTree() does
+		ASSERT_TRUE(m_sc->m_winnerTree.set(-1, MAX_WINNER_NODES, MAX_WINNER_NODES * MAX_BEST_REQUEST_SIZE, true,
+		                                   "wintree", NULL, sizeof(key192_t), -1));
+		ASSERT_TRUE(m_sc->m_winnerTable.set(8, sizeof(key192_t), 64, NULL, 0, false, "wtdedup"));
+
+		m_now = gettimeofdayInMilliseconds() / 1000;
+	}
+
+	void TearDown() {
+		GbTest::resetRdbs();
+	}
+
+	int64_t addRequest(int32_t n, uint32_t addedTime, int16_t hopCount, int64_t parentDocId) {
+		SpiderRequest sreq;
+		sreq.reset();
+		sprintf(sreq.m_url, "http://www.example.com/page%d.html", (int)n);
+		sreq.m_firstIp = s_firstIp;
+		sreq.m_addedTime = addedTime;
+		sreq.m_hopCount = hopCount;
+		sreq.m_hopCountValid = 1;
+		sreq.setKey(s_firstIp, parentDocId, false);
+		m_recs[sreq.m_key] = std::string((const char *)&sreq, sreq.getRecSize());
+		return sreq.getUrlHash48();
+	}
+
+	void addReply(int64_t uh48, uint32_t spideredTime) {
+		SpiderReply srep;
+		srep.reset();
+		srep.m_firstIp = s_firstIp;
+		srep.m_spideredTime = spideredTime;
+		srep.m_httpStatus = 200;
+		srep.m_langId = langEnglish;
+		srep.m_isIndexed = 1;
+		srep.m_dataSize = sizeof(SpiderReply) - sizeof(key128_t) - 4;
+		srep.setKey(s_firstIp, 0, uh48, false);
+		m_recs[srep.m_key] = std::string((const char *)&srep, srep.getRecSize());
+	}
+
+	// the spiderdb recs of the ip, or only those of "uh48"
+	void makeList(RdbList *list, int64_t uh48) {
+		list->set(NULL, 0, NULL, 0, -1, true, false, sizeof(key128_t));
+		for (std::map<key128_t, std::string>::const_iterator it = m_recs.begin(); it != m_recs.end(); ++it) {
+			if (uh48 >= 0 && Spiderdb::getUrlHash48(&it->first) != uh48) {
+				continue;
+			}
+			const int32_t headerSize = sizeof(key128_t) + 4;
+			ASSERT_TRUE(list->addRecord((const char *)&it->first, it->second.size() - headerSize, it->second.data() + headerSize));
+		}
+	}
+
+	void startIp() {
+		m_sc->m_waitingTreeKey.n1 = 0;
+		m_sc->m_waitingTreeKey.n0 = (uint32_t)s_firstIp;
+		m_sc->m_scanningIp = s_firstIp;
+		m_sc->m_incrementalMaxWinners = 0;
+		m_sc->restartFullScan();
+	}
+
+	// like evalIpLoop() does before each read
+	void scanList(int64_t uh48) {
+		m_sc->m_lastScanningIp = 0;
+		m_sc->m_lastSreqUh48 = 0LL;
+		makeList(&m_sc->m_list, uh48);
+		EXPECT_TRUE(m_sc->scanListForWinners());
+		m_sc->m_list.freeList();
+	}
+
+	std::vector<int64_t> getWinners() {
+		std::vector<int64_t> uh48s;
+		ScopedLock sl(m_sc->m_winnerTree.getLock());
+		for (int32_t node = m_sc->m_winnerTree.getFirstNode_unlocked(); node >= 0; node = m_sc->m_winnerTree.getNextNode_unlocked(node)) {
+			const SpiderRequest *sreq = reinterpret_cast<const SpiderRequest *>(m_sc->m_winnerTree.getData_unlocked(node));
+			uh48s.push_back(sreq->getUrlHash48());
+		}
+		return uh48s;
+	}
+
+	std::vector<int64_t> fullScan() {
+		startIp();
+		scanList(-1);
+		return getWinners();
+	}
+
+	// the winners as addWinnersIntoDoledb() puts them in m_winnerListCache
+	void makeDoleBuf(SafeBuf *doleBuf) {
+		doleBuf->pushLong(4);
+		ScopedLock sl(m_sc->m_winnerTree.getLock());
+		for (int32_t node = m_sc->m_winnerTree.getFirstNode_unlocked(); node >= 0; node = m_sc->m_winnerTree.getNextNode_unlocked(node)) {
+			const SpiderRequest *sreq = reinterpret_cast<const SpiderRequest *>(m_sc->m_winnerTree.getData_unlocked(node));
+			int32_t ip;
+			int32_t priority;
+			int32_t hopCount;
+			int64_t spiderTimeMS;
+			int64_t uh48;
+			parseWinnerTreeKey(reinterpret_cast<const key192_t *>(m_sc->m_winnerTree.getKey_unlocked(node)),
+			                   &ip, &priority, &hopCount, &spiderTimeMS, &uh48);
+			key96_t doleKey = Doledb::makeKey(priority, spiderTimeMS / 1000, uh48, false);
+			doleBuf->safeMemcpy(&doleKey, sizeof(key96_t));
+			doleBuf->pushLong(sreq->getRecSize());
+			doleBuf->safeMemcpy(sreq, sreq->getRecSize());
+		}
+	}
+
+	// . merge the changed urls into the cached winners like evalIpLoop()
+	// . returns false if the ip was not seeded from the cached winners
+	bool incrementalScan(SafeBuf *doleBuf) {
+		startIp();
+		if (!m_sc->takeChangedUrls(s_firstIp, &m_sc->m_changedUh48s)) {
+			return false;
+		}
+		if (!m_sc->seedWinnersFromDoleBuf(doleBuf->getBufStart(), doleBuf->length())) {
+			return false;
+		}
+		m_sc->m_incrementalScan = true;
+		for (size_t i = 0; i < m_sc->m_changedUh48s.size(); i++) {
+			scanList(m_sc->m_changedUh48s[i]);
+		}
+		return true;
+	}
+
+	void addChangedUrl(int64_t uh48) {
+		m_sc->addChangedUrl(s_firstIp, uh48);
+	}
+
+	bool takeChangedUrls(std::vector<int64_t> *uh48s) {
+		return m_sc->takeChangedUrls(s_firstIp, uh48s);
+	}
+
+	bool changedWinnerGotWorse() {
+		return m_sc->changedWinnerGotWorse();
+	}
+
+	// . enough due requests for a full scan to keep 400 winners
+	// . older requests are better, so the last 100 are not winners
+	void addManyRequests() {
+		for (int32_t i = 0; i < 500; i++) {
+			m_uh48s.push_back(addRequest(i, m_now - 100000 + i * 10, i % 3, 1000 + i));
+		}
+	}
+
+	SpiderColl *m_sc;
+	uint32_t m_now;
+	std::map<key128_t, std::string> m_recs;
+	std::vector<int64_t> m_uh48s;
+};
+
+TEST_F(SpiderCollTest, ChangedUrls) {
+	std::vector<int64_t> uh48s;
+
+	addChangedUrl(111);
+	addChangedUrl(222);
+	addChangedUrl(111);
+	EXPECT_TRUE(takeChangedUrls(&uh48s));
+	std::sort(uh48s.begin(), uh48s.end());
+	ASSERT_EQ(2u, uh48s.size());
+	EXPECT_EQ(111, uh48s[0]);
+	EXPECT_EQ(222, uh48s[1]);
+
+	// taken
+	EXPECT_TRUE(takeChangedUrls(&uh48s));
+	EXPECT_TRUE(uh48s.empty());
+
+	// too many, the ip needs a full scan
+	for (int64_t uh48 = 1; uh48 <= 150; uh48++) {
+		addChangedUrl(uh48);
+	}
+	EXPECT_FALSE(takeChangedUrls(&uh48s));
+	EXPECT_TRUE(takeChangedUrls(&uh48s));
+	EXPECT_TRUE(uh48s.empty());
+}
+
+TEST_F(SpiderCollTest, MergeNewRequestsMatchesFullScan) {
+	addManyRequests();
+
+	std::vector<int64_t> cached = fullScan();
+	ASSERT_EQ(400u, cached.size());
+	SafeBuf doleBuf;
+	makeDoleBuf(&doleBuf);
+
+	// a new url that beats all, one in the middle and one that loses
+	addChangedUrl(addRequest(1000, m_now - 200000, 0, 2000));
+	addChangedUrl(addRequest(1001, m_now - 100000 + 2005, 1, 2001));
+	addChangedUrl(addRequest(1002, m_now - 1000, 2, 2002));
+	// a loser that wins with a new request, and a winner that stays
+	addChangedUrl(addRequest(450, m_now - 150000, 0, 3000));
+	addChangedUrl(addRequest(10, m_now - 10, 2, 3001));
+
+	std::vector<int64_t> full = fullScan();
+	ASSERT_EQ(400u, full.size());
+	EXPECT_NE(cached, full);
+
+	ASSERT_TRUE(incrementalScan(&doleBuf));
+	EXPECT_FALSE(changedWinnerGotWorse());
+	EXPECT_EQ(full, getWinners());
+}
+
+TEST_F(SpiderCollTest, MergeSpideredWinnerNeedsFullScan) {
+	addManyRequests();
+
+	fullScan();
+	SafeBuf doleBuf;
+	makeDoleBuf(&doleBuf);
+
+	// the best winner got spidered, so a url that was not cached moves up
+	addReply(m_uh48s[0], m_now);
+	addChangedUrl(m_uh48s[0]);
+
+	std::vector<int64_t> full = fullScan();
+	ASSERT_EQ(400u, full.size());
+	EXPECT_NE(m_uh48s[0], full[0]);
+
+	ASSERT_TRUE(incrementalScan(&doleBuf));
+	EXPECT_TRUE(changedWinnerGotWorse());
+	EXPECT_EQ(full[0], getWinners()[0]);
+}
+
+TEST_F(SpiderCollTest, SingleCachedWinnerIsNotMerged) {
+	// a short list only keeps one winner
+	for (int32_t i = 0; i < 5; i++) {
+		m_uh48s.push_back(addRequest(i, m_now - 100000 + i * 10, 0, 1000 + i));
+	}
+
+	ASSERT_EQ(1u, fullScan().size());
+	SafeBuf doleBuf;
+	makeDoleBuf(&doleBuf);
+
+	addChangedUrl(addRequest(100, m_now - 200000, 0, 2000));
+	EXPECT_FALSE(incrementalScan(&doleBuf));
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "TitleRecCodec.h"
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+// documents sharing a lot of boilerplate, like the pages of a site do
+static std::string makeDoc(int n) {
+	std::string doc;
+	doc += "<html><head><title>Page number ";
+	doc += std::to_string(n);
+	doc += " of the example site</title><meta name=\"description\" content=\"An example page\"></head>";
+	doc += "<body><div class=\"navigation\"><a href=\"/\">Home</a> <a href=\"/about\">About</a> <a href=\"/contact\">Contact</a></div>";
+	for (int i = 0; i < 20; i++) {
+		doc += "<p>Paragraph ";
+		doc += std::to_string((n * 31 + i * 7) % 1000);
+		doc += " talks about things that are related to number ";
+		doc += std::to_string(n + i);
+		doc += ".</p>";
+	}
+	doc += "<div class=\"footer\">Copyright example.com. All rights reserved.</div></body></html>";
+	return doc;
+}
+
+static void roundTrip(titlerec_codec_t codec, TitleRecDicts *dicts, const std::string &doc, int32_t *compressedSize) {
+	std::vector<char> cbuf(getTitleRecCompressBound(codec, doc.size()));
+	int32_t csize = cbuf.size();
+	ASSERT_TRUE(titleRecCompress(codec, 3, dicts, &cbuf[0], &csize, doc.data(), doc.size()));
+	EXPECT_LT(csize, (int32_t)doc.size());
+
+	std::vector<char> ubuf(doc.size());
+	int32_t usize = ubuf.size();
+	ASSERT_TRUE(titleRecUncompress(codec, dicts, &ubuf[0], &usize, &cbuf[0], csize));
+	ASSERT_EQ((int32_t)doc.size(), usize);
+	EXPECT_EQ(0, memcmp(doc.data(), &ubuf[0], usize));
+
+	if (compressedSize) {
+		*compressedSize = csize;
+	}
+}
+
+TEST(TitleRecCodecTest, UsizeField) {
+	// records written before the codec was stored are zlib
+	EXPECT_EQ(TITLEREC_CODEC_ZLIB, getTitleRecCodec(12345));
+	EXPECT_EQ(12345, getTitleRecUncompressedSize(12345));
+
+	int32_t field = makeTitleRecUsizeField(TITLEREC_CODEC_ZSTD, 100000000);
+	EXPECT_GT(field, 0);
+	EXPECT_EQ(TITLEREC_CODEC_ZSTD, getTitleRecCodec(field));
+	EXPECT_EQ(100000000, getTitleRecUncompressedSize(field));
+
+	field = makeTitleRecUsizeField(TITLEREC_CODEC_LZ4, 1);
+	EXPECT_EQ(TITLEREC_CODEC_LZ4, getTitleRecCodec(field));
+	EXPECT_EQ(1, getTitleRecUncompressedSize(field));
+
+	// corruption is still caught
+	EXPECT_EQ(-1, getTitleRecUncompressedSize(-1));
+}
+
+TEST(TitleRecCodecTest, RoundTrip) {
+	std::string doc = makeDoc(1);
+	roundTrip(TITLEREC_CODEC_ZLIB, NULL, doc, NULL);
+	roundTrip(TITLEREC_CODEC_ZSTD, NULL, doc, NULL);
+	roundTrip(TITLEREC_CODEC_LZ4, NULL, doc, NULL);
+
+	EXPECT_STREQ("zstd", getTitleRecCodecName(getTitleRecCodecFromName("zstd")));
+	EXPECT_STREQ("lz4", getTitleRecCodecName(getTitleRecCodecFromName("LZ4")));
+	EXPECT_EQ(TITLEREC_CODEC_ZLIB, getTitleRecCodecFromName("bogus"));
+}
+
+TEST(TitleRecCodecTest, Corrupt) {
+	std::string doc = makeDoc(2);
+	std::vector<char> cbuf(getTitleRecCompressBound(TITLEREC_CODEC_ZSTD, doc.size()));
+	int32_t csize = cbuf.size();
+	ASSERT_TRUE(titleRecCompress(TITLEREC_CODEC_ZSTD, 3, NULL, &cbuf[0], &csize, doc.data(), doc.size()));
+
+	// too small a buffer
+	std::vector<char> ubuf(doc.size());
+	int32_t usize = doc.size() / 2;
+	EXPECT_FALSE(titleRecUncompress(TITLEREC_CODEC_ZSTD, NULL, &ubuf[0], &usize, &cbuf[0], csize));
+
+	// wrong codec
+	usize = ubuf.size();
+	EXPECT_FALSE(titleRecUncompress(TITLEREC_CODEC_ZLIB, NULL, &ubuf[0], &usize, &cbuf[0], csize));
+}
+
+TEST(TitleRecCodecTest, Dictionary) {
+	char dir[] = "/tmp/titlereccodectest.XXXXXX";
+	ASSERT_TRUE(mkdtemp(dir) != NULL);
+	std::string dirName = std::string(dir) + "/";
+
+	std::string samples;
+	std::vector<size_t> sampleSizes;
+	for (int i = 0; i < 500; i++) {
+		std::string doc = makeDoc(i);
+		samples += doc;
+		sampleSizes.push_back(doc.size());
+	}
+
+	uint32_t dictId = 0;
+	{
+		TitleRecDicts dicts;
+		ASSERT_TRUE(dicts.load(dirName.c_str()));
+		EXPECT_EQ(0, dicts.getNumDicts());
+		EXPECT_EQ(0U, dicts.getNewestId());
+
+		ASSERT_TRUE(dicts.train(samples.data(), &sampleSizes[0], sampleSizes.size(), 16 * 1024, &dictId));
+		EXPECT_EQ(dictId, dicts.getNewestId());
+		EXPECT_EQ(1, dicts.getNumDicts());
+	}
+
+	// a new document compresses better with the dictionary
+	std::string doc = makeDoc(1000);
+	int32_t plainSize;
+	roundTrip(TITLEREC_CODEC_ZSTD, NULL, doc, &plainSize);
+
+	TitleRecDicts dicts;
+	ASSERT_TRUE(dicts.load(dirName.c_str()));
+	EXPECT_EQ(dictId, dicts.getNewestId());
+	int32_t dictSize;
+	roundTrip(TITLEREC_CODEC_ZSTD, &dicts, doc, &dictSize);
+	EXPECT_LT(dictSize, plainSize);
+
+	// records compressed with the older dictionary can still be read
+	std::vector<char> cbuf(getTitleRecCompressBound(TITLEREC_CODEC_ZSTD, doc.size()));
+	int32_t csize = cbuf.size();
+	ASSERT_TRUE(titleRecCompress(TITLEREC_CODEC_ZSTD, 3, &dicts, &cbuf[0], &csize, doc.data(), doc.size()));
+
+	uint32_t newDictId = 0;
+	ASSERT_TRUE(dicts.train(samples.data(), &sampleSizes[0], sampleSizes.size(), 16 * 1024, &newDictId));
+	EXPECT_EQ(dictId + 1, newDictId);
+	EXPECT_EQ(newDictId, dicts.getNewestId());
+
+	std::vector<char> ubuf(doc.size());
+	int32_t usize = ubuf.size();
+	ASSERT_TRUE(titleRecUncompress(TITLEREC_CODEC_ZSTD, &dicts, &ubuf[0], &usize, &cbuf[0], csize));
+	EXPECT_EQ((int32_t)doc.size(), usize);
+
+	// but not without it
+	usize = ubuf.size();
+	EXPECT_FALSE(titleRecUncompress(TITLEREC_CODEC_ZSTD, NULL, &ubuf[0], &usize, &cbuf[0], csize));
+
+	std::string cmd = "rm -rf " + dirName;
+	system(cmd.c_str());
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "UdpBatch.h"
+#include "UdpStatistic.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <string>
+
+// bind a udp socket to a random loopback port
+static int openSocket(struct sockaddr_in *addr) {
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = 0;
+	socklen_t len = sizeof(*addr);
+	if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) != 0 || getsockname(fd, (struct sockaddr *)addr, &len) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+TEST(UdpBatchTest, RecvBatch) {
+	struct sockaddr_in recvAddr;
+	struct sockaddr_in sendAddr;
+	int recvFd = openSocket(&recvAddr);
+	int sendFd = openSocket(&sendAddr);
+	ASSERT_GE(recvFd, 0);
+	ASSERT_GE(sendFd, 0);
+
+	UdpRecvBatch batch;
+	ASSERT_TRUE(batch.init());
+
+	// nothing waiting
+	EXPECT_EQ(0, batch.fill(recvFd, 16));
+	EXPECT_TRUE(batch.isEmpty());
+
+	for (int i = 0; i < 10; i++) {
+		std::string dgram = "dgram" + std::to_string(i);
+		ASSERT_EQ((ssize_t)dgram.size(), sendto(sendFd, dgram.data(), dgram.size(), 0, (struct sockaddr *)&recvAddr, sizeof(recvAddr)));
+	}
+
+	// only read up to the batch size
+	EXPECT_EQ(4, batch.fill(recvFd, 4));
+
+	int next = 0;
+	for (int round = 0; round < 2; round++) {
+		const char *dgram;
+		int32_t dgramSize;
+		struct sockaddr_in from;
+		while (batch.getNext(&dgram, &dgramSize, &from)) {
+			std::string expected = "dgram" + std::to_string(next++);
+			EXPECT_EQ(expected, std::string(dgram, dgramSize));
+			EXPECT_EQ(sendAddr.sin_port, from.sin_port);
+		}
+		EXPECT_TRUE(batch.isEmpty());
+
+		if (round == 0) {
+			EXPECT_EQ(6, batch.fill(recvFd, 64));
+		}
+	}
+	EXPECT_EQ(10, next);
+
+	close(recvFd);
+	close(sendFd);
+}
+
+TEST(UdpBatchTest, SendBatch) {
+	struct sockaddr_in recvAddr;
+	struct sockaddr_in sendAddr;
+	int recvFd = openSocket(&recvAddr);
+	int sendFd = openSocket(&sendAddr);
+	ASSERT_GE(recvFd, 0);
+	ASSERT_GE(sendFd, 0);
+
+	UdpSendBatch batch;
+	ASSERT_TRUE(batch.init());
+	EXPECT_TRUE(batch.isEmpty());
+
+	// header is copied, data is sent from where it is
+	static const char data[] = "payload";
+	for (int i = 0; i < UDP_MAX_BATCH; i++) {
+		char header[12];
+		snprintf(header, sizeof(header), "hdr%02d:", i);
+		batch.add(NULL, i, false, recvAddr, header, strlen(header), data, i % 2 ? sizeof(data) - 1 : 0);
+	}
+	EXPECT_TRUE(batch.isFull());
+
+	UdpBatchStatistic stats;
+	EXPECT_TRUE(batch.flush(sendFd, 16, &stats));
+	EXPECT_TRUE(batch.isEmpty());
+	EXPECT_EQ(4, stats.getNumSendCalls());
+	EXPECT_EQ(UDP_MAX_BATCH, stats.getNumSendDgrams());
+	EXPECT_EQ(0, stats.getNumSendBlocked());
+
+	for (int i = 0; i < UDP_MAX_BATCH; i++) {
+		char buf[64];
+		ssize_t size = recv(recvFd, buf, sizeof(buf), MSG_DONTWAIT);
+		char expected[32];
+		snprintf(expected, sizeof(expected), "hdr%02d:%s", i, i % 2 ? data : "");
+		ASSERT_EQ((ssize_t)strlen(expected), size);
+		EXPECT_EQ(std::string(expected), std::string(buf, size));
+	}
+
+	// nothing more
+	char buf[64];
+	EXPECT_GT(0, recv(recvFd, buf, sizeof(buf), MSG_DONTWAIT));
+
+	char sizes[256];
+	stats.printSendHistogram(sizes, sizeof(sizes));
+	EXPECT_STREQ("1:0 2-3:0 4-7:0 8-15:0 16-31:4 32-63:0 64+:0", sizes);
+
+	close(recvFd);
+	close(sendFd);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "UdpCongestion.h"
+
+TEST(UdpCongestionTest, RttEstimate) {
+	UdpCongestion congestion;
+	congestion.reset();
+
+	EXPECT_FALSE(congestion.hasRttSample());
+	EXPECT_EQ(-1, congestion.getResendTimeout(40, 200));
+	EXPECT_EQ(0, congestion.getPacingInterval());
+
+	// first sample: srtt = rtt, rttvar = rtt/2
+	congestion.addRttSample(10000);
+	EXPECT_TRUE(congestion.hasRttSample());
+	EXPECT_EQ(10000, congestion.getSrtt());
+	EXPECT_EQ(5000, congestion.getRttVar());
+	EXPECT_EQ(30, congestion.getResendTimeout(0, 200));
+
+	// clamped
+	EXPECT_EQ(40, congestion.getResendTimeout(40, 200));
+	EXPECT_EQ(20, congestion.getResendTimeout(0, 20));
+
+	// steady rtt converges and the deviation decays
+	for (int i = 0; i < 100; i++) {
+		congestion.addRttSample(2000);
+	}
+	EXPECT_NEAR(2000, congestion.getSrtt(), 100);
+	EXPECT_LT(congestion.getRttVar(), 100);
+	EXPECT_EQ(101, congestion.getNumRttSamples());
+
+	// sub-ms rtt rounds the timeout up
+	UdpCongestion lan;
+	lan.reset();
+	lan.addRttSample(200);
+	EXPECT_EQ(1, lan.getResendTimeout(0, 200));
+}
+
+TEST(UdpCongestionTest, Window) {
+	UdpCongestion congestion;
+	congestion.reset();
+
+	EXPECT_EQ(UDP_CWND_INITIAL, congestion.getWindow());
+
+	// slow start doubles the window per window of acks
+	for (int i = 0; i < UDP_CWND_INITIAL; i++) {
+		congestion.onAck();
+	}
+	EXPECT_EQ(UDP_CWND_INITIAL * 2, congestion.getWindow());
+
+	// capped
+	for (int i = 0; i < 1000; i++) {
+		congestion.onAck();
+	}
+	EXPECT_EQ(UDP_CWND_MAX, congestion.getWindow());
+
+	// loss halves it
+	congestion.onLoss(1000);
+	EXPECT_EQ(UDP_CWND_MAX / 2, congestion.getWindow());
+	EXPECT_EQ(1, congestion.getNumWindowDecreases());
+
+	// but only once per rtt (at least a ms)
+	congestion.onLoss(1000);
+	EXPECT_EQ(UDP_CWND_MAX / 2, congestion.getWindow());
+	congestion.onLoss(1001);
+	EXPECT_EQ(UDP_CWND_MAX / 4, congestion.getWindow());
+
+	// congestion avoidance grows it by a bit under a dgram per window of acks
+	int32_t window = congestion.getWindow();
+	for (int i = 0; i < window * 2; i++) {
+		congestion.onAck();
+	}
+	EXPECT_EQ(window + 1, congestion.getWindow());
+
+	// never below the minimum
+	for (int i = 0; i < 20; i++) {
+		congestion.onLoss(2000 + i);
+	}
+	EXPECT_EQ(UDP_CWND_MIN, congestion.getWindow());
+
+	congestion.resetStats();
+	EXPECT_EQ(0, congestion.getNumWindowDecreases());
+	EXPECT_EQ(UDP_CWND_MIN, congestion.getWindow());
+}
+
+TEST(UdpCongestionTest, Pacing) {
+	UdpCongestion congestion;
+	congestion.reset();
+
+	// 20ms rtt over a window of 4 dgrams
+	congestion.addRttSample(20000);
+	EXPECT_EQ(5, congestion.getPacingInterval());
+
+	// lan rtts don't pace at all
+	UdpCongestion lan;
+	lan.reset();
+	lan.addRttSample(300);
+	EXPECT_EQ(0, lan.getPacingInterval());
+}
@@ -0,0 +1,248 @@
+#include <gtest/gtest.h>
+#include "UrlFilterProgram.h"
+#include "SafeBuf.h"
+#include "Collectiondb.h"
+#include "Spider.h"
+#include "HashTableX.h"
+#include "Lang.h"
+#include <vector>
+
+static void compileRules(UrlFilterProgram *prog, const std::vector<const char *> &rules) {
+	static SafeBuf sbs[16];
+	for (size_t i = 0; i < rules.size(); i++) {
+		sbs[i].reset();
+		sbs[i].safeStrcpy(rules[i]);
+		sbs[i].nullTerm();
+	}
+	prog->compile(sbs, rules.size());
+}
+
+TEST(UrlFilterProgramTest, Chain) {
+	UrlFilterProgram prog;
+	compileRules(&prog, {"hopcount>=3 && !isnew && ^http://www.", "default"});
+	ASSERT_EQ(2, prog.getNumRules());
+
+	const UrlFilterOp *op = prog.getOp(prog.getFirstOp(0));
+	EXPECT_EQ(UFOP_HOPCOUNT, op->m_type);
+	EXPECT_EQ(SIGN_GE, op->m_sign);
+	EXPECT_EQ(3, op->m_intArg);
+	EXPECT_FALSE(op->m_negate);
+	ASSERT_GE(op->m_next, 0);
+
+	op = prog.getOp(op->m_next);
+	EXPECT_EQ(UFOP_ISNEW, op->m_type);
+	EXPECT_TRUE(op->m_negate);
+	ASSERT_GE(op->m_next, 0);
+
+	op = prog.getOp(op->m_next);
+	EXPECT_EQ(UFOP_PREFIX, op->m_type);
+	EXPECT_EQ("http://www.", op->m_str);
+	EXPECT_EQ(-1, op->m_next);
+
+	op = prog.getOp(prog.getFirstOp(1));
+	EXPECT_EQ(UFOP_DEFAULT, op->m_type);
+}
+
+TEST(UrlFilterProgramTest, Signs) {
+	UrlFilterProgram prog;
+	compileRules(&prog, {"errorcount==1", "errorcode != 32880", "sitenuminlinks<10", "numinlinks <= 7",
+	                     "spiderwaited>3600", "percentchangedperday >= 2.5", "httpstatus=404", "hopcount"});
+
+	const char expected[] = {SIGN_EQ, SIGN_NE, SIGN_LT, SIGN_LE, SIGN_GT, SIGN_GE, SIGN_EQ, 0};
+	for (int32_t i = 0; i < prog.getNumRules(); i++) {
+		EXPECT_EQ(expected[i], prog.getOp(prog.getFirstOp(i))->m_sign) << "rule " << i;
+	}
+
+	EXPECT_EQ(UFOP_ERRORCODE, prog.getOp(prog.getFirstOp(1))->m_type);
+	EXPECT_EQ(32880, prog.getOp(prog.getFirstOp(1))->m_intArg);
+	EXPECT_FLOAT_EQ(2.5, prog.getOp(prog.getFirstOp(5))->m_floatArg);
+}
+
+TEST(UrlFilterProgramTest, List) {
+	UrlFilterProgram prog;
+	compileRules(&prog, {"tld==com,org && isroot", "lang!=en,de"});
+
+	const UrlFilterOp *op = prog.getOp(prog.getFirstOp(0));
+	EXPECT_EQ(UFOP_TLD, op->m_type);
+	EXPECT_EQ(SIGN_EQ, op->m_sign);
+	ASSERT_EQ(2u, op->m_items.size());
+	EXPECT_EQ("com", op->m_items[0].m_str);
+	EXPECT_EQ("org", op->m_items[1].m_str);
+	// both continue with the same "isroot"
+	EXPECT_EQ(op->m_items[0].m_next, op->m_items[1].m_next);
+	ASSERT_GE(op->m_items[0].m_next, 0);
+	EXPECT_EQ(UFOP_ISROOT, prog.getOp(op->m_items[0].m_next)->m_type);
+
+	op = prog.getOp(prog.getFirstOp(1));
+	EXPECT_EQ(UFOP_LANG, op->m_type);
+	EXPECT_EQ(SIGN_NE, op->m_sign);
+	ASSERT_EQ(2u, op->m_items.size());
+	EXPECT_EQ(-1, op->m_next);
+}
+
+TEST(UrlFilterProgramTest, Patterns) {
+	UrlFilterProgram prog;
+	compileRules(&prog, {"$\\.css", "!facebook.com && tag:shallow", "^", "isrssext", "ispermalinkformat", "", "default "});
+
+	const UrlFilterOp *op = prog.getOp(prog.getFirstOp(0));
+	EXPECT_EQ(UFOP_SUFFIX, op->m_type);
+	EXPECT_EQ(".css", op->m_str);
+
+	op = prog.getOp(prog.getFirstOp(1));
+	EXPECT_EQ(UFOP_SUBSTRING, op->m_type);
+	EXPECT_TRUE(op->m_negate);
+	EXPECT_EQ("facebook.com", op->m_str);
+	op = prog.getOp(op->m_next);
+	EXPECT_EQ(UFOP_TAG, op->m_type);
+	EXPECT_EQ("shallow", op->m_str);
+
+	// an empty pattern never matches
+	EXPECT_EQ(UFOP_FAIL, prog.getOp(prog.getFirstOp(2))->m_type);
+
+	// these were always caught by "isrss" and "ispermalink"
+	EXPECT_EQ(UFOP_ISRSS, prog.getOp(prog.getFirstOp(3))->m_type);
+	EXPECT_EQ(UFOP_ISPERMALINK, prog.getOp(prog.getFirstOp(4))->m_type);
+
+	EXPECT_EQ(UFOP_FAIL, prog.getOp(prog.getFirstOp(5))->m_type);
+
+	// only an exact "default" is the default rule
+	EXPECT_EQ(UFOP_SUBSTRING, prog.getOp(prog.getFirstOp(6))->m_type);
+}
+
+TEST(UrlFilterProgramTest, Hits) {
+	UrlFilterProgram prog;
+	compileRules(&prog, {"isroot", "default"});
+	prog.addHit(1);
+	prog.addHit(1);
+	EXPECT_EQ(0, prog.getHits(0));
+	EXPECT_EQ(2, prog.getHits(1));
+
+	// recompiling resets them
+	compileRules(&prog, {"isroot", "default"});
+	EXPECT_EQ(0, prog.getHits(1));
+}
+
+static CollectionRec *makeCollRec(const std::vector<const char *> &rules) {
+	CollectionRec *cr = new CollectionRec;
+	cr->m_urlFiltersProfile.safeStrcpy("custom");
+	cr->m_urlFiltersProfile.nullTerm();
+	for (size_t i = 0; i < rules.size(); i++) {
+		cr->m_regExs[i].safeStrcpy(rules[i]);
+		cr->m_regExs[i].nullTerm();
+	}
+	cr->m_numRegExs = rules.size();
+	cr->rebuildUrlFilters();
+	return cr;
+}
+
+static void setRequest(SpiderRequest *sreq, const char *url, int32_t hopCount, bool hadReply) {
+	sreq->reset();
+	strcpy(sreq->m_url, url);
+	sreq->m_hopCount = hopCount;
+	sreq->m_hopCountValid = (hopCount >= 0);
+	sreq->m_hadReply = hadReply;
+	sreq->m_addedTime = 1000;
+	sreq->setDataSize();
+}
+
+// . the filter numbers are the ones getUrlFilterNum() returned when it
+//   parsed the rule strings for every url
+TEST(UrlFilterProgramTest, GetUrlFilterNum) {
+	CollectionRec *cr = makeCollRec({"isnewrequest && hopcount>=3",
+	                                 "tld==org,net && isroot",
+	                                 "lang!=en,de && errorcount>=1",
+	                                 "^https://",
+	                                 "$.css",
+	                                 "hasreply && errorcount==0 && !isnew",
+	                                 "foo",
+	                                 "hopcount<2",
+	                                 "default"});
+	HashTableX quotaTable;
+	SpiderRequest sreq;
+	SpiderReply srep;
+	srep.reset();
+	srep.m_spideredTime = 2000;
+	srep.m_langId = langEnglish;
+
+	setRequest(&sreq, "http://www.example.com/a", 5, false);
+	EXPECT_EQ(0, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	// not a new request if it was added before the reply
+	setRequest(&sreq, "http://www.example.com/a", 5, true);
+	EXPECT_EQ(5, getUrlFilterNum(&sreq, &srep, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "http://example.org/", 1, false);
+	EXPECT_EQ(1, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "http://example.org/a", 1, false);
+	EXPECT_EQ(7, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "https://example.com/x.css", 1, false);
+	EXPECT_EQ(3, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "http://example.com/x.css", 1, false);
+	EXPECT_EQ(4, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "http://example.com/food", 2, false);
+	EXPECT_EQ(6, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "http://example.com/bar", 1, false);
+	EXPECT_EQ(7, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	// the hop count is not valid
+	setRequest(&sreq, "http://example.com/bar", -1, false);
+	EXPECT_EQ(8, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	setRequest(&sreq, "http://example.com/bar", 4, true);
+	srep.m_errCount = 2;
+	EXPECT_EQ(8, getUrlFilterNum(&sreq, &srep, 3000, false, cr, false, &quotaTable, -1));
+	srep.m_langId = langFrench;
+	EXPECT_EQ(2, getUrlFilterNum(&sreq, &srep, 3000, false, cr, false, &quotaTable, -1));
+	srep.m_langId = langGerman;
+	EXPECT_EQ(8, getUrlFilterNum(&sreq, &srep, 3000, false, cr, false, &quotaTable, -1));
+
+	// a new request for an url we have a reply for
+	sreq.m_addedTime = 2500;
+	EXPECT_EQ(0, getUrlFilterNum(&sreq, &srep, 3000, false, cr, false, &quotaTable, -1));
+
+	// the rules that need the reply are skipped for msg20
+	setRequest(&sreq, "http://www.example.com/a", 5, true);
+	srep.m_errCount = 0;
+	EXPECT_EQ(8, getUrlFilterNum(&sreq, &srep, 3000, true, cr, false, &quotaTable, -1));
+
+	// and we can not tell for outlinks
+	EXPECT_EQ(-1, getUrlFilterNum(&sreq, &srep, 3000, false, cr, true, &quotaTable, -1));
+
+	EXPECT_EQ(2, cr->getUrlFilterProgram()->getHits(0));
+	EXPECT_EQ(4, cr->getUrlFilterProgram()->getHits(8));
+
+	delete cr;
+}
+
+TEST(UrlFilterProgramTest, Rebuild) {
+	CollectionRec *cr = makeCollRec({"isroot", "default"});
+	HashTableX quotaTable;
+	SpiderRequest sreq;
+	setRequest(&sreq, "http://example.com/", 1, false);
+
+	// a program in use stays valid when the rules change
+	urlfilterprogram_ptr_t prog = cr->getUrlFilterProgram();
+	EXPECT_EQ(0, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+
+	cr->m_regExs[0].reset();
+	cr->m_regExs[0].safeStrcpy("default");
+	cr->m_regExs[0].nullTerm();
+	cr->m_numRegExs = 1;
+	cr->rebuildUrlFilters();
+
+	EXPECT_EQ(2, prog->getNumRules());
+	EXPECT_EQ(1, prog->getHits(0));
+	EXPECT_EQ(1, cr->getUrlFilterProgram()->getNumRules());
+	EXPECT_EQ(0, cr->getUrlFilterProgram()->getHits(0));
+
+	EXPECT_EQ(0, getUrlFilterNum(&sreq, NULL, 3000, false, cr, false, &quotaTable, -1));
+	EXPECT_EQ(1, prog->getHits(0));
+	EXPECT_EQ(1, cr->getUrlFilterProgram()->getHits(0));
+
+	delete cr;
+}
@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 
 #include "Words.h"
+#include "Xml.h"
+#include "HttpMime.h" // CT_HTML
+#include "TitleRecVersion.h"
+#include <string>
 
 TEST(WordsTest, VerifySize) {
 	// set c to a curling quote in unicode
@@ -28,3 +32,52 @@ TEST(WordsTest, VerifySize) {
 	// is that punct
 	EXPECT_TRUE(is_punct_utf8(p));
 }
+
+static void expectSameWords( const char *html, char contentType ) {
+	// the parsers may modify the buffer
+	std::string buf1( html );
+	std::string buf2( html );
+
+	Xml xml1;
+	ASSERT_TRUE( xml1.set( &buf1[0], buf1.size(), TITLEREC_CURRENT_VERSION, contentType ) );
+	Words words1;
+	ASSERT_TRUE( words1.set( &xml1, true ) );
+
+	Xml xml2;
+	Words words2;
+	ASSERT_TRUE( xml2.set( &buf2[0], buf2.size(), TITLEREC_CURRENT_VERSION, contentType, &words2, true ) );
+
+	EXPECT_EQ( xml1.getNumNodes(), xml2.getNumNodes() );
+	ASSERT_EQ( words1.getNumWords(), words2.getNumWords() );
+	EXPECT_EQ( words1.getNumAlnumWords(), words2.getNumAlnumWords() );
+	EXPECT_EQ( words1.getNumTags(), words2.getNumTags() );
+
+	for ( int32_t i = 0; i < words1.getNumWords(); i++ ) {
+		EXPECT_EQ( words1.getWord( i ) - &buf1[0], words2.getWord( i ) - &buf2[0] );
+		EXPECT_EQ( words1.getWordLen( i ), words2.getWordLen( i ) );
+		EXPECT_EQ( words1.getWordId( i ), words2.getWordId( i ) );
+		EXPECT_EQ( words1.getTagIds()[i], words2.getTagIds()[i] );
+		EXPECT_EQ( words1.getNodes()[i], words2.getNodes()[i] );
+	}
+}
+
+TEST(WordsTest, SetWithXml) {
+	const char *htmls[] = {
+		"",
+		"plain text without any tags",
+		"<html><head><title>A title</title></head><body><p>Hello, world! It's 3.14 and 1,000,000 C++ coders.</p></body></html>",
+		"<p>a < b and b > c</p><br/><img src=\"x.png\" alt=\"x\">trailing",
+		"<script>if (a < b) { document.write('</p>'); }</script><p>after script</p><script></script>",
+		"<!-- comment --><div>Größe café naïve — “quoted” Москва Αθήνα</div>",
+		"<div>日本語のテキストです。中文文本。ภาษาไทย</div><span>mixed日本abc</span>",
+		"<p>text with a \x01 control char and a tab\there</p>",
+	};
+
+	for ( size_t i = 0; i < sizeof( htmls ) / sizeof( htmls[0] ); i++ ) {
+		SCOPED_TRACE( htmls[i] );
+		expectSameWords( htmls[i], CT_HTML );
+		expectSameWords( htmls[i], CT_XML );
+	}
+
+	expectSameWords( "{\"key\":\"value with words\",\"n\":123}", CT_JSON );
+}
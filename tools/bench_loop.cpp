@@ -0,0 +1,146 @@
+#include "gb-include.h"
+
+#include "Loop.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "fctypes.h"
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <vector>
+#include <random>
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] [ACTIVE] [SECONDS] [NUMFDS...]\n", argv0);
+	fprintf(stdout, "Measure Loop callbacks/sec with many registered fds\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  ACTIVE         fds made readable per doPoll() (default 100)\n");
+	fprintf(stdout, "  SECONDS        run time per fd count (default 3)\n");
+	fprintf(stdout, "  NUMFDS         registered fds (default 1000 10000 50000)\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+static int64_t s_numReadCallbacks = 0;
+static int64_t s_numSleepCallbacks = 0;
+
+static void readCallback(int fd, void *state) {
+	uint64_t value;
+	if (read(fd, &value, sizeof(value)) == sizeof(value)) {
+		s_numReadCallbacks++;
+	}
+}
+
+static void sleepCallback(int fd, void *state) {
+	s_numSleepCallbacks++;
+}
+
+static void runBenchmark(int32_t numFds, int32_t numActive, int32_t seconds) {
+	std::vector<int> fds;
+	for (int32_t i = 0; i < numFds; i++) {
+		int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (fd < 0 || fd >= MAX_NUM_FDS) {
+			fprintf(stdout, "Unable to create %" PRId32" eventfds (got %" PRId32"). Check 'ulimit -n'\n",
+			        numFds, (int32_t)fds.size());
+			if (fd >= 0) {
+				close(fd);
+			}
+			break;
+		}
+		fds.push_back(fd);
+		g_loop.registerReadCallback(fd, NULL, readCallback, "bench_loop", 0);
+	}
+
+	// sleep callbacks with a spread of ticks to keep the timer wheel busy
+	static char sleepStates[1000];
+	for (int i = 0; i < 1000; i++) {
+		g_loop.registerSleepCallback(1 + i % 500, &sleepStates[i], sleepCallback, "bench_loop", 1);
+	}
+
+	std::mt19937 rng(numFds);
+	std::uniform_int_distribution<size_t> dist(0, fds.size() - 1);
+
+	s_numReadCallbacks = 0;
+	s_numSleepCallbacks = 0;
+	int64_t numPolls = 0;
+	int64_t numSignaled = 0;
+
+	int64_t start = gettimeofdayInMilliseconds();
+	int64_t end = start + seconds * 1000;
+	int64_t now = start;
+	while (now < end) {
+		for (int32_t i = 0; i < numActive; i++) {
+			uint64_t one = 1;
+			if (write(fds[dist(rng)], &one, sizeof(one)) == sizeof(one)) {
+				numSignaled++;
+			}
+		}
+		g_loop.doPoll();
+		numPolls++;
+		now = gettimeofdayInMilliseconds();
+	}
+
+	// pick up the stragglers
+	for (int i = 0; i < 10; i++) {
+		g_loop.doPoll();
+	}
+
+	int64_t took = now - start;
+	fprintf(stdout, "fds=%-6" PRId32" active=%-4" PRId32": %" PRId64" read callbacks/s, %" PRId64" polls/s, "
+	        "%" PRId64" sleep callbacks/s (%" PRId64" eventfd writes)\n",
+	        (int32_t)fds.size(), numActive, s_numReadCallbacks * 1000 / took, numPolls * 1000 / took,
+	        s_numSleepCallbacks * 1000 / took, numSignaled);
+
+	for (int i = 0; i < 1000; i++) {
+		g_loop.unregisterSleepCallback(&sleepStates[i], sleepCallback);
+	}
+	for (auto fd : fds) {
+		g_loop.unregisterReadCallback(fd, NULL, readCallback);
+		close(fd);
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	int32_t numActive = (argc > 1) ? atoi(argv[1]) : 100;
+	int32_t seconds = (argc > 2) ? atoi(argv[2]) : 3;
+	if (numActive <= 0 || seconds <= 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<int32_t> numFds;
+	for (int i = 3; i < argc; i++) {
+		numFds.push_back(atoi(argv[i]));
+	}
+	if (numFds.empty()) {
+		numFds = { 1000, 10000, 50000 };
+	}
+
+	// we need a lot of fds
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	if (!g_loop.init()) {
+		fprintf(stdout, "Unable to init loop\n");
+		return 1;
+	}
+
+	for (auto n : numFds) {
+		runBenchmark(n, numActive, seconds);
+	}
+
+	return 0;
+}
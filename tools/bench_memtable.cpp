@@ -0,0 +1,121 @@
+#include "RdbTree.h"
+#include "RdbSkipList.h"
+#include "RdbList.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "fctypes.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <random>
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] [WRITERS] [READERS] [KEYS]\n", argv0);
+	fprintf(stdout, "Concurrent insert/read benchmark of RdbTree vs. RdbSkipList\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  WRITERS        number of threads adding records (default 4)\n");
+	fprintf(stdout, "  READERS        number of threads doing getList (default 4)\n");
+	fprintf(stdout, "  KEYS           total number of records to add (default 1000000)\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+// titledb-like: 12 byte keys, variable-sized data that we don't own
+template <typename T>
+static void runBenchmark(const char *name, int numWriters, int numReaders, int32_t numKeys) {
+	T tree;
+	if (!tree.set(-1, numKeys + 1000, -1, false, name)) {
+		fprintf(stdout, "%s: unable to allocate %" PRId32" nodes\n", name, numKeys);
+		exit(1);
+	}
+
+	static char data[100];
+
+	std::atomic<bool> done(false);
+	std::atomic<int64_t> numLists(0);
+	std::atomic<int64_t> numListRecs(0);
+
+	int64_t start = gettimeofdayInMilliseconds();
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < numReaders; r++) {
+		readers.emplace_back([&, r]() {
+			std::mt19937 rng(r);
+			while (!done) {
+				// Msg5-style read of a small range
+				key96_t startKey;
+				startKey.n1 = rng();
+				startKey.n0 = 0;
+				key96_t endKey = startKey;
+				endKey.n1 += 1 << 20;
+
+				RdbList list;
+				int32_t numPosRecs = 0;
+				int32_t numNegRecs = 0;
+				tree.getList(0, (const char *)&startKey, (const char *)&endKey, 64 * 1024, &list,
+				             &numPosRecs, &numNegRecs, false);
+				numLists++;
+				numListRecs += numPosRecs + numNegRecs;
+			}
+		});
+	}
+
+	std::vector<std::thread> writers;
+	for (int w = 0; w < numWriters; w++) {
+		writers.emplace_back([&, w]() {
+			std::mt19937_64 rng(1000 + w);
+			for (int32_t i = w; i < numKeys; i += numWriters) {
+				key96_t k;
+				k.n1 = (uint32_t)rng();
+				k.n0 = (rng() | 0x01);
+				tree.addNode(0, (const char *)&k, data, sizeof(data));
+			}
+		});
+	}
+
+	for (auto &t : writers) {
+		t.join();
+	}
+	int64_t addDone = gettimeofdayInMilliseconds();
+	done = true;
+	for (auto &t : readers) {
+		t.join();
+	}
+
+	int64_t took = addDone - start;
+	if (took <= 0) {
+		took = 1;
+	}
+
+	fprintf(stdout, "%-12s writers=%d readers=%d: %" PRId32" adds in %" PRId64" ms (%" PRId64" adds/s), "
+	        "%" PRId64" getLists (%" PRId64" lists/s, avg %" PRId64" recs)\n",
+	        name, numWriters, numReaders, tree.getNumUsedNodes(), took,
+	        (int64_t)numKeys * 1000 / took, numLists.load(), numLists.load() * 1000 / took,
+	        numLists.load() ? numListRecs.load() / numLists.load() : 0);
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	int numWriters = (argc > 1) ? atoi(argv[1]) : 4;
+	int numReaders = (argc > 2) ? atoi(argv[2]) : 4;
+	int32_t numKeys = (argc > 3) ? atoi(argv[3]) : 1000000;
+	if (numWriters <= 0 || numReaders < 0 || numKeys <= 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	runBenchmark<RdbTree>("RdbTree", numWriters, numReaders, numKeys);
+	runBenchmark<RdbSkipList>("RdbSkipList", numWriters, numReaders, numKeys);
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include "gb-include.h"
+
+#include "Xml.h"
+#include "Words.h"
+#include "HttpMime.h"
+#include "TitleRecVersion.h"
+#include "Unicode.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "fctypes.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] [DIR] [ITERATIONS]\n", argv0);
+	fprintf(stdout, "Compare html parse MB/s of Xml::set()+Words::set(Xml*) vs. the single pass Xml::set()\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  DIR            directory of saved pages (default ../test/system/data/html)\n");
+	fprintf(stdout, "  ITERATIONS     times to parse each page (default 1000)\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+static bool loadPages(const char *dirName, std::vector<std::string> *pages) {
+	DIR *dir = opendir(dirName);
+	if (!dir) {
+		fprintf(stdout, "Unable to open %s: %s\n", dirName, strerror(errno));
+		return false;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		std::string fileName = std::string(dirName) + "/" + ent->d_name;
+
+		struct stat st;
+		if (stat(fileName.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+			continue;
+		}
+
+		FILE *fp = fopen(fileName.c_str(), "r");
+		if (!fp) {
+			continue;
+		}
+
+		std::string page(st.st_size, '\0');
+		size_t read = fread(&page[0], 1, st.st_size, fp);
+		fclose(fp);
+
+		page.resize(read);
+		pages->push_back(page);
+	}
+
+	closedir(dir);
+	return true;
+}
+
+// returns microseconds spent parsing
+static int64_t runBenchmark(const std::vector<std::string> &pages, int32_t iterations, bool singlePass,
+                            std::vector<int32_t> *numWords) {
+	std::vector<char> buf;
+	int64_t took = 0;
+
+	for (int32_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < pages.size(); j++) {
+			// the parsers modify the buffer, and Xml::set() wants it null terminated
+			buf.assign(pages[j].begin(), pages[j].end());
+			buf.push_back('\0');
+
+			Xml xml;
+			Words words;
+
+			int64_t start = gettimeofdayInMicroseconds();
+			if (singlePass) {
+				xml.set(&buf[0], buf.size() - 1, TITLEREC_CURRENT_VERSION, CT_HTML, &words, true);
+			} else {
+				xml.set(&buf[0], buf.size() - 1, TITLEREC_CURRENT_VERSION, CT_HTML);
+				words.set(&xml, true);
+			}
+			took += gettimeofdayInMicroseconds() - start;
+
+			if (i == 0) {
+				numWords->push_back(words.getNumWords());
+			}
+		}
+	}
+
+	return took;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const char *dirName = (argc > 1) ? argv[1] : "../test/system/data/html";
+	int32_t iterations = (argc > 2) ? atoi(argv[2]) : 1000;
+	if (iterations <= 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	if (!ucInit()) {
+		fprintf(stdout, "Unable to load ucdata\n");
+		return 1;
+	}
+
+	std::vector<std::string> pages;
+	if (!loadPages(dirName, &pages) || pages.empty()) {
+		fprintf(stdout, "No pages found in %s\n", dirName);
+		return 1;
+	}
+
+	int64_t totalBytes = 0;
+	for (size_t i = 0; i < pages.size(); i++) {
+		totalBytes += pages[i].size();
+	}
+	totalBytes *= iterations;
+
+	std::vector<int32_t> numWordsTwoPass;
+	std::vector<int32_t> numWordsSinglePass;
+	int64_t twoPassTime = runBenchmark(pages, iterations, false, &numWordsTwoPass);
+	int64_t singlePassTime = runBenchmark(pages, iterations, true, &numWordsSinglePass);
+
+	if (numWordsTwoPass != numWordsSinglePass) {
+		fprintf(stdout, "Word counts differ between the two parsers!\n");
+		return 1;
+	}
+
+	if (twoPassTime <= 0) {
+		twoPassTime = 1;
+	}
+	if (singlePassTime <= 0) {
+		singlePassTime = 1;
+	}
+
+	fprintf(stdout, "%zu pages, %" PRId64" bytes parsed %" PRId32" times\n",
+	        pages.size(), totalBytes / iterations, iterations);
+	fprintf(stdout, "%-12s %8" PRId64" ms %8.2f MB/s\n", "two pass",
+	        twoPassTime / 1000, (double)totalBytes / (double)twoPassTime);
+	fprintf(stdout, "%-12s %8" PRId64" ms %8.2f MB/s\n", "single pass",
+	        singlePassTime / 1000, (double)totalBytes / (double)singlePassTime);
+	fprintf(stdout, "speedup %.2fx\n", (double)twoPassTime / (double)singlePassTime);
+
+	return 0;
+}
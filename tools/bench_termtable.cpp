@@ -0,0 +1,252 @@
+#include "gb-include.h"
+
+#include "Xml.h"
+#include "Words.h"
+#include "Bits.h"
+#include "Phrases.h"
+#include "Posdb.h"
+#include "HashTableX.h"
+#include "PosdbTermTable.h"
+#include "HttpMime.h"
+#include "TitleRecVersion.h"
+#include "Unicode.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "fctypes.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] [DIR] [ITERATIONS]\n", argv0);
+	fprintf(stdout, "Compare adding the posdb keys of documents to a HashTableX vs. a PosdbTermTable\n");
+	fprintf(stdout, "and copying them out like XmlDoc::addTable144() does\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  DIR            directory of saved pages (default ../test/system/data/html)\n");
+	fprintf(stdout, "  ITERATIONS     times to hash each page (default 1000)\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+static bool loadPages(const char *dirName, std::vector<std::string> *pages) {
+	DIR *dir = opendir(dirName);
+	if (!dir) {
+		fprintf(stdout, "Unable to open %s: %s\n", dirName, strerror(errno));
+		return false;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		std::string fileName = std::string(dirName) + "/" + ent->d_name;
+
+		struct stat st;
+		if (stat(fileName.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+			continue;
+		}
+
+		FILE *fp = fopen(fileName.c_str(), "r");
+		if (!fp) {
+			continue;
+		}
+
+		std::string page(st.st_size, '\0');
+		size_t read = fread(&page[0], 1, st.st_size, fp);
+		fclose(fp);
+
+		page.resize(read);
+		pages->push_back(page);
+	}
+
+	closedir(dir);
+	return true;
+}
+
+struct DocKeys {
+	int32_t m_numWords;
+	std::vector<key144_t> m_keys;
+};
+
+// the word and two word phrase keys hashWords3() makes for the body, and the
+// same again with a prefix like the meta tags and link text get
+static void makeKeys(std::string page, DocKeys *doc) {
+	page.push_back('\0');
+
+	Xml xml;
+	Words words;
+	xml.set(&page[0], page.size() - 1, TITLEREC_CURRENT_VERSION, CT_HTML, &words, true);
+
+	Bits bits;
+	bits.set(&words);
+	Phrases phrases;
+	phrases.set(&words, &bits);
+
+	doc->m_numWords = words.getNumWords();
+
+	const int64_t *wids = words.getWordIds();
+	const int64_t *pids = phrases.getPhraseIds2();
+	int64_t prefixHash = hash64b("gbinlinktext");
+
+	for (int32_t pass = 0; pass < 2; pass++) {
+		for (int32_t i = 0; i < words.getNumWords(); i++) {
+			if (!wids[i]) {
+				continue;
+			}
+
+			int64_t wid = pass ? hash64(wids[i], prefixHash) : wids[i];
+			key144_t k;
+			Posdb::makeKey(&k, wid, 0LL, i * 2, MAXDENSITYRANK, MAXDIVERSITYRANK, MAXWORDSPAMRANK, 0,
+			               pass ? HASHGROUP_INLINKTEXT : HASHGROUP_BODY, langUnknown, 0, false, false, false);
+			doc->m_keys.push_back(k);
+
+			if (pids[i]) {
+				int64_t pid = pass ? hash64(pids[i], prefixHash) : pids[i];
+				Posdb::makeKey(&k, pid, 0LL, i * 2, MAXDENSITYRANK, MAXDIVERSITYRANK, MAXWORDSPAMRANK, 0,
+				               pass ? HASHGROUP_INLINKTEXT : HASHGROUP_BODY, langUnknown, 0, true, false, false);
+				doc->m_keys.push_back(k);
+			}
+		}
+	}
+}
+
+struct Result {
+	int64_t m_time;
+	int64_t m_numTerms;
+	int32_t m_checksum;
+};
+
+// sized like XmlDoc::getMetaList() used to
+static void runHashTableX(const std::vector<DocKeys> &docs, int32_t iterations, std::vector<char> *out, Result *res) {
+	int64_t start = gettimeofdayInMicroseconds();
+	res->m_numTerms = 0;
+	res->m_checksum = 0;
+
+	for (int32_t it = 0; it < iterations; it++) {
+		for (size_t d = 0; d < docs.size(); d++) {
+			HashTableX tt;
+			tt.set(18, 4, docs[d].m_numWords * 4 + 5000, NULL, 0, false, "bench-tt");
+
+			const std::vector<key144_t> &keys = docs[d].m_keys;
+			for (size_t i = 0; i < keys.size(); i++) {
+				tt.addTerm144(&keys[i]);
+			}
+
+			res->m_checksum ^= tt.getKeyChecksum32();
+
+			char *p = &(*out)[0];
+			for (int32_t i = 0; i < tt.getNumSlots(); i++) {
+				if (tt.m_flags[i] == 0) {
+					continue;
+				}
+				*p++ = RDB_POSDB;
+				memcpy(p, tt.getKeyFromSlot(i), sizeof(key144_t));
+				p += sizeof(key144_t);
+			}
+			res->m_numTerms += tt.getNumUsedSlots();
+		}
+	}
+
+	res->m_time = gettimeofdayInMicroseconds() - start;
+}
+
+// sized like XmlDoc::getMetaList() does now
+static void runPosdbTermTable(const std::vector<DocKeys> &docs, int32_t iterations, std::vector<char> *out, Result *res) {
+	int64_t start = gettimeofdayInMicroseconds();
+	res->m_numTerms = 0;
+	res->m_checksum = 0;
+
+	for (int32_t it = 0; it < iterations; it++) {
+		for (size_t d = 0; d < docs.size(); d++) {
+			PosdbTermTable tt;
+			tt.set(docs[d].m_numWords * 2 + 2500);
+
+			const std::vector<key144_t> &keys = docs[d].m_keys;
+			for (size_t i = 0; i < keys.size(); i++) {
+				tt.addTerm144(&keys[i]);
+			}
+
+			res->m_checksum ^= tt.getKeyChecksum32();
+
+			tt.sortKeys();
+			char *p = &(*out)[0];
+			const key144_t *sorted = tt.getKeys();
+			for (int32_t i = 0; i < tt.getNumTerms(); i++) {
+				*p++ = RDB_POSDB;
+				memcpy(p, &sorted[i], sizeof(key144_t));
+				p += sizeof(key144_t);
+			}
+			res->m_numTerms += tt.getNumTerms();
+		}
+	}
+
+	res->m_time = gettimeofdayInMicroseconds() - start;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const char *dirName = (argc > 1) ? argv[1] : "../test/system/data/html";
+	int32_t iterations = (argc > 2) ? atoi(argv[2]) : 1000;
+	if (iterations <= 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	if (!ucInit()) {
+		fprintf(stdout, "Unable to load ucdata\n");
+		return 1;
+	}
+
+	std::vector<std::string> pages;
+	if (!loadPages(dirName, &pages) || pages.empty()) {
+		fprintf(stdout, "No pages found in %s\n", dirName);
+		return 1;
+	}
+
+	std::vector<DocKeys> docs(pages.size());
+	size_t maxKeys = 0;
+	int64_t totalKeys = 0;
+	for (size_t i = 0; i < pages.size(); i++) {
+		makeKeys(pages[i], &docs[i]);
+		maxKeys = std::max(maxKeys, docs[i].m_keys.size());
+		totalKeys += docs[i].m_keys.size();
+	}
+
+	std::vector<char> out((maxKeys + 1) * (sizeof(key144_t) + 1));
+
+	Result hashTableX;
+	Result termTable;
+	runHashTableX(docs, iterations, &out, &hashTableX);
+	runPosdbTermTable(docs, iterations, &out, &termTable);
+
+	if (hashTableX.m_numTerms != termTable.m_numTerms || hashTableX.m_checksum != termTable.m_checksum) {
+		fprintf(stdout, "The tables have different keys!\n");
+		return 1;
+	}
+
+	if (hashTableX.m_time <= 0) {
+		hashTableX.m_time = 1;
+	}
+	if (termTable.m_time <= 0) {
+		termTable.m_time = 1;
+	}
+
+	fprintf(stdout, "%zu pages, %" PRId64" keys (%" PRId64" distinct) hashed %" PRId32" times\n",
+	        pages.size(), totalKeys, hashTableX.m_numTerms / iterations, iterations);
+	fprintf(stdout, "%-16s %8" PRId64" ms %8.2f Mkeys/s\n", "HashTableX",
+	        hashTableX.m_time / 1000, (double)totalKeys * iterations / (double)hashTableX.m_time);
+	fprintf(stdout, "%-16s %8" PRId64" ms %8.2f Mkeys/s\n", "PosdbTermTable",
+	        termTable.m_time / 1000, (double)totalKeys * iterations / (double)termTable.m_time);
+	fprintf(stdout, "speedup %.2fx\n", (double)hashTableX.m_time / (double)termTable.m_time);
+
+	return 0;
+}
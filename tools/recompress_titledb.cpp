@@ -0,0 +1,483 @@
+#include "BigFile.h"
+#include "RdbMap.h"
+#include "Dir.h"
+#include "TitleRecCodec.h"
+#include "Titledb.h"
+#include "SafeBuf.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+// max bytes of titlerecs read or written at a time
+static const int64_t s_chunkSize = 32 * 1024 * 1024;
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] [-c CODEC] [-l LEVEL] [-t SAMPLES] [-s BYTES] [-d] [-n] COLLDIR\n", argv0);
+	fprintf(stdout, "Recompress the titledb files in COLLDIR (eg. coll.main.0). gb must not be running.\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  -c CODEC       zlib, zstd or lz4 (default zstd)\n");
+	fprintf(stdout, "  -l LEVEL       zstd compression level (default 3)\n");
+	fprintf(stdout, "  -t SAMPLES     train a new zstd dictionary from SAMPLES random titlerecs\n");
+	fprintf(stdout, "                 and compress with it. copy it to the twins of this host\n");
+	fprintf(stdout, "                 before they get records compressed with it\n");
+	fprintf(stdout, "  -s BYTES       max size of a trained dictionary (default 112640)\n");
+	fprintf(stdout, "  -d             compress with the newest dictionary in COLLDIR\n");
+	fprintf(stdout, "  -n             only train the dictionary, don't recompress\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+// . calls "func" for each record in the titledb file
+// . returns false on error
+template <typename Func>
+static bool forEachTitleRec(BigFile *f, Func func) {
+	int64_t fileSize = f->getFileSize();
+	if ( fileSize < 0 ) {
+		return false;
+	}
+
+	int64_t bufSize = s_chunkSize;
+	char *buf = (char *)mmalloc(bufSize, "titlerecs");
+	if ( ! buf ) {
+		return false;
+	}
+
+	bool ok = true;
+	int64_t offset = 0;
+	while ( ok && offset < fileSize ) {
+		int64_t readSize = fileSize - offset;
+		if ( readSize > bufSize ) readSize = bufSize;
+
+		if ( ! f->read(buf, readSize, offset) || g_errno ) {
+			fprintf(stderr, "Unable to read %s at offset %" PRId64": %s\n", f->getFilename(), offset, mstrerror(g_errno));
+			ok = false;
+			break;
+		}
+
+		char *p = buf;
+		char *pend = buf + readSize;
+		int64_t recSize = 0;
+		while ( p + sizeof(key96_t) <= pend ) {
+			// negative keys have no dataSize
+			if ( (p[0] & 0x01) == 0x00 ) {
+				recSize = sizeof(key96_t);
+			} else {
+				if ( p + sizeof(key96_t) + 4 > pend ) break;
+				int32_t dataSize = *(int32_t *)(p + sizeof(key96_t));
+				if ( dataSize < 4 ) {
+					fprintf(stderr, "Bad titlerec in %s at offset %" PRId64"\n", f->getFilename(), offset + (p - buf));
+					ok = false;
+					break;
+				}
+				recSize = sizeof(key96_t) + 4 + dataSize;
+			}
+			if ( p + recSize > pend ) break;
+			if ( ! func(p, (int32_t)recSize) ) {
+				ok = false;
+				break;
+			}
+			p += recSize;
+		}
+
+		// a record bigger than the buffer
+		if ( ok && p == buf && readSize == bufSize ) {
+			char *newBuf = (char *)mrealloc(buf, bufSize, recSize, "titlerecs");
+			if ( ! newBuf ) {
+				ok = false;
+				break;
+			}
+			buf = newBuf;
+			bufSize = recSize;
+			continue;
+		}
+
+		if ( ok && p == buf ) {
+			fprintf(stderr, "Truncated titlerec at the end of %s\n", f->getFilename());
+			ok = false;
+		}
+
+		offset += p - buf;
+	}
+
+	mfree(buf, bufSize, "titlerecs");
+	return ok;
+}
+
+static bool uncompressTitleRec(TitleRecDicts *dicts, const char *rec, SafeBuf *ubuf) {
+	int32_t usizeField = *(int32_t *)(rec + sizeof(key96_t) + 4);
+	int32_t usize = getTitleRecUncompressedSize(usizeField);
+	if ( usize <= 0 || usize > 100000000 ) {
+		fprintf(stderr, "Bad uncompressed titlerec size %" PRId32"\n", usize);
+		return false;
+	}
+
+	ubuf->reset();
+	if ( ! ubuf->reserve(usize) ) {
+		return false;
+	}
+
+	int32_t dataSize = *(int32_t *)(rec + sizeof(key96_t));
+	int32_t size = usize;
+	if ( ! titleRecUncompress(getTitleRecCodec(usizeField), dicts, ubuf->getBufStart(), &size,
+	                          rec + sizeof(key96_t) + 8, dataSize - 4) ) {
+		return false;
+	}
+	if ( size != usize ) {
+		fprintf(stderr, "Uncompressed titlerec is %" PRId32" bytes instead of %" PRId32"\n", size, usize);
+		return false;
+	}
+	ubuf->setLength(size);
+	return true;
+}
+
+static bool trainDictionary(const char *dir, const std::vector<std::string> &filenames, TitleRecDicts *dicts,
+                            uint32_t numSamples, size_t maxDictSize) {
+	// reservoir sample of the compressed records
+	std::vector<std::string> samples;
+	int64_t numRecs = 0;
+	for ( size_t i = 0; i < filenames.size(); i++ ) {
+		BigFile f;
+		f.set(dir, filenames[i].c_str());
+		if ( ! f.open(O_RDONLY) ) {
+			fprintf(stderr, "Unable to open %s\n", filenames[i].c_str());
+			return false;
+		}
+		bool ok = forEachTitleRec(&f, [&](const char *rec, int32_t recSize) {
+			if ( (rec[0] & 0x01) == 0x00 ) {
+				return true;
+			}
+			numRecs++;
+			if ( samples.size() < numSamples ) {
+				samples.push_back(std::string(rec, recSize));
+			} else {
+				int64_t j = ((int64_t)rand() * RAND_MAX + rand()) % numRecs;
+				if ( j < numSamples ) {
+					samples[j].assign(rec, recSize);
+				}
+			}
+			return true;
+		});
+		f.close();
+		if ( ! ok ) {
+			return false;
+		}
+	}
+
+	if ( samples.empty() ) {
+		fprintf(stderr, "No titlerecs to train a dictionary from\n");
+		return false;
+	}
+
+	// the dictionary is trained from the uncompressed records
+	SafeBuf sampleBuf;
+	std::vector<size_t> sampleSizes;
+	SafeBuf ubuf;
+	for ( size_t i = 0; i < samples.size(); i++ ) {
+		if ( ! uncompressTitleRec(dicts, samples[i].data(), &ubuf) ) {
+			return false;
+		}
+		if ( ! sampleBuf.safeMemcpy(&ubuf) ) {
+			return false;
+		}
+		sampleSizes.push_back(ubuf.length());
+	}
+
+	fprintf(stdout, "Training dictionary from %" PRId64" of %" PRId64" titlerecs (%" PRId32" bytes)\n",
+	        (int64_t)samples.size(), numRecs, sampleBuf.length());
+
+	uint32_t dictId;
+	if ( ! dicts->train(sampleBuf.getBufStart(), &sampleSizes[0], sampleSizes.size(), maxDictSize, &dictId) ) {
+		fprintf(stderr, "Unable to train dictionary: %s\n", mstrerror(g_errno));
+		return false;
+	}
+
+	fprintf(stdout, "Saved dictionary %" PRIu32" in %s\n", dictId, dir);
+	return true;
+}
+
+// same naming as BigFile::makeFilename_r()
+static void makePartFilename(const char *dir, const char *filename, int32_t part, char *buf, size_t bufSize) {
+	if ( part == 0 ) {
+		snprintf(buf, bufSize, "%s/%s", dir, filename);
+	} else {
+		snprintf(buf, bufSize, "%s/%s.part%" PRId32, dir, filename, part);
+	}
+}
+
+// make renames in "dir" durable
+static bool syncDir(const char *dir) {
+	int fd = ::open(dir, O_RDONLY | O_DIRECTORY);
+	if ( fd < 0 ) {
+		return false;
+	}
+	bool ok = ( fsync(fd) == 0 );
+	::close(fd);
+	return ok;
+}
+
+static bool recompressFile(const char *dir, const char *filename, TitleRecDicts *dicts, TitleRecDicts *compressDicts,
+                           titlerec_codec_t codec, int32_t level) {
+	BigFile f;
+	f.set(dir, filename);
+	if ( ! f.open(O_RDONLY) ) {
+		fprintf(stderr, "Unable to open %s\n", filename);
+		return false;
+	}
+
+	char tmpFilename[1024];
+	snprintf(tmpFilename, sizeof(tmpFilename), "%s.recompress", filename);
+
+	BigFile out;
+	out.set(dir, tmpFilename);
+	out.unlink();
+	if ( ! out.open(O_RDWR | O_CREAT) ) {
+		fprintf(stderr, "Unable to create %s\n", tmpFilename);
+		return false;
+	}
+
+	int64_t oldSize = f.getFileSize();
+	int64_t outOffset = 0;
+	int64_t numRecs = 0;
+	SafeBuf obuf;
+	SafeBuf ubuf;
+	SafeBuf cbuf;
+
+	auto flush = [&]() {
+		if ( obuf.length() == 0 ) {
+			return true;
+		}
+		if ( ! out.write(obuf.getBufStart(), obuf.length(), outOffset) || g_errno ) {
+			fprintf(stderr, "Unable to write %s: %s\n", tmpFilename, mstrerror(g_errno));
+			return false;
+		}
+		outOffset += obuf.length();
+		obuf.reset();
+		return true;
+	};
+
+	bool ok = forEachTitleRec(&f, [&](const char *rec, int32_t recSize) {
+		numRecs++;
+
+		// negative keys are copied as they are
+		if ( (rec[0] & 0x01) == 0x00 ) {
+			return obuf.safeMemcpy(rec, recSize);
+		}
+
+		if ( ! uncompressTitleRec(dicts, rec, &ubuf) ) {
+			return false;
+		}
+
+		int32_t bound = getTitleRecCompressBound(codec, ubuf.length());
+		cbuf.reset();
+		if ( ! cbuf.reserve(bound) ) {
+			return false;
+		}
+		int32_t size = bound;
+		if ( ! titleRecCompress(codec, level, compressDicts, cbuf.getBufStart(), &size, ubuf.getBufStart(), ubuf.length()) ) {
+			return false;
+		}
+
+		int32_t dataSize = size + 4;
+		int32_t usizeField = makeTitleRecUsizeField(codec, ubuf.length());
+		if ( ! obuf.safeMemcpy(rec, sizeof(key96_t)) ||
+		     ! obuf.safeMemcpy(&dataSize, 4) ||
+		     ! obuf.safeMemcpy(&usizeField, 4) ||
+		     ! obuf.safeMemcpy(cbuf.getBufStart(), size) ) {
+			return false;
+		}
+
+		if ( obuf.length() >= s_chunkSize ) {
+			return flush();
+		}
+		return true;
+	});
+
+	if ( ok ) {
+		ok = flush();
+	}
+
+	// the new file must be on disk before it replaces the old one
+	int32_t numNewParts = out.getNumParts();
+	for ( int32_t i = 0; ok && i < numNewParts; i++ ) {
+		int fd = out.getfd(i, false);
+		if ( fd < 0 || fsync(fd) != 0 ) {
+			fprintf(stderr, "Unable to sync %s: %s\n", tmpFilename, strerror(errno));
+			ok = false;
+		}
+	}
+
+	int32_t numOldParts = f.getNumParts();
+	f.close();
+	out.close();
+
+	if ( ! ok ) {
+		fprintf(stderr, "Recompressing %s failed. Leaving it as it is\n", filename);
+		out.unlink();
+		return false;
+	}
+
+	// . replace the file by renaming each part over the old one, so there
+	//   is no moment without a titledb file. BigFile::rename() refuses to
+	//   overwrite
+	// . parts the new file doesn't have are removed afterwards
+	for ( int32_t i = 0; i < numNewParts; i++ ) {
+		char src[2048];
+		char dst[2048];
+		makePartFilename(dir, tmpFilename, i, src, sizeof(src));
+		makePartFilename(dir, filename, i, dst, sizeof(dst));
+		if ( ::rename(src, dst) != 0 ) {
+			fprintf(stderr, "Unable to rename %s to %s: %s\n", src, dst, strerror(errno));
+			return false;
+		}
+	}
+	for ( int32_t i = numNewParts; i < numOldParts; i++ ) {
+		char old[2048];
+		makePartFilename(dir, filename, i, old, sizeof(old));
+		::unlink(old);
+	}
+	if ( ! syncDir(dir) ) {
+		fprintf(stderr, "Unable to sync %s: %s\n", dir, strerror(errno));
+		return false;
+	}
+
+	// offsets changed, so the map must be regenerated
+	char mapFilename[1024];
+	strcpy(mapFilename, filename);
+	strcpy(strrchr(mapFilename, '.'), ".map");
+
+	char mapPath[2048];
+	snprintf(mapPath, sizeof(mapPath), "%s/%s", dir, mapFilename);
+	::unlink(mapPath);
+
+	BigFile newFile;
+	newFile.set(dir, filename);
+	RdbMap map;
+	map.set(dir, mapFilename, Titledb::getFixedDataSize(), Titledb::getUseHalfKeys(), Titledb::getKeySize(), GB_INDEXDB_PAGE_SIZE);
+	if ( ! map.generateMap(&newFile) || ! map.writeMap(true) ) {
+		fprintf(stderr, "Unable to generate %s. gb will regenerate it on startup\n", mapFilename);
+	}
+
+	fprintf(stdout, "%s: %" PRId64" records, %" PRId64" -> %" PRId64" bytes\n", filename, numRecs, oldSize, outOffset);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	titlerec_codec_t codec = TITLEREC_CODEC_ZSTD;
+	int32_t level = 3;
+	uint32_t numSamples = 0;
+	size_t maxDictSize = 112640;
+	bool useDict = false;
+	bool trainOnly = false;
+
+	static const struct option long_options[] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int c;
+	while ( (c = getopt_long(argc, argv, "hc:l:t:s:dn", long_options, NULL)) != -1 ) {
+		switch ( c ) {
+			case 'c':
+				codec = getTitleRecCodecFromName(optarg);
+				if ( codec == TITLEREC_CODEC_ZLIB && strcasecmp(optarg, "zlib") != 0 ) {
+					fprintf(stderr, "Unknown codec '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'l':
+				level = atoi(optarg);
+				break;
+			case 't':
+				numSamples = atoi(optarg);
+				useDict = true;
+				break;
+			case 's':
+				maxDictSize = atoi(optarg);
+				break;
+			case 'd':
+				useDict = true;
+				break;
+			case 'n':
+				trainOnly = true;
+				break;
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if ( optind >= argc ) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if ( useDict && codec != TITLEREC_CODEC_ZSTD ) {
+		fprintf(stderr, "Dictionaries are only used by zstd\n");
+		return 1;
+	}
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	char dir[PATH_MAX];
+	if ( ! realpath(argv[optind], dir) ) {
+		fprintf(stderr, "Unable to find %s\n", argv[optind]);
+		return 1;
+	}
+	strcat(dir, "/");
+
+	std::vector<std::string> filenames;
+	Dir d;
+	d.set(dir);
+	if ( ! d.open() ) {
+		fprintf(stderr, "Unable to open %s\n", dir);
+		return 1;
+	}
+	while ( const char *filename = d.getNextFilename("titledb*") ) {
+		// skip .map files, part files and left over temp files
+		size_t len = strlen(filename);
+		if ( len < 4 || strcmp(filename + len - 4, ".dat") != 0 ) {
+			continue;
+		}
+		filenames.push_back(filename);
+	}
+	d.close();
+
+	TitleRecDicts dicts;
+	dicts.load(dir);
+
+	if ( numSamples > 0 ) {
+		if ( ! trainDictionary(dir, filenames, &dicts, numSamples, maxDictSize) ) {
+			return 1;
+		}
+	} else if ( useDict && dicts.getNewestId() == 0 ) {
+		fprintf(stderr, "No dictionary in %s. Train one with -t\n", dir);
+		return 1;
+	}
+
+	if ( trainOnly ) {
+		return 0;
+	}
+
+	fprintf(stdout, "Recompressing %" PRId64" titledb files with %s\n", (int64_t)filenames.size(), getTitleRecCodecName(codec));
+
+	// the dictionaries are needed to read records compressed with them
+	// even if we don't compress with one
+	for ( size_t i = 0; i < filenames.size(); i++ ) {
+		if ( ! recompressFile(dir, filenames[i].c_str(), &dicts, useDict ? &dicts : NULL, codec, level) ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}